@@ -36,9 +36,27 @@ static const char *app_sources[] = {
     "src/picking.cpp",
     "src/edge_detection.cpp",
     "src/face_detection.cpp",
+    "src/face_provenance.cpp",
+    "src/mesh_topology.cpp",
+    "src/mesh_bvh.cpp",
+    "src/mesh_derived.cpp",
+    "src/mesh_lod.cpp",
+    "src/mesh_lod_builder.cpp",
     "src/input_controller.cpp",
+    "src/glyph_atlas.cpp",
+    "src/view_culling.cpp",
+    "src/frame_scheduler.cpp",
     "src/lod_policy.cpp",
     "src/op_decoder.cpp",
+    "src/replay_fusion.cpp",
+    "src/replay_scheduler.cpp",
+    "src/replay_stream.cpp",
+    "src/replay_semantic_arena.cpp",
+    "src/union_by_bounds.cpp",
+    "src/replay_cache.cpp",
+    "src/work_stealing_pool.cpp",
+    "src/log.cpp",
+    "src/trace.cpp",
     "src/op_reader.cpp",
     "src/op_trace.cpp",
     "src/render_scene.cpp",
@@ -46,10 +64,22 @@ static const char *app_sources[] = {
     "src/renderer_3d.cpp",
     "src/renderer_overlay.cpp",
     "src/scene_session.cpp",
+    "src/scene_loader.cpp",
+    "src/scene_refiner.cpp",
+    "src/scene_analyzer.cpp",
+    "src/scene_tab_cache.cpp",
+    "src/scene_export_job.cpp",
+    "src/file_watch.cpp",
+    "src/mesh_disk_cache.cpp",
+    "src/threemf_writer.cpp",
     "src/script_worker_client.cpp",
+    "src/ipc_doorbell.cpp",
+    "src/scene_decode.cpp",
+    "src/scene_object.cpp",
     "src/scene_runtime.cpp",
     "src/sketch_semantics.cpp",
     "src/sketch_dimensions.cpp",
+    "src/sketch_layout.cpp",
     "src/ui_layout.cpp",
     "src/ui_state.cpp",
 };
@@ -858,7 +888,19 @@ static bool bake_funnel_sans_header(const char *baker_bin_path, const char *head
     return nob_cmd_run(&cmd);
 }
 
-// Build lod_replay_test by compiling only its own source file and linking it
+// Sources of lod_replay_test; lod_replay_test.cpp holds main().
+static const char *lod_replay_test_sources[] = {
+    "src/lod_replay_test.cpp",
+    "src/lod_replay_stream_test.cpp",
+    "src/lod_replay_fusion_test.cpp",
+    "src/lod_replay_mesh_test.cpp",
+    "src/lod_replay_topology_test.cpp",
+    "src/lod_replay_face_test.cpp",
+    "src/lod_replay_file_watch_test.cpp",
+    "src/lod_replay_threemf_test.cpp",
+};
+
+// Build lod_replay_test by compiling only its own source files and linking them
 // with the shared objects already produced by the main build (manifold,
 // op_decoder, lod_policy, and optionally cross_section / clipper2).  This
 // avoids recompiling shared code and keeps the incremental build fast.
@@ -867,32 +909,52 @@ static bool build_lod_replay_test(const BuildContext *ctx, const char *binary_pa
     if (!nob_mkdir_if_not_exists(obj_dir)) return false;
     if (!nob_mkdir_if_not_exists(nob_temp_sprintf("%s/src", obj_dir))) return false;
 
-    const char *src = "src/lod_replay_test.cpp";
-    const char *obj = make_obj_path(obj_dir, "src", src);
+    Nob_File_Paths link_objs = {0};
+    for (size_t i = 0; i < NOB_ARRAY_LEN(lod_replay_test_sources); ++i) {
+        const char *src = lod_replay_test_sources[i];
+        const char *obj = make_obj_path(obj_dir, "src", src);
 
-    CompileUnit unit = {0};
-    unit.src_path = src;
-    unit.obj_path = obj;
-    unit.lang = COMPILE_LANG_CXX;
-    unit.group = COMPILE_GROUP_APP;
-    unit.sanitize = ctx->opt.asan;
+        CompileUnit unit = {0};
+        unit.src_path = src;
+        unit.obj_path = obj;
+        unit.lang = COMPILE_LANG_CXX;
+        unit.group = COMPILE_GROUP_APP;
+        unit.sanitize = ctx->opt.asan;
 
-    int rebuild = needs_rebuild_unit(ctx, &unit);
-    if (rebuild < 0) return false;
-    if (rebuild != 0) {
-        Nob_Cmd cmd = {0};
-        build_compile_cmd(ctx, &unit, &cmd);
-        if (!nob_cmd_run(&cmd)) {
-            nob_log(NOB_ERROR, "lod_replay_test compilation failed");
-            return false;
+        int rebuild = needs_rebuild_unit(ctx, &unit);
+        if (rebuild < 0) return false;
+        if (rebuild != 0) {
+            Nob_Cmd cmd = {0};
+            build_compile_cmd(ctx, &unit, &cmd);
+            if (!nob_cmd_run(&cmd)) {
+                nob_log(NOB_ERROR, "lod_replay_test compilation failed: %s", src);
+                return false;
+            }
         }
+        nob_da_append(&link_objs, obj);
     }
 
-    // Link: lod_replay_test.o + shared objects already compiled by the main build.
-    Nob_File_Paths link_objs = {0};
-    nob_da_append(&link_objs, obj);
+    // Link: the test objects + shared objects already compiled by the main build.
     nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/op_decoder.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/replay_fusion.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/replay_scheduler.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/replay_stream.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/replay_semantic_arena.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/union_by_bounds.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/replay_cache.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/work_stealing_pool.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/log.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/trace.cpp"));
     nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/lod_policy.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/mesh_bvh.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/mesh_topology.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/edge_detection.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/face_detection.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/face_provenance.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/mesh_derived.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/mesh_lod.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/file_watch.cpp"));
+    nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", "src/threemf_writer.cpp"));
     for (size_t i = 0; i < NOB_ARRAY_LEN(manifold_sources); ++i) {
         nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "manifold/src", manifold_sources[i]));
     }
@@ -952,15 +1014,46 @@ static bool build_ipc_integration_test(const BuildContext *ctx, const char *bina
         }
     }
 
-    // Shared objects required by ScriptWorkerClient and its call graph.
+    // Shared objects required by ScriptWorkerClient, the scene session and
+    // their call graph.
     const char *ipc_srcs[] = {
         "src/script_worker_client.cpp",
+        "src/ipc_doorbell.cpp",
+        "src/scene_decode.cpp",
+        "src/scene_object.cpp",
+        "src/mesh_bvh.cpp",
+        "src/mesh_derived.cpp",
+        "src/mesh_disk_cache.cpp",
         "src/op_decoder.cpp",
+        "src/replay_fusion.cpp",
+        "src/replay_scheduler.cpp",
+        "src/replay_stream.cpp",
+        "src/replay_semantic_arena.cpp",
+        "src/union_by_bounds.cpp",
+        "src/replay_cache.cpp",
+        "src/work_stealing_pool.cpp",
+        "src/log.cpp",
+        "src/trace.cpp",
         "src/op_reader.cpp",
         "src/op_trace.cpp",
         "src/lod_policy.cpp",
         "src/sketch_dimensions.cpp",
+        "src/sketch_layout.cpp",
         "src/sketch_semantics.cpp",
+        "src/scene_session.cpp",
+        "src/scene_loader.cpp",
+        "src/scene_refiner.cpp",
+        "src/scene_analyzer.cpp",
+        "src/scene_tab_cache.cpp",
+        "src/scene_export_job.cpp",
+        "src/file_watch.cpp",
+        "src/threemf_writer.cpp",
+        "src/edge_detection.cpp",
+        "src/face_detection.cpp",
+        "src/face_provenance.cpp",
+        "src/mesh_topology.cpp",
+        "src/mesh_lod.cpp",
+        "src/mesh_lod_builder.cpp",
     };
 
     Nob_File_Paths link_objs = {0};
@@ -1106,12 +1199,16 @@ static bool run_test_suite(const char *lod_test_binary, const char *ipc_test_bin
     return all_passed;
 }
 
-static bool build_run_script(const BuildContext *ctx, const char *binary_path) {
-    const char *obj_dir = "build/obj_run_script";
+// Builds a headless tool (src/<name>.cpp) that drives the worker over IPC and
+// links what it needs from the app objects: run_script, batch_build, bench.
+// `extra_srcs` names app objects a tool needs beyond the IPC path.
+static bool build_headless_tool(const BuildContext *ctx, const char *name, const char *binary_path,
+                                const char *const *extra_srcs, size_t extra_count) {
+    const char *obj_dir = nob_temp_sprintf("build/obj_%s", name);
     if (!nob_mkdir_if_not_exists(obj_dir)) return false;
     if (!nob_mkdir_if_not_exists(nob_temp_sprintf("%s/src", obj_dir))) return false;
 
-    const char *src = "src/run_script.cpp";
+    const char *src = nob_temp_sprintf("src/%s.cpp", name);
     const char *obj = make_obj_path(obj_dir, "src", src);
 
     CompileUnit unit = {0};
@@ -1131,12 +1228,28 @@ static bool build_run_script(const BuildContext *ctx, const char *binary_path) {
 
     const char *ipc_srcs[] = {
         "src/script_worker_client.cpp",
+        "src/ipc_doorbell.cpp",
+        "src/scene_decode.cpp",
+        "src/scene_object.cpp",
+        "src/mesh_bvh.cpp",
+        "src/mesh_derived.cpp",
         "src/op_decoder.cpp",
+        "src/replay_fusion.cpp",
+        "src/replay_scheduler.cpp",
+        "src/replay_stream.cpp",
+        "src/replay_semantic_arena.cpp",
+        "src/union_by_bounds.cpp",
+        "src/replay_cache.cpp",
+        "src/work_stealing_pool.cpp",
+        "src/log.cpp",
+        "src/trace.cpp",
         "src/op_reader.cpp",
         "src/op_trace.cpp",
         "src/lod_policy.cpp",
         "src/sketch_dimensions.cpp",
+        "src/sketch_layout.cpp",
         "src/sketch_semantics.cpp",
+        "src/threemf_writer.cpp",
     };
 
     Nob_File_Paths link_objs = {0};
@@ -1144,6 +1257,9 @@ static bool build_run_script(const BuildContext *ctx, const char *binary_path) {
     for (size_t i = 0; i < NOB_ARRAY_LEN(ipc_srcs); ++i) {
         nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", ipc_srcs[i]));
     }
+    for (size_t i = 0; i < extra_count; ++i) {
+        nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "src", extra_srcs[i]));
+    }
     for (size_t i = 0; i < NOB_ARRAY_LEN(manifold_sources); ++i) {
         nob_da_append(&link_objs, make_obj_path(ctx->obj_root, "manifold/src", manifold_sources[i]));
     }
@@ -1194,17 +1310,47 @@ static bool run_lint_cpp_incremental(void) {
     static const char *srcs[] = {
         "src/op_reader.cpp",
         "src/op_decoder.cpp",
+        "src/replay_fusion.cpp",
+        "src/replay_scheduler.cpp",
+        "src/replay_stream.cpp",
+        "src/replay_semantic_arena.cpp",
+        "src/union_by_bounds.cpp",
+        "src/replay_cache.cpp",
+        "src/work_stealing_pool.cpp",
+        "src/log.cpp",
+        "src/trace.cpp",
         "src/op_trace.cpp",
         "src/script_worker_client.cpp",
+        "src/ipc_doorbell.cpp",
+        "src/scene_decode.cpp",
+        "src/scene_object.cpp",
         "src/scene_session.cpp",
+        "src/scene_loader.cpp",
+        "src/scene_refiner.cpp",
+        "src/scene_analyzer.cpp",
+        "src/scene_tab_cache.cpp",
+        "src/scene_export_job.cpp",
+        "src/file_watch.cpp",
+        "src/mesh_disk_cache.cpp",
+        "src/threemf_writer.cpp",
         "src/edge_detection.cpp",
         "src/face_detection.cpp",
+        "src/face_provenance.cpp",
+        "src/mesh_topology.cpp",
+        "src/mesh_bvh.cpp",
+        "src/mesh_derived.cpp",
+        "src/mesh_lod.cpp",
+        "src/mesh_lod_builder.cpp",
         "src/lod_policy.cpp",
         "src/sketch_dimensions.cpp",
+        "src/sketch_layout.cpp",
         "src/sketch_semantics.cpp",
         "src/picking.cpp",
         "src/interaction_state.cpp",
         "src/input_controller.cpp",
+        "src/glyph_atlas.cpp",
+        "src/view_culling.cpp",
+        "src/frame_scheduler.cpp",
         "src/renderer_3d.cpp",
         "src/renderer_overlay.cpp",
         "src/render_ui.cpp",
@@ -1216,8 +1362,8 @@ static bool run_lint_cpp_incremental(void) {
     nob_mkdir_if_not_exists("build/clang-tidy-stamps");
 
     // Collect dirty sources and their stamp paths.
-    const char *dirty_srcs[32];
-    char stamp_paths[32][256];
+    const char *dirty_srcs[NOB_ARRAY_LEN(srcs)];
+    char stamp_paths[NOB_ARRAY_LEN(srcs)][256];
     size_t ndirty = 0;
     size_t nskipped = 0;
     bool ok = true;
@@ -1320,6 +1466,9 @@ int main(int argc, char **argv) {
     NOB_GO_REBUILD_URSELF(argc, argv);
     BuildOptions opt = {0};
     bool run_tests = false;
+    bool run_bench = false;
+    int bench_argc = 0;
+    char **bench_argv = NULL;
     argc--;
     argv++;
 
@@ -1418,6 +1567,12 @@ int main(int argc, char **argv) {
             return ok ? 0 : 1;
         } else if (strcmp(arg, "test") == 0) {
             run_tests = true;
+        } else if (strcmp(arg, "bench") == 0) {
+            // Everything after `bench` is passed through to build/bench.
+            run_bench = true;
+            bench_argc = argc;
+            bench_argv = argv;
+            break;
         } else if (strcmp(arg, "--asan") == 0) {
             opt.asan = true;
         } else if (strcmp(arg, "--asan-deps") == 0) {
@@ -1430,7 +1585,7 @@ int main(int argc, char **argv) {
             const char *value = nob_shift_args(&argc, &argv);
             opt.max_procs = atoi(value);
         } else if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
-            nob_log(NOB_INFO, "Usage: ./nob [agent-check|lint-ts|lint-cpp|lint-docs|test] [--asan] [--asan-deps] [--max-procs N]");
+            nob_log(NOB_INFO, "Usage: ./nob [agent-check|lint-ts|lint-cpp|lint-docs|test|bench] [--asan] [--asan-deps] [--max-procs N]");
             nob_log(NOB_INFO, "  agent-check [--script=<path>]");
             nob_log(NOB_INFO, "             Closed-loop: build → layers → lint-ts → lint-cpp → lint-docs → ipc test.");
             nob_log(NOB_INFO, "             With --script=<path>: also runs that script through the worker.");
@@ -1439,13 +1594,15 @@ int main(int argc, char **argv) {
             nob_log(NOB_INFO, "  lint-cpp   Run clang-tidy incrementally in parallel (requires build first).");
             nob_log(NOB_INFO, "  lint-docs  Check markdown links + op-code sync across C++/TS/docs.");
             nob_log(NOB_INFO, "  test       Build and run all tests (layer check, lod_replay_test, bun tests, smoke test).");
+            nob_log(NOB_INFO, "  bench [--iters=N] [--filter=S] [--large] [--no-ipc]");
+            nob_log(NOB_INFO, "             Build and run build/bench; stdout: one JSON line with every benchmark.");
             nob_log(NOB_INFO, "  --asan     Build vicad with ASan+UBSan instrumentation.");
             nob_log(NOB_INFO, "  --asan-deps  Also instrument manifold/clipper dependencies (requires --asan).");
             nob_log(NOB_INFO, "  --max-procs N  Limit concurrent compiler processes (N <= 0 uses Nob default).");
             return 0;
         } else {
             nob_log(NOB_ERROR, "Unknown argument: %s", arg);
-            nob_log(NOB_INFO, "Usage: ./nob [agent-check|lint-ts|lint-cpp|lint-docs|test] [--asan] [--asan-deps] [--max-procs N]");
+            nob_log(NOB_INFO, "Usage: ./nob [agent-check|lint-ts|lint-cpp|lint-docs|test|bench] [--asan] [--asan-deps] [--max-procs N]");
             return 1;
         }
     }
@@ -1622,7 +1779,8 @@ int main(int argc, char **argv) {
     }
 
     // run_script is always built — agent-check --script= depends on it.
-    if (!build_run_script(&ctx, "build/run_script")) return 1;
+    if (!build_headless_tool(&ctx, "run_script", "build/run_script", NULL, 0)) return 1;
+    if (!build_headless_tool(&ctx, "batch_build", "build/batch_build", NULL, 0)) return 1;
 
     if (run_tests) {
         const char *lod_test_binary = "build/lod_replay_test";
@@ -1632,5 +1790,21 @@ int main(int argc, char **argv) {
         if (!run_test_suite(lod_test_binary, ipc_test_binary, "build/vicad")) return 1;
     }
 
+    if (run_bench) {
+        const char *bench_srcs[] = {
+            "src/mesh_topology.cpp",
+            "src/edge_detection.cpp",
+            "src/face_detection.cpp",
+            "src/face_provenance.cpp",
+        };
+        if (!build_headless_tool(&ctx, "bench", "build/bench", bench_srcs, NOB_ARRAY_LEN(bench_srcs))) return 1;
+        // The JSON report goes to stdout; per-benchmark progress to the NDJSON
+        // event log on stderr.
+        Nob_Cmd cmd = {0};
+        nob_cmd_append(&cmd, "build/bench");
+        for (int i = 0; i < bench_argc; ++i) nob_cmd_append(&cmd, bench_argv[i]);
+        if (!nob_cmd_run(&cmd)) return 1;
+    }
+
     return 0;
 }
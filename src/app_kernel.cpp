@@ -14,12 +14,12 @@
 #include <set>
 #include <ctime>
 #include <optional>
+#include <limits>
 #include <string>
 #include <vector>
 #include <fstream>
 #include <algorithm>
 #include <filesystem>
-#include <sys/stat.h>
 #include <new>
 
 #if defined(__APPLE__)
@@ -30,14 +30,24 @@
 #include "../RGFW.h"
 #include "app_kernel.h"
 #include "log.h"
+#include "trace.h"
 #include "edge_detection.h"
 #include "face_detection.h"
+#include "file_watch.h"
+#include "mesh_derived.h"
+#include "mesh_lod.h"
+#include "mesh_topology.h"
 #include "app_state.h"
+#include "frame_scheduler.h"
+#include "glyph_atlas.h"
 #include "input_controller.h"
 #include "render_scene.h"
 #include "render_ui.h"
+#include "renderer_3d.h"
+#include "renderer_overlay.h"
 #include "scene_session.h"
 #include "scene_runtime.h"
+#include "view_culling.h"
 #include "picking.h"
 #include "script_worker_client.h"
 #include "manifold/manifold.h"
@@ -47,12 +57,6 @@
 #ifdef VICAD_HAS_NFD
 #include "nfd.h"
 #endif
-#ifdef VICAD_HAS_HARFBUZZ
-#include <ft2build.h>
-#include FT_FREETYPE_H
-#include <hb.h>
-#include <hb-ft.h>
-#endif
 
 #if defined(__APPLE__)
 #include <OpenGL/gl.h>
@@ -69,7 +73,6 @@
 
 #define CLAY_IMPLEMENTATION
 #include "../clay.h"
-#include "funnel_sans_baked.h"
 
 using vicad_app::Vec2;
 using vicad_app::Vec3;
@@ -123,288 +126,24 @@ static Clay_String ui_text_slot(size_t slot, const std::string &text) {
     return s;
 }
 
-struct BakedFontState {
-    GLuint texture;
-    bool initialized;
-};
-
-static BakedFontState g_baked_font = {};
+// Every UI and world-space label; see glyph_atlas.h.
+static vicad_text::TextRenderer g_text;
+static vicad_renderer_overlay::UiBatch g_ui_batch;
+static std::vector<vicad_text::TextQuad> g_ui_glyph_scratch;
 static constexpr float kHudBaseScale = 0.75f;
 static constexpr float kHudLegacyScale = 1.5f;
 static constexpr int kRequestedMsaaSamples = 4;
-static constexpr float kTextShadowAlphaScale = 0.0f;
-#ifdef VICAD_HAS_HARFBUZZ
-static constexpr size_t kHbTextCacheLimit = 512;
-
-struct HbTextCacheEntry {
-    GLuint texture;
-    int width;
-    int height;
-    int offset_x;
-    int offset_y;
-    uint64_t last_use;
-};
-
-struct HbTextState {
-    bool initialized;
-    FT_Library ft_library;
-    FT_Face ft_face;
-    hb_font_t *hb_font;
-    std::map<std::string, HbTextCacheEntry> cache;
-    uint64_t use_stamp;
-};
-
-static HbTextState g_hb_text = {};
-
-static int fixed26_6_floor(int v) {
-    if (v >= 0) return v / 64;
-    return -(((-v) + 63) / 64);
-}
-
-static bool ensure_hb_text_state(void) {
-    if (g_hb_text.initialized) return true;
-    if (FT_Init_FreeType(&g_hb_text.ft_library) != 0) return false;
-    if (FT_New_Face(g_hb_text.ft_library, "Funnel_Sans/static/FunnelSans-Regular.ttf", 0, &g_hb_text.ft_face) != 0) {
-        FT_Done_FreeType(g_hb_text.ft_library);
-        g_hb_text.ft_library = NULL;
-        return false;
-    }
-    g_hb_text.hb_font = hb_ft_font_create_referenced(g_hb_text.ft_face);
-    if (!g_hb_text.hb_font) {
-        FT_Done_Face(g_hb_text.ft_face);
-        FT_Done_FreeType(g_hb_text.ft_library);
-        g_hb_text.ft_face = NULL;
-        g_hb_text.ft_library = NULL;
-        return false;
-    }
-    hb_ft_font_set_load_flags(g_hb_text.hb_font, FT_LOAD_DEFAULT);
-    g_hb_text.initialized = true;
-    g_hb_text.use_stamp = 0;
-    return true;
-}
-
-static void destroy_hb_text_state(void) {
-    if (!g_hb_text.initialized) return;
-    for (auto &it : g_hb_text.cache) {
-        if (it.second.texture != 0) glDeleteTextures(1, &it.second.texture);
-    }
-    g_hb_text.cache.clear();
-    if (g_hb_text.hb_font) hb_font_destroy(g_hb_text.hb_font);
-    g_hb_text.hb_font = nullptr;
-    if (g_hb_text.ft_face) FT_Done_Face(g_hb_text.ft_face);
-    g_hb_text.ft_face = NULL;
-    if (g_hb_text.ft_library) FT_Done_FreeType(g_hb_text.ft_library);
-    g_hb_text.ft_library = NULL;
-    g_hb_text.initialized = false;
-}
-
-struct HbGlyphPlacement {
-    hb_codepoint_t gid;
-    int x;
-    int y;
-};
-
-static bool rasterize_text_hb(const char *text, int font_px,
-                              std::vector<uint8_t> *out_alpha,
-                              int *out_w, int *out_h,
-                              int *out_off_x, int *out_off_y) {
-    if (!text || !text[0] || !out_alpha || !out_w || !out_h || !out_off_x || !out_off_y) return false;
-    if (font_px <= 0) return false;
-    if (!ensure_hb_text_state()) return false;
-
-    if (FT_Set_Pixel_Sizes(g_hb_text.ft_face, 0, (FT_UInt)font_px) != 0) return false;
-    hb_ft_font_changed(g_hb_text.hb_font);
-
-    const int line_height = std::max(1, (int)(g_hb_text.ft_face->size->metrics.height >> 6));
-    const int ascender = (int)(g_hb_text.ft_face->size->metrics.ascender >> 6);
-
-    std::vector<std::string> lines;
-    {
-        const char *start = text;
-        const char *p = text;
-        for (;;) {
-            if (*p == '\n' || *p == '\0') {
-                lines.emplace_back(start, (size_t)(p - start));
-                if (*p == '\0') break;
-                start = p + 1;
-            }
-            ++p;
-        }
-        if (lines.empty()) lines.emplace_back("");
-    }
-
-    std::vector<HbGlyphPlacement> glyphs;
-    int min_x = 0;
-    int min_y = 0;
-    int max_x = 0;
-    int max_y = 0;
-    bool have_bounds = false;
-
-    for (size_t line_idx = 0; line_idx < lines.size(); ++line_idx) {
-        hb_buffer_t *buffer = hb_buffer_create();
-        if (!buffer) continue;
-        const std::string &line = lines[line_idx];
-        hb_buffer_add_utf8(buffer, line.c_str(), (int)line.size(), 0, (int)line.size());
-        hb_buffer_guess_segment_properties(buffer);
-        hb_shape(g_hb_text.hb_font, buffer, NULL, 0);
-
-        unsigned int glyph_count = 0;
-        hb_glyph_info_t *infos = hb_buffer_get_glyph_infos(buffer, &glyph_count);
-        hb_glyph_position_t *positions = hb_buffer_get_glyph_positions(buffer, &glyph_count);
-        int pen_x = 0;
-        int pen_y = 0;
-        const int line_off_y = (int)line_idx * line_height;
-
-        for (unsigned int i = 0; i < glyph_count; ++i) {
-            const hb_codepoint_t gid = infos[i].codepoint;
-            if (FT_Load_Glyph(g_hb_text.ft_face, (FT_UInt)gid, FT_LOAD_DEFAULT) == 0 &&
-                FT_Render_Glyph(g_hb_text.ft_face->glyph, FT_RENDER_MODE_NORMAL) == 0) {
-                const FT_GlyphSlot slot = g_hb_text.ft_face->glyph;
-                const int gx = fixed26_6_floor(pen_x + positions[i].x_offset) + slot->bitmap_left;
-                const int gy = line_off_y + ascender - fixed26_6_floor(pen_y + positions[i].y_offset) - slot->bitmap_top;
-                const int gw = (int)slot->bitmap.width;
-                const int gh = (int)slot->bitmap.rows;
-                if (gw > 0 && gh > 0) {
-                    if (!have_bounds) {
-                        min_x = gx;
-                        min_y = gy;
-                        max_x = gx + gw;
-                        max_y = gy + gh;
-                        have_bounds = true;
-                    } else {
-                        if (gx < min_x) min_x = gx;
-                        if (gy < min_y) min_y = gy;
-                        if (gx + gw > max_x) max_x = gx + gw;
-                        if (gy + gh > max_y) max_y = gy + gh;
-                    }
-                    glyphs.push_back({gid, gx, gy});
-                }
-            }
-            pen_x += positions[i].x_advance;
-            pen_y += positions[i].y_advance;
-        }
-        hb_buffer_destroy(buffer);
-    }
-
-    if (!have_bounds) return false;
-    const int w = std::max(1, max_x - min_x);
-    const int h = std::max(1, max_y - min_y);
-    out_alpha->assign((size_t)w * (size_t)h, 0);
-
-    for (const HbGlyphPlacement &g : glyphs) {
-        if (FT_Load_Glyph(g_hb_text.ft_face, (FT_UInt)g.gid, FT_LOAD_DEFAULT) != 0) continue;
-        if (FT_Render_Glyph(g_hb_text.ft_face->glyph, FT_RENDER_MODE_NORMAL) != 0) continue;
-        const FT_Bitmap &bm = g_hb_text.ft_face->glyph->bitmap;
-        for (int row = 0; row < (int)bm.rows; ++row) {
-            const uint8_t *src = bm.buffer + row * bm.pitch;
-            const int dy = g.y - min_y + row;
-            if (dy < 0 || dy >= h) continue;
-            for (int col = 0; col < (int)bm.width; ++col) {
-                const int dx = g.x - min_x + col;
-                if (dx < 0 || dx >= w) continue;
-                uint8_t &dst = (*out_alpha)[(size_t)dy * (size_t)w + (size_t)dx];
-                const uint8_t sv = src[col];
-                if (sv > dst) dst = sv;
-            }
-        }
-    }
-
-    *out_w = w;
-    *out_h = h;
-    *out_off_x = min_x;
-    *out_off_y = min_y;
-    return true;
-}
-
-static std::string hb_text_cache_key(const char *text, float font_px) {
-    const int px = (int)std::lround(font_px);
-    std::string k = std::to_string(px);
-    k.push_back('\n');
-    k.append(text ? text : "");
-    return k;
-}
-
-static HbTextCacheEntry *get_or_create_hb_text_entry(const char *text, float font_px) {
-    if (!text || !text[0]) return nullptr;
-    const std::string key = hb_text_cache_key(text, font_px);
-    auto it = g_hb_text.cache.find(key);
-    if (it != g_hb_text.cache.end()) {
-        it->second.last_use = ++g_hb_text.use_stamp;
-        return &it->second;
-    }
-
-    std::vector<uint8_t> alpha;
-    int w = 0, h = 0, off_x = 0, off_y = 0;
-    if (!rasterize_text_hb(text, (int)std::lround(font_px), &alpha, &w, &h, &off_x, &off_y)) return nullptr;
-
-    GLuint tex = 0;
-    glGenTextures(1, &tex);
-    if (tex == 0) return nullptr;
-    glBindTexture(GL_TEXTURE_2D, tex);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, w, h, 0, GL_ALPHA, GL_UNSIGNED_BYTE, alpha.data());
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    HbTextCacheEntry entry = {};
-    entry.texture = tex;
-    entry.width = w;
-    entry.height = h;
-    entry.offset_x = off_x;
-    entry.offset_y = off_y;
-    entry.last_use = ++g_hb_text.use_stamp;
-    auto inserted = g_hb_text.cache.emplace(key, entry);
-    if (!inserted.second) {
-        glDeleteTextures(1, &tex);
-        return nullptr;
-    }
-
-    if (g_hb_text.cache.size() > kHbTextCacheLimit) {
-        auto evict_it = g_hb_text.cache.begin();
-        for (auto jt = g_hb_text.cache.begin(); jt != g_hb_text.cache.end(); ++jt) {
-            if (jt->second.last_use < evict_it->second.last_use) evict_it = jt;
-        }
-        if (evict_it != g_hb_text.cache.end()) {
-            if (evict_it->second.texture != 0) glDeleteTextures(1, &evict_it->second.texture);
-            g_hb_text.cache.erase(evict_it);
-        }
-    }
-    return &inserted.first->second;
-}
-#endif
-
-static const VicadBakedGlyph *glyph_for_char(unsigned char ch) {
-    if (ch < VICAD_BAKED_FIRST_CHAR || ch > VICAD_BAKED_LAST_CHAR) ch = '?';
-    return &vicad_baked_glyphs[ch - VICAD_BAKED_FIRST_CHAR];
-}
+// Vertex buffers of every mesh drawn; see retain_gpu_meshes in AppRunLoop.
+static vicad_renderer3d::MeshBufferCache g_mesh_buffers;
+// Last drawn 3D viewport, reused by frames with only UI damage.
+static vicad_renderer3d::ViewportLayerCache g_viewport_layer;
+// Feature and non-manifold edges of the merged mesh, in view-culling chunk order.
+static vicad_renderer3d::EdgeLineBuffer g_feature_edge_lines;
+static vicad_renderer3d::EdgeLineBuffer g_non_manifold_edge_lines;
 
 static float text_width_for_slice(Clay_StringSlice text, float font_px) {
     if (text.length <= 0 || !text.chars || font_px <= 0.0f) return 0.0f;
-#ifdef VICAD_HAS_HARFBUZZ
-    std::string s(text.chars, (size_t)text.length);
-    std::vector<uint8_t> alpha;
-    int w = 0, h = 0, off_x = 0, off_y = 0;
-    if (rasterize_text_hb(s.c_str(), (int)std::lround(font_px), &alpha, &w, &h, &off_x, &off_y)) {
-        (void)off_y;
-        return (float)(off_x + w);
-    }
-#endif
-    const float scale = font_px / (float)VICAD_BAKED_PIXEL_SIZE;
-    float width = 0.0f;
-    float line_width = 0.0f;
-    for (int i = 0; i < text.length; ++i) {
-        const unsigned char ch = (unsigned char)text.chars[i];
-        if (ch == '\n') {
-            if (line_width > width) width = line_width;
-            line_width = 0.0f;
-            continue;
-        }
-        line_width += (float)glyph_for_char(ch)->advance * scale;
-    }
-    if (line_width > width) width = line_width;
-    return width;
+    return g_text.Measure(std::string_view(text.chars, (size_t)text.length), font_px).width;
 }
 
 static float text_width_for_cstr(const char *text, float font_px) {
@@ -419,34 +158,9 @@ static float text_width_for_cstr(const char *text, float font_px) {
 static Clay_Dimensions measure_text_mono(Clay_StringSlice text, Clay_TextElementConfig *config, void *userData) {
     (void)userData;
     const float font_px = (float)(config ? config->fontSize : 16);
-#ifdef VICAD_HAS_HARFBUZZ
-    if (text.length > 0 && text.chars && font_px > 0.0f && ensure_hb_text_state()) {
-        if (FT_Set_Pixel_Sizes(g_hb_text.ft_face, 0, (FT_UInt)std::lround(font_px)) == 0) {
-            hb_ft_font_changed(g_hb_text.hb_font);
-        }
-        const int hb_line_height = std::max(1, (int)(g_hb_text.ft_face->size->metrics.height >> 6));
-        std::string s(text.chars, (size_t)text.length);
-        std::vector<uint8_t> alpha;
-        int w = 0, h = 0, off_x = 0, off_y = 0;
-        if (rasterize_text_hb(s.c_str(), (int)std::lround(font_px), &alpha, &w, &h, &off_x, &off_y)) {
-            (void)off_x;
-            (void)off_y;
-            int lines = 1;
-            for (int i = 0; i < text.length; ++i) {
-                if (text.chars && text.chars[i] == '\n') lines += 1;
-            }
-            return (Clay_Dimensions){(float)w, (float)(hb_line_height * lines)};
-        }
-    }
-#endif
-    const float scale = font_px / (float)VICAD_BAKED_PIXEL_SIZE;
-    const float width = text_width_for_slice(text, font_px);
-    int lines = 1;
-    for (int i = 0; i < text.length; ++i) {
-        if (text.chars && text.chars[i] == '\n') lines += 1;
-    }
-    const float height = (float)VICAD_BAKED_LINE_HEIGHT * scale * (float)lines;
-    return (Clay_Dimensions){width, height};
+    if (text.length <= 0 || !text.chars || font_px <= 0.0f) return (Clay_Dimensions){0.0f, 0.0f};
+    const vicad_text::TextMetrics m = g_text.Measure(std::string_view(text.chars, (size_t)text.length), font_px);
+    return (Clay_Dimensions){m.width, m.height};
 }
 
 static void clay_error_handler(Clay_ErrorData errorData) {
@@ -468,59 +182,28 @@ static void clay_init(i32 width, i32 height) {
     g_ui.initialized = true;
 }
 
-static float clay_color_chan(float c) {
-    float v = c / 255.0f;
-    if (v < 0.0f) v = 0.0f;
-    if (v > 1.0f) v = 1.0f;
-    return v;
-}
-
-static bool ensure_baked_font_texture(void) {
-    if (g_baked_font.initialized) return true;
-    glGenTextures(1, &g_baked_font.texture);
-    if (g_baked_font.texture == 0) return false;
-
-    glBindTexture(GL_TEXTURE_2D, g_baked_font.texture);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexImage2D(GL_TEXTURE_2D,
-                 0,
-                 GL_ALPHA,
-                 VICAD_BAKED_ATLAS_WIDTH,
-                 VICAD_BAKED_ATLAS_HEIGHT,
-                 0,
-                 GL_ALPHA,
-                 GL_UNSIGNED_BYTE,
-                 vicad_baked_atlas);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    g_baked_font.initialized = true;
-    return true;
+static uint8_t clay_color_byte(float c) {
+    if (c < 0.0f) c = 0.0f;
+    if (c > 255.0f) c = 255.0f;
+    return (uint8_t)std::lround(c);
 }
 
-static void draw_text_5x7(float x, float y, float scale, const char *text, float r, float g, float b);
-static void draw_text_from_slice(float x, float y, float scale, Clay_StringSlice s, float r, float g, float b);
-static void draw_text_baked_world(const Vec3 &origin,
-                                  const Vec3 &axis_right,
-                                  const Vec3 &axis_up,
-                                  float world_scale, const char *text,
-                                  float r, float g, float b, float a);
+static void clay_color_rgba(Clay_Color c, uint8_t out[4]) {
+    out[0] = clay_color_byte(c.r);
+    out[1] = clay_color_byte(c.g);
+    out[2] = clay_color_byte(c.b);
+    out[3] = clay_color_byte(c.a);
+}
 
+// The whole UI goes through one streaming batch: rectangles, borders and
+// glyph quads in command order, cut into draws only at scissor or atlas page
+// changes.
 static void clay_render_commands(Clay_RenderCommandArray cmds, i32 pixel_width, i32 pixel_height, float ui_scale) {
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glLoadIdentity();
-    glOrtho(0, pixel_width, pixel_height, 0, -1, 1);
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-    glLoadIdentity();
-    glScalef(ui_scale, ui_scale, 1.0f);
-
-    glDisable(GL_LIGHTING);
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
-    glDisable(GL_SCISSOR_TEST);
+    float solid_u = 0.0f;
+    float solid_v = 0.0f;
+    vicad_text::TextRenderer::SolidTexel(&solid_u, &solid_v);
+    g_ui_batch.Begin(g_text.SolidTexture(), solid_u, solid_v);
+    std::vector<vicad_text::TextQuad> &glyphs = g_ui_glyph_scratch;
 
     for (int i = 0; i < cmds.length; ++i) {
         Clay_RenderCommand *cmd = Clay_RenderCommandArray_Get(&cmds, i);
@@ -534,60 +217,66 @@ static void clay_render_commands(Clay_RenderCommandArray cmds, i32 pixel_width,
 
         switch (cmd->commandType) {
             case CLAY_RENDER_COMMAND_TYPE_RECTANGLE: {
-                const Clay_Color c = cmd->renderData.rectangle.backgroundColor;
-                glColor4f(clay_color_chan(c.r), clay_color_chan(c.g), clay_color_chan(c.b), clay_color_chan(c.a));
-                glBegin(GL_QUADS);
-                glVertex2f(x0, y0); glVertex2f(x1, y0); glVertex2f(x1, y1); glVertex2f(x0, y1);
-                glEnd();
+                uint8_t rgba[4];
+                clay_color_rgba(cmd->renderData.rectangle.backgroundColor, rgba);
+                g_ui_batch.AddRect(x0, y0, x1, y1, rgba);
             } break;
             case CLAY_RENDER_COMMAND_TYPE_BORDER: {
-                const Clay_Color c = cmd->renderData.border.color;
+                uint8_t rgba[4];
+                clay_color_rgba(cmd->renderData.border.color, rgba);
                 const Clay_BorderWidth w = cmd->renderData.border.width;
-                glColor4f(clay_color_chan(c.r), clay_color_chan(c.g), clay_color_chan(c.b), clay_color_chan(c.a));
-                glBegin(GL_QUADS);
-                if (w.left > 0) {
-                    glVertex2f(x0, y0); glVertex2f(x0 + w.left, y0); glVertex2f(x0 + w.left, y1); glVertex2f(x0, y1);
-                }
-                if (w.right > 0) {
-                    glVertex2f(x1 - w.right, y0); glVertex2f(x1, y0); glVertex2f(x1, y1); glVertex2f(x1 - w.right, y1);
-                }
-                if (w.top > 0) {
-                    glVertex2f(x0, y0); glVertex2f(x1, y0); glVertex2f(x1, y0 + w.top); glVertex2f(x0, y0 + w.top);
-                }
-                if (w.bottom > 0) {
-                    glVertex2f(x0, y1 - w.bottom); glVertex2f(x1, y1 - w.bottom); glVertex2f(x1, y1); glVertex2f(x0, y1);
-                }
-                glEnd();
+                if (w.left > 0) g_ui_batch.AddRect(x0, y0, x0 + w.left, y1, rgba);
+                if (w.right > 0) g_ui_batch.AddRect(x1 - w.right, y0, x1, y1, rgba);
+                if (w.top > 0) g_ui_batch.AddRect(x0, y0, x1, y0 + w.top, rgba);
+                if (w.bottom > 0) g_ui_batch.AddRect(x0, y1 - w.bottom, x1, y1, rgba);
             } break;
             case CLAY_RENDER_COMMAND_TYPE_TEXT: {
                 const Clay_TextRenderData t = cmd->renderData.text;
-                float sf = (float)t.fontSize / 7.0f;
-                if (sf < 1.0f) sf = 1.0f;
-                if (sf > 8.0f) sf = 8.0f;
-                draw_text_from_slice(
-                    x0, y0,
-                    sf, t.stringContents,
-                    clay_color_chan(t.textColor.r),
-                    clay_color_chan(t.textColor.g),
-                    clay_color_chan(t.textColor.b));
+                if (t.stringContents.length <= 0 || !t.stringContents.chars) break;
+                const float font_px = vicad_app::clampf((float)t.fontSize, 7.0f, 56.0f);
+                const uint8_t rgba[4] = {
+                    clay_color_byte(t.textColor.r), clay_color_byte(t.textColor.g), clay_color_byte(t.textColor.b), 255,
+                };
+                glyphs.clear();
+                g_text.AppendScreenQuads(x0, y0, font_px,
+                                         std::string_view(t.stringContents.chars, (size_t)t.stringContents.length),
+                                         &glyphs);
+                for (const vicad_text::TextQuad &q : glyphs) {
+                    g_ui_batch.AddTexturedRect(q.texture, q.x0, q.y0, q.x1, q.y1, q.u0, q.v0, q.u1, q.v1, rgba);
+                }
             } break;
             case CLAY_RENDER_COMMAND_TYPE_SCISSOR_START: {
-                const int sx = (int)std::lround(box.x * ui_scale);
-                const int sy = pixel_height - (int)std::lround((box.y + box.height) * ui_scale);
-                const int sw = (int)std::lround(box.width * ui_scale);
-                const int sh = (int)std::lround(box.height * ui_scale);
-                glEnable(GL_SCISSOR_TEST);
-                glScissor(sx, sy, sw, sh);
+                vicad_renderer_overlay::UiScissor scissor;
+                scissor.enabled = true;
+                scissor.x = (int)std::lround(box.x * ui_scale);
+                scissor.y = pixel_height - (int)std::lround((box.y + box.height) * ui_scale);
+                scissor.w = (int)std::lround(box.width * ui_scale);
+                scissor.h = (int)std::lround(box.height * ui_scale);
+                g_ui_batch.SetScissor(scissor);
             } break;
             case CLAY_RENDER_COMMAND_TYPE_SCISSOR_END:
-                glDisable(GL_SCISSOR_TEST);
+                g_ui_batch.SetScissor(vicad_renderer_overlay::UiScissor());
                 break;
             default:
                 break;
         }
     }
 
-    glDisable(GL_SCISSOR_TEST);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, pixel_width, pixel_height, 0, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    glScalef(ui_scale, ui_scale, 1.0f);
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+
+    g_ui_batch.Draw();
+
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
 
@@ -716,43 +405,80 @@ static void draw_grid(const Vec3 &target, float distance, float fov_degrees, i32
     glEnd();
 }
 
-static void draw_mesh(const manifold::MeshGL &mesh) {
+// Buffer of a mesh, uploaded with the normals of its MeshDerived when the
+// caller keeps one (a scene object's mesh) and computing them otherwise.
+static const vicad_renderer3d::GpuMesh *gpu_mesh(const manifold::MeshGL &mesh, const vicad::MeshDerived *derived) {
+    return derived ? g_mesh_buffers.Get(mesh, *derived) : g_mesh_buffers.Get(mesh);
+}
+
+static void draw_mesh(const manifold::MeshGL &mesh, const vicad::MeshDerived *derived = nullptr) {
+    const vicad_renderer3d::GpuMesh *gpu = gpu_mesh(mesh, derived);
+    if (!gpu) return;
     glEnable(GL_LIGHTING);
     glEnable(GL_POLYGON_OFFSET_FILL);
     glPolygonOffset(1.0f, 1.0f);
     glColor3f(0.69f, 0.65f, 0.61f);
-    glBegin(GL_TRIANGLES);
-    for (size_t tri = 0; tri < mesh.NumTri(); ++tri) {
-        const size_t i0 = mesh.triVerts[tri * 3 + 0];
-        const size_t i1 = mesh.triVerts[tri * 3 + 1];
-        const size_t i2 = mesh.triVerts[tri * 3 + 2];
-
-        const Vec3 p0 = {
-            mesh.vertProperties[i0 * mesh.numProp + 0],
-            mesh.vertProperties[i0 * mesh.numProp + 1],
-            mesh.vertProperties[i0 * mesh.numProp + 2],
-        };
-        const Vec3 p1 = {
-            mesh.vertProperties[i1 * mesh.numProp + 0],
-            mesh.vertProperties[i1 * mesh.numProp + 1],
-            mesh.vertProperties[i1 * mesh.numProp + 2],
-        };
-        const Vec3 p2 = {
-            mesh.vertProperties[i2 * mesh.numProp + 0],
-            mesh.vertProperties[i2 * mesh.numProp + 1],
-            mesh.vertProperties[i2 * mesh.numProp + 2],
-        };
+    vicad_renderer3d::DrawMesh(*gpu);
+    glDisable(GL_POLYGON_OFFSET_FILL);
+}
 
-        const Vec3 n = normalize(cross(sub(p1, p0), sub(p2, p0)));
-        glNormal3f(n.x, n.y, n.z);
-        glVertex3f(p0.x, p0.y, p0.z);
-        glVertex3f(p1.x, p1.y, p1.z);
-        glVertex3f(p2.x, p2.y, p2.z);
-    }
-    glEnd();
+// Several objects sharing instance geometry, drawn from one vertex buffer.
+static void draw_mesh_instances(const manifold::MeshGL &mesh, const vicad::MeshDerived &derived,
+                                const std::vector<vicad_renderer3d::MeshInstance> &instances) {
+    const vicad_renderer3d::GpuMesh *gpu = g_mesh_buffers.Get(mesh, derived);
+    if (!gpu) return;
+    glEnable(GL_LIGHTING);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(1.0f, 1.0f);
+    glColor3f(0.69f, 0.65f, 0.61f);
+    vicad_renderer3d::DrawMeshInstances(*gpu, instances);
     glDisable(GL_POLYGON_OFFSET_FILL);
 }
 
+static vicad_renderer3d::MeshInstance scene_object_mesh_instance(const vicad::ScriptSceneObject &obj) {
+    const manifold::mat3x4 &m = obj.instanceTransform;
+    vicad_renderer3d::MeshInstance inst = {};
+    for (int c = 0; c < 4; ++c) {
+        inst.model[c * 4 + 0] = m[c].x;
+        inst.model[c * 4 + 1] = m[c].y;
+        inst.model[c * 4 + 2] = m[c].z;
+        inst.model[c * 4 + 3] = c == 3 ? 1.0 : 0.0;
+    }
+    const double det = m[0].x * (m[1].y * m[2].z - m[1].z * m[2].y) -
+                       m[1].x * (m[0].y * m[2].z - m[0].z * m[2].y) +
+                       m[2].x * (m[0].y * m[1].z - m[0].z * m[1].y);
+    inst.mirrored = det < 0.0;
+    return inst;
+}
+
+// Pixels of viewport height covered by an object's bounding sphere.
+static float object_screen_px(const vicad::ScriptSceneObject &obj, const Vec3 &eye, float fov_degrees,
+                              int viewport_h) {
+    const Vec3 bmin = {obj.bmin.x, obj.bmin.y, obj.bmin.z};
+    const Vec3 bmax = {obj.bmax.x, obj.bmax.y, obj.bmax.z};
+    const Vec3 half = mul(sub(bmax, bmin), 0.5f);
+    const Vec3 to_center = sub(add(bmin, half), eye);
+    const float radius = std::sqrt(dot(half, half));
+    const float dist = std::sqrt(dot(to_center, to_center));
+    if (dist <= radius) return std::numeric_limits<float>::infinity();
+    const float tan_half_fov = std::tan((fov_degrees * 3.1415926535f / 180.0f) * 0.5f);
+    return radius / (dist * tan_half_fov) * (float)viewport_h;
+}
+
+// Render level to draw a manifold object at this frame (0 is the full mesh),
+// remembered on the object for the next frame's hysteresis. While the camera
+// moves, objects are drawn as if half their size and the choice is not
+// remembered, so the settled frame picks up where the last one left off.
+static int scene_object_lod(const vicad::ScriptSceneObject &obj, const Vec3 &eye, float fov_degrees,
+                            int viewport_h, bool interacting) {
+    const vicad::MeshLodChain *chain = obj.instance ? obj.instance->lodChain.get() : obj.lodChain.get();
+    if (!chain || chain->levels.empty()) return obj.lodShown = 0;
+    const float screen_px = object_screen_px(obj, eye, fov_degrees, viewport_h);
+    if (interacting) return vicad::SelectMeshLod(*chain, screen_px * 0.5f, obj.lodShown);
+    obj.lodShown = vicad::SelectMeshLod(*chain, screen_px, obj.lodShown);
+    return obj.lodShown;
+}
+
 static Vec3 mesh_vertex(const manifold::MeshGL &mesh, uint32_t idx) {
     return {
         mesh.vertProperties[(size_t)idx * mesh.numProp + 0],
@@ -761,21 +487,6 @@ static Vec3 mesh_vertex(const manifold::MeshGL &mesh, uint32_t idx) {
     };
 }
 
-static void draw_edge_indices(const manifold::MeshGL &mesh,
-                              const vicad::EdgeDetectionResult &edge_result,
-                              const std::vector<int> &indices) {
-    glBegin(GL_LINES);
-    for (const int idx : indices) {
-        if (idx < 0 || (size_t)idx >= edge_result.edges.size()) continue;
-        const vicad::EdgeRecord &e = edge_result.edges[(size_t)idx];
-        const Vec3 p0 = mesh_vertex(mesh, e.v0);
-        const Vec3 p1 = mesh_vertex(mesh, e.v1);
-        glVertex3f(p0.x, p0.y, p0.z);
-        glVertex3f(p1.x, p1.y, p1.z);
-    }
-    glEnd();
-}
-
 static void begin_edge_overlay_lines() {
     glDisable(GL_LIGHTING);
     glEnable(GL_BLEND);
@@ -790,30 +501,79 @@ static void end_edge_overlay_lines() {
     glDisable(GL_BLEND);
 }
 
-static void draw_feature_edges(const manifold::MeshGL &mesh,
-                               const vicad::EdgeDetectionResult &edge_result) {
+// Segments for an edge line buffer, with the adjacent face normals the
+// silhouette shader classifies by; boundary edges get none.
+static std::vector<vicad_renderer3d::EdgeSegment> edge_segments(const manifold::MeshGL &mesh,
+                                                                const vicad::EdgeDetectionResult &edge_result,
+                                                                const std::vector<int> &indices) {
+    std::vector<vicad_renderer3d::EdgeSegment> out;
+    out.reserve(indices.size());
+    for (const int idx : indices) {
+        if (idx < 0 || (size_t)idx >= edge_result.edges.size()) continue;
+        const vicad::EdgeRecord &e = edge_result.edges[(size_t)idx];
+        const Vec3 p0 = mesh_vertex(mesh, e.v0);
+        const Vec3 p1 = mesh_vertex(mesh, e.v1);
+        vicad_renderer3d::EdgeSegment seg = {{p0.x, p0.y, p0.z}, {p1.x, p1.y, p1.z}, {0, 0, 0}, {0, 0, 0}};
+        const bool two_sided = e.triA >= 0 && e.triB >= 0 &&
+                               std::isfinite(e.nA.x) && std::isfinite(e.nA.y) && std::isfinite(e.nA.z) &&
+                               std::isfinite(e.nB.x) && std::isfinite(e.nB.y) && std::isfinite(e.nB.z);
+        if (two_sided) {
+            seg.normal_a[0] = (float)e.nA.x;
+            seg.normal_a[1] = (float)e.nA.y;
+            seg.normal_a[2] = (float)e.nA.z;
+            seg.normal_b[0] = (float)e.nB.x;
+            seg.normal_b[1] = (float)e.nB.y;
+            seg.normal_b[2] = (float)e.nB.z;
+        }
+        out.push_back(seg);
+    }
+    return out;
+}
+
+// Ranges are the view-culled chunks of g_feature_edge_lines and
+// g_non_manifold_edge_lines.
+static void draw_feature_edges(const std::vector<vicad_renderer3d::EdgeRange> &feature_ranges,
+                               const std::vector<vicad_renderer3d::EdgeRange> &non_manifold_ranges) {
     begin_edge_overlay_lines();
 
     glLineWidth(2.4f);
     glColor4f(0.05f, 0.13f, 0.20f, 0.96f);
-    draw_edge_indices(mesh, edge_result, edge_result.featureEdgeIndices);
+    g_feature_edge_lines.Draw(feature_ranges);
 
     glLineWidth(2.8f);
     glColor4f(0.98f, 0.38f, 0.30f, 0.98f);
-    draw_edge_indices(mesh, edge_result, edge_result.nonManifoldEdgeIndices);
+    g_non_manifold_edge_lines.Draw(non_manifold_ranges);
 
     glLineWidth(1.0f);
     end_edge_overlay_lines();
 }
 
+// Silhouettes are classified on the GPU from the feature edge buffer. Only
+// without shader support does `silhouette` hold a CPU classification, culled
+// here per segment.
 static void draw_silhouette_edges(const manifold::MeshGL &mesh,
                                   const vicad::EdgeDetectionResult &edge_result,
-                                  const vicad::SilhouetteResult &silhouette) {
-    if (silhouette.silhouetteEdgeIndices.empty()) return;
+                                  const vicad::SilhouetteResult &silhouette,
+                                  const Vec3 &eye,
+                                  const vicad_cull::ViewFrustum &frustum,
+                                  const std::vector<vicad_renderer3d::EdgeRange> &feature_ranges) {
     begin_edge_overlay_lines();
     glLineWidth(2.6f);
     glColor4f(0.04f, 0.08f, 0.12f, 0.98f);
-    draw_edge_indices(mesh, edge_result, silhouette.silhouetteEdgeIndices);
+    const float eye_xyz[3] = {eye.x, eye.y, eye.z};
+    if (!g_feature_edge_lines.DrawSilhouettes(eye_xyz, feature_ranges)) {
+        glBegin(GL_LINES);
+        for (const int idx : silhouette.silhouetteEdgeIndices) {
+            if (idx < 0 || (size_t)idx >= edge_result.edges.size()) continue;
+            const vicad::EdgeRecord &e = edge_result.edges[(size_t)idx];
+            const Vec3 p0 = mesh_vertex(mesh, e.v0);
+            const Vec3 p1 = mesh_vertex(mesh, e.v1);
+            if (!vicad_cull::SegmentInFrustum(frustum, p0, p1)) continue;
+            glVertex3f(p0.x, p0.y, p0.z);
+            glVertex3f(p1.x, p1.y, p1.z);
+        }
+        glEnd();
+    }
     glLineWidth(1.0f);
     end_edge_overlay_lines();
 }
@@ -863,6 +623,8 @@ static void draw_face_region_overlay(const manifold::MeshGL &mesh,
 
     const std::vector<uint32_t> &tris = faces.regions[(size_t)region];
     if (tris.empty()) return;
+    const vicad_renderer3d::GpuMesh *gpu = g_mesh_buffers.Get(mesh);
+    if (!gpu) return;
 
     glDisable(GL_LIGHTING);
     glEnable(GL_BLEND);
@@ -871,41 +633,16 @@ static void draw_face_region_overlay(const manifold::MeshGL &mesh,
     glEnable(GL_POLYGON_OFFSET_FILL);
     glPolygonOffset(-1.0f, -1.0f);
     glColor4f(r, g, b, a);
-
-    glBegin(GL_TRIANGLES);
-    for (const uint32_t tri : tris) {
-        const size_t i0 = mesh.triVerts[tri * 3 + 0];
-        const size_t i1 = mesh.triVerts[tri * 3 + 1];
-        const size_t i2 = mesh.triVerts[tri * 3 + 2];
-        const Vec3 p0 = {
-            mesh.vertProperties[i0 * mesh.numProp + 0],
-            mesh.vertProperties[i0 * mesh.numProp + 1],
-            mesh.vertProperties[i0 * mesh.numProp + 2],
-        };
-        const Vec3 p1 = {
-            mesh.vertProperties[i1 * mesh.numProp + 0],
-            mesh.vertProperties[i1 * mesh.numProp + 1],
-            mesh.vertProperties[i1 * mesh.numProp + 2],
-        };
-        const Vec3 p2 = {
-            mesh.vertProperties[i2 * mesh.numProp + 0],
-            mesh.vertProperties[i2 * mesh.numProp + 1],
-            mesh.vertProperties[i2 * mesh.numProp + 2],
-        };
-        glVertex3f(p0.x, p0.y, p0.z);
-        glVertex3f(p1.x, p1.y, p1.z);
-        glVertex3f(p2.x, p2.y, p2.z);
-    }
-    glEnd();
-
+    vicad_renderer3d::DrawMeshTriangles(*gpu, tris);
     glDisable(GL_POLYGON_OFFSET_FILL);
     glDepthMask(GL_TRUE);
     glDisable(GL_BLEND);
 }
 
-static void draw_mesh_selection_overlay(const manifold::MeshGL &mesh,
+static void draw_mesh_selection_overlay(const manifold::MeshGL &mesh, const vicad::MeshDerived *derived,
                                         float r, float g, float b, float a) {
-    if (mesh.NumTri() == 0) return;
+    const vicad_renderer3d::GpuMesh *gpu = gpu_mesh(mesh, derived);
+    if (!gpu) return;
 
     glDisable(GL_LIGHTING);
     glEnable(GL_BLEND);
@@ -914,34 +651,7 @@ static void draw_mesh_selection_overlay(const manifold::MeshGL &mesh,
     glEnable(GL_POLYGON_OFFSET_FILL);
     glPolygonOffset(-1.0f, -1.0f);
     glColor4f(r, g, b, a);
-
-    glBegin(GL_TRIANGLES);
-    for (size_t tri = 0; tri < mesh.NumTri(); ++tri) {
-        const size_t i0 = mesh.triVerts[tri * 3 + 0];
-        const size_t i1 = mesh.triVerts[tri * 3 + 1];
-        const size_t i2 = mesh.triVerts[tri * 3 + 2];
-
-        const Vec3 p0 = {
-            mesh.vertProperties[i0 * mesh.numProp + 0],
-            mesh.vertProperties[i0 * mesh.numProp + 1],
-            mesh.vertProperties[i0 * mesh.numProp + 2],
-        };
-        const Vec3 p1 = {
-            mesh.vertProperties[i1 * mesh.numProp + 0],
-            mesh.vertProperties[i1 * mesh.numProp + 1],
-            mesh.vertProperties[i1 * mesh.numProp + 2],
-        };
-        const Vec3 p2 = {
-            mesh.vertProperties[i2 * mesh.numProp + 0],
-            mesh.vertProperties[i2 * mesh.numProp + 1],
-            mesh.vertProperties[i2 * mesh.numProp + 2],
-        };
-        glVertex3f(p0.x, p0.y, p0.z);
-        glVertex3f(p1.x, p1.y, p1.z);
-        glVertex3f(p2.x, p2.y, p2.z);
-    }
-    glEnd();
-
+    vicad_renderer3d::DrawMeshUnlit(*gpu);
     glDisable(GL_POLYGON_OFFSET_FILL);
     glDepthMask(GL_TRUE);
     glDisable(GL_BLEND);
@@ -1049,16 +759,6 @@ static void draw_script_sketches(const std::vector<vicad::ScriptSceneObject> &sc
     glEnable(GL_DEPTH_TEST);
 }
 
-enum class SketchDimShapeKind {
-    Unknown,
-    Point,
-    Circle,
-    Rectangle,
-    Square,
-    RegularPolygon,
-    Polygon,
-};
-
 using vicad_app::add2;
 using vicad_app::sub2v;
 using vicad_app::mul2;
@@ -1068,249 +768,6 @@ using vicad_app::normalize2;
 using vicad_app::perp2;
 using vicad_app::vec3_from_2d;
 
-static void contour_plane_axes(const vicad::ScriptSketchContour &contour,
-                               Vec3 *out_right,
-                               Vec3 *out_up,
-                               Vec3 *out_normal) {
-    Vec3 right = {1.0f, 0.0f, 0.0f};
-    Vec3 up = {0.0f, 1.0f, 0.0f};
-    Vec3 normal = {0.0f, 0.0f, 1.0f};
-    if (contour.points.size() >= 2) {
-        const auto to_v3 = [](const vicad::SceneVec3 &p) {
-            return Vec3{p.x, p.y, p.z};
-        };
-        const Vec3 p0 = to_v3(contour.points[0]);
-        bool found_right = false;
-        for (size_t i = 1; i < contour.points.size(); ++i) {
-            const Vec3 e = sub(to_v3(contour.points[i]), p0);
-            if (dot(e, e) > 1e-10f) {
-                right = normalize(e);
-                found_right = true;
-                break;
-            }
-        }
-        if (found_right) {
-            bool found_normal = false;
-            for (size_t i = 1; i < contour.points.size(); ++i) {
-                const Vec3 e = sub(to_v3(contour.points[i]), p0);
-                const Vec3 n = cross(right, e);
-                if (dot(n, n) > 1e-10f) {
-                    normal = normalize(n);
-                    found_normal = true;
-                    break;
-                }
-            }
-            if (!found_normal) {
-                const Vec3 fallback_up = std::fabs(right.z) < 0.95f
-                    ? Vec3{0.0f, 0.0f, 1.0f}
-                    : Vec3{0.0f, 1.0f, 0.0f};
-                normal = normalize(cross(right, fallback_up));
-            }
-            up = normalize(cross(normal, right));
-        }
-    }
-    if (out_right) *out_right = right;
-    if (out_up) *out_up = up;
-    if (out_normal) *out_normal = normal;
-}
-
-static float contour_signed_area(const std::vector<Vec2> &pts) {
-    const size_t n = pts.size();
-    if (n < 3) return 0.0f;
-    double a = 0.0;
-    for (size_t i = 0; i < n; ++i) {
-        const Vec2 &p0 = pts[i];
-        const Vec2 &p1 = pts[(i + 1) % n];
-        a += (double)p0.x * (double)p1.y - (double)p1.x * (double)p0.y;
-    }
-  return (float)(0.5 * a);
-}
-
-static float contour_projected_area3d(const vicad::ScriptSketchContour &contour) {
-    const size_t n = contour.points.size();
-    if (n < 3) return 0.0f;
-    Vec3 area_vec = {0.0f, 0.0f, 0.0f};
-    for (size_t i = 0; i < n; ++i) {
-        const vicad::SceneVec3 &a = contour.points[i];
-        const vicad::SceneVec3 &b = contour.points[(i + 1) % n];
-        area_vec = add(area_vec, cross({a.x, a.y, a.z}, {b.x, b.y, b.z}));
-    }
-    return 0.5f * std::sqrt(dot(area_vec, area_vec));
-}
-
-static void contour_bbox(const std::vector<Vec2> &pts, Vec2 *mn, Vec2 *mx) {
-    Vec2 bmin = {0.0f, 0.0f};
-    Vec2 bmax = {0.0f, 0.0f};
-    if (!pts.empty()) {
-        bmin = pts[0];
-        bmax = pts[0];
-        for (size_t i = 1; i < pts.size(); ++i) {
-            const Vec2 &p = pts[i];
-            if (p.x < bmin.x) bmin.x = p.x;
-            if (p.y < bmin.y) bmin.y = p.y;
-            if (p.x > bmax.x) bmax.x = p.x;
-            if (p.y > bmax.y) bmax.y = p.y;
-        }
-    }
-    *mn = bmin;
-    *mx = bmax;
-}
-
-static Vec2 contour_centroid_mean(const std::vector<Vec2> &pts) {
-    if (pts.empty()) return {0.0f, 0.0f};
-    Vec2 c = {0.0f, 0.0f};
-    for (const Vec2 &p : pts) c = add2(c, p);
-    const float inv = 1.0f / (float)pts.size();
-    return mul2(c, inv);
-}
-
-static bool classify_rectangle_like(const std::vector<Vec2> &pts,
-                                    float *out_w, float *out_h) {
-    if (pts.size() != 4) return false;
-    const Vec2 e0 = sub2v(pts[1], pts[0]);
-    const Vec2 e1 = sub2v(pts[2], pts[1]);
-    const Vec2 e2 = sub2v(pts[3], pts[2]);
-    const Vec2 e3 = sub2v(pts[0], pts[3]);
-    const float l0 = length2(e0);
-    const float l1 = length2(e1);
-    const float l2 = length2(e2);
-    const float l3 = length2(e3);
-    if (l0 <= 1e-6f || l1 <= 1e-6f || l2 <= 1e-6f || l3 <= 1e-6f) return false;
-    const float orth = std::fabs(dot2(normalize2(e0), normalize2(e1)));
-    const float opp0 = std::fabs(l0 - l2) / ((l0 > l2) ? l0 : l2);
-    const float opp1 = std::fabs(l1 - l3) / ((l1 > l3) ? l1 : l3);
-    if (orth > 0.05f || opp0 > 0.05f || opp1 > 0.05f) return false;
-    *out_w = l0;
-    *out_h = l1;
-    return true;
-}
-
-static bool classify_circle_like(const std::vector<Vec2> &pts,
-                                 Vec2 *out_center, float *out_radius) {
-    const size_t n = pts.size();
-    if (n < 12) return false;
-    const Vec2 c = contour_centroid_mean(pts);
-    double sum_r = 0.0;
-    std::vector<float> rs;
-    rs.reserve(n);
-    for (const Vec2 &p : pts) {
-        const float r = length2(sub2v(p, c));
-        rs.push_back(r);
-        sum_r += (double)r;
-    }
-    const float mean_r = (float)(sum_r / (double)n);
-    if (mean_r <= 1e-6f) return false;
-    double max_dev = 0.0;
-    for (float r : rs) {
-        const double d = std::fabs((double)r - (double)mean_r);
-        if (d > max_dev) max_dev = d;
-    }
-    const double rel = max_dev / (double)mean_r;
-    if (rel > 0.03) return false;
-    *out_center = c;
-    *out_radius = mean_r;
-    return true;
-}
-
-static bool classify_rounded_rectangle_like(const std::vector<Vec2> &pts,
-                                            float *out_w, float *out_h) {
-    const size_t n = pts.size();
-    if (n < 8) return false;
-
-    Vec2 bmin = {0.0f, 0.0f};
-    Vec2 bmax = {0.0f, 0.0f};
-    contour_bbox(pts, &bmin, &bmax);
-    const float bw = bmax.x - bmin.x;
-    const float bh = bmax.y - bmin.y;
-    if (bw <= 1e-5f || bh <= 1e-5f) return false;
-
-    const float max_dim = (bw > bh) ? bw : bh;
-    const float side_tol = max_dim * 0.02f + 1e-4f;
-
-    bool touch_left = false;
-    bool touch_right = false;
-    bool touch_bottom = false;
-    bool touch_top = false;
-    for (const Vec2 &p : pts) {
-        if (std::fabs(p.x - bmin.x) <= side_tol) touch_left = true;
-        if (std::fabs(p.x - bmax.x) <= side_tol) touch_right = true;
-        if (std::fabs(p.y - bmin.y) <= side_tol) touch_bottom = true;
-        if (std::fabs(p.y - bmax.y) <= side_tol) touch_top = true;
-    }
-    if (!touch_left || !touch_right || !touch_bottom || !touch_top) return false;
-
-    // Rounded rectangles keep a meaningful amount of axis-aligned edge length.
-    double total_len = 0.0;
-    double axis_len = 0.0;
-    for (size_t i = 0; i < n; ++i) {
-        const Vec2 &a = pts[i];
-        const Vec2 &b = pts[(i + 1) % n];
-        const Vec2 e = sub2v(b, a);
-        const float len = length2(e);
-        if (len <= 1e-6f) continue;
-        total_len += (double)len;
-        const Vec2 dir = {e.x / len, e.y / len};
-        const float axis_score = std::fmax(std::fabs(dir.x), std::fabs(dir.y));
-        if (axis_score >= 0.9659f) {  // ~15 degrees from axis
-            axis_len += (double)len;
-        }
-    }
-    if (total_len <= 1e-8) return false;
-    const double axis_ratio = axis_len / total_len;
-    if (axis_ratio < 0.18) return false;
-
-    *out_w = bw;
-    *out_h = bh;
-    return true;
-}
-
-static bool classify_regular_polygon_like(const std::vector<Vec2> &pts,
-                                          Vec2 *out_center,
-                                          float *out_radius,
-                                          float *out_side) {
-    const size_t n = pts.size();
-    if (n < 3 || n > 16) return false;
-    const Vec2 c = contour_centroid_mean(pts);
-    double sum_r = 0.0;
-    std::vector<float> rs;
-    rs.reserve(n);
-    for (const Vec2 &p : pts) {
-        const float r = length2(sub2v(p, c));
-        rs.push_back(r);
-        sum_r += (double)r;
-    }
-    const float mean_r = (float)(sum_r / (double)n);
-    if (mean_r <= 1e-6f) return false;
-    double max_rel_r = 0.0;
-    for (float r : rs) {
-        const double rel = std::fabs((double)r - (double)mean_r) / (double)mean_r;
-        if (rel > max_rel_r) max_rel_r = rel;
-    }
-    if (max_rel_r > 0.03) return false;
-
-    std::vector<float> edge_lengths;
-    edge_lengths.reserve(n);
-    for (size_t i = 0; i < n; ++i) {
-        const Vec2 &a = pts[i];
-        const Vec2 &b = pts[(i + 1) % n];
-        edge_lengths.push_back(length2(sub2v(b, a)));
-    }
-    float mean_e = 0.0f;
-    for (float e : edge_lengths) mean_e += e;
-    mean_e /= (float)n;
-    if (mean_e <= 1e-6f) return false;
-    double max_rel_e = 0.0;
-    for (float e : edge_lengths) {
-        const double rel = std::fabs((double)e - (double)mean_e) / (double)mean_e;
-        if (rel > max_rel_e) max_rel_e = rel;
-    }
-    if (max_rel_e > 0.04) return false;
-    *out_center = c;
-    *out_radius = mean_r;
-    *out_side = mean_e;
-    return true;
-}
-
 static void draw_world_line(const Vec3 &a, const Vec3 &b) {
     glBegin(GL_LINES);
     glVertex3f(a.x, a.y, a.z);
@@ -1369,18 +826,6 @@ static void orient_label_axes_for_camera(const Vec3 &eye,
     if (out_facing_normal) *out_facing_normal = facing_normal;
 }
 
-static Vec3 scene_point_to_vec3(const vicad::SceneVec3 &p) {
-    return {p.x, p.y, p.z};
-}
-
-static Vec2 contour_point_to_plane_local(const Vec3 &p,
-                                         const Vec3 &origin,
-                                         const Vec3 &axis_right,
-                                         const Vec3 &axis_up) {
-    const Vec3 d = sub(p, origin);
-    return {(float)dot(d, axis_right), (float)dot(d, axis_up)};
-}
-
 static Vec3 contour_point_from_plane_local(const Vec2 &p,
                                            const Vec3 &origin,
                                            const Vec3 &axis_right,
@@ -1389,8 +834,7 @@ static Vec3 contour_point_from_plane_local(const Vec2 &p,
 }
 
 static float text_width_world(const char *text, float world_scale) {
-    const float font_px = (float)VICAD_BAKED_PIXEL_SIZE * world_scale;
-    return text_width_for_cstr(text, font_px);
+    return text_width_for_cstr(text, (float)vicad_text::BaseFontPixelSize()) * world_scale;
 }
 
 static void draw_dimension_label_world(const Vec3 &anchor,
@@ -1406,7 +850,9 @@ static void draw_dimension_label_world(const Vec3 &anchor,
     if (center_x) {
         origin = add(origin, mul(axis_right, -0.5f * text_width_world(text, label_world_scale)));
     }
-    draw_text_baked_world(origin, axis_right, axis_up, label_world_scale, text, r, g, b, a);
+    // Queued; draw_script_sketch_dimensions flushes every label at once.
+    g_text.AddWorldText({origin.x, origin.y, origin.z}, {axis_right.x, axis_right.y, axis_right.z},
+                        {axis_up.x, axis_up.y, axis_up.z}, label_world_scale, text, r, g, b, a);
 }
 
 static void draw_dimension_arrowheads_world(const Vec3 &a,
@@ -1472,31 +918,21 @@ static float arrow_world_size_at_anchor(const DimensionRenderContext &ctx,
     return clampf(target, min_size, max_size);
 }
 
-static void draw_contour_dimensions(const vicad::ScriptSketchContour &contour,
+static void draw_contour_dimensions(const vicad::SketchDimLayout &layout,
                                     const DimensionRenderContext &ctx,
                                     float alpha,
                                     float ink) {
-    if (contour.points.size() < 2) return;
-    Vec3 text_right = {1.0f, 0.0f, 0.0f};
-    Vec3 text_up = {0.0f, 1.0f, 0.0f};
-    Vec3 plane_normal = {0.0f, 0.0f, 1.0f};
-    contour_plane_axes(contour, &text_right, &text_up, &plane_normal);
-    const Vec3 plane_origin = scene_point_to_vec3(contour.points.front());
-
-    std::vector<Vec2> pts2;
-    pts2.reserve(contour.points.size());
-    for (const vicad::SceneVec3 &p : contour.points) {
-        pts2.push_back(contour_point_to_plane_local(scene_point_to_vec3(p), plane_origin, text_right, text_up));
-    }
-    const Vec2 centroid = contour_centroid_mean(pts2);
-    Vec2 bmin = {0.0f, 0.0f}, bmax = {0.0f, 0.0f};
-    contour_bbox(pts2, &bmin, &bmax);
-    const float bw = bmax.x - bmin.x;
-    const float bh = bmax.y - bmin.y;
-    const float bdiag = std::sqrt(bw * bw + bh * bh);
+    if (layout.points.size() < 2) return;
+    const Vec3 text_right = layout.right;
+    const Vec3 text_up = layout.up;
+    const Vec3 plane_normal = layout.normal;
+    const Vec3 plane_origin = layout.origin;
+    const std::vector<Vec2> &pts2 = layout.points;
+    const Vec2 centroid = layout.centroid;
+    const float bdiag = layout.diagonal;
     const Vec3 centroid3 = contour_point_from_plane_local(centroid, plane_origin, text_right, text_up);
     const float world_per_px = world_per_pixel_at_anchor(ctx, centroid3);
-    float world_scale = (world_per_px * 27.0f) / (float)VICAD_BAKED_PIXEL_SIZE;
+    float world_scale = (world_per_px * 27.0f) / (float)vicad_text::BaseFontPixelSize();
     Vec3 facing_right = text_right;
     Vec3 facing_up = text_up;
     Vec3 facing_normal = plane_normal;
@@ -1506,39 +942,20 @@ static void draw_contour_dimensions(const vicad::ScriptSketchContour &contour,
                                 mul(facing_normal, world_per_px * 2.0f));
     const Vec3 dim_plane_lift = mul(facing_normal, world_per_px * 1.5f);
 
-    SketchDimShapeKind kind = SketchDimShapeKind::Polygon;
-    float rect_w = 0.0f, rect_h = 0.0f;
-    Vec2 c_center = {0.0f, 0.0f};
-    float c_radius = 0.0f;
-    Vec2 rp_center = {0.0f, 0.0f};
-    float rp_radius = 0.0f;
-    float rp_side = 0.0f;
-
-    if (classify_rectangle_like(pts2, &rect_w, &rect_h) ||
-        classify_rounded_rectangle_like(pts2, &rect_w, &rect_h)) {
-        const float maxv = rect_w > rect_h ? rect_w : rect_h;
-        const float minv = rect_w > rect_h ? rect_h : rect_w;
-        if (maxv > 1e-6f && std::fabs(maxv - minv) / maxv < 0.02f) {
-            kind = SketchDimShapeKind::Square;
-        } else {
-            kind = SketchDimShapeKind::Rectangle;
-        }
-    } else if (classify_circle_like(pts2, &c_center, &c_radius)) {
-        if (c_radius <= 0.2f) {
-            kind = SketchDimShapeKind::Point;
-        } else {
-            kind = SketchDimShapeKind::Circle;
-        }
-    } else if (classify_regular_polygon_like(pts2, &rp_center, &rp_radius, &rp_side)) {
-        kind = SketchDimShapeKind::RegularPolygon;
-    } else {
-        kind = SketchDimShapeKind::Polygon;
-    }
+    using vicad::SketchDimShape;
+    const SketchDimShape kind = layout.shape;
+    const float rect_w = layout.rectWidth;
+    const float rect_h = layout.rectHeight;
+    const Vec2 c_center = layout.center;
+    const float c_radius = layout.radius;
+    const Vec2 rp_center = layout.center;
+    const float rp_radius = layout.radius;
+    const float rp_side = layout.side;
 
     glColor4f(ink, ink, ink, alpha);
     char text[128];
 
-    if (kind == SketchDimShapeKind::Circle || kind == SketchDimShapeKind::Point) {
+    if (kind == SketchDimShape::Circle || kind == SketchDimShape::Point) {
         Vec2 a2 = {c_center.x - c_radius, c_center.y};
         Vec2 b2 = {c_center.x + c_radius, c_center.y};
         const Vec3 a3 = add(contour_point_from_plane_local(a2, plane_origin, text_right, text_up), dim_plane_lift);
@@ -1547,7 +964,7 @@ static void draw_contour_dimensions(const vicad::ScriptSketchContour &contour,
         const Vec3 mid = mul(add(a3, b3), 0.5f);
         draw_dimension_arrowheads_world(a3, b3, ctx.camera,
                                         arrow_world_size_at_anchor(ctx, a3, b3, mid));
-        if (kind == SketchDimShapeKind::Point) {
+        if (kind == SketchDimShape::Point) {
             std::snprintf(text, sizeof(text), "P(%.3g, %.3g)", (double)c_center.x, (double)c_center.y);
         } else {
             format_dim(text, sizeof(text), "", c_radius * 2.0f);
@@ -1556,7 +973,7 @@ static void draw_contour_dimensions(const vicad::ScriptSketchContour &contour,
         if (dot(dim_dir, facing_right) < 0.0f) dim_dir = mul(dim_dir, -1.0f);
         const Vec3 dim_up = normalize(cross(facing_normal, dim_dir));
         draw_dimension_label_world(add(mid, label_lift), dim_dir, dim_up, world_scale, text, ink, ink, ink, alpha, true);
-        if (kind == SketchDimShapeKind::Point) {
+        if (kind == SketchDimShape::Point) {
             const float arm = (bdiag > 0.0f ? bdiag : 1.0f) * 0.06f + 0.04f;
             draw_world_line(add(contour_point_from_plane_local({c_center.x - arm, c_center.y}, plane_origin, text_right, text_up), dim_plane_lift),
                             add(contour_point_from_plane_local({c_center.x + arm, c_center.y}, plane_origin, text_right, text_up), dim_plane_lift));
@@ -1566,7 +983,7 @@ static void draw_contour_dimensions(const vicad::ScriptSketchContour &contour,
         return;
     }
 
-    if (kind == SketchDimShapeKind::Rectangle || kind == SketchDimShapeKind::Square) {
+    if (kind == SketchDimShape::Rectangle || kind == SketchDimShape::Square) {
         const Vec2 p0 = pts2[0];
         const Vec2 p1 = pts2[1];
         const Vec2 p2 = pts2[2];
@@ -1618,7 +1035,7 @@ static void draw_contour_dimensions(const vicad::ScriptSketchContour &contour,
         return;
     }
 
-    if (kind == SketchDimShapeKind::RegularPolygon) {
+    if (kind == SketchDimShape::RegularPolygon) {
         const size_t n = pts2.size();
         draw_world_line(add(contour_point_from_plane_local(pts2[0], plane_origin, text_right, text_up), dim_plane_lift),
                         add(contour_point_from_plane_local(pts2[1], plane_origin, text_right, text_up), dim_plane_lift));
@@ -1646,46 +1063,22 @@ static void draw_contour_dimensions(const vicad::ScriptSketchContour &contour,
                                        ink, ink, ink, alpha, true);
         }
     } else {
-        float perimeter = 0.0f;
-        for (size_t i = 0; i < n; ++i) {
-            perimeter += length2(sub2v(pts2[(i + 1) % n], pts2[i]));
-        }
-        const float area = std::fabs(contour_signed_area(pts2));
-        std::snprintf(text, sizeof(text), "N=%zu  P=%.3g  A=%.3g", n, (double)perimeter, (double)area);
+        std::snprintf(text, sizeof(text), "N=%zu  P=%.3g  A=%.3g", n, (double)layout.perimeter, (double)layout.area);
         draw_dimension_label_world(add(contour_point_from_plane_local(centroid, plane_origin, text_right, text_up), label_lift),
                                    facing_right, facing_up, world_scale, text, ink, ink, ink, alpha, true);
     }
 }
 
 static void draw_sketch_dimension_model(const vicad::SketchDimensionModel &model,
-                                        float z,
+                                        const vicad::SketchDimLayout &layout,
                                         const DimensionRenderContext &ctx,
                                         float alpha,
                                         float ink) {
     if (model.entities.empty()) return;
-    std::vector<Vec2> pts2;
-    pts2.reserve(model.logicalVertices.size());
-    for (const manifold::vec2 &p : model.logicalVertices) {
-        pts2.push_back({(float)p.x, (float)p.y});
-    }
-
-    Vec2 bmin = {0.0f, 0.0f};
-    Vec2 bmax = {0.0f, 0.0f};
-    if (!pts2.empty()) {
-        contour_bbox(pts2, &bmin, &bmax);
-    } else {
-        bmin = {(float)model.anchor.x, (float)model.anchor.y};
-        bmax = bmin;
-    }
-    const float bw = bmax.x - bmin.x;
-    const float bh = bmax.y - bmin.y;
-    Vec2 centroid = {(float)model.anchor.x, (float)model.anchor.y};
-    if (!pts2.empty()) {
-        centroid = contour_centroid_mean(pts2);
-    }
-    const Vec3 centroid3 = vec3_from_2d(centroid, z);
+    const float z = layout.modelZ;
+    const Vec3 centroid3 = vec3_from_2d(layout.modelCentroid, z);
     const float world_per_px = world_per_pixel_at_anchor(ctx, centroid3);
-    float world_scale = (world_per_px * 27.0f) / (float)VICAD_BAKED_PIXEL_SIZE;
+    float world_scale = (world_per_px * 27.0f) / (float)vicad_text::BaseFontPixelSize();
 
     Vec3 facing_right = {1.0f, 0.0f, 0.0f};
     Vec3 facing_up = {0.0f, 1.0f, 0.0f};
@@ -1741,26 +1134,14 @@ static void draw_script_sketch_dimensions(const std::vector<vicad::ScriptSceneOb
         const float ink = selected ? 0.12f : 0.28f;
         glColor4f(ink, ink, ink, alpha);
 
-        size_t largest_idx = 0;
-        float largest_area = -1.0f;
-        for (size_t i = 0; i < obj.sketchContours.size(); ++i) {
-            const vicad::ScriptSketchContour &c = obj.sketchContours[i];
-            const float a = contour_projected_area3d(c);
-            if (a > largest_area) {
-                largest_area = a;
-                largest_idx = i;
-            }
-        }
-        if (obj.sketchDims.has_value()) {
-            float z = 0.0f;
-            if (!obj.sketchContours.empty() && !obj.sketchContours.front().points.empty()) {
-                z = obj.sketchContours.front().points.front().z;
-            }
-            draw_sketch_dimension_model(*obj.sketchDims, z, ctx, alpha, ink);
+        const vicad::SketchDimLayout &layout = vicad::SceneObjectSketchLayout(obj);
+        if (const vicad::SketchDimensionModel *dims = vicad::SceneObjectSketchDims(obj)) {
+            draw_sketch_dimension_model(*dims, layout, ctx, alpha, ink);
         } else {
-            draw_contour_dimensions(obj.sketchContours[largest_idx], ctx, alpha, ink);
+            draw_contour_dimensions(layout, ctx, alpha, ink);
         }
     }
+    g_text.Flush();
 
     glLineWidth(1.0f);
     glDepthMask(GL_TRUE);
@@ -1858,133 +1239,123 @@ static void draw_pick_debug_overlay(i32 pixel_w, i32 pixel_h,
     glMatrixMode(GL_MODELVIEW);
 }
 
-static bool ray_intersect_triangle(const Vec3 &orig, const Vec3 &dir,
-                                   const Vec3 &p0, const Vec3 &p1, const Vec3 &p2,
-                                   float *out_t) {
-    const Vec3 e1 = sub(p1, p0);
-    const Vec3 e2 = sub(p2, p0);
-    const Vec3 p = cross(dir, e2);
-    const float det = dot(e1, p);
-    if (std::fabs(det) < 1e-7f) return false;
-    const float inv_det = 1.0f / det;
-
-    const Vec3 tvec = sub(orig, p0);
-    const float u = dot(tvec, p) * inv_det;
-    if (u < 0.0f || u > 1.0f) return false;
-
-    const Vec3 q = cross(tvec, e1);
-    const float v = dot(dir, q) * inv_det;
-    if (v < 0.0f || u + v > 1.0f) return false;
-
-    const float t = dot(e2, q) * inv_det;
-    if (t <= 1e-5f) return false;
-    if (out_t) *out_t = t;
-    return true;
-}
-
-static bool ray_mesh_hit_t(const manifold::MeshGL &mesh,
-                           const Vec3 &ray_origin, const Vec3 &ray_dir,
-                           float *out_t) {
-    const size_t tri_count = mesh.NumTri();
-    if (tri_count == 0) return false;
-
-    bool hit = false;
-    float best_t = 1e30f;
-    for (size_t tri = 0; tri < tri_count; ++tri) {
-        const size_t i0 = mesh.triVerts[tri * 3 + 0];
-        const size_t i1 = mesh.triVerts[tri * 3 + 1];
-        const size_t i2 = mesh.triVerts[tri * 3 + 2];
-        const Vec3 p0 = {
-            mesh.vertProperties[i0 * mesh.numProp + 0],
-            mesh.vertProperties[i0 * mesh.numProp + 1],
-            mesh.vertProperties[i0 * mesh.numProp + 2],
-        };
-        const Vec3 p1 = {
-            mesh.vertProperties[i1 * mesh.numProp + 0],
-            mesh.vertProperties[i1 * mesh.numProp + 1],
-            mesh.vertProperties[i1 * mesh.numProp + 2],
-        };
-        const Vec3 p2 = {
-            mesh.vertProperties[i2 * mesh.numProp + 0],
-            mesh.vertProperties[i2 * mesh.numProp + 1],
-            mesh.vertProperties[i2 * mesh.numProp + 2],
-        };
-
-        float t = 0.0f;
-        if (!ray_intersect_triangle(ray_origin, ray_dir, p0, p1, p2, &t)) continue;
-        if (t >= best_t) continue;
-        best_t = t;
-        hit = true;
-    }
-
-    if (hit && out_t) *out_t = best_t;
-    return hit;
-}
-
-static bool ray_aabb_hit_t(const Vec3 &ray_origin, const Vec3 &ray_dir,
-                           const Vec3 &bmin, const Vec3 &bmax, float *out_t) {
-    float tmin = 0.0f;
-    float tmax = 1e30f;
+enum class IdPickTarget {
+    Objects,
+    FaceRegions,
+    Edges,
+};
 
-    const float ro[3] = {ray_origin.x, ray_origin.y, ray_origin.z};
-    const float rd[3] = {ray_dir.x, ray_dir.y, ray_dir.z};
-    const float mn[3] = {bmin.x, bmin.y, bmin.z};
-    const float mx[3] = {bmax.x, bmax.y, bmax.z};
+struct IdPickRequest {
+    IdPickTarget target = IdPickTarget::Objects;
+    i32 mouse_px_x = 0;
+    i32 mouse_px_y = 0;
+    i32 width = 1;
+    i32 height = 1;
+    float pixel_scale = 1.0f;
+    float fov_degrees = 45.0f;
+    Vec3 eye = {0.0f, 0.0f, 0.0f};
+    Vec3 target_point = {0.0f, 0.0f, 0.0f};
+};
 
-    for (int i = 0; i < 3; ++i) {
-        if (std::fabs(rd[i]) < 1e-6f) {
-            if (ro[i] < mn[i] || ro[i] > mx[i]) return false;
-            continue;
-        }
-        const float inv = 1.0f / rd[i];
-        float t0 = (mn[i] - ro[i]) * inv;
-        float t1 = (mx[i] - ro[i]) * inv;
-        if (t0 > t1) {
-            const float tmp = t0;
-            t0 = t1;
-            t1 = tmp;
+// Per-triangle face region ids of the topology mesh, uploaded whenever face
+// detection reruns.
+static vicad_renderer3d::TriangleIdBuffer g_face_region_ids;
+
+// Hover and click picking through the id pass: the index under the cursor of
+// the scene object, face region of `mesh` or feature edge of `edges` that is
+// actually visible there, or -1. Objects resolve to 0 for `mesh` when the
+// scene has no objects. Leaves the back buffer cleared.
+static int pick_by_id_pass(const IdPickRequest &req,
+                           const std::vector<vicad::ScriptSceneObject> &scene,
+                           const std::vector<uint8_t> &visible_mask,
+                           const manifold::MeshGL &mesh,
+                           const vicad::EdgeDetectionResult &edges) {
+    const float line_width = 6.0f * req.pixel_scale;
+    vicad_renderer3d::BeginIdPass(req.width, req.height);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    set_perspective(req.fov_degrees, (float)req.width / (float)req.height, 0.1f, 5000.0f);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+    apply_look_at(req.eye, req.target_point);
+
+    int radius = 0;
+    if (req.target == IdPickTarget::Objects) {
+        if (scene.empty()) {
+            if (const vicad_renderer3d::GpuMesh *gpu = g_mesh_buffers.Get(mesh)) {
+                vicad_renderer3d::SetPickId(1);
+                vicad_renderer3d::DrawMeshUnlit(*gpu);
+            }
         }
-        if (t0 > tmin) tmin = t0;
-        if (t1 < tmax) tmax = t1;
-        if (tmax < tmin) return false;
-    }
-    if (tmax < 0.0f) return false;
-    if (out_t) *out_t = tmin >= 0.0f ? tmin : tmax;
-    return true;
-}
-
-static Vec3 scene_vec3_to_vec3(const vicad::SceneVec3 &v) {
-    return {v.x, v.y, v.z};
-}
-
-static int pick_scene_object_by_ray(const std::vector<vicad::ScriptSceneObject> &scene,
-                                    const Vec3 &eye, const Vec3 &ray_dir,
-                                    const std::vector<uint8_t> *visible_mask) {
-    float best_t = 1e30f;
-    int best = -1;
-    for (size_t i = 0; i < scene.size(); ++i) {
-        if (visible_mask && (i >= visible_mask->size() || (*visible_mask)[i] == 0)) continue;
-        float broad_t = 0.0f;
-        if (!ray_aabb_hit_t(eye, ray_dir,
-                            scene_vec3_to_vec3(scene[i].bmin),
-                            scene_vec3_to_vec3(scene[i].bmax),
-                            &broad_t)) {
-            continue;
+        for (size_t i = 0; i < scene.size(); ++i) {
+            if (i >= visible_mask.size() || visible_mask[i] == 0) continue;
+            const vicad::ScriptSceneObject &obj = scene[i];
+            if (!scene_object_is_manifold(obj)) continue;
+            vicad_renderer3d::SetPickId((uint32_t)i + 1);
+            if (obj.instance) {
+                const vicad::SceneInstanceGeometry &geom = *obj.instance;
+                const vicad_renderer3d::GpuMesh *gpu =
+                    g_mesh_buffers.Get(vicad::SceneInstanceMesh(geom), vicad::SceneInstanceDerived(geom));
+                if (gpu) vicad_renderer3d::DrawMeshInstances(*gpu, {scene_object_mesh_instance(obj)});
+            } else if (const vicad_renderer3d::GpuMesh *gpu =
+                           g_mesh_buffers.Get(vicad::SceneObjectMesh(obj), vicad::SceneObjectDerived(obj))) {
+                vicad_renderer3d::DrawMeshUnlit(*gpu);
+            }
         }
-        float hit_t = broad_t;
-        if (scene_object_is_manifold(scene[i])) {
-            if (!ray_mesh_hit_t(scene[i].mesh, eye, ray_dir, &hit_t)) {
-                continue;
+        // Sketches draw over the solids, as they do on screen.
+        glDisable(GL_DEPTH_TEST);
+        glLineWidth(line_width);
+        for (size_t i = 0; i < scene.size(); ++i) {
+            if (i >= visible_mask.size() || visible_mask[i] == 0) continue;
+            if (!scene_object_is_sketch(scene[i])) continue;
+            vicad_renderer3d::SetPickId((uint32_t)i + 1);
+            for (const vicad::ScriptSketchContour &contour : scene[i].sketchContours) {
+                if (contour.points.size() < 2) continue;
+                glBegin(GL_LINE_LOOP);
+                for (const vicad::SceneVec3 &p : contour.points) glVertex3f(p.x, p.y, p.z);
+                glEnd();
             }
-        } else if (!scene_object_is_sketch(scene[i])) {
-            continue;
         }
-        if (hit_t < best_t) {
-            best_t = hit_t;
-            best = (int)i;
+        glEnable(GL_DEPTH_TEST);
+        radius = (int)std::lround(2.0f * req.pixel_scale);
+    } else if (const vicad_renderer3d::GpuMesh *gpu = g_mesh_buffers.Get(mesh)) {
+        if (req.target == IdPickTarget::FaceRegions) {
+            g_face_region_ids.Draw(*gpu);
+        } else {
+            // The mesh only occludes; edges on its surface win the depth test.
+            glEnable(GL_POLYGON_OFFSET_FILL);
+            glPolygonOffset(1.0f, 1.0f);
+            vicad_renderer3d::SetPickId(0);
+            vicad_renderer3d::DrawMeshUnlit(*gpu);
+            glDisable(GL_POLYGON_OFFSET_FILL);
+            glLineWidth(line_width);
+            glBegin(GL_LINES);
+            for (const std::vector<int> *indices : {&edges.featureEdgeIndices, &edges.nonManifoldEdgeIndices}) {
+                for (const int idx : *indices) {
+                    if (idx < 0 || (size_t)idx >= edges.edges.size()) continue;
+                    const vicad::EdgeRecord &e = edges.edges[(size_t)idx];
+                    vicad_renderer3d::SetPickId((uint32_t)idx + 1);
+                    const Vec3 p0 = mesh_vertex(mesh, e.v0);
+                    const Vec3 p1 = mesh_vertex(mesh, e.v1);
+                    glVertex3f(p0.x, p0.y, p0.z);
+                    glVertex3f(p1.x, p1.y, p1.z);
+                }
+            }
+            glEnd();
+            radius = (int)std::lround(4.0f * req.pixel_scale);
         }
     }
-    return best;
+
+    const uint32_t id = vicad_renderer3d::ReadPickId(req.mouse_px_x, req.mouse_px_y, radius, req.width, req.height);
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    vicad_renderer3d::EndIdPass();
+    return (int)id - 1;
 }
 
 static void draw_orientation_cube(const CameraBasis &basis, i32 width, i32 height, float hud_scale) {
@@ -2192,37 +1563,6 @@ static int close_tab_at(std::vector<std::string> *tabs, int active_index, int cl
     return active_index;
 }
 
-struct FileWatchStamp {
-    long long mtime_ns = -1;
-    long long ctime_ns = -1;
-    long long size_bytes = -1;
-    bool exists = false;
-};
-
-static FileWatchStamp read_file_watch_stamp(const std::string &path) {
-    FileWatchStamp stamp = {};
-    if (path.empty()) return stamp;
-    struct stat st;
-    if (stat(path.c_str(), &st) != 0) return stamp;
-    stamp.exists = true;
-#if defined(__APPLE__)
-    stamp.mtime_ns = (long long)st.st_mtimespec.tv_sec * 1000000000LL + (long long)st.st_mtimespec.tv_nsec;
-    stamp.ctime_ns = (long long)st.st_ctimespec.tv_sec * 1000000000LL + (long long)st.st_ctimespec.tv_nsec;
-#else
-    stamp.mtime_ns = (long long)st.st_mtime * 1000000000LL;
-    stamp.ctime_ns = (long long)st.st_ctime * 1000000000LL;
-#endif
-    stamp.size_bytes = (long long)st.st_size;
-    return stamp;
-}
-
-static bool file_watch_stamp_equal(const FileWatchStamp &a, const FileWatchStamp &b) {
-    return a.exists == b.exists &&
-           a.mtime_ns == b.mtime_ns &&
-           a.ctime_ns == b.ctime_ns &&
-           a.size_bytes == b.size_bytes;
-}
-
 class TabFileWatcher {
   public:
     TabFileWatcher() : stop_(false) {
@@ -2234,7 +1574,7 @@ class TabFileWatcher {
 
     void Stop() {
         if (stop_.exchange(true)) return;
-        // RGFW_stopCheckEvents();
+        notifier_.Wake();
         if (thread_.joinable()) thread_.join();
     }
 
@@ -2249,8 +1589,11 @@ class TabFileWatcher {
             normalized.push_back(norm);
         }
         std::sort(normalized.begin(), normalized.end());
-        std::lock_guard<std::mutex> lock(mutex_);
-        watched_paths_ = std::move(normalized);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            watched_paths_ = std::move(normalized);
+        }
+        notifier_.Wake();
     }
 
     void DrainChangedPaths(std::vector<std::string> *out_paths) {
@@ -2265,10 +1608,23 @@ class TabFileWatcher {
     }
 
   private:
+    // Stat interval for files the OS does not report changes to.
     static constexpr int kPollIntervalMs = 12;
-
+    // After a file event, how long the files must stay quiet before they are
+    // compared, so the writes and renames of one editor save count once, and
+    // the longest a burst of events may hold the comparison back.
+    static constexpr int kSettleMs = 4;
+    static constexpr int kSettleMaxMs = 50;
+
+    // Compares the watched files' stamps after every OS file event, or every
+    // kPollIntervalMs when some file is not covered by OS events; idle, the
+    // thread sleeps in the notifier.
     void RunLoop() {
-        std::map<std::string, FileWatchStamp> stamps;
+        // A missing file keeps the all -1 stamp, so deleting and re-creating
+        // a file both count as changes.
+        std::map<std::string, vicad::FileStamp> stamps;
+        std::vector<std::string> notifier_paths;
+        bool notifier_set = false;
         while (!stop_.load()) {
             bool notify_main_loop = false;
             std::vector<std::string> paths;
@@ -2278,6 +1634,11 @@ class TabFileWatcher {
                 for (const auto &p : watched_paths_)
                     paths.emplace_back(p.data(), p.size());
             }
+            if (!notifier_set || paths != notifier_paths) {
+                notifier_.Watch(paths);
+                notifier_paths = paths;
+                notifier_set = true;
+            }
 
             for (auto it = stamps.begin(); it != stamps.end();) {
                 if (std::find(paths.begin(), paths.end(), it->first) == paths.end()) {
@@ -2288,13 +1649,18 @@ class TabFileWatcher {
             }
 
             for (const std::string &path : paths) {
-                const FileWatchStamp next = read_file_watch_stamp(path);
+                vicad::FileStamp next = {-1, -1, -1};
+                (void)vicad::ReadFileStamp(path.c_str(), &next);
                 auto it = stamps.find(path);
                 if (it == stamps.end()) {
                     stamps[path] = next;
                     continue;
                 }
-                if (file_watch_stamp_equal(it->second, next)) continue;
+                const vicad::FileStamp &prev = it->second;
+                if (prev.mtime_ns == next.mtime_ns && prev.ctime_ns == next.ctime_ns &&
+                    prev.size_bytes == next.size_bytes) {
+                    continue;
+                }
                 it->second = next;
 
                 std::lock_guard<std::mutex> lock(mutex_);
@@ -2308,10 +1674,18 @@ class TabFileWatcher {
                 RGFW_stopCheckEvents();
             }
 
-            std::this_thread::sleep_for(std::chrono::milliseconds(kPollIntervalMs));
+            if (!notifier_.watching()) {
+                (void)notifier_.Wait(kPollIntervalMs);
+                continue;
+            }
+            if (!notifier_.Wait(-1)) continue;
+            const auto settle_until = std::chrono::steady_clock::now() + std::chrono::milliseconds(kSettleMaxMs);
+            while (!stop_.load() && std::chrono::steady_clock::now() < settle_until && notifier_.Wait(kSettleMs)) {
+            }
         }
     }
 
+    vicad::FileChangeNotifier notifier_;
     std::atomic<bool> stop_;
     std::thread thread_;
     std::mutex mutex_;
@@ -2343,187 +1717,21 @@ static bool open_script_dialog(std::string *out_path, std::string *err) {
 #endif
 }
 
-static void draw_text_baked_rgba(float x, float y, float font_px, const char *text,
-                                 float r, float g, float b, float a) {
-    if (!text || !text[0]) return;
-    if (font_px <= 0.0f) return;
-#ifdef VICAD_HAS_HARFBUZZ
-    if (ensure_hb_text_state()) {
-        HbTextCacheEntry *entry = get_or_create_hb_text_entry(text, font_px);
-        if (entry && entry->texture != 0 && entry->width > 0 && entry->height > 0) {
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-            glEnable(GL_TEXTURE_2D);
-            glBindTexture(GL_TEXTURE_2D, entry->texture);
-            glColor4f(r, g, b, a);
-            const float x0 = x + (float)entry->offset_x;
-            const float y0 = y + (float)entry->offset_y;
-            const float x1 = x0 + (float)entry->width;
-            const float y1 = y0 + (float)entry->height;
-            glBegin(GL_QUADS);
-            glTexCoord2f(0.0f, 0.0f); glVertex2f(x0, y0);
-            glTexCoord2f(1.0f, 0.0f); glVertex2f(x1, y0);
-            glTexCoord2f(1.0f, 1.0f); glVertex2f(x1, y1);
-            glTexCoord2f(0.0f, 1.0f); glVertex2f(x0, y1);
-            glEnd();
-            glDisable(GL_TEXTURE_2D);
-            glDisable(GL_BLEND);
-            return;
-        }
-    }
-#endif
-    if (!ensure_baked_font_texture()) return;
-
-    const float scale = font_px / (float)VICAD_BAKED_PIXEL_SIZE;
-    const float line_height = (float)VICAD_BAKED_LINE_HEIGHT * scale;
-    const float shadow_px = clampf(font_px * 0.055f, 1.0f, 2.0f);
-
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, g_baked_font.texture);
-    auto draw_pass = [&](float x_off, float y_off, float cr, float cg, float cb, float ca) {
-        float pen_x = x + x_off;
-        float baseline = y + y_off + (float)VICAD_BAKED_ASCENDER * scale;
-        glColor4f(cr, cg, cb, ca);
-        glBegin(GL_QUADS);
-        for (const unsigned char *p = (const unsigned char *)text; *p; ++p) {
-            if (*p == '\n') {
-                pen_x = x + x_off;
-                baseline += line_height;
-                continue;
-            }
-
-            const VicadBakedGlyph *glyph = glyph_for_char(*p);
-            if (glyph->w > 0 && glyph->h > 0) {
-                const float x0 = pen_x + (float)glyph->bearing_x * scale;
-                const float y0 = baseline - (float)glyph->bearing_y * scale;
-                const float x1 = x0 + (float)glyph->w * scale;
-                const float y1 = y0 + (float)glyph->h * scale;
-                const float u0 = (float)glyph->x / (float)VICAD_BAKED_ATLAS_WIDTH;
-                const float v0 = (float)glyph->y / (float)VICAD_BAKED_ATLAS_HEIGHT;
-                const float u1 = (float)(glyph->x + glyph->w) / (float)VICAD_BAKED_ATLAS_WIDTH;
-                const float v1 = (float)(glyph->y + glyph->h) / (float)VICAD_BAKED_ATLAS_HEIGHT;
-
-                glTexCoord2f(u0, v0); glVertex2f(x0, y0);
-                glTexCoord2f(u1, v0); glVertex2f(x1, y0);
-                glTexCoord2f(u1, v1); glVertex2f(x1, y1);
-                glTexCoord2f(u0, v1); glVertex2f(x0, y1);
-            }
-            pen_x += (float)glyph->advance * scale;
-        }
-        glEnd();
-    };
-
-    draw_pass(shadow_px, shadow_px, 0.02f, 0.03f, 0.04f, a * kTextShadowAlphaScale);
-    draw_pass(0.0f, 0.0f, r, g, b, a);
-    glDisable(GL_TEXTURE_2D);
-    glDisable(GL_BLEND);
-}
-
-static void draw_text_baked_world(const Vec3 &origin,
-                                  const Vec3 &axis_right,
-                                  const Vec3 &axis_up,
-                                  float world_scale, const char *text,
-                                  float r, float g, float b, float a) {
-    if (!text || !text[0]) return;
-    if (world_scale <= 0.0f) return;
-    if (!ensure_baked_font_texture()) return;
-
-    const float line_height = (float)VICAD_BAKED_LINE_HEIGHT * world_scale;
-    const Vec3 down = mul(axis_up, -1.0f);
-    const float shadow_world = world_scale * 1.35f;
-    const Vec3 shadow_origin = add(origin, add(mul(axis_right, shadow_world), mul(down, shadow_world)));
-
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, g_baked_font.texture);
-    auto draw_pass = [&](const Vec3 &pass_origin, float cr, float cg, float cb, float ca) {
-        float pen_x = 0.0f;
-        float baseline = (float)VICAD_BAKED_ASCENDER * world_scale;
-        glColor4f(cr, cg, cb, ca);
-        glBegin(GL_QUADS);
-        for (const unsigned char *p = (const unsigned char *)text; *p; ++p) {
-            if (*p == '\n') {
-                pen_x = 0.0f;
-                baseline += line_height;
-                continue;
-            }
-
-            const VicadBakedGlyph *glyph = glyph_for_char(*p);
-            if (glyph->w > 0 && glyph->h > 0) {
-                const float x0 = pen_x + (float)glyph->bearing_x * world_scale;
-                const float y0 = baseline - (float)glyph->bearing_y * world_scale;
-                const float x1 = x0 + (float)glyph->w * world_scale;
-                const float y1 = y0 + (float)glyph->h * world_scale;
-                const float u0 = (float)glyph->x / (float)VICAD_BAKED_ATLAS_WIDTH;
-                const float v0 = (float)glyph->y / (float)VICAD_BAKED_ATLAS_HEIGHT;
-                const float u1 = (float)(glyph->x + glyph->w) / (float)VICAD_BAKED_ATLAS_WIDTH;
-                const float v1 = (float)(glyph->y + glyph->h) / (float)VICAD_BAKED_ATLAS_HEIGHT;
-
-                const Vec3 p00 = add(add(pass_origin, mul(axis_right, x0)), mul(down, y0));
-                const Vec3 p10 = add(add(pass_origin, mul(axis_right, x1)), mul(down, y0));
-                const Vec3 p11 = add(add(pass_origin, mul(axis_right, x1)), mul(down, y1));
-                const Vec3 p01 = add(add(pass_origin, mul(axis_right, x0)), mul(down, y1));
-
-                glTexCoord2f(u0, v0); glVertex3f(p00.x, p00.y, p00.z);
-                glTexCoord2f(u1, v0); glVertex3f(p10.x, p10.y, p10.z);
-                glTexCoord2f(u1, v1); glVertex3f(p11.x, p11.y, p11.z);
-                glTexCoord2f(u0, v1); glVertex3f(p01.x, p01.y, p01.z);
-            }
-            pen_x += (float)glyph->advance * world_scale;
-        }
-        glEnd();
-    };
-
-    draw_pass(shadow_origin, 0.02f, 0.03f, 0.04f, a * kTextShadowAlphaScale);
-    draw_pass(origin, r, g, b, a);
-    glDisable(GL_TEXTURE_2D);
-    glDisable(GL_BLEND);
-}
-
-static void draw_text_5x7(float x, float y, float scale, const char *text, float r, float g, float b) {
-    draw_text_baked_rgba(x, y, scale * 7.0f, text, r, g, b, 1.0f);
-}
-
-static void draw_text_from_slice(float x, float y, float scale, Clay_StringSlice s, float r, float g, float b) {
-    if (s.length <= 0 || !s.chars) return;
-    char tmp[512];
-    int n = s.length;
-    if (n > (int)sizeof(tmp) - 1) n = (int)sizeof(tmp) - 1;
-    std::memcpy(tmp, s.chars, (size_t)n);
-    tmp[n] = '\0';
-    draw_text_5x7(x, y, scale, tmp, r, g, b);
-}
-
-static bool compute_mesh_bounds(const manifold::MeshGL &mesh, Vec3 *bmin, Vec3 *bmax) {
-    if (mesh.numProp < 3 || mesh.vertProperties.empty()) return false;
-    const size_t count = mesh.vertProperties.size() / mesh.numProp;
-    if (count == 0) return false;
-
-    Vec3 mn = {
-        mesh.vertProperties[0],
-        mesh.vertProperties[1],
-        mesh.vertProperties[2],
-    };
-    Vec3 mx = mn;
-
-    for (size_t i = 1; i < count; ++i) {
-        const float x = mesh.vertProperties[i * mesh.numProp + 0];
-        const float y = mesh.vertProperties[i * mesh.numProp + 1];
-        const float z = mesh.vertProperties[i * mesh.numProp + 2];
-        if (x < mn.x) mn.x = x;
-        if (y < mn.y) mn.y = y;
-        if (z < mn.z) mn.z = z;
-        if (x > mx.x) mx.x = x;
-        if (y > mx.y) mx.y = y;
-        if (z > mx.z) mx.z = z;
-    }
-
-    *bmin = mn;
-    *bmax = mx;
-    return true;
+// Lines of the perf HUD: the worker phases and sizes of the run behind the
+// displayed scene, its replay and meshing here, and the last frame's CPU time.
+static std::vector<std::string> perf_hud_lines(const vicad_scene::SceneRunStats &stats, double frame_ms) {
+    const vicad::ScriptRunStats &run = stats.run;
+    char line[128];
+    std::vector<std::string> lines;
+    std::snprintf(line, sizeof(line), "worker  load %.1f  exec %.1f  encode %.1f ms",
+                  run.workerLoadUs / 1000.0, run.workerExecuteUs / 1000.0, run.workerEncodeUs / 1000.0);
+    lines.push_back(line);
+    std::snprintf(line, sizeof(line), "ops %u  records %.1f KiB  run %.1f ms",
+                  run.opCount, run.recordsBytes / 1024.0, run.runMs);
+    lines.push_back(line);
+    std::snprintf(line, sizeof(line), "replay %.1f  mesh %.1f  frame %.1f ms", run.replayMs, stats.mesh_ms, frame_ms);
+    lines.push_back(line);
+    return lines;
 }
 
 static Clay_RenderCommandArray build_clay_ui(i32 width, i32 height,
@@ -2542,7 +1750,8 @@ static Clay_RenderCommandArray build_clay_ui(i32 width, i32 height,
                                              bool sketches_collapsed,
                                              bool bodies_visible,
                                              bool sketches_visible,
-                                             const std::map<uint64_t, bool> &per_object_visible) {
+                                             const std::map<uint64_t, bool> &per_object_visible,
+                                             const std::vector<std::string> &hud_lines) {
     const float hud = vicad_render_ui::ClampHudScale(hud_scale);
     const int root_pad = (int)std::lround(14.0f * hud);
     int panel_w = (int)std::lround(286.0f * hud);
@@ -2622,6 +1831,9 @@ static Clay_RenderCommandArray build_clay_ui(i32 width, i32 height,
         const vicad::ScriptSceneObject &obj = scene[scene_idx];
         sketch_name_slots.push_back(ui_text_slot(slot++, obj.name.empty() ? "Sketch" : obj.name));
     }
+    std::vector<Clay_String> hud_line_slots;
+    hud_line_slots.reserve(hud_lines.size());
+    for (const std::string &line : hud_lines) hud_line_slots.push_back(ui_text_slot(slot++, line));
 
     CLAY(CLAY_ID("UiRoot"), {
         .layout = {
@@ -3010,6 +2222,34 @@ static Clay_RenderCommandArray build_clay_ui(i32 width, i32 height,
                 }
             }
         }
+
+        if (!hud_line_slots.empty()) {
+            CLAY(CLAY_ID("PerfHud"), {
+                .layout = {
+                    .layoutDirection = CLAY_TOP_TO_BOTTOM,
+                    .sizing = {.width = CLAY_SIZING_FIT(0), .height = CLAY_SIZING_FIT(0)},
+                    .padding = CLAY_PADDING_ALL((uint16_t)body_pad),
+                    .childGap = (uint16_t)body_gap,
+                },
+                .floating = {
+                    .offset = {(float)-root_pad, (float)-root_pad},
+                    .parentId = CLAY_ID("UiRoot").id,
+                    .zIndex = 2000,
+                    .attachPoints = {.element = CLAY_ATTACH_POINT_RIGHT_BOTTOM, .parent = CLAY_ATTACH_POINT_RIGHT_BOTTOM},
+                    .attachTo = CLAY_ATTACH_TO_ELEMENT_WITH_ID,
+                    .clipTo = CLAY_CLIP_TO_NONE,
+                },
+                .backgroundColor = {24, 28, 34, 214},
+            }) {
+                for (const Clay_String &line : hud_line_slots) {
+                    CLAY_TEXT(line, CLAY_TEXT_CONFIG({
+                        .fontSize = (uint16_t)small_font,
+                        .textColor = {226, 232, 240, 255},
+                        .wrapMode = CLAY_TEXT_WRAP_NONE,
+                    }));
+                }
+            }
+        }
     }
 
     Clay_RenderCommandArray cmds = Clay_EndLayout();
@@ -3049,21 +2289,72 @@ static Clay_RenderCommandArray build_clay_ui(i32 width, i32 height,
 }
 
 static int AppRunLoop() {
+    // Startup is logged as STARTUP_PHASE events, each with the time since
+    // launch, up to the first frame and the first model on screen.
+    const auto startup_begin = std::chrono::steady_clock::now();
+    auto log_startup_phase = [&](const char *phase) {
+        const double ms =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startup_begin).count();
+        char details[96];
+        std::snprintf(details, sizeof(details), "phase=%s ms=%.1f", phase, ms);
+        vicad::log_event("STARTUP_PHASE", 0, details);
+    };
+    // VICAD_TRACE=<path> records trace spans (see trace.h) and writes them to
+    // <path> as a Chrome trace on exit.
+    const char *trace_path = std::getenv("VICAD_TRACE");
+    if (trace_path && trace_path[0]) {
+        vicad::trace_enable();
+        vicad::trace_thread_name("main");
+    }
+
     static RGFW_glHints gl_hints = RGFW_DEFAULT_GL_HINTS;
     gl_hints.samples = kRequestedMsaaSamples;
     RGFW_setGlobalHints_OpenGL(&gl_hints);
 
     const bool feature_detection_enabled = true;
     manifold::Manifold fallback = manifold::Manifold::Cube(manifold::vec3(1.0), true);
-    manifold::MeshGL base_mesh = fallback.GetMeshGL();
-    manifold::MeshGL mesh = base_mesh;
+    // Mesh behind whole-scene face/edge topology: the fallback cube until a
+    // scene loads, then the merged scene mesh, shared with the session.
+    std::shared_ptr<const manifold::MeshGL> topology_mesh =
+        std::make_shared<const manifold::MeshGL>(fallback.GetMeshGL());
     Vec3 mesh_bmin = {-0.5f, -0.5f, -0.5f};
     Vec3 mesh_bmax = {0.5f, 0.5f, 0.5f};
-    (void)compute_mesh_bounds(mesh, &mesh_bmin, &mesh_bmax);
+    if (const vicad::MeshDerived fallback_derived = vicad::BuildMeshDerived(*topology_mesh);
+        fallback_derived.hasBounds) {
+        mesh_bmin = {fallback_derived.bmin[0], fallback_derived.bmin[1], fallback_derived.bmin[2]};
+        mesh_bmax = {fallback_derived.bmax[0], fallback_derived.bmax[1], fallback_derived.bmax[2]};
+    }
 
+    // Reloads run on the session's loader thread with a worker of its own;
+    // this one only fetches a response to export a scene that retained none.
     vicad::ScriptWorkerClient worker_client;
     vicad_scene::SceneSessionState scene_session = {};
     scene_session.script_path = "myobject.vicad.ts";
+    scene_session.progressive_lod = true;
+    scene_session.on_load_ready = [] { RGFW_stopCheckEvents(); };
+    scene_session.on_refine_ready = [] { RGFW_stopCheckEvents(); };
+    scene_session.on_analysis_ready = [] { RGFW_stopCheckEvents(); };
+    scene_session.on_lod_ready = [] { RGFW_stopCheckEvents(); };
+    scene_session.on_export_done = [] { RGFW_stopCheckEvents(); };
+    scene_session.disk_cache_enabled = true;
+    // Scenes of inactive tabs are kept for instant switching; VICAD_TAB_CACHE_MB
+    // sets their memory budget (0 disables the cache).
+    if (const char *budget_mb = std::getenv("VICAD_TAB_CACHE_MB"); budget_mb && budget_mb[0]) {
+        scene_session.tab_cache_budget_bytes = (size_t)std::strtoull(budget_mb, nullptr, 10) << 20;
+    }
+    // Tabs run on a pool of workers (one Bun process each), so background
+    // tabs edited on disk rebuild beside the active one. VICAD_WORKERS
+    // overrides the default of half the cores, at most four.
+    scene_session.loader_workers = std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, 4);
+    if (const char *workers = std::getenv("VICAD_WORKERS"); workers && workers[0]) {
+        scene_session.loader_workers = std::max<size_t>(1, (size_t)std::strtoull(workers, nullptr, 10));
+    }
+    // The Bun cold start is the longest step before the first model, so the
+    // worker spawns now and starts up while the window and GL are set up;
+    // fonts and shaping load on the first text measured.
+    vicad_scene::SceneSessionPrestartWorker(&scene_session);
+    log_startup_phase("worker_spawn");
+    bool export_pending_report = false;
     std::vector<std::string> recent_files = load_recent_files();
     if (!recent_files.empty() && file_exists_path(recent_files.front())) {
         scene_session.script_path = recent_files.front();
@@ -3086,6 +2377,7 @@ static int AppRunLoop() {
         800,
         (RGFW_windowFlags)(RGFW_windowCenter | RGFW_windowOpenGL | RGFW_windowTransparentTitlebar));
     if (win == nullptr) return 1;
+    log_startup_phase("window");
 
     RGFW_window_setExitKey(win, RGFW_keyNULL);
     RGFW_window_makeCurrentContext_OpenGL(win);
@@ -3146,6 +2438,7 @@ static int AppRunLoop() {
     ui_width = width;
     ui_height = height;
     clay_init(width, height);
+    log_startup_phase("ui");
 
     const float fov_degrees = 65.0f;
     Vec3 target = {0.0f, 0.0f, 0.0f};
@@ -3178,6 +2471,8 @@ static int AppRunLoop() {
     i32 last_mouse_y = 0;
     bool have_last_mouse = false;
     bool pick_debug_overlay = true;
+    bool perf_hud = false;
+    double last_frame_ms = 0.0;
     bool browser_collapsed = false;
     bool bodies_collapsed = false;
     bool sketches_collapsed = false;
@@ -3188,11 +2483,36 @@ static int AppRunLoop() {
     std::vector<size_t> browser_sketch_scene_indices;
     std::vector<uint8_t> visible_mask;
     int traffic_light_right_inset_px = 0;
-    bool needs_redraw = true;
+    vicad_frame::FrameScheduler frame(std::chrono::milliseconds(16));
+    // Per frame: the visible instances of each shared geometry, by render level.
+    std::vector<std::pair<std::pair<const vicad::SceneInstanceGeometry *, int>,
+                          std::vector<vicad_renderer3d::MeshInstance>>>
+        instance_draws;
+    // Per frame: visible_mask narrowed to the objects inside the view frustum,
+    // and the feature edges whose chunks intersect it.
+    std::vector<uint8_t> view_mask;
+    vicad_cull::EdgeChunks feature_edge_chunks;
+    vicad_cull::EdgeChunks non_manifold_edge_chunks;
+    bool edge_chunks_dirty = true;
+    std::vector<vicad_renderer3d::EdgeRange> view_feature_ranges;
+    std::vector<vicad_renderer3d::EdgeRange> view_non_manifold_ranges;
+    auto id_pick = [&](IdPickTarget pick_target, i32 px, i32 py) -> int {
+        IdPickRequest req;
+        req.target = pick_target;
+        req.mouse_px_x = px;
+        req.mouse_px_y = py;
+        req.width = width > 0 ? width : 1;
+        req.height = height > 0 ? height : 1;
+        req.pixel_scale = vicad_input::ComputeDisplayScale(width, height, window_w, window_h);
+        req.fov_degrees = fov_degrees;
+        req.eye = camera_position(target, yaw_deg, pitch_deg, distance);
+        req.target_point = target;
+        return pick_by_id_pass(req, script_scene, visible_mask, *topology_mesh, edge_select.edges);
+    };
     bool watch_paths_dirty = true;
     bool active_script_reload_requested = true;
-    const auto frame_interval = std::chrono::milliseconds(16);
-    auto next_frame_deadline = std::chrono::steady_clock::now();
+    bool tab_scene_switched = false;
+    bool tab_scene_restored = false;
     auto active_tab_is_new_tab = [&]() -> bool {
         return active_editor_tab >= 0 &&
                (size_t)active_editor_tab < open_editor_tabs.size() &&
@@ -3202,7 +2522,7 @@ static int AppRunLoop() {
         const std::string norm = normalize_path_lex(path);
         if (norm.empty()) return false;
         if (!file_exists_path(norm)) {
-            needs_redraw = true;
+            frame.Mark(vicad_frame::kDamageUi);
             return false;
         }
         if (add_to_tabs) {
@@ -3219,14 +2539,18 @@ static int AppRunLoop() {
             const int tab_index = find_tab_index_by_path(open_editor_tabs, norm);
             if (tab_index >= 0) active_editor_tab = tab_index;
         }
-        scene_session.script_path = norm;
-        scene_session.last_mtime_ns = -1;
-        scene_session.last_ctime_ns = -1;
-        scene_session.last_size_bytes = -1;
+        // The displayed scene changes with the tab (to the cached one, or
+        // empty until the script loads); it is adopted by the reload below.
+        tab_scene_restored = vicad_scene::SceneSessionSwitchScript(&scene_session, norm);
+        tab_scene_switched = true;
+        object_selected = false;
+        selected_object_index = -1;
+        hovered_object_index = -1;
+        watch_paths_dirty = true;
         push_recent_file(&recent_files, norm);
         save_recent_files(recent_files);
         active_script_reload_requested = true;
-        needs_redraw = true;
+        frame.Mark(vicad_frame::kDamageAll);
         return true;
     };
 
@@ -3258,86 +2582,332 @@ static int AppRunLoop() {
         }
     };
 
+    // Screen-space tessellation: the tolerance follows the projected pixel size
+    // at the nearest point of the scene bounds, so nothing on screen is
+    // coarser than kLodViewPixelTolerance pixels.
+    auto view_lod_policy = [&]() -> vicad::ReplayLodPolicy {
+        const Vec3 eye = camera_position(target, yaw_deg, pitch_deg, distance);
+        const Vec3 nearest = {
+            clampf(eye.x, mesh_bmin.x, mesh_bmax.x),
+            clampf(eye.y, mesh_bmin.y, mesh_bmax.y),
+            clampf(eye.z, mesh_bmin.z, mesh_bmax.z),
+        };
+        const Vec3 d = sub(nearest, eye);
+        const float depth = std::max(std::sqrt(dot(d, d)), 0.05f * distance);
+        vicad::ReplayLodPolicy policy = {};
+        policy.profile = vicad::LodProfile::View;
+        policy.viewLevel = vicad::LodViewLevelForDepth(depth, fov_degrees, (int)height);
+        return policy;
+    };
+
+    // The merged scene mesh only backs whole-scene face/edge topology, so it is
+    // fetched (and unioned) the first time a selection mode needs it.
+    bool topology_mesh_stale = false;
+    std::optional<vicad::MeshTopology> mesh_topology;
+    // Drops GPU buffers of meshes that are gone, so a new mesh reusing their
+    // storage is never drawn from a stale buffer. Runs whenever the scene or
+    // the topology mesh changes; meshes built later upload on first draw.
+    auto retain_gpu_meshes = [&](bool keep_topology_mesh) {
+        std::vector<const manifold::MeshGL *> live;
+        std::vector<uint64_t> live_versions;
+        live_versions.reserve(script_scene.size());
+        auto retain_scene = [&](const std::vector<vicad::ScriptSceneObject> &scene) {
+            auto retain_lods = [&](const std::shared_ptr<const vicad::MeshLodChain> &chain) {
+                if (!chain) return;
+                for (const vicad::MeshLodLevel &level : chain->levels) live_versions.push_back(level.derived.version);
+            };
+            for (const vicad::ScriptSceneObject &obj : scene) {
+                if (obj.derivedCache) live_versions.push_back(obj.derivedCache->version);
+                retain_lods(obj.lodChain);
+                if (obj.instance && obj.instance->derivedCache) {
+                    live_versions.push_back(obj.instance->derivedCache->version);
+                }
+                if (obj.instance) retain_lods(obj.instance->lodChain);
+            }
+        };
+        retain_scene(script_scene);
+        // Cached tabs keep their buffers, so switching back skips the upload.
+        for (const vicad_scene::SceneTabSnapshot &snap : scene_session.tab_cache) retain_scene(snap.scene_objects);
+        if (keep_topology_mesh) live.push_back(topology_mesh.get());
+        g_mesh_buffers.Retain(live, live_versions);
+    };
+
+    auto refresh_topology_mesh = [&]() {
+        if (!topology_mesh_stale) return;
+        topology_mesh_stale = false;
+        retain_gpu_meshes(false);
+        std::string merge_err;
+        topology_mesh = vicad_scene::SceneSessionMergedMesh(&scene_session, &merge_err);
+        if (!topology_mesh) {
+            manifold::MeshGL empty;
+            empty.numProp = 3;
+            topology_mesh = std::make_shared<const manifold::MeshGL>(std::move(empty));
+            vicad::log_event("SCRIPT_MERGE_ERROR", 0, merge_err.c_str());
+        }
+        mesh_topology.reset();
+    };
+    // Adjacency of the topology mesh, shared by face and edge detection.
+    auto topology = [&]() -> const vicad::MeshTopology & {
+        if (!mesh_topology) mesh_topology = vicad::BuildMeshTopology(*topology_mesh);
+        return *mesh_topology;
+    };
+    auto detect_faces = [&]() {
+        return vicad::DetectMeshFaces(*topology_mesh, topology(), face_select.angleThresholdDeg,
+                                      vicad::SceneFaceSources(scene_session.scene_objects));
+    };
+
+    // Face and edge topology (and their selections) survive a scene install
+    // that left every manifold object unchanged.
+    auto invalidate_topology_if_changed = [&]() {
+        if (!scene_session.topology_changed) return;
+        topology_mesh_stale = true;
+        face_select.dirty = true;
+        face_select.hoveredRegion = -1;
+        face_select.selectedRegion = -1;
+        edge_select.dirtyTopology = true;
+        edge_select.hoveredEdge = -1;
+        edge_select.selectedEdge = -1;
+        // Merge and analyse the new geometry now, so the first face or edge
+        // pick does not wait for it.
+        vicad_scene::SceneSessionStartAnalysis(&scene_session, face_select.angleThresholdDeg);
+    };
+
+    // Installs a finished background analysis: the merged mesh and its
+    // topology, the edge topology, and the face regions when they were found
+    // at the current angle threshold.
+    auto apply_analysis_if_ready = [&]() -> bool {
+        vicad_scene::SceneAnalysisResult analysis;
+        std::string analysis_err;
+        if (!vicad_scene::SceneSessionTakeAnalysis(&scene_session, &analysis, &analysis_err)) {
+            if (!analysis_err.empty()) vicad::log_event("SCRIPT_MERGE_ERROR", 0, analysis_err.c_str());
+            return false;
+        }
+        retain_gpu_meshes(false);
+        topology_mesh = vicad_scene::SceneSessionMergedMesh(&scene_session, nullptr);
+        topology_mesh_stale = false;
+        mesh_topology = std::move(analysis.topology);
+        if (edge_select.dirtyTopology) {
+            edge_select.edges = std::move(analysis.edges);
+            edge_chunks_dirty = true;
+            edge_select.dirtyTopology = false;
+        }
+        if (face_select.dirty && analysis.face_angle_deg == face_select.angleThresholdDeg) {
+            face_select.faces = std::move(analysis.faces);
+            face_select.dirty = false;
+            g_face_region_ids.Upload(face_select.faces.triRegion);
+        }
+        return true;
+    };
+    // Until the analysis lands, face and edge modes pick whole objects instead
+    // of building the topology on the spot.
+    auto awaiting_analysis = [&](bool dirty) {
+        return dirty && vicad_scene::SceneSessionAnalyzing(scene_session);
+    };
+
+    bool first_model_shown = false;
+    auto adopt_new_scene = [&]() {
+        vicad::TraceSpan span("scene", "adopt");
+        if (!first_model_shown && !scene_session.scene_objects.empty()) {
+            first_model_shown = true;
+            log_startup_phase("first_model");
+        }
+        retain_gpu_meshes(!scene_session.topology_changed);
+        mesh_bmin = scene_session.bounds_min;
+        mesh_bmax = scene_session.bounds_max;
+        object_selected = false;
+        selected_object_index = -1;
+        hovered_object_index = -1;
+        invalidate_topology_if_changed();
+        vicad_scene::SceneSessionStartLodBuild(&scene_session);
+        script_error.clear();
+        rebuild_browser_lists_and_visibility();
+    };
+
+    // A freshly opened script first shows its on-disk cached scene for a
+    // frame; the reload that follows runs the script and replaces it.
+    bool cached_preview_shown = false;
     auto reload_active_script_if_changed = [&]() -> bool {
-        const long long prev_mtime = scene_session.last_mtime_ns;
-        const long long prev_ctime = scene_session.last_ctime_ns;
-        const long long prev_size = scene_session.last_size_bytes;
-        std::string reload_err;
-        vicad::ReplayLodPolicy lod_policy = {};
-        lod_policy.profile = vicad::LodProfile::Model;
-        const bool loaded = vicad_scene::SceneSessionReloadIfChanged(
-            &scene_session, &worker_client, lod_policy, &reload_err);
-        const bool changed =
-            scene_session.last_mtime_ns != prev_mtime ||
-            scene_session.last_ctime_ns != prev_ctime ||
-            scene_session.last_size_bytes != prev_size;
-        if (!changed) return false;
-        if (loaded) {
-            base_mesh = scene_session.merged_mesh;
-            mesh = base_mesh;
-            mesh_bmin = scene_session.bounds_min;
-            mesh_bmax = scene_session.bounds_max;
-            object_selected = false;
-            selected_object_index = -1;
-            hovered_object_index = -1;
-            face_select.dirty = true;
-            face_select.hoveredRegion = -1;
-            face_select.selectedRegion = -1;
-            edge_select.dirtyTopology = true;
-            edge_select.hoveredEdge = -1;
-            edge_select.selectedEdge = -1;
-            script_error.clear();
-            rebuild_browser_lists_and_visibility();
+        bool scene_changed = false;
+        if (tab_scene_switched) {
+            tab_scene_switched = false;
+            adopt_new_scene();
+            scene_changed = true;
+            if (tab_scene_restored) vicad::log_event("SCRIPT_TAB_CACHED", 0, scene_session.script_path.c_str());
+        }
+        if (scene_session.last_mtime_ns == -1 && !cached_preview_shown) {
+            cached_preview_shown = true;
+            if (vicad_scene::SceneSessionShowCached(&scene_session, nullptr)) {
+                adopt_new_scene();
+                active_script_reload_requested = true;
+                vicad::log_event("SCRIPT_CACHED", 0, scene_session.script_path.c_str());
+                return true;
+            }
+        }
+        cached_preview_shown = false;
+        // The run, replay and meshing happen on the loader thread; the scene
+        // is swapped in by apply_loaded_scene_if_ready once it is done.
+        if (vicad_scene::SceneSessionStartReload(&scene_session, view_lod_policy())) {
+            vicad::log_event("SCRIPT_QUEUED", 0, scene_session.script_path.c_str());
+        }
+        return scene_changed;
+    };
+
+    auto apply_loaded_scene_if_ready = [&]() -> bool {
+        std::string load_err;
+        if (vicad_scene::SceneSessionTakeLoaded(&scene_session, &load_err)) {
+            adopt_new_scene();
             vicad::log_event("SCRIPT_LOADED", 0, scene_session.script_path.c_str());
-        } else {
-            script_error = reload_err;
-            vicad::log_event("SCRIPT_ERROR", 0, script_error.c_str());
+            return true;
         }
+        if (load_err.empty()) return false;
+        script_error = load_err;
+        vicad::log_event("SCRIPT_ERROR", 0, script_error.c_str());
         return true;
     };
 
+    // Swaps in the Model-quality replay of the previewed scene. Topology-based
+    // face and edge selections do not survive the new tessellation; object
+    // selection is carried over by objectId.
+    auto apply_refined_scene_if_ready = [&]() -> bool {
+        const uint64_t selected_id =
+            (selected_object_index >= 0 && selected_object_index < (int)script_scene.size())
+                ? script_scene[(size_t)selected_object_index].objectId
+                : 0;
+        const uint64_t hovered_id =
+            (hovered_object_index >= 0 && hovered_object_index < (int)script_scene.size())
+                ? script_scene[(size_t)hovered_object_index].objectId
+                : 0;
+        std::string refine_err;
+        if (!vicad_scene::SceneSessionTakeRefined(&scene_session, &refine_err)) {
+            if (!refine_err.empty()) vicad::log_event("SCRIPT_REFINE_ERROR", 0, refine_err.c_str());
+            return false;
+        }
+        mesh_bmin = scene_session.bounds_min;
+        mesh_bmax = scene_session.bounds_max;
+        retain_gpu_meshes(!scene_session.topology_changed);
+        const bool had_selected = selected_object_index >= 0;
+        const bool had_hovered = hovered_object_index >= 0;
+        selected_object_index = -1;
+        hovered_object_index = -1;
+        for (size_t i = 0; i < script_scene.size(); ++i) {
+            if (had_selected && script_scene[i].objectId == selected_id) selected_object_index = (int)i;
+            if (had_hovered && script_scene[i].objectId == hovered_id) hovered_object_index = (int)i;
+        }
+        if (selected_object_index < 0) object_selected = false;
+        invalidate_topology_if_changed();
+        vicad_scene::SceneSessionStartLodBuild(&scene_session);
+        rebuild_browser_lists_and_visibility();
+        vicad::log_event("SCRIPT_REFINED", 0, scene_session.script_path.c_str());
+        return true;
+    };
+
+    // The active script and every module its last run imported: an edit to
+    // any of them reloads the active tab, and no other tab runs.
     TabFileWatcher tab_file_watcher;
-    if (!active_tab_is_new_tab()) {
-        tab_file_watcher.SetWatchedPaths({scene_session.script_path});
-    } else {
-        tab_file_watcher.SetWatchedPaths({});
-    }
+    std::vector<std::string> watched_imports;
+    uint64_t watched_tab_cache_generation = 0;
+    auto update_watched_paths = [&]() {
+        watched_imports = scene_session.script_imports;
+        watched_tab_cache_generation = scene_session.tab_cache_generation;
+        std::vector<std::string> paths;
+        if (!active_tab_is_new_tab()) {
+            paths = watched_imports;
+            paths.push_back(scene_session.script_path);
+        }
+        // Cached tabs are rebuilt in the background when their files change.
+        for (const vicad_scene::SceneTabSnapshot &snap : scene_session.tab_cache) {
+            paths.push_back(snap.script_path);
+            paths.insert(paths.end(), snap.script_imports.begin(), snap.script_imports.end());
+        }
+        tab_file_watcher.SetWatchedPaths(paths);
+    };
+    update_watched_paths();
     rebuild_browser_lists_and_visibility();
     watch_paths_dirty = false;
 
+    bool first_frame_presented = false;
     while (!RGFW_window_shouldClose(win)) {
-        if (watch_paths_dirty) {
-            if (!active_tab_is_new_tab()) {
-                tab_file_watcher.SetWatchedPaths({scene_session.script_path});
-            } else {
-                tab_file_watcher.SetWatchedPaths({});
-            }
+        if (watch_paths_dirty || watched_imports != scene_session.script_imports ||
+            watched_tab_cache_generation != scene_session.tab_cache_generation) {
+            update_watched_paths();
             watch_paths_dirty = false;
         }
 
         std::vector<std::string> changed_paths;
         tab_file_watcher.DrainChangedPaths(&changed_paths);
         bool active_file_changed = false;
-        if (!active_tab_is_new_tab()) {
-            for (const std::string &path : changed_paths) {
-                if (path == scene_session.script_path) {
-                    active_file_changed = true;
-                    break;
-                }
+        bool cached_tab_changed = false;
+        for (const std::string &path : changed_paths) {
+            if (!active_tab_is_new_tab() &&
+                (path == scene_session.script_path ||
+                 std::find(watched_imports.begin(), watched_imports.end(), path) != watched_imports.end())) {
+                active_file_changed = true;
+            } else {
+                cached_tab_changed = true;
+            }
+        }
+        if (active_file_changed) {
+            active_script_reload_requested = true;
+            frame.Mark(vicad_frame::kDamageFileWatch);
+        }
+        if (cached_tab_changed) {
+            const size_t queued = vicad_scene::SceneSessionReloadCachedTabs(&scene_session, view_lod_policy());
+            if (queued > 0) {
+                vicad::log_event("SCRIPT_TABS_QUEUED", 0, ("count=" + std::to_string(queued)).c_str());
             }
         }
-        if (active_file_changed) active_script_reload_requested = true;
         if (active_script_reload_requested && !active_tab_is_new_tab()) {
             active_script_reload_requested = false;
-            if (reload_active_script_if_changed()) needs_redraw = true;
+            if (reload_active_script_if_changed()) frame.Mark(vicad_frame::kDamageScene | vicad_frame::kDamageUi);
+        }
+        if (apply_loaded_scene_if_ready()) frame.Mark(vicad_frame::kDamageScene | vicad_frame::kDamageUi);
+        if (apply_refined_scene_if_ready()) frame.Mark(vicad_frame::kDamageScene | vicad_frame::kDamageUi);
+        if (apply_analysis_if_ready()) frame.Mark(vicad_frame::kDamageScene);
+        if (vicad_scene::SceneSessionTakeLods(&scene_session)) frame.Mark(vicad_frame::kDamageViewport);
+        vicad_scene::SceneExportProgress export_progress;
+        if (export_pending_report && vicad_scene::SceneSessionExportProgress(scene_session, &export_progress) &&
+            export_progress.phase == vicad_scene::SceneExportPhase::Finished) {
+            export_pending_report = false;
+            if (export_progress.ok) {
+                vicad::log_event("EXPORT_DONE", 0, export_progress.path.c_str());
+            } else if (export_progress.cancelled) {
+                vicad::log_event("EXPORT_CANCELLED", 0, export_progress.path.c_str());
+            } else {
+                vicad::log_event("EXPORT_ERROR", 0, export_progress.error.c_str());
+            }
+        }
+        if (scene_session.target_lod.profile == vicad::LodProfile::View) {
+            const vicad::ReplayLodPolicy wanted = view_lod_policy();
+            if (vicad::LodViewLevelNeedsReplay(scene_session.target_lod.viewLevel, wanted.viewLevel)) {
+                (void)vicad_scene::SceneSessionRefineAt(&scene_session, wanted);
+            }
         }
 
-        if (!needs_redraw) {
-            RGFW_waitForEvent(16);
+        // Nothing to draw: sleep until input arrives or a background thread
+        // (file watcher, loader, refiner, export job) wakes the loop. After
+        // camera motion the wait ends at the settle deadline instead, so the
+        // full-quality frame is drawn once the camera comes to rest.
+        frame.Settle(std::chrono::steady_clock::now());
+        if (!frame.Dirty()) {
+            RGFW_waitForEvent(frame.WaitMs(std::chrono::steady_clock::now()));
         }
 
+        const Vec3 camera_target_before = target;
+        const float camera_yaw_before = yaw_deg;
+        const float camera_pitch_before = pitch_deg;
+        const float camera_distance_before = distance;
         while (RGFW_window_checkEvent(win, &event)) {
-            needs_redraw = true;
+            // Pointer motion and release only touch the UI (Clay hover and
+            // pressed states) and scrolling only the UI and the camera; camera
+            // moves are detected below and 3D hover changes by the frame's pick.
+            // Everything else may change what the viewport shows.
+            if (event.type == RGFW_mousePosChanged || event.type == RGFW_mouseButtonReleased) {
+                frame.Mark(vicad_frame::kDamageUi);
+            } else if (event.type == RGFW_mouseScroll) {
+                frame.Mark(vicad_frame::kDamageUi);
+            } else {
+                frame.Mark(vicad_frame::kDamageAll);
+            }
             if (event.type == RGFW_quit) break;
             if (event.type == RGFW_windowResized || event.type == RGFW_scaleUpdated) {
                 RGFW_window_getSizeInPixels(win, &width, &height);
@@ -3347,13 +2917,31 @@ static int AppRunLoop() {
             }
             if (event.type == RGFW_keyPressed) {
                 const RGFW_key key = event.key.value;
-                if (feature_detection_enabled && key == RGFW_e) {
+                const bool command_down = RGFW_window_isKeyDown(win, RGFW_superL) ||
+                                          RGFW_window_isKeyDown(win, RGFW_superR) ||
+                                          RGFW_window_isKeyDown(win, RGFW_controlL) ||
+                                          RGFW_window_isKeyDown(win, RGFW_controlR);
+                if (command_down && key == RGFW_e) {
+                    // Cmd/Ctrl+E exports in the background; again while running cancels.
+                    if (export_pending_report) {
+                        vicad_scene::SceneSessionCancelExport(&scene_session);
+                    } else if (!active_tab_is_new_tab()) {
+                        std::string export_err;
+                        const std::string export_path = vicad_runtime::MakeExport3mfFilename();
+                        if (vicad_scene::SceneSessionStartExport3mf(&scene_session, &worker_client, export_path,
+                                                                   &export_err)) {
+                            export_pending_report = true;
+                            vicad::log_event("EXPORT_STARTED", 0, export_path.c_str());
+                        } else {
+                            vicad::log_event("EXPORT_ERROR", 0, export_err.c_str());
+                        }
+                    }
+                } else if (feature_detection_enabled && key == RGFW_e) {
                     edge_select.enabled = !edge_select.enabled;
                     if (edge_select.enabled) {
                         face_select.enabled = false;
                         face_select.hoveredRegion = -1;
                         face_select.selectedRegion = -1;
-                        edge_select.dirtyTopology = true;
                     } else {
                         edge_select.hoveredEdge = -1;
                         edge_select.selectedEdge = -1;
@@ -3365,7 +2953,6 @@ static int AppRunLoop() {
                     if (face_select.enabled) {
                         edge_select.enabled = false;
                         edge_select.hoveredEdge = -1;
-                        face_select.dirty = true;
                     } else {
                         face_select.hoveredRegion = -1;
                         face_select.selectedRegion = -1;
@@ -3392,6 +2979,8 @@ static int AppRunLoop() {
                     pick_debug_overlay = !pick_debug_overlay;
                 } else if (key == RGFW_d) {
                     show_sketch_dimensions = !show_sketch_dimensions;
+                } else if (key == RGFW_h) {
+                    perf_hud = !perf_hud;
                 }
             }
             if (event.type == RGFW_mouseScroll) {
@@ -3515,6 +3104,7 @@ static int AppRunLoop() {
                             continue;
                         }
                         if (open_editor_tabs.size() > 1) {
+                            const std::string closed_path = open_editor_tabs[i];
                             active_editor_tab = close_tab_at(&open_editor_tabs, active_editor_tab, (int)i);
                             watch_paths_dirty = true;
                             if (active_editor_tab >= 0 && (size_t)active_editor_tab < open_editor_tabs.size()) {
@@ -3522,9 +3112,10 @@ static int AppRunLoop() {
                                     activate_script_path(open_editor_tabs[(size_t)active_editor_tab], false);
                                 } else {
                                     active_script_reload_requested = false;
-                                    needs_redraw = true;
+                                    frame.Mark(vicad_frame::kDamageAll);
                                 }
                             }
+                            vicad_scene::SceneSessionDropCached(&scene_session, closed_path);
                         }
                         tab_close_clicked = true;
                         break;
@@ -3547,7 +3138,7 @@ static int AppRunLoop() {
                                 activate_script_path(open_editor_tabs[i], false);
                             } else {
                                 active_script_reload_requested = false;
-                                needs_redraw = true;
+                                frame.Mark(vicad_frame::kDamageAll);
                             }
                         }
                         tab_switch_clicked = true;
@@ -3567,7 +3158,7 @@ static int AppRunLoop() {
                             if (open_editor_tabs.size() != prev_tab_count) {
                                 watch_paths_dirty = true;
                             }
-                            needs_redraw = true;
+                            frame.Mark(vicad_frame::kDamageAll);
                         }
                         continue;
                     }
@@ -3718,55 +3309,33 @@ static int AppRunLoop() {
                         continue;
                     }
 
-                    const Vec3 eye = camera_position(target, yaw_deg, pitch_deg, distance);
-                    const CameraBasis basis = camera_basis(eye, target);
-                    vicad_picking::PickContext pick_ctx = {};
-                    pick_ctx.viewport_width = width;
-                    pick_ctx.viewport_height = height;
-                    pick_ctx.fov_degrees = fov_degrees;
-                    pick_ctx.eye = eye;
-                    pick_ctx.basis = basis;
-                    const Vec3 ray_dir = vicad_picking::CameraRayDirection(mouse_px_x, mouse_px_y, pick_ctx);
-                    if (edge_select.enabled) {
+                    if (edge_select.enabled && !awaiting_analysis(edge_select.dirtyTopology)) {
+                        refresh_topology_mesh();
                         if (edge_select.dirtyTopology) {
-                            edge_select.edges = vicad::BuildEdgeTopology(mesh);
+                            edge_select.edges = vicad::BuildEdgeTopology(*topology_mesh, topology());
+                            edge_chunks_dirty = true;
                             edge_select.dirtyTopology = false;
                             if ((size_t)edge_select.selectedEdge >= edge_select.edges.edges.size()) {
                                 edge_select.selectedEdge = -1;
                             }
                         }
-                        edge_select.silhouette = vicad::ComputeSilhouetteEdges(
-                            mesh, edge_select.edges, (double)eye.x, (double)eye.y, (double)eye.z);
-                        const Vec3 diag = sub(mesh_bmax, mesh_bmin);
-                        const double bboxDiag = std::sqrt((double)dot(diag, diag));
-                        const double pickRadius = std::max(1e-4, bboxDiag * 0.012);
-                        const int edge = vicad::PickEdgeByRay(
-                            mesh, edge_select.edges, edge_select.silhouette,
-                            (double)eye.x, (double)eye.y, (double)eye.z,
-                            (double)ray_dir.x, (double)ray_dir.y, (double)ray_dir.z,
-                            pickRadius,
-                            nullptr);
+                        const int edge = id_pick(IdPickTarget::Edges, mouse_px_x, mouse_px_y);
                         edge_select.selectedEdge = edge;
                         object_selected = edge >= 0;
-                    } else if (face_select.enabled) {
+                    } else if (face_select.enabled && !awaiting_analysis(face_select.dirty)) {
+                        refresh_topology_mesh();
                         if (face_select.dirty) {
-                            face_select.faces = vicad::DetectMeshFaces(mesh, face_select.angleThresholdDeg);
+                            face_select.faces = detect_faces();
                             face_select.dirty = false;
+                            g_face_region_ids.Upload(face_select.faces.triRegion);
                         }
-                        const int region = vicad::PickFaceRegionByRay(
-                            mesh, face_select.faces,
-                            (double)eye.x, (double)eye.y, (double)eye.z,
-                            (double)ray_dir.x, (double)ray_dir.y, (double)ray_dir.z,
-                            nullptr);
+                        const int region = id_pick(IdPickTarget::FaceRegions, mouse_px_x, mouse_px_y);
                         face_select.selectedRegion = region;
                         object_selected = region >= 0;
                     } else {
-                        if (!script_scene.empty()) {
-                            selected_object_index = pick_scene_object_by_ray(script_scene, eye, ray_dir, &visible_mask);
-                            object_selected = selected_object_index >= 0;
-                        } else {
-                            object_selected = vicad_picking::PickMeshHit(mesh, eye, ray_dir);
-                        }
+                        const int picked = id_pick(IdPickTarget::Objects, mouse_px_x, mouse_px_y);
+                        if (!script_scene.empty()) selected_object_index = picked;
+                        object_selected = picked >= 0;
                     }
                 }
             }
@@ -3774,20 +3343,25 @@ static int AppRunLoop() {
 
         if (active_script_reload_requested && !active_tab_is_new_tab()) {
             active_script_reload_requested = false;
-            if (reload_active_script_if_changed()) needs_redraw = true;
+            if (reload_active_script_if_changed()) frame.Mark(vicad_frame::kDamageScene | vicad_frame::kDamageUi);
+        }
+        if (target.x != camera_target_before.x || target.y != camera_target_before.y ||
+            target.z != camera_target_before.z || yaw_deg != camera_yaw_before ||
+            pitch_deg != camera_pitch_before || distance != camera_distance_before) {
+            frame.CameraMoved(std::chrono::steady_clock::now());
         }
 
-        if (!needs_redraw) continue;
+        if (!frame.Dirty()) continue;
 
         const auto now = std::chrono::steady_clock::now();
-        if (now < next_frame_deadline) {
-            const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
-                next_frame_deadline - now);
-            const int wait_ms = (int)std::max<long long>(
-                1LL, std::min<long long>(16LL, remaining.count()));
-            RGFW_waitForEvent(wait_ms);
+        if (!frame.FrameDue(now)) {
+            RGFW_waitForEvent(frame.WaitMs(now));
             continue;
         }
+        vicad::TraceSpan frame_span("frame", "frame");
+        const auto frame_started = now;
+        // Reduced-quality frame while the camera is in motion (see FrameScheduler).
+        const bool interacting = frame.Interacting();
 
         if (height <= 0) height = 1;
         if (ui_height <= 0) ui_height = 1;
@@ -3841,80 +3415,68 @@ static int AppRunLoop() {
         ui_scroll_x = 0.0f;
         ui_scroll_y = 0.0f;
 
+        vicad::TraceSpan pick_span("frame", "hover_pick");
+        const int hovered_edge_before = edge_select.hoveredEdge;
+        const int hovered_region_before = face_select.hoveredRegion;
+        const int hovered_object_before = hovered_object_index;
+        const bool object_selected_before = object_selected;
         if (active_tab_is_new_tab()) {
             edge_select.hoveredEdge = -1;
             face_select.hoveredRegion = -1;
             hovered_object_index = -1;
             object_selected = false;
-        } else if (edge_select.enabled) {
+        } else if (edge_select.enabled && !awaiting_analysis(edge_select.dirtyTopology)) {
+            refresh_topology_mesh();
             if (edge_select.dirtyTopology) {
-                edge_select.edges = vicad::BuildEdgeTopology(mesh);
+                edge_select.edges = vicad::BuildEdgeTopology(*topology_mesh, topology());
+                edge_chunks_dirty = true;
                 edge_select.dirtyTopology = false;
                 if ((size_t)edge_select.selectedEdge >= edge_select.edges.edges.size()) {
                     edge_select.selectedEdge = -1;
                 }
             }
-            edge_select.silhouette = vicad::ComputeSilhouetteEdges(
-                mesh, edge_select.edges, (double)eye.x, (double)eye.y, (double)eye.z);
-            vicad_picking::PickContext pick_ctx = {};
-            pick_ctx.viewport_width = width;
-            pick_ctx.viewport_height = height;
-            pick_ctx.fov_degrees = fov_degrees;
-            pick_ctx.eye = eye;
-            pick_ctx.basis = basis;
-            const Vec3 ray_dir = vicad_picking::CameraRayDirection(mouse_px_x, mouse_px_y, pick_ctx);
-            const Vec3 diag = sub(mesh_bmax, mesh_bmin);
-            const double bboxDiag = std::sqrt((double)dot(diag, diag));
-            const double pickRadius = std::max(1e-4, bboxDiag * 0.012);
-            edge_select.hoveredEdge = vicad::PickEdgeByRay(
-                mesh, edge_select.edges, edge_select.silhouette,
-                (double)eye.x, (double)eye.y, (double)eye.z,
-                (double)ray_dir.x, (double)ray_dir.y, (double)ray_dir.z,
-                pickRadius,
-                nullptr);
+            if (!vicad_renderer3d::GpuSilhouettesSupported()) {
+                edge_select.silhouette = vicad::ComputeSilhouetteEdges(
+                    *topology_mesh, edge_select.edges, (double)eye.x, (double)eye.y, (double)eye.z);
+            }
+            edge_select.hoveredEdge = id_pick(IdPickTarget::Edges, mouse_px_x, mouse_px_y);
             face_select.hoveredRegion = -1;
             object_selected = edge_select.selectedEdge >= 0 || edge_select.hoveredEdge >= 0;
-        } else if (face_select.enabled) {
+        } else if (face_select.enabled && !awaiting_analysis(face_select.dirty)) {
+            refresh_topology_mesh();
             if (face_select.dirty) {
-                face_select.faces = vicad::DetectMeshFaces(mesh, face_select.angleThresholdDeg);
+                face_select.faces = detect_faces();
                 face_select.dirty = false;
+                g_face_region_ids.Upload(face_select.faces.triRegion);
                 if ((size_t)face_select.selectedRegion >= face_select.faces.regions.size()) {
                     face_select.selectedRegion = -1;
                 }
             }
-            vicad_picking::PickContext pick_ctx = {};
-            pick_ctx.viewport_width = width;
-            pick_ctx.viewport_height = height;
-            pick_ctx.fov_degrees = fov_degrees;
-            pick_ctx.eye = eye;
-            pick_ctx.basis = basis;
-            const Vec3 ray_dir = vicad_picking::CameraRayDirection(mouse_px_x, mouse_px_y, pick_ctx);
-            face_select.hoveredRegion = vicad::PickFaceRegionByRay(
-                mesh, face_select.faces,
-                (double)eye.x, (double)eye.y, (double)eye.z,
-                (double)ray_dir.x, (double)ray_dir.y, (double)ray_dir.z,
-                nullptr);
+            face_select.hoveredRegion = id_pick(IdPickTarget::FaceRegions, mouse_px_x, mouse_px_y);
             edge_select.hoveredEdge = -1;
             hovered_object_index = -1;
         } else {
             edge_select.hoveredEdge = -1;
             face_select.hoveredRegion = -1;
             if (!script_scene.empty()) {
-                vicad_picking::PickContext pick_ctx = {};
-                pick_ctx.viewport_width = width;
-                pick_ctx.viewport_height = height;
-                pick_ctx.fov_degrees = fov_degrees;
-                pick_ctx.eye = eye;
-                pick_ctx.basis = basis;
-                const Vec3 ray_dir = vicad_picking::CameraRayDirection(mouse_px_x, mouse_px_y, pick_ctx);
-                hovered_object_index = pick_scene_object_by_ray(script_scene, eye, ray_dir, &visible_mask);
+                hovered_object_index = id_pick(IdPickTarget::Objects, mouse_px_x, mouse_px_y);
                 object_selected = (selected_object_index >= 0 || hovered_object_index >= 0);
             } else {
                 hovered_object_index = -1;
             }
         }
+        if (edge_select.hoveredEdge != hovered_edge_before || face_select.hoveredRegion != hovered_region_before ||
+            hovered_object_index != hovered_object_before || object_selected != object_selected_before) {
+            frame.Mark(vicad_frame::kDamageHover);
+        }
 
+        pick_span.End();
+
+        vicad::TraceSpan ui_layout_span("frame", "ui_layout");
         rebuild_browser_lists_and_visibility();
+        // A full glyph atlas starts over between frames, never under a
+        // batch; the frame that ran out was missing glyphs, so redraw all.
+        if (g_text.BeginFrame()) frame.Mark(vicad_frame::kDamageAll);
         const bool show_new_tab_view = active_tab_is_new_tab();
         Clay_RenderCommandArray ui_cmds = build_clay_ui(
             ui_width, ui_height,
@@ -3932,43 +3494,123 @@ static int AppRunLoop() {
             sketches_collapsed,
             bodies_visible,
             sketches_visible,
-            per_object_visible);
-
-        if (!show_new_tab_view) {
+            per_object_visible,
+            perf_hud ? perf_hud_lines(scene_session.run_stats, last_frame_ms) : std::vector<std::string>());
+        ui_layout_span.End();
+
+        vicad::TraceSpan viewport_span("frame", "viewport");
+        // The pick debug crosshair follows the pointer, so it is drawn over
+        // the viewport layer rather than captured into it.
+        const bool redraw_viewport = frame.ViewportDirty() || !g_viewport_layer.Valid(width, height);
+        if (!show_new_tab_view && !redraw_viewport) {
+            g_viewport_layer.Draw();
+        } else if (!show_new_tab_view) {
+            const vicad_cull::ViewFrustum frustum = vicad_cull::BuildViewFrustum(
+                eye, basis, fov_degrees, (float)width / (float)height, 0.1f, 5000.0f);
+            view_mask.assign(script_scene.size(), 0);
+            for (size_t i = 0; i < script_scene.size() && i < visible_mask.size(); ++i) {
+                if (visible_mask[i] == 0) continue;
+                const vicad::ScriptSceneObject &obj = script_scene[i];
+                Vec3 bmin = {obj.bmin.x, obj.bmin.y, obj.bmin.z};
+                Vec3 bmax = {obj.bmax.x, obj.bmax.y, obj.bmax.z};
+                if (scene_object_is_sketch(obj)) {
+                    // Dimension labels and leaders extend past the contours.
+                    const Vec3 pad = mul(sub(bmax, bmin), 0.5f);
+                    bmin = sub(bmin, pad);
+                    bmax = add(bmax, pad);
+                }
+                view_mask[i] = vicad_cull::BoxInFrustum(frustum, bmin, bmax) ? 1 : 0;
+            }
             draw_grid(target, distance, fov_degrees, width, height);
             if (script_scene.empty()) {
-                draw_mesh(mesh);
+                draw_mesh(*topology_mesh);
             } else {
+                instance_draws.clear();
                 for (size_t i = 0; i < script_scene.size(); ++i) {
-                    if (i >= visible_mask.size() || visible_mask[i] == 0) continue;
-                    if (!scene_object_is_manifold(script_scene[i])) continue;
-                    draw_mesh(script_scene[i].mesh);
+                    if (view_mask[i] == 0) continue;
+                    const vicad::ScriptSceneObject &obj = script_scene[i];
+                    if (!scene_object_is_manifold(obj)) continue;
+                    // Small or distant objects, and everything while the
+                    // camera moves, draw a decimated level once one is built;
+                    // picking and export keep the full mesh.
+                    const int lod = scene_object_lod(obj, eye, fov_degrees, height, interacting);
+                    if (!obj.instance) {
+                        if (lod > 0) {
+                            const vicad::MeshLodLevel &level = obj.lodChain->levels[(size_t)lod - 1];
+                            draw_mesh(level.mesh, &level.derived);
+                        } else {
+                            draw_mesh(vicad::SceneObjectMesh(obj), &vicad::SceneObjectDerived(obj));
+                        }
+                        continue;
+                    }
+                    const std::pair<const vicad::SceneInstanceGeometry *, int> key(obj.instance.get(), lod);
+                    auto group = std::find_if(instance_draws.begin(), instance_draws.end(),
+                                              [&](const auto &d) { return d.first == key; });
+                    if (group == instance_draws.end()) {
+                        instance_draws.emplace_back(key, std::vector<vicad_renderer3d::MeshInstance>());
+                        group = instance_draws.end() - 1;
+                    }
+                    group->second.push_back(scene_object_mesh_instance(obj));
+                }
+                for (const auto &draw : instance_draws) {
+                    const vicad::SceneInstanceGeometry &geom = *draw.first.first;
+                    if (draw.first.second > 0) {
+                        const vicad::MeshLodLevel &level = geom.lodChain->levels[(size_t)draw.first.second - 1];
+                        draw_mesh_instances(level.mesh, level.derived, draw.second);
+                    } else {
+                        draw_mesh_instances(vicad::SceneInstanceMesh(geom), vicad::SceneInstanceDerived(geom),
+                                            draw.second);
+                    }
                 }
             }
-            draw_script_sketches(script_scene, selected_object_index, hovered_object_index, &visible_mask);
-            if (feature_detection_enabled && edge_select.enabled) {
-                draw_feature_edges(mesh, edge_select.edges);
-                draw_silhouette_edges(mesh, edge_select.edges, edge_select.silhouette);
+            draw_script_sketches(script_scene, selected_object_index, hovered_object_index, &view_mask);
+            // Picks fall back to whole objects while the analysis is pending,
+            // so those get the object highlight.
+            const bool topology_pending = (edge_select.enabled && awaiting_analysis(edge_select.dirtyTopology)) ||
+                                          (face_select.enabled && awaiting_analysis(face_select.dirty));
+            if (feature_detection_enabled && edge_select.enabled && !edge_select.dirtyTopology) {
+                if (edge_chunks_dirty) {
+                    feature_edge_chunks =
+                        vicad_cull::BuildEdgeChunks(*topology_mesh, edge_select.edges,
+                                                    edge_select.edges.featureEdgeIndices);
+                    non_manifold_edge_chunks =
+                        vicad_cull::BuildEdgeChunks(*topology_mesh, edge_select.edges,
+                                                    edge_select.edges.nonManifoldEdgeIndices);
+                    g_feature_edge_lines.Upload(
+                        edge_segments(*topology_mesh, edge_select.edges, feature_edge_chunks.edges));
+                    g_non_manifold_edge_lines.Upload(
+                        edge_segments(*topology_mesh, edge_select.edges, non_manifold_edge_chunks.edges));
+                    edge_chunks_dirty = false;
+                }
+                vicad_cull::CollectVisibleRanges(feature_edge_chunks, frustum, &view_feature_ranges);
+                vicad_cull::CollectVisibleRanges(non_manifold_edge_chunks, frustum, &view_non_manifold_ranges);
+                // Edge overlays wait for the camera to settle; the hovered
+                // and selected edges are few and stay.
+                if (!interacting) {
+                    draw_feature_edges(view_feature_ranges, view_non_manifold_ranges);
+                    draw_silhouette_edges(*topology_mesh, edge_select.edges, edge_select.silhouette, eye, frustum,
+                                          view_feature_ranges);
+                }
                 if (edge_select.hoveredEdge >= 0 &&
                            edge_select.hoveredEdge != edge_select.selectedEdge) {
-                    draw_hovered_edge(mesh, edge_select.edges, edge_select.hoveredEdge);
+                    draw_hovered_edge(*topology_mesh, edge_select.edges, edge_select.hoveredEdge);
                 }
                 if (edge_select.selectedEdge >= 0) {
-                    draw_selected_edge(mesh, edge_select.edges, edge_select.selectedEdge);
+                    draw_selected_edge(*topology_mesh, edge_select.edges, edge_select.selectedEdge);
                 }
             }
             if (feature_detection_enabled && face_select.enabled) {
                 if (face_select.hoveredRegion >= 0 &&
                     face_select.hoveredRegion != face_select.selectedRegion) {
-                    draw_face_region_overlay(mesh, face_select.faces, face_select.hoveredRegion,
+                    draw_face_region_overlay(*topology_mesh, face_select.faces, face_select.hoveredRegion,
                                              0.34f, 0.66f, 1.00f, 0.18f);
                 }
                 if (face_select.selectedRegion >= 0) {
-                    draw_face_region_overlay(mesh, face_select.faces, face_select.selectedRegion,
+                    draw_face_region_overlay(*topology_mesh, face_select.faces, face_select.selectedRegion,
                                              0.22f, 0.52f, 0.98f, 0.32f);
                 }
             }
-            if (object_selected && !face_select.enabled && !edge_select.enabled) {
+            if (object_selected && ((!face_select.enabled && !edge_select.enabled) || topology_pending)) {
                 const bool selected_visible =
                     selected_object_index >= 0 &&
                     (size_t)selected_object_index < visible_mask.size() &&
@@ -3982,17 +3624,19 @@ static int AppRunLoop() {
                     selected_visible) {
                     const vicad::ScriptSceneObject &obj = script_scene[(size_t)selected_object_index];
                     if (scene_object_is_manifold(obj)) {
-                        draw_mesh_selection_overlay(obj.mesh, 0.22f, 0.52f, 0.98f, 0.28f);
+                        draw_mesh_selection_overlay(vicad::SceneObjectMesh(obj), &vicad::SceneObjectDerived(obj),
+                                                    0.22f, 0.52f, 0.98f, 0.28f);
                     }
                 } else if (hovered_object_index >= 0 &&
                            (size_t)hovered_object_index < script_scene.size() &&
                            hovered_visible) {
                     const vicad::ScriptSceneObject &obj = script_scene[(size_t)hovered_object_index];
                     if (scene_object_is_manifold(obj)) {
-                        draw_mesh_selection_overlay(obj.mesh, 0.34f, 0.66f, 1.00f, 0.16f);
+                        draw_mesh_selection_overlay(vicad::SceneObjectMesh(obj), &vicad::SceneObjectDerived(obj),
+                                                    0.34f, 0.66f, 1.00f, 0.16f);
                     }
                 } else if (script_scene.empty()) {
-                    draw_mesh_selection_overlay(mesh, 0.22f, 0.52f, 0.98f, 0.28f);
+                    draw_mesh_selection_overlay(*topology_mesh, nullptr, 0.22f, 0.52f, 0.98f, 0.28f);
                 }
             }
             DimensionRenderContext dim_ctx = {};
@@ -4001,24 +3645,51 @@ static int AppRunLoop() {
             dim_ctx.fovDegrees = fov_degrees;
             dim_ctx.viewportHeight = height;
             dim_ctx.arrowPixels = 4.0f;
-            draw_script_sketch_dimensions(script_scene, selected_object_index, dim_ctx, show_sketch_dimensions, &visible_mask);
-            if (pick_debug_overlay) {
-                draw_pick_debug_overlay(width, height, window_w, window_h,
-                                        mouse_x, mouse_y, mouse_px_x, mouse_px_y);
-            }
+            // Dimension layout and label shaping are skipped while the camera
+            // moves; the sketch contours themselves are still drawn.
+            draw_script_sketch_dimensions(script_scene, selected_object_index, dim_ctx,
+                                          show_sketch_dimensions && !interacting, &view_mask);
             draw_orientation_cube(basis, width, height, hud_scale);
+            g_viewport_layer.Capture(width, height);
+        }
+        if (!show_new_tab_view && pick_debug_overlay) {
+            draw_pick_debug_overlay(width, height, window_w, window_h,
+                                    mouse_x, mouse_y, mouse_px_x, mouse_px_y);
+        }
+        viewport_span.End();
+        {
+            vicad::TraceSpan span("frame", "ui_render");
+            clay_render_commands(ui_cmds, width, height, ui_scale);
         }
-        clay_render_commands(ui_cmds, width, height, ui_scale);
 
+        vicad::TraceSpan swap_span("frame", "swap");
         RGFW_window_swapBuffers_OpenGL(win);
-        next_frame_deadline = std::chrono::steady_clock::now() + frame_interval;
-        needs_redraw = false;
+        swap_span.End();
+        last_frame_ms =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_started).count();
+        if (!first_frame_presented) {
+            first_frame_presented = true;
+            log_startup_phase("first_frame");
+        }
+        frame.FramePresented(std::chrono::steady_clock::now());
     }
 
-    #ifdef VICAD_HAS_HARFBUZZ
-    destroy_hb_text_state();
-    #endif
+    g_viewport_layer.Clear();
+    g_face_region_ids.Clear();
+    g_feature_edge_lines.Clear();
+    g_non_manifold_edge_lines.Clear();
+    g_mesh_buffers.Clear();
+    g_ui_batch.Clear();
+    g_text.Shutdown();
     RGFW_window_close(win);
+    if (vicad::trace_enabled()) {
+        std::string trace_err;
+        if (vicad::trace_write(trace_path, &trace_err)) {
+            vicad::log_event("TRACE_WRITTEN", 0, trace_path);
+        } else {
+            vicad::log_event("TRACE_FAILED", 0, trace_err.c_str());
+        }
+    }
     return 0;
 }
 
@@ -0,0 +1,272 @@
+// batch_build.cpp
+//
+// Runs many .vicad.ts scripts headlessly on a pool of workers, replays each
+// at one LOD profile and writes its manifold objects as a 3MF package, then
+// reports every file with its timings as one JSON line on stdout.  Worker
+// lifecycle events go to stderr (structured JSON via vicad::log_event).
+//
+// Usage:  build/batch_build [options] <script or glob>...
+//   --jobs=N     worker processes (default: half the cores)
+//   --lod=P      draft | model | export (default: export)
+//   --out=DIR    directory the <name>.3mf files are written to (default: build/batch)
+//   --no-output  run and replay only, write nothing
+//   --list=FILE  also read scripts (or globs) from FILE, one per line
+//
+// Globs are expanded here as well, so they can be passed quoted from CI.
+//
+// Exit codes:
+//   0  — every script ran (and was written); stdout has a "pass" summary
+//   1  — some script failed, or usage error; stdout has a "fail" summary
+
+#include <glob.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "json_escape.h"
+#include "lod_policy.h"
+#include "script_worker_client.h"
+#include "threemf_writer.h"
+
+namespace {
+
+struct Options {
+  size_t jobs = 0;
+  vicad::ReplayLodPolicy lod = {};
+  std::string out_dir = "build/batch";
+  bool write_output = true;
+  std::vector<std::string> scripts;
+};
+
+struct FileResult {
+  bool ok = false;
+  std::string output;
+  std::string error;
+  size_t objects = 0;
+  size_t triangles = 0;
+  double run_ms = 0.0;
+  double write_ms = 0.0;
+};
+
+double ms_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+const char *lod_name(vicad::LodProfile profile) {
+  switch (profile) {
+    case vicad::LodProfile::Draft: return "draft";
+    case vicad::LodProfile::Model: return "model";
+    case vicad::LodProfile::Export3MF: return "export";
+    case vicad::LodProfile::View: return "view";
+  }
+  return "model";
+}
+
+bool parse_lod(const char *name, vicad::LodProfile *out) {
+  if (std::strcmp(name, "draft") == 0) *out = vicad::LodProfile::Draft;
+  else if (std::strcmp(name, "model") == 0) *out = vicad::LodProfile::Model;
+  else if (std::strcmp(name, "export") == 0) *out = vicad::LodProfile::Export3MF;
+  else return false;
+  return true;
+}
+
+// Appends `arg`, or the files it matches when it is a glob pattern.
+void add_script(const std::string &arg, std::vector<std::string> *scripts) {
+  if (arg.find_first_of("*?[") == std::string::npos) {
+    scripts->push_back(arg);
+    return;
+  }
+  glob_t matches = {};
+  if (glob(arg.c_str(), 0, nullptr, &matches) == 0) {
+    for (size_t i = 0; i < matches.gl_pathc; ++i) scripts->push_back(matches.gl_pathv[i]);
+  }
+  globfree(&matches);
+}
+
+bool parse_args(int argc, char **argv, Options *opt, std::string *error) {
+  opt->lod.profile = vicad::LodProfile::Export3MF;
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if (std::strncmp(arg, "--jobs=", 7) == 0) {
+      opt->jobs = (size_t)std::strtoull(arg + 7, nullptr, 10);
+    } else if (std::strncmp(arg, "--lod=", 6) == 0) {
+      if (!parse_lod(arg + 6, &opt->lod.profile)) {
+        *error = std::string("unknown LOD profile: ") + (arg + 6);
+        return false;
+      }
+    } else if (std::strncmp(arg, "--out=", 6) == 0) {
+      opt->out_dir = arg + 6;
+    } else if (std::strcmp(arg, "--no-output") == 0) {
+      opt->write_output = false;
+    } else if (std::strncmp(arg, "--list=", 7) == 0) {
+      std::ifstream list(arg + 7);
+      if (!list) {
+        *error = std::string("cannot read list file: ") + (arg + 7);
+        return false;
+      }
+      std::string line;
+      while (std::getline(list, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty() && line[0] != '#') add_script(line, &opt->scripts);
+      }
+    } else if (std::strncmp(arg, "--", 2) == 0) {
+      *error = std::string("unknown option: ") + arg;
+      return false;
+    } else {
+      add_script(arg, &opt->scripts);
+    }
+  }
+  if (opt->scripts.empty()) {
+    *error = "no scripts given";
+    return false;
+  }
+  if (opt->jobs == 0) opt->jobs = std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, 8);
+  opt->jobs = std::min(opt->jobs, opt->scripts.size());
+  return true;
+}
+
+// <out_dir>/<script name without .vicad.ts>.3mf, made unique when two scripts
+// in different directories share a name.
+std::vector<std::string> output_paths(const Options &opt) {
+  std::vector<std::string> paths;
+  std::vector<std::string> taken;
+  for (const std::string &script : opt.scripts) {
+    std::string stem = std::filesystem::path(script).filename().string();
+    for (const char *ext : {".vicad.ts", ".ts"}) {
+      const size_t len = std::strlen(ext);
+      if (stem.size() > len && stem.compare(stem.size() - len, len, ext) == 0) {
+        stem.resize(stem.size() - len);
+        break;
+      }
+    }
+    std::string name = stem;
+    for (int n = 2; std::find(taken.begin(), taken.end(), name) != taken.end(); ++n) {
+      name = stem + "-" + std::to_string(n);
+    }
+    taken.push_back(name);
+    paths.push_back((std::filesystem::path(opt.out_dir) / (name + ".3mf")).string());
+  }
+  return paths;
+}
+
+bool write_3mf(const std::vector<vicad::ScriptSceneObject> &objects, const std::string &path,
+               size_t *triangles, std::string *error) {
+  const std::string part_path = path + ".part";
+  vicad::ThreeMfWriter writer;
+  auto fail = [&](std::string why) {
+    writer.Abort();
+    std::remove(part_path.c_str());
+    *error = std::move(why);
+    return false;
+  };
+  if (!writer.Open(part_path, error)) return fail(*error);
+  for (const vicad::ScriptSceneObject &obj : objects) {
+    if (obj.kind != vicad::ScriptSceneObjectKind::Manifold) continue;
+    if (obj.manifold.Status() != manifold::Manifold::Error::NoError) {
+      return fail("scene object " + obj.name + " failed with status " +
+                  std::to_string((int)obj.manifold.Status()));
+    }
+    const manifold::MeshGL mesh = obj.manifold.GetMeshGL();
+    *triangles += mesh.NumTri();
+    if (!writer.WriteObject(obj.name, mesh, error)) return fail(*error);
+  }
+  if (writer.object_count() == 0) return fail("scene has no manifold geometry to export");
+  if (!writer.Finish(error)) return fail(*error);
+  if (std::rename(part_path.c_str(), path.c_str()) != 0) return fail("cannot rename " + part_path);
+  return true;
+}
+
+void build_one(vicad::ScriptWorkerClient *client, const Options &opt, const std::string &script,
+               const std::string &output, FileResult *out) {
+  std::vector<vicad::ScriptSceneObject> objects;
+  const auto run_start = std::chrono::steady_clock::now();
+  out->ok = client->ExecuteScriptScene(script.c_str(), &objects, &out->error, opt.lod);
+  out->run_ms = ms_since(run_start);
+  out->objects = objects.size();
+  if (!out->ok || !opt.write_output) return;
+  const auto write_start = std::chrono::steady_clock::now();
+  out->ok = write_3mf(objects, output, &out->triangles, &out->error);
+  out->write_ms = ms_since(write_start);
+  if (out->ok) out->output = output;
+}
+
+void print_summary(const Options &opt, const std::vector<FileResult> &results, double total_ms) {
+  const size_t failed = (size_t)std::count_if(results.begin(), results.end(),
+                                              [](const FileResult &r) { return !r.ok; });
+  std::fprintf(stdout, "{\"result\":\"%s\",\"lod\":\"%s\",\"jobs\":%zu,\"passed\":%zu,\"failed\":%zu,"
+               "\"total_ms\":%.1f,\"files\":[",
+               failed == 0 ? "pass" : "fail", lod_name(opt.lod.profile), opt.jobs, results.size() - failed,
+               failed, total_ms);
+  for (size_t i = 0; i < results.size(); ++i) {
+    const FileResult &r = results[i];
+    std::fprintf(stdout, "%s{\"script\":\"", i == 0 ? "" : ",");
+    vicad::write_json_escaped(stdout, opt.scripts[i].c_str());
+    std::fprintf(stdout, "\",\"result\":\"%s\",\"objects\":%zu,\"triangles\":%zu,\"run_ms\":%.1f,\"write_ms\":%.1f",
+                 r.ok ? "pass" : "fail", r.objects, r.triangles, r.run_ms, r.write_ms);
+    if (!r.output.empty()) {
+      std::fprintf(stdout, ",\"output\":\"");
+      vicad::write_json_escaped(stdout, r.output.c_str());
+      std::fprintf(stdout, "\"");
+    }
+    if (!r.ok) {
+      std::fprintf(stdout, ",\"error\":\"");
+      vicad::write_json_escaped(stdout, r.error.c_str());
+      std::fprintf(stdout, "\"");
+    }
+    std::fprintf(stdout, "}");
+  }
+  std::fprintf(stdout, "]}\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  std::string error;
+  if (!parse_args(argc, argv, &opt, &error)) {
+    std::fprintf(stderr, "usage: batch_build [--jobs=N] [--lod=draft|model|export] [--out=DIR] [--no-output] "
+                         "[--list=FILE] <script or glob>...\n");
+    std::fprintf(stdout, "{\"result\":\"fail\",\"error\":\"");
+    vicad::write_json_escaped(stdout, error.c_str());
+    std::fprintf(stdout, "\"}\n");
+    return 1;
+  }
+  std::error_code mkdir_err;
+  if (opt.write_output && !std::filesystem::create_directories(opt.out_dir, mkdir_err) && mkdir_err) {
+    std::fprintf(stdout, "{\"result\":\"fail\",\"error\":\"cannot create output directory\"}\n");
+    return 1;
+  }
+
+  const std::vector<std::string> outputs = output_paths(opt);
+  std::vector<FileResult> results(opt.scripts.size());
+  std::atomic<size_t> next{0};
+  const auto start = std::chrono::steady_clock::now();
+  // One worker process per thread; scripts are handed out in order as workers
+  // free up. Each client keeps its replay cache across the scripts it runs, so
+  // variants of one part reuse their shared subtrees.
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < opt.jobs; ++t) {
+    threads.emplace_back([&] {
+      vicad::ScriptWorkerClient client;
+      // Runs never need a quick restart, so a standby would only double the
+      // number of Bun processes.
+      client.set_standby_enabled(false);
+      for (size_t i = next.fetch_add(1); i < opt.scripts.size(); i = next.fetch_add(1)) {
+        build_one(&client, opt, opt.scripts[i], outputs[i], &results[i]);
+      }
+    });
+  }
+  for (std::thread &thread : threads) thread.join();
+
+  print_summary(opt, results, ms_since(start));
+  return std::all_of(results.begin(), results.end(), [](const FileResult &r) { return r.ok; }) ? 0 : 1;
+}
@@ -0,0 +1,513 @@
+// bench.cpp
+//
+// Times the replay, topology and picking hot paths on deterministic synthetic
+// workloads, plus one end-to-end IPC round trip, and reports every benchmark
+// as one JSON line on stdout so runs can be diffed across commits.  Progress
+// and worker lifecycle events go to stderr (structured JSON via
+// vicad::log_event).
+//
+// Usage:  build/bench [options]        (or ./nob bench [options])
+//   --iters=N      timed iterations per benchmark after one warm-up (default: 7)
+//   --filter=S     only run benchmarks whose name contains S
+//   --large        also run the 5M-triangle mesh set
+//   --no-ipc       skip the IPC round trip (no Bun needed)
+//   --script=PATH  script for the IPC round trip (default: sketch-fillet-example.vicad.ts)
+//
+// Each benchmark reports median/p95/min wall time, the median number and size
+// of heap allocations per iteration, and the process peak RSS after it ran
+// (peak so far, so it only ever grows down the list).
+//
+// Exit codes:
+//   0  — every benchmark ran; stdout has a "pass" line
+//   1  — some benchmark failed, or usage error; stdout has a "fail" line
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "edge_detection.h"
+#include "face_detection.h"
+#include "ipc_protocol.h"
+#include "json_escape.h"
+#include "lod_policy.h"
+#include "log.h"
+#include "mesh_bvh.h"
+#include "mesh_topology.h"
+#include "op_decoder.h"
+#include "replay_stream.h"
+#include "script_worker_client.h"
+
+// Every heap allocation of the process goes through here, so the counters
+// cover manifold and the pool threads too.
+namespace {
+std::atomic<uint64_t> g_alloc_count{0};
+std::atomic<uint64_t> g_alloc_bytes{0};
+}  // namespace
+
+void *operator new(size_t size) {
+  g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+  g_alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (void *p = std::malloc(size == 0 ? 1 : size)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+struct Options {
+  int iters = 7;
+  std::string filter;
+  bool large = false;
+  bool ipc = true;
+  std::string script = "sketch-fillet-example.vicad.ts";
+};
+
+struct BenchResult {
+  std::string name;
+  bool ok = true;
+  std::string error;
+  size_t items = 0;  // triangles, ops or rays one iteration handles
+  double median_ms = 0.0;
+  double p95_ms = 0.0;
+  double min_ms = 0.0;
+  uint64_t allocs = 0;
+  uint64_t alloc_bytes = 0;
+  long peak_rss_kb = 0;
+};
+
+long peak_rss_kb() {
+  struct rusage usage = {};
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;  // bytes on macOS
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+template <typename T>
+T median_of(std::vector<T> v) {
+  std::sort(v.begin(), v.end());
+  return v[v.size() / 2];
+}
+
+// Nearest-rank percentile of an unsorted sample.
+double percentile(std::vector<double> v, double p) {
+  std::sort(v.begin(), v.end());
+  const size_t rank = (size_t)std::ceil(p * (double)v.size());
+  return v[std::min(v.size() - 1, rank == 0 ? 0 : rank - 1)];
+}
+
+class Runner {
+ public:
+  explicit Runner(const Options &opt) : opt_(opt) {}
+
+  bool wants(const char *name) const { return opt_.filter.empty() || std::strstr(name, opt_.filter.c_str()); }
+
+  // Runs `fn` once untimed and then opt.iters times. `fn` returns false and
+  // sets the error when the workload itself failed.
+  template <typename Fn>
+  void run(const std::string &name, size_t items, Fn &&fn) {
+    if (!wants(name.c_str())) return;
+    BenchResult r;
+    r.name = name;
+    r.items = items;
+    std::vector<double> ms;
+    std::vector<uint64_t> allocs;
+    std::vector<uint64_t> bytes;
+    for (int i = 0; i <= opt_.iters && r.ok; ++i) {
+      const uint64_t count0 = g_alloc_count.load(std::memory_order_relaxed);
+      const uint64_t bytes0 = g_alloc_bytes.load(std::memory_order_relaxed);
+      const auto start = std::chrono::steady_clock::now();
+      r.ok = fn(&r.error);
+      const auto stop = std::chrono::steady_clock::now();
+      const double elapsed = std::chrono::duration<double, std::milli>(stop - start).count();
+      if (i == 0) continue;
+      ms.push_back(elapsed);
+      allocs.push_back(g_alloc_count.load(std::memory_order_relaxed) - count0);
+      bytes.push_back(g_alloc_bytes.load(std::memory_order_relaxed) - bytes0);
+    }
+    if (r.ok && !ms.empty()) {
+      r.median_ms = median_of(ms);
+      r.p95_ms = percentile(ms, 0.95);
+      r.min_ms = *std::min_element(ms.begin(), ms.end());
+      r.allocs = median_of(allocs);
+      r.alloc_bytes = median_of(bytes);
+    }
+    r.peak_rss_kb = peak_rss_kb();
+    // Progress goes through the event log so stderr stays one JSON object per
+    // line.
+    std::string details = "name=" + name;
+    if (r.ok) {
+      char median[48];
+      std::snprintf(median, sizeof(median), " median_ms=%.3f", r.median_ms);
+      details += median;
+    } else {
+      details += " failed";
+    }
+    vicad::log_event("BENCH_DONE", 0, details.c_str());
+    results_.push_back(std::move(r));
+  }
+
+  const std::vector<BenchResult> &results() const { return results_; }
+
+ private:
+  const Options &opt_;
+  std::vector<BenchResult> results_;
+};
+
+// ---------------------------------------------------------------------------
+// Op streams (same record layout as lod_replay_test)
+
+template <typename T>
+void append_pod(std::vector<uint8_t> *out, const T &v) {
+  const size_t at = out->size();
+  out->resize(at + sizeof(T));
+  std::memcpy(out->data() + at, &v, sizeof(T));
+}
+
+struct OpStream {
+  std::vector<uint8_t> records;
+  uint32_t op_count = 0;
+  uint32_t next_id = 1;
+  uint32_t root_id = 0;
+
+  // Starts a record; the caller appends its payload after the output id.
+  uint32_t begin(std::vector<uint8_t> *payload) {
+    payload->clear();
+    const uint32_t id = next_id++;
+    append_pod(payload, id);
+    return id;
+  }
+
+  void end(vicad::OpCode opcode, const std::vector<uint8_t> &payload) {
+    vicad::OpRecordHeader hdr = {};
+    hdr.opcode = (uint16_t)opcode;
+    hdr.payload_len = (uint32_t)payload.size();
+    append_pod(&records, hdr);
+    records.insert(records.end(), payload.begin(), payload.end());
+    op_count++;
+  }
+
+  uint32_t cube(double x, double y, double z) {
+    std::vector<uint8_t> p;
+    const uint32_t id = begin(&p);
+    append_pod(&p, x);
+    append_pod(&p, y);
+    append_pod(&p, z);
+    append_pod(&p, (uint32_t)0);
+    end(vicad::OpCode::Cube, p);
+    return id;
+  }
+
+  uint32_t cylinder(double h, double r) {
+    std::vector<uint8_t> p;
+    const uint32_t id = begin(&p);
+    append_pod(&p, h);
+    append_pod(&p, r);
+    append_pod(&p, r);
+    append_pod(&p, (uint32_t)0);
+    append_pod(&p, (uint32_t)0);
+    end(vicad::OpCode::Cylinder, p);
+    return id;
+  }
+
+  uint32_t translate(uint32_t in, double x, double y, double z) {
+    std::vector<uint8_t> p;
+    const uint32_t id = begin(&p);
+    append_pod(&p, in);
+    append_pod(&p, x);
+    append_pod(&p, y);
+    append_pod(&p, z);
+    end(vicad::OpCode::Translate, p);
+    return id;
+  }
+
+  uint32_t subtract(uint32_t a, uint32_t b) {
+    std::vector<uint8_t> p;
+    const uint32_t id = begin(&p);
+    append_pod(&p, a);
+    append_pod(&p, b);
+    end(vicad::OpCode::Subtract, p);
+    return id;
+  }
+
+  uint32_t unite(const std::vector<uint32_t> &ids) {
+    std::vector<uint8_t> p;
+    const uint32_t id = begin(&p);
+    append_pod(&p, (uint32_t)ids.size());
+    for (uint32_t in : ids) append_pod(&p, in);
+    end(vicad::OpCode::Union, p);
+    return id;
+  }
+
+  // Segment counts in the payloads below are ignored by replay, which derives
+  // them from the radius and the LOD profile.
+  uint32_t circle_at(double x, double y, double radius) {
+    std::vector<uint8_t> p;
+    const uint32_t id = begin(&p);
+    append_pod(&p, x);
+    append_pod(&p, y);
+    append_pod(&p, radius);
+    append_pod(&p, (uint32_t)0);
+    end(vicad::OpCode::CrossPoint, p);
+    return id;
+  }
+
+  uint32_t revolve(uint32_t cs) {
+    std::vector<uint8_t> p;
+    const uint32_t id = begin(&p);
+    append_pod(&p, cs);
+    append_pod(&p, (uint32_t)0);
+    append_pod(&p, 360.0);
+    end(vicad::OpCode::Revolve, p);
+    return id;
+  }
+};
+
+// side x side unit cubes on a grid, each placed by its own Translate, all
+// joined by one Union: decode-bound, with a cheap disjoint boolean.
+OpStream union_grid_stream(uint32_t side) {
+  OpStream s;
+  std::vector<uint32_t> parts;
+  for (uint32_t y = 0; y < side; ++y) {
+    for (uint32_t x = 0; x < side; ++x) parts.push_back(s.translate(s.cube(1.0, 1.0, 1.0), x * 2.0, y * 2.0, 0.0));
+  }
+  s.root_id = s.unite(parts);
+  return s;
+}
+
+// A plate drilled by a chain of `holes` subtractions: boolean-bound.
+OpStream drilled_plate_stream(uint32_t holes) {
+  OpStream s;
+  const uint32_t side = (uint32_t)std::ceil(std::sqrt((double)holes));
+  uint32_t plate = s.cube(side * 4.0 + 4.0, side * 4.0 + 4.0, 2.0);
+  for (uint32_t i = 0; i < holes; ++i) {
+    const uint32_t hole = s.translate(s.cylinder(4.0, 1.0), 4.0 + (i % side) * 4.0, 4.0 + (i / side) * 4.0, -1.0);
+    plate = s.subtract(plate, hole);
+  }
+  s.root_id = plate;
+  return s;
+}
+
+// A thin, wide torus: at export tolerance the sweep gets about 1.4k segments
+// and the tube about 220, some 600k triangles.
+OpStream revolve_stream(double major_radius, double minor_radius) {
+  OpStream s;
+  s.root_id = s.revolve(s.circle_at(major_radius, 0.0, minor_radius));
+  return s;
+}
+
+void run_replay(Runner *runner, const std::string &name, const OpStream &stream, vicad::LodProfile profile) {
+  vicad::ReplayLodPolicy lod = {};
+  lod.profile = profile;
+  runner->run(name, stream.op_count, [&](std::string *error) {
+    vicad::ReplayTables tables;
+    if (!vicad::ReplayOpsToTables(stream.records.data(), stream.records.size(), stream.op_count, lod, &tables,
+                                  error)) {
+      return false;
+    }
+    if (!vicad::ReplayNodeIs(tables, stream.root_id, vicad::NodeKind::Manifold)) {
+      *error = "root is not a manifold";
+      return false;
+    }
+    // Booleans are lazy; force the root so their cost is part of the run.
+    if (tables.manifold_nodes[stream.root_id].NumTri() == 0) {
+      *error = "root is empty";
+      return false;
+    }
+    return true;
+  });
+}
+
+// ---------------------------------------------------------------------------
+// Meshes and rays
+
+// A sphere of about `tris` triangles with one octant cut away, so the mesh has
+// planar faces and sharp edges besides the smooth surface.
+manifold::MeshGL carved_sphere(size_t tris, double radius) {
+  const int segments = 4 * (int)std::ceil(std::sqrt((double)tris / 8.0));
+  const manifold::Manifold sphere = manifold::Manifold::Sphere(radius, segments);
+  const manifold::Manifold cut =
+      manifold::Manifold::Cube(manifold::vec3(radius)).Translate(manifold::vec3(radius * 0.2));
+  return (sphere - cut).GetMeshGL();
+}
+
+struct Ray {
+  double o[3];
+  double d[3];
+};
+
+// Rays from a shell of radius 3r aimed near the origin, from a fixed seed.
+std::vector<Ray> make_rays(size_t count, double radius) {
+  std::vector<Ray> rays(count);
+  uint64_t state = 0x9e3779b97f4a7c15ull;
+  auto next = [&state]() {
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    return (double)(state >> 11) / (double)(1ull << 53);
+  };
+  for (Ray &ray : rays) {
+    const double z = next() * 2.0 - 1.0;
+    const double phi = next() * 6.283185307179586;
+    const double s = std::sqrt(1.0 - z * z);
+    const double o[3] = {3.0 * radius * s * std::cos(phi), 3.0 * radius * s * std::sin(phi), 3.0 * radius * z};
+    for (int a = 0; a < 3; ++a) {
+      ray.o[a] = o[a];
+      ray.d[a] = (next() - 0.5) * radius - o[a];
+    }
+  }
+  return rays;
+}
+
+void run_mesh_set(Runner *runner, size_t tris, const char *tag) {
+  const std::string prefix = std::string("mesh_") + tag + "_";
+  bool any = false;
+  for (const char *stage : {"topology", "edges", "faces", "silhouette", "bvh", "pick_"}) {
+    any = any || runner->wants((prefix + stage).c_str());
+  }
+  if (!any) return;
+  const double radius = 10.0;
+  const manifold::MeshGL mesh = carved_sphere(tris, radius);
+  const size_t n = mesh.NumTri();
+  const std::vector<Ray> rays = make_rays(256, radius);
+
+  runner->run(prefix + "topology", n, [&](std::string *) { return vicad::BuildMeshTopology(mesh).triCount == n; });
+  const vicad::MeshTopology topo = vicad::BuildMeshTopology(mesh);
+  runner->run(prefix + "edges", n, [&](std::string *) {
+    return !vicad::BuildEdgeTopology(mesh, topo).edges.empty();
+  });
+  runner->run(prefix + "faces", n, [&](std::string *) {
+    return !vicad::DetectMeshFaces(mesh, topo, 30.0f).regions.empty();
+  });
+  const vicad::EdgeDetectionResult edges = vicad::BuildEdgeTopology(mesh, topo);
+  runner->run(prefix + "silhouette", n, [&](std::string *) {
+    const vicad::SilhouetteResult sil = vicad::ComputeSilhouetteEdges(mesh, edges, 3.0 * radius, 2.0 * radius, radius);
+    return sil.isSilhouette.size() == edges.edges.size();
+  });
+  runner->run(prefix + "bvh", n, [&](std::string *) { return !vicad::BuildMeshBvh(mesh).nodes.empty(); });
+
+  const vicad::MeshBvh bvh = vicad::BuildMeshBvh(mesh);
+  const vicad::FaceDetectionResult faces = vicad::DetectMeshFaces(mesh, topo, 30.0f);
+  const vicad::SilhouetteResult sil = vicad::ComputeSilhouetteEdges(mesh, edges, 3.0 * radius, 2.0 * radius, radius);
+  // Each pick benchmark shoots the same 256 rays; items counts rays, and a
+  // miss is not a failure (some rays pass the carved corner).
+  runner->run(prefix + "pick_mesh", rays.size(), [&](std::string *) {
+    for (const Ray &r : rays) {
+      double t = 0.0;
+      uint32_t tri = 0;
+      vicad::RaycastMeshBvh(mesh, bvh, r.o[0], r.o[1], r.o[2], r.d[0], r.d[1], r.d[2], &t, &tri);
+    }
+    return true;
+  });
+  runner->run(prefix + "pick_face", rays.size(), [&](std::string *) {
+    for (const Ray &r : rays) {
+      double dist = 0.0;
+      vicad::PickFaceRegionByRay(mesh, bvh, faces, r.o[0], r.o[1], r.o[2], r.d[0], r.d[1], r.d[2], &dist);
+    }
+    return true;
+  });
+  runner->run(prefix + "pick_edge", rays.size(), [&](std::string *) {
+    for (const Ray &r : rays) {
+      double dist = 0.0;
+      vicad::PickEdgeByRay(mesh, edges, sil, r.o[0], r.o[1], r.o[2], r.d[0], r.d[1], r.d[2], 0.05 * radius, &dist);
+    }
+    return true;
+  });
+}
+
+// Script in, replayed scene out, through the real worker. The warm-up run
+// spawns the worker; the timed runs then measure a steady-state round trip,
+// replay cache included.
+void run_ipc(Runner *runner, const Options &opt) {
+  if (!runner->wants("ipc_round_trip")) return;
+  vicad::ScriptWorkerClient client;
+  client.set_standby_enabled(false);
+  vicad::ReplayLodPolicy lod = {};
+  lod.profile = vicad::LodProfile::Model;
+  runner->run("ipc_round_trip", 1, [&](std::string *error) {
+    std::vector<vicad::ScriptSceneObject> objects;
+    return client.ExecuteScriptScene(opt.script.c_str(), &objects, error, lod);
+  });
+}
+
+bool parse_args(int argc, char **argv, Options *opt, std::string *error) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if (std::strncmp(arg, "--iters=", 8) == 0) {
+      opt->iters = std::max(1, std::atoi(arg + 8));
+    } else if (std::strncmp(arg, "--filter=", 9) == 0) {
+      opt->filter = arg + 9;
+    } else if (std::strcmp(arg, "--large") == 0) {
+      opt->large = true;
+    } else if (std::strcmp(arg, "--no-ipc") == 0) {
+      opt->ipc = false;
+    } else if (std::strncmp(arg, "--script=", 9) == 0) {
+      opt->script = arg + 9;
+    } else {
+      *error = std::string("unknown argument: ") + arg;
+      return false;
+    }
+  }
+  return true;
+}
+
+void print_results(const Options &opt, const std::vector<BenchResult> &results) {
+  const bool ok = std::all_of(results.begin(), results.end(), [](const BenchResult &r) { return r.ok; });
+  std::fprintf(stdout, "{\"result\":\"%s\",\"iters\":%d,\"benchmarks\":[", ok ? "pass" : "fail", opt.iters);
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchResult &r = results[i];
+    std::fprintf(stdout, "%s{\"name\":\"", i == 0 ? "" : ",");
+    vicad::write_json_escaped(stdout, r.name.c_str());
+    std::fprintf(stdout,
+                 "\",\"result\":\"%s\",\"items\":%zu,\"median_ms\":%.3f,\"p95_ms\":%.3f,\"min_ms\":%.3f,"
+                 "\"allocs\":%llu,\"alloc_bytes\":%llu,\"peak_rss_kb\":%ld",
+                 r.ok ? "pass" : "fail", r.items, r.median_ms, r.p95_ms, r.min_ms, (unsigned long long)r.allocs,
+                 (unsigned long long)r.alloc_bytes, r.peak_rss_kb);
+    if (!r.ok) {
+      std::fprintf(stdout, ",\"error\":\"");
+      vicad::write_json_escaped(stdout, r.error.c_str());
+      std::fprintf(stdout, "\"");
+    }
+    std::fprintf(stdout, "}");
+  }
+  std::fprintf(stdout, "]}\n");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  std::string error;
+  if (!parse_args(argc, argv, &opt, &error)) {
+    std::fprintf(stderr, "usage: bench [--iters=N] [--filter=S] [--large] [--no-ipc] [--script=PATH]\n");
+    std::fprintf(stdout, "{\"result\":\"fail\",\"error\":\"");
+    vicad::write_json_escaped(stdout, error.c_str());
+    std::fprintf(stdout, "\"}\n");
+    return 1;
+  }
+
+  Runner runner(opt);
+  run_replay(&runner, "replay_union_grid_4096", union_grid_stream(64), vicad::LodProfile::Model);
+  run_replay(&runner, "replay_drilled_plate_256", drilled_plate_stream(256), vicad::LodProfile::Model);
+  run_replay(&runner, "replay_revolve_export", revolve_stream(40.0, 1.0), vicad::LodProfile::Export3MF);
+  run_mesh_set(&runner, 100000, "100k");
+  run_mesh_set(&runner, 1000000, "1m");
+  if (opt.large) run_mesh_set(&runner, 5000000, "5m");
+  if (opt.ipc) run_ipc(&runner, opt);
+
+  print_results(opt, runner.results());
+  const std::vector<BenchResult> &results = runner.results();
+  return std::all_of(results.begin(), results.end(), [](const BenchResult &r) { return r.ok; }) ? 0 : 1;
+}
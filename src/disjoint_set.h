@@ -0,0 +1,72 @@
+#ifndef VICAD_DISJOINT_SET_H_
+#define VICAD_DISJOINT_SET_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace vicad {
+
+// Union-find over ids [0, n) with union by rank and path halving.
+struct DisjointSet {
+  std::vector<uint32_t> parent;
+  std::vector<uint8_t> rank;
+
+  explicit DisjointSet(size_t n) : parent(n), rank(n, 0) { std::iota(parent.begin(), parent.end(), 0); }
+
+  uint32_t find(uint32_t x) {
+    while (parent[x] != x) {
+      parent[x] = parent[parent[x]];
+      x = parent[x];
+    }
+    return x;
+  }
+
+  void unite(uint32_t a, uint32_t b) {
+    a = find(a);
+    b = find(b);
+    if (a == b) return;
+    if (rank[a] < rank[b]) std::swap(a, b);
+    parent[b] = a;
+    if (rank[a] == rank[b]) rank[a]++;
+  }
+};
+
+// Union-find that several threads may unite into at once. A root is only ever
+// linked under a smaller root, so every set ends up rooted at its lowest
+// member whatever order the unions land in.
+struct ConcurrentDisjointSet {
+  std::vector<std::atomic<uint32_t>> parent;
+
+  explicit ConcurrentDisjointSet(size_t n) : parent(n) {
+    for (size_t i = 0; i < n; ++i) parent[i].store((uint32_t)i, std::memory_order_relaxed);
+  }
+
+  uint32_t find(uint32_t x) {
+    for (;;) {
+      uint32_t up = parent[x].load(std::memory_order_relaxed);
+      if (up == x) return x;
+      const uint32_t grand = parent[up].load(std::memory_order_relaxed);
+      if (grand != up) parent[x].compare_exchange_weak(up, grand, std::memory_order_relaxed);
+      x = grand;
+    }
+  }
+
+  void unite(uint32_t a, uint32_t b) {
+    for (;;) {
+      a = find(a);
+      b = find(b);
+      if (a == b) return;
+      if (a < b) std::swap(a, b);
+      uint32_t expected = a;
+      if (parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed)) return;
+    }
+  }
+};
+
+}  // namespace vicad
+
+#endif  // VICAD_DISJOINT_SET_H_
@@ -4,26 +4,16 @@
 #include <cmath>
 #include <cstdint>
 #include <limits>
-#include <numeric>
-#include <unordered_map>
 #include <vector>
 
+#include "mesh_topology.h"
+#include "trace.h"
+
 namespace vicad {
 
 namespace {
 
-struct Vec3d {
-    double x;
-    double y;
-    double z;
-};
-
-struct EdgeAccum {
-    uint32_t renderV0 = 0;
-    uint32_t renderV1 = 0;
-    bool hasRenderVerts = false;
-    std::vector<int> tris;
-};
+using Vec3d = MeshTopoVec3;
 
 static Vec3d add(const Vec3d &a, const Vec3d &b) {
     return {a.x + b.x, a.y + b.y, a.z + b.z};
@@ -74,11 +64,6 @@ static double clamp01(double v) {
     return v;
 }
 
-static uint64_t edge_key(uint32_t a, uint32_t b) {
-    if (a > b) std::swap(a, b);
-    return ((uint64_t)a << 32) | (uint64_t)b;
-}
-
 static bool point_ray_distance(const Vec3d &p,
                                const Vec3d &rayOrig,
                                const Vec3d &rayDir,
@@ -164,87 +149,100 @@ static bool segment_ray_distance(const Vec3d &a,
     return true;
 }
 
-struct DisjointSet {
-    std::vector<uint32_t> parent;
-    std::vector<uint8_t> rank;
+constexpr uint32_t kPickLeafSize = 4;
 
-    explicit DisjointSet(size_t n) : parent(n), rank(n, 0) {
-        std::iota(parent.begin(), parent.end(), 0);
-    }
+struct PickBuildEdge {
+    float mn[3];
+    float mx[3];
+    float center[3];
+};
 
-    uint32_t find(uint32_t x) {
-        while (parent[(size_t)x] != x) {
-            parent[(size_t)x] = parent[(size_t)parent[(size_t)x]];
-            x = parent[(size_t)x];
+// Median split on the longest axis of the edge centers.
+static void build_pick_node(const std::vector<PickBuildEdge> &prims, EdgeDetectionResult *out,
+                            uint32_t begin, uint32_t end) {
+    const size_t node = out->pickNodes.size();
+    out->pickNodes.push_back({});
+    EdgePickNode n = {};
+    float cmn[3], cmx[3];
+    for (int a = 0; a < 3; ++a) {
+        n.bmin[a] = cmn[a] = std::numeric_limits<float>::infinity();
+        n.bmax[a] = cmx[a] = -std::numeric_limits<float>::infinity();
+    }
+    for (uint32_t i = begin; i < end; ++i) {
+        const PickBuildEdge &e = prims[out->pickEdges[i]];
+        for (int a = 0; a < 3; ++a) {
+            n.bmin[a] = std::min(n.bmin[a], e.mn[a]);
+            n.bmax[a] = std::max(n.bmax[a], e.mx[a]);
+            cmn[a] = std::min(cmn[a], e.center[a]);
+            cmx[a] = std::max(cmx[a], e.center[a]);
         }
-        return x;
     }
 
-    void unite(uint32_t a, uint32_t b) {
-        uint32_t ra = find(a);
-        uint32_t rb = find(b);
-        if (ra == rb) return;
-        const uint8_t rankA = rank[(size_t)ra];
-        const uint8_t rankB = rank[(size_t)rb];
-        if (rankA < rankB) {
-            parent[(size_t)ra] = rb;
-            return;
-        }
-        if (rankA > rankB) {
-            parent[(size_t)rb] = ra;
-            return;
+    int axis = 0;
+    for (int a = 1; a < 3; ++a) {
+        if (cmx[a] - cmn[a] > cmx[axis] - cmn[axis]) axis = a;
+    }
+    if (end - begin <= kPickLeafSize || !(cmx[axis] > cmn[axis])) {
+        n.offset = begin;
+        n.count = end - begin;
+        out->pickNodes[node] = n;
+        return;
+    }
+
+    const uint32_t mid = begin + (end - begin) / 2;
+    std::nth_element(out->pickEdges.begin() + begin, out->pickEdges.begin() + mid, out->pickEdges.begin() + end,
+                     [&](uint32_t a, uint32_t b) { return prims[a].center[axis] < prims[b].center[axis]; });
+    build_pick_node(prims, out, begin, mid);
+    n.offset = (uint32_t)out->pickNodes.size();
+    n.count = 0;
+    build_pick_node(prims, out, mid, end);
+    out->pickNodes[node] = n;
+}
+
+static void build_pick_index(const manifold::MeshGL &mesh, EdgeDetectionResult *out) {
+    const uint32_t count = (uint32_t)out->edges.size();
+    if (count == 0) return;
+    std::vector<PickBuildEdge> prims(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        const EdgeRecord &e = out->edges[i];
+        const float *p0 = &mesh.vertProperties[(size_t)e.v0 * (size_t)mesh.numProp];
+        const float *p1 = &mesh.vertProperties[(size_t)e.v1 * (size_t)mesh.numProp];
+        for (int a = 0; a < 3; ++a) {
+            prims[i].mn[a] = std::min(p0[a], p1[a]);
+            prims[i].mx[a] = std::max(p0[a], p1[a]);
+            prims[i].center[a] = 0.5f * (p0[a] + p1[a]);
         }
-        parent[(size_t)rb] = ra;
-        rank[(size_t)ra] += 1;
     }
-};
+    out->pickEdges.resize(count);
+    for (uint32_t i = 0; i < count; ++i) out->pickEdges[i] = i;
+    out->pickNodes.reserve(2 * ((size_t)count / kPickLeafSize + 1));
+    build_pick_node(prims, out, 0, count);
+}
 
-static void add_edge(std::unordered_map<uint64_t, EdgeAccum> &edgeMap,
-                     DisjointSet *dsu,
-                     uint32_t v0,
-                     uint32_t v1,
-                     int tri) {
-    const uint32_t c0 = dsu->find(v0);
-    const uint32_t c1 = dsu->find(v1);
-    if (c0 == c1) return;
-    const uint64_t key = edge_key(c0, c1);
-    EdgeAccum &acc = edgeMap[key];
-    if (!acc.hasRenderVerts) {
-        acc.renderV0 = v0;
-        acc.renderV1 = v1;
-        acc.hasRenderVerts = true;
+// Whether the ray (t >= 0) passes within `radius` of the node's box, tested
+// as a slab test against the box grown by `radius` on every side.
+static bool pick_box_hit(const EdgePickNode &n, const double orig[3], const double inv[3], double radius) {
+    double t0 = 0.0;
+    double t1 = std::numeric_limits<double>::infinity();
+    for (int a = 0; a < 3; ++a) {
+        double lo = ((double)n.bmin[a] - radius - orig[a]) * inv[a];
+        double hi = ((double)n.bmax[a] + radius - orig[a]) * inv[a];
+        if (lo > hi) std::swap(lo, hi);
+        t0 = std::max(t0, lo);
+        t1 = std::min(t1, hi);
+        if (t0 > t1) return false;
     }
-    acc.tris.push_back(tri);
+    return true;
 }
 
 }  // namespace
 
-EdgeDetectionResult BuildEdgeTopology(const manifold::MeshGL &mesh) {
+EdgeDetectionResult BuildEdgeTopology(const manifold::MeshGL &mesh, const MeshTopology &topo) {
+    TraceSpan span("analysis", "edges");
     EdgeDetectionResult out = {};
     const uint32_t triCount = (uint32_t)mesh.NumTri();
     if (triCount == 0 || mesh.numProp < 3) return out;
-    if (mesh.faceID.size() != triCount) return out;
-
-    std::vector<Vec3d> triNormal(triCount);
-    for (uint32_t tri = 0; tri < triCount; ++tri) {
-        const uint32_t i0 = mesh.triVerts[tri * 3 + 0];
-        const uint32_t i1 = mesh.triVerts[tri * 3 + 1];
-        const uint32_t i2 = mesh.triVerts[tri * 3 + 2];
-        const Vec3d p0 = mesh_pos(mesh, i0);
-        const Vec3d p1 = mesh_pos(mesh, i1);
-        const Vec3d p2 = mesh_pos(mesh, i2);
-        triNormal[tri] = normalize(cross(sub(p1, p0), sub(p2, p0)));
-    }
-
-    const uint32_t numVerts = (uint32_t)mesh.NumVert();
-    DisjointSet dsu(numVerts);
-    const size_t mergeCount = std::min(mesh.mergeFromVert.size(), mesh.mergeToVert.size());
-    for (size_t i = 0; i < mergeCount; ++i) {
-        const uint32_t from = mesh.mergeFromVert[i];
-        const uint32_t to = mesh.mergeToVert[i];
-        if (from >= numVerts || to >= numVerts) continue;
-        dsu.unite(from, to);
-    }
+    if (mesh.faceID.size() != triCount || topo.triCount != triCount) return out;
 
     std::vector<int> triRunSlot(triCount, 0);
     if (mesh.runIndex.size() >= 2) {
@@ -259,45 +257,31 @@ EdgeDetectionResult BuildEdgeTopology(const manifold::MeshGL &mesh) {
         }
     }
 
-    std::unordered_map<uint64_t, EdgeAccum> edgeMap;
-    edgeMap.reserve((size_t)triCount * 2);
-    for (uint32_t tri = 0; tri < triCount; ++tri) {
-        const uint32_t i0 = mesh.triVerts[tri * 3 + 0];
-        const uint32_t i1 = mesh.triVerts[tri * 3 + 1];
-        const uint32_t i2 = mesh.triVerts[tri * 3 + 2];
-        add_edge(edgeMap, &dsu, i0, i1, (int)tri);
-        add_edge(edgeMap, &dsu, i1, i2, (int)tri);
-        add_edge(edgeMap, &dsu, i2, i0, (int)tri);
-    }
-
-    std::vector<uint64_t> sortedKeys;
-    sortedKeys.reserve(edgeMap.size());
-    for (const auto &it : edgeMap) {
-        sortedKeys.push_back(it.first);
-    }
-    std::sort(sortedKeys.begin(), sortedKeys.end());
-
-    out.edges.reserve(sortedKeys.size());
-    out.edgeFlags.reserve(sortedKeys.size());
-    out.featureEdgeIndices.clear();
-    out.nonManifoldEdgeIndices.clear();
-
-    for (const uint64_t key : sortedKeys) {
-        const auto found = edgeMap.find(key);
-        if (found == edgeMap.end()) continue;
-        const EdgeAccum &acc = found->second;
-        if (!acc.hasRenderVerts) continue;
-
-        std::vector<int> tris = acc.tris;
-        std::sort(tris.begin(), tris.end());
-        tris.erase(std::unique(tris.begin(), tris.end()), tris.end());
+    // Sides of an edge ascend by triangle, and the first one names the
+    // edge's render vertices.
+    const std::vector<MeshTopoVec3> &triNormal = topo.triNormal;
+    for (size_t edge = 0; edge < topo.edge_count(); ++edge) {
+        const uint32_t begin = topo.edgeOffset[edge];
+        const uint32_t end = topo.edgeOffset[edge + 1];
+        // The two lowest distinct triangles, and how many there are.
+        int tris[2] = {-1, -1};
+        size_t triTotal = 0;
+        int last = -1;
+        for (uint32_t i = begin; i < end; ++i) {
+            const int tri = (int)(topo.edgeSides[i] / 3);
+            if (tri == last) continue;
+            last = tri;
+            if (triTotal < 2) tris[triTotal] = tri;
+            ++triTotal;
+        }
+        const uint32_t first = topo.edgeSides[begin];
 
         uint8_t flags = EdgeClassNone;
         bool keep = false;
-        if (tris.size() == 1) {
+        if (triTotal == 1) {
             flags |= EdgeClassFeature;
             keep = true;
-        } else if (tris.size() == 2) {
+        } else if (triTotal == 2) {
             const int triA = tris[0];
             const int triB = tris[1];
             if (triRunSlot[(size_t)triA] != triRunSlot[(size_t)triB] ||
@@ -305,22 +289,20 @@ EdgeDetectionResult BuildEdgeTopology(const manifold::MeshGL &mesh) {
                 flags |= EdgeClassFeature;
                 keep = true;
             }
-        } else if (tris.size() > 2) {
+        } else if (triTotal > 2) {
             flags |= EdgeClassNonManifold;
             keep = true;
         }
         if (!keep) continue;
 
         EdgeRecord rec = {};
-        rec.v0 = acc.renderV0;
-        rec.v1 = acc.renderV1;
-        if (!tris.empty()) {
-            rec.triA = tris[0];
-            rec.nA = {triNormal[(size_t)tris[0]].x,
-                      triNormal[(size_t)tris[0]].y,
-                      triNormal[(size_t)tris[0]].z};
-        }
-        if (tris.size() >= 2) {
+        rec.v0 = mesh.triVerts[first];
+        rec.v1 = mesh.triVerts[first - first % 3 + (first % 3 + 1) % 3];
+        rec.triA = tris[0];
+        rec.nA = {triNormal[(size_t)tris[0]].x,
+                  triNormal[(size_t)tris[0]].y,
+                  triNormal[(size_t)tris[0]].z};
+        if (triTotal >= 2) {
             rec.triB = tris[1];
             rec.nB = {triNormal[(size_t)tris[1]].x,
                       triNormal[(size_t)tris[1]].y,
@@ -334,12 +316,14 @@ EdgeDetectionResult BuildEdgeTopology(const manifold::MeshGL &mesh) {
         if ((flags & EdgeClassNonManifold) != 0) out.nonManifoldEdgeIndices.push_back(idx);
     }
 
+    build_pick_index(mesh, &out);
     return out;
 }
 
 SilhouetteResult ComputeSilhouetteEdges(const manifold::MeshGL &mesh,
                                         const EdgeDetectionResult &edges,
                                         double eyeX, double eyeY, double eyeZ) {
+    TraceSpan span("analysis", "silhouette");
     SilhouetteResult out = {};
     out.isSilhouette.assign(edges.edges.size(), 0);
     if (mesh.numProp < 3 || edges.edges.empty()) return out;
@@ -384,35 +368,55 @@ int PickEdgeByRay(const manifold::MeshGL &mesh,
     const Vec3d rayDir = normalize({rayDirX, rayDirY, rayDirZ});
     if (length(rayDir) <= 1e-20) return -1;
 
-    std::vector<uint8_t> candidate(edges.edges.size(), 0);
-    for (int idx : edges.featureEdgeIndices) {
-        if (idx >= 0 && (size_t)idx < candidate.size()) candidate[(size_t)idx] = 1;
-    }
-    for (int idx : edges.nonManifoldEdgeIndices) {
-        if (idx >= 0 && (size_t)idx < candidate.size()) candidate[(size_t)idx] = 1;
+    if (edges.pickNodes.empty()) return -1;
+
+    const double orig[3] = {rayOrig.x, rayOrig.y, rayOrig.z};
+    const double dir[3] = {rayDir.x, rayDir.y, rayDir.z};
+    double inv[3];
+    for (int a = 0; a < 3; ++a) {
+        // A tiny stand-in for a zero component keeps the slabs free of 0 * inf.
+        inv[a] = 1.0 / (std::fabs(dir[a]) < 1e-30 ? std::copysign(1e-30, dir[a]) : dir[a]);
     }
 
     double bestDist = std::numeric_limits<double>::infinity();
     double bestT = std::numeric_limits<double>::infinity();
     int bestEdge = -1;
 
-    for (size_t i = 0; i < edges.edges.size(); ++i) {
-        if (candidate[i] == 0) continue;
-        const EdgeRecord &e = edges.edges[i];
-
-        const Vec3d p0 = mesh_pos(mesh, e.v0);
-        const Vec3d p1 = mesh_pos(mesh, e.v1);
-
-        double t = 0.0;
-        double d = 0.0;
-        if (!segment_ray_distance(p0, p1, rayOrig, rayDir, &t, &d)) continue;
-
-        if (d > pickRadius) continue;
-        if (d < bestDist - 1e-9 ||
-            (std::fabs(d - bestDist) <= 1e-9 && t < bestT)) {
-            bestDist = d;
-            bestT = t;
-            bestEdge = (int)i;
+    // Every kept edge is a feature or non-manifold edge, so all are candidates.
+    // Subtrees are culled by the pick radius, narrowed to the best distance so
+    // far (plus the tie tolerance) once an edge is found.
+    std::vector<uint32_t> stack = {0};
+    while (!stack.empty()) {
+        const uint32_t node = stack.back();
+        stack.pop_back();
+        const EdgePickNode &n = edges.pickNodes[node];
+        const double radius = std::min(pickRadius, bestDist + 1e-9);
+        if (!pick_box_hit(n, orig, inv, radius)) continue;
+        if (n.count == 0) {
+            stack.push_back(n.offset);
+            stack.push_back(node + 1);
+            continue;
+        }
+        for (uint32_t k = n.offset; k < n.offset + n.count; ++k) {
+            const uint32_t i = edges.pickEdges[k];
+            const EdgeRecord &e = edges.edges[i];
+
+            const Vec3d p0 = mesh_pos(mesh, e.v0);
+            const Vec3d p1 = mesh_pos(mesh, e.v1);
+
+            double t = 0.0;
+            double d = 0.0;
+            if (!segment_ray_distance(p0, p1, rayOrig, rayDir, &t, &d)) continue;
+
+            if (d > pickRadius) continue;
+            // Edges meeting at the vertex nearest the ray tie exactly; the
+            // lower index wins, whatever order the walk reached them in.
+            const bool tie = std::fabs(d - bestDist) <= 1e-9;
+            if (d < bestDist - 1e-9 || (tie && (t < bestT || (t == bestT && (int)i < bestEdge)))) {
+                bestDist = d;
+                bestT = t;
+                bestEdge = (int)i;
+            }
         }
     }
 
@@ -7,6 +7,8 @@
 
 namespace vicad {
 
+struct MeshTopology;
+
 enum EdgeClassFlags : uint8_t {
     EdgeClassNone = 0,
     EdgeClassFeature = 1 << 0,
@@ -28,11 +30,23 @@ struct EdgeRecord {
     EdgeVec3 nB = {0.0, 0.0, 0.0};
 };
 
+// Node of the BVH over `edges` that ray picking walks. Flattened like
+// MeshBvhNode: an inner node's left child follows it and `offset` names the
+// right child; leaves (count > 0) cover pickEdges[offset, offset + count).
+struct EdgePickNode {
+    float bmin[3];
+    uint32_t offset;
+    float bmax[3];
+    uint32_t count;
+};
+
 struct EdgeDetectionResult {
     std::vector<EdgeRecord> edges;
     std::vector<uint8_t> edgeFlags;
     std::vector<int> featureEdgeIndices;
     std::vector<int> nonManifoldEdgeIndices;
+    std::vector<EdgePickNode> pickNodes;
+    std::vector<uint32_t> pickEdges;  // edge indices in leaf order
 };
 
 struct SilhouetteResult {
@@ -40,12 +54,15 @@ struct SilhouetteResult {
     std::vector<uint8_t> isSilhouette;
 };
 
-EdgeDetectionResult BuildEdgeTopology(const manifold::MeshGL &mesh);
+// `topo` must be built from `mesh` (see mesh_topology.h).
+EdgeDetectionResult BuildEdgeTopology(const manifold::MeshGL &mesh, const MeshTopology &topo);
 
 SilhouetteResult ComputeSilhouetteEdges(const manifold::MeshGL &mesh,
                                         const EdgeDetectionResult &edges,
                                         double eyeX, double eyeY, double eyeZ);
 
+// Closest feature or non-manifold edge within `pickRadius` of the ray, found
+// through the pick BVH BuildEdgeTopology built; ties go to the nearer hit.
 int PickEdgeByRay(const manifold::MeshGL &mesh,
                   const EdgeDetectionResult &edges,
                   const SilhouetteResult &silhouette,
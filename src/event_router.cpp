@@ -19,6 +19,9 @@ bool HandleWindowEvent(vicad_interaction::InteractionState *interaction,
     if (event.type == RGFW_keyPressed && event.key.value == RGFW_p) {
         interaction->pick_debug_overlay = !interaction->pick_debug_overlay;
     }
+    if (event.type == RGFW_keyPressed && event.key.value == RGFW_h) {
+        interaction->perf_hud = !interaction->perf_hud;
+    }
     return true;
 }
 
@@ -4,19 +4,26 @@
 #include <cmath>
 #include <cstdint>
 #include <limits>
-#include <numeric>
-#include <queue>
+#include <span>
 #include <unordered_map>
 
+#include "disjoint_set.h"
+#include "face_provenance.h"
+#include "mesh_bvh.h"
+#include "mesh_topology.h"
+#include "trace.h"
+#include "work_stealing_pool.h"
+
 namespace vicad {
 
 namespace {
 
-struct Vec3d {
-    double x;
-    double y;
-    double z;
-};
+using Vec3d = MeshTopoVec3;
+
+// Below this many triangles (or region pairs) a step stays on the calling
+// thread; regions are heavier, so fitting fans out from fewer of them.
+constexpr size_t kParallelMin = (size_t)1 << 14;
+constexpr size_t kParallelMinRegions = 32;
 
 struct RegionFit {
     FacePrimitiveType type = FacePrimitiveType::Unknown;
@@ -32,30 +39,6 @@ struct RegionFit {
     double cylinderRms = std::numeric_limits<double>::infinity();
 };
 
-struct DisjointSet {
-    std::vector<int> p;
-    std::vector<int> r;
-
-    explicit DisjointSet(size_t n) : p(n), r(n, 0) {
-        std::iota(p.begin(), p.end(), 0);
-    }
-
-    int find(int x) {
-        if (p[x] == x) return x;
-        p[x] = find(p[x]);
-        return p[x];
-    }
-
-    void unite(int a, int b) {
-        a = find(a);
-        b = find(b);
-        if (a == b) return;
-        if (r[a] < r[b]) std::swap(a, b);
-        p[b] = a;
-        if (r[a] == r[b]) ++r[a];
-    }
-};
-
 static Vec3d add(const Vec3d &a, const Vec3d &b) {
     return {a.x + b.x, a.y + b.y, a.z + b.z};
 }
@@ -99,11 +82,6 @@ static Vec3d mesh_pos(const manifold::MeshGL &mesh, uint32_t idx) {
     };
 }
 
-static uint64_t edge_key(uint32_t a, uint32_t b) {
-    if (a > b) std::swap(a, b);
-    return (uint64_t)a << 32 | (uint64_t)b;
-}
-
 static bool solve_4x4(double m[4][5], double out[4]) {
     for (int col = 0; col < 4; ++col) {
         int pivot = col;
@@ -158,36 +136,12 @@ static bool solve_3x3(double m[3][4], double out[3]) {
     return true;
 }
 
-static bool ray_intersect_triangle(const Vec3d &orig, const Vec3d &dir,
-                                   const Vec3d &v0, const Vec3d &v1, const Vec3d &v2,
-                                   double *out_t) {
-    const Vec3d e1 = sub(v1, v0);
-    const Vec3d e2 = sub(v2, v0);
-    const Vec3d p = cross(dir, e2);
-    const double det = dot(e1, p);
-    if (std::fabs(det) < 1e-12) return false;
-    const double inv_det = 1.0 / det;
-    const Vec3d tvec = sub(orig, v0);
-    const double u = dot(tvec, p) * inv_det;
-    if (u < 0.0 || u > 1.0) return false;
-    const Vec3d q = cross(tvec, e1);
-    const double v = dot(dir, q) * inv_det;
-    if (v < 0.0 || u + v > 1.0) return false;
-    const double t = dot(e2, q) * inv_det;
-    if (t <= 1e-9) return false;
-    if (out_t) *out_t = t;
-    return true;
-}
-
-static RegionFit classify_region(const std::vector<uint32_t> &tris,
-                                 const std::vector<Vec3d> &triCenters,
-                                 const std::vector<Vec3d> &triNormals,
-                                 double planeTol,
-                                 double sphereTol,
-                                 double cylinderTol) {
-    RegionFit fit = {};
-    if (tris.empty()) return fit;
-
+// Least-squares plane through the triangle centers, oriented by the summed
+// normals, and its RMS distance.
+static void fit_plane(const std::vector<uint32_t> &tris,
+                      const std::vector<Vec3d> &triCenters,
+                      const std::vector<Vec3d> &triNormals,
+                      RegionFit *fit) {
     Vec3d centroid = {0.0, 0.0, 0.0};
     Vec3d nsum = {0.0, 0.0, 0.0};
     for (uint32_t t : tris) {
@@ -195,15 +149,50 @@ static RegionFit classify_region(const std::vector<uint32_t> &tris,
         nsum = add(nsum, triNormals[t]);
     }
     centroid = mul(centroid, 1.0 / (double)tris.size());
-    fit.planeN = normalize(nsum);
-    fit.planeD = -dot(fit.planeN, centroid);
+    fit->planeN = normalize(nsum);
+    fit->planeD = -dot(fit->planeN, centroid);
 
     double planeErr2 = 0.0;
     for (uint32_t t : tris) {
-        const double dist = dot(fit.planeN, triCenters[t]) + fit.planeD;
+        const double dist = dot(fit->planeN, triCenters[t]) + fit->planeD;
         planeErr2 += dist * dist;
     }
-    fit.planeRms = std::sqrt(planeErr2 / (double)tris.size());
+    fit->planeRms = std::sqrt(planeErr2 / (double)tris.size());
+}
+
+// Residual of the cylinder in `fit`: radial distance of the triangle centers
+// from its side plus how far the normals lean along its axis.
+static double cylinder_rms(const std::vector<uint32_t> &tris,
+                           const std::vector<Vec3d> &triCenters,
+                           const std::vector<Vec3d> &triNormals,
+                           const RegionFit &fit) {
+    const Vec3d axis = fit.cylinderAxis;
+    const double r = fit.cylinderR;
+    double radErr2 = 0.0;
+    double ndotErr2 = 0.0;
+    for (uint32_t t : tris) {
+        const Vec3d d = sub(triCenters[t], fit.cylinderPoint);
+        const Vec3d radial = sub(d, mul(axis, dot(d, axis)));
+        const double re = length(radial) - r;
+        radErr2 += re * re;
+        const double na = dot(triNormals[t], axis);
+        ndotErr2 += na * na;
+    }
+    const double radialRms = std::sqrt(radErr2 / (double)tris.size());
+    const double normalRms = std::sqrt(ndotErr2 / (double)tris.size());
+    return std::sqrt(radialRms * radialRms + (normalRms * r) * (normalRms * r));
+}
+
+static RegionFit classify_region(const std::vector<uint32_t> &tris,
+                                 const std::vector<Vec3d> &triCenters,
+                                 const std::vector<Vec3d> &triNormals,
+                                 double planeTol,
+                                 double sphereTol,
+                                 double cylinderTol) {
+    RegionFit fit = {};
+    if (tris.empty()) return fit;
+
+    fit_plane(tris, triCenters, triNormals, &fit);
 
     if (tris.size() >= 6) {
         double ata[4][4] = {};
@@ -288,28 +277,10 @@ static RegionFit classify_region(const std::vector<uint32_t> &tris,
                 const double cy = -0.5 * x[1];
                 const double rr = cx * cx + cy * cy - x[2];
                 if (std::isfinite(rr) && rr > 1e-12) {
-                    const double r = std::sqrt(rr);
-                    const Vec3d c3 = add(mul(u, cx), mul(v, cy));
-
-                    double radErr2 = 0.0;
-                    double ndotErr2 = 0.0;
-                    for (uint32_t t : tris) {
-                        const Vec3d p = triCenters[t];
-                        const Vec3d d = sub(p, c3);
-                        const double ax = dot(d, axis);
-                        const Vec3d radial = sub(d, mul(axis, ax));
-                        const double rho = length(radial);
-                        const double re = rho - r;
-                        radErr2 += re * re;
-                        const double na = dot(triNormals[t], axis);
-                        ndotErr2 += na * na;
-                    }
-                    const double radialRms = std::sqrt(radErr2 / (double)tris.size());
-                    const double normalRms = std::sqrt(ndotErr2 / (double)tris.size());
                     fit.cylinderAxis = axis;
-                    fit.cylinderPoint = c3;
-                    fit.cylinderR = r;
-                    fit.cylinderRms = std::sqrt(radialRms * radialRms + (normalRms * r) * (normalRms * r));
+                    fit.cylinderPoint = add(mul(u, cx), mul(v, cy));
+                    fit.cylinderR = std::sqrt(rr);
+                    fit.cylinderRms = cylinder_rms(tris, triCenters, triNormals, fit);
                 }
             }
         }
@@ -377,101 +348,110 @@ static bool compatible_for_merge(const RegionFit &a, const RegionFit &b,
     return false;
 }
 
+// Types a region from its source surface when it sits within the fit tolerance
+// of it. Planes still take their offset from the triangles (one cheap pass).
+static bool classify_from_source(const std::vector<uint32_t> &tris, const FaceProvenance &provenance,
+                                 const std::vector<Vec3d> &triCenters, const std::vector<Vec3d> &triNormals,
+                                 double planeTol, double sphereTol, double cylinderTol, RegionFit *out) {
+    FacePrimitiveType type = FacePrimitiveType::Unknown;
+    const FaceRunSurface *surf = FaceRegionSource(provenance, tris, &type);
+    if (!surf) return false;
+    RegionFit fit = {};
+    if (type == FacePrimitiveType::Plane) {
+        fit_plane(tris, triCenters, triNormals, &fit);
+        if (fit.planeRms > planeTol) return false;
+    } else if (type == FacePrimitiveType::Sphere) {
+        fit.sphereC = surf->origin;
+        fit.sphereR = surf->radius;
+        fit.sphereRms = FaceSourceSphereRms(*surf, tris, triCenters);
+        if (fit.sphereRms > sphereTol) return false;
+    } else {
+        fit.cylinderAxis = surf->axis;
+        fit.cylinderPoint = surf->origin;
+        fit.cylinderR = surf->radius;
+        fit.cylinderRms = cylinder_rms(tris, triCenters, triNormals, fit);
+        if (fit.cylinderRms > cylinderTol) return false;
+    }
+    fit.type = type;
+    *out = fit;
+    return true;
+}
+
 }  // namespace
 
-FaceDetectionResult DetectMeshFaces(const manifold::MeshGL &mesh, float maxDihedralDegrees) {
+FaceDetectionResult DetectMeshFaces(const manifold::MeshGL &mesh, const MeshTopology &topo,
+                                    float maxDihedralDegrees, const std::vector<FaceSource> &sources) {
+    TraceSpan span("analysis", "faces");
     FaceDetectionResult out = {};
     const uint32_t triCount = (uint32_t)mesh.NumTri();
-    if (triCount == 0 || mesh.numProp < 3) return out;
+    if (triCount == 0 || mesh.numProp < 3 || topo.triCount != triCount) return out;
 
     out.triRegion.assign(triCount, -1);
 
-    std::vector<Vec3d> triNormal(triCount);
-    std::vector<Vec3d> triCenter(triCount);
-    triNormal.reserve(triCount);
-    triCenter.reserve(triCount);
+    const std::vector<Vec3d> &triNormal = topo.triNormal;
+    const std::vector<Vec3d> &triCenter = topo.triCenter;
     Vec3d mn = mesh_pos(mesh, mesh.triVerts[0]);
     Vec3d mx = mn;
-
     for (uint32_t tri = 0; tri < triCount; ++tri) {
-        const uint32_t i0 = mesh.triVerts[tri * 3 + 0];
-        const uint32_t i1 = mesh.triVerts[tri * 3 + 1];
-        const uint32_t i2 = mesh.triVerts[tri * 3 + 2];
-        const Vec3d p0 = mesh_pos(mesh, i0);
-        const Vec3d p1 = mesh_pos(mesh, i1);
-        const Vec3d p2 = mesh_pos(mesh, i2);
-        triNormal[tri] = normalize(cross(sub(p1, p0), sub(p2, p0)));
-        triCenter[tri] = mul(add(add(p0, p1), p2), 1.0 / 3.0);
-
-        mn.x = std::min({mn.x, p0.x, p1.x, p2.x});
-        mn.y = std::min({mn.y, p0.y, p1.y, p2.y});
-        mn.z = std::min({mn.z, p0.z, p1.z, p2.z});
-        mx.x = std::max({mx.x, p0.x, p1.x, p2.x});
-        mx.y = std::max({mx.y, p0.y, p1.y, p2.y});
-        mx.z = std::max({mx.z, p0.z, p1.z, p2.z});
+        for (uint32_t corner = 0; corner < 3; ++corner) {
+            const Vec3d p = mesh_pos(mesh, mesh.triVerts[tri * 3 + corner]);
+            mn.x = std::min(mn.x, p.x);
+            mn.y = std::min(mn.y, p.y);
+            mn.z = std::min(mn.z, p.z);
+            mx.x = std::max(mx.x, p.x);
+            mx.y = std::max(mx.y, p.y);
+            mx.z = std::max(mx.z, p.z);
+        }
     }
 
     const double bboxDiag = std::max(length(sub(mx, mn)), 1e-6);
     const double planeTol = std::max(1e-5, bboxDiag * 0.003);
     const double sphereTol = std::max(1e-5, bboxDiag * 0.005);
     const double cylinderTol = std::max(1e-5, bboxDiag * 0.0055);
-
-    std::vector<std::vector<uint32_t>> neighbors(triCount);
-    std::unordered_map<uint64_t, std::vector<uint32_t>> edgeToTris;
-    edgeToTris.reserve((size_t)triCount * 2);
-    for (uint32_t tri = 0; tri < triCount; ++tri) {
-        const uint32_t i0 = mesh.triVerts[tri * 3 + 0];
-        const uint32_t i1 = mesh.triVerts[tri * 3 + 1];
-        const uint32_t i2 = mesh.triVerts[tri * 3 + 2];
-        edgeToTris[edge_key(i0, i1)].push_back(tri);
-        edgeToTris[edge_key(i1, i2)].push_back(tri);
-        edgeToTris[edge_key(i2, i0)].push_back(tri);
-    }
-    for (const auto &it : edgeToTris) {
-        const std::vector<uint32_t> &tris = it.second;
-        for (size_t i = 0; i < tris.size(); ++i) {
-            for (size_t j = i + 1; j < tris.size(); ++j) {
-                neighbors[tris[i]].push_back(tris[j]);
-                neighbors[tris[j]].push_back(tris[i]);
-            }
+    const FaceProvenance provenance = BuildFaceProvenance(mesh, sources, triNormal);
+    auto classify = [&](const std::vector<uint32_t> &tris) {
+        RegionFit fit;
+        if (classify_from_source(tris, provenance, triCenter, triNormal, planeTol, sphereTol, cylinderTol, &fit)) {
+            return fit;
         }
-    }
-    for (std::vector<uint32_t> &adj : neighbors) {
-        std::sort(adj.begin(), adj.end());
-        adj.erase(std::unique(adj.begin(), adj.end()), adj.end());
-    }
+        return classify_region(tris, triCenter, triNormal, planeTol, sphereTol, cylinderTol);
+    };
+    auto neighbors = [&](uint32_t tri) {
+        return std::span<const uint32_t>(topo.triNeighbors.data() + topo.triOffset[tri],
+                                         topo.triOffset[tri + 1] - topo.triOffset[tri]);
+    };
 
     constexpr double kPi = 3.14159265358979323846;
     const double threshold = std::cos((double)maxDihedralDegrees * kPi / 180.0);
 
-    std::queue<uint32_t> q;
-    for (uint32_t seed = 0; seed < triCount; ++seed) {
-        if (out.triRegion[seed] != -1) continue;
-        const int regionId = (int)out.regions.size();
-        out.regions.push_back({});
-
-        out.triRegion[seed] = regionId;
-        q.push(seed);
-        while (!q.empty()) {
-            const uint32_t tri = q.front();
-            q.pop();
-            out.regions.back().push_back(tri);
-
-            for (const uint32_t nb : neighbors[tri]) {
-                if (out.triRegion[nb] != -1) continue;
-                const double d = dot(triNormal[tri], triNormal[nb]);
-                if (d < threshold) continue;
-                out.triRegion[nb] = regionId;
-                q.push(nb);
+    // Triangles across a dihedral-compatible edge share a region. Each edge is
+    // tested once, from its lower triangle, and regions are numbered by their
+    // lowest triangle, so ids follow triangle order as a seeded BFS would.
+    ConcurrentDisjointSet triSets(triCount);
+    RunWorkChunks(SplitWork(triCount, kParallelMin), [&](size_t, size_t begin, size_t end) {
+        for (uint32_t tri = (uint32_t)begin; tri < (uint32_t)end; ++tri) {
+            for (const uint32_t nb : neighbors(tri)) {
+                if (nb < tri || dot(triNormal[tri], triNormal[nb]) < threshold) continue;
+                triSets.unite(tri, nb);
             }
         }
+    });
+    for (uint32_t tri = 0; tri < triCount; ++tri) {
+        const uint32_t root = triSets.find(tri);
+        if (root == tri) {
+            out.triRegion[tri] = (int)out.regions.size();
+            out.regions.push_back({});
+        } else {
+            out.triRegion[tri] = out.triRegion[root];
+        }
+        out.regions[(size_t)out.triRegion[tri]].push_back(tri);
     }
 
     std::vector<std::pair<int, int>> regionAdj;
     regionAdj.reserve((size_t)triCount * 2);
     for (uint32_t tri = 0; tri < triCount; ++tri) {
         const int a = out.triRegion[tri];
-        for (uint32_t nb : neighbors[tri]) {
+        for (uint32_t nb : neighbors(tri)) {
             const int b = out.triRegion[nb];
             if (a == b) continue;
             const int lo = std::min(a, b);
@@ -482,23 +462,34 @@ FaceDetectionResult DetectMeshFaces(const manifold::MeshGL &mesh, float maxDihed
     std::sort(regionAdj.begin(), regionAdj.end());
     regionAdj.erase(std::unique(regionAdj.begin(), regionAdj.end()), regionAdj.end());
 
+    // Fits only read the shared mesh data, so regions are fitted and their
+    // pairs compared concurrently; the merges themselves stay serial.
     std::vector<RegionFit> fits(out.regions.size());
-    for (size_t i = 0; i < out.regions.size(); ++i) {
-        fits[i] = classify_region(out.regions[i], triCenter, triNormal, planeTol, sphereTol, cylinderTol);
-    }
+    RunWorkChunks(SplitWork(out.regions.size(), kParallelMinRegions), [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            fits[i] = classify(out.regions[i]);
+        }
+    });
+
+    std::vector<uint8_t> mergeable(regionAdj.size(), 0);
+    RunWorkChunks(SplitWork(regionAdj.size(), kParallelMin), [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const auto &e = regionAdj[i];
+            mergeable[i] = compatible_for_merge(fits[(size_t)e.first], fits[(size_t)e.second], planeTol,
+                                                sphereTol, cylinderTol);
+        }
+    });
 
     DisjointSet dsu(out.regions.size());
-    for (const auto &e : regionAdj) {
-        if (compatible_for_merge(fits[(size_t)e.first], fits[(size_t)e.second], planeTol, sphereTol, cylinderTol)) {
-            dsu.unite(e.first, e.second);
-        }
+    for (size_t i = 0; i < regionAdj.size(); ++i) {
+        if (mergeable[i]) dsu.unite((uint32_t)regionAdj[i].first, (uint32_t)regionAdj[i].second);
     }
 
     std::unordered_map<int, int> rootToNew;
     std::vector<std::vector<uint32_t>> merged;
     for (uint32_t tri = 0; tri < triCount; ++tri) {
         const int old = out.triRegion[tri];
-        const int root = dsu.find(old);
+        const int root = (int)dsu.find((uint32_t)old);
         auto it = rootToNew.find(root);
         int id = -1;
         if (it == rootToNew.end()) {
@@ -514,15 +505,17 @@ FaceDetectionResult DetectMeshFaces(const manifold::MeshGL &mesh, float maxDihed
     out.regions = std::move(merged);
 
     out.regionType.resize(out.regions.size(), FacePrimitiveType::Unknown);
-    for (size_t i = 0; i < out.regions.size(); ++i) {
-        const RegionFit fit = classify_region(out.regions[i], triCenter, triNormal, planeTol, sphereTol, cylinderTol);
-        out.regionType[i] = fit.type;
-    }
+    RunWorkChunks(SplitWork(out.regions.size(), kParallelMinRegions), [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            out.regionType[i] = classify(out.regions[i]).type;
+        }
+    });
 
     return out;
 }
 
 int PickFaceRegionByRay(const manifold::MeshGL &mesh,
+                        const MeshBvh &bvh,
                         const FaceDetectionResult &faces,
                         double rayOriginX, double rayOriginY, double rayOriginZ,
                         double rayDirX, double rayDirY, double rayDirZ,
@@ -530,27 +523,12 @@ int PickFaceRegionByRay(const manifold::MeshGL &mesh,
     const uint32_t triCount = (uint32_t)mesh.NumTri();
     if (triCount == 0 || faces.triRegion.size() != triCount) return -1;
 
-    const Vec3d orig = {rayOriginX, rayOriginY, rayOriginZ};
     const Vec3d dir = normalize({rayDirX, rayDirY, rayDirZ});
-
-    double bestT = std::numeric_limits<double>::infinity();
-    int bestRegion = -1;
-    for (uint32_t tri = 0; tri < triCount; ++tri) {
-        const uint32_t i0 = mesh.triVerts[tri * 3 + 0];
-        const uint32_t i1 = mesh.triVerts[tri * 3 + 1];
-        const uint32_t i2 = mesh.triVerts[tri * 3 + 2];
-        const Vec3d p0 = mesh_pos(mesh, i0);
-        const Vec3d p1 = mesh_pos(mesh, i1);
-        const Vec3d p2 = mesh_pos(mesh, i2);
-        double t = 0.0;
-        if (!ray_intersect_triangle(orig, dir, p0, p1, p2, &t)) continue;
-        if (t >= bestT) continue;
-        bestT = t;
-        bestRegion = faces.triRegion[tri];
-    }
-
-    if (bestRegion >= 0 && outDistance) *outDistance = bestT;
-    return bestRegion;
+    double t = 0.0;
+    uint32_t tri = 0;
+    if (!RaycastMeshBvh(mesh, bvh, rayOriginX, rayOriginY, rayOriginZ, dir.x, dir.y, dir.z, &t, &tri)) return -1;
+    if (outDistance) *outDistance = t;
+    return faces.triRegion[tri];
 }
 
 const char *FacePrimitiveTypeName(FacePrimitiveType type) {
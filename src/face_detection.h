@@ -1,12 +1,16 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <vector>
 
 #include "manifold/manifold.h"
 
 namespace vicad {
 
+struct MeshBvh;
+struct MeshTopology;
+
 enum class FacePrimitiveType {
     Unknown,
     Plane,
@@ -20,9 +24,32 @@ struct FaceDetectionResult {
     std::vector<FacePrimitiveType> regionType;
 };
 
-FaceDetectionResult DetectMeshFaces(const manifold::MeshGL &mesh, float maxDihedralDegrees);
+enum class FaceSourceShape {
+    Box,         // every face planar
+    Sphere,      // centered on the origin
+    Cylinder,    // side of `radius` around the axis, planar ends
+    PlanarEnds,  // only the ends normal to the axis are known (extrusions, cones)
+};
+
+// A primitive the op stream built, keyed by the manifold original ID its
+// triangles keep in MeshGL::runOriginalID through booleans. The shape is in
+// the primitive's own frame, with its axis +Z through the origin; each run's
+// runTransform places it in the mesh.
+struct FaceSource {
+    uint32_t originalId = 0;
+    FaceSourceShape shape = FaceSourceShape::Box;
+    double radius = 0.0;
+};
+
+// `topo` must be built from `mesh` (see mesh_topology.h). A region whose
+// triangles all lie on one known surface of `sources` takes that surface's
+// type and parameters after a residual check; only the rest are fitted.
+FaceDetectionResult DetectMeshFaces(const manifold::MeshGL &mesh, const MeshTopology &topo,
+                                    float maxDihedralDegrees, const std::vector<FaceSource> &sources = {});
 
+// `bvh` must be built from `mesh` (see mesh_bvh.h).
 int PickFaceRegionByRay(const manifold::MeshGL &mesh,
+                        const MeshBvh &bvh,
                         const FaceDetectionResult &faces,
                         double rayOriginX, double rayOriginY, double rayOriginZ,
                         double rayDirX, double rayDirY, double rayDirZ,
@@ -0,0 +1,136 @@
+#include "face_provenance.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace vicad {
+
+namespace {
+
+using Vec3d = MeshTopoVec3;
+
+// Ends are told from sides by their normal: sides of a cylinder are normal
+// to the axis, and extruded or conical sides lean well away from it.
+constexpr double kEndNormalCos = 0.999;
+
+static Vec3d sub(const Vec3d &a, const Vec3d &b) {
+    return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+static double dot(const Vec3d &a, const Vec3d &b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static double length(const Vec3d &v) {
+    return std::sqrt(dot(v, v));
+}
+
+static Vec3d normalize(const Vec3d &v) {
+    const double l = length(v);
+    if (l <= 1e-30) return {0.0, 0.0, 0.0};
+    return {v.x / l, v.y / l, v.z / l};
+}
+
+// Only a similarity transform keeps spheres, cylinders and what is normal to
+// an axis intact, so under any other transform only boxes stay known.
+static std::vector<FaceRunSurface> run_surfaces(const manifold::MeshGL &mesh,
+                                                const std::vector<FaceSource> &sources) {
+    const size_t runCount = mesh.runIndex.empty() ? 0 : mesh.runIndex.size() - 1;
+    std::vector<FaceRunSurface> out(runCount);
+    if (sources.empty() || mesh.runOriginalID.size() < runCount) return out;
+
+    std::unordered_map<uint32_t, const FaceSource *> byId;
+    for (const FaceSource &s : sources) byId[s.originalId] = &s;
+    const bool hasTransforms = mesh.runTransform.size() >= runCount * 12;
+    for (size_t r = 0; r < runCount; ++r) {
+        const auto it = byId.find(mesh.runOriginalID[r]);
+        if (it == byId.end()) continue;
+        double m[12] = {1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0};
+        if (hasTransforms) {
+            for (int i = 0; i < 12; ++i) m[i] = (double)mesh.runTransform[r * 12 + (size_t)i];
+        }
+        const Vec3d cx = {m[0], m[1], m[2]};
+        const Vec3d cy = {m[3], m[4], m[5]};
+        const Vec3d cz = {m[6], m[7], m[8]};
+        const double s = length(cx);
+        const double tol = 1e-5 * s;
+        const bool similar = s > 1e-12 && std::fabs(length(cy) - s) <= tol && std::fabs(length(cz) - s) <= tol &&
+                             std::fabs(dot(cx, cy)) <= tol * s && std::fabs(dot(cy, cz)) <= tol * s &&
+                             std::fabs(dot(cx, cz)) <= tol * s;
+        FaceRunSurface &surf = out[r];
+        surf.shape = it->second->shape;
+        surf.known = similar || surf.shape == FaceSourceShape::Box;
+        surf.origin = {m[9], m[10], m[11]};
+        surf.axis = normalize(cz);
+        surf.radius = it->second->radius * s;
+    }
+    return out;
+}
+
+static std::vector<FaceTriSource> tri_sources(const manifold::MeshGL &mesh,
+                                              const std::vector<FaceRunSurface> &surfaces,
+                                              const std::vector<Vec3d> &triNormals) {
+    std::vector<FaceTriSource> out;
+    const uint32_t triCount = (uint32_t)triNormals.size();
+    for (size_t r = 0; r < surfaces.size(); ++r) {
+        const FaceRunSurface &surf = surfaces[r];
+        if (!surf.known) continue;
+        if (out.empty()) out.resize(triCount);
+        const uint32_t end = std::min(mesh.runIndex[r + 1] / 3, triCount);
+        for (uint32_t tri = mesh.runIndex[r] / 3; tri < end; ++tri) {
+            const Vec3d n = triNormals[tri];
+            if (dot(n, n) < 0.5) continue;
+            const bool isEnd = std::fabs(dot(n, surf.axis)) >= kEndNormalCos;
+            FacePrimitiveType type = FacePrimitiveType::Unknown;
+            switch (surf.shape) {
+                case FaceSourceShape::Box: type = FacePrimitiveType::Plane; break;
+                case FaceSourceShape::Sphere: type = FacePrimitiveType::Sphere; break;
+                case FaceSourceShape::Cylinder:
+                    type = isEnd ? FacePrimitiveType::Plane : FacePrimitiveType::Cylinder;
+                    break;
+                case FaceSourceShape::PlanarEnds:
+                    if (isEnd) type = FacePrimitiveType::Plane;
+                    break;
+            }
+            out[tri] = {(uint32_t)r, type};
+        }
+    }
+    return out;
+}
+
+}  // namespace
+
+FaceProvenance BuildFaceProvenance(const manifold::MeshGL &mesh, const std::vector<FaceSource> &sources,
+                                   const std::vector<MeshTopoVec3> &triNormals) {
+    FaceProvenance out;
+    out.surfaces = run_surfaces(mesh, sources);
+    out.triSource = tri_sources(mesh, out.surfaces, triNormals);
+    return out;
+}
+
+const FaceRunSurface *FaceRegionSource(const FaceProvenance &provenance, const std::vector<uint32_t> &tris,
+                                       FacePrimitiveType *type) {
+    if (tris.empty() || provenance.triSource.empty()) return nullptr;
+    const FaceTriSource first = provenance.triSource[tris[0]];
+    if (first.type == FacePrimitiveType::Unknown) return nullptr;
+    for (uint32_t t : tris) {
+        const FaceTriSource &s = provenance.triSource[t];
+        if (s.type != first.type) return nullptr;
+        if (first.type != FacePrimitiveType::Plane && s.run != first.run) return nullptr;
+    }
+    *type = first.type;
+    return &provenance.surfaces[first.run];
+}
+
+double FaceSourceSphereRms(const FaceRunSurface &sphere, const std::vector<uint32_t> &tris,
+                           const std::vector<MeshTopoVec3> &triCenters) {
+    double err2 = 0.0;
+    for (uint32_t t : tris) {
+        const double e = length(sub(triCenters[t], sphere.origin)) - sphere.radius;
+        err2 += e * e;
+    }
+    return std::sqrt(err2 / (double)tris.size());
+}
+
+}  // namespace vicad
@@ -0,0 +1,52 @@
+#ifndef VICAD_FACE_PROVENANCE_H_
+#define VICAD_FACE_PROVENANCE_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "face_detection.h"
+#include "manifold/manifold.h"
+#include "mesh_topology.h"
+
+namespace vicad {
+
+// A run's source shape placed in mesh space.
+struct FaceRunSurface {
+    bool known = false;
+    FaceSourceShape shape = FaceSourceShape::Box;
+    MeshTopoVec3 origin = {0.0, 0.0, 0.0};
+    MeshTopoVec3 axis = {0.0, 0.0, 1.0};
+    double radius = 0.0;
+};
+
+// Surface a triangle lies on according to its run's source; Unknown when the
+// source does not say. Curved surfaces are only shared within one run.
+struct FaceTriSource {
+    uint32_t run = 0;
+    FacePrimitiveType type = FacePrimitiveType::Unknown;
+};
+
+// What the op stream says about the triangles of a mesh. `triSource` is empty
+// when no run has a known surface.
+struct FaceProvenance {
+    std::vector<FaceRunSurface> surfaces;
+    std::vector<FaceTriSource> triSource;
+};
+
+// Matches runs to `sources` by runOriginalID and types each triangle of a known
+// run. `triNormals` is MeshTopology::triNormal of `mesh`.
+FaceProvenance BuildFaceProvenance(const manifold::MeshGL &mesh, const std::vector<FaceSource> &sources,
+                                   const std::vector<MeshTopoVec3> &triNormals);
+
+// The surface a region lies on when every triangle has the same known type
+// (and, when curved, the same run); null otherwise. Sets `type` on success.
+const FaceRunSurface *FaceRegionSource(const FaceProvenance &provenance, const std::vector<uint32_t> &tris,
+                                       FacePrimitiveType *type);
+
+// RMS distance of the triangle centers from a sphere source's surface.
+double FaceSourceSphereRms(const FaceRunSurface &sphere, const std::vector<uint32_t> &tris,
+                           const std::vector<MeshTopoVec3> &triCenters);
+
+}  // namespace vicad
+
+#endif  // VICAD_FACE_PROVENANCE_H_
@@ -0,0 +1,295 @@
+#include "file_watch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#elif defined(__APPLE__)
+#include <sys/event.h>
+#endif
+
+namespace vicad {
+
+namespace {
+
+std::string parent_dir(const std::string &path) {
+  const size_t slash = path.find_last_of('/');
+  if (slash == std::string::npos) return ".";
+  if (slash == 0) return "/";
+  return path.substr(0, slash);
+}
+
+std::string file_name(const std::string &path) {
+  const size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+void drain(int fd) {
+  char buf[64];
+  while (read(fd, buf, sizeof(buf)) > 0) {
+  }
+}
+
+}  // namespace
+
+FileChangeNotifier::FileChangeNotifier() {
+  if (pipe(wake_pipe_) != 0) {
+    wake_pipe_[0] = wake_pipe_[1] = -1;
+    return;
+  }
+  for (const int fd : wake_pipe_) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+#if defined(__linux__)
+  queue_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#elif defined(__APPLE__)
+  queue_fd_ = kqueue();
+  if (queue_fd_ >= 0) {
+    fcntl(queue_fd_, F_SETFD, FD_CLOEXEC);
+    struct kevent ev;
+    EV_SET(&ev, wake_pipe_[0], EVFILT_READ, EV_ADD, 0, 0, nullptr);
+    if (kevent(queue_fd_, &ev, 1, nullptr, 0, nullptr) != 0) {
+      close(queue_fd_);
+      queue_fd_ = -1;
+    }
+  }
+#endif
+  native_ = queue_fd_ >= 0;
+}
+
+FileChangeNotifier::~FileChangeNotifier() {
+#if defined(__APPLE__)
+  for (const int fd : dir_fds_) close(fd);
+  for (const auto &entry : file_fds_) close(entry.first);
+#endif
+  if (queue_fd_ >= 0) close(queue_fd_);
+  for (const int fd : wake_pipe_) {
+    if (fd >= 0) close(fd);
+  }
+}
+
+void FileChangeNotifier::Wake() {
+  if (wake_pipe_[1] < 0) return;
+  const char byte = 1;
+  (void)!write(wake_pipe_[1], &byte, 1);
+}
+
+bool FileChangeNotifier::Wait(int timeout_ms) {
+  if (wake_pipe_[0] < 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(std::max(timeout_ms, 0)));
+    return false;
+  }
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout_ms, 0));
+  for (;;) {
+    int remaining = -1;
+    if (timeout_ms >= 0) {
+      const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - std::chrono::steady_clock::now());
+      remaining = (int)std::max<long long>(left.count(), 0);
+    }
+    const int result = wait_once(remaining);
+    if (result != 0) return result > 0;
+    if (remaining == 0) return false;
+  }
+}
+
+#if defined(__linux__)
+
+void FileChangeNotifier::Watch(const std::vector<std::string> &paths) {
+  paths_ = paths;
+  complete_ = true;
+  if (!native_) return;
+  for (const auto &entry : dir_watches_) inotify_rm_watch(queue_fd_, entry.first);
+  dir_watches_.clear();
+  constexpr uint32_t kMask = IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                             IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+  for (const std::string &path : paths) {
+    const int wd = inotify_add_watch(queue_fd_, parent_dir(path).c_str(), kMask);
+    if (wd < 0) {
+      complete_ = false;
+      continue;
+    }
+    dir_watches_[wd].push_back(file_name(path));
+  }
+}
+
+int FileChangeNotifier::wait_once(int timeout_ms) {
+  struct pollfd fds[2] = {{wake_pipe_[0], POLLIN, 0}, {queue_fd_, POLLIN, 0}};
+  const int rc = poll(fds, native_ ? 2 : 1, timeout_ms);
+  if (rc <= 0) return rc == 0 ? -1 : 0;
+  bool hit = false;
+  if (fds[0].revents & POLLIN) {
+    drain(wake_pipe_[0]);
+    hit = true;
+  }
+  if (!native_ || !(fds[1].revents & POLLIN)) return hit ? 1 : 0;
+  bool lost_watch = false;
+  alignas(struct inotify_event) char buf[4096];
+  ssize_t len;
+  while ((len = read(queue_fd_, buf, sizeof(buf))) > 0) {
+    for (const char *p = buf; p < buf + len;) {
+      const struct inotify_event *ev = (const struct inotify_event *)p;
+      p += sizeof(struct inotify_event) + ev->len;
+      if (ev->mask & IN_Q_OVERFLOW) {
+        hit = true;
+        continue;
+      }
+      auto it = dir_watches_.find(ev->wd);
+      if (it == dir_watches_.end()) continue;
+      if (ev->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+        // The directory itself went away; watching it again happens below.
+        lost_watch = true;
+        hit = true;
+        continue;
+      }
+      if (ev->len > 0 && std::find(it->second.begin(), it->second.end(), ev->name) != it->second.end()) {
+        hit = true;
+      }
+    }
+  }
+  if (lost_watch) Watch(std::vector<std::string>(paths_));
+  return hit ? 1 : 0;
+}
+
+#elif defined(__APPLE__)
+
+void FileChangeNotifier::watch_fd(int fd, unsigned int events) {
+  struct kevent ev;
+  EV_SET(&ev, fd, EVFILT_VNODE, EV_ADD | EV_CLEAR, events, 0, nullptr);
+  (void)kevent(queue_fd_, &ev, 1, nullptr, 0, nullptr);
+}
+
+// Closing a descriptor drops its kevents, so re-opening re-arms the file
+// after an editor replaced it.
+void FileChangeNotifier::open_files() {
+  for (const auto &entry : file_fds_) close(entry.first);
+  file_fds_.clear();
+  for (const std::string &path : paths_) {
+    const int fd = open(path.c_str(), O_EVTONLY | O_CLOEXEC);
+    if (fd < 0) continue;  // a missing file shows up through its directory
+    file_fds_[fd] = path;
+    watch_fd(fd, NOTE_WRITE | NOTE_EXTEND | NOTE_ATTRIB | NOTE_DELETE | NOTE_RENAME);
+  }
+}
+
+void FileChangeNotifier::Watch(const std::vector<std::string> &paths) {
+  paths_ = paths;
+  complete_ = true;
+  if (!native_) return;
+  for (const int fd : dir_fds_) close(fd);
+  dir_fds_.clear();
+  std::vector<std::string> dirs;
+  for (const std::string &path : paths) {
+    const std::string dir = parent_dir(path);
+    if (std::find(dirs.begin(), dirs.end(), dir) != dirs.end()) continue;
+    dirs.push_back(dir);
+    const int fd = open(dir.c_str(), O_EVTONLY | O_CLOEXEC);
+    if (fd < 0) {
+      complete_ = false;
+      continue;
+    }
+    dir_fds_.push_back(fd);
+    watch_fd(fd, NOTE_WRITE | NOTE_DELETE | NOTE_RENAME);
+  }
+  open_files();
+}
+
+int FileChangeNotifier::wait_once(int timeout_ms) {
+  if (!native_) {
+    if (timeout_ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+    return -1;
+  }
+  struct timespec ts = {timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L};
+  struct kevent events[16];
+  const int rc = kevent(queue_fd_, nullptr, 0, events, 16, timeout_ms >= 0 ? &ts : nullptr);
+  if (rc <= 0) return rc == 0 ? -1 : 0;
+  bool hit = false;
+  bool reopen = false;
+  for (int i = 0; i < rc; ++i) {
+    const int fd = (int)events[i].ident;
+    if (events[i].filter == EVFILT_READ && fd == wake_pipe_[0]) {
+      drain(wake_pipe_[0]);
+      hit = true;
+      continue;
+    }
+    // Directory events name no entry: any of them may be a watched file
+    // being created or renamed over, so they count as hits too.
+    hit = true;
+    if (file_fds_.count(fd)) {
+      if (events[i].fflags & (NOTE_DELETE | NOTE_RENAME)) reopen = true;
+    } else {
+      reopen = true;
+    }
+  }
+  if (reopen) open_files();
+  return hit ? 1 : 0;
+}
+
+#else
+
+void FileChangeNotifier::Watch(const std::vector<std::string> &paths) { paths_ = paths; }
+
+int FileChangeNotifier::wait_once(int timeout_ms) {
+  if (timeout_ms > 0) std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+  return -1;
+}
+
+#endif
+
+bool ReadFileStamp(const char *path, FileStamp *out) {
+  struct stat st;
+  if (!out || !path || stat(path, &st) != 0) return false;
+  FileStamp stamp = {};
+#if defined(__APPLE__)
+  stamp.mtime_ns = (long long)st.st_mtimespec.tv_sec * 1000000000LL + (long long)st.st_mtimespec.tv_nsec;
+  stamp.ctime_ns = (long long)st.st_ctimespec.tv_sec * 1000000000LL + (long long)st.st_ctimespec.tv_nsec;
+#else
+  stamp.mtime_ns = (long long)st.st_mtim.tv_sec * 1000000000LL + (long long)st.st_mtim.tv_nsec;
+  stamp.ctime_ns = (long long)st.st_ctim.tv_sec * 1000000000LL + (long long)st.st_ctim.tv_nsec;
+#endif
+  stamp.size_bytes = (long long)st.st_size;
+  *out = stamp;
+  return true;
+}
+
+uint64_t ImportsStamp(const std::vector<std::string> &imports) {
+  uint64_t h = 1469598103934665603ull;
+  auto mix = [&h](long long v) {
+    h ^= (uint64_t)v;
+    h *= 1099511628211ull;
+  };
+  for (const std::string &path : imports) {
+    FileStamp stamp = {-1, -1, -1};
+    (void)ReadFileStamp(path.c_str(), &stamp);
+    mix(stamp.mtime_ns);
+    mix(stamp.ctime_ns);
+    mix(stamp.size_bytes);
+  }
+  return h;
+}
+
+bool TakeStampChange(const std::string &script_path, const std::vector<std::string> &imports, long long *mtime_ns,
+                     long long *ctime_ns, long long *size_bytes, uint64_t *last_imports_stamp) {
+  FileStamp stamp = {};
+  if (!ReadFileStamp(script_path.c_str(), &stamp)) return false;
+  const uint64_t deps_stamp = ImportsStamp(imports);
+  if (stamp.mtime_ns == *mtime_ns && stamp.ctime_ns == *ctime_ns && stamp.size_bytes == *size_bytes &&
+      deps_stamp == *last_imports_stamp) {
+    return false;
+  }
+  *mtime_ns = stamp.mtime_ns;
+  *ctime_ns = stamp.ctime_ns;
+  *size_bytes = stamp.size_bytes;
+  *last_imports_stamp = deps_stamp;
+  return true;
+}
+
+}  // namespace vicad
@@ -0,0 +1,74 @@
+#ifndef VICAD_FILE_WATCH_H_
+#define VICAD_FILE_WATCH_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace vicad {
+
+// Modification time, change time and size of a file, compared to tell
+// whether it changed.
+struct FileStamp {
+  long long mtime_ns;
+  long long ctime_ns;
+  long long size_bytes;
+};
+
+bool ReadFileStamp(const char *path, FileStamp *out);
+// Folds the stamps of a script's imports into one value; a missing file
+// folds in as all -1, so deleting one counts as a change too.
+uint64_t ImportsStamp(const std::vector<std::string> &imports);
+// Records the current stamps of the script and its imports; false when none
+// has changed (or the script cannot be read) since the last reload.
+bool TakeStampChange(const std::string &script_path, const std::vector<std::string> &imports, long long *mtime_ns,
+                     long long *ctime_ns, long long *size_bytes, uint64_t *last_imports_stamp);
+
+// Blocks a watcher thread until files may have changed, on the OS's file
+// events: inotify on Linux, kqueue on macOS. Each file's directory is watched
+// as well, so a save that writes a temporary file and renames it over the
+// original is seen. Events are hints; callers stat the files to confirm.
+class FileChangeNotifier {
+ public:
+  FileChangeNotifier();
+  ~FileChangeNotifier();
+
+  FileChangeNotifier(const FileChangeNotifier &) = delete;
+  FileChangeNotifier &operator=(const FileChangeNotifier &) = delete;
+
+  // Whether every watched file is covered by OS events. False when the
+  // platform has no backend, it failed to start or a directory could not be
+  // watched; Wait then only times out or wakes, and callers poll.
+  bool watching() const { return native_ && complete_; }
+  // Replaces the watched files.
+  void Watch(const std::vector<std::string> &paths);
+  // Waits for an event on a watched file or a Wake, for at most timeout_ms
+  // (-1 waits without limit). Returns false on timeout.
+  bool Wait(int timeout_ms);
+  // Safe from any thread: ends the current or next Wait.
+  void Wake();
+
+ private:
+  // One wait on the backend: 1 for an event on a watched file or a Wake, 0
+  // for events on other files only, -1 on timeout.
+  int wait_once(int timeout_ms);
+
+  bool native_ = false;
+  bool complete_ = true;
+  int queue_fd_ = -1;  // inotify instance or kqueue
+  int wake_pipe_[2] = {-1, -1};
+  std::vector<std::string> paths_;
+#if defined(__linux__)
+  std::map<int, std::vector<std::string>> dir_watches_;  // watch descriptor -> file names in it
+#elif defined(__APPLE__)
+  std::vector<int> dir_fds_;
+  std::map<int, std::string> file_fds_;  // open file -> its path, re-opened after its directory changes
+  void watch_fd(int fd, unsigned int events);
+  void open_files();
+#endif
+};
+
+}  // namespace vicad
+
+#endif  // VICAD_FILE_WATCH_H_
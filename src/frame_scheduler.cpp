@@ -0,0 +1,36 @@
+#include "frame_scheduler.h"
+
+#include <algorithm>
+
+namespace vicad_frame {
+
+void FrameScheduler::CameraMoved(Clock::time_point now) {
+  damage_ |= kDamageCamera;
+  interacting_ = true;
+  settle_deadline_ = now + settle_interval_;
+}
+
+void FrameScheduler::Settle(Clock::time_point now) {
+  if (!interacting_ || now < settle_deadline_) return;
+  interacting_ = false;
+  damage_ |= kDamageViewport;
+}
+
+int FrameScheduler::WaitMs(Clock::time_point now) const {
+  if (!Dirty()) {
+    if (!interacting_) return -1;
+    if (now >= settle_deadline_) return 0;
+    const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(settle_deadline_ - now);
+    return (int)std::max<long long>(1LL, remaining.count());
+  }
+  if (now >= next_frame_deadline_) return 0;
+  const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(next_frame_deadline_ - now);
+  return (int)std::max<long long>(1LL, std::min<long long>(frame_interval_.count(), remaining.count()));
+}
+
+void FrameScheduler::FramePresented(Clock::time_point now) {
+  next_frame_deadline_ = now + frame_interval_;
+  damage_ = kDamageNone;
+}
+
+}  // namespace vicad_frame
@@ -0,0 +1,71 @@
+#ifndef VICAD_FRAME_SCHEDULER_H_
+#define VICAD_FRAME_SCHEDULER_H_
+
+#include <chrono>
+#include <cstdint>
+
+namespace vicad_frame {
+
+// Why the next frame has to be drawn. Everything but kDamageUi invalidates
+// the 3D viewport layer; UI-only damage repaints the UI over the cached one.
+enum FrameDamage : uint32_t {
+  kDamageNone = 0,
+  kDamageCamera = 1u << 0,
+  kDamageHover = 1u << 1,
+  kDamageSelection = 1u << 2,
+  kDamageScene = 1u << 3,
+  kDamageFileWatch = 1u << 4,
+  kDamageViewport = 1u << 5,  // resize, display toggles, anything else 3D
+  kDamageUi = 1u << 6,
+  kDamageAll = 0x7Fu,
+};
+
+constexpr uint32_t kDamageViewportMask = kDamageAll & ~(uint32_t)kDamageUi;
+
+// Render-on-demand pacing: frames are drawn only while damage is pending and
+// no faster than one per frame interval. With nothing pending the main loop
+// blocks in the event wait until input or a background wake-up arrives.
+//
+// Camera motion puts the viewport in interactive mode: frames drawn while it
+// lasts may cut quality (coarser meshes, no overlays) to keep up with input.
+// Once the camera has been still for the settle interval, Settle() leaves the
+// mode and damages the viewport so the resting view is redrawn in full.
+class FrameScheduler {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit FrameScheduler(std::chrono::milliseconds frame_interval,
+                          std::chrono::milliseconds settle_interval = std::chrono::milliseconds(150))
+      : frame_interval_(frame_interval), settle_interval_(settle_interval) {}
+
+  void Mark(uint32_t damage) { damage_ |= damage; }
+  uint32_t damage() const { return damage_; }
+  bool Dirty() const { return damage_ != kDamageNone; }
+  bool ViewportDirty() const { return (damage_ & kDamageViewportMask) != 0; }
+
+  // Marks camera damage and (re)starts the settle interval.
+  void CameraMoved(Clock::time_point now);
+  bool Interacting() const { return interacting_; }
+  // Ends interactive mode once the settle interval has passed.
+  void Settle(Clock::time_point now);
+
+  // Milliseconds to block waiting for events: -1 (wait indefinitely) when
+  // clean and not interacting, 0 when a frame is due, else the time left
+  // until the frame or settle deadline.
+  int WaitMs(Clock::time_point now) const;
+  bool FrameDue(Clock::time_point now) const { return Dirty() && now >= next_frame_deadline_; }
+  // Clears the damage drawn by the frame just presented.
+  void FramePresented(Clock::time_point now);
+
+ private:
+  std::chrono::milliseconds frame_interval_;
+  std::chrono::milliseconds settle_interval_;
+  Clock::time_point next_frame_deadline_ = Clock::now();
+  Clock::time_point settle_deadline_ = Clock::now();
+  bool interacting_ = false;
+  uint32_t damage_ = kDamageAll;
+};
+
+}  // namespace vicad_frame
+
+#endif  // VICAD_FRAME_SCHEDULER_H_
@@ -0,0 +1,490 @@
+#include "glyph_atlas.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef VICAD_HAS_HARFBUZZ
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <hb.h>
+#include <hb-ft.h>
+#endif
+
+#if defined(__APPLE__)
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+
+#include "funnel_sans_baked.h"
+
+namespace vicad_text {
+
+namespace {
+
+constexpr int kAtlasPageSize = 1024;
+constexpr size_t kMaxAtlasPages = 4;
+constexpr size_t kRunCacheLimit = 1024;
+constexpr int kGlyphPadding = 1;
+// Opaque block at the top-left of every page, sampled by solid UI quads.
+constexpr int kSolidBlockSize = 4;
+
+uint64_t hash_run(std::string_view text, int raster_px) {
+  uint64_t h = 1469598103934665603ull;
+  for (const char c : text) {
+    h ^= (uint8_t)c;
+    h *= 1099511628211ull;
+  }
+  return h ^ ((uint64_t)(uint32_t)raster_px * 0x9E3779B97F4A7C15ull);
+}
+
+uint64_t glyph_key(int raster_px, uint32_t glyph) { return ((uint64_t)(uint32_t)raster_px << 32) | glyph; }
+
+uint8_t color_byte(float c) { return (uint8_t)std::lround(std::clamp(c, 0.0f, 1.0f) * 255.0f); }
+
+#ifdef VICAD_HAS_HARFBUZZ
+int fixed26_6_floor(int v) {
+  if (v >= 0) return v / 64;
+  return -(((-v) + 63) / 64);
+}
+#endif
+
+}  // namespace
+
+int BaseFontPixelSize() { return VICAD_BAKED_PIXEL_SIZE; }
+
+#ifdef VICAD_HAS_HARFBUZZ
+struct TextRenderer::FontState {
+  FT_Library ft_library = nullptr;
+  FT_Face ft_face = nullptr;
+  hb_font_t *hb_font = nullptr;
+  hb_buffer_t *buffer = nullptr;
+  int current_px = 0;
+
+  bool set_px(int px) {
+    if (px == current_px) return true;
+    if (FT_Set_Pixel_Sizes(ft_face, 0, (FT_UInt)px) != 0) return false;
+    hb_ft_font_changed(hb_font);
+    current_px = px;
+    return true;
+  }
+};
+#else
+struct TextRenderer::FontState {};
+#endif
+
+TextRenderer::~TextRenderer() = default;
+
+// HarfBuzz shaping when the font loads; the baked font otherwise.
+bool TextRenderer::ensure_font() {
+  if (font_) return true;
+  if (font_failed_) return false;
+  font_failed_ = true;
+#ifdef VICAD_HAS_HARFBUZZ
+  FontState *font = new FontState();
+  if (FT_Init_FreeType(&font->ft_library) != 0) {
+    delete font;
+    return false;
+  }
+  if (FT_New_Face(font->ft_library, "Funnel_Sans/static/FunnelSans-Regular.ttf", 0, &font->ft_face) != 0) {
+    FT_Done_FreeType(font->ft_library);
+    delete font;
+    return false;
+  }
+  font->hb_font = hb_ft_font_create_referenced(font->ft_face);
+  if (!font->hb_font) {
+    FT_Done_Face(font->ft_face);
+    FT_Done_FreeType(font->ft_library);
+    delete font;
+    return false;
+  }
+  hb_ft_font_set_load_flags(font->hb_font, FT_LOAD_DEFAULT);
+  font->buffer = hb_buffer_create();
+  font_ = font;
+  font_failed_ = false;
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Shaped text is rasterized at whole pixel sizes and drawn unscaled; the
+// baked font has one size and scales.
+int TextRenderer::raster_px_for(float font_px) {
+  if (ensure_font()) return std::max(1, (int)std::lround(font_px));
+  return VICAD_BAKED_PIXEL_SIZE;
+}
+
+float TextRenderer::scale_for(float font_px, int raster_px) const {
+  if (font_) return 1.0f;
+  return font_px / (float)raster_px;
+}
+
+bool TextRenderer::shape(std::string_view text, int raster_px, Run *out) {
+  out->raster_px = raster_px;
+  out->glyphs.clear();
+  out->complete = true;
+  float advance_width = 0.0f;
+  int lines = 1;
+#ifdef VICAD_HAS_HARFBUZZ
+  if (font_) {
+    if (!font_->set_px(raster_px)) return false;
+    const int line_height = std::max(1, (int)(font_->ft_face->size->metrics.height >> 6));
+    const int ascender = (int)(font_->ft_face->size->metrics.ascender >> 6);
+    float ink_right = 0.0f;
+    bool has_ink = false;
+    size_t line_start = 0;
+    for (;;) {
+      size_t line_end = text.find('\n', line_start);
+      if (line_end == std::string_view::npos) line_end = text.size();
+      const std::string_view line = text.substr(line_start, line_end - line_start);
+      hb_buffer_t *buffer = font_->buffer;
+      hb_buffer_reset(buffer);
+      hb_buffer_add_utf8(buffer, line.data(), (int)line.size(), 0, (int)line.size());
+      hb_buffer_guess_segment_properties(buffer);
+      hb_shape(font_->hb_font, buffer, nullptr, 0);
+      unsigned int glyph_count = 0;
+      const hb_glyph_info_t *infos = hb_buffer_get_glyph_infos(buffer, &glyph_count);
+      const hb_glyph_position_t *positions = hb_buffer_get_glyph_positions(buffer, &glyph_count);
+      const int line_top = (lines - 1) * line_height;
+      int pen_x = 0;
+      int pen_y = 0;
+      for (unsigned int i = 0; i < glyph_count; ++i) {
+        const RunGlyph g = {
+            infos[i].codepoint,
+            fixed26_6_floor(pen_x + positions[i].x_offset),
+            line_top + ascender - fixed26_6_floor(pen_y + positions[i].y_offset),
+        };
+        const AtlasGlyph *ag = glyph_for(raster_px, g.glyph);
+        if (!ag) out->complete = false;
+        if (ag && ag->w > 0 && ag->h > 0) {
+          const float right = (float)(g.x + ag->left + ag->w);
+          ink_right = has_ink ? std::max(ink_right, right) : right;
+          has_ink = true;
+          out->glyphs.push_back(g);
+        }
+        pen_x += positions[i].x_advance;
+        pen_y += positions[i].y_advance;
+      }
+      advance_width = std::max(advance_width, (float)fixed26_6_floor(pen_x));
+      if (line_end >= text.size()) break;
+      line_start = line_end + 1;
+      ++lines;
+    }
+    out->metrics.width = has_ink ? ink_right : advance_width;
+    out->metrics.height = (float)(line_height * lines);
+    return true;
+  }
+#endif
+  // Baked font: one glyph per byte, no kerning.
+  int pen_x = 0;
+  int baseline = VICAD_BAKED_ASCENDER;
+  for (const char c : text) {
+    unsigned char ch = (unsigned char)c;
+    if (ch == '\n') {
+      advance_width = std::max(advance_width, (float)pen_x);
+      pen_x = 0;
+      baseline += VICAD_BAKED_LINE_HEIGHT;
+      ++lines;
+      continue;
+    }
+    if (ch < VICAD_BAKED_FIRST_CHAR || ch > VICAD_BAKED_LAST_CHAR) ch = '?';
+    const VicadBakedGlyph &bg = vicad_baked_glyphs[ch - VICAD_BAKED_FIRST_CHAR];
+    if (bg.w > 0 && bg.h > 0) out->glyphs.push_back({(uint32_t)ch, pen_x, baseline});
+    pen_x += bg.advance;
+  }
+  advance_width = std::max(advance_width, (float)pen_x);
+  out->metrics.width = advance_width;
+  out->metrics.height = (float)(VICAD_BAKED_LINE_HEIGHT * lines);
+  return true;
+}
+
+const TextRenderer::Run *TextRenderer::run_for(std::string_view text, int raster_px) {
+  const uint64_t h = hash_run(text, raster_px);
+  auto it = run_index_.find(h);
+  if (it != run_index_.end()) {
+    Run &run = *it->second;
+    if (run.raster_px == raster_px && run.text == text) {
+      runs_.splice(runs_.begin(), runs_, it->second);
+      return &run;
+    }
+    // Hash collision: the newer text takes the slot.
+    runs_.erase(it->second);
+    run_index_.erase(it);
+  }
+  Run run;
+  run.hash = h;
+  run.text.assign(text.data(), text.size());
+  if (!shape(text, raster_px, &run)) return nullptr;
+  if (!run.complete) {
+    // Shaped against a full atlas; kept out of the cache so it is redone
+    // once BeginFrame has made room.
+    uncached_run_ = std::move(run);
+    return &uncached_run_;
+  }
+  runs_.push_front(std::move(run));
+  run_index_[h] = runs_.begin();
+  while (runs_.size() > kRunCacheLimit) {
+    run_index_.erase(runs_.back().hash);
+    runs_.pop_back();
+  }
+  return &runs_.front();
+}
+
+bool TextRenderer::add_page() {
+  if (pages_.size() >= kMaxAtlasPages) return false;
+  GLuint tex = 0;
+  glGenTextures(1, &tex);
+  if (tex == 0) return false;
+  std::vector<uint8_t> pixels((size_t)kAtlasPageSize * kAtlasPageSize, 0);
+  for (int y = 0; y < kSolidBlockSize; ++y) {
+    for (int x = 0; x < kSolidBlockSize; ++x) pixels[(size_t)y * kAtlasPageSize + x] = 255;
+  }
+  glBindTexture(GL_TEXTURE_2D, tex);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, kAtlasPageSize, kAtlasPageSize, 0, GL_ALPHA, GL_UNSIGNED_BYTE,
+               pixels.data());
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  Page page;
+  page.texture = tex;
+  page.shelf_x = kSolidBlockSize + kGlyphPadding;
+  page.shelf_h = kSolidBlockSize + kGlyphPadding;
+  pages_.push_back(std::move(page));
+  return true;
+}
+
+// Shelf packing into the newest page, opening another when it is full.
+bool TextRenderer::pack(int w, int h, const uint8_t *alpha, int pitch, AtlasGlyph *out) {
+  if (w + kGlyphPadding > kAtlasPageSize || h + kGlyphPadding > kAtlasPageSize) return false;
+  Page *page = pages_.empty() ? nullptr : &pages_.back();
+  if (page) {
+    if (page->shelf_x + w + kGlyphPadding > kAtlasPageSize) {
+      page->shelf_y += page->shelf_h;
+      page->shelf_x = 0;
+      page->shelf_h = 0;
+    }
+    if (page->shelf_y + h + kGlyphPadding > kAtlasPageSize) page = nullptr;
+  }
+  if (!page) {
+    if (!add_page()) {
+      atlas_full_ = pages_.size() >= kMaxAtlasPages;
+      return false;
+    }
+    page = &pages_.back();
+  }
+  out->page = (uint8_t)(pages_.size() - 1);
+  out->x = (uint16_t)page->shelf_x;
+  out->y = (uint16_t)page->shelf_y;
+  out->w = (uint16_t)w;
+  out->h = (uint16_t)h;
+  glBindTexture(GL_TEXTURE_2D, page->texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, page->shelf_x, page->shelf_y, w, h, GL_ALPHA, GL_UNSIGNED_BYTE, alpha);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  page->shelf_x += w + kGlyphPadding;
+  page->shelf_h = std::max(page->shelf_h, h + kGlyphPadding);
+  return true;
+}
+
+bool TextRenderer::rasterize(int raster_px, uint32_t glyph, AtlasGlyph *out) {
+#ifdef VICAD_HAS_HARFBUZZ
+  if (font_) {
+    if (!font_->set_px(raster_px)) return false;
+    if (FT_Load_Glyph(font_->ft_face, (FT_UInt)glyph, FT_LOAD_DEFAULT) != 0) return false;
+    if (FT_Render_Glyph(font_->ft_face->glyph, FT_RENDER_MODE_NORMAL) != 0) return false;
+    const FT_GlyphSlot slot = font_->ft_face->glyph;
+    out->left = (int16_t)slot->bitmap_left;
+    out->top = (int16_t)(-slot->bitmap_top);
+    const FT_Bitmap &bm = slot->bitmap;
+    if (bm.width == 0 || bm.rows == 0) return true;
+    if (bm.pitch < 0) return false;
+    return pack((int)bm.width, (int)bm.rows, bm.buffer, bm.pitch, out);
+  }
+#endif
+  (void)raster_px;
+  if (glyph < VICAD_BAKED_FIRST_CHAR || glyph > VICAD_BAKED_LAST_CHAR) return false;
+  const VicadBakedGlyph &bg = vicad_baked_glyphs[glyph - VICAD_BAKED_FIRST_CHAR];
+  out->left = bg.bearing_x;
+  out->top = (int16_t)(-bg.bearing_y);
+  if (bg.w == 0 || bg.h == 0) return true;
+  const uint8_t *src = vicad_baked_atlas + (size_t)bg.y * VICAD_BAKED_ATLAS_WIDTH + bg.x;
+  return pack(bg.w, bg.h, src, VICAD_BAKED_ATLAS_WIDTH, out);
+}
+
+const TextRenderer::AtlasGlyph *TextRenderer::glyph_for(int raster_px, uint32_t glyph) {
+  const uint64_t key = glyph_key(raster_px, glyph);
+  auto it = glyphs_.find(key);
+  if (it != glyphs_.end()) return &it->second;
+  AtlasGlyph g;
+  if (!rasterize(raster_px, glyph, &g)) {
+    // With the atlas full the glyph is skipped until BeginFrame starts over,
+    // since batched quads may still point into the current pages. Anything
+    // else is unrenderable and cached empty so it is not retried every frame.
+    if (atlas_full_) return nullptr;
+    g = AtlasGlyph();
+  }
+  return &glyphs_.emplace(key, g).first->second;
+}
+
+bool TextRenderer::BeginFrame() {
+  if (!atlas_full_) return false;
+  reset_atlas();
+  return true;
+}
+
+void TextRenderer::reset_atlas() {
+  Flush();
+  for (Page &page : pages_) {
+    if (page.texture != 0) {
+      const GLuint tex = page.texture;
+      glDeleteTextures(1, &tex);
+    }
+  }
+  pages_.clear();
+  glyphs_.clear();
+  atlas_full_ = false;
+}
+
+void TextRenderer::add_run(const Run &run, const TextVec3 &origin, const TextVec3 &right, const TextVec3 &down,
+                           float scale, const uint8_t rgba[4]) {
+  const float inv_page = 1.0f / (float)kAtlasPageSize;
+  auto at = [&](float px, float py) -> TextVec3 {
+    return {origin.x + right.x * px + down.x * py, origin.y + right.y * px + down.y * py,
+            origin.z + right.z * px + down.z * py};
+  };
+  for (const RunGlyph &rg : run.glyphs) {
+    const AtlasGlyph *g = glyph_for(run.raster_px, rg.glyph);
+    if (!g || g->w == 0 || g->h == 0 || g->page >= pages_.size()) continue;
+    const float x0 = (float)(rg.x + g->left) * scale;
+    const float y0 = (float)(rg.y + g->top) * scale;
+    const float x1 = x0 + (float)g->w * scale;
+    const float y1 = y0 + (float)g->h * scale;
+    const float u0 = (float)g->x * inv_page;
+    const float v0 = (float)g->y * inv_page;
+    const float u1 = (float)(g->x + g->w) * inv_page;
+    const float v1 = (float)(g->y + g->h) * inv_page;
+    const TextVec3 corners[4] = {at(x0, y0), at(x1, y0), at(x1, y1), at(x0, y1)};
+    const float uvs[4][2] = {{u0, v0}, {u1, v0}, {u1, v1}, {u0, v1}};
+    std::vector<Vertex> &quads = pages_[g->page].quads;
+    for (int k = 0; k < 4; ++k) {
+      quads.push_back({{corners[k].x, corners[k].y, corners[k].z},
+                       {uvs[k][0], uvs[k][1]},
+                       {rgba[0], rgba[1], rgba[2], rgba[3]}});
+    }
+  }
+}
+
+void TextRenderer::append_run(const Run &run, float x, float y, float scale, std::vector<TextQuad> *out) {
+  const float inv_page = 1.0f / (float)kAtlasPageSize;
+  for (const RunGlyph &rg : run.glyphs) {
+    const AtlasGlyph *g = glyph_for(run.raster_px, rg.glyph);
+    if (!g || g->w == 0 || g->h == 0 || g->page >= pages_.size()) continue;
+    TextQuad q;
+    q.texture = pages_[g->page].texture;
+    q.x0 = x + (float)(rg.x + g->left) * scale;
+    q.y0 = y + (float)(rg.y + g->top) * scale;
+    q.x1 = q.x0 + (float)g->w * scale;
+    q.y1 = q.y0 + (float)g->h * scale;
+    q.u0 = (float)g->x * inv_page;
+    q.v0 = (float)g->y * inv_page;
+    q.u1 = (float)(g->x + g->w) * inv_page;
+    q.v1 = (float)(g->y + g->h) * inv_page;
+    out->push_back(q);
+  }
+}
+
+TextMetrics TextRenderer::Measure(std::string_view text, float font_px) {
+  if (text.empty() || font_px <= 0.0f) return {};
+  const int raster_px = raster_px_for(font_px);
+  const Run *run = run_for(text, raster_px);
+  if (!run) return {};
+  const float scale = scale_for(font_px, raster_px);
+  return {run->metrics.width * scale, run->metrics.height * scale};
+}
+
+void TextRenderer::AppendScreenQuads(float x, float y, float font_px, std::string_view text,
+                                     std::vector<TextQuad> *out) {
+  if (!out || text.empty() || font_px <= 0.0f) return;
+  const int raster_px = raster_px_for(font_px);
+  const Run *run = run_for(text, raster_px);
+  if (!run) return;
+  append_run(*run, x, y, scale_for(font_px, raster_px), out);
+}
+
+unsigned int TextRenderer::SolidTexture() {
+  if (pages_.empty() && !add_page()) return 0;
+  return pages_.front().texture;
+}
+
+void TextRenderer::SolidTexel(float *u, float *v) {
+  const float c = (float)kSolidBlockSize * 0.5f / (float)kAtlasPageSize;
+  if (u) *u = c;
+  if (v) *v = c;
+}
+
+void TextRenderer::AddWorldText(const TextVec3 &origin, const TextVec3 &right, const TextVec3 &up, float world_scale,
+                                std::string_view text, float r, float g, float b, float a) {
+  if (text.empty() || world_scale <= 0.0f || a <= 0.0f) return;
+  const int raster_px = raster_px_for((float)BaseFontPixelSize());
+  const Run *run = run_for(text, raster_px);
+  if (!run) return;
+  const uint8_t rgba[4] = {color_byte(r), color_byte(g), color_byte(b), color_byte(a)};
+  add_run(*run, origin, right, {-up.x, -up.y, -up.z}, world_scale, rgba);
+}
+
+void TextRenderer::Flush() {
+  bool any = false;
+  for (const Page &page : pages_) any = any || !page.quads.empty();
+  if (!any) return;
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glEnable(GL_TEXTURE_2D);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  for (Page &page : pages_) {
+    if (page.quads.empty()) continue;
+    glBindTexture(GL_TEXTURE_2D, page.texture);
+    glVertexPointer(3, GL_FLOAT, sizeof(Vertex), page.quads[0].pos);
+    glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), page.quads[0].uv);
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), page.quads[0].rgba);
+    glDrawArrays(GL_QUADS, 0, (GLsizei)page.quads.size());
+    page.quads.clear();
+  }
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glDisable(GL_TEXTURE_2D);
+  glDisable(GL_BLEND);
+}
+
+void TextRenderer::Shutdown() {
+  for (Page &page : pages_) page.quads.clear();
+  reset_atlas();
+  runs_.clear();
+  run_index_.clear();
+#ifdef VICAD_HAS_HARFBUZZ
+  if (font_) {
+    if (font_->buffer) hb_buffer_destroy(font_->buffer);
+    if (font_->hb_font) hb_font_destroy(font_->hb_font);
+    if (font_->ft_face) FT_Done_Face(font_->ft_face);
+    if (font_->ft_library) FT_Done_FreeType(font_->ft_library);
+  }
+#endif
+  delete font_;
+  font_ = nullptr;
+  font_failed_ = false;
+}
+
+}  // namespace vicad_text
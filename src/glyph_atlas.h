@@ -0,0 +1,140 @@
+#ifndef VICAD_GLYPH_ATLAS_H_
+#define VICAD_GLYPH_ATLAS_H_
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace vicad_text {
+
+struct TextVec3 {
+  float x;
+  float y;
+  float z;
+};
+
+// Layout box of a text run in pixels: width from the origin to the right ink
+// edge (the pen advance when there is no ink or no shaping), and one line
+// height per line.
+struct TextMetrics {
+  float width = 0.0f;
+  float height = 0.0f;
+};
+
+// One screen-aligned glyph quad for a caller-owned batch.
+struct TextQuad {
+  unsigned int texture;
+  float x0, y0, x1, y1;
+  float u0, v0, u1, v1;
+};
+
+// Pixel size world-space labels are rasterized at; their world scale is
+// world units per pixel of this size.
+int BaseFontPixelSize();
+
+// Text drawing through one glyph atlas. Runs are shaped once (HarfBuzz when
+// built with it, the baked font otherwise) and kept in an LRU keyed by a
+// hash of size and text. Glyphs are rasterized once per pixel size into a
+// few shared atlas textures, each of which also holds an opaque block so
+// solid UI quads can share a draw with text. AddWorldText only queues quads;
+// Flush draws everything queued with the current matrices, one draw call per
+// atlas page. Every call needs the GL context current.
+class TextRenderer {
+ public:
+  TextRenderer() = default;
+  ~TextRenderer();
+
+  TextRenderer(const TextRenderer &) = delete;
+  TextRenderer &operator=(const TextRenderer &) = delete;
+
+  // Starts over when the atlas filled up last frame, dropping every page.
+  // Returns true when it did, since glyphs were missing from that frame.
+  bool BeginFrame();
+
+  TextMetrics Measure(std::string_view text, float font_px);
+  // Appends the run's quads with the top-left of its first line at (x, y)
+  // in y-down pixels.
+  void AppendScreenQuads(float x, float y, float font_px, std::string_view text, std::vector<TextQuad> *out);
+  // A page texture and the texture coordinate of its opaque block, which
+  // sits at the same place on every page. Texture 0 if none can be made.
+  unsigned int SolidTexture();
+  static void SolidTexel(float *u, float *v);
+  // Top-left of the first line at `origin`, with pixel x along `right` and
+  // lines stepping along -`up`, `world_scale` world units per pixel.
+  void AddWorldText(const TextVec3 &origin, const TextVec3 &right, const TextVec3 &up, float world_scale,
+                    std::string_view text, float r, float g, float b, float a);
+  void Flush();
+  // Releases textures and font state.
+  void Shutdown();
+
+  size_t run_count() const { return runs_.size(); }
+  size_t glyph_count() const { return glyphs_.size(); }
+
+ private:
+  struct FontState;
+
+  struct AtlasGlyph {
+    uint8_t page = 0;
+    uint16_t x = 0;
+    uint16_t y = 0;
+    uint16_t w = 0;
+    uint16_t h = 0;
+    int16_t left = 0;  // bitmap offset from the pen position, y down
+    int16_t top = 0;
+  };
+  struct RunGlyph {
+    uint32_t glyph;
+    int32_t x;  // pen position in raster pixels, y down from the run top
+    int32_t y;
+  };
+  struct Run {
+    uint64_t hash = 0;
+    int raster_px = 0;
+    std::string text;
+    std::vector<RunGlyph> glyphs;
+    TextMetrics metrics;  // raster pixels
+    bool complete = true;  // false when some glyph could not be placed
+  };
+  struct Vertex {
+    float pos[3];
+    float uv[2];
+    uint8_t rgba[4];
+  };
+  struct Page {
+    unsigned int texture = 0;
+    int shelf_x = 0;
+    int shelf_y = 0;
+    int shelf_h = 0;
+    std::vector<Vertex> quads;
+  };
+
+  bool ensure_font();
+  int raster_px_for(float font_px);
+  float scale_for(float font_px, int raster_px) const;
+  const Run *run_for(std::string_view text, int raster_px);
+  bool shape(std::string_view text, int raster_px, Run *out);
+  const AtlasGlyph *glyph_for(int raster_px, uint32_t glyph);
+  bool rasterize(int raster_px, uint32_t glyph, AtlasGlyph *out);
+  bool add_page();
+  bool pack(int w, int h, const uint8_t *alpha, int pitch, AtlasGlyph *out);
+  void reset_atlas();
+  void add_run(const Run &run, const TextVec3 &origin, const TextVec3 &right, const TextVec3 &down, float scale,
+               const uint8_t rgba[4]);
+  void append_run(const Run &run, float x, float y, float scale, std::vector<TextQuad> *out);
+
+  FontState *font_ = nullptr;
+  bool font_failed_ = false;
+  std::list<Run> runs_;
+  std::unordered_map<uint64_t, std::list<Run>::iterator> run_index_;
+  Run uncached_run_;
+  std::unordered_map<uint64_t, AtlasGlyph> glyphs_;
+  std::vector<Page> pages_;
+  bool atlas_full_ = false;
+};
+
+}  // namespace vicad_text
+
+#endif  // VICAD_GLYPH_ATLAS_H_
@@ -21,6 +21,7 @@ struct InteractionState {
     int hovered_object_index = -1;
     bool show_sketch_dimensions = true;
     bool pick_debug_overlay = true;
+    bool perf_hud = false;
     SelectionMode selection_mode = SelectionMode::Object;
 };
 
@@ -0,0 +1,37 @@
+#include "ipc_doorbell.h"
+
+#include <cerrno>
+#include <chrono>
+#include <thread>
+
+#if defined(__APPLE__)
+#include <os/os_sync_wait_on_address.h>
+#endif
+
+namespace vicad {
+
+uint32_t DoorbellLoad(const uint32_t *word) {
+  return __atomic_load_n(word, __ATOMIC_ACQUIRE);
+}
+
+void DoorbellStore(uint32_t *word, uint32_t value) {
+  __atomic_store_n(word, value, __ATOMIC_RELEASE);
+}
+
+bool DoorbellWait(uint32_t *word, uint32_t expected, int timeout_ms) {
+  if (DoorbellLoad(word) != expected) return true;
+  if (timeout_ms <= 0) return false;
+#if defined(__APPLE__)
+  if (__builtin_available(macOS 14.4, *)) {
+    const uint64_t timeout_ns = (uint64_t)timeout_ms * 1000000ull;
+    const int rc = os_sync_wait_on_address_with_timeout(word, expected, sizeof(*word),
+                                                        OS_SYNC_WAIT_ON_ADDRESS_SHARED,
+                                                        OS_CLOCK_MACH_ABSOLUTE_TIME, timeout_ns);
+    return !(rc < 0 && errno == ETIMEDOUT);
+  }
+#endif
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  return DoorbellLoad(word) != expected;
+}
+
+}  // namespace vicad
@@ -0,0 +1,21 @@
+#ifndef VICAD_IPC_DOORBELL_H_
+#define VICAD_IPC_DOORBELL_H_
+
+#include <cstdint>
+
+namespace vicad {
+
+// Cross-process wait on a 32-bit word inside a MAP_SHARED mapping; the worker
+// rings it with os_sync_wake_by_address_any after publishing a new state.
+// macOS 14.4+ waits with os_sync_wait_on_address. Elsewhere (older macOS, and
+// Linux, where nothing rings the word) the wait polls in 1 ms sleeps.
+uint32_t DoorbellLoad(const uint32_t *word);
+void DoorbellStore(uint32_t *word, uint32_t value);
+
+// Blocks while *word == expected, for at most timeout_ms. Wakeups may be
+// spurious; callers re-read the word. Returns false only on timeout.
+bool DoorbellWait(uint32_t *word, uint32_t expected, int timeout_ms);
+
+}  // namespace vicad
+
+#endif  // VICAD_IPC_DOORBELL_H_
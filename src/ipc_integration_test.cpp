@@ -12,14 +12,27 @@
 // Must be run from the repo root (where sketch-fillet-example.vicad.ts lives)
 // with `bun` on PATH.
 
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "ipc_protocol.h"
 #include "lod_policy.h"
+#include "mesh_disk_cache.h"
+#include "replay_stream.h"
+#include "scene_decode.h"
+#include "scene_loader.h"
+#include "scene_session.h"
+#include "scene_tab_cache.h"
 #include "script_worker_client.h"
 
 namespace {
@@ -75,7 +88,7 @@ bool test_fillet_example() {
           "objects[1] name is 'Per-Corner Fillet Plate'");
   require(objects[1].kind == vicad::ScriptSceneObjectKind::Manifold,
           "objects[1] kind is Manifold");
-  require(!objects[1].mesh.vertProperties.empty(),
+  require(!vicad::SceneObjectMesh(objects[1]).vertProperties.empty(),
           "objects[1] mesh has vertices");
 
   // Bounds check: extrusion of 80×50 profile by height 8.
@@ -93,12 +106,442 @@ bool test_fillet_example() {
   return g_fail == 0;
 }
 
+// ── Test: warm worker re-run ─────────────────────────────────────────────────
+//
+// The worker stays alive between runs. A second run on the same client must
+// re-execute the script's top-level registration instead of returning an empty
+// scene from Bun's module cache.
+bool test_warm_rerun() {
+  std::cout << "\n[ipc_integration_test] warm worker re-run\n";
+
+  vicad::ScriptWorkerClient client;
+  std::vector<vicad::ScriptSceneObject> first;
+  std::vector<vicad::ScriptSceneObject> second;
+  std::string error;
+
+  if (!require(client.ExecuteScriptScene("sketch-fillet-example.vicad.ts", &first, &error),
+               "first run returned true")) {
+    std::cout << "  error: " << error << "\n";
+    return false;
+  }
+  if (!require(client.ExecuteScriptScene("sketch-fillet-example.vicad.ts", &second, &error),
+               "second run returned true")) {
+    std::cout << "  error: " << error << "\n";
+    return false;
+  }
+  require(client.started(), "worker is still running after two runs");
+  require(second.size() == first.size(), "second run has the same object count");
+  if (second.size() == first.size()) {
+    for (size_t i = 0; i < first.size(); ++i) {
+      require(second[i].objectId == first[i].objectId, "second run keeps object ids stable");
+    }
+  }
+  return g_fail == 0;
+}
+
+// ── Test: cancelled run ──────────────────────────────────────────────────────
+//
+// A run whose cancel flag is set fails without waiting for the worker, and
+// the next run goes through on a fresh (standby) worker.
+bool test_cancelled_run() {
+  std::cout << "\n[ipc_integration_test] cancelled run\n";
+
+  vicad::ScriptWorkerClient client;
+  std::atomic<bool> cancel{true};
+  client.set_cancel_flag(&cancel);
+  std::vector<vicad::ScriptSceneObject> objects;
+  std::string error;
+  require(!client.ExecuteScriptScene("sketch-fillet-example.vicad.ts", &objects, &error),
+          "cancelled run returned false");
+  require(error == "Run cancelled.", "cancelled run reports the cancel");
+
+  cancel.store(false);
+  if (!require(client.ExecuteScriptScene("sketch-fillet-example.vicad.ts", &objects, &error),
+               "run after a cancel returned true")) {
+    std::cout << "  error: " << error << "\n";
+    return false;
+  }
+  require(!objects.empty(), "run after a cancel decoded objects");
+  return g_fail == 0;
+}
+
+// ── Test: script imports ─────────────────────────────────────────────────────
+//
+// A run reports the local modules the script imported, so the app can watch
+// them; the script itself is not among them.
+bool test_script_imports() {
+  std::cout << "\n[ipc_integration_test] script imports\n";
+
+  std::filesystem::create_directories("build/test_imports");
+  const std::filesystem::path dir = std::filesystem::canonical("build/test_imports");
+  std::ofstream(dir / "plate.ts") << "export function plate() {\n"
+                                     "  return Manifold.extrude(CrossSection.rectangle(10, 10, true), 2);\n"
+                                     "}\n";
+  std::ofstream(dir / "main.vicad.ts") << "import { plate } from \"./plate.ts\";\n"
+                                          "vicad.addToScene(plate(), { name: \"Plate\" });\n";
+
+  vicad::ScriptWorkerClient client;
+  std::vector<vicad::ScriptSceneObject> objects;
+  std::string error;
+  if (!require(client.ExecuteScriptScene((dir / "main.vicad.ts").c_str(), &objects, &error),
+               "run returned true")) {
+    std::cout << "  error: " << error << "\n";
+    return false;
+  }
+  const std::vector<std::string> &imports = client.last_imports();
+  require(imports.size() == 1, "run reports one import");
+  require(!imports.empty() && imports[0] == (dir / "plate.ts").string(), "import is the helper's absolute path");
+  return g_fail == 0;
+}
+
+// ── Test: progressive refine ─────────────────────────────────────────────────
+//
+// A Draft run with the response retained can be replayed again at Model
+// quality, off the client, and yields the same objects.
+bool test_progressive_refine() {
+  std::cout << "\n[ipc_integration_test] progressive refine\n";
+
+  vicad::ScriptWorkerClient client;
+  client.set_retain_scene_response(true);
+  std::vector<vicad::ScriptSceneObject> draft;
+  std::string error;
+  vicad::ReplayLodPolicy lod = {};
+  lod.profile = vicad::LodProfile::Draft;
+  if (!require(client.ExecuteScriptScene("sketch-fillet-example.vicad.ts", &draft, &error, lod),
+               "draft run returned true")) {
+    std::cout << "  error: " << error << "\n";
+    return false;
+  }
+  const std::shared_ptr<const std::vector<uint8_t>> response = client.last_scene_response();
+  if (!require(response != nullptr, "draft response is retained")) return false;
+
+  std::vector<vicad::ScriptSceneObject> model;
+  lod.profile = vicad::LodProfile::Model;
+  if (!require(vicad::ReplaySceneResponse(*response, lod, nullptr, &model, &error),
+               "retained response replays at Model")) {
+    std::cout << "  error: " << error << "\n";
+    return false;
+  }
+  require(model.size() == draft.size(), "refined scene has the same object count");
+  if (model.size() == draft.size() && model.size() == 2) {
+    require(model[1].objectId == draft[1].objectId, "refined scene keeps object ids");
+    require(model[1].rootDigest != 0 && model[1].rootDigest == draft[1].rootDigest,
+            "refined scene keeps root digests");
+    require(model[1].lodKey != draft[1].lodKey, "refined scene records its LOD key");
+    require(vicad::SceneObjectMesh(model[1]).NumTri() >= vicad::SceneObjectMesh(draft[1]).NumTri(),
+            "refined mesh is at least as fine as the draft");
+  }
+  return g_fail == 0;
+}
+
+// ── Test: retained delta re-run ──────────────────────────────────────────────
+//
+// A re-run with responses retained (as progressive LOD does) is still sent as
+// a delta, and the retained response expands its keep records so it replays
+// on its own.
+bool test_retained_delta_rerun() {
+  std::cout << "\n[ipc_integration_test] retained delta re-run\n";
+
+  std::filesystem::create_directories("build/test_retained_delta");
+  const std::filesystem::path script = std::filesystem::canonical("build/test_retained_delta") / "main.vicad.ts";
+  auto write_script = [&](int peg_size) {
+    std::ofstream(script) << "const base = Manifold.cube([20, 20, 5], true)"
+                             ".subtract(Manifold.sphere(4).translate(0, 0, 3));\n"
+                             "vicad.addToScene(base, { name: \"Base\" });\n"
+                             "vicad.addToScene(Manifold.cube("
+                          << peg_size << ", true).translate(30, 0, 0), { name: \"Peg\" });\n";
+  };
+
+  vicad::ScriptWorkerClient client;
+  client.set_retain_scene_response(true);
+  vicad::ReplayLodPolicy lod = {};
+  lod.profile = vicad::LodProfile::Model;
+  std::vector<vicad::ScriptSceneObject> objects;
+  std::string error;
+  write_script(4);
+  if (!require(client.ExecuteScriptScene(script.c_str(), &objects, &error, lod), "first run returned true")) {
+    std::cout << "  error: " << error << "\n";
+    return false;
+  }
+  require(client.last_run_stats().keptOps == 0, "first run is sent in full");
+  write_script(6);
+  if (!require(client.ExecuteScriptScene(script.c_str(), &objects, &error, lod), "second run returned true")) {
+    std::cout << "  error: " << error << "\n";
+    return false;
+  }
+  const vicad::ScriptRunStats &stats = client.last_run_stats();
+  require(stats.keptOps > 0 && stats.keptOps < stats.opCount, "second run took the delta path");
+
+  const std::shared_ptr<const std::vector<uint8_t>> response = client.last_scene_response();
+  if (!require(response != nullptr, "delta response is retained")) return false;
+  std::vector<vicad::ScriptSceneObject> replayed;
+  if (!require(vicad::ReplaySceneResponse(*response, lod, nullptr, &replayed, &error),
+               "retained delta response replays without its base")) {
+    std::cout << "  error: " << error << "\n";
+    return false;
+  }
+  require(replayed.size() == objects.size(), "replayed scene has the same object count");
+  for (size_t i = 0; i < replayed.size() && i < objects.size(); ++i) {
+    require(replayed[i].rootDigest == objects[i].rootDigest, "replayed objects keep root digests");
+    require(std::fabs(replayed[i].manifold.Volume() - objects[i].manifold.Volume()) < 1e-6,
+            "replayed objects match the delta run");
+  }
+  return g_fail == 0;
+}
+
+bool test_mesh_disk_cache() {
+  std::cout << "\n[ipc_integration_test] mesh disk cache\n";
+
+  vicad::ScriptWorkerClient client;
+  std::vector<vicad::ScriptSceneObject> objects;
+  std::string error;
+  if (!require(client.ExecuteScriptScene("sketch-fillet-example.vicad.ts", &objects, &error),
+               "run returned true")) {
+    std::cout << "  error: " << error << "\n";
+    return false;
+  }
+  setenv("VICAD_CACHE_DIR", "build/test_mesh_cache", 1);
+  vicad::MeshDiskCacheKey key;
+  require(vicad::MeshDiskCacheKeyForScript("sketch-fillet-example.vicad.ts", &key), "script hashes");
+  if (!require(vicad::MeshDiskCacheStore(key, 1, objects, &error), "scene stores")) {
+    std::cout << "  error: " << error << "\n";
+    return false;
+  }
+  std::vector<vicad::ScriptSceneObject> cached;
+  if (!require(vicad::MeshDiskCacheLoad(key, &cached, &error), "scene loads")) {
+    std::cout << "  error: " << error << "\n";
+    return false;
+  }
+  require(cached.size() == objects.size(), "cached scene has the same object count");
+  for (size_t i = 0; i < cached.size() && i < objects.size(); ++i) {
+    require(cached[i].objectId == objects[i].objectId && cached[i].rootDigest == objects[i].rootDigest,
+            "cached object keeps id and digest");
+    require(vicad::SceneObjectMesh(cached[i]).NumTri() == vicad::SceneObjectMesh(objects[i]).NumTri(),
+            "cached object keeps its mesh");
+    require(cached[i].sketchContours.size() == objects[i].sketchContours.size(),
+            "cached object keeps its contours");
+  }
+  vicad::MeshDiskCacheKey stale = key;
+  stale.content_hash ^= 1;
+  require(!vicad::MeshDiskCacheLoad(stale, &cached, &error), "stale content hash misses");
+  unsetenv("VICAD_CACHE_DIR");
+  return g_fail == 0;
+}
+
+template <typename T>
+void append_pod(std::vector<uint8_t> *out, const T &v) {
+  const size_t at = out->size();
+  out->resize(at + sizeof(T));
+  std::memcpy(out->data() + at, &v, sizeof(T));
+}
+
+void append_transform(std::vector<uint8_t> *records, vicad::OpCode opcode, uint32_t out_id, uint32_t in_id,
+                      double x, double y, double z, uint64_t digest) {
+  vicad::OpRecordHeader hdr = {};
+  hdr.opcode = (uint16_t)opcode;
+  hdr.payload_len = 2 * sizeof(uint32_t) + 3 * sizeof(double);
+  hdr.digest = digest;
+  append_pod(records, hdr);
+  append_pod(records, out_id);
+  append_pod(records, in_id);
+  append_pod(records, x);
+  append_pod(records, y);
+  append_pod(records, z);
+}
+
+// ── Test: instanced geometry ─────────────────────────────────────────────────
+//
+// Three objects place one cube under different transform chains; they share
+// one SceneInstanceGeometry whose transforms reproduce each object's bounds.
+bool test_scene_instances() {
+  std::cout << "\n[ipc_integration_test] scene instancing\n";
+
+  std::vector<uint8_t> records;
+  vicad::OpRecordHeader cube = {};
+  cube.opcode = (uint16_t)vicad::OpCode::Cube;
+  cube.payload_len = sizeof(uint32_t) + 3 * sizeof(double) + sizeof(uint32_t);
+  cube.digest = 11;
+  append_pod(&records, cube);
+  append_pod(&records, (uint32_t)1);
+  append_pod(&records, 2.0);
+  append_pod(&records, 4.0);
+  append_pod(&records, 6.0);
+  append_pod(&records, (uint32_t)0);
+  append_transform(&records, vicad::OpCode::Translate, 2, 1, 10.0, 0.0, 0.0, 21);
+  append_transform(&records, vicad::OpCode::Rotate, 3, 1, 0.0, 0.0, 90.0, 22);
+  append_transform(&records, vicad::OpCode::Translate, 4, 3, 0.0, -20.0, 5.0, 23);
+  append_transform(&records, vicad::OpCode::Scale, 5, 1, -1.0, 2.0, 1.0, 24);
+
+  auto tables = std::make_shared<vicad::ReplayTables>();
+  std::string error;
+  if (!require(vicad::ReplayOpsToTables(records.data(), records.size(), 5, vicad::ReplayLodPolicy{},
+                                        tables.get(), &error),
+               "records replay")) {
+    std::cout << "  error: " << error << "\n";
+    return false;
+  }
+  std::vector<vicad::ScriptSceneObject> objects;
+  for (uint32_t root : {2u, 4u, 5u}) {
+    vicad::ScriptSceneObject obj;
+    obj.objectId = root;
+    obj.kind = vicad::ScriptSceneObjectKind::Manifold;
+    obj.rootKind = (uint32_t)vicad::NodeKind::Manifold;
+    obj.rootId = root;
+    obj.manifold = tables->manifold_nodes[root];
+    obj.tables = tables;
+    objects.push_back(std::move(obj));
+  }
+  vicad::ResolveSceneInstances(&objects);
+  require(objects[0].instance && objects[1].instance == objects[0].instance &&
+              objects[2].instance == objects[0].instance,
+          "objects share one instance geometry");
+  if (!objects[0].instance) return false;
+  require(objects[0].instance->digest == 11, "instance geometry is the cube");
+  require(!objects[0].meshCache, "world mesh is not built");
+  for (const vicad::ScriptSceneObject &obj : objects) {
+    const manifold::Box want = obj.manifold.BoundingBox();
+    const manifold::Box got = obj.instance->manifold.Transform(obj.instanceTransform).BoundingBox();
+    require(std::fabs(want.min.x - got.min.x) < 1e-9 && std::fabs(want.min.y - got.min.y) < 1e-9 &&
+                std::fabs(want.min.z - got.min.z) < 1e-9 && std::fabs(want.max.x - got.max.x) < 1e-9 &&
+                std::fabs(want.max.y - got.max.y) < 1e-9 && std::fabs(want.max.z - got.max.z) < 1e-9,
+            "instance transform reproduces the object");
+  }
+  vicad::SceneVec3 origin = {11.0f, 2.0f, -50.0f};
+  vicad::SceneVec3 dir = {0.0f, 0.0f, 1.0f};
+  (void)vicad::SceneObjectPickMesh(objects[0], &origin, &dir);
+  require(std::fabs(origin.x - 1.0f) < 1e-6f && std::fabs(origin.y - 2.0f) < 1e-6f && dir.z == 1.0f,
+          "pick ray maps into the instance frame");
+  return g_fail == 0;
+}
+
+// ── Test: tab cache ──────────────────────────────────────────────────────────
+//
+// Inactive tabs' scenes are evicted least recently used first once over the
+// budget, the tab being switched to is never evicted, and a finished run only
+// replaces a snapshot when it is the load that snapshot is waiting for.
+std::vector<vicad::ScriptSceneObject> cube_scene(double size) {
+  vicad::ScriptSceneObject obj;
+  obj.objectId = 1;
+  obj.kind = vicad::ScriptSceneObjectKind::Manifold;
+  obj.manifold = manifold::Manifold::Cube(manifold::vec3(size, size, size));
+  std::vector<vicad::ScriptSceneObject> scene;
+  scene.push_back(std::move(obj));
+  return scene;
+}
+
+// Makes `path` the active tab with a loaded cube scene of edge `size`.
+bool switch_to_loaded(vicad_scene::SceneSessionState *state, const std::string &path, double size) {
+  const bool restored = vicad_scene::SceneSessionSwitchScript(state, path);
+  if (!restored) {
+    state->scene_objects = cube_scene(size);
+    state->last_mtime_ns = 1;
+  }
+  return restored;
+}
+
+bool tab_cached(const vicad_scene::SceneSessionState &state, const std::string &path) {
+  for (const vicad_scene::SceneTabSnapshot &snap : state.tab_cache) {
+    if (snap.script_path == path) return true;
+  }
+  return false;
+}
+
+bool test_tab_cache() {
+  std::cout << "\n[ipc_integration_test] tab cache\n";
+
+  vicad_scene::SceneSessionState state;
+  const size_t scene_bytes = vicad_scene::SceneSessionSceneBytes(cube_scene(1.0));
+  state.tab_cache_budget_bytes = 2 * scene_bytes + scene_bytes / 2;
+
+  // a is cached first but used again after b, so b is the one evicted.
+  switch_to_loaded(&state, "a.vicad.ts", 1.0);
+  switch_to_loaded(&state, "b.vicad.ts", 2.0);
+  require(switch_to_loaded(&state, "a.vicad.ts", 1.0), "switching back restores a cached tab");
+  switch_to_loaded(&state, "c.vicad.ts", 3.0);
+  require(tab_cached(state, "a.vicad.ts") && tab_cached(state, "b.vicad.ts"), "two tabs fit the budget");
+  switch_to_loaded(&state, "d.vicad.ts", 4.0);
+  require(state.tab_cache.size() == 2, "cache is evicted down to the budget");
+  require(!tab_cached(state, "b.vicad.ts"), "least recently used tab is evicted");
+  require(tab_cached(state, "a.vicad.ts") && tab_cached(state, "c.vicad.ts"), "recently used tabs stay cached");
+
+  // With no room at all, the incoming tab is taken out of the cache before
+  // evicting, so it is still restored.
+  state.tab_cache_budget_bytes = 1;
+  require(vicad_scene::SceneSessionSwitchScript(&state, "c.vicad.ts"), "active tab is restored over budget");
+  require(state.tab_cache.empty(), "every inactive tab is evicted over budget");
+  require(state.scene_objects.size() == 1 &&
+              std::fabs(state.scene_objects[0].manifold.Volume() - 27.0) < 1e-9,
+          "active tab keeps its scene");
+
+  // A run finishing for a cached tab replaces its scene only when it is the
+  // load the snapshot waits for.
+  state.tab_cache_budget_bytes = (size_t)1 << 30;
+  switch_to_loaded(&state, "e.vicad.ts", 5.0);
+  if (!require(tab_cached(state, "c.vicad.ts"), "c is cached again")) return false;
+  state.tab_cache[0].load_generation = 7;
+  vicad_scene::SceneLoadResult stale;
+  stale.generation = 6;
+  stale.script_path = "c.vicad.ts";
+  stale.ok = true;
+  stale.scene_objects = cube_scene(10.0);
+  vicad_scene::SceneTabCacheInstall(&state, &stale);
+  require(state.tab_cache[0].load_generation == 7 &&
+              std::fabs(state.tab_cache[0].scene_objects[0].manifold.Volume() - 27.0) < 1e-9,
+          "stale generation misses");
+  vicad_scene::SceneLoadResult current = stale;
+  current.generation = 7;
+  current.scene_objects = cube_scene(10.0);
+  vicad_scene::SceneTabCacheInstall(&state, &current);
+  require(state.tab_cache[0].load_generation == 0 &&
+              std::fabs(state.tab_cache[0].scene_objects[0].manifold.Volume() - 1000.0) < 1e-6,
+          "current generation replaces the snapshot");
+  return g_fail == 0;
+}
+
+// ── Test: loader resubmission ────────────────────────────────────────────────
+//
+// Submitting a script again while its first run is queued or running
+// replaces that run: only the second submission's result is delivered.
+bool test_loader_resubmit() {
+  std::cout << "\n[ipc_integration_test] loader resubmission\n";
+
+  std::atomic<int> ready{0};
+  vicad_scene::SceneLoader loader([&ready] { ready.fetch_add(1); }, 1);
+  const std::string script = "sketch-fillet-example.vicad.ts";
+  loader.Submit(1, script, vicad::ReplayLodPolicy{}, false, false);
+  loader.Submit(2, script, vicad::ReplayLodPolicy{}, false, false);
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+  while (ready.load() == 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  vicad_scene::SceneLoadResult result;
+  if (!require(loader.TakeResult(&result), "loader delivers a result")) return false;
+  if (!result.ok) std::cout << "  error: " << result.error << "\n";
+  require(result.ok && !result.scene_objects.empty(), "delivered run succeeded");
+  require(result.generation == 2, "delivered result is the second submission");
+  require(!loader.Busy(script), "loader is idle after delivering");
+  vicad_scene::SceneLoadResult extra;
+  require(!loader.TakeResult(&extra), "first submission is never delivered");
+  require(ready.load() == 1, "on_ready fires once");
+  return g_fail == 0;
+}
+
 }  // namespace
 
 int main() {
   std::cout << "[ipc_integration_test] starting\n";
 
-  const bool all_passed = test_fillet_example();
+  bool all_passed = test_fillet_example();
+  all_passed = test_warm_rerun() && all_passed;
+  all_passed = test_cancelled_run() && all_passed;
+  all_passed = test_script_imports() && all_passed;
+  all_passed = test_progressive_refine() && all_passed;
+  all_passed = test_retained_delta_rerun() && all_passed;
+  all_passed = test_mesh_disk_cache() && all_passed;
+  all_passed = test_scene_instances() && all_passed;
+  all_passed = test_tab_cache() && all_passed;
+  all_passed = test_loader_resubmit() && all_passed;
 
   std::cout << "\n[ipc_integration_test] "
             << g_pass << " passed, " << g_fail << " failed\n";
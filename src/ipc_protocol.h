@@ -7,10 +7,13 @@
 namespace vicad {
 
 static constexpr const char kIpcMagic[8] = {'V', 'C', 'A', 'D', 'I', 'P', 'C', '1'};
-static constexpr uint32_t kIpcVersion = 3;
-static constexpr size_t kDefaultShmSize = 100u * 1024u * 1024u;
+static constexpr uint32_t kIpcVersion = 10;
+// The main segment only has to fit the header, the request and typical
+// responses. Larger responses go to an overflow segment the worker creates on
+// demand (see SharedHeader::response_segment).
+static constexpr size_t kInitialShmSize = 1024u * 1024u;
 static constexpr uint32_t kDefaultRequestOffset = 4096u;
-static constexpr uint32_t kDefaultResponseOffset = 1024u * 1024u;
+static constexpr uint32_t kDefaultResponseOffset = 64u * 1024u;
 
 enum class IpcState : uint32_t {
   Idle = 0,
@@ -87,12 +90,21 @@ struct SharedHeader {
   uint32_t response_length;
   uint32_t state;
   uint32_t error_code;
-  uint32_t reserved;
+  // 0 when the response lives in this segment; otherwise the generation of the
+  // worker-created overflow segment "<shm name>-r<generation>" holding it.
+  uint32_t response_segment;
+  // Bytes of op records the worker has committed so far behind the scene
+  // payload header. Advances while the script runs so replay can start early.
+  uint32_t records_committed;
 };
 
 struct RequestPayload {
   uint32_t version;
   uint32_t script_path_len;
+  // request_seq of the run whose replay tables the client still holds for the
+  // current LOD profile, or 0. When it matches the worker's last successful
+  // run, unchanged nodes are sent as keep records (kOpRecordFlagKeep).
+  uint64_t delta_base_seq;
 };
 
 struct ResponsePayloadOk {
@@ -117,8 +129,16 @@ struct ResponsePayloadScene {
   uint32_t object_count;
   uint32_t op_count;
   uint32_t records_size;
+  // Object names back to back (SceneObjectRecord::name_len each), then the
+  // absolute paths of the user modules the script imported, '\n'-separated.
   uint32_t diagnostics_len;
   uint32_t object_table_size;
+  // Worker-side phase timings in microseconds: loading the script up to its
+  // first op, the rest of its execution, and collecting the scene and
+  // assembling this response.
+  uint32_t load_us;
+  uint32_t execute_us;
+  uint32_t encode_us;
 };
 
 struct ResponsePayloadError {
@@ -138,10 +158,33 @@ struct OpRecordHeader {
   uint16_t opcode;
   uint16_t flags;
   uint32_t payload_len;
+  // Content digest of the output node (opcode, parameters and input digests,
+  // independent of node ids). 0 means "do not cache".
+  uint64_t digest;
 };
 #pragma pack(pop)
 
-static_assert(sizeof(SharedHeader) == 60, "Unexpected SharedHeader size");
+// The record reuses node `base_id` of the delta base run instead of carrying
+// the op's payload: { out_id: u32, base_id: u32 }. The opcode is kept.
+static constexpr uint16_t kOpRecordFlagKeep = 1u << 0;
+
+static_assert(sizeof(SharedHeader) == 64, "Unexpected SharedHeader size");
+static_assert(sizeof(RequestPayload) == 16, "Unexpected RequestPayload size");
+static_assert(sizeof(ResponsePayloadScene) == 36, "Unexpected ResponsePayloadScene size");
+static_assert(sizeof(OpRecordHeader) == 16, "Unexpected OpRecordHeader size");
+static_assert(offsetof(SharedHeader, state) % 4 == 0, "SharedHeader::state must be word aligned");
+static_assert(offsetof(SharedHeader, records_committed) % 4 == 0,
+              "SharedHeader::records_committed must be word aligned");
+
+// SharedHeader::state doubles as the completion doorbell both processes wait
+// on. The struct is packed, so take the address through offsetof.
+inline uint32_t *SharedHeaderStateWord(SharedHeader *hdr) {
+  return (uint32_t *)((uint8_t *)hdr + offsetof(SharedHeader, state));
+}
+
+inline uint32_t *SharedHeaderRecordsCommittedWord(SharedHeader *hdr) {
+  return (uint32_t *)((uint8_t *)hdr + offsetof(SharedHeader, records_committed));
+}
 
 }  // namespace vicad
 
@@ -0,0 +1,38 @@
+#ifndef VICAD_JSON_ESCAPE_H_
+#define VICAD_JSON_ESCAPE_H_
+
+#include <cstdio>
+#include <string>
+
+namespace vicad {
+
+// Appends `s` as the body of a JSON string literal: quotes, backslashes and
+// control characters are escaped, everything else is copied byte for byte.
+inline void append_json_escaped(std::string *out, const char *s) {
+  static const char kHex[] = "0123456789abcdef";
+  for (const char *p = s; *p != '\0'; ++p) {
+    const unsigned char c = (unsigned char)*p;
+    if      (c == '"')  out->append("\\\"");
+    else if (c == '\\') out->append("\\\\");
+    else if (c == '\n') out->append("\\n");
+    else if (c == '\r') out->append("\\r");
+    else if (c == '\t') out->append("\\t");
+    else if (c < 0x20) {
+      const char esc[6] = {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xF]};
+      out->append(esc, sizeof(esc));
+    } else {
+      out->push_back((char)c);
+    }
+  }
+}
+
+// Writes `s` to `f` escaped as by append_json_escaped.
+inline void write_json_escaped(std::FILE *f, const char *s) {
+  std::string escaped;
+  append_json_escaped(&escaped, s);
+  std::fwrite(escaped.data(), 1, escaped.size(), f);
+}
+
+}  // namespace vicad
+
+#endif  // VICAD_JSON_ESCAPE_H_
@@ -9,6 +9,7 @@ namespace vicad {
 const double kLodToleranceDraft = 0.1;
 const double kLodToleranceModel = 0.001;
 const double kLodToleranceExport3MF = 0.0001;
+const double kLodViewPixelTolerance = 0.5;
 
 namespace {
 
@@ -51,12 +52,50 @@ double LodToleranceForProfile(LodProfile profile) {
       return kLodToleranceDraft;
     case LodProfile::Export3MF:
       return kLodToleranceExport3MF;
+    case LodProfile::View:
     case LodProfile::Model:
     default:
       return kLodToleranceModel;
   }
 }
 
+double LodToleranceForPolicy(const ReplayLodPolicy& policy) {
+  if (policy.profile != LodProfile::View) {
+    return LodToleranceForProfile(policy.profile);
+  }
+  const int level = std::min<int>(policy.viewLevel, kLodViewMaxLevel);
+  return std::ldexp(kLodToleranceModel, level);
+}
+
+uint32_t LodKeyForPolicy(const ReplayLodPolicy& policy) {
+  uint32_t key = (uint32_t)policy.profile;
+  if (policy.profile == LodProfile::View) {
+    key |= (uint32_t)std::min<uint8_t>(policy.viewLevel, kLodViewMaxLevel) << 8;
+  }
+  return key;
+}
+
+uint8_t LodViewLevelForDepth(double depth, double fovYDegrees,
+                             int viewportHeightPx) {
+  if (!std::isfinite(depth) || depth <= 0.0 || viewportHeightPx <= 0 ||
+      !std::isfinite(fovYDegrees) || fovYDegrees <= 0.0) {
+    return 0;
+  }
+  const double half_fov = fovYDegrees * kPi / 360.0;
+  const double world_per_px =
+      2.0 * depth * std::tan(half_fov) / (double)viewportHeightPx;
+  const double tolerance = kLodViewPixelTolerance * world_per_px;
+  if (!std::isfinite(tolerance) || tolerance <= kLodToleranceModel) return 0;
+  // Round down so the chosen tolerance never exceeds the wanted one.
+  const double level = std::floor(std::log2(tolerance / kLodToleranceModel));
+  return (uint8_t)std::clamp(level, 0.0, (double)kLodViewMaxLevel);
+}
+
+bool LodViewLevelNeedsReplay(uint8_t displayedLevel, uint8_t wantedLevel) {
+  const int diff = (int)displayedLevel - (int)wantedLevel;
+  return std::abs(diff) >= (int)kLodViewHysteresisLevels;
+}
+
 int AutoCircularSegments(double radius, LodProfile profile) {
   return circular_segments_for_radius_and_tolerance(
       radius, LodToleranceForProfile(profile));
@@ -64,7 +103,19 @@ int AutoCircularSegments(double radius, LodProfile profile) {
 
 int AutoCircularSegmentsForRevolve(double radius, double revolveDegrees,
                                    LodProfile profile) {
-  const int full = AutoCircularSegments(radius, profile);
+  ReplayLodPolicy policy = {};
+  policy.profile = profile;
+  return AutoCircularSegmentsForRevolve(radius, revolveDegrees, policy);
+}
+
+int AutoCircularSegments(double radius, const ReplayLodPolicy& policy) {
+  return circular_segments_for_radius_and_tolerance(
+      radius, LodToleranceForPolicy(policy));
+}
+
+int AutoCircularSegmentsForRevolve(double radius, double revolveDegrees,
+                                   const ReplayLodPolicy& policy) {
+  const int full = AutoCircularSegments(radius, policy);
   if (!std::isfinite(revolveDegrees) || revolveDegrees <= 0.0) return 3;
   const double clamped = std::min(revolveDegrees, 360.0);
   const int scaled = (int)std::ceil((double)full * clamped / 360.0);
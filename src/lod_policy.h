@@ -12,6 +12,8 @@ enum class LodProfile : uint8_t {
   Draft = 0,
   Model = 1,
   Export3MF = 2,
+  // Screen-space: tolerance follows the camera through ReplayLodPolicy::viewLevel.
+  View = 3,
 };
 
 // Global defaults in one clear place, in scene units.
@@ -19,6 +21,14 @@ extern const double kLodToleranceDraft;
 extern const double kLodToleranceModel;
 extern const double kLodToleranceExport3MF;
 
+// View profile: tolerance is kLodToleranceModel * 2^viewLevel. Quantizing to
+// power-of-two levels keeps cache keys and re-replay decisions stable under
+// small camera moves; a replay is only worth it once the wanted level is
+// kLodViewHysteresisLevels away from the displayed one.
+extern const double kLodViewPixelTolerance;
+constexpr uint8_t kLodViewMaxLevel = 10;
+constexpr uint8_t kLodViewHysteresisLevels = 2;
+
 struct ReplayPostprocessPolicy {
   // Future-facing hook: when enabled, run RefineToTolerance() after replay.
   bool refineToToleranceEnabled = false;
@@ -27,15 +37,30 @@ struct ReplayPostprocessPolicy {
 
 struct ReplayLodPolicy {
   LodProfile profile = LodProfile::Model;
+  // Only read for LodProfile::View.
+  uint8_t viewLevel = 0;
   ReplayPostprocessPolicy postprocess = {};
 };
 
 double LodToleranceForProfile(LodProfile profile);
+double LodToleranceForPolicy(const ReplayLodPolicy& policy);
+// Identifies the tessellation a policy produces, e.g. for caching replayed
+// nodes: the profile, plus the level for View.
+uint32_t LodKeyForPolicy(const ReplayLodPolicy& policy);
+
+// Coarsest View level whose chord error stays under kLodViewPixelTolerance
+// pixels for geometry `depth` scene units in front of a perspective camera.
+uint8_t LodViewLevelForDepth(double depth, double fovYDegrees,
+                             int viewportHeightPx);
+bool LodViewLevelNeedsReplay(uint8_t displayedLevel, uint8_t wantedLevel);
 
 // Auto-derived circular tessellation from profile tolerance.
 int AutoCircularSegments(double radius, LodProfile profile);
 int AutoCircularSegmentsForRevolve(double radius, double revolveDegrees,
                                    LodProfile profile);
+int AutoCircularSegments(double radius, const ReplayLodPolicy& policy);
+int AutoCircularSegmentsForRevolve(double radius, double revolveDegrees,
+                                   const ReplayLodPolicy& policy);
 
 manifold::Manifold ApplyReplayPostprocess(
     const manifold::Manifold& input,
@@ -0,0 +1,70 @@
+#include "lod_replay_test.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "face_detection.h"
+#include "mesh_topology.h"
+#include "work_stealing_pool.h"
+
+namespace lod_replay_test {
+
+namespace {
+
+// Box of half-extent `half` with every edge rounded to `r`: three slabs, a
+// cylinder along each edge and a sphere in each corner.
+manifold::Manifold filleted_box(double half, double r, int segments) {
+  const double in = half - r;
+  std::vector<manifold::Manifold> parts;
+  parts.push_back(manifold::Manifold::Cube(manifold::vec3(2 * half, 2 * in, 2 * in), true));
+  parts.push_back(manifold::Manifold::Cube(manifold::vec3(2 * in, 2 * half, 2 * in), true));
+  parts.push_back(manifold::Manifold::Cube(manifold::vec3(2 * in, 2 * in, 2 * half), true));
+  const manifold::Manifold edge = manifold::Manifold::Cylinder(2 * in, r, r, segments, true);
+  for (double a : {-in, in}) {
+    for (double b : {-in, in}) {
+      parts.push_back(edge.Translate(manifold::vec3(a, b, 0.0)));
+      parts.push_back(edge.Rotate(90.0, 0.0, 0.0).Translate(manifold::vec3(a, 0.0, b)));
+      parts.push_back(edge.Rotate(0.0, 90.0, 0.0).Translate(manifold::vec3(0.0, a, b)));
+      for (double c : {-in, in}) {
+        parts.push_back(manifold::Manifold::Sphere(r, segments).Translate(manifold::vec3(a, b, c)));
+      }
+    }
+  }
+  return manifold::Manifold::BatchBoolean(parts, manifold::OpType::Add);
+}
+
+}  // namespace
+
+bool run_face_tests() {
+  bool ok = true;
+
+  {
+    // Face detection on a mesh above its parallel threshold (concurrent
+    // union-find over triangles, regions fitted in chunks) matches the serial
+    // path. Running it inside a pool task holds the pool, so every step falls
+    // back to the calling thread.
+    const manifold::MeshGL mesh = filleted_box(10.0, 2.0, 256).GetMeshGL();
+    ok = ok && require(mesh.NumTri() > ((size_t)1 << 14), "filleted box is above the parallel threshold");
+    const vicad::MeshTopology topo = vicad::BuildMeshTopology(mesh);
+    const float maxDihedral = 20.0f;
+    const vicad::FaceDetectionResult parallel = vicad::DetectMeshFaces(mesh, topo, maxDihedral);
+    vicad::FaceDetectionResult serial;
+    const std::vector<uint32_t> indegree(1, 0);
+    const std::vector<std::vector<uint32_t>> dependents(1);
+    vicad::WorkStealingPool::Shared().RunGraph(indegree, dependents, [&](uint32_t) {
+      serial = vicad::DetectMeshFaces(mesh, topo, maxDihedral);
+      return true;
+    });
+
+    ok = ok && require(parallel.regions.size() == serial.regions.size(), "parallel face detection region count");
+    ok = ok && require(parallel.regionType == serial.regionType, "parallel face detection region types");
+    ok = ok && require(parallel.triRegion == serial.triRegion && parallel.regions == serial.regions,
+                       "parallel face detection per-face labels");
+    ok = ok && require(parallel.regions.size() > 1 && parallel.triRegion.size() == mesh.NumTri(),
+                       "filleted box splits into several regions");
+  }
+
+  return ok;
+}
+
+}  // namespace lod_replay_test
@@ -0,0 +1,100 @@
+#include "lod_replay_test.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "file_watch.h"
+
+namespace lod_replay_test {
+
+namespace {
+
+void write_file(const std::string &path, const char *text) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out << text;
+}
+
+// Consumes events left over from earlier steps.
+void drain_events(vicad::FileChangeNotifier *notifier) {
+  while (notifier->Wait(50)) {
+  }
+}
+
+}  // namespace
+
+bool run_file_watch_tests() {
+  bool ok = true;
+
+  {
+    // Every way an editor saves a file wakes the notifier: writing it in
+    // place, renaming a temporary file over it, and deleting and re-creating
+    // it. Changes to other files in the directory do not, and a Wake ends a
+    // wait without a timeout.
+    const std::string dir = "build/test_file_watch";
+    const std::string path = dir + "/watched.vicad.ts";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    write_file(path, "a");
+
+    vicad::FileChangeNotifier notifier;
+    notifier.Watch({path});
+    if (notifier.watching()) {
+      vicad::FileStamp before = {};
+      vicad::FileStamp after = {};
+      ok = ok && require(vicad::ReadFileStamp(path.c_str(), &before), "watched file has a stamp");
+
+      drain_events(&notifier);
+      {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        out << "bc";
+      }
+      ok = ok && require(notifier.Wait(1000), "in-place write wakes the notifier");
+      ok = ok && require(vicad::ReadFileStamp(path.c_str(), &after) && after.size_bytes == 3,
+                         "in-place write changes the stamp");
+
+      drain_events(&notifier);
+      write_file(dir + "/watched.vicad.ts.tmp", "renamed");
+      ok = ok && require(std::rename((dir + "/watched.vicad.ts.tmp").c_str(), path.c_str()) == 0,
+                         "temporary file renames over the watched file");
+      ok = ok && require(notifier.Wait(1000), "rename over the file wakes the notifier");
+      ok = ok && require(vicad::ReadFileStamp(path.c_str(), &after) && after.size_bytes == 7,
+                         "rename over the file changes the stamp");
+
+      drain_events(&notifier);
+      ok = ok && require(std::remove(path.c_str()) == 0, "watched file is deleted");
+      ok = ok && require(notifier.Wait(1000), "deletion wakes the notifier");
+      ok = ok && require(!vicad::ReadFileStamp(path.c_str(), &after), "deleted file has no stamp");
+
+      drain_events(&notifier);
+      write_file(path, "back");
+      ok = ok && require(notifier.Wait(1000), "re-creation wakes the notifier");
+      ok = ok && require(vicad::ReadFileStamp(path.c_str(), &after) && after.size_bytes == 4,
+                         "re-created file has a stamp");
+
+#if defined(__linux__)
+      // kqueue reports directory events without names, so only inotify can
+      // tell other files apart.
+      drain_events(&notifier);
+      write_file(dir + "/other.txt", "x");
+      ok = ok && require(!notifier.Wait(100), "writes to other files do not wake the notifier");
+#endif
+    }
+
+    drain_events(&notifier);
+    std::thread waker([&notifier] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      notifier.Wake();
+    });
+    ok = ok && require(notifier.Wait(-1), "Wake ends a wait without a timeout");
+    waker.join();
+    std::filesystem::remove_all(dir);
+  }
+
+  return ok;
+}
+
+}  // namespace lod_replay_test
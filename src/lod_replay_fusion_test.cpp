@@ -0,0 +1,198 @@
+#include "lod_replay_test.h"
+
+#include <cmath>
+#include <unordered_map>
+
+#include "replay_fusion.h"
+#include "union_by_bounds.h"
+
+namespace lod_replay_test {
+
+namespace {
+
+// The fusion plan the scheduler makes for `records` replayed as one batch,
+// with one entry per record even when nothing fuses.
+std::vector<vicad::NodeFusion> fusion_plan(const std::vector<uint8_t> &records, const std::vector<uint32_t> &roots) {
+  std::vector<uint16_t> opcodes;
+  std::vector<std::vector<uint32_t>> inputs;
+  std::unordered_map<uint32_t, uint32_t> producer;
+  for (size_t off = 0; off + sizeof(vicad::OpRecordHeader) <= records.size();) {
+    vicad::OpRecordHeader hdr = {};
+    std::memcpy(&hdr, records.data() + off, sizeof(hdr));
+    const uint8_t *payload = records.data() + off + sizeof(hdr);
+    uint32_t out_id = 0;
+    std::memcpy(&out_id, payload, sizeof(out_id));
+    opcodes.push_back(hdr.opcode);
+    inputs.emplace_back();
+    vicad::ReplayRecordInputs(hdr, payload, &inputs.back());
+    producer[out_id] = (uint32_t)opcodes.size() - 1;
+    off += sizeof(hdr) + hdr.payload_len;
+  }
+  std::vector<vicad::NodeFusion> plan = vicad::PlanReplayFusion(opcodes, inputs, producer, roots);
+  plan.resize(opcodes.size());
+  return plan;
+}
+
+// Only the last record is materialized: every sweep and transform before it
+// is deferred into it, and the sketch records are left alone.
+bool only_last_materialized(const std::vector<vicad::NodeFusion> &plan, size_t first_deferred) {
+  for (size_t i = 0; i < plan.size(); ++i) {
+    if (plan[i].deferred != (i >= first_deferred && i + 1 < plan.size())) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool run_fusion_tests() {
+  bool ok = true;
+
+  {
+    // A transform chain on a plane-mapped extrude folds into one matrix.
+    std::vector<uint8_t> rec;
+    append_record(&rec, vicad::OpCode::CrossSquare, payload_cross_square(1, 10.0, 10.0, 1));
+    append_record(&rec, vicad::OpCode::CrossPlane, payload_cross_plane(2, 1, 1, 0.0));
+    append_record(&rec, vicad::OpCode::Extrude, payload_extrude(3, 2, 10.0, 0, 0.0));
+    append_record(&rec, vicad::OpCode::Translate, payload_transform(4, 3, 0.0, 0.0, 5.0));
+    append_record(&rec, vicad::OpCode::Scale, payload_transform(5, 4, 2.0, 1.0, 1.0));
+
+    manifold::MeshGL mesh;
+    std::string err;
+    ok = ok && require(replay_to_mesh(rec, 5, 5, vicad::LodProfile::Model, &mesh, &err),
+                       "folded transform replay");
+    manifold::vec3 bmin, bmax;
+    ok = ok && require(mesh_bounds(mesh, &bmin, &bmax), "folded transform bounds");
+    ok = ok && require(std::fabs(bmin.x + 10.0) < 1e-6 && std::fabs(bmax.x - 10.0) < 1e-6 &&
+                           std::fabs(bmin.y) < 1e-6 && std::fabs(bmax.y - 10.0) < 1e-6 &&
+                           std::fabs(bmin.z) < 1e-6 && std::fabs(bmax.z - 10.0) < 1e-6,
+                       "folded transforms apply plane, translate and scale in order");
+    ok = ok && require(only_last_materialized(fusion_plan(rec, {5}), 2),
+                       "extrude and inner translate are deferred into the outer scale");
+  }
+
+  {
+    // Folding must compose in stream order: a rotation before a non-uniform
+    // scale gives different bounds than the reverse. A revolve folds the same
+    // way as an extrude.
+    std::vector<uint8_t> rec;
+    append_record(&rec, vicad::OpCode::CrossSquare, payload_cross_square(1, 2.0, 1.0, 1));
+    append_record(&rec, vicad::OpCode::Extrude, payload_extrude(2, 1, 1.0, 0, 0.0));
+    append_record(&rec, vicad::OpCode::Rotate, payload_transform(3, 2, 0.0, 0.0, 90.0));
+    append_record(&rec, vicad::OpCode::Scale, payload_transform(4, 3, 3.0, 1.0, 1.0));
+    ok = ok && require(only_last_materialized(fusion_plan(rec, {4}), 1),
+                       "extrude and rotation are deferred into the scale");
+
+    manifold::MeshGL mesh;
+    std::string err;
+    manifold::vec3 bmin, bmax;
+    ok = ok && require(replay_to_mesh(rec, 4, 4, vicad::LodProfile::Model, &mesh, &err) &&
+                           mesh_bounds(mesh, &bmin, &bmax),
+                       "rotate then scale replay");
+    // Rotating the 2 x 1 footprint first gives 1 x 2, then x triples; the
+    // reverse order would give 6 x 1.
+    ok = ok && require(std::fabs(bmin.x + 1.5) < 1e-6 && std::fabs(bmax.x - 1.5) < 1e-6 &&
+                           std::fabs(bmin.y + 1.0) < 1e-6 && std::fabs(bmax.y - 1.0) < 1e-6 &&
+                           std::fabs(bmin.z) < 1e-6 && std::fabs(bmax.z - 1.0) < 1e-6,
+                       "folded rotation applies before the non-uniform scale");
+
+    // A transform read twice is not folded: both readers materialize it.
+    append_record(&rec, vicad::OpCode::Translate, payload_transform(5, 3, 0.0, 0.0, 1.0));
+    const std::vector<vicad::NodeFusion> shared = fusion_plan(rec, {4, 5});
+    ok = ok && require(shared[1].deferred && !shared[2].deferred && !shared[3].deferred && !shared[4].deferred,
+                       "a transform with two readers is materialized");
+
+    rec.clear();
+    append_record(&rec, vicad::OpCode::CrossSquare, payload_cross_square(1, 2.0, 1.0, 0));
+    append_record(&rec, vicad::OpCode::CrossTranslate, payload_cross_translate(2, 1, 3.0, 0.0));
+    append_record(&rec, vicad::OpCode::Revolve, payload_revolve(3, 2, 32, 360.0));
+    append_record(&rec, vicad::OpCode::Rotate, payload_transform(4, 3, 90.0, 0.0, 0.0));
+    append_record(&rec, vicad::OpCode::Translate, payload_transform(5, 4, 0.0, 0.0, 1.0));
+    ok = ok && require(only_last_materialized(fusion_plan(rec, {5}), 2),
+                       "revolve and rotation are deferred into the translate");
+  }
+
+  {
+    // A left-deep subtract chain is flattened into one BatchBoolean; an
+    // intermediate read again in a later batch still resolves.
+    vicad::ReplayLodPolicy model = {};
+    model.profile = vicad::LodProfile::Model;
+    std::vector<uint8_t> rec;
+    std::vector<size_t> ends;
+    append_record(&rec, vicad::OpCode::Cube, payload_cube(1, 10.0, 10.0, 2.0, 1));
+    ends.push_back(rec.size());
+    append_record(&rec, vicad::OpCode::Cylinder, payload_cylinder(2, 4.0, 1.0, 1.0, 0, 1));
+    ends.push_back(rec.size());
+    append_record(&rec, vicad::OpCode::Translate, payload_transform(3, 2, 3.0, 0.0, 0.0));
+    ends.push_back(rec.size());
+    append_record(&rec, vicad::OpCode::Translate, payload_transform(4, 2, -3.0, 0.0, 0.0));
+    ends.push_back(rec.size());
+    append_record(&rec, vicad::OpCode::Subtract, payload_boolean(5, 1, 2));
+    ends.push_back(rec.size());
+    append_record(&rec, vicad::OpCode::Subtract, payload_boolean(6, 5, 3));
+    ends.push_back(rec.size());
+    append_record(&rec, vicad::OpCode::Subtract, payload_boolean(7, 6, 4));
+    ends.push_back(rec.size());
+    const size_t first_batch = rec.size();
+    append_record(&rec, vicad::OpCode::Translate, payload_transform(8, 6, 0.0, 0.0, 5.0));
+    vicad::ReplayStream stream;
+    vicad::ReplayStreamBegin(&stream, model);
+    std::string err;
+    ok = ok && require(vicad::ReplayStreamFeed(&stream, rec.data(), first_batch, &err) &&
+                           vicad::ReplayStreamFeed(&stream, rec.data(), rec.size(), &err) &&
+                           vicad::ReplayStreamFinish(stream, rec.size(), 8, &err),
+                       "flattened subtract chain replay");
+    manifold::Manifold chain, partial;
+    ok = ok && require(vicad::ResolveReplayManifold(stream.tables, (uint32_t)vicad::NodeKind::Manifold, 7,
+                                                    model, &chain, &err) &&
+                           vicad::ResolveReplayManifold(stream.tables, (uint32_t)vicad::NodeKind::Manifold, 8,
+                                                        model, &partial, &err),
+                       "resolve chain head and later reader of a deferred node");
+
+    // One record per feed leaves nothing to fuse: the pairwise reference.
+    vicad::ReplayStream pairwise;
+    vicad::ReplayStreamBegin(&pairwise, model);
+    for (size_t end : ends) ok = ok && require(vicad::ReplayStreamFeed(&pairwise, rec.data(), end, &err), "pairwise");
+    manifold::Manifold expected;
+    ok = ok && require(vicad::ResolveReplayManifold(pairwise.tables, (uint32_t)vicad::NodeKind::Manifold, 7,
+                                                    model, &expected, &err),
+                       "resolve pairwise chain");
+    ok = ok && require(std::fabs(chain.Volume() - expected.Volume()) < 1e-6 &&
+                           partial.Volume() > chain.Volume(),
+                       "flattened chain matches pairwise subtraction");
+  }
+
+  {
+    // Union of two overlapping cubes and a far one: the overlapping pair goes
+    // through a boolean, the far cube is composed in, and the result matches
+    // a plain BatchBoolean.
+    std::vector<uint8_t> rec;
+    append_record(&rec, vicad::OpCode::Cube, payload_cube(1, 2.0, 2.0, 2.0, 0));
+    append_record(&rec, vicad::OpCode::Cube, payload_cube(2, 2.0, 2.0, 2.0, 0));
+    append_record(&rec, vicad::OpCode::Translate, payload_transform(3, 2, 1.0, 0.0, 0.0));
+    append_record(&rec, vicad::OpCode::Cube, payload_cube(4, 2.0, 2.0, 2.0, 0));
+    append_record(&rec, vicad::OpCode::Translate, payload_transform(5, 4, 50.0, 0.0, 0.0));
+    append_record(&rec, vicad::OpCode::Union, payload_union(6, {1, 3, 5}));
+    vicad::ReplayTables tables;
+    vicad::ReplayLodPolicy model = {};
+    model.profile = vicad::LodProfile::Model;
+    std::string err;
+    ok = ok && require(vicad::ReplayOpsToTables(rec.data(), rec.size(), 6, model, &tables, &err),
+                       "disjoint union replay");
+    if (ok) {
+      const manifold::Manifold &merged = tables.manifold_nodes[6];
+      const manifold::Manifold expected = manifold::Manifold::BatchBoolean(
+          {tables.manifold_nodes[1], tables.manifold_nodes[3], tables.manifold_nodes[5]}, manifold::OpType::Add);
+      ok = ok && require(std::fabs(merged.Volume() - 20.0) < 1e-6 &&
+                             std::fabs(merged.Volume() - expected.Volume()) < 1e-6 &&
+                             merged.NumTri() == expected.NumTri() && merged.Genus() == -1,
+                         "bounds-partitioned union matches BatchBoolean");
+      const manifold::Manifold lone = vicad::UnionByBounds({tables.manifold_nodes[5]});
+      ok = ok && require(std::fabs(lone.Volume() - 8.0) < 1e-6 && vicad::UnionByBounds({}).IsEmpty(),
+                         "union of one part and of none");
+    }
+  }
+
+  return ok;
+}
+
+}  // namespace lod_replay_test
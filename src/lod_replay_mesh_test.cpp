@@ -0,0 +1,219 @@
+#include "lod_replay_test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "face_detection.h"
+#include "mesh_bvh.h"
+#include "mesh_topology.h"
+
+namespace lod_replay_test {
+
+namespace {
+
+// Brute-force, one-triangle-at-a-time Moller-Trumbore over the whole mesh, in
+// the same double precision and with the same thresholds as the BVH leaves.
+// `ties` gets every triangle hit at the nearest t (rays through shared edges).
+bool reference_raycast(const manifold::MeshGL &mesh, const double o[3], const double d[3], double *out_t,
+                       std::vector<uint32_t> *ties) {
+  double best_t = std::numeric_limits<double>::infinity();
+  ties->clear();
+  for (uint32_t tri = 0; tri < mesh.NumTri(); ++tri) {
+    double c[3][3];
+    for (int k = 0; k < 3; ++k) {
+      const float *p = &mesh.vertProperties[(size_t)mesh.triVerts[(size_t)tri * 3 + k] * mesh.numProp];
+      for (int a = 0; a < 3; ++a) c[k][a] = (double)p[a];
+    }
+    double e1[3], e2[3], tv[3];
+    for (int a = 0; a < 3; ++a) {
+      e1[a] = c[1][a] - c[0][a];
+      e2[a] = c[2][a] - c[0][a];
+      tv[a] = o[a] - c[0][a];
+    }
+    const double p[3] = {d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0]};
+    const double det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    if (std::fabs(det) < 1e-12) continue;
+    const double inv_det = 1.0 / det;
+    const double u = (tv[0] * p[0] + tv[1] * p[1] + tv[2] * p[2]) * inv_det;
+    const double q[3] = {tv[1] * e1[2] - tv[2] * e1[1], tv[2] * e1[0] - tv[0] * e1[2], tv[0] * e1[1] - tv[1] * e1[0]};
+    const double v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv_det;
+    const double t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv_det;
+    if (u < 0.0 || u > 1.0 || v < 0.0 || u + v > 1.0 || !(t > 1e-9) || t > best_t) continue;
+    if (t < best_t) ties->clear();
+    best_t = t;
+    ties->push_back(tri);
+  }
+  *out_t = best_t;
+  return !ties->empty();
+}
+
+// The BVH pick agrees with the reference: same hit or miss, the same t, and a
+// triangle the reference also hits at that t.
+bool pick_matches_reference(const manifold::MeshGL &mesh, const vicad::MeshBvh &bvh, const double o[3],
+                            const double d[3]) {
+  double ref_t = 0.0;
+  std::vector<uint32_t> ties;
+  const bool ref_hit = reference_raycast(mesh, o, d, &ref_t, &ties);
+  double t = 0.0;
+  uint32_t tri = 0;
+  const bool hit = vicad::RaycastMeshBvh(mesh, bvh, o[0], o[1], o[2], d[0], d[1], d[2], &t, &tri);
+  if (hit != ref_hit) return false;
+  if (!hit) return true;
+  return std::fabs(t - ref_t) <= 1e-9 * std::max(1.0, ref_t) &&
+         std::find(ties.begin(), ties.end(), tri) != ties.end();
+}
+
+// Strip of `count` unit right triangles in z = 0 along +x, with integer corners
+// so rays down onto shared edges and vertices are tested exactly.
+manifold::MeshGL triangle_strip(uint32_t count) {
+  manifold::MeshGL mesh;
+  mesh.numProp = 3;
+  const uint32_t columns = count / 2 + 2;
+  for (uint32_t i = 0; i < columns; ++i) {
+    for (float y : {0.0f, 1.0f}) {
+      mesh.vertProperties.insert(mesh.vertProperties.end(), {(float)i, y, 0.0f});
+    }
+  }
+  for (uint32_t tri = 0; tri < count; ++tri) {
+    const uint32_t k = tri / 2;
+    if (tri % 2 == 0) {
+      mesh.triVerts.insert(mesh.triVerts.end(), {2 * k, 2 * (k + 1), 2 * k + 1});
+    } else {
+      mesh.triVerts.insert(mesh.triVerts.end(), {2 * (k + 1), 2 * (k + 1) + 1, 2 * k + 1});
+    }
+  }
+  return mesh;
+}
+
+}  // namespace
+
+bool run_mesh_tests() {
+  bool ok = true;
+
+  {
+    // BVH ray casts land on the exact face of an axis-aligned cube, whose
+    // leaf boxes are flat, and on the surface of a sphere.
+    std::vector<uint8_t> rec;
+    append_record(&rec, vicad::OpCode::Cube, payload_cube(1, 2.0, 2.0, 2.0, 1));
+    manifold::MeshGL cube;
+    std::string err;
+    ok = ok && require(replay_to_mesh(rec, 1, 1, vicad::LodProfile::Model, &cube, &err), "bvh cube replay");
+    const vicad::MeshBvh cube_bvh = vicad::BuildMeshBvh(cube);
+    bool cube_ok = !cube_bvh.nodes.empty();
+    for (int i = 0; i <= 8 && cube_ok; ++i) {
+      for (int j = 0; j <= 8 && cube_ok; ++j) {
+        const double x = -1.2 + 0.3 * i;
+        const double y = -1.2 + 0.3 * j;
+        double t = 0.0;
+        const bool hit = vicad::RaycastMeshBvh(cube, cube_bvh, x, y, 5.0, 0.0, 0.0, -1.0, &t, nullptr);
+        const bool inside = std::fabs(x) < 1.0 && std::fabs(y) < 1.0;
+        cube_ok = hit == inside && (!hit || std::fabs(t - 4.0) < 1e-6);
+      }
+    }
+    ok = ok && require(cube_ok, "bvh cube top face hits");
+
+    rec.clear();
+    append_record(&rec, vicad::OpCode::Sphere, payload_sphere(1, 20.0, 64));
+    manifold::MeshGL sphere;
+    ok = ok && require(replay_to_mesh(rec, 1, 1, vicad::LodProfile::Model, &sphere, &err), "bvh sphere replay");
+    const vicad::MeshBvh sphere_bvh = vicad::BuildMeshBvh(sphere);
+    bool sphere_ok = true;
+    for (int i = 0; i < 64 && sphere_ok; ++i) {
+      const double a = 0.1 * i;
+      const double dir[3] = {std::cos(a) * 0.1, std::sin(a) * 0.1, -1.0};
+      double t = 0.0;
+      uint32_t tri = 0;
+      const bool hit = vicad::RaycastMeshBvh(sphere, sphere_bvh, 0.0, 0.0, 100.0, dir[0], dir[1], dir[2], &t, &tri);
+      const double r = std::sqrt(std::pow(dir[0] * t, 2) + std::pow(dir[1] * t, 2) + std::pow(100.0 + dir[2] * t, 2));
+      sphere_ok = hit && tri < sphere.NumTri() && r > 19.5 && r < 20.01;
+    }
+    ok = ok && require(sphere_ok, "bvh sphere hits lie on the surface");
+    ok = ok && require(!vicad::RaycastMeshBvh(sphere, sphere_bvh, 0.0, 0.0, 100.0, 1.0, 0.0, 0.0, nullptr, nullptr),
+                       "bvh ray past the sphere misses");
+    ok = ok && require(!vicad::RaycastMeshBvh(cube, sphere_bvh, 0.0, 0.0, 5.0, 0.0, 0.0, -1.0, nullptr, nullptr),
+                       "bvh rejects a mesh it was not built from");
+  }
+
+  {
+    // BVH picks, whose leaves test four triangles per vector batch, match a
+    // scalar brute-force reference. Strips of 1..11 triangles leave every
+    // batch remainder; rays land on shared edges and vertices, graze the
+    // strip nearly parallel to it, or lie in its plane. A dense sphere adds
+    // near-tangent rays.
+    bool strip_ok = true;
+    for (uint32_t count = 1; count <= 11 && strip_ok; ++count) {
+      const manifold::MeshGL strip = triangle_strip(count);
+      const vicad::MeshBvh bvh = vicad::BuildMeshBvh(strip);
+      const double down[3] = {0.0, 0.0, -1.0};
+      for (int i = -2; i <= 4 * ((int)count / 2 + 2) && strip_ok; ++i) {
+        for (int j = -1; j <= 5 && strip_ok; ++j) {
+          const double o[3] = {0.25 * i, 0.25 * j, 2.0};
+          strip_ok = pick_matches_reference(strip, bvh, o, down);
+        }
+      }
+      for (int i = 0; i < 16 && strip_ok; ++i) {
+        const double o[3] = {-1.0, 0.0625 * i, 1e-3 * (i + 1)};
+        const double grazing[3] = {1.0, 0.01, -1e-3};
+        const double in_plane[3] = {1.0, 0.01, 0.0};
+        const double o_plane[3] = {-1.0, 0.0625 * i, 0.0};
+        strip_ok = pick_matches_reference(strip, bvh, o, grazing) &&
+                   pick_matches_reference(strip, bvh, o_plane, in_plane);
+      }
+    }
+    ok = ok && require(strip_ok, "bvh picks on triangle strips match the scalar reference");
+
+    const manifold::MeshGL sphere = manifold::Manifold::Sphere(20.0, 96).GetMeshGL();
+    const vicad::MeshBvh bvh = vicad::BuildMeshBvh(sphere);
+    bool sphere_ok = true;
+    for (int i = 0; i < 200 && sphere_ok; ++i) {
+      // Rays parallel to -z at a radius sweeping out to just past the
+      // silhouette, so the last ones graze the sphere or miss it.
+      const double a = 0.37 * i;
+      const double r = 20.0 * std::min(1.0005, std::sqrt(i / 190.0));
+      const double o[3] = {r * std::cos(a), r * std::sin(a), 50.0};
+      const double d[3] = {0.0, 0.0, -1.0};
+      sphere_ok = pick_matches_reference(sphere, bvh, o, d);
+    }
+    ok = ok && require(sphere_ok, "bvh picks on a sphere match the scalar reference");
+  }
+
+  {
+    // Faces of a translated cylinder unioned with a sphere are typed from the
+    // primitives their runs came from: one sphere, one cylinder side and the
+    // two cylinder ends.
+    std::vector<uint8_t> rec;
+    append_record(&rec, vicad::OpCode::Cylinder, payload_cylinder(1, 10.0, 3.0, 3.0, 0, 0));
+    append_record(&rec, vicad::OpCode::Translate, payload_transform(2, 1, 20.0, 0.0, 0.0));
+    append_record(&rec, vicad::OpCode::Sphere, payload_sphere(3, 5.0, 0));
+    append_record(&rec, vicad::OpCode::Union, payload_union(4, {2, 3}));
+    vicad::ReplayTables tables;
+    vicad::ReplayLodPolicy model = {};
+    model.profile = vicad::LodProfile::Model;
+    std::string err;
+    ok = ok && require(vicad::ReplayOpsToTables(rec.data(), rec.size(), 4, model, &tables, &err),
+                       "provenance replay");
+    if (ok) {
+      const manifold::MeshGL mesh = tables.manifold_nodes[4].GetMeshGL();
+      const vicad::MeshTopology topo = vicad::BuildMeshTopology(mesh);
+      const std::vector<vicad::FaceSource> sources = {
+          {(uint32_t)tables.manifold_nodes[1].OriginalID(), vicad::FaceSourceShape::Cylinder, 3.0},
+          {(uint32_t)tables.manifold_nodes[3].OriginalID(), vicad::FaceSourceShape::Sphere, 5.0},
+      };
+      const vicad::FaceDetectionResult faces = vicad::DetectMeshFaces(mesh, topo, 30.0f, sources);
+      const auto count = [&](vicad::FacePrimitiveType type) {
+        return std::count(faces.regionType.begin(), faces.regionType.end(), type);
+      };
+      ok = ok && require(faces.regions.size() == 4 && count(vicad::FacePrimitiveType::Sphere) == 1 &&
+                             count(vicad::FacePrimitiveType::Cylinder) == 1 &&
+                             count(vicad::FacePrimitiveType::Plane) == 2,
+                         "faces typed from op provenance");
+    }
+  }
+
+  return ok;
+}
+
+}  // namespace lod_replay_test
@@ -0,0 +1,257 @@
+#include "lod_replay_test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+#include "replay_cache.h"
+
+namespace lod_replay_test {
+
+bool run_stream_tests() {
+  bool ok = true;
+
+  {
+    // Feeding the stream in arbitrary slices matches a one-shot replay, and
+    // finishing before the last record has arrived reports truncation.
+    std::vector<uint8_t> rec;
+    append_record(&rec, vicad::OpCode::CrossSquare,
+                  payload_cross_square(1, 20.0, 20.0, 1));
+    append_record(&rec, vicad::OpCode::CrossPlane,
+                  payload_cross_plane(2, 1, 1, 3.0));
+    append_record(&rec, vicad::OpCode::Cube,
+                  payload_cube(3, 2.0, 3.0, 4.0, 1));
+
+    vicad::ReplayLodPolicy lod_policy = {};
+    lod_policy.profile = vicad::LodProfile::Model;
+    vicad::ReplayStream stream;
+    vicad::ReplayStreamBegin(&stream, lod_policy);
+    std::string err;
+    for (size_t available = 0; available <= rec.size() && ok; available += 3) {
+      ok = ok && require(vicad::ReplayStreamFeed(&stream, rec.data(), available, &err),
+                         "sliced stream feed");
+    }
+    ok = ok && require(!vicad::ReplayStreamFinish(stream, rec.size(), 3, &err) &&
+                           err == "Replay failed: truncated op payload.",
+                       "finish before the last record reports truncation");
+    ok = ok && require(vicad::ReplayStreamFeed(&stream, rec.data(), rec.size(), &err) &&
+                           vicad::ReplayStreamFinish(stream, rec.size(), 3, &err),
+                       "stream completes once every record is available");
+    vicad::SketchPlane plane;
+    ok = ok && require(vicad::ResolveReplayCrossSectionPlane(
+                           stream.tables, (uint32_t)vicad::NodeKind::CrossSection, 2, &plane, &err),
+                       "resolve streamed cross plane");
+    ok = ok && require((uint32_t)plane.kind == 1 && std::fabs(plane.offset - 3.0) < 1e-9,
+                       "streamed cross plane metadata");
+    manifold::Manifold cube;
+    ok = ok && require(vicad::ResolveReplayManifold(stream.tables, (uint32_t)vicad::NodeKind::Manifold, 3,
+                                                    lod_policy, &cube, &err),
+                       "resolve streamed cube");
+  }
+
+  {
+    // Semantics live in the tables' flat arena; polygon rings round-trip
+    // through it, including via a cache hit.
+    vicad::ReplayCache cache;
+    vicad::ReplayLodPolicy model = {};
+    model.profile = vicad::LodProfile::Model;
+    const std::vector<std::vector<manifold::vec2>> rings = {
+        {{0.0, 0.0}, {4.0, 0.0}, {4.0, 3.0}},
+        {{10.0, 0.0}, {12.0, 0.0}, {12.0, 2.0}, {10.0, 2.0}},
+    };
+    std::vector<uint8_t> rec;
+    append_record(&rec, vicad::OpCode::CrossPolygons, payload_cross_polygons(1, rings), 0x61);
+    append_record(&rec, vicad::OpCode::CrossTranslate, payload_cross_translate(2, 1, 5.0, 6.0), 0x62);
+    std::string err;
+    for (int pass = 0; pass < 2; ++pass) {
+      cache.BeginRun();
+      vicad::ReplayStream stream;
+      vicad::ReplayStreamBegin(&stream, model, &cache);
+      ok = ok && require(vicad::ReplayStreamFeed(&stream, rec.data(), rec.size(), &err) &&
+                             vicad::ReplayStreamFinish(stream, rec.size(), 2, &err),
+                         "arena replay");
+      cache.EndRun(vicad::LodKeyForPolicy(model));
+      const vicad::ReplayTables &t = stream.tables;
+      const manifold::Polygons polys = vicad::ReplaySemanticPolygons(t, t.node_semantics[1]);
+      ok = ok && require(polys.size() == 2 && polys[0].size() == 3 && polys[1].size() == 4 &&
+                             polys[1][2].x == 12.0 && polys[1][2].y == 2.0,
+                         "polygon rings read back from the arena");
+      const auto f64 = vicad::ReplaySemanticF64(t, t.node_semantics[2]);
+      ok = ok && require(f64.size() == 2 && f64[0] == 5.0 && f64[1] == 6.0 &&
+                             vicad::ReplaySemanticInputs(t, t.node_semantics[2]).front() == 1,
+                         "translate params and inputs read back from the arena");
+    }
+    ok = ok && require(cache.hits() == 2, "second arena run is served by the cache");
+  }
+
+  {
+    // Digest-keyed cache: a second run reuses every node, under new node ids,
+    // while a different LOD profile misses.
+    vicad::ReplayCache cache;
+    vicad::ReplayLodPolicy model = {};
+    model.profile = vicad::LodProfile::Model;
+    auto run = [&](uint32_t first_id, const vicad::ReplayLodPolicy& policy, std::string* err) {
+      std::vector<uint8_t> rec;
+      append_record(&rec, vicad::OpCode::Sphere, payload_sphere(first_id, 2.0, 0), 0x51);
+      append_record(&rec, vicad::OpCode::Cube, payload_cube(first_id + 1, 1.0, 1.0, 1.0, 1), 0x52);
+      cache.BeginRun();
+      vicad::ReplayStream stream;
+      vicad::ReplayStreamBegin(&stream, policy, &cache);
+      const bool replayed = vicad::ReplayStreamFeed(&stream, rec.data(), rec.size(), err) &&
+                            vicad::ReplayStreamFinish(stream, rec.size(), 2, err);
+      manifold::Manifold sphere;
+      const bool resolved = replayed && vicad::ResolveReplayManifold(
+                                            stream.tables, (uint32_t)vicad::NodeKind::Manifold,
+                                            first_id, policy, &sphere, err);
+      if (resolved) cache.EndRun(vicad::LodKeyForPolicy(policy));
+      return resolved && stream.tables.node_semantics[first_id].out_id == first_id;
+    };
+    std::string err;
+    ok = ok && require(run(1, model, &err) && cache.misses() == 2, "cold cache run");
+    ok = ok && require(run(7, model, &err) && cache.hits() == 2 && cache.misses() == 0,
+                       "warm cache run reuses nodes under new ids");
+    vicad::ReplayLodPolicy draft = model;
+    draft.profile = vicad::LodProfile::Draft;
+    ok = ok && require(run(1, draft, &err) && cache.misses() == 2 && cache.size() == 4,
+                       "other profile misses and keeps model entries");
+  }
+
+  {
+    // Independent sub-assemblies replay concurrently; results and the reported
+    // error match a sequential replay.
+    vicad::ReplayLodPolicy model = {};
+    model.profile = vicad::LodProfile::Model;
+    auto assembly = [](std::vector<uint8_t>* rec, uint32_t first_id, const std::vector<uint32_t>& parts) {
+      append_record(rec, vicad::OpCode::Sphere, payload_sphere(first_id, 2.0, 0));
+      append_record(rec, vicad::OpCode::Cube, payload_cube(first_id + 1, 1.0, 1.0, 1.0, 1));
+      append_record(rec, vicad::OpCode::Union, payload_union(first_id + 2, parts));
+    };
+    std::vector<uint8_t> rec;
+    assembly(&rec, 1, {1, 2});
+    assembly(&rec, 4, {4, 5});
+    append_record(&rec, vicad::OpCode::Union, payload_union(7, {3, 6}));
+    vicad::ReplayTables tables;
+    std::string err;
+    ok = ok && require(vicad::ReplayOpsToTables(rec.data(), rec.size(), 7, model, &tables, &err),
+                       "parallel sub-assembly replay");
+    manifold::Manifold root;
+    ok = ok && require(vicad::ResolveReplayManifold(tables, (uint32_t)vicad::NodeKind::Manifold, 7,
+                                                    model, &root, &err) && !root.IsEmpty(),
+                       "resolve parallel replay root");
+
+    std::vector<uint8_t> bad;
+    assembly(&bad, 1, {});
+    assembly(&bad, 4, {4, 9});
+    vicad::ReplayTables bad_tables;
+    ok = ok && require(!vicad::ReplayOpsToTables(bad.data(), bad.size(), 6, model, &bad_tables, &err) &&
+                           err == "Replay failed: invalid union payload.",
+                       "parallel replay reports the first failure in stream order");
+  }
+
+  {
+    // Delta run: keep records copy base nodes under new ids and remap their
+    // inputs; only the new records are replayed.
+    vicad::ReplayLodPolicy model = {};
+    model.profile = vicad::LodProfile::Model;
+    std::vector<uint8_t> base_rec;
+    append_record(&base_rec, vicad::OpCode::Sphere, payload_sphere(1, 2.0, 0), 0xA1);
+    append_record(&base_rec, vicad::OpCode::Cube, payload_cube(2, 1.0, 1.0, 1.0, 1), 0xA2);
+    append_record(&base_rec, vicad::OpCode::Union, payload_union(3, {1, 2}), 0xA3);
+    std::string err;
+    auto base = std::make_shared<vicad::ReplayTables>();
+    ok = ok && require(vicad::ReplayOpsToTables(base_rec.data(), base_rec.size(), 3, model, base.get(), &err),
+                       "delta base replay");
+
+    std::vector<uint8_t> rec;
+    append_record(&rec, vicad::OpCode::Cylinder, payload_cylinder(1, 4.0, 1.0, 1.0, 0, 0), 0xB1);
+    append_record(&rec, vicad::OpCode::Sphere, payload_keep(2, 1), 0xA1, vicad::kOpRecordFlagKeep);
+    append_record(&rec, vicad::OpCode::Cube, payload_keep(3, 2), 0xA2, vicad::kOpRecordFlagKeep);
+    append_record(&rec, vicad::OpCode::Union, payload_keep(4, 3), 0xA3, vicad::kOpRecordFlagKeep);
+    append_record(&rec, vicad::OpCode::Union, payload_union(5, {1, 4}), 0xB2);
+    vicad::ReplayStream stream;
+    vicad::ReplayStreamBegin(&stream, model, nullptr, base);
+    ok = ok && require(vicad::ReplayStreamFeed(&stream, rec.data(), rec.size(), &err) &&
+                           vicad::ReplayStreamFinish(stream, rec.size(), 5, &err),
+                       "delta replay");
+    const vicad::ReplayNodeSemantic &kept_union = stream.tables.node_semantics[4];
+    ok = ok && require(stream.kept == 3 &&
+                           std::ranges::equal(vicad::ReplaySemanticInputs(stream.tables, kept_union),
+                                              std::vector<uint32_t>{2, 3}),
+                       "kept union is remapped to the new input ids");
+    manifold::Manifold root;
+    ok = ok && require(vicad::ResolveReplayManifold(stream.tables, (uint32_t)vicad::NodeKind::Manifold, 5,
+                                                    model, &root, &err),
+                       "resolve delta root");
+
+    vicad::ReplayTables no_base;
+    ok = ok && require(!vicad::ReplayOpsToTables(rec.data(), rec.size(), 5, model, &no_base, &err),
+                       "keep records need a base");
+  }
+
+  {
+    // Low-memory replay frees intermediates after their last use and drops
+    // semantics no root reaches.
+    vicad::ReplayLodPolicy model = {};
+    model.profile = vicad::LodProfile::Model;
+    std::vector<uint8_t> rec;
+    append_record(&rec, vicad::OpCode::Sphere, payload_sphere(1, 2.0, 0));
+    append_record(&rec, vicad::OpCode::Cube, payload_cube(2, 1.0, 1.0, 1.0, 1));
+    append_record(&rec, vicad::OpCode::Union, payload_union(3, {1, 2}));
+    append_record(&rec, vicad::OpCode::Union, payload_union(4, {3}));
+    append_record(&rec, vicad::OpCode::Sphere, payload_sphere(5, 1.0, 0));
+    vicad::ReplayStream stream;
+    vicad::ReplayStreamBegin(&stream, model);
+    stream.release_dead = true;
+    stream.roots = {4};
+    std::string err;
+    ok = ok && require(vicad::ReplayStreamFeed(&stream, rec.data(), rec.size(), &err) &&
+                           vicad::ReplayStreamFinish(stream, rec.size(), 5, &err),
+                       "low-memory replay");
+    const vicad::ReplayTables &t = stream.tables;
+    auto is_manifold = [&](uint32_t id) { return vicad::ReplayNodeIs(t, id, vicad::NodeKind::Manifold); };
+    ok = ok && require(!is_manifold(1) && !is_manifold(2) && !is_manifold(3) && is_manifold(4) && !is_manifold(5),
+                       "only the root keeps its geometry");
+    ok = ok && require(t.node_semantics[1].valid && t.node_semantics[3].valid && !t.node_semantics[5].valid,
+                       "semantics kept for reachable nodes only");
+    std::vector<vicad::OpTraceEntry> trace;
+    ok = ok && require(vicad::BuildOperationTraceForRoot(t, (uint32_t)vicad::NodeKind::Manifold, 4, &trace, &err) &&
+                           trace.size() == 4,
+                       "op trace survives low-memory replay");
+  }
+
+  {
+    // A shared op trace builds each node's entry once; each root's span is
+    // still its own postorder.
+    vicad::ReplayLodPolicy model = {};
+    model.profile = vicad::LodProfile::Model;
+    std::vector<uint8_t> rec;
+    append_record(&rec, vicad::OpCode::Sphere, payload_sphere(1, 2.0, 0));
+    append_record(&rec, vicad::OpCode::Cube, payload_cube(2, 1.0, 1.0, 1.0, 1));
+    append_record(&rec, vicad::OpCode::Union, payload_union(3, {1, 2}));
+    append_record(&rec, vicad::OpCode::Translate, payload_transform(4, 3, 5.0, 0.0, 0.0));
+    append_record(&rec, vicad::OpCode::Translate, payload_transform(5, 3, 0.0, 5.0, 0.0));
+    vicad::ReplayTables t;
+    std::string err;
+    ok = ok && require(vicad::ReplayOpsToTables(rec.data(), rec.size(), 5, model, &t, &err), "shared trace replay");
+    const uint32_t roots[] = {4, 5, 99};
+    vicad::OpTraceTable table;
+    vicad::BuildOperationTraceTable(t, roots, &table);
+    ok = ok && require(table.entries.size() == 5 && table.roots.size() == 3, "one entry per traced node");
+    std::vector<vicad::OpTraceEntry> single;
+    ok = ok && require(vicad::BuildOperationTraceForRoot(t, (uint32_t)vicad::NodeKind::Manifold, 5, &single, &err),
+                       "single-root trace");
+    const vicad::OpTraceSpan &span = table.roots[1];
+    bool same = span.valid && span.count == single.size();
+    for (uint32_t i = 0; same && i < span.count; ++i) {
+      same = table.entries[table.order[span.offset + i]].outId == single[i].outId;
+    }
+    ok = ok && require(same, "shared trace matches the single-root trace");
+    ok = ok && require(table.roots[0].valid && table.roots[0].count == 4 && !table.roots[2].valid &&
+                           table.roots[2].count == 0,
+                       "root spans");
+  }
+
+  return ok;
+}
+
+}  // namespace lod_replay_test
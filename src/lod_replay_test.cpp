@@ -1,208 +1,12 @@
-#include "op_decoder.h"
+#include "lod_replay_test.h"
 
-#include <algorithm>
 #include <cmath>
-#include <cstdint>
-#include <cstring>
-#include <iostream>
-#include <string>
-#include <tuple>
-#include <vector>
-
-#include "ipc_protocol.h"
-
-namespace {
-
-template <typename T>
-void append_pod(std::vector<uint8_t>* out, const T& v) {
-  const size_t at = out->size();
-  out->resize(at + sizeof(T));
-  std::memcpy(out->data() + at, &v, sizeof(T));
-}
-
-void append_record(std::vector<uint8_t>* out, vicad::OpCode opcode,
-                   const std::vector<uint8_t>& payload) {
-  vicad::OpRecordHeader hdr = {};
-  hdr.opcode = (uint16_t)opcode;
-  hdr.flags = 0;
-  hdr.payload_len = (uint32_t)payload.size();
-  append_pod(out, hdr);
-  out->insert(out->end(), payload.begin(), payload.end());
-}
-
-std::vector<uint8_t> payload_sphere(uint32_t out_id, double radius,
-                                    uint32_t segments) {
-  std::vector<uint8_t> out;
-  append_pod(&out, out_id);
-  append_pod(&out, radius);
-  append_pod(&out, segments);
-  return out;
-}
-
-std::vector<uint8_t> payload_cylinder(uint32_t out_id, double h, double r1,
-                                      double r2, uint32_t segments,
-                                      uint32_t center) {
-  std::vector<uint8_t> out;
-  append_pod(&out, out_id);
-  append_pod(&out, h);
-  append_pod(&out, r1);
-  append_pod(&out, r2);
-  append_pod(&out, segments);
-  append_pod(&out, center);
-  return out;
-}
-
-std::vector<uint8_t> payload_cube(uint32_t out_id, double x, double y, double z,
-                                  uint32_t center) {
-  std::vector<uint8_t> out;
-  append_pod(&out, out_id);
-  append_pod(&out, x);
-  append_pod(&out, y);
-  append_pod(&out, z);
-  append_pod(&out, center);
-  return out;
-}
-
-std::vector<uint8_t> payload_cross_circle(uint32_t out_id, double radius,
-                                          uint32_t segments) {
-  std::vector<uint8_t> out;
-  append_pod(&out, out_id);
-  append_pod(&out, radius);
-  append_pod(&out, segments);
-  return out;
-}
-
-std::vector<uint8_t> payload_revolve(uint32_t out_id, uint32_t cs_id,
-                                     uint32_t segments, double degrees) {
-  std::vector<uint8_t> out;
-  append_pod(&out, out_id);
-  append_pod(&out, cs_id);
-  append_pod(&out, segments);
-  append_pod(&out, degrees);
-  return out;
-}
-
-std::vector<uint8_t> payload_cross_square(uint32_t out_id, double w, double h,
-                                          uint32_t center) {
-  std::vector<uint8_t> out;
-  append_pod(&out, out_id);
-  append_pod(&out, w);
-  append_pod(&out, h);
-  append_pod(&out, center);
-  return out;
-}
-
-std::vector<uint8_t> payload_cross_fillet(uint32_t out_id, uint32_t in_id,
-                                          double radius) {
-  std::vector<uint8_t> out;
-  append_pod(&out, out_id);
-  append_pod(&out, in_id);
-  append_pod(&out, radius);
-  return out;
-}
-
-std::vector<uint8_t> payload_cross_fillet_corners(
-    uint32_t out_id, uint32_t in_id,
-    const std::vector<std::tuple<uint32_t, uint32_t, double>> &corners) {
-  std::vector<uint8_t> out;
-  append_pod(&out, out_id);
-  append_pod(&out, in_id);
-  const uint32_t count = (uint32_t)corners.size();
-  append_pod(&out, count);
-  for (const auto &corner : corners) {
-    append_pod(&out, std::get<0>(corner));
-    append_pod(&out, std::get<1>(corner));
-    append_pod(&out, std::get<2>(corner));
-  }
-  return out;
-}
-
-std::vector<uint8_t> payload_cross_offset_clone(uint32_t out_id, uint32_t in_id,
-                                                double delta) {
-  std::vector<uint8_t> out;
-  append_pod(&out, out_id);
-  append_pod(&out, in_id);
-  append_pod(&out, delta);
-  return out;
-}
-
-std::vector<uint8_t> payload_cross_plane(uint32_t out_id, uint32_t in_id,
-                                         uint32_t kind, double offset) {
-  std::vector<uint8_t> out;
-  append_pod(&out, out_id);
-  append_pod(&out, in_id);
-  append_pod(&out, kind);
-  append_pod(&out, offset);
-  return out;
-}
-
-std::vector<uint8_t> payload_cross_translate(uint32_t out_id, uint32_t in_id,
-                                             double x, double y) {
-  std::vector<uint8_t> out;
-  append_pod(&out, out_id);
-  append_pod(&out, in_id);
-  append_pod(&out, x);
-  append_pod(&out, y);
-  return out;
-}
-
-std::vector<uint8_t> payload_extrude(uint32_t out_id, uint32_t cs_id, double h,
-                                     uint32_t divisions, double twist) {
-  std::vector<uint8_t> out;
-  append_pod(&out, out_id);
-  append_pod(&out, cs_id);
-  append_pod(&out, h);
-  append_pod(&out, divisions);
-  append_pod(&out, twist);
-  return out;
-}
-
-bool replay_to_mesh(const std::vector<uint8_t>& records, uint32_t op_count,
-                    uint32_t root_id, vicad::LodProfile profile,
-                    manifold::MeshGL* out_mesh, std::string* out_err) {
-  vicad::ReplayInput in = {};
-  in.records = records.data();
-  in.records_size = records.size();
-  in.op_count = op_count;
-  in.root_kind = (uint32_t)vicad::NodeKind::Manifold;
-  in.root_id = root_id;
-  in.lod_policy.profile = profile;
-  return vicad::ReplayOpsToMesh(in, out_mesh, out_err);
-}
-
-bool require(bool cond, const char* msg) {
-  if (cond) return true;
-  std::cerr << "[lod_replay_test] FAIL: " << msg << "\n";
-  return false;
-}
 
-bool mesh_bounds(const manifold::MeshGL &mesh, manifold::vec3 *out_min, manifold::vec3 *out_max) {
-  if (!out_min || !out_max) return false;
-  if (mesh.numProp < 3 || mesh.vertProperties.empty()) return false;
-  const size_t count = mesh.vertProperties.size() / mesh.numProp;
-  if (count == 0) return false;
-  manifold::vec3 bmin(1e30, 1e30, 1e30);
-  manifold::vec3 bmax(-1e30, -1e30, -1e30);
-  for (size_t i = 0; i < count; ++i) {
-    const size_t at = i * mesh.numProp;
-    const double x = mesh.vertProperties[at + 0];
-    const double y = mesh.vertProperties[at + 1];
-    const double z = mesh.vertProperties[at + 2];
-    bmin.x = std::min(bmin.x, x);
-    bmin.y = std::min(bmin.y, y);
-    bmin.z = std::min(bmin.z, z);
-    bmax.x = std::max(bmax.x, x);
-    bmax.y = std::max(bmax.y, y);
-    bmax.z = std::max(bmax.z, z);
-  }
-  *out_min = bmin;
-  *out_max = bmax;
-  return true;
-}
+#include "mesh_lod.h"
 
-}  // namespace
+namespace lod_replay_test {
 
-int main() {
+bool run_lod_tests() {
   bool ok = true;
 
   {
@@ -258,6 +62,30 @@ int main() {
                        "revolve tri count Draft < Model < Export3MF");
   }
 
+  {
+    // View levels coarsen with depth, key per level, and only replay past the
+    // hysteresis band.
+    const uint8_t near_level = vicad::LodViewLevelForDepth(10.0, 45.0, 1000);
+    const uint8_t far_level = vicad::LodViewLevelForDepth(10000.0, 45.0, 1000);
+    ok = ok && require(near_level <= far_level, "view level grows with depth");
+    ok = ok && require(far_level <= vicad::kLodViewMaxLevel, "view level is clamped");
+
+    vicad::ReplayLodPolicy coarse;
+    coarse.profile = vicad::LodProfile::View;
+    coarse.viewLevel = 6;
+    vicad::ReplayLodPolicy fine = coarse;
+    fine.viewLevel = 0;
+    ok = ok && require(vicad::LodKeyForPolicy(coarse) != vicad::LodKeyForPolicy(fine),
+                       "view levels have distinct cache keys");
+    ok = ok && require(vicad::AutoCircularSegments(20.0, coarse) <
+                           vicad::AutoCircularSegments(20.0, fine),
+                       "coarse view level uses fewer segments");
+    ok = ok && require(!vicad::LodViewLevelNeedsReplay(4, 5) &&
+                           vicad::LodViewLevelNeedsReplay(4, 6) &&
+                           vicad::LodViewLevelNeedsReplay(4, 2),
+                       "view replay hysteresis");
+  }
+
   {
     // Any encoded segment field is ignored; profile-driven auto LOD is canonical.
     std::vector<uint8_t> rec;
@@ -433,6 +261,43 @@ int main() {
                        "cross plane metadata propagated");
   }
 
+  {
+    // Render levels of a dense sphere get coarser level by level, and the
+    // level picked by screen size only changes past the hysteresis margin.
+    const manifold::Manifold sphere = manifold::Manifold::Sphere(10.0, 128);
+    const vicad::MeshLodChain chain = vicad::BuildMeshLodChain(sphere);
+    ok = ok && require(!chain.levels.empty(), "dense sphere gets render levels");
+    size_t prev = sphere.NumTri();
+    for (const vicad::MeshLodLevel &level : chain.levels) {
+      ok = ok && require(level.derived.triCount == level.mesh.NumTri() && level.mesh.NumTri() < prev,
+                         "each render level is coarser than the last");
+      prev = level.mesh.NumTri();
+    }
+    const int coarsest = (int)chain.levels.size();
+    ok = ok && require(vicad::SelectMeshLod(chain, 1e4f, coarsest) == 0 &&
+                           vicad::SelectMeshLod(chain, 1.0f, 0) == coarsest,
+                       "large objects draw in full, tiny ones at the coarsest level");
+    ok = ok && require(vicad::SelectMeshLod(chain, 340.0f, 0) == 0 && vicad::SelectMeshLod(chain, 380.0f, 1) == 1,
+                       "level switches wait for the hysteresis margin");
+    ok = ok && require(vicad::BuildMeshLodChain(manifold::Manifold::Cube(manifold::vec3(1.0))).levels.empty(),
+                       "small meshes get no render levels");
+  }
+
+  return ok;
+}
+
+}  // namespace lod_replay_test
+
+int main() {
+  bool ok = true;
+  ok = lod_replay_test::run_lod_tests() && ok;
+  ok = lod_replay_test::run_stream_tests() && ok;
+  ok = lod_replay_test::run_fusion_tests() && ok;
+  ok = lod_replay_test::run_mesh_tests() && ok;
+  ok = lod_replay_test::run_topology_tests() && ok;
+  ok = lod_replay_test::run_face_tests() && ok;
+  ok = lod_replay_test::run_file_watch_tests() && ok;
+  ok = lod_replay_test::run_threemf_tests() && ok;
   if (!ok) return 1;
   std::cout << "[lod_replay_test] PASS\n";
   return 0;
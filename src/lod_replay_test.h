@@ -0,0 +1,283 @@
+#ifndef VICAD_LOD_REPLAY_TEST_H_
+#define VICAD_LOD_REPLAY_TEST_H_
+
+// Record builders and checks shared by the lod_replay_test sources. Each
+// source holds one group of cases behind a run_*_tests() entry point that
+// main() in lod_replay_test.cpp calls.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "manifold/manifold.h"
+#include "ipc_protocol.h"
+#include "lod_policy.h"
+#include "op_decoder.h"
+#include "replay_stream.h"
+
+namespace lod_replay_test {
+
+template <typename T>
+inline void append_pod(std::vector<uint8_t>* out, const T& v) {
+  const size_t at = out->size();
+  out->resize(at + sizeof(T));
+  std::memcpy(out->data() + at, &v, sizeof(T));
+}
+
+inline void append_record(std::vector<uint8_t>* out, vicad::OpCode opcode,
+                   const std::vector<uint8_t>& payload, uint64_t digest = 0, uint16_t flags = 0) {
+  vicad::OpRecordHeader hdr = {};
+  hdr.opcode = (uint16_t)opcode;
+  hdr.flags = flags;
+  hdr.payload_len = (uint32_t)payload.size();
+  hdr.digest = digest;
+  append_pod(out, hdr);
+  out->insert(out->end(), payload.begin(), payload.end());
+}
+
+inline std::vector<uint8_t> payload_sphere(uint32_t out_id, double radius,
+                                    uint32_t segments) {
+  std::vector<uint8_t> out;
+  append_pod(&out, out_id);
+  append_pod(&out, radius);
+  append_pod(&out, segments);
+  return out;
+}
+
+inline std::vector<uint8_t> payload_cylinder(uint32_t out_id, double h, double r1,
+                                      double r2, uint32_t segments,
+                                      uint32_t center) {
+  std::vector<uint8_t> out;
+  append_pod(&out, out_id);
+  append_pod(&out, h);
+  append_pod(&out, r1);
+  append_pod(&out, r2);
+  append_pod(&out, segments);
+  append_pod(&out, center);
+  return out;
+}
+
+inline std::vector<uint8_t> payload_union(uint32_t out_id, const std::vector<uint32_t>& ids) {
+  std::vector<uint8_t> out;
+  append_pod(&out, out_id);
+  append_pod(&out, (uint32_t)ids.size());
+  for (uint32_t id : ids) append_pod(&out, id);
+  return out;
+}
+
+inline std::vector<uint8_t> payload_boolean(uint32_t out_id, uint32_t a, uint32_t b) {
+  std::vector<uint8_t> out;
+  append_pod(&out, out_id);
+  append_pod(&out, a);
+  append_pod(&out, b);
+  return out;
+}
+
+inline std::vector<uint8_t> payload_transform(uint32_t out_id, uint32_t in_id, double x, double y, double z) {
+  std::vector<uint8_t> out;
+  append_pod(&out, out_id);
+  append_pod(&out, in_id);
+  append_pod(&out, x);
+  append_pod(&out, y);
+  append_pod(&out, z);
+  return out;
+}
+
+inline std::vector<uint8_t> payload_keep(uint32_t out_id, uint32_t base_id) {
+  std::vector<uint8_t> out;
+  append_pod(&out, out_id);
+  append_pod(&out, base_id);
+  return out;
+}
+
+inline std::vector<uint8_t> payload_cube(uint32_t out_id, double x, double y, double z,
+                                  uint32_t center) {
+  std::vector<uint8_t> out;
+  append_pod(&out, out_id);
+  append_pod(&out, x);
+  append_pod(&out, y);
+  append_pod(&out, z);
+  append_pod(&out, center);
+  return out;
+}
+
+inline std::vector<uint8_t> payload_cross_circle(uint32_t out_id, double radius,
+                                          uint32_t segments) {
+  std::vector<uint8_t> out;
+  append_pod(&out, out_id);
+  append_pod(&out, radius);
+  append_pod(&out, segments);
+  return out;
+}
+
+inline std::vector<uint8_t> payload_revolve(uint32_t out_id, uint32_t cs_id,
+                                     uint32_t segments, double degrees) {
+  std::vector<uint8_t> out;
+  append_pod(&out, out_id);
+  append_pod(&out, cs_id);
+  append_pod(&out, segments);
+  append_pod(&out, degrees);
+  return out;
+}
+
+inline std::vector<uint8_t> payload_cross_square(uint32_t out_id, double w, double h,
+                                          uint32_t center) {
+  std::vector<uint8_t> out;
+  append_pod(&out, out_id);
+  append_pod(&out, w);
+  append_pod(&out, h);
+  append_pod(&out, center);
+  return out;
+}
+
+inline std::vector<uint8_t> payload_cross_polygons(uint32_t out_id,
+                                            const std::vector<std::vector<manifold::vec2>> &rings) {
+  std::vector<uint8_t> out;
+  append_pod(&out, out_id);
+  append_pod(&out, (uint32_t)rings.size());
+  for (const std::vector<manifold::vec2> &ring : rings) {
+    append_pod(&out, (uint32_t)ring.size());
+    for (const manifold::vec2 &p : ring) {
+      append_pod(&out, (double)p.x);
+      append_pod(&out, (double)p.y);
+    }
+  }
+  return out;
+}
+
+inline std::vector<uint8_t> payload_cross_fillet(uint32_t out_id, uint32_t in_id,
+                                          double radius) {
+  std::vector<uint8_t> out;
+  append_pod(&out, out_id);
+  append_pod(&out, in_id);
+  append_pod(&out, radius);
+  return out;
+}
+
+inline std::vector<uint8_t> payload_cross_fillet_corners(
+    uint32_t out_id, uint32_t in_id,
+    const std::vector<std::tuple<uint32_t, uint32_t, double>> &corners) {
+  std::vector<uint8_t> out;
+  append_pod(&out, out_id);
+  append_pod(&out, in_id);
+  const uint32_t count = (uint32_t)corners.size();
+  append_pod(&out, count);
+  for (const auto &corner : corners) {
+    append_pod(&out, std::get<0>(corner));
+    append_pod(&out, std::get<1>(corner));
+    append_pod(&out, std::get<2>(corner));
+  }
+  return out;
+}
+
+inline std::vector<uint8_t> payload_cross_offset_clone(uint32_t out_id, uint32_t in_id,
+                                                double delta) {
+  std::vector<uint8_t> out;
+  append_pod(&out, out_id);
+  append_pod(&out, in_id);
+  append_pod(&out, delta);
+  return out;
+}
+
+inline std::vector<uint8_t> payload_cross_plane(uint32_t out_id, uint32_t in_id,
+                                         uint32_t kind, double offset) {
+  std::vector<uint8_t> out;
+  append_pod(&out, out_id);
+  append_pod(&out, in_id);
+  append_pod(&out, kind);
+  append_pod(&out, offset);
+  return out;
+}
+
+inline std::vector<uint8_t> payload_cross_translate(uint32_t out_id, uint32_t in_id,
+                                             double x, double y) {
+  std::vector<uint8_t> out;
+  append_pod(&out, out_id);
+  append_pod(&out, in_id);
+  append_pod(&out, x);
+  append_pod(&out, y);
+  return out;
+}
+
+inline std::vector<uint8_t> payload_extrude(uint32_t out_id, uint32_t cs_id, double h,
+                                     uint32_t divisions, double twist) {
+  std::vector<uint8_t> out;
+  append_pod(&out, out_id);
+  append_pod(&out, cs_id);
+  append_pod(&out, h);
+  append_pod(&out, divisions);
+  append_pod(&out, twist);
+  return out;
+}
+
+inline bool replay_to_mesh(const std::vector<uint8_t>& records, uint32_t op_count,
+                    uint32_t root_id, vicad::LodProfile profile,
+                    manifold::MeshGL* out_mesh, std::string* out_err) {
+  vicad::ReplayInput in = {};
+  in.records = records.data();
+  in.records_size = records.size();
+  in.op_count = op_count;
+  in.root_kind = (uint32_t)vicad::NodeKind::Manifold;
+  in.root_id = root_id;
+  in.lod_policy.profile = profile;
+  return vicad::ReplayOpsToMesh(in, out_mesh, out_err);
+}
+
+inline bool require(bool cond, const char* msg) {
+  if (cond) return true;
+  std::cerr << "[lod_replay_test] FAIL: " << msg << "\n";
+  return false;
+}
+
+inline bool mesh_bounds(const manifold::MeshGL &mesh, manifold::vec3 *out_min, manifold::vec3 *out_max) {
+  if (!out_min || !out_max) return false;
+  if (mesh.numProp < 3 || mesh.vertProperties.empty()) return false;
+  const size_t count = mesh.vertProperties.size() / mesh.numProp;
+  if (count == 0) return false;
+  manifold::vec3 bmin(1e30, 1e30, 1e30);
+  manifold::vec3 bmax(-1e30, -1e30, -1e30);
+  for (size_t i = 0; i < count; ++i) {
+    const size_t at = i * mesh.numProp;
+    const double x = mesh.vertProperties[at + 0];
+    const double y = mesh.vertProperties[at + 1];
+    const double z = mesh.vertProperties[at + 2];
+    bmin.x = std::min(bmin.x, x);
+    bmin.y = std::min(bmin.y, y);
+    bmin.z = std::min(bmin.z, z);
+    bmax.x = std::max(bmax.x, x);
+    bmax.y = std::max(bmax.y, y);
+    bmax.z = std::max(bmax.z, z);
+  }
+  *out_min = bmin;
+  *out_max = bmax;
+  return true;
+}
+
+// LOD profiles, view levels, sketch planes and render levels
+// (lod_replay_test.cpp).
+bool run_lod_tests();
+// Streamed feeds, semantic arena, replay cache, parallel and delta replay,
+// low-memory replay and shared op traces (lod_replay_stream_test.cpp).
+bool run_stream_tests();
+// Transform and boolean chain fusion and UnionByBounds
+// (lod_replay_fusion_test.cpp).
+bool run_fusion_tests();
+// BVH ray casts and provenance face typing (lod_replay_mesh_test.cpp).
+bool run_mesh_tests();
+// Mesh topology and edge tables against a std::sort reference build
+// (lod_replay_topology_test.cpp).
+bool run_topology_tests();
+// Parallel face detection against its serial path (lod_replay_face_test.cpp).
+bool run_face_tests();
+// FileChangeNotifier against real file saves (lod_replay_file_watch_test.cpp).
+bool run_file_watch_tests();
+// 3MF packages read back against their source meshes (lod_replay_threemf_test.cpp).
+bool run_threemf_tests();
+
+}  // namespace lod_replay_test
+
+#endif  // VICAD_LOD_REPLAY_TEST_H_
@@ -0,0 +1,129 @@
+#include "lod_replay_test.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+
+#include "threemf_writer.h"
+
+namespace lod_replay_test {
+
+namespace {
+
+uint32_t read_u32(const std::string &zip, size_t at) {
+  uint32_t v = 0;
+  std::memcpy(&v, zip.data() + at, sizeof(v));
+  return v;
+}
+
+uint16_t read_u16(const std::string &zip, size_t at) {
+  uint16_t v = 0;
+  std::memcpy(&v, zip.data() + at, sizeof(v));
+  return v;
+}
+
+// Bitwise CRC-32, independent of the writer's table.
+uint32_t crc32_of(const std::string &data) {
+  uint32_t crc = 0xFFFFFFFFu;
+  for (unsigned char c : data) {
+    crc ^= c;
+    for (int k = 0; k < 8; ++k) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+  }
+  return ~crc;
+}
+
+// Reads a zip of stored entries through its central directory, checking each
+// local header and CRC. Returns false on anything malformed.
+bool read_stored_zip(const std::string &path, std::map<std::string, std::string> *parts) {
+  std::ifstream in(path, std::ios::binary);
+  const std::string zip((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (zip.size() < 22 || read_u32(zip, zip.size() - 22) != 0x06054b50u) return false;
+  const uint16_t count = read_u16(zip, zip.size() - 12);
+  size_t at = read_u32(zip, zip.size() - 6);
+  for (uint16_t i = 0; i < count; ++i) {
+    if (at + 46 > zip.size() || read_u32(zip, at) != 0x02014b50u || read_u16(zip, at + 10) != 0) return false;
+    const uint32_t crc = read_u32(zip, at + 16);
+    const uint32_t size = read_u32(zip, at + 20);
+    const uint16_t name_len = read_u16(zip, at + 28);
+    const size_t header = read_u32(zip, at + 42);
+    const std::string name = zip.substr(at + 46, name_len);
+    at += 46 + name_len + read_u16(zip, at + 30) + read_u16(zip, at + 32);
+    if (header + 30 > zip.size() || read_u32(zip, header) != 0x04034b50u || read_u32(zip, header + 14) != crc ||
+        read_u32(zip, header + 22) != size || zip.compare(header + 30, name_len, name) != 0) {
+      return false;
+    }
+    const size_t data = header + 30 + name_len + read_u16(zip, header + 28);
+    if (data + size > zip.size()) return false;
+    std::string body = zip.substr(data, size);
+    if (crc32_of(body) != crc) return false;
+    (*parts)[name] = std::move(body);
+  }
+  return true;
+}
+
+size_t count_of(const std::string &text, const char *needle, size_t from = 0, size_t to = std::string::npos) {
+  size_t n = 0;
+  const size_t len = std::strlen(needle);
+  for (size_t at = text.find(needle, from); at != std::string::npos && at < to; at = text.find(needle, at + len)) {
+    ++n;
+  }
+  return n;
+}
+
+}  // namespace
+
+bool run_threemf_tests() {
+  bool ok = true;
+
+  {
+    // A written package reads back as a zip with the three required parts,
+    // valid CRCs across the model part's flushes, and one object per
+    // non-empty mesh with the source's vertex and triangle counts.
+    const std::string dir = "build/test_threemf";
+    const std::string path = dir + "/roundtrip.3mf";
+    std::filesystem::create_directories(dir);
+    const std::vector<std::pair<std::string, manifold::MeshGL>> sources = {
+        {"Box & lid", manifold::Manifold::Cube(manifold::vec3(2.0, 3.0, 4.0)).GetMeshGL()},
+        {"Empty", manifold::MeshGL()},
+        {"Ball", manifold::Manifold::Sphere(5.0, 256).GetMeshGL()},
+    };
+    vicad::ThreeMfWriter writer;
+    std::string err;
+    bool written = writer.Open(path, &err);
+    for (const auto &source : sources) written = written && writer.WriteObject(source.first, source.second, &err);
+    written = written && writer.Finish(&err);
+    ok = ok && require(written && writer.object_count() == 2, "3mf package writes, skipping the empty mesh");
+
+    std::map<std::string, std::string> parts;
+    ok = ok && require(read_stored_zip(path, &parts), "3mf package reads back as a zip with valid CRCs");
+    ok = ok && require(parts.size() == 3 && parts.count("[Content_Types].xml") && parts.count("_rels/.rels") &&
+                           parts.count("3D/3dmodel.model"),
+                       "3mf package has the content types, relationships and model parts");
+    const std::string &model = parts["3D/3dmodel.model"];
+    ok = ok && require(parts["_rels/.rels"].find("Target=\"/3D/3dmodel.model\"") != std::string::npos,
+                       "3mf relationships point at the model part");
+    ok = ok && require(model.size() > ((size_t)1 << 20), "3mf model part spans several flushes");
+    ok = ok && require(count_of(model, "<object ") == 2 && count_of(model, "<item objectid=") == 2 &&
+                           model.find("name=\"Box &amp; lid\"") != std::string::npos,
+                       "3mf model has one escaped, built object per mesh");
+
+    size_t from = 0;
+    for (const auto &source : sources) {
+      if (source.second.NumTri() == 0) continue;
+      const size_t begin = model.find("<object ", from);
+      const size_t end = model.find("</object>", begin);
+      ok = ok && require(begin != std::string::npos && end != std::string::npos, "3mf object is complete");
+      if (!ok) break;
+      ok = ok && require(count_of(model, "<vertex ", begin, end) == source.second.NumVert() &&
+                             count_of(model, "<triangle ", begin, end) == source.second.NumTri(),
+                         "3mf object keeps the source's vertex and triangle counts");
+      from = end;
+    }
+    std::filesystem::remove_all(dir);
+  }
+
+  return ok;
+}
+
+}  // namespace lod_replay_test
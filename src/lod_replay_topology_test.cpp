@@ -0,0 +1,189 @@
+#include "lod_replay_test.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "edge_detection.h"
+#include "mesh_topology.h"
+
+namespace lod_replay_test {
+
+namespace {
+
+// Edge and adjacency tables built the obvious way (std::sort over every
+// side), to check BuildMeshTopology's radix-sorted, parallel build against.
+struct ReferenceTopology {
+  std::vector<uint64_t> edgeKey;
+  std::vector<uint32_t> edgeOffset;
+  std::vector<uint32_t> edgeSides;
+  std::vector<uint32_t> triOffset;
+  std::vector<uint32_t> triNeighbors;
+};
+
+ReferenceTopology build_reference(const manifold::MeshGL &mesh, const std::vector<uint32_t> &welded) {
+  const uint32_t triCount = (uint32_t)mesh.NumTri();
+  std::vector<std::pair<uint64_t, uint32_t>> sides;
+  for (uint32_t tri = 0; tri < triCount; ++tri) {
+    for (uint32_t corner = 0; corner < 3; ++corner) {
+      uint32_t a = welded[mesh.triVerts[tri * 3 + corner]];
+      uint32_t b = welded[mesh.triVerts[tri * 3 + (corner + 1) % 3]];
+      if (a == b) continue;
+      if (a > b) std::swap(a, b);
+      sides.push_back({((uint64_t)a << 32) | b, tri * 3 + corner});
+    }
+  }
+  std::sort(sides.begin(), sides.end());
+
+  ReferenceTopology ref;
+  ref.edgeOffset.push_back(0);
+  std::vector<std::vector<uint32_t>> neighbors(triCount);
+  for (size_t i = 0; i < sides.size();) {
+    size_t j = i;
+    while (j < sides.size() && sides[j].first == sides[i].first) ++j;
+    ref.edgeKey.push_back(sides[i].first);
+    for (size_t k = i; k < j; ++k) {
+      ref.edgeSides.push_back(sides[k].second);
+      for (size_t m = i; m < j; ++m) {
+        const uint32_t a = sides[k].second / 3;
+        const uint32_t b = sides[m].second / 3;
+        if (a != b) neighbors[a].push_back(b);
+      }
+    }
+    ref.edgeOffset.push_back((uint32_t)ref.edgeSides.size());
+    i = j;
+  }
+  ref.triOffset.push_back(0);
+  for (std::vector<uint32_t> &n : neighbors) {
+    std::sort(n.begin(), n.end());
+    n.erase(std::unique(n.begin(), n.end()), n.end());
+    ref.triNeighbors.insert(ref.triNeighbors.end(), n.begin(), n.end());
+    ref.triOffset.push_back((uint32_t)ref.triNeighbors.size());
+  }
+  return ref;
+}
+
+// Welded ids must group exactly the vertices the merge vectors join.
+bool welds_match_merges(const manifold::MeshGL &mesh, const std::vector<uint32_t> &welded) {
+  const uint32_t numVerts = (uint32_t)mesh.NumVert();
+  if (welded.size() != numVerts) return false;
+  std::vector<uint32_t> group(numVerts);
+  for (uint32_t v = 0; v < numVerts; ++v) group[v] = v;
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t i = 0; i < mesh.mergeFromVert.size(); ++i) {
+      uint32_t &a = group[mesh.mergeFromVert[i]];
+      uint32_t &b = group[mesh.mergeToVert[i]];
+      if (a == b) continue;
+      a = b = std::min(a, b);
+      changed = true;
+    }
+  }
+  std::unordered_map<uint32_t, uint32_t> welded_of_group;
+  std::unordered_map<uint32_t, uint32_t> group_of_welded;
+  for (uint32_t v = 0; v < numVerts; ++v) {
+    if (welded_of_group.emplace(group[v], welded[v]).first->second != welded[v]) return false;
+    if (group_of_welded.emplace(welded[v], group[v]).first->second != group[v]) return false;
+  }
+  return true;
+}
+
+bool topology_matches_reference(const manifold::MeshGL &mesh) {
+  const vicad::MeshTopology topo = vicad::BuildMeshTopology(mesh);
+  if (!welds_match_merges(mesh, topo.weldedVert)) return false;
+  const ReferenceTopology ref = build_reference(mesh, topo.weldedVert);
+  return topo.edgeKey == ref.edgeKey && topo.edgeOffset == ref.edgeOffset && topo.edgeSides == ref.edgeSides &&
+         topo.triOffset == ref.triOffset && topo.triNeighbors == ref.triNeighbors;
+}
+
+void add_vert(manifold::MeshGL *mesh, double x, double y, double z) {
+  mesh->vertProperties.push_back((float)x);
+  mesh->vertProperties.push_back((float)y);
+  mesh->vertProperties.push_back((float)z);
+}
+
+// Gives every triangle corner its own vertex, merged back onto the original,
+// so every edge of the mesh is a property seam.
+manifold::MeshGL split_corners(const manifold::MeshGL &in) {
+  manifold::MeshGL out;
+  out.numProp = 3;
+  const uint32_t numVerts = (uint32_t)in.NumVert();
+  for (uint32_t v = 0; v < numVerts; ++v) {
+    const size_t at = (size_t)v * in.numProp;
+    add_vert(&out, in.vertProperties[at], in.vertProperties[at + 1], in.vertProperties[at + 2]);
+  }
+  for (size_t i = 0; i < in.triVerts.size(); ++i) {
+    const uint32_t v = in.triVerts[i];
+    const size_t at = (size_t)v * in.numProp;
+    add_vert(&out, in.vertProperties[at], in.vertProperties[at + 1], in.vertProperties[at + 2]);
+    out.triVerts.push_back(numVerts + (uint32_t)i);
+    out.mergeFromVert.push_back(numVerts + (uint32_t)i);
+    out.mergeToVert.push_back(v);
+  }
+  return out;
+}
+
+}  // namespace
+
+bool run_topology_tests() {
+  bool ok = true;
+
+  {
+    // A small mesh with a seam, a degenerate sliver, a collapsed triangle and
+    // an edge shared by three triangles builds the same tables as the
+    // reference, and edge detection flags the non-manifold and open edges.
+    manifold::MeshGL mesh;
+    mesh.numProp = 3;
+    add_vert(&mesh, 0, 0, 0);  // 0
+    add_vert(&mesh, 1, 0, 0);  // 1
+    add_vert(&mesh, 0, 1, 0);  // 2
+    add_vert(&mesh, 1, 1, 0);  // 3
+    add_vert(&mesh, 0, 0, 1);  // 4
+    add_vert(&mesh, 0, 0, -1);  // 5
+    add_vert(&mesh, 1, 0, 0);  // 6: seam copy of 1
+    add_vert(&mesh, 2, 0, 0);  // 7: collinear with 0 and 1
+    mesh.triVerts = {
+        0, 1, 2,  // fan around edge 0-1 ...
+        1, 0, 4,  // ... second triangle on it
+        0, 6, 5,  // ... third, through the seam copy: non-manifold
+        6, 3, 2,  // shares 1-2 with the first through the seam
+        0, 1, 7,  // zero-area sliver
+        2, 2, 3,  // two corners on one vertex
+    };
+    mesh.mergeFromVert = {6};
+    mesh.mergeToVert = {1};
+    mesh.faceID.assign(mesh.NumTri(), 0);
+    ok = ok && require(topology_matches_reference(mesh), "topology of seams, degenerates and non-manifold edges");
+
+    const vicad::MeshTopology topo = vicad::BuildMeshTopology(mesh);
+    const vicad::EdgeDetectionResult edges = vicad::BuildEdgeTopology(mesh, topo);
+    const ReferenceTopology ref = build_reference(mesh, topo.weldedVert);
+    size_t ref_open = 0;
+    size_t ref_non_manifold = 0;
+    for (size_t e = 0; e + 1 < ref.edgeOffset.size(); ++e) {
+      std::vector<uint32_t> tris;
+      for (uint32_t i = ref.edgeOffset[e]; i < ref.edgeOffset[e + 1]; ++i) tris.push_back(ref.edgeSides[i] / 3);
+      tris.erase(std::unique(tris.begin(), tris.end()), tris.end());
+      if (tris.size() == 1) ref_open++;
+      if (tris.size() > 2) ref_non_manifold++;
+    }
+    ok = ok && require(ref_non_manifold > 0 && edges.nonManifoldEdgeIndices.size() == ref_non_manifold,
+                       "edge detection flags every non-manifold edge");
+    ok = ok && require(edges.featureEdgeIndices.size() == ref_open, "edge detection flags every open edge");
+  }
+
+  {
+    // A sphere large enough for the parallel build, with every edge a seam,
+    // matches the reference; so does the welded original.
+    const manifold::MeshGL sphere = manifold::Manifold::Sphere(10.0, 256).GetMeshGL();
+    ok = ok && require(sphere.NumTri() > ((size_t)1 << 14), "seamed sphere is above the parallel threshold");
+    ok = ok && require(topology_matches_reference(sphere), "topology of a dense sphere");
+    ok = ok && require(topology_matches_reference(split_corners(sphere)), "topology of a fully seamed sphere");
+  }
+
+  return ok;
+}
+
+}  // namespace lod_replay_test
@@ -0,0 +1,262 @@
+#include "log.h"
+
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "json_escape.h"
+
+namespace vicad {
+
+namespace {
+
+void write_fd(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    const ssize_t n = ::write(fd, data, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return;
+    data += n;
+    len -= (size_t)n;
+  }
+}
+
+// Bounded multi-producer ring (Vyukov): a slot is free for position `pos` when
+// its sequence equals pos, and holds a record for the flusher at pos + 1.
+class AsyncLog {
+ public:
+  static constexpr size_t kSlots = 1024;
+  static constexpr size_t kSlotBytes = 496;
+  static constexpr size_t kChunkBytes = 64 * 1024;
+
+  AsyncLog() {
+    for (size_t i = 0; i < kSlots; ++i) slots_[i].seq.store(i, std::memory_order_relaxed);
+    thread_ = std::thread(&AsyncLog::Run, this);
+  }
+
+  // Queues `len` bytes; false when they do not fit a slot or the ring is full.
+  bool TryPush(const char *data, size_t len) {
+    if (len > kSlotBytes) return false;
+    uint64_t pos = head_.load(std::memory_order_relaxed);
+    Slot *slot = nullptr;
+    for (;;) {
+      slot = &slots_[pos % kSlots];
+      const uint64_t seq = slot->seq.load(std::memory_order_acquire);
+      const int64_t diff = (int64_t)seq - (int64_t)pos;
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+    std::memcpy(slot->text, data, len);
+    slot->len = (uint32_t)len;
+    slot->seq.store(pos + 1, std::memory_order_release);
+    // Pairs with the fences in Run: either the flusher sees this record before
+    // it sleeps or stops, or this thread sees it idle or stopped.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (stopped_.load(std::memory_order_relaxed)) {
+      DrainDirect();
+    } else if (idle_.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      wake_.notify_one();
+    }
+    return true;
+  }
+
+  // Returns once every record queued before the call has been written.
+  void Flush() {
+    const uint64_t target = head_.load(std::memory_order_acquire);
+    std::unique_lock<std::mutex> lock(mutex_);
+    flushed_.wait(lock, [&] { return written_ >= target || stopped_.load(std::memory_order_relaxed); });
+  }
+
+  // Drains the ring and stops the flusher; later records go out directly.
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stop_) return;
+      stop_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+  }
+
+  // Writes whatever is queued from a crashing thread. The flusher may be the
+  // one that crashed, so its drain lock is only waited on briefly.
+  void DrainFatal() {
+    const struct timespec pause = {0, 100 * 1000};
+    for (int i = 0; i < 1000 && draining_.test_and_set(std::memory_order_acquire); ++i) nanosleep(&pause, nullptr);
+    DrainSlots();
+    draining_.clear(std::memory_order_release);
+  }
+
+  bool stopped() const { return stopped_.load(std::memory_order_acquire); }
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> seq{0};
+    uint32_t len = 0;
+    char text[kSlotBytes];
+  };
+
+  bool Pending() const { return slots_[tail_ % kSlots].seq.load(std::memory_order_acquire) == tail_ + 1; }
+
+  // Moves the published records from the tail on into `chunk`.
+  size_t Drain(char *chunk) {
+    size_t used = 0;
+    for (;;) {
+      Slot &slot = slots_[tail_ % kSlots];
+      if (slot.seq.load(std::memory_order_acquire) != tail_ + 1) break;
+      if (used + slot.len > kChunkBytes) break;
+      std::memcpy(chunk + used, slot.text, slot.len);
+      used += slot.len;
+      slot.seq.store(tail_ + kSlots, std::memory_order_release);
+      tail_++;
+    }
+    return used;
+  }
+
+  // Writes published records one by one, without a chunk buffer, so it is safe
+  // from a signal handler. The caller holds `draining_`.
+  void DrainSlots() {
+    while (Pending()) {
+      Slot &slot = slots_[tail_ % kSlots];
+      write_fd(STDERR_FILENO, slot.text, slot.len);
+      slot.seq.store(tail_ + kSlots, std::memory_order_release);
+      tail_++;
+    }
+  }
+
+  // Used once the flusher stopped: a record published after its last drain is
+  // written by whichever thread published it.
+  void DrainDirect() {
+    while (draining_.test_and_set(std::memory_order_acquire)) std::this_thread::yield();
+    DrainSlots();
+    draining_.clear(std::memory_order_release);
+  }
+
+  void Run() {
+    std::vector<char> chunk(kChunkBytes);
+    for (;;) {
+      while (draining_.test_and_set(std::memory_order_acquire)) std::this_thread::yield();
+      const size_t used = Drain(chunk.data());
+      if (used > 0) write_fd(STDERR_FILENO, chunk.data(), used);
+      const uint64_t done = tail_;
+      draining_.clear(std::memory_order_release);
+      std::unique_lock<std::mutex> lock(mutex_);
+      written_ = done;
+      flushed_.notify_all();
+      if (used > 0) continue;
+      if (stop_) break;
+      idle_.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      wake_.wait(lock, [&] { return stop_ || Pending(); });
+      idle_.store(false, std::memory_order_relaxed);
+    }
+    stopped_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    DrainDirect();
+    std::lock_guard<std::mutex> lock(mutex_);
+    written_ = tail_;
+    flushed_.notify_all();
+  }
+
+  Slot slots_[kSlots];
+  std::atomic<uint64_t> head_{0};
+  uint64_t tail_ = 0;  // advanced only under `draining_`
+  std::atomic_flag draining_ = ATOMIC_FLAG_INIT;
+  std::atomic<bool> idle_{false};
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable flushed_;
+  uint64_t written_ = 0;
+  bool stop_ = false;
+  std::atomic<bool> stopped_{false};
+  std::thread thread_;
+};
+
+AsyncLog *g_log = nullptr;
+
+constexpr int kFatalSignals[] = {SIGABRT, SIGSEGV, SIGBUS, SIGILL, SIGFPE};
+struct sigaction g_prev_actions[sizeof(kFatalSignals) / sizeof(kFatalSignals[0])];
+std::terminate_handler g_prev_terminate = nullptr;
+
+// Writes out the queue, then lets the previous handler (default, or e.g. a
+// sanitizer's) take the signal once this one returns.
+void on_fatal_signal(int sig) {
+  if (g_log) g_log->DrainFatal();
+  for (size_t i = 0; i < sizeof(kFatalSignals) / sizeof(kFatalSignals[0]); ++i) {
+    if (kFatalSignals[i] == sig) sigaction(sig, &g_prev_actions[i], nullptr);
+  }
+  raise(sig);
+}
+
+void on_terminate() {
+  if (g_log) g_log->DrainFatal();
+  if (g_prev_terminate) g_prev_terminate();
+  std::abort();
+}
+
+void install_fatal_handlers() {
+  struct sigaction action = {};
+  action.sa_handler = on_fatal_signal;
+  sigemptyset(&action.sa_mask);
+  for (size_t i = 0; i < sizeof(kFatalSignals) / sizeof(kFatalSignals[0]); ++i) {
+    sigaction(kFatalSignals[i], &action, &g_prev_actions[i]);
+  }
+  g_prev_terminate = std::set_terminate(on_terminate);
+}
+
+// Never destroyed: threads may still log during static destruction. The ring
+// is drained at exit instead.
+AsyncLog &async_log() {
+  static AsyncLog *log = [] {
+    AsyncLog *l = new AsyncLog();
+    g_log = l;
+    install_fatal_handlers();
+    std::atexit([] { async_log().Stop(); });
+    return l;
+  }();
+  return *log;
+}
+
+}  // namespace
+
+void log_event(const char *event, uint64_t run_id, const char *details) {
+  thread_local std::string line;
+  line.clear();
+  char prefix[64];
+  line.append("{\"src\":\"vicad\",\"event\":\"");
+  line.append(event);
+  std::snprintf(prefix, sizeof(prefix), "\",\"run_id\":%llu", (unsigned long long)run_id);
+  line.append(prefix);
+  if (details && details[0] != '\0') {
+    line.append(",\"details\":\"");
+    append_json_escaped(&line, details);
+    line.append("\"}\n");
+  } else {
+    line.append("}\n");
+  }
+  AsyncLog &log = async_log();
+  if (!log.stopped() && log.TryPush(line.data(), line.size())) return;
+  log.Flush();
+  write_fd(STDERR_FILENO, line.data(), line.size());
+}
+
+void log_flush() { async_log().Flush(); }
+
+}  // namespace vicad
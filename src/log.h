@@ -2,8 +2,6 @@
 #define VICAD_LOG_H_
 
 #include <cstdint>
-#include <cstdio>
-#include <cstring>
 
 // Emits a single newline-delimited JSON log record to stderr.
 //
@@ -14,6 +12,14 @@
 // The details string is JSON-escaped: backslashes, quotes, and control
 // characters are all safely encoded so the output is always valid JSON.
 //
+// Records are formatted on the calling thread into a reused thread-local
+// buffer and queued in a lock-free ring; a background thread writes them out
+// in large chunks, so logging never blocks on stderr. Records keep their order
+// per thread. One too long for a ring slot, or logged while the ring is full,
+// is written directly after draining the ring. Everything queued is written at
+// exit and, synchronously, on abort, std::terminate and fatal signals;
+// log_flush() forces it out earlier.
+//
 // Agents can query logs with:
 //   ./vicad 2>build/vicad.log
 //   grep '"event":"RUN_DONE"' build/vicad.log | jq .
@@ -25,28 +31,10 @@
 
 namespace vicad {
 
-inline void log_event(const char *event, uint64_t run_id, const char *details = nullptr) {
-  if (details && details[0] != '\0') {
-    // Write prefix
-    std::fprintf(stderr, "{\"src\":\"vicad\",\"event\":\"%s\",\"run_id\":%llu,\"details\":\"",
-                 event, (unsigned long long)run_id);
-    // JSON-escape details character by character
-    for (const char *p = details; *p != '\0'; ++p) {
-      const unsigned char c = (unsigned char)*p;
-      if      (c == '"')  std::fputs("\\\"", stderr);
-      else if (c == '\\') std::fputs("\\\\", stderr);
-      else if (c == '\n') std::fputs("\\n",  stderr);
-      else if (c == '\r') std::fputs("\\r",  stderr);
-      else if (c == '\t') std::fputs("\\t",  stderr);
-      else if (c < 0x20)  std::fprintf(stderr, "\\u%04x", c);
-      else                std::fputc(c, stderr);
-    }
-    std::fputs("\"}\n", stderr);
-  } else {
-    std::fprintf(stderr, "{\"src\":\"vicad\",\"event\":\"%s\",\"run_id\":%llu}\n",
-                 event, (unsigned long long)run_id);
-  }
-}
+void log_event(const char *event, uint64_t run_id, const char *details = nullptr);
+
+// Writes out every record logged so far.
+void log_flush();
 
 }  // namespace vicad
 
@@ -0,0 +1,359 @@
+#include "mesh_bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "trace.h"
+
+namespace vicad {
+
+namespace {
+
+constexpr int kBinCount = 12;
+// Nodes at or below kLeafSize triangles (one batch) are never split; up to
+// kMaxLeafSize they stay leaves when the SAH finds no cheaper split.
+constexpr uint32_t kBatch = 4;
+constexpr uint32_t kLeafSize = kBatch;
+constexpr uint32_t kMaxLeafSize = 16;
+// Bounds the traversal stack. A node this deep becomes a leaf whatever its size.
+constexpr int kMaxDepth = 48;
+// Widens the far slab distance by 2 * gamma(3) so rounding in the box test
+// never culls a triangle lying exactly on a box face (Ize, "Robust BVH Ray
+// Traversal"); axis-aligned CAD faces make zero-thickness boxes common.
+constexpr float kSlabSlack = 1.0f + 4.0f * std::numeric_limits<float>::epsilon();
+
+struct Box {
+  float mn[3];
+  float mx[3];
+};
+
+Box empty_box() {
+  const float inf = std::numeric_limits<float>::infinity();
+  return {{inf, inf, inf}, {-inf, -inf, -inf}};
+}
+
+void grow(Box *b, const float p[3]) {
+  for (int a = 0; a < 3; ++a) {
+    b->mn[a] = std::min(b->mn[a], p[a]);
+    b->mx[a] = std::max(b->mx[a], p[a]);
+  }
+}
+
+void grow(Box *b, const Box &o) {
+  grow(b, o.mn);
+  grow(b, o.mx);
+}
+
+// Half the surface area, which is all the SAH needs.
+float half_area(const Box &b) {
+  const float dx = b.mx[0] - b.mn[0];
+  const float dy = b.mx[1] - b.mn[1];
+  const float dz = b.mx[2] - b.mn[2];
+  if (dx < 0.0f) return 0.0f;
+  return dx * dy + dy * dz + dz * dx;
+}
+
+struct BuildTri {
+  Box box;
+  float center[3];
+};
+
+struct Builder {
+  const std::vector<BuildTri> *prims;
+  MeshBvh *bvh;
+};
+
+int bin_of(float c, float mn, float scale) {
+  const int b = (int)((c - mn) * scale);
+  return std::clamp(b, 0, kBinCount - 1);
+}
+
+void build_node(const Builder &s, uint32_t begin, uint32_t end, int depth) {
+  const std::vector<BuildTri> &prims = *s.prims;
+  std::vector<uint32_t> &tris = s.bvh->tris;
+  const size_t node = s.bvh->nodes.size();
+  s.bvh->nodes.push_back({});
+
+  Box bounds = empty_box();
+  Box centers = empty_box();
+  for (uint32_t i = begin; i < end; ++i) {
+    grow(&bounds, prims[tris[i]].box);
+    grow(&centers, prims[tris[i]].center);
+  }
+  {
+    MeshBvhNode &n = s.bvh->nodes[node];
+    std::copy(bounds.mn, bounds.mn + 3, n.bmin);
+    std::copy(bounds.mx, bounds.mx + 3, n.bmax);
+  }
+  const uint32_t count = end - begin;
+  auto make_leaf = [&]() {
+    s.bvh->nodes[node].offset = begin;
+    s.bvh->nodes[node].count = count;
+  };
+  if (count <= kLeafSize || depth >= kMaxDepth) {
+    make_leaf();
+    return;
+  }
+
+  int best_axis = -1;
+  int best_split = 0;
+  float best_cost = std::numeric_limits<float>::infinity();
+  for (int axis = 0; axis < 3; ++axis) {
+    const float extent = centers.mx[axis] - centers.mn[axis];
+    if (!(extent > 0.0f)) continue;
+    const float scale = (float)kBinCount / extent;
+    Box bin_box[kBinCount];
+    uint32_t bin_count[kBinCount] = {};
+    for (Box &b : bin_box) b = empty_box();
+    for (uint32_t i = begin; i < end; ++i) {
+      const BuildTri &p = prims[tris[i]];
+      const int b = bin_of(p.center[axis], centers.mn[axis], scale);
+      grow(&bin_box[b], p.box);
+      bin_count[b]++;
+    }
+    // right_cost[k]: area times count of bins [k, kBinCount).
+    float right_cost[kBinCount] = {};
+    Box acc = empty_box();
+    uint32_t acc_count = 0;
+    for (int b = kBinCount - 1; b > 0; --b) {
+      grow(&acc, bin_box[b]);
+      acc_count += bin_count[b];
+      right_cost[b] = half_area(acc) * (float)acc_count;
+    }
+    acc = empty_box();
+    acc_count = 0;
+    for (int split = 1; split < kBinCount; ++split) {
+      grow(&acc, bin_box[split - 1]);
+      acc_count += bin_count[split - 1];
+      const float cost = half_area(acc) * (float)acc_count + right_cost[split];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_axis = axis;
+        best_split = split;
+      }
+    }
+  }
+
+  // One traversal step costs about as much as one triangle test.
+  const float leaf_cost = half_area(bounds) * (float)count;
+  if (best_axis >= 0 && half_area(bounds) + best_cost >= leaf_cost && count <= kMaxLeafSize) {
+    make_leaf();
+    return;
+  }
+
+  uint32_t mid = begin + count / 2;
+  if (best_axis >= 0) {
+    const float scale = (float)kBinCount / (centers.mx[best_axis] - centers.mn[best_axis]);
+    const float mn = centers.mn[best_axis];
+    auto it = std::partition(tris.begin() + begin, tris.begin() + end, [&](uint32_t tri) {
+      return bin_of(prims[tri].center[best_axis], mn, scale) < best_split;
+    });
+    const uint32_t at = (uint32_t)(it - tris.begin());
+    if (at > begin && at < end) mid = at;
+  } else if (count <= kMaxLeafSize) {
+    // Every centroid coincides; no split separates them.
+    make_leaf();
+    return;
+  }
+
+  build_node(s, begin, mid, depth + 1);
+  s.bvh->nodes[node].offset = (uint32_t)s.bvh->nodes.size();
+  s.bvh->nodes[node].count = 0;
+  build_node(s, mid, end, depth + 1);
+}
+
+struct Ray {
+  double o[3];
+  double d[3];
+  float of[3];
+  float inv[3];
+};
+
+bool box_hit(const MeshBvhNode &n, const Ray &ray, double limit, float *out_near) {
+  float t0 = 0.0f;
+  float t1 = (float)limit;
+  for (int a = 0; a < 3; ++a) {
+    float ta = (n.bmin[a] - ray.of[a]) * ray.inv[a];
+    float tb = (n.bmax[a] - ray.of[a]) * ray.inv[a];
+    if (ta > tb) std::swap(ta, tb);
+    t0 = ta > t0 ? ta : t0;
+    t1 = tb * kSlabSlack < t1 ? tb * kSlabSlack : t1;
+  }
+  *out_near = t0;
+  return t0 <= t1;
+}
+
+// Moller-Trumbore in double precision over leaf slots [first, first + count),
+// keeping the nearest hit closer than *best_t. With GCC/Clang vector
+// extensions four slots go at once (SSE2 or AVX on x86-64, NEON on arm64);
+// each lane does the same operations as the scalar path, so both pick the
+// same triangle.
+#if defined(__GNUC__) || defined(__clang__)
+typedef float Float4 __attribute__((vector_size(4 * sizeof(float))));
+typedef double Double4 __attribute__((vector_size(4 * sizeof(double))));
+
+void hit_slots(const MeshBvh &bvh, uint32_t first, uint32_t count, const Ray &ray, double *best_t,
+               uint32_t *best_slot) {
+  const double *d = ray.d;
+  for (uint32_t base = first; base < first + count; base += kBatch) {
+    Double4 c[9];
+    for (int k = 0; k < 9; ++k) {
+      Float4 f;
+      std::memcpy(&f, bvh.corner[k].data() + base, sizeof(f));
+      c[k] = __builtin_convertvector(f, Double4);
+    }
+    const Double4 e1[3] = {c[3] - c[0], c[4] - c[1], c[5] - c[2]};
+    const Double4 e2[3] = {c[6] - c[0], c[7] - c[1], c[8] - c[2]};
+    const Double4 p[3] = {d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0]};
+    const Double4 det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    const Double4 inv_det = 1.0 / det;
+    const Double4 tv[3] = {ray.o[0] - c[0], ray.o[1] - c[1], ray.o[2] - c[2]};
+    const Double4 u = (tv[0] * p[0] + tv[1] * p[1] + tv[2] * p[2]) * inv_det;
+    const Double4 q[3] = {tv[1] * e1[2] - tv[2] * e1[1], tv[2] * e1[0] - tv[0] * e1[2],
+                          tv[0] * e1[1] - tv[1] * e1[0]};
+    const Double4 v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv_det;
+    const Double4 t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv_det;
+    // Lane masks: all bits set where the comparison holds.
+    const auto ok = ((det >= 1e-12) | (det <= -1e-12)) & (u >= 0.0) & (u <= 1.0) & (v >= 0.0) & (u + v <= 1.0) &
+                    (t > 1e-9);
+    const uint32_t lanes = std::min(kBatch, first + count - base);
+    for (uint32_t lane = 0; lane < lanes; ++lane) {
+      if (ok[lane] && t[lane] < *best_t) {
+        *best_t = t[lane];
+        *best_slot = base + lane;
+      }
+    }
+  }
+}
+#else
+void hit_slots(const MeshBvh &bvh, uint32_t first, uint32_t count, const Ray &ray, double *best_t,
+               uint32_t *best_slot) {
+  const double *d = ray.d;
+  for (uint32_t i = first; i < first + count; ++i) {
+    double p0[3], e1[3], e2[3];
+    for (int a = 0; a < 3; ++a) {
+      p0[a] = (double)bvh.corner[a][i];
+      e1[a] = (double)bvh.corner[3 + a][i] - p0[a];
+      e2[a] = (double)bvh.corner[6 + a][i] - p0[a];
+    }
+    const double p[3] = {d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0]};
+    const double det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    if (std::fabs(det) < 1e-12) continue;
+    const double inv_det = 1.0 / det;
+    const double tv[3] = {ray.o[0] - p0[0], ray.o[1] - p0[1], ray.o[2] - p0[2]};
+    const double u = (tv[0] * p[0] + tv[1] * p[1] + tv[2] * p[2]) * inv_det;
+    if (u < 0.0 || u > 1.0) continue;
+    const double q[3] = {tv[1] * e1[2] - tv[2] * e1[1], tv[2] * e1[0] - tv[0] * e1[2], tv[0] * e1[1] - tv[1] * e1[0]};
+    const double v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv_det;
+    if (v < 0.0 || u + v > 1.0) continue;
+    const double t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv_det;
+    if (t > 1e-9 && t < *best_t) {
+      *best_t = t;
+      *best_slot = i;
+    }
+  }
+}
+#endif
+
+}  // namespace
+
+MeshBvh BuildMeshBvh(const manifold::MeshGL &mesh) {
+  TraceSpan span("analysis", "bvh");
+  MeshBvh bvh;
+  const uint32_t tri_count = (uint32_t)mesh.NumTri();
+  bvh.triCount = tri_count;
+  if (tri_count == 0 || mesh.numProp < 3) return bvh;
+
+  std::vector<BuildTri> prims(tri_count);
+  for (uint32_t tri = 0; tri < tri_count; ++tri) {
+    BuildTri &p = prims[tri];
+    p.box = empty_box();
+    for (int c = 0; c < 3; ++c) {
+      const size_t v = mesh.triVerts[(size_t)tri * 3 + (size_t)c];
+      grow(&p.box, &mesh.vertProperties[v * mesh.numProp]);
+    }
+    for (int a = 0; a < 3; ++a) p.center[a] = 0.5f * (p.box.mn[a] + p.box.mx[a]);
+  }
+  bvh.tris.resize(tri_count);
+  for (uint32_t tri = 0; tri < tri_count; ++tri) bvh.tris[tri] = tri;
+  bvh.nodes.reserve((size_t)tri_count / kLeafSize * 2 + 1);
+  build_node({&prims, &bvh}, 0, tri_count, 0);
+
+  for (std::vector<float> &array : bvh.corner) array.assign((size_t)tri_count + kBatch - 1, 0.0f);
+  for (uint32_t i = 0; i < tri_count; ++i) {
+    for (int c = 0; c < 3; ++c) {
+      const float *p = &mesh.vertProperties[(size_t)mesh.triVerts[(size_t)bvh.tris[i] * 3 + (size_t)c] * mesh.numProp];
+      for (int a = 0; a < 3; ++a) bvh.corner[c * 3 + a][i] = p[a];
+    }
+  }
+  return bvh;
+}
+
+bool RaycastMeshBvh(const manifold::MeshGL &mesh, const MeshBvh &bvh,
+                    double originX, double originY, double originZ,
+                    double dirX, double dirY, double dirZ,
+                    double *outT, uint32_t *outTri) {
+  if (bvh.nodes.empty() || bvh.triCount != mesh.NumTri() || mesh.numProp < 3) return false;
+  Ray ray = {{originX, originY, originZ}, {dirX, dirY, dirZ}, {}, {}};
+  for (int a = 0; a < 3; ++a) {
+    ray.of[a] = (float)ray.o[a];
+    // A tiny stand-in for a zero component keeps the slabs free of 0 * inf.
+    const double d = std::fabs(ray.d[a]) < 1e-30 ? std::copysign(1e-30, ray.d[a]) : ray.d[a];
+    ray.inv[a] = (float)(1.0 / d);
+  }
+
+  struct Pending {
+    uint32_t node;
+    float t;
+  };
+  Pending stack[kMaxDepth + 2];
+  int depth = 0;
+  double best_t = std::numeric_limits<double>::infinity();
+  uint32_t best_tri = 0;
+  bool hit = false;
+
+  float t_root = 0.0f;
+  if (!box_hit(bvh.nodes[0], ray, best_t, &t_root)) return false;
+  uint32_t node = 0;
+  for (;;) {
+    const MeshBvhNode &n = bvh.nodes[node];
+    bool descend = false;
+    if (n.count > 0) {
+      uint32_t slot = UINT32_MAX;
+      hit_slots(bvh, n.offset, n.count, ray, &best_t, &slot);
+      if (slot != UINT32_MAX) {
+        best_tri = bvh.tris[slot];
+        hit = true;
+      }
+    } else {
+      const uint32_t left = node + 1;
+      const uint32_t right = n.offset;
+      float t_left = 0.0f, t_right = 0.0f;
+      const bool hit_left = box_hit(bvh.nodes[left], ray, best_t, &t_left);
+      const bool hit_right = box_hit(bvh.nodes[right], ray, best_t, &t_right);
+      if (hit_left && hit_right) {
+        const bool left_first = t_left <= t_right;
+        stack[depth++] = left_first ? Pending{right, t_right} : Pending{left, t_left};
+        node = left_first ? left : right;
+        descend = true;
+      } else if (hit_left || hit_right) {
+        node = hit_left ? left : right;
+        descend = true;
+      }
+    }
+    if (descend) continue;
+    // Pop the nearest pending subtree that can still beat the best hit.
+    while (depth > 0 && (double)stack[depth - 1].t > best_t) --depth;
+    if (depth == 0) break;
+    node = stack[--depth].node;
+  }
+
+  if (!hit) return false;
+  if (outT) *outT = best_t;
+  if (outTri) *outTri = best_tri;
+  return true;
+}
+
+}  // namespace vicad
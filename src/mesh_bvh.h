@@ -0,0 +1,47 @@
+#ifndef VICAD_MESH_BVH_H_
+#define VICAD_MESH_BVH_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "manifold/manifold.h"
+
+namespace vicad {
+
+// One node of a flattened BVH. Inner nodes keep their left child right after
+// themselves and `offset` names the right child; leaves (count > 0) cover
+// triangles [offset, offset + count) of MeshBvh::tris.
+struct MeshBvhNode {
+  float bmin[3];
+  uint32_t offset;
+  float bmax[3];
+  uint32_t count;
+};
+
+// Bounding volume hierarchy over the triangles of one MeshGL, built with a
+// binned surface area heuristic. It stores triangle ids only, so it is only
+// valid for the mesh it was built from.
+struct MeshBvh {
+  std::vector<MeshBvhNode> nodes;
+  std::vector<uint32_t> tris;  // triangle ids in leaf order
+  uint32_t triCount = 0;       // NumTri() of the mesh it was built from
+  // Corner positions of `tris`, one array per corner and axis
+  // (corner[c * 3 + axis][i]), so leaf tests run four triangles at a time
+  // without going through triVerts. Padded so a batch of four starting at
+  // any leaf stays in bounds.
+  std::vector<float> corner[9];
+};
+
+MeshBvh BuildMeshBvh(const manifold::MeshGL &mesh);
+
+// Closest triangle hit by the ray with t > 0, in units of `dir` (which need
+// not be normalized), tested in double precision. `mesh` must be the mesh
+// `bvh` was built from. Returns false on a miss or a mismatched mesh.
+bool RaycastMeshBvh(const manifold::MeshGL &mesh, const MeshBvh &bvh,
+                    double originX, double originY, double originZ,
+                    double dirX, double dirY, double dirZ,
+                    double *outT, uint32_t *outTri);
+
+}  // namespace vicad
+
+#endif  // VICAD_MESH_BVH_H_
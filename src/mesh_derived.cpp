@@ -0,0 +1,63 @@
+#include "mesh_derived.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace vicad {
+
+namespace {
+
+std::atomic<uint64_t> g_next_version{1};
+
+}  // namespace
+
+MeshDerived BuildMeshDerived(const manifold::MeshGL &mesh) {
+  MeshDerived out;
+  out.version = g_next_version.fetch_add(1, std::memory_order_relaxed);
+  if (mesh.numProp < 3) return out;
+  const size_t stride = mesh.numProp;
+  const size_t vertCount = mesh.vertProperties.size() / stride;
+  const float *props = mesh.vertProperties.data();
+
+  if (vertCount > 0) {
+    float mn[3] = {props[0], props[1], props[2]};
+    float mx[3] = {props[0], props[1], props[2]};
+    for (size_t v = 1; v < vertCount; ++v) {
+      const float *p = props + v * stride;
+      for (int axis = 0; axis < 3; ++axis) {
+        mn[axis] = std::min(mn[axis], p[axis]);
+        mx[axis] = std::max(mx[axis], p[axis]);
+      }
+    }
+    std::copy(mn, mn + 3, out.bmin);
+    std::copy(mx, mx + 3, out.bmax);
+    out.hasBounds = true;
+  }
+
+  const size_t triCount = mesh.NumTri();
+  out.triCount = (uint32_t)triCount;
+  for (std::vector<float> &axis : out.triNormal) axis.resize(triCount);
+  float *nxs = out.triNormal[0].data();
+  float *nys = out.triNormal[1].data();
+  float *nzs = out.triNormal[2].data();
+  const uint32_t *triVerts = mesh.triVerts.data();
+  for (size_t tri = 0; tri < triCount; ++tri) {
+    const float *p0 = props + (size_t)triVerts[tri * 3 + 0] * stride;
+    const float *p1 = props + (size_t)triVerts[tri * 3 + 1] * stride;
+    const float *p2 = props + (size_t)triVerts[tri * 3 + 2] * stride;
+    const float ux = p1[0] - p0[0], uy = p1[1] - p0[1], uz = p1[2] - p0[2];
+    const float vx = p2[0] - p0[0], vy = p2[1] - p0[1], vz = p2[2] - p0[2];
+    const float nx = uy * vz - uz * vy;
+    const float ny = uz * vx - ux * vz;
+    const float nz = ux * vy - uy * vx;
+    const float len = std::sqrt(nx * nx + ny * ny + nz * nz);
+    const float inv = len > 0.0f ? 1.0f / len : 0.0f;
+    nxs[tri] = nx * inv;
+    nys[tri] = ny * inv;
+    nzs[tri] = nz * inv;
+  }
+  return out;
+}
+
+}  // namespace vicad
@@ -0,0 +1,29 @@
+#ifndef VICAD_MESH_DERIVED_H_
+#define VICAD_MESH_DERIVED_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "manifold/manifold.h"
+
+namespace vicad {
+
+// Per-mesh quantities more than one consumer reads, computed in one pass and
+// cached with the mesh: vertex bounds and unit face normals. Normals are kept
+// one array per axis so the build and the consumers stream each component.
+// `version` is unique to each build in the process, so a cache keyed by it can
+// never mistake a new mesh for a freed one whose storage it reuses.
+struct MeshDerived {
+  uint64_t version = 0;
+  uint32_t triCount = 0;  // NumTri() of the mesh it was built from
+  bool hasBounds = false;
+  float bmin[3] = {0.0f, 0.0f, 0.0f};
+  float bmax[3] = {0.0f, 0.0f, 0.0f};
+  std::vector<float> triNormal[3];  // per axis; zero for degenerate triangles
+};
+
+MeshDerived BuildMeshDerived(const manifold::MeshGL &mesh);
+
+}  // namespace vicad
+
+#endif  // VICAD_MESH_DERIVED_H_
@@ -0,0 +1,341 @@
+#include "mesh_disk_cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+namespace vicad {
+
+namespace {
+
+constexpr char kMagic[8] = {'V', 'C', 'A', 'D', 'M', 'S', 'H', '1'};
+constexpr uint32_t kVersion = 1;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t lod_key;
+  uint64_t content_hash;
+  uint32_t object_count;
+  uint32_t reserved;
+};
+static_assert(sizeof(FileHeader) == 32, "FileHeader must be 32 bytes");
+
+enum ArrayIndex : uint32_t {
+  kVertProperties = 0,
+  kTriVerts,
+  kMergeFromVert,
+  kMergeToVert,
+  kRunIndex,
+  kRunOriginalId,
+  kFaceId,
+  kRunTransform,
+  kContourSizes,
+  kContourPoints,
+  kArrayCount,
+};
+
+// Followed by the name and then each array in ArrayIndex order, every one
+// padded to 8 bytes. Counts are in elements (4 bytes each; 3 floats per
+// contour point).
+struct ObjectHeader {
+  uint64_t object_id;
+  uint64_t root_digest;
+  uint32_t kind;
+  uint32_t name_len;
+  float bmin[3];
+  float bmax[3];
+  uint32_t num_prop;
+  float tolerance;
+  uint32_t counts[kArrayCount];
+};
+static_assert(sizeof(ObjectHeader) % 8 == 0, "ObjectHeader must keep 8-byte alignment");
+
+size_t padded(size_t n) { return (n + 7) & ~(size_t)7; }
+
+uint64_t fnv1a(const void *data, size_t len, uint64_t h = 0xcbf29ce484222325ull) {
+  const uint8_t *p = (const uint8_t *)data;
+  for (size_t i = 0; i < len; ++i) {
+    h ^= p[i];
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+std::string cache_file_for(const std::string &script_path) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.vmesh",
+                (unsigned long long)fnv1a(script_path.data(), script_path.size()));
+  return MeshDiskCacheDir() + "/" + name;
+}
+
+bool set_err(std::string *error, const std::string &msg) {
+  if (error) *error = msg;
+  return false;
+}
+
+class Writer {
+ public:
+  explicit Writer(std::FILE *f) : f_(f) {}
+  void bytes(const void *data, size_t len) {
+    if (ok_ && len > 0) ok_ = std::fwrite(data, 1, len, f_) == len;
+    written_ += len;
+  }
+  void pad() {
+    static const char zeros[8] = {};
+    bytes(zeros, padded(written_) - written_);
+  }
+  template <typename T>
+  void array(const std::vector<T> &v) {
+    bytes(v.data(), v.size() * sizeof(T));
+    pad();
+  }
+  bool ok() const { return ok_; }
+
+ private:
+  std::FILE *f_;
+  size_t written_ = 0;
+  bool ok_ = true;
+};
+
+struct Reader {
+  const uint8_t *data;
+  size_t size;
+  size_t off;
+
+  const uint8_t *take(size_t len) {
+    if (len > size - off) return nullptr;
+    const uint8_t *p = data + off;
+    off = padded(off + len);
+    if (off > size) off = size;
+    return p;
+  }
+  template <typename T>
+  bool array(uint32_t count, std::vector<T> *out) {
+    const uint8_t *p = take((size_t)count * sizeof(T));
+    if (!p) return false;
+    out->resize(count);
+    if (count > 0) std::memcpy(out->data(), p, (size_t)count * sizeof(T));
+    return true;
+  }
+};
+
+}  // namespace
+
+std::string MeshDiskCacheDir() {
+  if (const char *dir = std::getenv("VICAD_CACHE_DIR"); dir && dir[0]) return dir;
+  const char *home = std::getenv("HOME");
+#if defined(__APPLE__)
+  if (home && home[0]) return std::string(home) + "/Library/Caches/vicad";
+#else
+  if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && xdg[0]) return std::string(xdg) + "/vicad";
+  if (home && home[0]) return std::string(home) + "/.cache/vicad";
+#endif
+  return "build/vicad_cache";
+}
+
+bool MeshDiskCacheKeyForScript(const std::string &script_path, MeshDiskCacheKey *out) {
+  if (!out) return false;
+  std::ifstream in(script_path, std::ios::binary);
+  if (!in) return false;
+  const std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  out->script_path = script_path;
+  out->content_hash = fnv1a(content.data(), content.size());
+  // 0 marks "no key" elsewhere.
+  if (out->content_hash == 0) out->content_hash = 1;
+  return true;
+}
+
+bool MeshDiskCacheStore(const MeshDiskCacheKey &key, uint32_t lod_key,
+                        const std::vector<ScriptSceneObject> &objects, std::string *error) {
+  if (key.content_hash == 0) return set_err(error, "Mesh cache key is empty.");
+  std::error_code ec;
+  std::filesystem::create_directories(MeshDiskCacheDir(), ec);
+  if (ec) return set_err(error, "Failed to create mesh cache dir: " + ec.message());
+  const std::string path = cache_file_for(key.script_path);
+  const std::string tmp_path = path + ".tmp";
+  std::FILE *f = std::fopen(tmp_path.c_str(), "wb");
+  if (!f) return set_err(error, "Failed to open " + tmp_path + " for writing.");
+
+  Writer w(f);
+  FileHeader hdr = {};
+  std::memcpy(hdr.magic, kMagic, sizeof(kMagic));
+  hdr.version = kVersion;
+  hdr.lod_key = lod_key;
+  hdr.content_hash = key.content_hash;
+  hdr.object_count = (uint32_t)objects.size();
+  w.bytes(&hdr, sizeof(hdr));
+  for (const ScriptSceneObject &obj : objects) {
+    const bool is_manifold = obj.kind == ScriptSceneObjectKind::Manifold;
+    // An instanced object is stored as its world mesh, built for the write
+    // only so the object keeps sharing its instance geometry.
+    manifold::MeshGL flattened;
+    if (is_manifold && obj.instance && !obj.meshCache) flattened = obj.manifold.GetMeshGL();
+    const manifold::MeshGL &mesh = flattened.vertProperties.empty() ? SceneObjectMesh(obj) : flattened;
+    std::vector<uint32_t> contour_sizes;
+    std::vector<float> contour_points;
+    for (const ScriptSketchContour &contour : obj.sketchContours) {
+      contour_sizes.push_back((uint32_t)contour.points.size());
+      for (const SceneVec3 &p : contour.points) contour_points.insert(contour_points.end(), {p.x, p.y, p.z});
+    }
+    ObjectHeader oh = {};
+    oh.object_id = obj.objectId;
+    oh.root_digest = obj.rootDigest;
+    oh.kind = (uint32_t)obj.kind;
+    oh.name_len = (uint32_t)obj.name.size();
+    oh.bmin[0] = obj.bmin.x;
+    oh.bmin[1] = obj.bmin.y;
+    oh.bmin[2] = obj.bmin.z;
+    oh.bmax[0] = obj.bmax.x;
+    oh.bmax[1] = obj.bmax.y;
+    oh.bmax[2] = obj.bmax.z;
+    oh.num_prop = mesh.numProp;
+    oh.tolerance = mesh.tolerance;
+    if (is_manifold) {
+      oh.counts[kVertProperties] = (uint32_t)mesh.vertProperties.size();
+      oh.counts[kTriVerts] = (uint32_t)mesh.triVerts.size();
+      oh.counts[kMergeFromVert] = (uint32_t)mesh.mergeFromVert.size();
+      oh.counts[kMergeToVert] = (uint32_t)mesh.mergeToVert.size();
+      oh.counts[kRunIndex] = (uint32_t)mesh.runIndex.size();
+      oh.counts[kRunOriginalId] = (uint32_t)mesh.runOriginalID.size();
+      oh.counts[kFaceId] = (uint32_t)mesh.faceID.size();
+      oh.counts[kRunTransform] = (uint32_t)mesh.runTransform.size();
+    }
+    oh.counts[kContourSizes] = (uint32_t)contour_sizes.size();
+    oh.counts[kContourPoints] = (uint32_t)contour_points.size();
+    w.bytes(&oh, sizeof(oh));
+    w.bytes(obj.name.data(), obj.name.size());
+    w.pad();
+    if (is_manifold) {
+      w.array(mesh.vertProperties);
+      w.array(mesh.triVerts);
+      w.array(mesh.mergeFromVert);
+      w.array(mesh.mergeToVert);
+      w.array(mesh.runIndex);
+      w.array(mesh.runOriginalID);
+      w.array(mesh.faceID);
+      w.array(mesh.runTransform);
+    }
+    w.array(contour_sizes);
+    w.array(contour_points);
+  }
+  const bool closed = std::fclose(f) == 0;
+  if (!w.ok() || !closed) {
+    std::remove(tmp_path.c_str());
+    return set_err(error, "Failed to write " + tmp_path + ".");
+  }
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+    return set_err(error, "Failed to replace " + path + ".");
+  }
+  return true;
+}
+
+bool MeshDiskCacheLoad(const MeshDiskCacheKey &key, std::vector<ScriptSceneObject> *objects,
+                       std::string *error) {
+  if (!objects || key.content_hash == 0) return set_err(error, "Invalid mesh cache arguments.");
+  objects->clear();
+  const std::string path = cache_file_for(key.script_path);
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return set_err(error, "No cached scene for " + key.script_path + ".");
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(FileHeader)) {
+    ::close(fd);
+    return set_err(error, "Cached scene " + path + " is truncated.");
+  }
+  const size_t size = (size_t)st.st_size;
+  void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) return set_err(error, "Failed to map " + path + ".");
+
+  Reader r = {(const uint8_t *)map, size, 0};
+  bool ok = true;
+  std::string why;
+  FileHeader hdr = {};
+  std::memcpy(&hdr, r.take(sizeof(hdr)), sizeof(hdr));
+  if (std::memcmp(hdr.magic, kMagic, sizeof(kMagic)) != 0 || hdr.version != kVersion) {
+    ok = false;
+    why = "Cached scene " + path + " has an unknown format.";
+  } else if (hdr.content_hash != key.content_hash) {
+    ok = false;
+    why = "Cached scene is stale.";
+  }
+  std::vector<ScriptSceneObject> loaded;
+  for (uint32_t i = 0; ok && i < hdr.object_count; ++i) {
+    const uint8_t *oh_ptr = r.take(sizeof(ObjectHeader));
+    if (!oh_ptr) {
+      ok = false;
+      break;
+    }
+    ObjectHeader oh = {};
+    std::memcpy(&oh, oh_ptr, sizeof(oh));
+    const uint8_t *name = r.take(oh.name_len);
+    if (!name) {
+      ok = false;
+      break;
+    }
+    ScriptSceneObject obj;
+    obj.objectId = oh.object_id;
+    obj.rootDigest = oh.root_digest;
+    obj.lodKey = hdr.lod_key;
+    obj.kind = (ScriptSceneObjectKind)oh.kind;
+    obj.name.assign((const char *)name, oh.name_len);
+    obj.bmin = {oh.bmin[0], oh.bmin[1], oh.bmin[2]};
+    obj.bmax = {oh.bmax[0], oh.bmax[1], oh.bmax[2]};
+    manifold::MeshGL mesh;
+    mesh.numProp = oh.num_prop;
+    mesh.tolerance = oh.tolerance;
+    std::vector<uint32_t> contour_sizes;
+    std::vector<float> contour_points;
+    ok = r.array(oh.counts[kVertProperties], &mesh.vertProperties) &&
+         r.array(oh.counts[kTriVerts], &mesh.triVerts) &&
+         r.array(oh.counts[kMergeFromVert], &mesh.mergeFromVert) &&
+         r.array(oh.counts[kMergeToVert], &mesh.mergeToVert) &&
+         r.array(oh.counts[kRunIndex], &mesh.runIndex) &&
+         r.array(oh.counts[kRunOriginalId], &mesh.runOriginalID) &&
+         r.array(oh.counts[kFaceId], &mesh.faceID) &&
+         r.array(oh.counts[kRunTransform], &mesh.runTransform) &&
+         r.array(oh.counts[kContourSizes], &contour_sizes) &&
+         r.array(oh.counts[kContourPoints], &contour_points);
+    if (!ok) break;
+    size_t point = 0;
+    for (uint32_t n : contour_sizes) {
+      if ((point + n) * 3 > contour_points.size()) {
+        ok = false;
+        break;
+      }
+      ScriptSketchContour contour;
+      contour.points.reserve(n);
+      for (uint32_t k = 0; k < n; ++k, ++point) {
+        contour.points.push_back({contour_points[point * 3 + 0], contour_points[point * 3 + 1],
+                                  contour_points[point * 3 + 2]});
+      }
+      obj.sketchContours.push_back(std::move(contour));
+    }
+    if (!ok) break;
+    if (obj.kind == ScriptSceneObjectKind::Manifold) {
+      if (mesh.numProp < 3) {
+        ok = false;
+        break;
+      }
+      obj.manifold = manifold::Manifold(mesh);
+      obj.meshCache = std::move(mesh);
+    }
+    loaded.push_back(std::move(obj));
+  }
+  munmap(map, size);
+  if (!ok) return set_err(error, why.empty() ? "Cached scene " + path + " is corrupt." : why);
+  *objects = std::move(loaded);
+  return true;
+}
+
+}  // namespace vicad
@@ -0,0 +1,40 @@
+#ifndef VICAD_MESH_DISK_CACHE_H_
+#define VICAD_MESH_DISK_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "scene_object.h"
+
+namespace vicad {
+
+// Identifies a script's scene on disk: its path plus a hash of the file's
+// bytes. Imports are not hashed, so a cached scene is only a preview to show
+// while the script is re-run.
+struct MeshDiskCacheKey {
+  std::string script_path;
+  uint64_t content_hash = 0;
+};
+
+// Directory holding cached scenes: $VICAD_CACHE_DIR, else the user cache dir
+// (~/Library/Caches/vicad on macOS, $XDG_CACHE_HOME/vicad or ~/.cache/vicad
+// elsewhere).
+std::string MeshDiskCacheDir();
+bool MeshDiskCacheKeyForScript(const std::string &script_path, MeshDiskCacheKey *out);
+
+// One file per script. Every object's MeshGL (positions, triVerts, faceID,
+// run and merge vectors) or sketch contours, bounds, objectId and root digest
+// are laid out as 8-byte aligned arrays so a reader can mmap the file and copy
+// them out directly. The file is replaced atomically.
+bool MeshDiskCacheStore(const MeshDiskCacheKey &key, uint32_t lod_key,
+                        const std::vector<ScriptSceneObject> &objects, std::string *error);
+// Loads the cached scene when its content hash matches `key`. Manifold
+// objects get a Manifold rebuilt from their mesh and keep the mesh as their
+// cached SceneObjectMesh; objects carry no replay tables.
+bool MeshDiskCacheLoad(const MeshDiskCacheKey &key, std::vector<ScriptSceneObject> *objects,
+                       std::string *error);
+
+}  // namespace vicad
+
+#endif  // VICAD_MESH_DISK_CACHE_H_
@@ -0,0 +1,70 @@
+#include "mesh_lod.h"
+
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+namespace vicad {
+
+namespace {
+
+// Simplification tolerance as a fraction of the bounding-box diagonal: where
+// the search starts, and past which a level is too coarse to be worth drawing.
+constexpr double kStartTolerance = 1e-3;
+constexpr double kMaxTolerance = 0.04;
+
+// Largest on-screen size, in pixels, at which each coarser level is drawn.
+constexpr float kLevelMaxPx[] = {360.0f, 160.0f, 64.0f};
+static_assert(std::size(kLevelMaxPx) == std::size(kMeshLodRatios), "one threshold per level");
+// Fraction past a threshold an object must move before the level switches.
+constexpr float kHysteresis = 0.15f;
+
+}  // namespace
+
+MeshLodChain BuildMeshLodChain(const manifold::Manifold &m) {
+  MeshLodChain chain;
+  const size_t full = m.NumTri();
+  if (full < kMeshLodMinTris) return chain;
+  const manifold::Box box = m.BoundingBox();
+  const double dx = box.max.x - box.min.x;
+  const double dy = box.max.y - box.min.y;
+  const double dz = box.max.z - box.min.z;
+  const double diag = std::sqrt(dx * dx + dy * dy + dz * dz);
+  if (!std::isfinite(diag) || diag <= 0.0) return chain;
+
+  double tolerance = diag * kStartTolerance;
+  size_t prev = full;
+  for (float ratio : kMeshLodRatios) {
+    const size_t target = (size_t)((double)full * ratio);
+    manifold::Manifold simplified;
+    size_t tris = 0;
+    while (tolerance <= diag * kMaxTolerance) {
+      simplified = m.Simplify(tolerance);
+      tris = simplified.NumTri();
+      if (tris <= target) break;
+      tolerance *= 2.0;
+    }
+    if (tris == 0 || tris > prev - prev / 4) break;
+    MeshLodLevel level;
+    level.mesh = simplified.GetMeshGL();
+    level.derived = BuildMeshDerived(level.mesh);
+    chain.levels.push_back(std::move(level));
+    prev = tris;
+  }
+  return chain;
+}
+
+int SelectMeshLod(const MeshLodChain &chain, float screen_px, int current) {
+  const int count = (int)chain.levels.size();
+  if (current > count) current = count;
+  if (current < 0) current = 0;
+  int level = current;
+  // Coarser: the object has to be clearly below the next level's threshold.
+  while (level < count && screen_px < kLevelMaxPx[level] * (1.0f - kHysteresis)) level++;
+  if (level != current) return level;
+  // Finer: clearly above the current level's threshold.
+  while (level > 0 && screen_px > kLevelMaxPx[level - 1] * (1.0f + kHysteresis)) level--;
+  return level;
+}
+
+}  // namespace vicad
@@ -0,0 +1,42 @@
+#ifndef VICAD_MESH_LOD_H_
+#define VICAD_MESH_LOD_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "manifold/manifold.h"
+#include "mesh_derived.h"
+
+namespace vicad {
+
+// Render-only decimated copies of a manifold's mesh, finest first. Level 0 is
+// the full mesh itself and is not stored, so level i is levels[i - 1]. Picking
+// and export always use the full mesh.
+struct MeshLodLevel {
+  manifold::MeshGL mesh;
+  MeshDerived derived;
+};
+
+struct MeshLodChain {
+  std::vector<MeshLodLevel> levels;
+};
+
+// Triangle budgets of the coarser levels as fractions of the full mesh.
+inline constexpr float kMeshLodRatios[] = {0.5f, 0.25f, 0.1f};
+// Meshes below this many triangles are cheap enough to always draw in full.
+inline constexpr uint32_t kMeshLodMinTris = 4096;
+
+// Simplifies `m` with a growing tolerance until each level meets its budget,
+// stopping at the first level that would not cut the previous one by a
+// quarter or would need a tolerance above a few percent of the mesh size.
+// Slow; meant for a background thread. Empty when `m` is too small.
+MeshLodChain BuildMeshLodChain(const manifold::Manifold &m);
+
+// Level to draw for an object `screen_px` pixels across, given the level
+// drawn last (`current`). Switching needs a margin past the threshold, so an
+// object sitting on one does not flip between levels every frame.
+int SelectMeshLod(const MeshLodChain &chain, float screen_px, int current);
+
+}  // namespace vicad
+
+#endif  // VICAD_MESH_LOD_H_
@@ -0,0 +1,69 @@
+#include "mesh_lod_builder.h"
+
+#include <utility>
+
+#include "trace.h"
+
+namespace vicad {
+
+MeshLodBuilder::MeshLodBuilder(std::function<void()> on_ready) : on_ready_(std::move(on_ready)) {
+  // Start the thread only after all members are fully constructed.
+  thread_ = std::thread(&MeshLodBuilder::RunLoop, this);
+}
+
+MeshLodBuilder::~MeshLodBuilder() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  if (thread_.joinable()) thread_.join();
+}
+
+void MeshLodBuilder::Submit(std::vector<MeshLodJob> jobs) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_ = std::move(jobs);
+  }
+  wake_.notify_one();
+}
+
+bool MeshLodBuilder::TakeResults(std::vector<MeshLodResult> *out) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (results_.empty()) return false;
+  *out = std::move(results_);
+  results_.clear();
+  return true;
+}
+
+void MeshLodBuilder::RunLoop() {
+  trace_thread_name("lod");
+  for (;;) {
+    MeshLodJob job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+      if (stop_) return;
+      job = std::move(jobs_.back());
+      jobs_.pop_back();
+    }
+
+    MeshLodResult result;
+    result.object_id = job.object_id;
+    result.digest = job.digest;
+    result.lod_key = job.lod_key;
+    {
+      TraceSpan span("scene", "lod_chain");
+      result.chain = std::make_shared<const MeshLodChain>(BuildMeshLodChain(job.manifold));
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stop_) return;
+      results_.push_back(std::move(result));
+    }
+    if (on_ready_) on_ready_();
+  }
+}
+
+}  // namespace vicad
@@ -0,0 +1,64 @@
+#ifndef VICAD_MESH_LOD_BUILDER_H_
+#define VICAD_MESH_LOD_BUILDER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "manifold/manifold.h"
+#include "mesh_lod.h"
+
+namespace vicad {
+
+// A manifold to build render levels for: a non-instanced object, matched back
+// by objectId, root digest and LOD key, or shared instance geometry (objectId
+// 0), matched by its digest and LOD key.
+struct MeshLodJob {
+  uint64_t object_id = 0;
+  uint64_t digest = 0;
+  uint32_t lod_key = 0;
+  manifold::Manifold manifold;
+};
+
+struct MeshLodResult {
+  uint64_t object_id = 0;
+  uint64_t digest = 0;
+  uint32_t lod_key = 0;
+  std::shared_ptr<const MeshLodChain> chain;
+};
+
+// Background thread that builds decimated render levels, one manifold at a
+// time. Each chain is published as soon as it is built; a new submission
+// replaces whatever of the previous one has not started yet.
+class MeshLodBuilder {
+ public:
+  explicit MeshLodBuilder(std::function<void()> on_ready);
+  ~MeshLodBuilder();
+
+  MeshLodBuilder(const MeshLodBuilder &) = delete;
+  MeshLodBuilder &operator=(const MeshLodBuilder &) = delete;
+
+  // Jobs run from the back of `jobs`.
+  void Submit(std::vector<MeshLodJob> jobs);
+  // Moves out every chain built since the last call.
+  bool TakeResults(std::vector<MeshLodResult> *out);
+
+ private:
+  void RunLoop();
+
+  std::function<void()> on_ready_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stop_ = false;
+  std::vector<MeshLodJob> jobs_;
+  std::vector<MeshLodResult> results_;
+  std::thread thread_;
+};
+
+}  // namespace vicad
+
+#endif  // VICAD_MESH_LOD_BUILDER_H_
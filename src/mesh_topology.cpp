@@ -0,0 +1,202 @@
+#include "mesh_topology.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "disjoint_set.h"
+#include "trace.h"
+#include "work_stealing_pool.h"
+
+namespace vicad {
+
+namespace {
+
+// Below this many items a step stays on the calling thread.
+constexpr size_t kParallelMin = (size_t)1 << 16;
+constexpr int kRadixBits = 8;
+constexpr uint32_t kRadixBuckets = 1u << kRadixBits;
+
+// One triangle side between two distinct welded vertices.
+struct Side {
+  uint64_t key;
+  uint32_t code;  // tri * 3 + corner
+};
+
+uint64_t edge_key(uint32_t a, uint32_t b) {
+  if (a > b) std::swap(a, b);
+  return ((uint64_t)a << 32) | (uint64_t)b;
+}
+
+// Stable LSD radix sort by key. Keys pack two welded ids no larger than
+// maxVert, so only the digits those can occupy are visited, and a pass whose
+// digit is the same for every key is skipped.
+void radix_sort_sides(std::vector<Side> *items, uint32_t maxVert) {
+  const size_t n = items->size();
+  if (n < 2) return;
+  const WorkChunks chunks = SplitWork(n, kParallelMin);
+  int vertBits = 0;
+  while (vertBits < 32 && (maxVert >> vertBits) != 0) ++vertBits;
+  std::vector<Side> scratch(n);
+  std::vector<uint32_t> offsets(chunks.count * kRadixBuckets);
+  Side *src = items->data();
+  Side *dst = scratch.data();
+  for (int half = 0; half < 64; half += 32) {
+    for (int bit = 0; bit < vertBits; bit += kRadixBits) {
+      const int shift = half + bit;
+      auto digit = [shift](const Side &s) { return (uint32_t)(s.key >> shift) & (kRadixBuckets - 1); };
+      RunWorkChunks(chunks, [&](size_t c, size_t begin, size_t end) {
+        uint32_t *count = &offsets[c * kRadixBuckets];
+        std::fill(count, count + kRadixBuckets, 0u);
+        for (size_t i = begin; i < end; ++i) count[digit(src[i])]++;
+      });
+      bool uniform = false;
+      for (uint32_t d = 0; d < kRadixBuckets && !uniform; ++d) {
+        size_t total = 0;
+        for (size_t c = 0; c < chunks.count; ++c) total += offsets[c * kRadixBuckets + d];
+        uniform = total == n;
+      }
+      if (uniform) continue;
+      uint32_t running = 0;
+      for (uint32_t d = 0; d < kRadixBuckets; ++d) {
+        for (size_t c = 0; c < chunks.count; ++c) {
+          const uint32_t count = offsets[c * kRadixBuckets + d];
+          offsets[c * kRadixBuckets + d] = running;
+          running += count;
+        }
+      }
+      RunWorkChunks(chunks, [&](size_t c, size_t begin, size_t end) {
+        uint32_t *next = &offsets[c * kRadixBuckets];
+        for (size_t i = begin; i < end; ++i) dst[next[digit(src[i])]++] = src[i];
+      });
+      std::swap(src, dst);
+    }
+  }
+  if (src != items->data()) items->swap(scratch);
+}
+
+MeshTopoVec3 vert_pos(const manifold::MeshGL &mesh, uint32_t v) {
+  const size_t base = (size_t)v * mesh.numProp;
+  return {(double)mesh.vertProperties[base + 0], (double)mesh.vertProperties[base + 1],
+          (double)mesh.vertProperties[base + 2]};
+}
+
+}  // namespace
+
+MeshTopology BuildMeshTopology(const manifold::MeshGL &mesh) {
+  TraceSpan span("analysis", "topology");
+  MeshTopology topo;
+  const uint32_t triCount = (uint32_t)mesh.NumTri();
+  topo.triCount = triCount;
+  topo.edgeOffset.push_back(0);
+  topo.triOffset.assign((size_t)triCount + 1, 0);
+  if (triCount == 0 || mesh.numProp < 3) return topo;
+
+  const uint32_t numVerts = (uint32_t)mesh.NumVert();
+  DisjointSet dsu(numVerts);
+  const size_t mergeCount = std::min(mesh.mergeFromVert.size(), mesh.mergeToVert.size());
+  for (size_t i = 0; i < mergeCount; ++i) {
+    const uint32_t from = mesh.mergeFromVert[i];
+    const uint32_t to = mesh.mergeToVert[i];
+    if (from >= numVerts || to >= numVerts) continue;
+    dsu.unite(from, to);
+  }
+  topo.weldedVert.resize(numVerts);
+  for (uint32_t v = 0; v < numVerts; ++v) topo.weldedVert[v] = dsu.find(v);
+
+  topo.triNormal.resize(triCount);
+  topo.triCenter.resize(triCount);
+  RunWorkChunks(SplitWork(triCount, kParallelMin), [&](size_t, size_t begin, size_t end) {
+    for (size_t tri = begin; tri < end; ++tri) {
+      const MeshTopoVec3 p0 = vert_pos(mesh, mesh.triVerts[tri * 3 + 0]);
+      const MeshTopoVec3 p1 = vert_pos(mesh, mesh.triVerts[tri * 3 + 1]);
+      const MeshTopoVec3 p2 = vert_pos(mesh, mesh.triVerts[tri * 3 + 2]);
+      const double ax = p1.x - p0.x, ay = p1.y - p0.y, az = p1.z - p0.z;
+      const double bx = p2.x - p0.x, by = p2.y - p0.y, bz = p2.z - p0.z;
+      MeshTopoVec3 n = {ay * bz - az * by, az * bx - ax * bz, ax * by - ay * bx};
+      const double len = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+      n = len <= 1e-30 ? MeshTopoVec3{0.0, 0.0, 0.0} : MeshTopoVec3{n.x / len, n.y / len, n.z / len};
+      topo.triNormal[tri] = n;
+      const double third = 1.0 / 3.0;
+      topo.triCenter[tri] = {(p0.x + p1.x + p2.x) * third, (p0.y + p1.y + p2.y) * third,
+                             (p0.z + p1.z + p2.z) * third};
+    }
+  });
+
+  // Sides are emitted in code order and the sort is stable, so each edge's
+  // sides stay ascending.
+  std::vector<Side> sides;
+  sides.reserve((size_t)triCount * 3);
+  for (uint32_t tri = 0; tri < triCount; ++tri) {
+    for (uint32_t corner = 0; corner < 3; ++corner) {
+      const uint32_t a = topo.weldedVert[mesh.triVerts[tri * 3 + corner]];
+      const uint32_t b = topo.weldedVert[mesh.triVerts[tri * 3 + (corner + 1) % 3]];
+      if (a == b) continue;
+      sides.push_back({edge_key(a, b), tri * 3 + corner});
+    }
+  }
+  radix_sort_sides(&sides, numVerts - 1);
+
+  topo.edgeSides.resize(sides.size());
+  for (size_t i = 0; i < sides.size(); ++i) {
+    if (i > 0 && sides[i].key != sides[i - 1].key) topo.edgeOffset.push_back((uint32_t)i);
+    if (i == 0 || sides[i].key != sides[i - 1].key) topo.edgeKey.push_back(sides[i].key);
+    topo.edgeSides[i] = sides[i].code;
+  }
+  if (!sides.empty()) topo.edgeOffset.push_back((uint32_t)sides.size());
+  std::vector<Side>().swap(sides);
+
+  // Every other distinct triangle on an edge is a neighbor. Gather them with
+  // repeats, then sort and dedupe each triangle's list and pack the lists.
+  const size_t edgeCount = topo.edge_count();
+  auto for_edge_tris = [&](size_t e, auto &&fn) {
+    uint32_t last = UINT32_MAX;
+    for (uint32_t i = topo.edgeOffset[e]; i < topo.edgeOffset[e + 1]; ++i) {
+      const uint32_t tri = topo.edgeSides[i] / 3;
+      if (tri == last) continue;
+      last = tri;
+      fn(tri);
+    }
+  };
+  std::vector<uint32_t> rawOffset((size_t)triCount + 1, 0);
+  for (size_t e = 0; e < edgeCount; ++e) {
+    uint32_t distinct = 0;
+    for_edge_tris(e, [&](uint32_t) { ++distinct; });
+    for_edge_tris(e, [&](uint32_t tri) { rawOffset[(size_t)tri + 1] += distinct - 1; });
+  }
+  for (uint32_t tri = 0; tri < triCount; ++tri) rawOffset[(size_t)tri + 1] += rawOffset[tri];
+  std::vector<uint32_t> raw(rawOffset[triCount]);
+  {
+    std::vector<uint32_t> fill(rawOffset.begin(), rawOffset.end() - 1);
+    std::vector<uint32_t> edgeTris;
+    for (size_t e = 0; e < edgeCount; ++e) {
+      edgeTris.clear();
+      for_edge_tris(e, [&](uint32_t tri) { edgeTris.push_back(tri); });
+      for (const uint32_t a : edgeTris) {
+        for (const uint32_t b : edgeTris) {
+          if (a != b) raw[fill[a]++] = b;
+        }
+      }
+    }
+  }
+  std::vector<uint32_t> uniqueCount(triCount);
+  RunWorkChunks(SplitWork(triCount, kParallelMin), [&](size_t, size_t begin, size_t end) {
+    for (size_t tri = begin; tri < end; ++tri) {
+      uint32_t *first = raw.data() + rawOffset[tri];
+      uint32_t *last = raw.data() + rawOffset[tri + 1];
+      std::sort(first, last);
+      uniqueCount[tri] = (uint32_t)(std::unique(first, last) - first);
+    }
+  });
+  for (uint32_t tri = 0; tri < triCount; ++tri) {
+    topo.triOffset[(size_t)tri + 1] = topo.triOffset[tri] + uniqueCount[tri];
+  }
+  topo.triNeighbors.resize(topo.triOffset[triCount]);
+  for (uint32_t tri = 0; tri < triCount; ++tri) {
+    std::copy(raw.begin() + rawOffset[tri], raw.begin() + rawOffset[tri] + uniqueCount[tri],
+              topo.triNeighbors.begin() + topo.triOffset[tri]);
+  }
+  return topo;
+}
+
+}  // namespace vicad
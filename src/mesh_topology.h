@@ -0,0 +1,46 @@
+#ifndef VICAD_MESH_TOPOLOGY_H_
+#define VICAD_MESH_TOPOLOGY_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "manifold/manifold.h"
+
+namespace vicad {
+
+struct MeshTopoVec3 {
+  double x;
+  double y;
+  double z;
+};
+
+// Connectivity of one MeshGL in compressed sparse row form, built once and
+// shared by face detection and edge topology. Vertices are welded through
+// mergeFromVert/mergeToVert, so property seams split neither edges nor
+// triangle adjacency.
+struct MeshTopology {
+  uint32_t triCount = 0;  // NumTri() of the mesh it was built from
+  std::vector<uint32_t> weldedVert;  // per vertex, the id of its welded group
+  // Edges between two distinct welded vertices, ascending by edgeKey (the
+  // smaller welded id in the high word). Edge e is the triangle sides
+  // edgeSides[edgeOffset[e], edgeOffset[e + 1]), each coded tri * 3 + corner
+  // for the side starting at that corner, in ascending order.
+  std::vector<uint64_t> edgeKey;
+  std::vector<uint32_t> edgeOffset;
+  std::vector<uint32_t> edgeSides;
+  // Triangles sharing an edge with triangle t, ascending and without t:
+  // triNeighbors[triOffset[t], triOffset[t + 1]).
+  std::vector<uint32_t> triOffset;
+  std::vector<uint32_t> triNeighbors;
+  std::vector<MeshTopoVec3> triNormal;  // unit, zero for degenerate triangles
+  std::vector<MeshTopoVec3> triCenter;
+
+  size_t edge_count() const { return edgeKey.size(); }
+};
+
+// Builds in parallel on the shared work-stealing pool when it is free.
+MeshTopology BuildMeshTopology(const manifold::MeshGL &mesh);
+
+}  // namespace vicad
+
+#endif  // VICAD_MESH_TOPOLOGY_H_
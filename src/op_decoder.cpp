@@ -9,6 +9,10 @@
 #include <vector>
 
 #include "ipc_protocol.h"
+#include "replay_fusion.h"
+#include "replay_scheduler.h"
+#include "replay_semantic_arena.h"
+#include "union_by_bounds.h"
 
 namespace vicad {
 
@@ -31,43 +35,36 @@ bool read_pod(Reader *r, T *out) {
 bool read_u32(Reader *r, uint32_t *out) { return read_pod<uint32_t>(r, out); }
 bool read_f64(Reader *r, double *out) { return read_pod<double>(r, out); }
 
-bool ensure_node(std::vector<manifold::Manifold> *m_nodes,
-                 std::vector<bool> *has_m,
-                 std::vector<manifold::CrossSection> *c_nodes,
-                 std::vector<bool> *has_c,
-                 std::vector<SketchPlane> *cross_plane,
-                 std::vector<ReplayNodeSemantic> *sem,
-                 uint32_t id) {
-  const size_t need = (size_t)id + 1;
-  if (m_nodes->size() >= need) return true;
-  m_nodes->resize(need);
-  has_m->resize(need, false);
-  c_nodes->resize(need);
-  has_c->resize(need, false);
-  cross_plane->resize(need);
-  sem->resize(need);
+static_assert(sizeof(manifold::vec2) == 2 * sizeof(double), "vec2 must be two packed doubles");
+
+// Copies `count` (x: f64, y: f64) points straight out of the record into `out`.
+bool read_points(Reader *r, uint32_t count, manifold::SimplePolygon *out) {
+  const size_t bytes = (size_t)count * sizeof(manifold::vec2);
+  if (r->off + bytes > r->len) return false;
+  out->resize(count);
+  std::memcpy(out->data(), r->ptr + r->off, bytes);
+  r->off += bytes;
   return true;
 }
 
-bool need_m(const std::vector<manifold::Manifold> &nodes,
-            const std::vector<bool> &has, uint32_t id, manifold::Manifold *out,
-            std::string *error) {
-  if ((size_t)id >= nodes.size() || !has[id]) {
+constexpr uint8_t kManifoldNode = (uint8_t)NodeKind::Manifold;
+constexpr uint8_t kCrossNode = (uint8_t)NodeKind::CrossSection;
+
+bool need_m(const ReplayTables &tables, uint32_t id, manifold::Manifold *out, std::string *error) {
+  if (!ReplayNodeIs(tables, id, NodeKind::Manifold)) {
     *error = "Replay failed: missing manifold node " + std::to_string(id);
     return false;
   }
-  *out = nodes[id];
+  *out = tables.manifold_nodes[id];
   return true;
 }
 
-bool need_c(const std::vector<manifold::CrossSection> &nodes,
-            const std::vector<bool> &has, uint32_t id, manifold::CrossSection *out,
-            std::string *error) {
-  if ((size_t)id >= nodes.size() || !has[id]) {
+bool need_c(const ReplayTables &tables, uint32_t id, manifold::CrossSection *out, std::string *error) {
+  if (!ReplayNodeIs(tables, id, NodeKind::CrossSection)) {
     *error = "Replay failed: missing cross-section node " + std::to_string(id);
     return false;
   }
-  *out = nodes[id];
+  *out = tables.cross_nodes[id];
   return true;
 }
 
@@ -77,6 +74,16 @@ bool check_status(const manifold::Manifold &m, const char *ctx, std::string *err
   return false;
 }
 
+bool batch_boolean(const ReplayTables &tables, const std::vector<uint32_t> &ids, manifold::OpType op,
+                   manifold::Manifold *out, std::string *error) {
+  std::vector<manifold::Manifold> parts(ids.size());
+  for (size_t i = 0; i < ids.size(); ++i) {
+    if (!need_m(tables, ids[i], &parts[i], error)) return false;
+  }
+  *out = op == manifold::OpType::Add ? UnionByBounds(parts) : manifold::Manifold::BatchBoolean(parts, op);
+  return true;
+}
+
 double revolve_effective_radius(const manifold::Polygons &cross_section) {
   double radius = 0.0;
   for (const manifold::SimplePolygon &poly : cross_section) {
@@ -105,26 +112,34 @@ SketchPlane default_sketch_plane() {
   return SketchPlane{};
 }
 
-manifold::vec3 map_plane_local_to_world(const SketchPlane &plane, const manifold::vec3 &p) {
+// Every sketch plane is a rotation by a signed axis permutation plus an
+// offset along the plane normal; columns are the images of local x, y, z and
+// the translation.
+manifold::mat3x4 plane_local_to_world(const SketchPlane &plane) {
   switch (plane.kind) {
     case SketchPlaneKind::XY:
-      return manifold::vec3(p.x, p.y, p.z + plane.offset);
+      break;
     case SketchPlaneKind::XZ:
-      // Keep right-handed basis while preserving +extrude along +Y.
-      return manifold::vec3(p.x, p.z + plane.offset, -p.y);
+      // Keep right-handed basis while preserving +extrude along +Y:
+      // (x, y, z) -> (x, z + offset, -y).
+      return manifold::mat3x4(manifold::vec3(1.0, 0.0, 0.0), manifold::vec3(0.0, 0.0, -1.0),
+                              manifold::vec3(0.0, 1.0, 0.0), manifold::vec3(0.0, plane.offset, 0.0));
     case SketchPlaneKind::YZ:
-      return manifold::vec3(p.z + plane.offset, p.x, p.y);
+      // (x, y, z) -> (z + offset, x, y).
+      return manifold::mat3x4(manifold::vec3(0.0, 1.0, 0.0), manifold::vec3(0.0, 0.0, 1.0),
+                              manifold::vec3(1.0, 0.0, 0.0), manifold::vec3(plane.offset, 0.0, 0.0));
   }
-  return manifold::vec3(p.x, p.y, p.z + plane.offset);
+  return manifold::mat3x4(manifold::vec3(1.0, 0.0, 0.0), manifold::vec3(0.0, 1.0, 0.0),
+                          manifold::vec3(0.0, 0.0, 1.0), manifold::vec3(0.0, 0.0, plane.offset));
 }
 
+// An affine Transform stays lazy in Manifold and composes with any transform
+// applied after it, unlike a per-vertex Warp.
 manifold::Manifold apply_plane_to_manifold(const manifold::Manifold &in_m, const SketchPlane &plane) {
   if (plane.kind == SketchPlaneKind::XY && std::abs(plane.offset) <= 1e-12) {
     return in_m;
   }
-  return in_m.Warp([plane](manifold::vec3 &v) {
-    v = map_plane_local_to_world(plane, v);
-  });
+  return in_m.Transform(plane_local_to_world(plane));
 }
 
 double cross2(const manifold::vec2 &a, const manifold::vec2 &b) {
@@ -350,7 +365,7 @@ bool apply_corner_fillets(const manifold::CrossSection &in_c,
         return false;
       }
 
-      const int full_segments = AutoCircularSegments(std::abs(r), lod_policy.profile);
+      const int full_segments = AutoCircularSegments(std::abs(r), lod_policy);
       int seg = std::max(1, (int)std::ceil((double)full_segments * sweep / kTwoPi));
       push_point(p_start);
       for (int s = 1; s < seg; ++s) {
@@ -386,488 +401,481 @@ bool apply_corner_fillets(const manifold::CrossSection &in_c,
 
 }  // namespace
 
-bool ReplayOpsToTables(const uint8_t *records, size_t records_size, uint32_t op_count,
-                       const ReplayLodPolicy &lod_policy,
-                       ReplayTables *tables, std::string *error) {
-  tables->manifold_nodes.clear();
-  tables->has_manifold.clear();
-  tables->cross_nodes.clear();
-  tables->has_cross.clear();
-  tables->cross_plane.clear();
-  tables->node_semantics.clear();
+void EnsureReplayNode(ReplayTables *tables, uint32_t id) {
+  const size_t need = (size_t)id + 1;
+  if (tables->node_kind.size() >= need) return;
+  tables->manifold_nodes.resize(need);
+  tables->cross_nodes.resize(need);
+  tables->node_kind.resize(need, (uint8_t)NodeKind::Unknown);
+  tables->cross_plane.resize(need);
+  tables->node_semantics.resize(need);
+  tables->node_digest.resize(need, 0);
+}
 
+// Ops arrive in topological order, so every input id has already been produced
+// by an earlier record.
+bool ReplayRecord(const OpRecordHeader &hdr, const uint8_t *payload_ptr, const ReplayLodPolicy &lod_policy,
+                  const NodeFusion *fusion, ReplayTables *tables, ReplaySemanticValue *sem_out,
+                  std::string *error) {
   std::vector<manifold::Manifold> &m_nodes = tables->manifold_nodes;
-  std::vector<bool> &has_m = tables->has_manifold;
   std::vector<manifold::CrossSection> &c_nodes = tables->cross_nodes;
-  std::vector<bool> &has_c = tables->has_cross;
+  std::vector<uint8_t> &kinds = tables->node_kind;
   std::vector<SketchPlane> &cross_plane = tables->cross_plane;
-  std::vector<ReplayNodeSemantic> &semantics = tables->node_semantics;
-
-  Reader ops = {records, records_size, 0};
-  uint32_t parsed = 0;
-  while (ops.off < ops.len) {
-    OpRecordHeader hdr = {};
-    if (!read_pod(&ops, &hdr)) {
-      *error = "Replay failed: truncated op header.";
-      return false;
-    }
-    if (ops.off + hdr.payload_len > ops.len) {
-      *error = "Replay failed: truncated op payload.";
-      return false;
-    }
 
-    Reader payload = {ops.ptr + ops.off, hdr.payload_len, 0};
-    ops.off += hdr.payload_len;
-    parsed++;
-
-    uint32_t out_id = 0;
-    if (!read_u32(&payload, &out_id)) {
-      *error = "Replay failed: missing out node id.";
-      return false;
-    }
-    ensure_node(&m_nodes, &has_m, &c_nodes, &has_c, &cross_plane, &semantics, out_id);
-
-    ReplayNodeSemantic sem = {};
-    sem.opcode = hdr.opcode;
-    sem.out_id = out_id;
-
-    switch ((OpCode)hdr.opcode) {
-      case OpCode::Sphere: {
-        double radius = 0.0;
-        uint32_t ignored_segments = 0;
-        if (!read_f64(&payload, &radius) || !read_u32(&payload, &ignored_segments)) {
-          *error = "Replay failed: invalid sphere payload.";
-          return false;
-        }
-        const uint32_t seg = (uint32_t)AutoCircularSegments(radius, lod_policy.profile);
-        manifold::Manifold m = manifold::Manifold::Sphere(radius, (int)seg);
-        if (!check_status(m, "sphere", error)) return false;
-        m_nodes[out_id] = std::move(m);
-        has_m[out_id] = true;
-        sem.params_f64.push_back(radius);
-        sem.params_u32.push_back(seg);
-      } break;
-      case OpCode::Cube: {
-        double x = 0.0, y = 0.0, z = 0.0;
-        uint32_t center = 0;
-        if (!read_f64(&payload, &x) || !read_f64(&payload, &y) || !read_f64(&payload, &z) ||
-            !read_u32(&payload, &center)) {
-          *error = "Replay failed: invalid cube payload.";
-          return false;
-        }
-        manifold::Manifold m = manifold::Manifold::Cube(manifold::vec3(x, y, z), center != 0);
-        if (!check_status(m, "cube", error)) return false;
-        m_nodes[out_id] = std::move(m);
-        has_m[out_id] = true;
-        sem.params_f64 = {x, y, z};
-        sem.params_u32 = {center};
-      } break;
-      case OpCode::Cylinder: {
-        double h = 0.0, r1 = 0.0, r2 = 0.0;
-        uint32_t ignored_segments = 0, center = 0;
-        if (!read_f64(&payload, &h) || !read_f64(&payload, &r1) || !read_f64(&payload, &r2) ||
-            !read_u32(&payload, &ignored_segments) || !read_u32(&payload, &center)) {
-          *error = "Replay failed: invalid cylinder payload.";
-          return false;
-        }
-        const double radius = std::max(std::abs(r1), std::abs(r2));
-        const uint32_t seg = (uint32_t)AutoCircularSegments(radius, lod_policy.profile);
-        manifold::Manifold m = manifold::Manifold::Cylinder(h, r1, r2, (int)seg, center != 0);
-        if (!check_status(m, "cylinder", error)) return false;
-        m_nodes[out_id] = std::move(m);
-        has_m[out_id] = true;
-        sem.params_f64 = {h, r1, r2};
-        sem.params_u32 = {seg, center};
-      } break;
-      case OpCode::Union: {
-        uint32_t count = 0;
-        if (!read_u32(&payload, &count) || count == 0) {
-          *error = "Replay failed: invalid union payload.";
-          return false;
-        }
-        std::vector<manifold::Manifold> parts;
-        parts.reserve(count);
-        sem.params_u32.push_back(count);
-        for (uint32_t i = 0; i < count; ++i) {
-          uint32_t id = 0;
-          if (!read_u32(&payload, &id)) {
-            *error = "Replay failed: invalid union args.";
-            return false;
-          }
-          manifold::Manifold part;
-          if (!need_m(m_nodes, has_m, id, &part, error)) return false;
-          parts.push_back(part);
-          sem.inputs.push_back(id);
-        }
-        manifold::Manifold m = manifold::Manifold::BatchBoolean(parts, manifold::OpType::Add);
-        if (!check_status(m, "union", error)) return false;
-        m_nodes[out_id] = std::move(m);
-        has_m[out_id] = true;
-      } break;
-      case OpCode::Subtract:
-      case OpCode::Intersect: {
-        uint32_t a = 0, b = 0;
-        if (!read_u32(&payload, &a) || !read_u32(&payload, &b)) {
-          *error = "Replay failed: invalid boolean payload.";
+  Reader payload = {payload_ptr, hdr.payload_len, 0};
+  uint32_t out_id = 0;
+  if (!read_u32(&payload, &out_id)) {
+    *error = "Replay failed: missing out node id.";
+    return false;
+  }
+  EnsureReplayNode(tables, out_id);
+
+  ReplaySemanticValue &sem = *sem_out;
+  sem.opcode = hdr.opcode;
+  sem.inputs.clear();
+  sem.params_f64.clear();
+  sem.params_u32.clear();
+  sem.polygons.clear();
+  sem.has_polygons = false;
+  const bool fused = fusion && !fusion->operands.empty();
+  const bool deferred = fusion && fusion->deferred;
+
+  switch ((OpCode)hdr.opcode) {
+    case OpCode::Sphere: {
+      double radius = 0.0;
+      uint32_t ignored_segments = 0;
+      if (!read_f64(&payload, &radius) || !read_u32(&payload, &ignored_segments)) {
+        *error = "Replay failed: invalid sphere payload.";
+        return false;
+      }
+      const uint32_t seg = (uint32_t)AutoCircularSegments(radius, lod_policy);
+      manifold::Manifold m = manifold::Manifold::Sphere(radius, (int)seg);
+      if (!check_status(m, "sphere", error)) return false;
+      m_nodes[out_id] = std::move(m);
+      kinds[out_id] = kManifoldNode;
+      sem.params_f64.push_back(radius);
+      sem.params_u32.push_back(seg);
+    } break;
+    case OpCode::Cube: {
+      double x = 0.0, y = 0.0, z = 0.0;
+      uint32_t center = 0;
+      if (!read_f64(&payload, &x) || !read_f64(&payload, &y) || !read_f64(&payload, &z) ||
+          !read_u32(&payload, &center)) {
+        *error = "Replay failed: invalid cube payload.";
+        return false;
+      }
+      manifold::Manifold m = manifold::Manifold::Cube(manifold::vec3(x, y, z), center != 0);
+      if (!check_status(m, "cube", error)) return false;
+      m_nodes[out_id] = std::move(m);
+      kinds[out_id] = kManifoldNode;
+      sem.params_f64 = {x, y, z};
+      sem.params_u32 = {center};
+    } break;
+    case OpCode::Cylinder: {
+      double h = 0.0, r1 = 0.0, r2 = 0.0;
+      uint32_t ignored_segments = 0, center = 0;
+      if (!read_f64(&payload, &h) || !read_f64(&payload, &r1) || !read_f64(&payload, &r2) ||
+          !read_u32(&payload, &ignored_segments) || !read_u32(&payload, &center)) {
+        *error = "Replay failed: invalid cylinder payload.";
+        return false;
+      }
+      const double radius = std::max(std::abs(r1), std::abs(r2));
+      const uint32_t seg = (uint32_t)AutoCircularSegments(radius, lod_policy);
+      manifold::Manifold m = manifold::Manifold::Cylinder(h, r1, r2, (int)seg, center != 0);
+      if (!check_status(m, "cylinder", error)) return false;
+      m_nodes[out_id] = std::move(m);
+      kinds[out_id] = kManifoldNode;
+      sem.params_f64 = {h, r1, r2};
+      sem.params_u32 = {seg, center};
+    } break;
+    case OpCode::Union: {
+      uint32_t count = 0;
+      if (!read_u32(&payload, &count) || count == 0) {
+        *error = "Replay failed: invalid union payload.";
+        return false;
+      }
+      std::vector<manifold::Manifold> parts;
+      parts.reserve(count);
+      sem.params_u32.push_back(count);
+      for (uint32_t i = 0; i < count; ++i) {
+        uint32_t id = 0;
+        if (!read_u32(&payload, &id)) {
+          *error = "Replay failed: invalid union args.";
           return false;
         }
+        sem.inputs.push_back(id);
+        if (fused) continue;
+        manifold::Manifold part;
+        if (!need_m(*tables, id, &part, error)) return false;
+        parts.push_back(part);
+      }
+      manifold::Manifold m;
+      if (fused) {
+        if (!batch_boolean(*tables, fusion->operands, manifold::OpType::Add, &m, error)) return false;
+      } else {
+        m = UnionByBounds(parts);
+      }
+      if (!deferred && !check_status(m, "union", error)) return false;
+      m_nodes[out_id] = std::move(m);
+      kinds[out_id] = kManifoldNode;
+    } break;
+    case OpCode::Subtract:
+    case OpCode::Intersect: {
+      uint32_t a = 0, b = 0;
+      if (!read_u32(&payload, &a) || !read_u32(&payload, &b)) {
+        *error = "Replay failed: invalid boolean payload.";
+        return false;
+      }
+      const manifold::OpType op =
+          ((OpCode)hdr.opcode == OpCode::Subtract) ? manifold::OpType::Subtract : manifold::OpType::Intersect;
+      manifold::Manifold m;
+      if (fused) {
+        // BatchBoolean subtracts the union of the rest from the first
+        // operand: a - b - c becomes a - (b + c).
+        if (!batch_boolean(*tables, fusion->operands, op, &m, error)) return false;
+      } else {
         manifold::Manifold ma, mb;
-        if (!need_m(m_nodes, has_m, a, &ma, error) || !need_m(m_nodes, has_m, b, &mb, error)) {
-          return false;
-        }
-        const manifold::OpType op =
-            ((OpCode)hdr.opcode == OpCode::Subtract) ? manifold::OpType::Subtract : manifold::OpType::Intersect;
-        manifold::Manifold m = ma.Boolean(mb, op);
-        if (!check_status(m, "boolean", error)) return false;
-        m_nodes[out_id] = std::move(m);
-        has_m[out_id] = true;
-        sem.inputs = {a, b};
-      } break;
-      case OpCode::Translate:
-      case OpCode::Rotate:
-      case OpCode::Scale: {
-        uint32_t in_id = 0;
-        double x = 0.0, y = 0.0, z = 0.0;
-        if (!read_u32(&payload, &in_id) || !read_f64(&payload, &x) || !read_f64(&payload, &y) ||
-            !read_f64(&payload, &z)) {
-          *error = "Replay failed: invalid transform payload.";
-          return false;
-        }
-        manifold::Manifold in_m;
-        if (!need_m(m_nodes, has_m, in_id, &in_m, error)) return false;
-        manifold::Manifold out_m;
-        if ((OpCode)hdr.opcode == OpCode::Translate) {
-          out_m = in_m.Translate(manifold::vec3(x, y, z));
-        } else if ((OpCode)hdr.opcode == OpCode::Rotate) {
-          out_m = in_m.Rotate(x, y, z);
-        } else {
-          out_m = in_m.Scale(manifold::vec3(x, y, z));
-        }
-        if (!check_status(out_m, "transform", error)) return false;
-        m_nodes[out_id] = std::move(out_m);
-        has_m[out_id] = true;
-        sem.inputs = {in_id};
-        sem.params_f64 = {x, y, z};
-      } break;
-      case OpCode::CrossCircle: {
-        double radius = 0.0;
-        uint32_t ignored_segments = 0;
-        if (!read_f64(&payload, &radius) || !read_u32(&payload, &ignored_segments)) {
-          *error = "Replay failed: invalid cross circle payload.";
-          return false;
-        }
-        const uint32_t seg = (uint32_t)AutoCircularSegments(radius, lod_policy.profile);
-        c_nodes[out_id] = manifold::CrossSection::Circle(radius, (int)seg);
-        has_c[out_id] = true;
-        cross_plane[out_id] = default_sketch_plane();
-        sem.params_f64 = {radius};
-        sem.params_u32 = {seg};
-      } break;
-      case OpCode::CrossSquare: {
-        double x = 0.0, y = 0.0;
-        uint32_t center = 0;
-        if (!read_f64(&payload, &x) || !read_f64(&payload, &y) || !read_u32(&payload, &center)) {
-          *error = "Replay failed: invalid cross square payload.";
-          return false;
-        }
-        c_nodes[out_id] = manifold::CrossSection::Square(manifold::vec2(x, y), center != 0);
-        has_c[out_id] = true;
-        cross_plane[out_id] = default_sketch_plane();
-        sem.params_f64 = {x, y};
-        sem.params_u32 = {center};
-      } break;
-      case OpCode::CrossRect: {
-        double x = 0.0, y = 0.0;
-        uint32_t center = 0;
-        if (!read_f64(&payload, &x) || !read_f64(&payload, &y) || !read_u32(&payload, &center)) {
-          *error = "Replay failed: invalid cross rect payload.";
-          return false;
-        }
-        c_nodes[out_id] = manifold::CrossSection::Square(manifold::vec2(x, y), center != 0);
-        has_c[out_id] = true;
-        cross_plane[out_id] = default_sketch_plane();
-        sem.params_f64 = {x, y};
-        sem.params_u32 = {center};
-      } break;
-      case OpCode::CrossPoint: {
-        double x = 0.0, y = 0.0, radius = 0.0;
-        uint32_t ignored_segments = 0;
-        if (!read_f64(&payload, &x) || !read_f64(&payload, &y) || !read_f64(&payload, &radius) ||
-            !read_u32(&payload, &ignored_segments)) {
-          *error = "Replay failed: invalid cross point payload.";
+        if (!need_m(*tables, a, &ma, error) || !need_m(*tables, b, &mb, error)) {
           return false;
         }
-        const uint32_t seg = (uint32_t)AutoCircularSegments(radius, lod_policy.profile);
-        c_nodes[out_id] =
-            manifold::CrossSection::Circle(radius, (int)seg).Translate(manifold::vec2(x, y));
-        has_c[out_id] = true;
-        cross_plane[out_id] = default_sketch_plane();
-        sem.params_f64 = {x, y, radius};
-        sem.params_u32 = {seg};
-      } break;
-      case OpCode::CrossPolygons: {
-        uint32_t contour_count = 0;
-        if (!read_u32(&payload, &contour_count) || contour_count == 0) {
-          *error = "Replay failed: invalid cross polygons payload.";
+        m = ma.Boolean(mb, op);
+      }
+      if (!deferred && !check_status(m, "boolean", error)) return false;
+      m_nodes[out_id] = std::move(m);
+      kinds[out_id] = kManifoldNode;
+      sem.inputs = {a, b};
+    } break;
+    case OpCode::Translate:
+    case OpCode::Rotate:
+    case OpCode::Scale: {
+      uint32_t in_id = 0;
+      double x = 0.0, y = 0.0, z = 0.0;
+      if (!read_u32(&payload, &in_id) || !read_f64(&payload, &x) || !read_f64(&payload, &y) ||
+          !read_f64(&payload, &z)) {
+        *error = "Replay failed: invalid transform payload.";
+        return false;
+      }
+      manifold::Manifold in_m;
+      if (!need_m(*tables, in_id, &in_m, error)) return false;
+      manifold::Manifold out_m;
+      if ((OpCode)hdr.opcode == OpCode::Translate) {
+        out_m = in_m.Translate(manifold::vec3(x, y, z));
+      } else if ((OpCode)hdr.opcode == OpCode::Rotate) {
+        out_m = in_m.Rotate(x, y, z);
+      } else {
+        out_m = in_m.Scale(manifold::vec3(x, y, z));
+      }
+      if (!deferred && !check_status(out_m, "transform", error)) return false;
+      m_nodes[out_id] = std::move(out_m);
+      kinds[out_id] = kManifoldNode;
+      sem.inputs = {in_id};
+      sem.params_f64 = {x, y, z};
+    } break;
+    case OpCode::CrossCircle: {
+      double radius = 0.0;
+      uint32_t ignored_segments = 0;
+      if (!read_f64(&payload, &radius) || !read_u32(&payload, &ignored_segments)) {
+        *error = "Replay failed: invalid cross circle payload.";
+        return false;
+      }
+      const uint32_t seg = (uint32_t)AutoCircularSegments(radius, lod_policy);
+      c_nodes[out_id] = manifold::CrossSection::Circle(radius, (int)seg);
+      kinds[out_id] = kCrossNode;
+      cross_plane[out_id] = default_sketch_plane();
+      sem.params_f64 = {radius};
+      sem.params_u32 = {seg};
+    } break;
+    case OpCode::CrossSquare: {
+      double x = 0.0, y = 0.0;
+      uint32_t center = 0;
+      if (!read_f64(&payload, &x) || !read_f64(&payload, &y) || !read_u32(&payload, &center)) {
+        *error = "Replay failed: invalid cross square payload.";
+        return false;
+      }
+      c_nodes[out_id] = manifold::CrossSection::Square(manifold::vec2(x, y), center != 0);
+      kinds[out_id] = kCrossNode;
+      cross_plane[out_id] = default_sketch_plane();
+      sem.params_f64 = {x, y};
+      sem.params_u32 = {center};
+    } break;
+    case OpCode::CrossRect: {
+      double x = 0.0, y = 0.0;
+      uint32_t center = 0;
+      if (!read_f64(&payload, &x) || !read_f64(&payload, &y) || !read_u32(&payload, &center)) {
+        *error = "Replay failed: invalid cross rect payload.";
+        return false;
+      }
+      c_nodes[out_id] = manifold::CrossSection::Square(manifold::vec2(x, y), center != 0);
+      kinds[out_id] = kCrossNode;
+      cross_plane[out_id] = default_sketch_plane();
+      sem.params_f64 = {x, y};
+      sem.params_u32 = {center};
+    } break;
+    case OpCode::CrossPoint: {
+      double x = 0.0, y = 0.0, radius = 0.0;
+      uint32_t ignored_segments = 0;
+      if (!read_f64(&payload, &x) || !read_f64(&payload, &y) || !read_f64(&payload, &radius) ||
+          !read_u32(&payload, &ignored_segments)) {
+        *error = "Replay failed: invalid cross point payload.";
+        return false;
+      }
+      const uint32_t seg = (uint32_t)AutoCircularSegments(radius, lod_policy);
+      c_nodes[out_id] =
+          manifold::CrossSection::Circle(radius, (int)seg).Translate(manifold::vec2(x, y));
+      kinds[out_id] = kCrossNode;
+      cross_plane[out_id] = default_sketch_plane();
+      sem.params_f64 = {x, y, radius};
+      sem.params_u32 = {seg};
+    } break;
+    case OpCode::CrossPolygons: {
+      uint32_t contour_count = 0;
+      if (!read_u32(&payload, &contour_count) || contour_count == 0) {
+        *error = "Replay failed: invalid cross polygons payload.";
+        return false;
+      }
+      // Contours are decoded straight into the semantic value, which the
+      // cross section is then built from.
+      manifold::Polygons &polys = sem.polygons;
+      polys.resize(contour_count);
+      for (uint32_t c = 0; c < contour_count; ++c) {
+        uint32_t point_count = 0;
+        if (!read_u32(&payload, &point_count) || point_count < 3) {
+          *error = "Replay failed: invalid cross polygon contour payload.";
           return false;
         }
-        manifold::Polygons polys;
-        polys.reserve(contour_count);
-        for (uint32_t c = 0; c < contour_count; ++c) {
-          uint32_t point_count = 0;
-          if (!read_u32(&payload, &point_count) || point_count < 3) {
-            *error = "Replay failed: invalid cross polygon contour payload.";
-            return false;
-          }
-          manifold::SimplePolygon poly;
-          poly.reserve(point_count);
-          for (uint32_t i = 0; i < point_count; ++i) {
-            double x = 0.0, y = 0.0;
-            if (!read_f64(&payload, &x) || !read_f64(&payload, &y)) {
-              *error = "Replay failed: invalid cross polygon point payload.";
-              return false;
-            }
-            poly.push_back(manifold::vec2(x, y));
-          }
-          polys.push_back(std::move(poly));
-        }
-        c_nodes[out_id] = manifold::CrossSection(polys, manifold::CrossSection::FillRule::Positive);
-        has_c[out_id] = true;
-        cross_plane[out_id] = default_sketch_plane();
-        sem.has_polygons = true;
-        sem.polygons = polys;
-      } break;
-      case OpCode::CrossTranslate: {
-        uint32_t in_id = 0;
-        double x = 0.0, y = 0.0;
-        if (!read_u32(&payload, &in_id) || !read_f64(&payload, &x) || !read_f64(&payload, &y)) {
-          *error = "Replay failed: invalid cross translate payload.";
+        if (!read_points(&payload, point_count, &polys[c])) {
+          *error = "Replay failed: invalid cross polygon point payload.";
           return false;
         }
-        manifold::CrossSection in_c;
-        if (!need_c(c_nodes, has_c, in_id, &in_c, error)) return false;
-        c_nodes[out_id] = in_c.Translate(manifold::vec2(x, y));
-        has_c[out_id] = true;
-        cross_plane[out_id] = ((size_t)in_id < cross_plane.size()) ? cross_plane[in_id] : default_sketch_plane();
-        sem.inputs = {in_id};
-        sem.params_f64 = {x, y};
-      } break;
-      case OpCode::CrossRotate: {
-        uint32_t in_id = 0;
-        double deg = 0.0;
-        if (!read_u32(&payload, &in_id) || !read_f64(&payload, &deg)) {
-          *error = "Replay failed: invalid cross rotate payload.";
+      }
+      c_nodes[out_id] = manifold::CrossSection(polys, manifold::CrossSection::FillRule::Positive);
+      kinds[out_id] = kCrossNode;
+      cross_plane[out_id] = default_sketch_plane();
+      sem.has_polygons = true;
+    } break;
+    case OpCode::CrossTranslate: {
+      uint32_t in_id = 0;
+      double x = 0.0, y = 0.0;
+      if (!read_u32(&payload, &in_id) || !read_f64(&payload, &x) || !read_f64(&payload, &y)) {
+        *error = "Replay failed: invalid cross translate payload.";
+        return false;
+      }
+      manifold::CrossSection in_c;
+      if (!need_c(*tables, in_id, &in_c, error)) return false;
+      c_nodes[out_id] = in_c.Translate(manifold::vec2(x, y));
+      kinds[out_id] = kCrossNode;
+      cross_plane[out_id] = ((size_t)in_id < cross_plane.size()) ? cross_plane[in_id] : default_sketch_plane();
+      sem.inputs = {in_id};
+      sem.params_f64 = {x, y};
+    } break;
+    case OpCode::CrossRotate: {
+      uint32_t in_id = 0;
+      double deg = 0.0;
+      if (!read_u32(&payload, &in_id) || !read_f64(&payload, &deg)) {
+        *error = "Replay failed: invalid cross rotate payload.";
+        return false;
+      }
+      manifold::CrossSection in_c;
+      if (!need_c(*tables, in_id, &in_c, error)) return false;
+      c_nodes[out_id] = in_c.Rotate(deg);
+      kinds[out_id] = kCrossNode;
+      cross_plane[out_id] = ((size_t)in_id < cross_plane.size()) ? cross_plane[in_id] : default_sketch_plane();
+      sem.inputs = {in_id};
+      sem.params_f64 = {deg};
+    } break;
+    case OpCode::CrossFillet: {
+      uint32_t in_id = 0;
+      double radius = 0.0;
+      if (!read_u32(&payload, &in_id) || !read_f64(&payload, &radius)) {
+        *error = "Replay failed: invalid cross fillet payload.";
+        return false;
+      }
+      if (radius < 0.0) {
+        *error = "Replay failed: cross fillet radius must be >= 0.";
+        return false;
+      }
+      manifold::CrossSection in_c;
+      if (!need_c(*tables, in_id, &in_c, error)) return false;
+      if (radius == 0.0) {
+        c_nodes[out_id] = in_c;
+        kinds[out_id] = kCrossNode;
+      } else {
+        manifold::CrossSection inset = in_c.Offset(-radius, manifold::CrossSection::JoinType::Miter);
+        if (inset.IsEmpty()) {
+          *error = "Replay failed: fillet radius is too large for this cross-section.";
           return false;
         }
-        manifold::CrossSection in_c;
-        if (!need_c(c_nodes, has_c, in_id, &in_c, error)) return false;
-        c_nodes[out_id] = in_c.Rotate(deg);
-        has_c[out_id] = true;
-        cross_plane[out_id] = ((size_t)in_id < cross_plane.size()) ? cross_plane[in_id] : default_sketch_plane();
-        sem.inputs = {in_id};
-        sem.params_f64 = {deg};
-      } break;
-      case OpCode::CrossFillet: {
-        uint32_t in_id = 0;
-        double radius = 0.0;
-        if (!read_u32(&payload, &in_id) || !read_f64(&payload, &radius)) {
-          *error = "Replay failed: invalid cross fillet payload.";
+        const int fillet_segments =
+            AutoCircularSegments(std::abs(radius), lod_policy);
+        manifold::CrossSection rounded =
+            inset.Offset(radius, manifold::CrossSection::JoinType::Round,
+                         2.0, fillet_segments);
+        if (rounded.IsEmpty()) {
+          *error = "Replay failed: fillet operation produced an empty cross-section.";
           return false;
         }
-        if (radius < 0.0) {
-          *error = "Replay failed: cross fillet radius must be >= 0.";
+        c_nodes[out_id] = std::move(rounded);
+        kinds[out_id] = kCrossNode;
+      }
+      cross_plane[out_id] = ((size_t)in_id < cross_plane.size()) ? cross_plane[in_id] : default_sketch_plane();
+      sem.inputs = {in_id};
+      sem.params_f64 = {radius};
+    } break;
+    case OpCode::CrossFilletCorners: {
+      uint32_t in_id = 0;
+      uint32_t corner_count = 0;
+      if (!read_u32(&payload, &in_id) || !read_u32(&payload, &corner_count) || corner_count == 0) {
+        *error = "Replay failed: invalid cross fillet corners payload.";
+        return false;
+      }
+      manifold::CrossSection in_c;
+      if (!need_c(*tables, in_id, &in_c, error)) return false;
+
+      std::vector<CornerFilletSpec> specs;
+      specs.reserve(corner_count);
+      sem.params_u32.push_back(corner_count);
+      for (uint32_t i = 0; i < corner_count; ++i) {
+        CornerFilletSpec spec = {};
+        if (!read_u32(&payload, &spec.contour) || !read_u32(&payload, &spec.vertex) ||
+            !read_f64(&payload, &spec.radius)) {
+          *error = "Replay failed: invalid cross fillet corner entry payload.";
           return false;
         }
-        manifold::CrossSection in_c;
-        if (!need_c(c_nodes, has_c, in_id, &in_c, error)) return false;
-        if (radius == 0.0) {
-          c_nodes[out_id] = in_c;
-          has_c[out_id] = true;
-        } else {
-          manifold::CrossSection inset = in_c.Offset(-radius, manifold::CrossSection::JoinType::Miter);
-          if (inset.IsEmpty()) {
-            *error = "Replay failed: fillet radius is too large for this cross-section.";
-            return false;
-          }
-          const int fillet_segments =
-              AutoCircularSegments(std::abs(radius), lod_policy.profile);
-          manifold::CrossSection rounded =
-              inset.Offset(radius, manifold::CrossSection::JoinType::Round,
-                           2.0, fillet_segments);
-          if (rounded.IsEmpty()) {
-            *error = "Replay failed: fillet operation produced an empty cross-section.";
-            return false;
-          }
-          c_nodes[out_id] = std::move(rounded);
-          has_c[out_id] = true;
-        }
-        cross_plane[out_id] = ((size_t)in_id < cross_plane.size()) ? cross_plane[in_id] : default_sketch_plane();
-        sem.inputs = {in_id};
-        sem.params_f64 = {radius};
-      } break;
-      case OpCode::CrossFilletCorners: {
-        uint32_t in_id = 0;
-        uint32_t corner_count = 0;
-        if (!read_u32(&payload, &in_id) || !read_u32(&payload, &corner_count) || corner_count == 0) {
-          *error = "Replay failed: invalid cross fillet corners payload.";
+        if (!std::isfinite(spec.radius) || spec.radius < 0.0) {
+          *error = "Replay failed: cross fillet corner radius must be finite and >= 0.";
           return false;
         }
-        manifold::CrossSection in_c;
-        if (!need_c(c_nodes, has_c, in_id, &in_c, error)) return false;
-
-        std::vector<CornerFilletSpec> specs;
-        specs.reserve(corner_count);
-        sem.params_u32.push_back(corner_count);
-        for (uint32_t i = 0; i < corner_count; ++i) {
-          CornerFilletSpec spec = {};
-          if (!read_u32(&payload, &spec.contour) || !read_u32(&payload, &spec.vertex) ||
-              !read_f64(&payload, &spec.radius)) {
-            *error = "Replay failed: invalid cross fillet corner entry payload.";
-            return false;
-          }
-          if (!std::isfinite(spec.radius) || spec.radius < 0.0) {
-            *error = "Replay failed: cross fillet corner radius must be finite and >= 0.";
-            return false;
-          }
-          specs.push_back(spec);
-          sem.params_u32.push_back(spec.contour);
-          sem.params_u32.push_back(spec.vertex);
-          sem.params_f64.push_back(spec.radius);
-        }
+        specs.push_back(spec);
+        sem.params_u32.push_back(spec.contour);
+        sem.params_u32.push_back(spec.vertex);
+        sem.params_f64.push_back(spec.radius);
+      }
 
-        manifold::CrossSection out_c;
-        if (!apply_corner_fillets(in_c, specs, lod_policy, &out_c, error)) return false;
-        c_nodes[out_id] = std::move(out_c);
-        has_c[out_id] = true;
-        cross_plane[out_id] =
-            ((size_t)in_id < cross_plane.size()) ? cross_plane[in_id] : default_sketch_plane();
-        sem.inputs = {in_id};
-      } break;
-      case OpCode::CrossOffsetClone: {
-        uint32_t in_id = 0;
-        double delta = 0.0;
-        if (!read_u32(&payload, &in_id) || !read_f64(&payload, &delta)) {
-          *error = "Replay failed: invalid cross offset clone payload.";
-          return false;
-        }
-        manifold::CrossSection in_c;
-        if (!need_c(c_nodes, has_c, in_id, &in_c, error)) return false;
-        manifold::CrossSection out_c = in_c.Offset(delta, manifold::CrossSection::JoinType::Miter);
-        if (out_c.IsEmpty()) {
-          *error = "Replay failed: offsetClone produced an empty cross-section.";
-          return false;
-        }
-        c_nodes[out_id] = std::move(out_c);
-        has_c[out_id] = true;
-        cross_plane[out_id] = ((size_t)in_id < cross_plane.size()) ? cross_plane[in_id] : default_sketch_plane();
-        sem.inputs = {in_id};
-        sem.params_f64 = {delta};
-      } break;
-      case OpCode::CrossPlane: {
-        uint32_t in_id = 0;
-        uint32_t kind_u32 = 0;
-        double offset = 0.0;
-        if (!read_u32(&payload, &in_id) || !read_u32(&payload, &kind_u32) || !read_f64(&payload, &offset)) {
-          *error = "Replay failed: invalid cross plane payload.";
-          return false;
-        }
-        if (!valid_plane_kind(kind_u32)) {
-          *error = "Replay failed: invalid cross plane kind.";
-          return false;
-        }
-        if (!std::isfinite(offset)) {
-          *error = "Replay failed: invalid cross plane offset.";
-          return false;
-        }
-        manifold::CrossSection in_c;
-        if (!need_c(c_nodes, has_c, in_id, &in_c, error)) return false;
-        c_nodes[out_id] = in_c;
-        has_c[out_id] = true;
-        cross_plane[out_id] = {static_cast<SketchPlaneKind>(kind_u32), offset};
-        sem.inputs = {in_id};
-        sem.params_u32 = {kind_u32};
-        sem.params_f64 = {offset};
-      } break;
-      case OpCode::Extrude: {
-        uint32_t cs_id = 0;
-        double h = 0.0, twist = 0.0;
-        uint32_t div = 0;
-        if (!read_u32(&payload, &cs_id) || !read_f64(&payload, &h) || !read_u32(&payload, &div) ||
-            !read_f64(&payload, &twist)) {
-          *error = "Replay failed: invalid extrude payload.";
-          return false;
-        }
-        manifold::CrossSection cs;
-        if (!need_c(c_nodes, has_c, cs_id, &cs, error)) return false;
-        manifold::Manifold m = manifold::Manifold::Extrude(cs.ToPolygons(), h, (int)div, twist);
-        const SketchPlane plane =
-            ((size_t)cs_id < cross_plane.size()) ? cross_plane[cs_id] : default_sketch_plane();
-        m = apply_plane_to_manifold(m, plane);
-        if (!check_status(m, "extrude", error)) return false;
-        m_nodes[out_id] = std::move(m);
-        has_m[out_id] = true;
-        sem.inputs = {cs_id};
-        sem.params_f64 = {h, twist};
-        sem.params_u32 = {div};
-      } break;
-      case OpCode::Revolve: {
-        uint32_t cs_id = 0, ignored_segments = 0;
-        double deg = 0.0;
-        if (!read_u32(&payload, &cs_id) || !read_u32(&payload, &ignored_segments) || !read_f64(&payload, &deg)) {
-          *error = "Replay failed: invalid revolve payload.";
-          return false;
-        }
-        manifold::CrossSection cs;
-        if (!need_c(c_nodes, has_c, cs_id, &cs, error)) return false;
-        const manifold::Polygons polys = cs.ToPolygons();
-        const double radius = revolve_effective_radius(polys);
-        const uint32_t seg =
-            (uint32_t)AutoCircularSegmentsForRevolve(radius, deg, lod_policy.profile);
-        manifold::Manifold m = manifold::Manifold::Revolve(polys, (int)seg, deg);
-        const SketchPlane plane =
-            ((size_t)cs_id < cross_plane.size()) ? cross_plane[cs_id] : default_sketch_plane();
-        m = apply_plane_to_manifold(m, plane);
-        if (!check_status(m, "revolve", error)) return false;
-        m_nodes[out_id] = std::move(m);
-        has_m[out_id] = true;
-        sem.inputs = {cs_id};
-        sem.params_u32 = {seg};
-        sem.params_f64 = {deg};
-      } break;
-      case OpCode::Slice: {
-        uint32_t in_id = 0;
-        double z = 0.0;
-        if (!read_u32(&payload, &in_id) || !read_f64(&payload, &z)) {
-          *error = "Replay failed: invalid slice payload.";
-          return false;
-        }
-        manifold::Manifold in_m;
-        if (!need_m(m_nodes, has_m, in_id, &in_m, error)) return false;
-        c_nodes[out_id] =
-            manifold::CrossSection(in_m.Slice(z), manifold::CrossSection::FillRule::Positive);
-        has_c[out_id] = true;
-        cross_plane[out_id] = default_sketch_plane();
-        sem.inputs = {in_id};
-        sem.params_f64 = {z};
-      } break;
-      default:
-        *error = "Replay failed: unknown opcode " + std::to_string(hdr.opcode);
+      manifold::CrossSection out_c;
+      if (!apply_corner_fillets(in_c, specs, lod_policy, &out_c, error)) return false;
+      c_nodes[out_id] = std::move(out_c);
+      kinds[out_id] = kCrossNode;
+      cross_plane[out_id] =
+          ((size_t)in_id < cross_plane.size()) ? cross_plane[in_id] : default_sketch_plane();
+      sem.inputs = {in_id};
+    } break;
+    case OpCode::CrossOffsetClone: {
+      uint32_t in_id = 0;
+      double delta = 0.0;
+      if (!read_u32(&payload, &in_id) || !read_f64(&payload, &delta)) {
+        *error = "Replay failed: invalid cross offset clone payload.";
         return false;
-    }
-
-    if (payload.off != payload.len) {
-      *error = "Replay failed: payload trailing bytes for opcode " + std::to_string(hdr.opcode);
+      }
+      manifold::CrossSection in_c;
+      if (!need_c(*tables, in_id, &in_c, error)) return false;
+      manifold::CrossSection out_c = in_c.Offset(delta, manifold::CrossSection::JoinType::Miter);
+      if (out_c.IsEmpty()) {
+        *error = "Replay failed: offsetClone produced an empty cross-section.";
+        return false;
+      }
+      c_nodes[out_id] = std::move(out_c);
+      kinds[out_id] = kCrossNode;
+      cross_plane[out_id] = ((size_t)in_id < cross_plane.size()) ? cross_plane[in_id] : default_sketch_plane();
+      sem.inputs = {in_id};
+      sem.params_f64 = {delta};
+    } break;
+    case OpCode::CrossPlane: {
+      uint32_t in_id = 0;
+      uint32_t kind_u32 = 0;
+      double offset = 0.0;
+      if (!read_u32(&payload, &in_id) || !read_u32(&payload, &kind_u32) || !read_f64(&payload, &offset)) {
+        *error = "Replay failed: invalid cross plane payload.";
+        return false;
+      }
+      if (!valid_plane_kind(kind_u32)) {
+        *error = "Replay failed: invalid cross plane kind.";
+        return false;
+      }
+      if (!std::isfinite(offset)) {
+        *error = "Replay failed: invalid cross plane offset.";
+        return false;
+      }
+      manifold::CrossSection in_c;
+      if (!need_c(*tables, in_id, &in_c, error)) return false;
+      c_nodes[out_id] = in_c;
+      kinds[out_id] = kCrossNode;
+      cross_plane[out_id] = {static_cast<SketchPlaneKind>(kind_u32), offset};
+      sem.inputs = {in_id};
+      sem.params_u32 = {kind_u32};
+      sem.params_f64 = {offset};
+    } break;
+    case OpCode::Extrude: {
+      uint32_t cs_id = 0;
+      double h = 0.0, twist = 0.0;
+      uint32_t div = 0;
+      if (!read_u32(&payload, &cs_id) || !read_f64(&payload, &h) || !read_u32(&payload, &div) ||
+          !read_f64(&payload, &twist)) {
+        *error = "Replay failed: invalid extrude payload.";
+        return false;
+      }
+      manifold::CrossSection cs;
+      if (!need_c(*tables, cs_id, &cs, error)) return false;
+      manifold::Manifold m = manifold::Manifold::Extrude(cs.ToPolygons(), h, (int)div, twist);
+      const SketchPlane plane =
+          ((size_t)cs_id < cross_plane.size()) ? cross_plane[cs_id] : default_sketch_plane();
+      m = apply_plane_to_manifold(m, plane);
+      if (!deferred && !check_status(m, "extrude", error)) return false;
+      m_nodes[out_id] = std::move(m);
+      kinds[out_id] = kManifoldNode;
+      sem.inputs = {cs_id};
+      sem.params_f64 = {h, twist};
+      sem.params_u32 = {div};
+    } break;
+    case OpCode::Revolve: {
+      uint32_t cs_id = 0, ignored_segments = 0;
+      double deg = 0.0;
+      if (!read_u32(&payload, &cs_id) || !read_u32(&payload, &ignored_segments) || !read_f64(&payload, &deg)) {
+        *error = "Replay failed: invalid revolve payload.";
+        return false;
+      }
+      manifold::CrossSection cs;
+      if (!need_c(*tables, cs_id, &cs, error)) return false;
+      const manifold::Polygons polys = cs.ToPolygons();
+      const double radius = revolve_effective_radius(polys);
+      const uint32_t seg =
+          (uint32_t)AutoCircularSegmentsForRevolve(radius, deg, lod_policy);
+      manifold::Manifold m = manifold::Manifold::Revolve(polys, (int)seg, deg);
+      const SketchPlane plane =
+          ((size_t)cs_id < cross_plane.size()) ? cross_plane[cs_id] : default_sketch_plane();
+      m = apply_plane_to_manifold(m, plane);
+      if (!deferred && !check_status(m, "revolve", error)) return false;
+      m_nodes[out_id] = std::move(m);
+      kinds[out_id] = kManifoldNode;
+      sem.inputs = {cs_id};
+      sem.params_u32 = {seg};
+      sem.params_f64 = {deg};
+    } break;
+    case OpCode::Slice: {
+      uint32_t in_id = 0;
+      double z = 0.0;
+      if (!read_u32(&payload, &in_id) || !read_f64(&payload, &z)) {
+        *error = "Replay failed: invalid slice payload.";
+        return false;
+      }
+      manifold::Manifold in_m;
+      if (!need_m(*tables, in_id, &in_m, error)) return false;
+      c_nodes[out_id] =
+          manifold::CrossSection(in_m.Slice(z), manifold::CrossSection::FillRule::Positive);
+      kinds[out_id] = kCrossNode;
+      cross_plane[out_id] = default_sketch_plane();
+      sem.inputs = {in_id};
+      sem.params_f64 = {z};
+    } break;
+    default:
+      *error = "Replay failed: unknown opcode " + std::to_string(hdr.opcode);
       return false;
-    }
-
-    sem.valid = true;
-    semantics[out_id] = std::move(sem);
   }
 
-  if (parsed != op_count) {
-    *error = "Replay failed: op count mismatch.";
+  if (payload.off != payload.len) {
+    *error = "Replay failed: payload trailing bytes for opcode " + std::to_string(hdr.opcode);
     return false;
   }
+
   return true;
 }
 
@@ -878,7 +886,7 @@ bool ResolveReplayManifold(const ReplayTables &tables, uint32_t root_kind, uint3
     *error = "Replay failed: root node is not a manifold.";
     return false;
   }
-  if ((size_t)root_id >= tables.manifold_nodes.size() || !tables.has_manifold[root_id]) {
+  if (!ReplayNodeIs(tables, root_id, NodeKind::Manifold)) {
     *error = "Replay failed: root manifold node missing.";
     return false;
   }
@@ -896,7 +904,7 @@ bool ResolveReplayCrossSection(const ReplayTables &tables, uint32_t root_kind, u
     *error = "Replay failed: root node is not a cross-section.";
     return false;
   }
-  if ((size_t)root_id >= tables.cross_nodes.size() || !tables.has_cross[root_id]) {
+  if (!ReplayNodeIs(tables, root_id, NodeKind::CrossSection)) {
     *error = "Replay failed: root cross-section node missing.";
     return false;
   }
@@ -914,7 +922,7 @@ bool ResolveReplayCrossSectionPlane(const ReplayTables &tables, uint32_t root_ki
     *error = "Replay failed: root node is not a cross-section.";
     return false;
   }
-  if ((size_t)root_id >= tables.cross_nodes.size() || !tables.has_cross[root_id]) {
+  if (!ReplayNodeIs(tables, root_id, NodeKind::CrossSection)) {
     *error = "Replay failed: root cross-section node missing.";
     return false;
   }
@@ -926,19 +934,4 @@ bool ResolveReplayCrossSectionPlane(const ReplayTables &tables, uint32_t root_ki
   return true;
 }
 
-bool ReplayOpsToMesh(const ReplayInput &in, manifold::MeshGL *mesh, std::string *error) {
-  ReplayTables tables;
-  if (!ReplayOpsToTables(in.records, in.records_size, in.op_count,
-                         in.lod_policy, &tables, error)) {
-    return false;
-  }
-  manifold::Manifold out;
-  if (!ResolveReplayManifold(tables, in.root_kind, in.root_id,
-                             in.lod_policy, &out, error)) {
-    return false;
-  }
-  *mesh = out.GetMeshGL();
-  return true;
-}
-
 }  // namespace vicad
@@ -3,11 +3,14 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
 #include "manifold/manifold.h"
 #include "manifold/cross_section.h"
+#include "ipc_protocol.h"
 #include "lod_policy.h"
 #include "sketch_dimensions.h"
 
@@ -24,29 +27,82 @@ struct SketchPlane {
   double offset = 0.0;
 };
 
+// Offset and length of a run of values in a ReplaySemanticArena array.
+struct ReplaySpan {
+  uint32_t offset = 0;
+  uint32_t count = 0;
+};
+
+// Contiguous storage for the variable-length parts of every node semantic, so
+// a replay does not allocate per node and trace/dimension walks stay local.
+struct ReplaySemanticArena {
+  std::vector<uint32_t> u32;
+  std::vector<double> f64;
+  std::vector<manifold::vec2> points;
+};
+
+// `inputs`, `params_u32` and `ring_sizes` index ReplaySemanticArena::u32,
+// `params_f64` indexes f64 and `points` indexes points. A polygon payload is
+// stored as its ring sizes plus the concatenated ring points.
 struct ReplayNodeSemantic {
   uint16_t opcode = 0;
   uint32_t out_id = 0;
+  ReplaySpan inputs;
+  ReplaySpan params_f64;
+  ReplaySpan params_u32;
+  ReplaySpan ring_sizes;
+  ReplaySpan points;
+  bool has_polygons = false;
+  bool valid = false;
+};
+
+// Self-contained copy of one node's semantic, outside any arena: what replay
+// builds before committing a node and what the replay cache keeps across runs.
+struct ReplaySemanticValue {
+  uint16_t opcode = 0;
   std::vector<uint32_t> inputs;
   std::vector<double> params_f64;
   std::vector<uint32_t> params_u32;
   manifold::Polygons polygons;
   bool has_polygons = false;
-  bool valid = false;
 };
 
+// Structure-of-arrays node storage indexed by node id. node_kind holds a
+// NodeKind byte per node (Unknown until produced); bytes rather than bits let
+// replay tasks on different threads set distinct nodes without sharing a word.
 struct ReplayTables {
   std::vector<manifold::Manifold> manifold_nodes;
-  std::vector<bool> has_manifold;
   std::vector<manifold::CrossSection> cross_nodes;
-  std::vector<bool> has_cross;
+  std::vector<uint8_t> node_kind;
   std::vector<SketchPlane> cross_plane;
   std::vector<ReplayNodeSemantic> node_semantics;
+  ReplaySemanticArena semantic_arena;
+  // Content digest of the record that produced each node; 0 when unknown.
+  std::vector<uint64_t> node_digest;
 };
 
-bool ReplayOpsToTables(const uint8_t *records, size_t records_size, uint32_t op_count,
-                       const ReplayLodPolicy &lod_policy,
-                       ReplayTables *tables, std::string *error);
+inline bool ReplayNodeIs(const ReplayTables &tables, uint32_t id, NodeKind kind) {
+  return (size_t)id < tables.node_kind.size() && tables.node_kind[id] == (uint8_t)kind;
+}
+
+inline std::span<const uint32_t> ReplaySemanticInputs(const ReplayTables &tables, const ReplayNodeSemantic &s) {
+  return {tables.semantic_arena.u32.data() + s.inputs.offset, s.inputs.count};
+}
+
+inline std::span<const double> ReplaySemanticF64(const ReplayTables &tables, const ReplayNodeSemantic &s) {
+  return {tables.semantic_arena.f64.data() + s.params_f64.offset, s.params_f64.count};
+}
+
+inline std::span<const uint32_t> ReplaySemanticU32(const ReplayTables &tables, const ReplayNodeSemantic &s) {
+  return {tables.semantic_arena.u32.data() + s.params_u32.offset, s.params_u32.count};
+}
+
+// Grows every table to hold node `id`.
+void EnsureReplayNode(ReplayTables *tables, uint32_t id);
+
+// Rebuilds the polygon payload of a CrossPolygons node.
+manifold::Polygons ReplaySemanticPolygons(const ReplayTables &tables, const ReplayNodeSemantic &s);
+
 bool ResolveReplayManifold(const ReplayTables &tables, uint32_t root_kind, uint32_t root_id,
                            const ReplayLodPolicy &lod_policy,
                            manifold::Manifold *out, std::string *error);
@@ -56,19 +112,16 @@ bool ResolveReplayCrossSectionPlane(const ReplayTables &tables, uint32_t root_ki
                                     SketchPlane *out, std::string *error);
 bool BuildSketchDimensionModelForRoot(const ReplayTables &tables, uint32_t root_id,
                                       SketchDimensionModel *out, std::string *error);
+// Dimension models of several sketch roots of the same tables, evaluating
+// shared subtrees once. Entry i is empty when root i has no model.
+void BuildSketchDimensionModels(const ReplayTables &tables, std::span<const uint32_t> root_ids,
+                                std::vector<std::optional<SketchDimensionModel>> *out);
 bool BuildOperationTraceForRoot(const ReplayTables &tables, uint32_t root_kind, uint32_t root_id,
                                 std::vector<OpTraceEntry> *out, std::string *error);
-
-struct ReplayInput {
-  const uint8_t *records;
-  size_t records_size;
-  uint32_t op_count;
-  uint32_t root_kind;
-  uint32_t root_id;
-  // Allows per-call modelling/export profile selection and future postprocess.
-  ReplayLodPolicy lod_policy = {};
-};
-bool ReplayOpsToMesh(const ReplayInput &in, manifold::MeshGL *mesh, std::string *error);
+// Shared operation trace of several roots of the same tables: each node's
+// entry is built once. Span i of out->roots is root i.
+void BuildOperationTraceTable(const ReplayTables &tables, std::span<const uint32_t> root_ids,
+                              OpTraceTable *out);
 
 }  // namespace vicad
 
@@ -1,7 +1,8 @@
 #include "op_decoder.h"
 
 #include <string>
-#include <unordered_set>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "ipc_protocol.h"
@@ -39,18 +40,45 @@ const char *op_name(uint16_t opcode) {
   }
 }
 
+// Table under construction: the entry index of every node built so far, and
+// the last root (as its index + 1) whose walk reached each node.
+struct TraceBuild {
+  std::unordered_map<uint32_t, uint32_t> entry_of;
+  std::unordered_map<uint32_t, uint32_t> reached_by;
+};
+
+uint32_t trace_entry(const ReplayTables &tables, uint32_t id, TraceBuild *build, OpTraceTable *out) {
+  auto [it, inserted] = build->entry_of.try_emplace(id, (uint32_t)out->entries.size());
+  if (!inserted) return it->second;
+  const ReplayNodeSemantic &node = tables.node_semantics[id];
+  OpTraceEntry entry;
+  entry.opcode = node.opcode;
+  entry.name = op_name(node.opcode);
+  entry.outId = node.out_id;
+  entry.args.reserve(node.params_f64.count + node.params_u32.count);
+  for (double v : ReplaySemanticF64(tables, node)) entry.args.push_back(v);
+  for (uint32_t v : ReplaySemanticU32(tables, node)) entry.args.push_back((double)v);
+  out->entries.push_back(std::move(entry));
+  return it->second;
+}
+
 void collect_trace_postorder(const ReplayTables &tables,
                              uint32_t id,
-                             std::unordered_set<uint32_t> *visited,
-                             std::vector<uint32_t> *order) {
+                             uint32_t walk,
+                             TraceBuild *build,
+                             OpTraceTable *out) {
   if ((size_t)id >= tables.node_semantics.size()) return;
   const ReplayNodeSemantic &node = tables.node_semantics[id];
   if (!node.valid) return;
-  if (!visited->insert(id).second) return;
-  for (uint32_t in_id : node.inputs) {
-    collect_trace_postorder(tables, in_id, visited, order);
+  auto [it, inserted] = build->reached_by.try_emplace(id, walk);
+  if (!inserted) {
+    if (it->second == walk) return;
+    it->second = walk;
+  }
+  for (uint32_t in_id : ReplaySemanticInputs(tables, node)) {
+    collect_trace_postorder(tables, in_id, walk, build, out);
   }
-  order->push_back(id);
+  out->order.push_back(trace_entry(tables, id, build, out));
 }
 
 }  // namespace
@@ -63,12 +91,12 @@ bool BuildOperationTraceForRoot(const ReplayTables &tables, uint32_t root_kind,
   }
 
   if (root_kind == (uint32_t)NodeKind::Manifold) {
-    if ((size_t)root_id >= tables.has_manifold.size() || !tables.has_manifold[root_id]) {
+    if (!ReplayNodeIs(tables, root_id, NodeKind::Manifold)) {
       if (error) *error = "Replay failed: root manifold node missing.";
       return false;
     }
   } else if (root_kind == (uint32_t)NodeKind::CrossSection) {
-    if ((size_t)root_id >= tables.has_cross.size() || !tables.has_cross[root_id]) {
+    if (!ReplayNodeIs(tables, root_id, NodeKind::CrossSection)) {
       if (error) *error = "Replay failed: root cross-section node missing.";
       return false;
     }
@@ -77,26 +105,28 @@ bool BuildOperationTraceForRoot(const ReplayTables &tables, uint32_t root_kind,
     return false;
   }
 
-  std::unordered_set<uint32_t> visited;
-  std::vector<uint32_t> order;
-  collect_trace_postorder(tables, root_id, &visited, &order);
+  OpTraceTable table;
+  BuildOperationTraceTable(tables, std::span<const uint32_t>(&root_id, 1), &table);
 
-  out->clear();
-  out->reserve(order.size());
-  for (uint32_t id : order) {
-    if ((size_t)id >= tables.node_semantics.size()) continue;
-    const ReplayNodeSemantic &node = tables.node_semantics[id];
-    if (!node.valid) continue;
-    OpTraceEntry entry;
-    entry.opcode = node.opcode;
-    entry.name = op_name(node.opcode);
-    entry.outId = node.out_id;
-    entry.args.reserve(node.params_f64.size() + node.params_u32.size());
-    for (double v : node.params_f64) entry.args.push_back(v);
-    for (uint32_t v : node.params_u32) entry.args.push_back((double)v);
-    out->push_back(std::move(entry));
-  }
+  // A single walk builds entries in trace order.
+  *out = std::move(table.entries);
   return true;
 }
 
+void BuildOperationTraceTable(const ReplayTables &tables, std::span<const uint32_t> root_ids,
+                              OpTraceTable *out) {
+  out->entries.clear();
+  out->order.clear();
+  out->roots.assign(root_ids.size(), OpTraceSpan{});
+  TraceBuild build;
+  for (size_t i = 0; i < root_ids.size(); ++i) {
+    const uint32_t id = root_ids[i];
+    OpTraceSpan &span = out->roots[i];
+    span.offset = (uint32_t)out->order.size();
+    span.valid = (size_t)id < tables.node_semantics.size() && tables.node_semantics[id].valid;
+    collect_trace_postorder(tables, id, (uint32_t)i + 1, &build, out);
+    span.count = (uint32_t)out->order.size() - span.offset;
+  }
+}
+
 }  // namespace vicad
@@ -8,9 +8,6 @@ namespace vicad_picking {
 using vicad_app::Vec3;
 using vicad_app::add;
 using vicad_app::mul;
-using vicad_app::dot;
-using vicad_app::cross;
-using vicad_app::sub;
 using vicad_app::normalize;
 
 Vec3 CameraRayDirection(int mouse_x, int mouse_y, const PickContext &ctx) {
@@ -44,63 +41,6 @@ void WindowMouseToPixel(int mouse_x, int mouse_y,
     *out_py = py;
 }
 
-static bool ray_intersect_triangle(const Vec3 &orig, const Vec3 &dir,
-                                   const Vec3 &v0, const Vec3 &v1, const Vec3 &v2,
-                                   double *t_out) {
-    const double eps = 1e-9;
-    const Vec3 e1 = sub(v1, v0);
-    const Vec3 e2 = sub(v2, v0);
-    const Vec3 pvec = cross(dir, e2);
-    const double det = (double)dot(e1, pvec);
-    if (det > -eps && det < eps) return false;
-    const double inv_det = 1.0 / det;
-    const Vec3 tvec = sub(orig, v0);
-    const double u = (double)dot(tvec, pvec) * inv_det;
-    if (u < 0.0 || u > 1.0) return false;
-    const Vec3 qvec = cross(tvec, e1);
-    const double v = (double)dot(dir, qvec) * inv_det;
-    if (v < 0.0 || u + v > 1.0) return false;
-    const double t = (double)dot(e2, qvec) * inv_det;
-    if (t <= eps) return false;
-    if (t_out) *t_out = t;
-    return true;
-}
-
-static bool ray_mesh_hit_t(const manifold::MeshGL &mesh,
-                           const Vec3 &orig, const Vec3 &dir,
-                           double *closest_t) {
-    if (mesh.NumTri() == 0 || mesh.numProp < 3) return false;
-    double best_t = 1e300;
-    bool hit = false;
-    for (size_t tri = 0; tri < mesh.NumTri(); ++tri) {
-        const size_t i0 = mesh.triVerts[tri * 3 + 0];
-        const size_t i1 = mesh.triVerts[tri * 3 + 1];
-        const size_t i2 = mesh.triVerts[tri * 3 + 2];
-        const Vec3 v0 = {
-            mesh.vertProperties[i0 * mesh.numProp + 0],
-            mesh.vertProperties[i0 * mesh.numProp + 1],
-            mesh.vertProperties[i0 * mesh.numProp + 2],
-        };
-        const Vec3 v1 = {
-            mesh.vertProperties[i1 * mesh.numProp + 0],
-            mesh.vertProperties[i1 * mesh.numProp + 1],
-            mesh.vertProperties[i1 * mesh.numProp + 2],
-        };
-        const Vec3 v2 = {
-            mesh.vertProperties[i2 * mesh.numProp + 0],
-            mesh.vertProperties[i2 * mesh.numProp + 1],
-            mesh.vertProperties[i2 * mesh.numProp + 2],
-        };
-        double t = 0.0;
-        if (ray_intersect_triangle(orig, dir, v0, v1, v2, &t) && t < best_t) {
-            best_t = t;
-            hit = true;
-        }
-    }
-    if (hit && closest_t) *closest_t = best_t;
-    return hit;
-}
-
 static bool ray_aabb_hit_t(const Vec3 &ray_origin, const Vec3 &ray_dir,
                            const Vec3 &bmin, const Vec3 &bmax,
                            double *t_out) {
@@ -132,9 +72,11 @@ static bool ray_aabb_hit_t(const Vec3 &ray_origin, const Vec3 &ray_dir,
 }
 
 bool PickMeshHit(const manifold::MeshGL &mesh,
+                 const vicad::MeshBvh &bvh,
                  const Vec3 &eye,
                  const Vec3 &ray_dir) {
-    return ray_mesh_hit_t(mesh, eye, ray_dir, nullptr);
+    return vicad::RaycastMeshBvh(mesh, bvh, eye.x, eye.y, eye.z, ray_dir.x, ray_dir.y, ray_dir.z,
+                                 nullptr, nullptr);
 }
 
 int PickSceneObject(const std::vector<vicad::ScriptSceneObject> &scene,
@@ -150,8 +92,15 @@ int PickSceneObject(const std::vector<vicad::ScriptSceneObject> &scene,
         if (!ray_aabb_hit_t(eye, ray_dir, mn, mx, &t_box)) continue;
 
         double t_hit = t_box;
-        if (obj.kind == vicad::ScriptSceneObjectKind::Manifold && obj.mesh.NumTri() > 0) {
-            if (!ray_mesh_hit_t(obj.mesh, eye, ray_dir, &t_hit)) continue;
+        if (obj.kind == vicad::ScriptSceneObjectKind::Manifold) {
+            vicad::SceneVec3 origin = {eye.x, eye.y, eye.z};
+            vicad::SceneVec3 dir = {ray_dir.x, ray_dir.y, ray_dir.z};
+            const manifold::MeshGL &mesh = vicad::SceneObjectPickMesh(obj, &origin, &dir);
+            if (mesh.NumTri() > 0 &&
+                !vicad::RaycastMeshBvh(mesh, vicad::SceneObjectPickBvh(obj), origin.x, origin.y, origin.z,
+                                       dir.x, dir.y, dir.z, &t_hit, nullptr)) {
+                continue;
+            }
         }
 
         if (t_hit < best_t) {
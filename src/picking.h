@@ -23,7 +23,9 @@ void WindowMouseToPixel(int mouse_x, int mouse_y,
                         int pixel_w, int pixel_h,
                         int *out_px, int *out_py);
 
+// `bvh` must be built from `mesh`.
 bool PickMeshHit(const manifold::MeshGL &mesh,
+                 const vicad::MeshBvh &bvh,
                  const vicad_app::Vec3 &eye,
                  const vicad_app::Vec3 &ray_dir);
 
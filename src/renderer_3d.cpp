@@ -1,9 +1,529 @@
 #include "renderer_3d.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_set>
+
+#if defined(__APPLE__)
+#include <OpenGL/gl.h>
+#else
+#define GL_GLEXT_PROTOTYPES 1
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
+
+#include "trace.h"
+
 namespace vicad_renderer3d {
 
+namespace {
+
+constexpr GLsizei kVertexStride = 6 * sizeof(float);
+
+bool upload_mesh(const manifold::MeshGL &mesh, const vicad::MeshDerived &derived, GpuMesh *out) {
+    vicad::TraceSpan span("gpu", "upload_mesh");
+    const size_t tri_count = mesh.NumTri();
+    if (mesh.numProp < 3 || tri_count == 0 || derived.triCount != tri_count) return false;
+    if (tri_count * 3 > (size_t)std::numeric_limits<int32_t>::max()) return false;
+    std::vector<float> interleaved;
+    interleaved.resize(tri_count * 3 * 6);
+    float *dst = interleaved.data();
+    for (size_t tri = 0; tri < tri_count; ++tri) {
+        const float nx = derived.triNormal[0][tri];
+        const float ny = derived.triNormal[1][tri];
+        const float nz = derived.triNormal[2][tri];
+        for (int k = 0; k < 3; ++k) {
+            const float *p = &mesh.vertProperties[(size_t)mesh.triVerts[tri * 3 + k] * mesh.numProp];
+            *dst++ = p[0];
+            *dst++ = p[1];
+            *dst++ = p[2];
+            *dst++ = nx;
+            *dst++ = ny;
+            *dst++ = nz;
+        }
+    }
+
+    GLuint vbo = 0;
+    glGenBuffers(1, &vbo);
+    if (vbo == 0) return false;
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(interleaved.size() * sizeof(float)), interleaved.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    out->vbo = vbo;
+    out->vertex_count = (int32_t)(tri_count * 3);
+    return true;
+}
+
+void release_mesh(GpuMesh *gpu) {
+    if (gpu->vbo != 0) {
+        const GLuint vbo = gpu->vbo;
+        glDeleteBuffers(1, &vbo);
+    }
+    *gpu = GpuMesh{};
+}
+
+void bind_positions(const GpuMesh &gpu) {
+    glBindBuffer(GL_ARRAY_BUFFER, gpu.vbo);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, kVertexStride, (const void *)0);
+}
+
+void unbind(bool normals) {
+    if (normals) glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+}  // namespace
+
 void RenderScene3D(const RenderSceneInputs &in) {
     (void)in;
 }
 
+MeshBufferCache::~MeshBufferCache() { Clear(); }
+
+MeshBufferCache::Key MeshBufferCache::key_for(const manifold::MeshGL &mesh, uint64_t version) {
+    return {mesh.vertProperties.data(), mesh.triVerts.data(), mesh.vertProperties.size(), mesh.triVerts.size(),
+            version};
+}
+
+const GpuMesh *MeshBufferCache::Get(const manifold::MeshGL &mesh) { return get(mesh, nullptr); }
+
+const GpuMesh *MeshBufferCache::Get(const manifold::MeshGL &mesh, const vicad::MeshDerived &derived) {
+    return get(mesh, &derived);
+}
+
+const GpuMesh *MeshBufferCache::get(const manifold::MeshGL &mesh, const vicad::MeshDerived *derived) {
+    if (mesh.NumTri() == 0) return nullptr;
+    const Key key = key_for(mesh, derived ? derived->version : 0);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) return &it->second;
+    GpuMesh gpu;
+    const bool uploaded = derived ? upload_mesh(mesh, *derived, &gpu)
+                                  : upload_mesh(mesh, vicad::BuildMeshDerived(mesh), &gpu);
+    if (!uploaded) return nullptr;
+    return &entries_.emplace(key, gpu).first->second;
+}
+
+void MeshBufferCache::Retain(const std::vector<const manifold::MeshGL *> &live,
+                             const std::vector<uint64_t> &live_versions) {
+    std::unordered_set<Key, KeyHash> keep;
+    keep.reserve(live.size());
+    for (const manifold::MeshGL *mesh : live) {
+        if (mesh) keep.insert(key_for(*mesh, 0));
+    }
+    const std::unordered_set<uint64_t> keep_versions(live_versions.begin(), live_versions.end());
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        const bool live_entry = it->first.version != 0 ? keep_versions.count(it->first.version) != 0
+                                                       : keep.count(it->first) != 0;
+        if (live_entry) {
+            ++it;
+            continue;
+        }
+        release_mesh(&it->second);
+        it = entries_.erase(it);
+    }
+}
+
+void MeshBufferCache::Clear() {
+    for (auto &entry : entries_) release_mesh(&entry.second);
+    entries_.clear();
+}
+
+void DrawMesh(const GpuMesh &gpu) {
+    if (gpu.vbo == 0 || gpu.vertex_count == 0) return;
+    bind_positions(gpu);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glNormalPointer(GL_FLOAT, kVertexStride, (const void *)(3 * sizeof(float)));
+    glDrawArrays(GL_TRIANGLES, 0, gpu.vertex_count);
+    unbind(true);
+}
+
+void DrawMeshInstances(const GpuMesh &gpu, const std::vector<MeshInstance> &instances) {
+    if (gpu.vbo == 0 || gpu.vertex_count == 0 || instances.empty()) return;
+    bind_positions(gpu);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glNormalPointer(GL_FLOAT, kVertexStride, (const void *)(3 * sizeof(float)));
+    glMatrixMode(GL_MODELVIEW);
+    for (const MeshInstance &inst : instances) {
+        glPushMatrix();
+        glMultMatrixd(inst.model);
+        if (inst.mirrored) glFrontFace(GL_CW);
+        glDrawArrays(GL_TRIANGLES, 0, gpu.vertex_count);
+        if (inst.mirrored) glFrontFace(GL_CCW);
+        glPopMatrix();
+    }
+    unbind(true);
+}
+
+void DrawMeshUnlit(const GpuMesh &gpu) {
+    if (gpu.vbo == 0 || gpu.vertex_count == 0) return;
+    bind_positions(gpu);
+    glDrawArrays(GL_TRIANGLES, 0, gpu.vertex_count);
+    unbind(false);
+}
+
+void DrawMeshTriangles(const GpuMesh &gpu, const std::vector<uint32_t> &tris) {
+    if (gpu.vbo == 0 || tris.empty()) return;
+    // Triangle t owns vertices 3t..3t+2 of the buffer.
+    static thread_local std::vector<GLuint> indices;
+    indices.clear();
+    indices.reserve(tris.size() * 3);
+    for (const uint32_t tri : tris) {
+        if ((int64_t)tri * 3 + 2 >= gpu.vertex_count) continue;
+        indices.push_back(tri * 3 + 0);
+        indices.push_back(tri * 3 + 1);
+        indices.push_back(tri * 3 + 2);
+    }
+    if (indices.empty()) return;
+    bind_positions(gpu);
+    glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_INT, indices.data());
+    unbind(false);
+}
+
+void BeginIdPass(int width, int height) {
+    glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_CURRENT_BIT | GL_DEPTH_BUFFER_BIT | GL_LIGHTING_BIT |
+                 GL_LINE_BIT | GL_POLYGON_BIT | GL_VIEWPORT_BIT | GL_PIXEL_MODE_BIT);
+    glViewport(0, 0, width, height);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_BLEND);
+    glDisable(GL_DITHER);
+    glDisable(GL_MULTISAMPLE);
+    glDisable(GL_TEXTURE_2D);
+    glDisable(GL_LINE_SMOOTH);
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LEQUAL);
+    glShadeModel(GL_FLAT);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void EndIdPass() {
+    glPopAttrib();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void SetPickId(uint32_t id) {
+    glColor3ub((GLubyte)(id & 0xFFu), (GLubyte)((id >> 8) & 0xFFu), (GLubyte)((id >> 16) & 0xFFu));
+}
+
+uint32_t ReadPickId(int x, int y, int radius, int width, int height) {
+    if (width <= 0 || height <= 0 || radius < 0) return 0;
+    const int gy = height - 1 - y;
+    const int x0 = std::max(0, x - radius);
+    const int y0 = std::max(0, gy - radius);
+    const int x1 = std::min(width - 1, x + radius);
+    const int y1 = std::min(height - 1, gy + radius);
+    if (x0 > x1 || y0 > y1) return 0;
+    const int w = x1 - x0 + 1;
+    const int h = y1 - y0 + 1;
+    static thread_local std::vector<GLubyte> pixels;
+    pixels.resize((size_t)w * (size_t)h * 4);
+    glReadBuffer(GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(x0, y0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    uint32_t best = 0;
+    int best_d2 = std::numeric_limits<int>::max();
+    for (int row = 0; row < h; ++row) {
+        for (int col = 0; col < w; ++col) {
+            const GLubyte *p = &pixels[((size_t)row * w + col) * 4];
+            const uint32_t id = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+            if (id == 0) continue;
+            const int dx = x0 + col - x;
+            const int dy = y0 + row - gy;
+            const int d2 = dx * dx + dy * dy;
+            if (d2 < best_d2) {
+                best_d2 = d2;
+                best = id;
+            }
+        }
+    }
+    return best;
+}
+
+TriangleIdBuffer::~TriangleIdBuffer() { Clear(); }
+
+bool TriangleIdBuffer::Upload(const std::vector<int> &tri_values) {
+    vicad::TraceSpan span("gpu", "upload_face_ids");
+    Clear();
+    if (tri_values.empty() || tri_values.size() * 3 > (size_t)std::numeric_limits<int32_t>::max()) return false;
+    std::vector<GLubyte> colors(tri_values.size() * 9);
+    GLubyte *dst = colors.data();
+    for (const int v : tri_values) {
+        const uint32_t id = v < 0 ? 0u : (uint32_t)v + 1u;
+        for (int k = 0; k < 3; ++k) {
+            *dst++ = (GLubyte)(id & 0xFFu);
+            *dst++ = (GLubyte)((id >> 8) & 0xFFu);
+            *dst++ = (GLubyte)((id >> 16) & 0xFFu);
+        }
+    }
+    GLuint vbo = 0;
+    glGenBuffers(1, &vbo);
+    if (vbo == 0) return false;
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)colors.size(), colors.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    vbo_ = vbo;
+    vertex_count_ = (int32_t)(tri_values.size() * 3);
+    return true;
+}
+
+void TriangleIdBuffer::Draw(const GpuMesh &gpu) const {
+    if (vbo_ == 0 || gpu.vbo == 0 || gpu.vertex_count != vertex_count_) return;
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glColorPointer(3, GL_UNSIGNED_BYTE, 0, (const void *)0);
+    bind_positions(gpu);
+    glDrawArrays(GL_TRIANGLES, 0, gpu.vertex_count);
+    glDisableClientState(GL_COLOR_ARRAY);
+    unbind(false);
+}
+
+void TriangleIdBuffer::Clear() {
+    if (vbo_ != 0) {
+        const GLuint vbo = vbo_;
+        glDeleteBuffers(1, &vbo);
+    }
+    vbo_ = 0;
+    vertex_count_ = 0;
+}
+
+namespace {
+
+// Position, normal of face A, normal of face B.
+constexpr GLsizei kEdgeVertexStride = 9 * sizeof(float);
+// Generic attribute slots clear of 0, which aliases gl_Vertex on some drivers.
+constexpr GLuint kNormalAAttrib = 6;
+constexpr GLuint kNormalBAttrib = 7;
+
+// Both endpoints lie on both face planes, so eye - position gives the same
+// signs at either end and a segment is kept or dropped whole. Dropped
+// vertices go past the far plane and are clipped.
+const char *const kSilhouetteVertexShader =
+    "#version 120\n"
+    "attribute vec3 normal_a;\n"
+    "attribute vec3 normal_b;\n"
+    "uniform vec3 eye;\n"
+    "void main() {\n"
+    "    vec3 view_dir = eye - gl_Vertex.xyz;\n"
+    "    bool front_a = dot(normal_a, view_dir) > 0.0;\n"
+    "    bool front_b = dot(normal_b, view_dir) > 0.0;\n"
+    "    bool two_sided = dot(normal_a, normal_a) > 0.0 && dot(normal_b, normal_b) > 0.0;\n"
+    "    gl_FrontColor = gl_Color;\n"
+    "    gl_Position = (two_sided && front_a != front_b) ? ftransform() : vec4(0.0, 0.0, 2.0, 1.0);\n"
+    "}\n";
+
+const char *const kSilhouetteFragmentShader =
+    "#version 120\n"
+    "void main() { gl_FragColor = gl_Color; }\n";
+
+GLuint compile_shader(GLenum type, const char *source) {
+    const GLuint shader = glCreateShader(type);
+    if (shader == 0) return 0;
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (ok != GL_TRUE) {
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+struct SilhouetteProgram {
+    bool tried = false;
+    GLuint program = 0;
+    GLint eye_uniform = -1;
+};
+
+// Built once per process; the program lives as long as the context.
+const SilhouetteProgram &silhouette_program() {
+    static SilhouetteProgram prog;
+    if (prog.tried) return prog;
+    prog.tried = true;
+    const GLuint vs = compile_shader(GL_VERTEX_SHADER, kSilhouetteVertexShader);
+    const GLuint fs = compile_shader(GL_FRAGMENT_SHADER, kSilhouetteFragmentShader);
+    if (vs != 0 && fs != 0) {
+        const GLuint program = glCreateProgram();
+        glAttachShader(program, vs);
+        glAttachShader(program, fs);
+        glBindAttribLocation(program, kNormalAAttrib, "normal_a");
+        glBindAttribLocation(program, kNormalBAttrib, "normal_b");
+        glLinkProgram(program);
+        GLint ok = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &ok);
+        if (ok == GL_TRUE) {
+            prog.program = program;
+            prog.eye_uniform = glGetUniformLocation(program, "eye");
+        } else {
+            glDeleteProgram(program);
+        }
+    }
+    if (vs != 0) glDeleteShader(vs);
+    if (fs != 0) glDeleteShader(fs);
+    return prog;
+}
+
+template <typename Fn>
+void for_each_range(const std::vector<EdgeRange> &ranges, int32_t segment_count, Fn &&draw) {
+    for (const EdgeRange &r : ranges) {
+        const uint32_t last = std::min<uint32_t>(r.second, (uint32_t)segment_count);
+        if (r.first >= last) continue;
+        draw((GLint)(r.first * 2), (GLsizei)((last - r.first) * 2));
+    }
+}
+
+}  // namespace
+
+EdgeLineBuffer::~EdgeLineBuffer() { Clear(); }
+
+bool EdgeLineBuffer::Upload(const std::vector<EdgeSegment> &segments) {
+    vicad::TraceSpan span("gpu", "upload_edges");
+    Clear();
+    if (segments.empty() || segments.size() * 2 > (size_t)std::numeric_limits<int32_t>::max()) return false;
+    std::vector<float> interleaved(segments.size() * 18);
+    float *dst = interleaved.data();
+    for (const EdgeSegment &seg : segments) {
+        for (const float *p : {seg.a, seg.b}) {
+            for (const float *v : {p, seg.normal_a, seg.normal_b}) {
+                *dst++ = v[0];
+                *dst++ = v[1];
+                *dst++ = v[2];
+            }
+        }
+    }
+    GLuint vbo = 0;
+    glGenBuffers(1, &vbo);
+    if (vbo == 0) return false;
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(interleaved.size() * sizeof(float)), interleaved.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    vbo_ = vbo;
+    segment_count_ = (int32_t)segments.size();
+    return true;
+}
+
+void EdgeLineBuffer::Draw(const std::vector<EdgeRange> &ranges) const {
+    if (vbo_ == 0 || ranges.empty()) return;
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, kEdgeVertexStride, (const void *)0);
+    for_each_range(ranges, segment_count_, [](GLint first, GLsizei count) { glDrawArrays(GL_LINES, first, count); });
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+bool EdgeLineBuffer::DrawSilhouettes(const float eye[3], const std::vector<EdgeRange> &ranges) const {
+    const SilhouetteProgram &prog = silhouette_program();
+    if (prog.program == 0) return false;
+    if (vbo_ == 0 || ranges.empty()) return true;
+    glUseProgram(prog.program);
+    glUniform3f(prog.eye_uniform, eye[0], eye[1], eye[2]);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, kEdgeVertexStride, (const void *)0);
+    glEnableVertexAttribArray(kNormalAAttrib);
+    glEnableVertexAttribArray(kNormalBAttrib);
+    glVertexAttribPointer(kNormalAAttrib, 3, GL_FLOAT, GL_FALSE, kEdgeVertexStride,
+                          (const void *)(3 * sizeof(float)));
+    glVertexAttribPointer(kNormalBAttrib, 3, GL_FLOAT, GL_FALSE, kEdgeVertexStride,
+                          (const void *)(6 * sizeof(float)));
+    for_each_range(ranges, segment_count_, [](GLint first, GLsizei count) { glDrawArrays(GL_LINES, first, count); });
+    glDisableVertexAttribArray(kNormalAAttrib);
+    glDisableVertexAttribArray(kNormalBAttrib);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(0);
+    return true;
+}
+
+void EdgeLineBuffer::Clear() {
+    if (vbo_ != 0) {
+        const GLuint vbo = vbo_;
+        glDeleteBuffers(1, &vbo);
+    }
+    vbo_ = 0;
+    segment_count_ = 0;
+}
+
+bool GpuSilhouettesSupported() { return silhouette_program().program != 0; }
+
+ViewportLayerCache::~ViewportLayerCache() { Clear(); }
+
+bool ViewportLayerCache::Capture(int width, int height) {
+    valid_ = false;
+    if (width <= 0 || height <= 0) return false;
+    if (texture_ == 0) {
+        GLuint tex = 0;
+        glGenTextures(1, &tex);
+        if (tex == 0) return false;
+        texture_ = tex;
+        width_ = 0;
+        height_ = 0;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    if (width != width_ || height != height_) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+        width_ = width;
+        height_ = height;
+    }
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    valid_ = glGetError() == GL_NO_ERROR;
+    return valid_;
+}
+
+void ViewportLayerCache::Draw() const {
+    if (!valid_) return;
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0.0, 1.0, 0.0, 1.0, -1.0, 1.0);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_LIGHTING);
+    glDisable(GL_BLEND);
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, 0.0f); glVertex2f(0.0f, 0.0f);
+    glTexCoord2f(1.0f, 0.0f); glVertex2f(1.0f, 0.0f);
+    glTexCoord2f(1.0f, 1.0f); glVertex2f(1.0f, 1.0f);
+    glTexCoord2f(0.0f, 1.0f); glVertex2f(0.0f, 1.0f);
+    glEnd();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+}
+
+void ViewportLayerCache::Clear() {
+    if (texture_ != 0) {
+        const GLuint tex = texture_;
+        glDeleteTextures(1, &tex);
+    }
+    texture_ = 0;
+    width_ = 0;
+    height_ = 0;
+    valid_ = false;
+}
+
 }  // namespace vicad_renderer3d
@@ -1,7 +1,15 @@
 #ifndef VICAD_RENDERER_3D_H_
 #define VICAD_RENDERER_3D_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include "manifold/manifold.h"
+#include "mesh_derived.h"
 
 namespace vicad_renderer3d {
 
@@ -11,6 +19,184 @@ struct RenderSceneInputs {
 
 void RenderScene3D(const RenderSceneInputs &in);
 
+// Retained GPU copy of a mesh for flat-shaded drawing: one vertex buffer of
+// interleaved position + face normal, three vertices per triangle, so a whole
+// mesh is a single glDrawArrays with no per-frame CPU work.
+struct GpuMesh {
+    unsigned int vbo = 0;
+    int32_t vertex_count = 0;
+};
+
+// Vertex buffers keyed by the MeshDerived version of the mesh they were
+// uploaded from, or for a mesh without one by its heap buffers. Both survive
+// moving the MeshGL (e.g. a scene object carried over across reloads); heap
+// buffers may be reused by a later allocation, so Retain must run whenever the
+// set of live meshes changes. Every call needs the GL context current.
+class MeshBufferCache {
+  public:
+    MeshBufferCache() = default;
+    ~MeshBufferCache();
+
+    MeshBufferCache(const MeshBufferCache &) = delete;
+    MeshBufferCache &operator=(const MeshBufferCache &) = delete;
+
+    // Uploads on first use. Null for an empty mesh or a failed upload.
+    const GpuMesh *Get(const manifold::MeshGL &mesh);
+    // Same, uploading the face normals of `derived`, which must have been
+    // built from `mesh`.
+    const GpuMesh *Get(const manifold::MeshGL &mesh, const vicad::MeshDerived &derived);
+    // Releases every buffer whose mesh is not in `live` and whose version is
+    // not in `live_versions`.
+    void Retain(const std::vector<const manifold::MeshGL *> &live, const std::vector<uint64_t> &live_versions);
+    void Clear();
+
+    size_t size() const { return entries_.size(); }
+
+  private:
+    struct Key {
+        const void *verts;
+        const void *tris;
+        size_t vert_floats;
+        size_t tri_indices;
+        uint64_t version;  // 0 when keyed by the buffers alone
+        bool operator==(const Key &o) const {
+            return verts == o.verts && tris == o.tris && vert_floats == o.vert_floats &&
+                   tri_indices == o.tri_indices && version == o.version;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key &k) const {
+            return std::hash<const void *>()(k.verts) ^ (std::hash<const void *>()(k.tris) << 1) ^
+                   (k.tri_indices * 0x9E3779B97F4A7C15ull) ^ (size_t)(k.version * 0xBF58476D1CE4E5B9ull);
+        }
+    };
+    static Key key_for(const manifold::MeshGL &mesh, uint64_t version);
+    const GpuMesh *get(const manifold::MeshGL &mesh, const vicad::MeshDerived *derived);
+
+    std::unordered_map<Key, GpuMesh, KeyHash> entries_;
+};
+
+// Lit draw with the current color; the caller owns GL state (lighting,
+// polygon offset, blending).
+void DrawMesh(const GpuMesh &gpu);
+// One placement of a shared mesh: a column-major model matrix as
+// glMultMatrixd takes it, and whether it flips handedness (which reverses
+// the triangles' winding).
+struct MeshInstance {
+    double model[16];
+    bool mirrored;
+};
+
+// Lit draw of the mesh once per instance, binding its buffer once. The
+// fixed-function pipeline has no instanced draw call, so each instance is a
+// glDrawArrays under its own modelview matrix.
+void DrawMeshInstances(const GpuMesh &gpu, const std::vector<MeshInstance> &instances);
+// Position-only draw for overlays.
+void DrawMeshUnlit(const GpuMesh &gpu);
+// Position-only draw of a subset of the mesh's triangles (by triangle index).
+void DrawMeshTriangles(const GpuMesh &gpu, const std::vector<uint32_t> &tris);
+
+// Picking by rendering ids. Everything pickable is drawn in a flat colour
+// encoding a 24-bit id (0 is background) with lighting, blending, dithering
+// and multisampling off, then the pixels around the cursor are read back. The
+// pass draws into the back buffer before the visible frame and EndIdPass
+// clears it again, so it needs no offscreen framebuffer. Draw with the
+// current projection and modelview; positions come from GpuMesh buffers.
+void BeginIdPass(int width, int height);
+void EndIdPass();
+void SetPickId(uint32_t id);
+// Nearest non-zero id within `radius` pixels of (x, y), in top-down
+// framebuffer pixels; 0 when there is none. Call before EndIdPass.
+uint32_t ReadPickId(int x, int y, int radius, int width, int height);
+
+// Per-vertex id colours matching a GpuMesh's vertices, for drawing each
+// triangle with its own id (e.g. the face region it belongs to).
+class TriangleIdBuffer {
+  public:
+    TriangleIdBuffer() = default;
+    ~TriangleIdBuffer();
+
+    TriangleIdBuffer(const TriangleIdBuffer &) = delete;
+    TriangleIdBuffer &operator=(const TriangleIdBuffer &) = delete;
+
+    // Triangle t gets id tri_values[t] + 1; negative values are unpickable.
+    bool Upload(const std::vector<int> &tri_values);
+    // Draws `gpu` with these ids; nothing when the vertex counts differ.
+    void Draw(const GpuMesh &gpu) const;
+    void Clear();
+
+  private:
+    unsigned int vbo_ = 0;
+    int32_t vertex_count_ = 0;
+};
+
+// One overlay edge: its endpoints and the normals of the two faces meeting
+// there. Zero normals (boundary or degenerate edges) never classify as a
+// silhouette.
+struct EdgeSegment {
+    float a[3];
+    float b[3];
+    float normal_a[3];
+    float normal_b[3];
+};
+
+// [first, last) segment indices of an EdgeLineBuffer.
+using EdgeRange = std::pair<uint32_t, uint32_t>;
+
+// Overlay edges retained as one line buffer for lines drawn with the current
+// colour and width. DrawSilhouettes classifies each edge in a vertex shader
+// against the eye, with the test vicad::ComputeSilhouetteEdges runs on the
+// CPU: one adjacent face towards the eye and the other away.
+class EdgeLineBuffer {
+  public:
+    EdgeLineBuffer() = default;
+    ~EdgeLineBuffer();
+
+    EdgeLineBuffer(const EdgeLineBuffer &) = delete;
+    EdgeLineBuffer &operator=(const EdgeLineBuffer &) = delete;
+
+    bool Upload(const std::vector<EdgeSegment> &segments);
+    void Draw(const std::vector<EdgeRange> &ranges) const;
+    // False when the context cannot build the shader, so the caller can fall
+    // back to classifying on the CPU.
+    bool DrawSilhouettes(const float eye[3], const std::vector<EdgeRange> &ranges) const;
+    void Clear();
+
+    uint32_t size() const { return (uint32_t)segment_count_; }
+
+  private:
+    unsigned int vbo_ = 0;
+    int32_t segment_count_ = 0;
+};
+
+// Whether DrawSilhouettes can run in this context; builds the shader on first
+// call. Needs the GL context current.
+bool GpuSilhouettesSupported();
+
+// Copy of the last fully drawn 3D viewport, so frames whose only damage is
+// UI (pointer hover over panels, tab strip) blit it instead of redrawing the
+// scene. Capture copies the back buffer; Draw replaces the whole framebuffer.
+class ViewportLayerCache {
+  public:
+    ViewportLayerCache() = default;
+    ~ViewportLayerCache();
+
+    ViewportLayerCache(const ViewportLayerCache &) = delete;
+    ViewportLayerCache &operator=(const ViewportLayerCache &) = delete;
+
+    bool Valid(int width, int height) const { return valid_ && width == width_ && height == height_; }
+    bool Capture(int width, int height);
+    void Draw() const;
+    void Invalidate() { valid_ = false; }
+    void Clear();
+
+  private:
+    unsigned int texture_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+    bool valid_ = false;
+};
+
 }  // namespace vicad_renderer3d
 
 #endif  // VICAD_RENDERER_3D_H_
@@ -1,9 +1,149 @@
 #include "renderer_overlay.h"
 
+#include <cstddef>
+
+#if defined(__APPLE__)
+#include <OpenGL/gl.h>
+#else
+#define GL_GLEXT_PROTOTYPES 1
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
+
 namespace vicad_renderer_overlay {
 
+namespace {
+
+bool same_scissor(const UiScissor &a, const UiScissor &b) {
+    if (a.enabled != b.enabled) return false;
+    if (!a.enabled) return true;
+    return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+}
+
+}  // namespace
+
 void RenderOverlays(const RenderOverlayInputs &in) {
     (void)in;
 }
 
+void UiBatch::Begin(unsigned int solid_texture, float solid_u, float solid_v) {
+    vertices_.clear();
+    draws_.clear();
+    scissor_ = UiScissor();
+    solid_texture_ = solid_texture;
+    solid_uv_[0] = solid_u;
+    solid_uv_[1] = solid_v;
+}
+
+void UiBatch::SetScissor(const UiScissor &scissor) {
+    scissor_ = scissor;
+}
+
+void UiBatch::AddRect(float x0, float y0, float x1, float y1, const uint8_t rgba[4]) {
+    // Stay on the current draw's texture when there is one: every texture
+    // the frame uses carries the solid texel at the same coordinate.
+    unsigned int texture = solid_texture_;
+    if (!draws_.empty() && same_scissor(draws_.back().scissor, scissor_) && draws_.back().texture != 0) {
+        texture = draws_.back().texture;
+    }
+    const float u = texture != 0 ? solid_uv_[0] : 0.0f;
+    const float v = texture != 0 ? solid_uv_[1] : 0.0f;
+    push_quad(texture, x0, y0, x1, y1, u, v, u, v, rgba);
+}
+
+void UiBatch::AddTexturedRect(unsigned int texture, float x0, float y0, float x1, float y1,
+                              float u0, float v0, float u1, float v1, const uint8_t rgba[4]) {
+    push_quad(texture, x0, y0, x1, y1, u0, v0, u1, v1, rgba);
+}
+
+void UiBatch::push_quad(unsigned int texture, float x0, float y0, float x1, float y1,
+                        float u0, float v0, float u1, float v1, const uint8_t rgba[4]) {
+    if (x1 <= x0 || y1 <= y0 || rgba[3] == 0) return;
+    if (draws_.empty() || draws_.back().texture != texture || !same_scissor(draws_.back().scissor, scissor_)) {
+        DrawCmd draw;
+        draw.texture = texture;
+        draw.scissor = scissor_;
+        draw.first = (uint32_t)vertices_.size();
+        draws_.push_back(draw);
+    }
+    const float corners[4][4] = {
+        {x0, y0, u0, v0}, {x1, y0, u1, v0}, {x1, y1, u1, v1}, {x0, y1, u0, v1},
+    };
+    for (const auto &c : corners) {
+        vertices_.push_back({{c[0], c[1]}, {c[2], c[3]}, {rgba[0], rgba[1], rgba[2], rgba[3]}});
+    }
+    draws_.back().count += 4;
+}
+
+void UiBatch::Draw() {
+    if (vertices_.empty()) return;
+    if (vbo_ == 0) {
+        GLuint vbo = 0;
+        glGenBuffers(1, &vbo);
+        vbo_ = vbo;
+        vbo_capacity_ = 0;
+    }
+    const size_t bytes = vertices_.size() * sizeof(Vertex);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    if (bytes > vbo_capacity_) vbo_capacity_ = bytes + bytes / 2;
+    // Orphan last frame's storage so the upload does not wait on it.
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vbo_capacity_, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)bytes, vertices_.data());
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, sizeof(Vertex), (const void *)offsetof(Vertex, pos));
+    glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), (const void *)offsetof(Vertex, uv));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), (const void *)offsetof(Vertex, rgba));
+
+    UiScissor bound_scissor;
+    unsigned int bound_texture = 0;
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_TEXTURE_2D);
+    for (const DrawCmd &draw : draws_) {
+        if (!same_scissor(draw.scissor, bound_scissor)) {
+            if (draw.scissor.enabled) {
+                glEnable(GL_SCISSOR_TEST);
+                glScissor(draw.scissor.x, draw.scissor.y, draw.scissor.w, draw.scissor.h);
+            } else {
+                glDisable(GL_SCISSOR_TEST);
+            }
+            bound_scissor = draw.scissor;
+        }
+        if (draw.texture != bound_texture) {
+            if (draw.texture != 0) {
+                if (bound_texture == 0) glEnable(GL_TEXTURE_2D);
+                glBindTexture(GL_TEXTURE_2D, draw.texture);
+            } else {
+                glDisable(GL_TEXTURE_2D);
+            }
+            bound_texture = draw.texture;
+        }
+        glDrawArrays(GL_QUADS, (GLint)draw.first, (GLsizei)draw.count);
+    }
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_TEXTURE_2D);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_BLEND);
+}
+
+void UiBatch::Clear() {
+    if (vbo_ != 0) {
+        const GLuint vbo = vbo_;
+        glDeleteBuffers(1, &vbo);
+    }
+    vbo_ = 0;
+    vbo_capacity_ = 0;
+    vertices_.clear();
+    draws_.clear();
+}
+
 }  // namespace vicad_renderer_overlay
@@ -1,6 +1,10 @@
 #ifndef VICAD_RENDERER_OVERLAY_H_
 #define VICAD_RENDERER_OVERLAY_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
 namespace vicad_renderer_overlay {
 
 struct RenderOverlayInputs {
@@ -10,6 +14,68 @@ struct RenderOverlayInputs {
 
 void RenderOverlays(const RenderOverlayInputs &in);
 
+// Scissor box in GL window pixels (origin bottom-left).
+struct UiScissor {
+    bool enabled = false;
+    int x = 0;
+    int y = 0;
+    int w = 0;
+    int h = 0;
+};
+
+// One frame of UI quads collected into a single streaming vertex buffer.
+// Quads keep submission order; a draw is cut only where the scissor or the
+// texture changes. Solid quads sample an opaque texel of whatever texture the
+// current draw already uses, so panels and their labels on one atlas page go
+// out together. Texture 0 draws untextured.
+class UiBatch {
+public:
+    UiBatch() = default;
+    UiBatch(const UiBatch &) = delete;
+    UiBatch &operator=(const UiBatch &) = delete;
+
+    // Drops the previous frame. `solid_texture` and (solid_u, solid_v) name
+    // the opaque texel solid quads sample; the texel must sit at the same
+    // place in every texture the frame uses.
+    void Begin(unsigned int solid_texture, float solid_u, float solid_v);
+    void SetScissor(const UiScissor &scissor);
+    void AddRect(float x0, float y0, float x1, float y1, const uint8_t rgba[4]);
+    void AddTexturedRect(unsigned int texture, float x0, float y0, float x1, float y1,
+                         float u0, float v0, float u1, float v1, const uint8_t rgba[4]);
+    // Uploads the frame and draws it with the current matrices, blending on.
+    // Leaves blending, texturing and the scissor test disabled.
+    void Draw();
+    // Releases the vertex buffer; needs the GL context current.
+    void Clear();
+
+    size_t quad_count() const { return vertices_.size() / 4; }
+    size_t draw_count() const { return draws_.size(); }
+
+private:
+    struct Vertex {
+        float pos[2];
+        float uv[2];
+        uint8_t rgba[4];
+    };
+    struct DrawCmd {
+        unsigned int texture = 0;
+        UiScissor scissor;
+        uint32_t first = 0;
+        uint32_t count = 0;
+    };
+
+    void push_quad(unsigned int texture, float x0, float y0, float x1, float y1,
+                   float u0, float v0, float u1, float v1, const uint8_t rgba[4]);
+
+    std::vector<Vertex> vertices_;
+    std::vector<DrawCmd> draws_;
+    UiScissor scissor_;
+    unsigned int solid_texture_ = 0;
+    float solid_uv_[2] = {0.0f, 0.0f};
+    unsigned int vbo_ = 0;
+    size_t vbo_capacity_ = 0;
+};
+
 }  // namespace vicad_renderer_overlay
 
 #endif  // VICAD_RENDERER_OVERLAY_H_
@@ -0,0 +1,75 @@
+#include "replay_cache.h"
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "replay_semantic_arena.h"
+#include "replay_stream.h"
+
+namespace vicad {
+
+void ReplayCache::BeginRun() {
+  run_++;
+  hits_ = 0;
+  misses_ = 0;
+}
+
+void ReplayCache::EndRun(uint32_t lod_key) {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (it->first.lod_key == lod_key && it->second.last_used_run != run_) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+const ReplayCacheEntry *ReplayCache::Find(uint64_t digest, uint32_t lod_key) {
+  auto it = entries_.find(Key{digest, lod_key});
+  if (it == entries_.end()) {
+    misses_++;
+    return nullptr;
+  }
+  hits_++;
+  it->second.last_used_run = run_;
+  return &it->second;
+}
+
+void ReplayCache::Insert(uint64_t digest, uint32_t lod_key, ReplayCacheEntry entry) {
+  entry.last_used_run = run_;
+  entries_[Key{digest, lod_key}] = std::move(entry);
+}
+
+void ReplayCache::Clear() {
+  entries_.clear();
+}
+
+ReplayCacheEntry ReplayCacheEntryOf(const ReplayTables &tables, uint32_t out_id) {
+  ReplayCacheEntry entry;
+  entry.kind = (NodeKind)tables.node_kind[out_id];
+  if (entry.kind == NodeKind::Manifold) entry.manifold = tables.manifold_nodes[out_id];
+  if (entry.kind == NodeKind::CrossSection) entry.cross = tables.cross_nodes[out_id];
+  entry.plane = tables.cross_plane[out_id];
+  entry.semantic = ReplaySemanticValueOf(tables, tables.node_semantics[out_id]);
+  return entry;
+}
+
+// The digest covers the inputs' content, so the cached semantic (params) still
+// applies; its inputs are this record's.
+bool ApplyReplayCacheEntry(const ReplayCacheEntry &hit, const OpRecordHeader &hdr, const uint8_t *payload,
+                           ReplayTables *tables, std::string *error) {
+  if (hdr.payload_len < sizeof(uint32_t)) {
+    *error = "Replay failed: missing out node id.";
+    return false;
+  }
+  uint32_t out_id = 0;
+  std::memcpy(&out_id, payload, sizeof(out_id));
+  std::vector<uint32_t> inputs;
+  ReplayRecordInputs(hdr, payload, &inputs);
+  InstallReplayNode(tables, out_id, hit.kind, hit.manifold, hit.cross, hit.plane);
+  tables->node_semantics[out_id] = StoreReplaySemantic(&tables->semantic_arena, hit.semantic, out_id, inputs);
+  return true;
+}
+
+}  // namespace vicad
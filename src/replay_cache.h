@@ -0,0 +1,70 @@
+#ifndef VICAD_REPLAY_CACHE_H_
+#define VICAD_REPLAY_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "manifold/cross_section.h"
+#include "manifold/manifold.h"
+#include "ipc_protocol.h"
+#include "lod_policy.h"
+#include "op_decoder.h"
+
+namespace vicad {
+
+// Replay result of one op, stored without its node id so it can be reused by
+// any later run that emits an op with the same content digest.
+struct ReplayCacheEntry {
+  NodeKind kind = NodeKind::Unknown;
+  manifold::Manifold manifold;
+  manifold::CrossSection cross;
+  SketchPlane plane;
+  ReplaySemanticValue semantic;
+  uint64_t last_used_run = 0;
+};
+
+// Content-addressed cache of replayed nodes, keyed by the worker's per-node
+// digest plus the LOD key (LodKeyForPolicy) the node was tessellated for.
+// Entries a run of the same key did not touch are dropped when it completes,
+// so the cache holds roughly one scene per key.
+class ReplayCache {
+ public:
+  void BeginRun();
+  void EndRun(uint32_t lod_key);
+  const ReplayCacheEntry *Find(uint64_t digest, uint32_t lod_key);
+  void Insert(uint64_t digest, uint32_t lod_key, ReplayCacheEntry entry);
+  void Clear();
+
+  size_t size() const { return entries_.size(); }
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+ private:
+  struct Key {
+    uint64_t digest;
+    uint32_t lod_key;
+    bool operator==(const Key &o) const { return digest == o.digest && lod_key == o.lod_key; }
+  };
+  struct KeyHash {
+    size_t operator()(const Key &k) const {
+      return (size_t)(k.digest ^ ((uint64_t)k.lod_key * 0x9E3779B97F4A7C15ull));
+    }
+  };
+
+  std::unordered_map<Key, ReplayCacheEntry, KeyHash> entries_;
+  uint64_t run_ = 0;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+};
+
+// Self-contained copy of node `out_id` for the cache.
+ReplayCacheEntry ReplayCacheEntryOf(const ReplayTables &tables, uint32_t out_id);
+// Installs a cache hit as the node the record `hdr` produces in this run.
+bool ApplyReplayCacheEntry(const ReplayCacheEntry &hit, const OpRecordHeader &hdr, const uint8_t *payload,
+                           ReplayTables *tables, std::string *error);
+
+}  // namespace vicad
+
+#endif  // VICAD_REPLAY_CACHE_H_
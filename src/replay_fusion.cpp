@@ -0,0 +1,81 @@
+#include "replay_fusion.h"
+
+#include <utility>
+
+#include "ipc_protocol.h"
+
+namespace vicad {
+
+namespace {
+
+// Ops whose result is a transform of a leaf mesh, whose matrix a following
+// transform can absorb.
+bool ends_in_transform(uint16_t opcode) {
+  return ReplayOpIsTransform(opcode) || (OpCode)opcode == OpCode::Extrude || (OpCode)opcode == OpCode::Revolve;
+}
+
+}  // namespace
+
+bool ReplayOpIsBoolean(uint16_t opcode) {
+  return (OpCode)opcode == OpCode::Union || (OpCode)opcode == OpCode::Subtract ||
+         (OpCode)opcode == OpCode::Intersect;
+}
+
+bool ReplayOpIsTransform(uint16_t opcode) {
+  return (OpCode)opcode == OpCode::Translate || (OpCode)opcode == OpCode::Rotate ||
+         (OpCode)opcode == OpCode::Scale;
+}
+
+std::vector<NodeFusion> PlanReplayFusion(const std::vector<uint16_t> &opcodes,
+                                         const std::vector<std::vector<uint32_t>> &inputs,
+                                         const std::unordered_map<uint32_t, uint32_t> &producer,
+                                         const std::vector<uint32_t> &roots) {
+  std::vector<uint32_t> reads(opcodes.size(), 0);
+  auto count_read = [&](uint32_t id) {
+    auto it = producer.find(id);
+    if (it != producer.end()) reads[it->second]++;
+  };
+  for (const std::vector<uint32_t> &ids : inputs) {
+    for (uint32_t in_id : ids) count_read(in_id);
+  }
+  for (uint32_t root : roots) count_read(root);
+
+  std::vector<NodeFusion> fusions;
+  auto sole_reader_input = [&](uint32_t i, uint32_t in_id) -> const uint32_t * {
+    auto it = producer.find(in_id);
+    return (it != producer.end() && it->second < i && reads[it->second] == 1) ? &it->second : nullptr;
+  };
+  for (uint32_t i = 0; i < (uint32_t)opcodes.size(); ++i) {
+    const uint16_t opcode = opcodes[i];
+    if (ReplayOpIsTransform(opcode) && !inputs[i].empty()) {
+      const uint32_t *j = sole_reader_input(i, inputs[i][0]);
+      if (j && ends_in_transform(opcodes[*j])) {
+        if (fusions.empty()) fusions.resize(opcodes.size());
+        fusions[*j].deferred = true;
+      }
+      continue;
+    }
+    if (!ReplayOpIsBoolean(opcode)) continue;
+    std::vector<uint32_t> operands;
+    bool chained = false;
+    for (size_t p = 0; p < inputs[i].size(); ++p) {
+      const uint32_t in_id = inputs[i][p];
+      const uint32_t *j = sole_reader_input(i, in_id);
+      if (!j || opcodes[*j] != opcode || ((OpCode)opcode == OpCode::Subtract && p != 0)) {
+        operands.push_back(in_id);
+        continue;
+      }
+      if (fusions.empty()) fusions.resize(opcodes.size());
+      NodeFusion &inner = fusions[*j];
+      inner.deferred = true;
+      const std::vector<uint32_t> &spliced = inner.operands.empty() ? inputs[*j] : inner.operands;
+      operands.insert(operands.end(), spliced.begin(), spliced.end());
+      inner.operands.clear();
+      chained = true;
+    }
+    if (chained) fusions[i].operands = std::move(operands);
+  }
+  return fusions;
+}
+
+}  // namespace vicad
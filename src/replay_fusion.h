@@ -0,0 +1,39 @@
+#ifndef VICAD_REPLAY_FUSION_H_
+#define VICAD_REPLAY_FUSION_H_
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace vicad {
+
+// How the scheduler folded a record into the op that reads it. A deferred op
+// has a single reader in its batch, so its result is left as an unevaluated
+// Manifold and the reader evaluates both at once: a boolean chain head with
+// one BatchBoolean over `operands`, a transform by composing its matrix onto
+// the pending one.
+struct NodeFusion {
+  bool deferred = false;
+  std::vector<uint32_t> operands;
+};
+
+bool ReplayOpIsBoolean(uint16_t opcode);
+bool ReplayOpIsTransform(uint16_t opcode);
+
+// Plans fusion within a batch of records, given each record's opcode and
+// input ids in stream order, `producer` (node id -> index of the record in the
+// batch that produces it) and the scene roots. Only inputs produced in the
+// batch, read nowhere else and not roots qualify. Chains of one boolean
+// operator are flattened: the input is deferred and its operands spliced into
+// the consumer's, so a - b - c runs as a single BatchBoolean (Subtract chains
+// through its left operand only). A transform of a transform, extrude or
+// revolve defers its input, so the matrices fold and the mesh is materialized
+// once. Returns an empty vector when nothing fuses.
+std::vector<NodeFusion> PlanReplayFusion(const std::vector<uint16_t> &opcodes,
+                                         const std::vector<std::vector<uint32_t>> &inputs,
+                                         const std::unordered_map<uint32_t, uint32_t> &producer,
+                                         const std::vector<uint32_t> &roots);
+
+}  // namespace vicad
+
+#endif  // VICAD_REPLAY_FUSION_H_
@@ -0,0 +1,143 @@
+#include "replay_scheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "replay_semantic_arena.h"
+#include "trace.h"
+#include "work_stealing_pool.h"
+
+namespace vicad {
+
+namespace {
+
+// Grows `v` for `extra` more elements while keeping amortized doubling, so
+// per-batch reservations do not turn appends quadratic.
+template <typename T>
+void reserve_more(std::vector<T> *v, size_t extra) {
+  const size_t need = v->size() + extra;
+  if (need > v->capacity()) v->reserve(std::max(need, v->capacity() * 2));
+}
+
+// Trace span name of a record: spans are grouped by kind of op, not opcode.
+const char *op_class_name(uint16_t opcode) {
+  if (ReplayOpIsBoolean(opcode)) return "boolean";
+  if (ReplayOpIsTransform(opcode)) return "transform";
+  switch ((OpCode)opcode) {
+    case OpCode::Sphere:
+    case OpCode::Cube:
+    case OpCode::Cylinder: return "primitive";
+    case OpCode::Extrude:
+    case OpCode::Revolve: return "sweep";
+    case OpCode::Slice: return "slice";
+    default: return "sketch";
+  }
+}
+
+}  // namespace
+
+bool ReplayPendingRecords(ReplayStream *stream, const std::vector<ReplayPending> &misses, uint32_t max_id,
+                          std::string *error) {
+  ReplayTables &tables = stream->tables;
+  // Payload size bounds what a record appends to the arena, so one
+  // reservation per batch keeps commits from reallocating.
+  size_t payload_bytes = 0;
+  for (const ReplayPending &p : misses) payload_bytes += p.hdr.payload_len;
+  reserve_more(&tables.semantic_arena.u32, payload_bytes / sizeof(uint32_t));
+  reserve_more(&tables.semantic_arena.f64, payload_bytes / sizeof(double));
+  reserve_more(&tables.semantic_arena.points, payload_bytes / sizeof(manifold::vec2));
+  std::vector<uint32_t> indegree(misses.size(), 0);
+  std::vector<std::vector<uint32_t>> dependents(misses.size());
+  std::vector<std::vector<uint32_t>> inputs(misses.size());
+  std::vector<uint16_t> opcodes(misses.size());
+  std::unordered_map<uint32_t, uint32_t> producer;
+  for (uint32_t i = 0; i < (uint32_t)misses.size(); ++i) {
+    opcodes[i] = misses[i].hdr.opcode;
+    ReplayRecordInputs(misses[i].hdr, misses[i].payload, &inputs[i]);
+    for (uint32_t in_id : inputs[i]) {
+      auto it = producer.find(in_id);
+      if (it == producer.end()) continue;
+      dependents[it->second].push_back(i);
+      indegree[i]++;
+    }
+    producer[misses[i].out_id] = i;
+  }
+  const std::vector<NodeFusion> fusions = PlanReplayFusion(opcodes, inputs, producer, stream->roots);
+  // A chain head also reads its flattened operands; count those reads so
+  // low-memory replay keeps them alive until the head ran.
+  for (size_t i = 0; i < fusions.size(); ++i) {
+    inputs[i].insert(inputs[i].end(), fusions[i].operands.begin(), fusions[i].operands.end());
+  }
+
+  // Remaining reads of each node; roots hold one extra so they are never
+  // released. Whichever task drops a count to zero frees the geometry.
+  std::unique_ptr<std::atomic<uint32_t>[]> uses;
+  if (stream->release_dead) {
+    uses.reset(new std::atomic<uint32_t>[(size_t)max_id + 1]());
+    for (const std::vector<uint32_t> &ids : inputs) {
+      for (uint32_t in_id : ids) {
+        if (in_id <= max_id) uses[in_id].fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    for (uint32_t root : stream->roots) {
+      if (root <= max_id) uses[root].fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  std::vector<std::string> errors(misses.size());
+  const ReplayLodPolicy &lod_policy = stream->lod_policy;
+  // Tasks build semantics in a per-thread scratch value and append them to
+  // the shared arena under the lock.
+  std::mutex arena_mutex;
+  auto run = [&](uint32_t i) {
+    thread_local ReplaySemanticValue draft;
+    const uint32_t out_id = misses[i].out_id;
+    const NodeFusion *fusion = fusions.empty() ? nullptr : &fusions[i];
+    TraceSpan span("replay", op_class_name(misses[i].hdr.opcode));
+    if (!ReplayRecord(misses[i].hdr, misses[i].payload, lod_policy, fusion, &tables, &draft, &errors[i])) {
+      return false;
+    }
+    {
+      std::lock_guard<std::mutex> lock(arena_mutex);
+      tables.node_semantics[out_id] = StoreReplaySemantic(&tables.semantic_arena, draft, out_id, draft.inputs);
+    }
+    if (uses) {
+      if (uses[out_id].load(std::memory_order_acquire) == 0) ReleaseReplayNode(&tables, out_id);
+      for (uint32_t in_id : inputs[i]) {
+        if (in_id <= max_id && uses[in_id].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+          ReleaseReplayNode(&tables, in_id);
+        }
+      }
+    }
+    return true;
+  };
+  // A replay on another thread (e.g. a background refine) may hold the
+  // pool; this one then runs sequentially rather than waiting for it.
+  WorkStealingPool &pool = WorkStealingPool::Shared();
+  std::vector<uint8_t> results;
+  if (!(misses.size() > 1 && pool.worker_count() > 0 && pool.TryRunGraph(indegree, dependents, run, &results))) {
+    results.assign(misses.size(), 0);
+    for (uint32_t i = 0; i < (uint32_t)misses.size() && (i == 0 || results[i - 1]); ++i) {
+      results[i] = run(i) ? 1 : 0;
+    }
+  }
+  // Report the first failure in stream order, which is what a sequential
+  // replay would have hit: a skipped task always has an earlier failed one.
+  for (size_t i = 0; i < misses.size(); ++i) {
+    if (results[i]) continue;
+    *error = errors[i];
+    return false;
+  }
+  if (stream->cache) {
+    for (const ReplayPending &p : misses) {
+      if (p.hdr.digest == 0) continue;
+      stream->cache->Insert(p.hdr.digest, LodKeyForPolicy(lod_policy), ReplayCacheEntryOf(tables, p.out_id));
+    }
+  }
+  return true;
+}
+
+}  // namespace vicad
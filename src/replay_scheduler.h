@@ -0,0 +1,41 @@
+#ifndef VICAD_REPLAY_SCHEDULER_H_
+#define VICAD_REPLAY_SCHEDULER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ipc_protocol.h"
+#include "op_decoder.h"
+#include "replay_cache.h"
+#include "replay_fusion.h"
+#include "replay_stream.h"
+
+namespace vicad {
+
+// A record of the current batch that missed the replay cache.
+struct ReplayPending {
+  OpRecordHeader hdr;
+  const uint8_t *payload;
+  uint32_t out_id;
+};
+
+// Replays `misses` (in stream order) as a dependency graph on the shared
+// work-stealing pool, so independent subtrees run concurrently; falls back to
+// a sequential replay when the pool is busy. The tables must already hold node
+// `max_id`. On failure reports the first error in stream order. Results with a
+// digest are inserted into the stream's cache.
+bool ReplayPendingRecords(ReplayStream *stream, const std::vector<ReplayPending> &misses, uint32_t max_id,
+                          std::string *error);
+
+// Replays one op record into `tables`; implemented in op_decoder.cpp. Every
+// input id has already been produced. The node's geometry goes straight into
+// `tables`; its semantic is built in `sem_out` and committed to the arena by
+// the caller. `fusion` may be null.
+bool ReplayRecord(const OpRecordHeader &hdr, const uint8_t *payload, const ReplayLodPolicy &lod_policy,
+                  const NodeFusion *fusion, ReplayTables *tables, ReplaySemanticValue *sem_out,
+                  std::string *error);
+
+}  // namespace vicad
+
+#endif  // VICAD_REPLAY_SCHEDULER_H_
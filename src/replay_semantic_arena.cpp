@@ -0,0 +1,102 @@
+#include "replay_semantic_arena.h"
+
+#include <utility>
+
+namespace vicad {
+
+namespace {
+
+template <typename T>
+ReplaySpan append_span(std::vector<T> *arena, const T *data, size_t count) {
+  ReplaySpan span = {(uint32_t)arena->size(), (uint32_t)count};
+  arena->insert(arena->end(), data, data + count);
+  return span;
+}
+
+}  // namespace
+
+ReplayNodeSemantic StoreReplaySemantic(ReplaySemanticArena *arena, const ReplaySemanticValue &value, uint32_t out_id,
+                                       std::span<const uint32_t> inputs) {
+  ReplayNodeSemantic sem;
+  sem.opcode = value.opcode;
+  sem.out_id = out_id;
+  sem.inputs = append_span(&arena->u32, inputs.data(), inputs.size());
+  sem.params_f64 = append_span(&arena->f64, value.params_f64.data(), value.params_f64.size());
+  sem.params_u32 = append_span(&arena->u32, value.params_u32.data(), value.params_u32.size());
+  sem.has_polygons = value.has_polygons;
+  if (value.has_polygons) {
+    sem.ring_sizes = {(uint32_t)arena->u32.size(), (uint32_t)value.polygons.size()};
+    sem.points.offset = (uint32_t)arena->points.size();
+    for (const manifold::SimplePolygon &ring : value.polygons) {
+      arena->u32.push_back((uint32_t)ring.size());
+      arena->points.insert(arena->points.end(), ring.begin(), ring.end());
+    }
+    sem.points.count = (uint32_t)arena->points.size() - sem.points.offset;
+  }
+  sem.valid = true;
+  return sem;
+}
+
+ReplayNodeSemantic CopyReplaySemantic(const ReplaySemanticArena &src, const ReplayNodeSemantic &from,
+                                      ReplaySemanticArena *dst, uint32_t out_id, std::span<const uint32_t> inputs) {
+  ReplayNodeSemantic sem = from;
+  sem.out_id = out_id;
+  sem.inputs = append_span(&dst->u32, inputs.data(), inputs.size());
+  sem.params_f64 = append_span(&dst->f64, src.f64.data() + from.params_f64.offset, from.params_f64.count);
+  sem.params_u32 = append_span(&dst->u32, src.u32.data() + from.params_u32.offset, from.params_u32.count);
+  sem.ring_sizes = append_span(&dst->u32, src.u32.data() + from.ring_sizes.offset, from.ring_sizes.count);
+  sem.points = append_span(&dst->points, src.points.data() + from.points.offset, from.points.count);
+  return sem;
+}
+
+ReplaySemanticValue ReplaySemanticValueOf(const ReplayTables &tables, const ReplayNodeSemantic &sem) {
+  ReplaySemanticValue value;
+  value.opcode = sem.opcode;
+  const auto inputs = ReplaySemanticInputs(tables, sem);
+  const auto f64 = ReplaySemanticF64(tables, sem);
+  const auto u32 = ReplaySemanticU32(tables, sem);
+  value.inputs.assign(inputs.begin(), inputs.end());
+  value.params_f64.assign(f64.begin(), f64.end());
+  value.params_u32.assign(u32.begin(), u32.end());
+  value.has_polygons = sem.has_polygons;
+  if (sem.has_polygons) value.polygons = ReplaySemanticPolygons(tables, sem);
+  return value;
+}
+
+void DropUnreachableReplaySemantics(ReplayTables *tables, const std::vector<uint32_t> &roots) {
+  std::vector<uint8_t> reachable(tables->node_semantics.size(), 0);
+  std::vector<uint32_t> pending;
+  for (uint32_t root : roots) pending.push_back(root);
+  while (!pending.empty()) {
+    const uint32_t id = pending.back();
+    pending.pop_back();
+    if ((size_t)id >= reachable.size() || reachable[id]) continue;
+    reachable[id] = 1;
+    for (uint32_t in_id : ReplaySemanticInputs(*tables, tables->node_semantics[id])) pending.push_back(in_id);
+  }
+  ReplaySemanticArena arena;
+  for (size_t id = 0; id < reachable.size(); ++id) {
+    ReplayNodeSemantic &sem = tables->node_semantics[id];
+    if (!reachable[id] || !sem.valid) {
+      sem = ReplayNodeSemantic{};
+      continue;
+    }
+    sem = CopyReplaySemantic(tables->semantic_arena, sem, &arena, sem.out_id, ReplaySemanticInputs(*tables, sem));
+  }
+  tables->semantic_arena = std::move(arena);
+}
+
+manifold::Polygons ReplaySemanticPolygons(const ReplayTables &tables, const ReplayNodeSemantic &sem) {
+  manifold::Polygons polygons;
+  if (!sem.has_polygons) return polygons;
+  const uint32_t *ring_sizes = tables.semantic_arena.u32.data() + sem.ring_sizes.offset;
+  const manifold::vec2 *point = tables.semantic_arena.points.data() + sem.points.offset;
+  polygons.reserve(sem.ring_sizes.count);
+  for (uint32_t r = 0; r < sem.ring_sizes.count; ++r) {
+    polygons.emplace_back(point, point + ring_sizes[r]);
+    point += ring_sizes[r];
+  }
+  return polygons;
+}
+
+}  // namespace vicad
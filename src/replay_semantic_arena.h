@@ -0,0 +1,28 @@
+#ifndef VICAD_REPLAY_SEMANTIC_ARENA_H_
+#define VICAD_REPLAY_SEMANTIC_ARENA_H_
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "op_decoder.h"
+
+namespace vicad {
+
+// Appends a semantic to the arena. `inputs` replaces value.inputs, since
+// installed nodes take their input ids from this run.
+ReplayNodeSemantic StoreReplaySemantic(ReplaySemanticArena *arena, const ReplaySemanticValue &value, uint32_t out_id,
+                                       std::span<const uint32_t> inputs);
+// Copies a semantic between arenas (of different tables), with new inputs.
+ReplayNodeSemantic CopyReplaySemantic(const ReplaySemanticArena &src, const ReplayNodeSemantic &from,
+                                      ReplaySemanticArena *dst, uint32_t out_id, std::span<const uint32_t> inputs);
+// Self-contained copy of a node's semantic, e.g. for the replay cache.
+ReplaySemanticValue ReplaySemanticValueOf(const ReplayTables &tables, const ReplayNodeSemantic &sem);
+// Keeps semantics only for nodes an op trace or sketch dimension model of a
+// root can reach; both walk semantic inputs from the root. The survivors are
+// compacted into a fresh arena.
+void DropUnreachableReplaySemantics(ReplayTables *tables, const std::vector<uint32_t> &roots);
+
+}  // namespace vicad
+
+#endif  // VICAD_REPLAY_SEMANTIC_ARENA_H_
@@ -0,0 +1,233 @@
+#include "replay_stream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "replay_cache.h"
+#include "replay_scheduler.h"
+#include "replay_semantic_arena.h"
+#include "trace.h"
+
+namespace vicad {
+
+namespace {
+
+// Reads the u32 at `*off` of a payload of `len` bytes and advances past it.
+bool read_u32_at(const uint8_t *payload, uint32_t len, size_t *off, uint32_t *out) {
+  if (*off + sizeof(uint32_t) > len) return false;
+  std::memcpy(out, payload + *off, sizeof(uint32_t));
+  *off += sizeof(uint32_t);
+  return true;
+}
+
+bool apply_kept_record(ReplayStream *stream, const uint8_t *payload_ptr, uint32_t payload_len,
+                       uint32_t *out_id, std::string *error) {
+  size_t off = 0;
+  uint32_t base_id = 0;
+  if (!read_u32_at(payload_ptr, payload_len, &off, out_id) ||
+      !read_u32_at(payload_ptr, payload_len, &off, &base_id)) {
+    *error = "Replay failed: invalid keep record.";
+    return false;
+  }
+  const ReplayTables *base = stream->base.get();
+  if (!base || (size_t)base_id >= base->node_semantics.size() || !base->node_semantics[base_id].valid) {
+    *error = "Replay failed: keep record references missing base node " + std::to_string(base_id);
+    return false;
+  }
+  const ReplayNodeSemantic &semantic = base->node_semantics[base_id];
+  std::vector<uint32_t> inputs;
+  inputs.reserve(semantic.inputs.count);
+  for (uint32_t in_id : ReplaySemanticInputs(*base, semantic)) {
+    auto it = stream->kept_ids.find(in_id);
+    if (it == stream->kept_ids.end()) {
+      *error = "Replay failed: keep record input " + std::to_string(in_id) + " was not kept.";
+      return false;
+    }
+    inputs.push_back(it->second);
+  }
+  ReplayTables *tables = &stream->tables;
+  InstallReplayNode(tables, *out_id, (NodeKind)base->node_kind[base_id], base->manifold_nodes[base_id],
+                    base->cross_nodes[base_id], base->cross_plane[base_id]);
+  tables->node_semantics[*out_id] =
+      CopyReplaySemantic(base->semantic_arena, semantic, &tables->semantic_arena, *out_id, inputs);
+  stream->kept_ids[base_id] = *out_id;
+  stream->kept++;
+  return true;
+}
+
+}  // namespace
+
+// Layouts mirror the payload cases of ReplayRecord.
+void ReplayRecordInputOffsets(const OpRecordHeader &hdr, const uint8_t *payload, std::vector<uint32_t> *out) {
+  out->clear();
+  const uint32_t len = hdr.payload_len;
+  auto fits = [&](size_t off) { return off + sizeof(uint32_t) <= len; };
+  switch ((OpCode)hdr.opcode) {
+    case OpCode::Union: {
+      uint32_t count = 0;
+      if (!fits(4)) return;
+      std::memcpy(&count, payload + 4, sizeof(count));
+      for (uint32_t i = 0; i < count && fits(8 + 4 * (size_t)i); ++i) out->push_back(8 + 4 * i);
+    } break;
+    case OpCode::Subtract:
+    case OpCode::Intersect:
+      if (fits(4)) out->push_back(4);
+      if (fits(8)) out->push_back(8);
+      break;
+    case OpCode::Translate:
+    case OpCode::Rotate:
+    case OpCode::Scale:
+    case OpCode::Extrude:
+    case OpCode::Revolve:
+    case OpCode::Slice:
+    case OpCode::CrossTranslate:
+    case OpCode::CrossRotate:
+    case OpCode::CrossFillet:
+    case OpCode::CrossOffsetClone:
+    case OpCode::CrossPlane:
+    case OpCode::CrossFilletCorners:
+      if (fits(4)) out->push_back(4);
+      break;
+    default:
+      break;
+  }
+}
+
+void ReplayRecordInputs(const OpRecordHeader &hdr, const uint8_t *payload, std::vector<uint32_t> *out) {
+  thread_local std::vector<uint32_t> offsets;
+  ReplayRecordInputOffsets(hdr, payload, &offsets);
+  out->resize(offsets.size());
+  for (size_t i = 0; i < offsets.size(); ++i) std::memcpy(&(*out)[i], payload + offsets[i], sizeof(uint32_t));
+}
+
+void InstallReplayNode(ReplayTables *tables, uint32_t out_id, NodeKind kind, const manifold::Manifold &m,
+                       const manifold::CrossSection &cs, const SketchPlane &plane) {
+  EnsureReplayNode(tables, out_id);
+  tables->node_kind[out_id] = (uint8_t)kind;
+  if (kind == NodeKind::Manifold) tables->manifold_nodes[out_id] = m;
+  if (kind == NodeKind::CrossSection) tables->cross_nodes[out_id] = cs;
+  tables->cross_plane[out_id] = plane;
+}
+
+void ReleaseReplayNode(ReplayTables *tables, uint32_t id) {
+  tables->manifold_nodes[id] = manifold::Manifold();
+  tables->cross_nodes[id] = manifold::CrossSection();
+  tables->node_kind[id] = (uint8_t)NodeKind::Unknown;
+}
+
+void ReplayStreamBegin(ReplayStream *stream, const ReplayLodPolicy &lod_policy, ReplayCache *cache,
+                       std::shared_ptr<const ReplayTables> base) {
+  *stream = ReplayStream{};
+  stream->lod_policy = lod_policy;
+  stream->cache = cache;
+  stream->base = std::move(base);
+}
+
+bool ReplayStreamFeed(ReplayStream *stream, const uint8_t *records, size_t available,
+                      std::string *error) {
+  // Cache hits are installed immediately; misses are collected and replayed as
+  // a dependency graph so independent subtrees run concurrently.
+  std::vector<ReplayPending> misses;
+  uint32_t max_id = 0;
+  size_t off = stream->consumed;
+  uint32_t parsed = 0;
+  while (off + sizeof(OpRecordHeader) <= available) {
+    OpRecordHeader hdr = {};
+    std::memcpy(&hdr, records + off, sizeof(hdr));
+    const size_t payload_off = off + sizeof(hdr);
+    if (payload_off + hdr.payload_len > available) break;
+    const uint8_t *payload = records + payload_off;
+    if (hdr.payload_len < sizeof(uint32_t)) {
+      *error = "Replay failed: missing out node id.";
+      return false;
+    }
+    uint32_t out_id = 0;
+    std::memcpy(&out_id, payload, sizeof(out_id));
+    ReplayCache *cache = (hdr.digest != 0) ? stream->cache : nullptr;
+    if (hdr.flags & kOpRecordFlagKeep) {
+      if (!apply_kept_record(stream, payload, hdr.payload_len, &out_id, error)) return false;
+      stream->tables.node_digest[out_id] = hdr.digest;
+      // Keep the cache warm for runs that cannot be sent as a delta.
+      if (cache) {
+        cache->Insert(hdr.digest, LodKeyForPolicy(stream->lod_policy), ReplayCacheEntryOf(stream->tables, out_id));
+      }
+      off = payload_off + hdr.payload_len;
+      parsed++;
+      continue;
+    }
+    const ReplayCacheEntry *hit = cache ? cache->Find(hdr.digest, LodKeyForPolicy(stream->lod_policy)) : nullptr;
+    if (hit) {
+      if (!ApplyReplayCacheEntry(*hit, hdr, payload, &stream->tables, error)) return false;
+      stream->tables.node_digest[out_id] = hdr.digest;
+    } else {
+      misses.push_back({hdr, payload, out_id});
+      max_id = std::max(max_id, out_id);
+    }
+    off = payload_off + hdr.payload_len;
+    parsed++;
+  }
+
+  ReplayTables &tables = stream->tables;
+  if (!misses.empty()) {
+    // Size the tables up front: replay tasks write distinct slots and must not
+    // reallocate while others read their inputs.
+    EnsureReplayNode(&tables, max_id);
+    for (const ReplayPending &p : misses) tables.node_digest[p.out_id] = p.hdr.digest;
+    if (!ReplayPendingRecords(stream, misses, max_id, error)) return false;
+  }
+  if (stream->release_dead) DropUnreachableReplaySemantics(&tables, stream->roots);
+  stream->consumed = off;
+  stream->parsed += parsed;
+  return true;
+}
+
+bool ReplayStreamFinish(const ReplayStream &stream, size_t records_size, uint32_t op_count,
+                        std::string *error) {
+  if (stream.consumed > records_size) {
+    *error = "Replay failed: op stream overran the records blob.";
+    return false;
+  }
+  if (stream.consumed < records_size) {
+    *error = (records_size - stream.consumed < sizeof(OpRecordHeader))
+                 ? "Replay failed: truncated op header."
+                 : "Replay failed: truncated op payload.";
+    return false;
+  }
+  if (stream.parsed != op_count) {
+    *error = "Replay failed: op count mismatch.";
+    return false;
+  }
+  return true;
+}
+
+bool ReplayOpsToTables(const uint8_t *records, size_t records_size, uint32_t op_count,
+                       const ReplayLodPolicy &lod_policy,
+                       ReplayTables *tables, std::string *error) {
+  ReplayStream stream;
+  ReplayStreamBegin(&stream, lod_policy);
+  if (!ReplayStreamFeed(&stream, records, records_size, error) ||
+      !ReplayStreamFinish(stream, records_size, op_count, error)) {
+    return false;
+  }
+  *tables = std::move(stream.tables);
+  return true;
+}
+
+bool ReplayOpsToMesh(const ReplayInput &in, manifold::MeshGL *mesh, std::string *error) {
+  ReplayTables tables;
+  if (!ReplayOpsToTables(in.records, in.records_size, in.op_count,
+                         in.lod_policy, &tables, error)) {
+    return false;
+  }
+  manifold::Manifold out;
+  if (!ResolveReplayManifold(tables, in.root_kind, in.root_id,
+                             in.lod_policy, &out, error)) {
+    return false;
+  }
+  TraceSpan span("mesh", "GetMeshGL");
+  *mesh = out.GetMeshGL();
+  return true;
+}
+
+}  // namespace vicad
@@ -0,0 +1,79 @@
+#ifndef VICAD_REPLAY_STREAM_H_
+#define VICAD_REPLAY_STREAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "manifold/manifold.h"
+#include "ipc_protocol.h"
+#include "lod_policy.h"
+#include "op_decoder.h"
+
+namespace vicad {
+
+class ReplayCache;
+
+// Incremental form of ReplayOpsToTables for records that arrive while the
+// worker is still encoding. Each feed replays every complete record in
+// [consumed, available); finish checks the stream against the final totals.
+// With a cache, records whose digest was replayed before are not rebuilt.
+// With a base (the tables of the delta base run), keep records copy their node
+// from it, so only new and changed records are replayed.
+struct ReplayStream {
+  ReplayTables tables;
+  ReplayLodPolicy lod_policy = {};
+  ReplayCache *cache = nullptr;
+  std::shared_ptr<const ReplayTables> base;
+  // Base node id -> node id in this run, for remapping kept semantics.
+  std::unordered_map<uint32_t, uint32_t> kept_ids;
+  // Low-memory mode: every record is fed in one batch and `roots` lists the
+  // scene roots up front. Intermediate geometry is released after its last
+  // use and semantics are kept only for nodes reachable from a root. Meant to
+  // run without a cache or base, which would hold the intermediates anyway.
+  bool release_dead = false;
+  std::vector<uint32_t> roots;
+  size_t consumed = 0;
+  uint32_t parsed = 0;
+  uint32_t kept = 0;
+};
+
+void ReplayStreamBegin(ReplayStream *stream, const ReplayLodPolicy &lod_policy,
+                       ReplayCache *cache = nullptr,
+                       std::shared_ptr<const ReplayTables> base = nullptr);
+bool ReplayStreamFeed(ReplayStream *stream, const uint8_t *records, size_t available,
+                      std::string *error);
+bool ReplayStreamFinish(const ReplayStream &stream, size_t records_size, uint32_t op_count,
+                        std::string *error);
+
+bool ReplayOpsToTables(const uint8_t *records, size_t records_size, uint32_t op_count,
+                       const ReplayLodPolicy &lod_policy,
+                       ReplayTables *tables, std::string *error);
+
+struct ReplayInput {
+  const uint8_t *records;
+  size_t records_size;
+  uint32_t op_count;
+  uint32_t root_kind;
+  uint32_t root_id;
+  // Allows per-call modelling/export profile selection and future postprocess.
+  ReplayLodPolicy lod_policy = {};
+};
+bool ReplayOpsToMesh(const ReplayInput &in, manifold::MeshGL *mesh, std::string *error);
+
+// Byte offsets of the input node ids (u32 each) in a record's payload.
+void ReplayRecordInputOffsets(const OpRecordHeader &hdr, const uint8_t *payload, std::vector<uint32_t> *out);
+// Input node ids of a record, read without replaying it.
+void ReplayRecordInputs(const OpRecordHeader &hdr, const uint8_t *payload, std::vector<uint32_t> *out);
+// Installs geometry under node `out_id`; the caller stores the semantic.
+void InstallReplayNode(ReplayTables *tables, uint32_t out_id, NodeKind kind, const manifold::Manifold &m,
+                       const manifold::CrossSection &cs, const SketchPlane &plane);
+// Frees the geometry of node `id`; its semantic is kept.
+void ReleaseReplayNode(ReplayTables *tables, uint32_t id);
+
+}  // namespace vicad
+
+#endif  // VICAD_REPLAY_STREAM_H_
@@ -6,33 +6,23 @@
 //
 // Usage:  build/run_script <path/to/script.vicad.ts>
 //
+// With VICAD_TRACE=<path> set, the run's trace spans are written to <path>
+// as a Chrome trace (see trace.h).
+//
 // Exit codes:
 //   0  — script executed successfully; stdout contains a "pass" JSON line
 //   1  — script failed or usage error; stdout contains a "fail" JSON line
 
 #include <cstdio>
+#include <cstdlib>
 #include <string>
 #include <vector>
 
+#include "json_escape.h"
 #include "lod_policy.h"
+#include "log.h"
 #include "script_worker_client.h"
-
-namespace {
-
-void json_str(const char *s) {
-  for (const char *p = s; *p != '\0'; ++p) {
-    const unsigned char c = (unsigned char)*p;
-    if      (c == '"')  std::fputs("\\\"", stdout);
-    else if (c == '\\') std::fputs("\\\\", stdout);
-    else if (c == '\n') std::fputs("\\n",  stdout);
-    else if (c == '\r') std::fputs("\\r",  stdout);
-    else if (c == '\t') std::fputs("\\t",  stdout);
-    else if (c < 0x20)  std::fprintf(stdout, "\\u%04x", c);
-    else                std::fputc(c, stdout);
-  }
-}
-
-}  // namespace
+#include "trace.h"
 
 int main(int argc, char **argv) {
   if (argc < 2) {
@@ -41,25 +31,35 @@ int main(int argc, char **argv) {
     return 1;
   }
   const char *script = argv[1];
+  const char *trace_path = std::getenv("VICAD_TRACE");
+  if (trace_path && trace_path[0]) vicad::trace_enable();
 
   vicad::ScriptWorkerClient client;
+  // Single run: a standby worker would only be spawned to be torn down again.
+  client.set_standby_enabled(false);
+  // Nothing is reloaded, so nothing is worth caching for a next run.
+  client.set_low_memory_replay(true);
   std::vector<vicad::ScriptSceneObject> objects;
   std::string error;
   vicad::ReplayLodPolicy lod = {};
   lod.profile = vicad::LodProfile::Model;
 
   const bool ok = client.ExecuteScriptScene(script, &objects, &error, lod);
+  std::string trace_err;
+  if (vicad::trace_enabled() && !vicad::trace_write(trace_path, &trace_err)) {
+    vicad::log_event("TRACE_FAILED", 0, trace_err.c_str());
+  }
 
   if (ok) {
     std::fprintf(stdout, "{\"result\":\"pass\",\"script\":\"");
-    json_str(script);
+    vicad::write_json_escaped(stdout, script);
     std::fprintf(stdout, "\",\"objects\":%zu}\n", objects.size());
     return 0;
   } else {
     std::fprintf(stdout, "{\"result\":\"fail\",\"script\":\"");
-    json_str(script);
+    vicad::write_json_escaped(stdout, script);
     std::fprintf(stdout, "\",\"error\":\"");
-    json_str(error.c_str());
+    vicad::write_json_escaped(stdout, error.c_str());
     std::fprintf(stdout, "\"}\n");
     return 1;
   }
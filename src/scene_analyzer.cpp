@@ -0,0 +1,127 @@
+#include "scene_analyzer.h"
+
+#include <utility>
+
+#include "trace.h"
+#include "union_by_bounds.h"
+
+namespace vicad_scene {
+
+bool SceneMergeManifolds(const std::vector<manifold::Manifold> &parts, manifold::MeshGL *mesh, std::string *err) {
+    if (parts.empty()) {
+        *mesh = manifold::MeshGL();
+        mesh->numProp = 3;
+        return true;
+    }
+    vicad::TraceSpan span("scene", "merge");
+    // Plates of separate parts are mostly disjoint, so most of the merge is
+    // a mesh concatenation rather than CSG.
+    manifold::Manifold merged = vicad::UnionByBounds(parts);
+    if (merged.Status() != manifold::Manifold::Error::NoError) {
+        *err = std::string("Scene merge failed: ") + SceneManifoldErrorString(merged.Status());
+        return false;
+    }
+    *mesh = merged.GetMeshGL();
+    return true;
+}
+
+const char *SceneManifoldErrorString(manifold::Manifold::Error error) {
+    switch (error) {
+        case manifold::Manifold::Error::NoError: return "No error";
+        case manifold::Manifold::Error::NonFiniteVertex: return "Non-finite vertex";
+        case manifold::Manifold::Error::NotManifold: return "Not manifold";
+        case manifold::Manifold::Error::VertexOutOfBounds: return "Vertex out of bounds";
+        case manifold::Manifold::Error::PropertiesWrongLength: return "Properties wrong length";
+        case manifold::Manifold::Error::MissingPositionProperties: return "Missing position properties";
+        case manifold::Manifold::Error::MergeVectorsDifferentLengths: return "Merge vectors different lengths";
+        case manifold::Manifold::Error::MergeIndexOutOfBounds: return "Merge index out of bounds";
+        case manifold::Manifold::Error::TransformWrongLength: return "Transform wrong length";
+        case manifold::Manifold::Error::RunIndexWrongLength: return "Run index wrong length";
+        case manifold::Manifold::Error::FaceIDWrongLength: return "Face id wrong length";
+        case manifold::Manifold::Error::InvalidConstruction: return "Invalid construction";
+        default: return "Unknown manifold error";
+    }
+}
+
+SceneAnalyzer::SceneAnalyzer(std::function<void()> on_ready) : on_ready_(std::move(on_ready)) {
+    // Start the thread only after all members are fully constructed.
+    thread_ = std::thread(&SceneAnalyzer::RunLoop, this);
+}
+
+SceneAnalyzer::~SceneAnalyzer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    if (thread_.joinable()) thread_.join();
+}
+
+void SceneAnalyzer::Submit(uint64_t generation, std::vector<manifold::Manifold> parts,
+                           std::vector<vicad::FaceSource> sources, float face_angle_deg) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        has_job_ = true;
+        job_generation_ = generation;
+        job_parts_ = std::move(parts);
+        job_sources_ = std::move(sources);
+        job_face_angle_deg_ = face_angle_deg;
+        has_result_ = false;
+    }
+    wake_.notify_one();
+}
+
+bool SceneAnalyzer::TakeResult(SceneAnalysisResult *out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!has_result_) return false;
+    *out = std::move(result_);
+    has_result_ = false;
+    return true;
+}
+
+bool SceneAnalyzer::Busy() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return has_job_ || running_ || has_result_;
+}
+
+void SceneAnalyzer::RunLoop() {
+    vicad::trace_thread_name("analyzer");
+    for (;;) {
+        std::vector<manifold::Manifold> parts;
+        std::vector<vicad::FaceSource> sources;
+        SceneAnalysisResult result;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stop_ || has_job_; });
+            if (stop_) return;
+            has_job_ = false;
+            running_ = true;
+            result.generation = job_generation_;
+            result.face_angle_deg = job_face_angle_deg_;
+            parts = std::move(job_parts_);
+            sources = std::move(job_sources_);
+        }
+
+        result.ok = SceneMergeManifolds(parts, &result.mesh, &result.error);
+        parts.clear();
+        if (result.ok) {
+            result.topology = vicad::BuildMeshTopology(result.mesh);
+            // Both only read the mesh and its topology.
+            std::thread edges([&result] { result.edges = vicad::BuildEdgeTopology(result.mesh, result.topology); });
+            result.faces = vicad::DetectMeshFaces(result.mesh, result.topology, result.face_angle_deg, sources);
+            edges.join();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+            // A newer submission makes this result stale.
+            if (has_job_) continue;
+            result_ = std::move(result);
+            has_result_ = true;
+        }
+        if (on_ready_) on_ready_();
+    }
+}
+
+}  // namespace vicad_scene
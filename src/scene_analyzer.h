@@ -0,0 +1,73 @@
+#ifndef VICAD_SCENE_ANALYZER_H_
+#define VICAD_SCENE_ANALYZER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "edge_detection.h"
+#include "face_detection.h"
+#include "manifold/manifold.h"
+#include "mesh_topology.h"
+
+namespace vicad_scene {
+
+struct SceneAnalysisResult {
+    uint64_t generation = 0;
+    bool ok = false;
+    std::string error;
+    float face_angle_deg = 0.0f;
+    manifold::MeshGL mesh;
+    vicad::MeshTopology topology;
+    vicad::FaceDetectionResult faces;
+    vicad::EdgeDetectionResult edges;
+};
+
+// Background thread that merges a scene's manifold objects and derives what
+// face and edge selection need from the merged mesh: its topology, face
+// regions and edge topology. Only the newest submission is kept.
+class SceneAnalyzer {
+  public:
+    explicit SceneAnalyzer(std::function<void()> on_ready);
+    ~SceneAnalyzer();
+
+    SceneAnalyzer(const SceneAnalyzer &) = delete;
+    SceneAnalyzer &operator=(const SceneAnalyzer &) = delete;
+
+    // `sources` types faces from op provenance (see DetectMeshFaces).
+    void Submit(uint64_t generation, std::vector<manifold::Manifold> parts, std::vector<vicad::FaceSource> sources,
+                float face_angle_deg);
+    bool TakeResult(SceneAnalysisResult *out);
+    // An analysis is queued, running or has a result not yet taken.
+    bool Busy() const;
+
+  private:
+    void RunLoop();
+
+    std::function<void()> on_ready_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    bool has_job_ = false;
+    bool running_ = false;
+    uint64_t job_generation_ = 0;
+    std::vector<manifold::Manifold> job_parts_;
+    std::vector<vicad::FaceSource> job_sources_;
+    float job_face_angle_deg_ = 0.0f;
+    bool has_result_ = false;
+    SceneAnalysisResult result_;
+    std::thread thread_;
+};
+
+// Merges manifolds into one mesh. Only export and whole-scene topology
+// (face/edge selection) need this; display and picking go per object.
+bool SceneMergeManifolds(const std::vector<manifold::Manifold> &parts, manifold::MeshGL *mesh, std::string *err);
+const char *SceneManifoldErrorString(manifold::Manifold::Error error);
+
+}  // namespace vicad_scene
+
+#endif  // VICAD_SCENE_ANALYZER_H_
@@ -0,0 +1,335 @@
+#include "scene_decode.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+#include "ipc_protocol.h"
+#include "op_decoder.h"
+#include "replay_cache.h"
+
+namespace vicad {
+
+namespace {
+
+bool set_err(std::string *error, const std::string &msg) {
+  if (error) *error = msg;
+  return false;
+}
+
+bool compute_sketch_bounds(const std::vector<ScriptSketchContour> &contours,
+                           SceneVec3 *out_min, SceneVec3 *out_max) {
+  double minx = std::numeric_limits<double>::infinity();
+  double miny = std::numeric_limits<double>::infinity();
+  double minz = std::numeric_limits<double>::infinity();
+  double maxx = -std::numeric_limits<double>::infinity();
+  double maxy = -std::numeric_limits<double>::infinity();
+  double maxz = -std::numeric_limits<double>::infinity();
+  for (const ScriptSketchContour &contour : contours) {
+    for (const SceneVec3 &p : contour.points) {
+      const double x = p.x;
+      const double y = p.y;
+      const double z = p.z;
+      if (!std::isfinite(x) || !std::isfinite(y) || !std::isfinite(z)) continue;
+      minx = std::min(minx, x);
+      miny = std::min(miny, y);
+      minz = std::min(minz, z);
+      maxx = std::max(maxx, x);
+      maxy = std::max(maxy, y);
+      maxz = std::max(maxz, z);
+    }
+  }
+  if (!std::isfinite(minx) || !std::isfinite(maxx)) return false;
+  const double pad = 1e-3;
+  *out_min = {(float)minx, (float)miny, (float)(minz - pad)};
+  *out_max = {(float)maxx, (float)maxy, (float)(maxz + pad)};
+  return true;
+}
+
+SceneVec3 map_sketch_point_to_world(double x, double y, const SketchPlane &plane) {
+  switch (plane.kind) {
+    case SketchPlaneKind::XY: return {(float)x, (float)y, (float)plane.offset};
+    case SketchPlaneKind::XZ: return {(float)x, (float)plane.offset, (float)-y};
+    case SketchPlaneKind::YZ: return {(float)plane.offset, (float)x, (float)y};
+  }
+  return {(float)x, (float)y, (float)plane.offset};
+}
+
+}  // namespace
+
+bool DecodeSceneResponse(const uint8_t *resp_ptr, size_t response_length,
+                         ReplayStream *stream,
+                         std::vector<ScriptSceneObject> *objects,
+                         std::string *error,
+                         std::vector<std::string> *imports) {
+  if (!resp_ptr || !stream || !objects) return set_err(error, "Invalid scene decode arguments.");
+  if (response_length < sizeof(ResponsePayloadScene)) return set_err(error, "Worker response payload is too small.");
+  ResponsePayloadScene ok = {};
+  std::memcpy(&ok, resp_ptr, sizeof(ok));
+  if (ok.version != kIpcVersion) {
+    return set_err(error, "Worker response version mismatch. Check worker/client protocol compatibility.");
+  }
+
+  const size_t payload_need =
+      sizeof(ResponsePayloadScene) + (size_t)ok.records_size + (size_t)ok.object_table_size + (size_t)ok.diagnostics_len;
+  if (payload_need > response_length) return set_err(error, "Worker response payload is truncated.");
+
+  const uint8_t *records_ptr = resp_ptr + sizeof(ResponsePayloadScene);
+  const uint8_t *object_table_ptr = records_ptr + ok.records_size;
+  const uint8_t *names_ptr = object_table_ptr + ok.object_table_size;
+  const size_t name_blob_size = (size_t)ok.diagnostics_len;
+  const size_t expected_table_size = (size_t)ok.object_count * sizeof(SceneObjectRecord);
+  if (ok.object_count == 0) return set_err(error, "Worker returned zero scene objects.");
+  if (ok.object_table_size != expected_table_size) {
+    return set_err(error, "Worker scene object table size mismatch.");
+  }
+
+  if (stream->release_dead) {
+    stream->roots.clear();
+    for (uint32_t i = 0; i < ok.object_count; ++i) {
+      SceneObjectRecord rec = {};
+      std::memcpy(&rec, object_table_ptr + i * sizeof(SceneObjectRecord), sizeof(SceneObjectRecord));
+      stream->roots.push_back(rec.root_id);
+    }
+  }
+  if (!ReplayStreamFeed(stream, records_ptr, ok.records_size, error) ||
+      !ReplayStreamFinish(*stream, ok.records_size, ok.op_count, error)) {
+    return false;
+  }
+  // Objects keep the tables alive for their lazily built op traces and sketch
+  // dimensions; the stream is done with them.
+  auto shared_tables = std::make_shared<const ReplayTables>(std::move(stream->tables));
+  const ReplayTables &tables = *shared_tables;
+  const ReplayLodPolicy &lod_policy = stream->lod_policy;
+
+  size_t name_off = 0;
+  objects->reserve(ok.object_count);
+  for (uint32_t i = 0; i < ok.object_count; ++i) {
+    SceneObjectRecord rec = {};
+    std::memcpy(&rec, object_table_ptr + i * sizeof(SceneObjectRecord), sizeof(SceneObjectRecord));
+    if (name_off + rec.name_len > name_blob_size) {
+      return set_err(error, "Worker scene name blob is truncated.");
+    }
+    ScriptSceneObject obj;
+    obj.objectId = rec.object_id_hash;
+    obj.name.assign((const char *)(names_ptr + name_off), (size_t)rec.name_len);
+    obj.kind = ScriptSceneObjectKind::Unknown;
+    obj.rootKind = rec.root_kind;
+    obj.rootId = rec.root_id;
+    if ((size_t)rec.root_id < tables.node_digest.size()) obj.rootDigest = tables.node_digest[rec.root_id];
+    obj.lodKey = LodKeyForPolicy(lod_policy);
+    obj.tables = shared_tables;
+
+    if (rec.root_kind == (uint32_t)NodeKind::Manifold) {
+      manifold::Manifold m;
+      if (!ResolveReplayManifold(tables, rec.root_kind, rec.root_id,
+                                 lod_policy, &m, error)) {
+        return false;
+      }
+      obj.kind = ScriptSceneObjectKind::Manifold;
+      obj.manifold = std::move(m);
+      const manifold::Box box = obj.manifold.BoundingBox();
+      if (obj.manifold.IsEmpty() || !std::isfinite(box.min.x) || !std::isfinite(box.max.x)) {
+        return set_err(error, "Failed to compute bounds for scene object " + std::to_string(i));
+      }
+      obj.bmin = {(float)box.min.x, (float)box.min.y, (float)box.min.z};
+      obj.bmax = {(float)box.max.x, (float)box.max.y, (float)box.max.z};
+    } else if (rec.root_kind == (uint32_t)NodeKind::CrossSection) {
+      manifold::CrossSection cs;
+      if (!ResolveReplayCrossSection(tables, rec.root_kind, rec.root_id, &cs, error)) return false;
+      SketchPlane plane;
+      if (!ResolveReplayCrossSectionPlane(tables, rec.root_kind, rec.root_id, &plane, error)) return false;
+      obj.kind = ScriptSceneObjectKind::CrossSection;
+      manifold::Polygons polys = cs.ToPolygons();
+      obj.sketchContours.reserve(polys.size());
+      for (const manifold::SimplePolygon &poly : polys) {
+        if (poly.empty()) continue;
+        ScriptSketchContour contour;
+        contour.points.reserve(poly.size());
+        for (const manifold::vec2 &p : poly) {
+          contour.points.push_back(map_sketch_point_to_world(p.x, p.y, plane));
+        }
+        obj.sketchContours.push_back(std::move(contour));
+      }
+      if (!compute_sketch_bounds(obj.sketchContours, &obj.bmin, &obj.bmax)) {
+        obj.bmin = {0.0f, 0.0f, 0.0f};
+        obj.bmax = {0.0f, 0.0f, 0.0f};
+      }
+    } else {
+      return set_err(error, "Worker scene object has unsupported root kind.");
+    }
+
+    name_off += rec.name_len;
+    objects->push_back(std::move(obj));
+  }
+  ResolveSceneInstances(objects);
+
+  if (imports) {
+    imports->clear();
+    const char *rest = (const char *)names_ptr + name_off;
+    const char *end = (const char *)names_ptr + name_blob_size;
+    while (rest < end) {
+      const char *line_end = std::find(rest, end, '\n');
+      if (line_end > rest) imports->emplace_back(rest, line_end);
+      rest = line_end == end ? end : line_end + 1;
+    }
+  }
+  return true;
+}
+
+bool ReplaySceneResponse(const std::vector<uint8_t> &response, const ReplayLodPolicy &lod_policy,
+                         ReplayCache *cache, std::vector<ScriptSceneObject> *objects,
+                         std::string *error) {
+  if (!objects) return set_err(error, "Invalid scene replay arguments.");
+  objects->clear();
+  if (cache) cache->BeginRun();
+  ReplayStream stream;
+  ReplayStreamBegin(&stream, lod_policy, cache);
+  if (!DecodeSceneResponse(response.data(), response.size(), &stream, objects, error)) return false;
+  if (cache) cache->EndRun(LodKeyForPolicy(lod_policy));
+  return true;
+}
+
+bool ExpandSceneResponseKeeps(const std::vector<uint8_t> &base, const uint8_t *resp_ptr, size_t response_length,
+                              std::vector<uint8_t> *out, std::string *error) {
+  ResponsePayloadScene base_hdr = {};
+  ResponsePayloadScene hdr = {};
+  if (base.size() < sizeof(base_hdr) || response_length < sizeof(hdr)) {
+    return set_err(error, "Scene response is too small to expand.");
+  }
+  std::memcpy(&base_hdr, base.data(), sizeof(base_hdr));
+  std::memcpy(&hdr, resp_ptr, sizeof(hdr));
+  const uint8_t *base_records = base.data() + sizeof(base_hdr);
+  const uint8_t *records = resp_ptr + sizeof(hdr);
+  if (sizeof(base_hdr) + (size_t)base_hdr.records_size > base.size() ||
+      sizeof(hdr) + (size_t)hdr.records_size > response_length) {
+    return set_err(error, "Scene response records are truncated.");
+  }
+
+  // Offset of the record that produced each node of the base run.
+  std::unordered_map<uint32_t, size_t> base_record_of;
+  for (size_t off = 0; off + sizeof(OpRecordHeader) + sizeof(uint32_t) <= base_hdr.records_size;) {
+    OpRecordHeader rh = {};
+    std::memcpy(&rh, base_records + off, sizeof(rh));
+    uint32_t out_id = 0;
+    std::memcpy(&out_id, base_records + off + sizeof(rh), sizeof(out_id));
+    base_record_of[out_id] = off;
+    off += sizeof(rh) + rh.payload_len;
+  }
+
+  out->assign(resp_ptr, resp_ptr + sizeof(hdr));
+  std::unordered_map<uint32_t, uint32_t> kept_ids;  // base node id -> node id in this run
+  std::vector<uint32_t> input_offsets;
+  for (size_t off = 0; off + sizeof(OpRecordHeader) <= hdr.records_size;) {
+    OpRecordHeader rh = {};
+    std::memcpy(&rh, records + off, sizeof(rh));
+    const uint8_t *payload = records + off + sizeof(rh);
+    const size_t next = off + sizeof(rh) + rh.payload_len;
+    if (next > hdr.records_size) return set_err(error, "Scene response records are truncated.");
+    off = next;
+    if (!(rh.flags & kOpRecordFlagKeep)) {
+      out->insert(out->end(), payload - sizeof(rh), payload + rh.payload_len);
+      continue;
+    }
+    uint32_t ids[2] = {};  // out id, base id
+    if (rh.payload_len < sizeof(ids)) return set_err(error, "Scene response has an invalid keep record.");
+    std::memcpy(ids, payload, sizeof(ids));
+    auto it = base_record_of.find(ids[1]);
+    if (it == base_record_of.end()) {
+      return set_err(error, "Keep record references base node " + std::to_string(ids[1]) + " the base lacks.");
+    }
+    OpRecordHeader kept_hdr = {};
+    std::memcpy(&kept_hdr, base_records + it->second, sizeof(kept_hdr));
+    const uint8_t *kept_payload = base_records + it->second + sizeof(kept_hdr);
+    const size_t at = out->size();
+    out->insert(out->end(), kept_payload - sizeof(kept_hdr), kept_payload + kept_hdr.payload_len);
+    uint8_t *copy = out->data() + at + sizeof(kept_hdr);
+    std::memcpy(copy, &ids[0], sizeof(uint32_t));
+    ReplayRecordInputOffsets(kept_hdr, kept_payload, &input_offsets);
+    for (uint32_t in_off : input_offsets) {
+      uint32_t in_id = 0;
+      std::memcpy(&in_id, kept_payload + in_off, sizeof(in_id));
+      auto kept = kept_ids.find(in_id);
+      if (kept == kept_ids.end()) {
+        return set_err(error, "Keep record input " + std::to_string(in_id) + " was not kept.");
+      }
+      std::memcpy(copy + in_off, &kept->second, sizeof(uint32_t));
+    }
+    kept_ids[ids[1]] = ids[0];
+  }
+
+  ResponsePayloadScene out_hdr = hdr;
+  out_hdr.records_size = (uint32_t)(out->size() - sizeof(hdr));
+  std::memcpy(out->data(), &out_hdr, sizeof(out_hdr));
+  out->insert(out->end(), records + hdr.records_size, resp_ptr + response_length);
+  return true;
+}
+
+void ReadSceneRunStats(const uint8_t *resp_ptr, ScriptRunStats *stats) {
+  ResponsePayloadScene hdr = {};
+  std::memcpy(&hdr, resp_ptr, sizeof(hdr));
+  stats->workerLoadUs = hdr.load_us;
+  stats->workerExecuteUs = hdr.execute_us;
+  stats->workerEncodeUs = hdr.encode_us;
+  stats->opCount = hdr.op_count;
+  stats->recordsBytes = hdr.records_size;
+}
+
+bool DecodeErrorResponse(const uint8_t *resp_ptr, size_t response_length,
+                         ScriptExecutionDiagnostic *diag, std::string *error) {
+  if (response_length < sizeof(ResponsePayloadError)) {
+    return set_err(error, "Worker error payload is truncated.");
+  }
+  ResponsePayloadError resp = {};
+  std::memcpy(&resp, resp_ptr, sizeof(resp));
+  if (resp.version != kIpcVersion) return set_err(error, "Worker error payload has invalid version.");
+  const size_t total = sizeof(resp) + (size_t)resp.file_len + (size_t)resp.stack_len + (size_t)resp.message_len;
+  if (total > response_length) return set_err(error, "Worker error message is truncated.");
+  const uint8_t *payload = resp_ptr + sizeof(resp);
+  diag->errorCode = resp.error_code;
+  diag->phase = resp.phase;
+  diag->line = resp.line;
+  diag->column = resp.column;
+  diag->runId = resp.run_id;
+  diag->durationMs = resp.duration_ms;
+  diag->file.assign((const char *)payload, (size_t)resp.file_len);
+  payload += resp.file_len;
+  diag->stack.assign((const char *)payload, (size_t)resp.stack_len);
+  payload += resp.stack_len;
+  diag->message.assign((const char *)payload, (size_t)resp.message_len);
+  return true;
+}
+
+const char *IpcErrorPhaseName(uint32_t phase) {
+  switch ((IpcErrorPhase)phase) {
+    case IpcErrorPhase::RequestDecode: return "request_decode";
+    case IpcErrorPhase::ScriptLoad: return "script_load";
+    case IpcErrorPhase::ScriptExecute: return "script_execute";
+    case IpcErrorPhase::SceneEncode: return "scene_encode";
+    case IpcErrorPhase::ResponseDecode: return "response_decode";
+    case IpcErrorPhase::Transport: return "transport";
+    case IpcErrorPhase::Unknown:
+    default: return "unknown";
+  }
+}
+
+std::string FormatScriptDiagnostic(const ScriptExecutionDiagnostic &diag) {
+  std::string out = "phase=" + std::string(IpcErrorPhaseName(diag.phase));
+  if (!diag.file.empty()) {
+    out += " file=" + diag.file;
+    if (diag.line > 0) {
+      out += ":" + std::to_string(diag.line);
+      if (diag.column > 0) out += ":" + std::to_string(diag.column);
+    }
+  }
+  if (diag.durationMs > 0) out += " duration_ms=" + std::to_string(diag.durationMs);
+  if (!diag.message.empty()) out += "\n" + diag.message;
+  if (!diag.stack.empty()) out += "\n" + diag.stack;
+  return out;
+}
+
+}  // namespace vicad
@@ -0,0 +1,84 @@
+#ifndef VICAD_SCENE_DECODE_H_
+#define VICAD_SCENE_DECODE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "op_decoder.h"
+#include "replay_stream.h"
+#include "scene_object.h"
+
+namespace vicad {
+
+// Why a run failed, decoded from a ResponsePayloadError.
+struct ScriptExecutionDiagnostic {
+  uint32_t errorCode = 0;
+  uint32_t phase = 0;
+  uint32_t line = 0;
+  uint32_t column = 0;
+  uint64_t runId = 0;
+  uint32_t durationMs = 0;
+  std::string file;
+  std::string message;
+  std::string stack;
+};
+
+// Timings and sizes of the last successful run. The worker phases come from
+// the scene response; the rest is measured on this side.
+struct ScriptRunStats {
+  uint32_t workerLoadUs = 0;
+  uint32_t workerExecuteUs = 0;
+  uint32_t workerEncodeUs = 0;
+  uint32_t opCount = 0;
+  uint32_t recordsBytes = 0;
+  // Records sent as keep records, i.e. reused from the delta base run.
+  uint32_t keptOps = 0;
+  // Request sent to response received.
+  double runMs = 0.0;
+  // Replaying records, while the script ran and after, and resolving objects.
+  double replayMs = 0.0;
+};
+
+// Decodes a ResponsePayloadScene (header, op records, object table, names)
+// into resolved scene objects. `resp_ptr` points at the payload header.
+// `stream` may already hold records replayed while the worker was running;
+// the remainder is replayed here. `imports`, when given, receives the modules
+// the script imported.
+bool DecodeSceneResponse(const uint8_t *resp_ptr, size_t response_length,
+                         ReplayStream *stream,
+                         std::vector<ScriptSceneObject> *objects,
+                         std::string *error,
+                         std::vector<std::string> *imports = nullptr);
+
+// Replays a complete scene response retained from an earlier run (see
+// ScriptWorkerClient::set_retain_scene_response), typically at another LOD
+// profile. Touches no client state, so it may run on any thread; `cache` may
+// be null and must not be shared with a concurrent replay.
+bool ReplaySceneResponse(const std::vector<uint8_t> &response, const ReplayLodPolicy &lod_policy,
+                         ReplayCache *cache, std::vector<ScriptSceneObject> *objects,
+                         std::string *error);
+
+// Rewrites the scene response at `resp_ptr` into `out` with every keep record
+// replaced by the record it kept from `base`, the self-contained response of
+// the delta base run, so the copy replays without the base run's tables.
+bool ExpandSceneResponseKeeps(const std::vector<uint8_t> &base, const uint8_t *resp_ptr, size_t response_length,
+                              std::vector<uint8_t> *out, std::string *error);
+
+// Reads the worker phase timings, op count and record size of a scene
+// response DecodeSceneResponse accepted into `stats`.
+void ReadSceneRunStats(const uint8_t *resp_ptr, ScriptRunStats *stats);
+
+// Decodes a ResponsePayloadError into `diag`.
+bool DecodeErrorResponse(const uint8_t *resp_ptr, size_t response_length,
+                         ScriptExecutionDiagnostic *diag, std::string *error);
+// Name of an IpcErrorPhase as it appears in logs and diagnostics.
+const char *IpcErrorPhaseName(uint32_t phase);
+// One-line summary of a failed run (phase, file:line:column, duration), then
+// the message and stack on their own lines.
+std::string FormatScriptDiagnostic(const ScriptExecutionDiagnostic &diag);
+
+}  // namespace vicad
+
+#endif  // VICAD_SCENE_DECODE_H_
@@ -0,0 +1,123 @@
+#include "scene_export_job.h"
+
+#include <cstdio>
+#include <utility>
+
+#include "scene_analyzer.h"
+#include "scene_decode.h"
+#include "threemf_writer.h"
+#include "trace.h"
+
+namespace vicad_scene {
+
+SceneExportJob::SceneExportJob(std::shared_ptr<const std::vector<uint8_t>> response,
+                               std::shared_ptr<vicad::ReplayCache> cache,
+                               std::string out_path,
+                               std::function<void()> on_done)
+    : response_(std::move(response)), cache_(std::move(cache)), on_done_(std::move(on_done)) {
+    progress_.path = std::move(out_path);
+    // Start the thread only after all members are fully constructed.
+    thread_ = std::thread(&SceneExportJob::Run, this);
+}
+
+SceneExportJob::~SceneExportJob() {
+    Cancel();
+    Wait();
+}
+
+void SceneExportJob::Cancel() { cancel_.store(true, std::memory_order_relaxed); }
+
+void SceneExportJob::Wait() {
+    if (thread_.joinable()) thread_.join();
+}
+
+SceneExportProgress SceneExportJob::Progress() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return progress_;
+}
+
+void SceneExportJob::finish(bool ok, std::string error) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        progress_.phase = SceneExportPhase::Finished;
+        progress_.ok = ok;
+        progress_.cancelled = !ok && cancel_.load(std::memory_order_relaxed);
+        progress_.error = std::move(error);
+    }
+    if (on_done_) on_done_();
+}
+
+void SceneExportJob::Run() {
+    vicad::trace_thread_name("export");
+    vicad::ReplayLodPolicy lod_policy = {};
+    lod_policy.profile = vicad::LodProfile::Export3MF;
+    std::vector<vicad::ScriptSceneObject> objects;
+    std::string error;
+    if (!vicad::ReplaySceneResponse(*response_, lod_policy, cache_.get(), &objects, &error)) {
+        finish(false, error);
+        return;
+    }
+    response_.reset();
+
+    uint32_t total = 0;
+    for (const vicad::ScriptSceneObject &obj : objects) {
+        if (obj.kind == vicad::ScriptSceneObjectKind::Manifold) total++;
+    }
+    if (total == 0) {
+        finish(false, "Script scene does not contain manifold geometry to export.");
+        return;
+    }
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        progress_.phase = SceneExportPhase::Writing;
+        progress_.objects_total = total;
+        path = progress_.path;
+    }
+
+    const std::string part_path = path + ".part";
+    vicad::ThreeMfWriter writer;
+    auto fail = [&](std::string why) {
+        writer.Abort();
+        std::remove(part_path.c_str());
+        finish(false, std::move(why));
+    };
+    if (!writer.Open(part_path, &error)) {
+        fail(error);
+        return;
+    }
+    uint32_t done = 0;
+    for (vicad::ScriptSceneObject &obj : objects) {
+        if (obj.kind != vicad::ScriptSceneObjectKind::Manifold) continue;
+        if (cancel_.load(std::memory_order_relaxed)) {
+            fail("Export cancelled.");
+            return;
+        }
+        if (obj.manifold.Status() != manifold::Manifold::Error::NoError) {
+            fail("Scene object " + obj.name + " failed: " + SceneManifoldErrorString(obj.manifold.Status()));
+            return;
+        }
+        // One object's mesh at a time: it is dropped as soon as it is written.
+        if (!writer.WriteObject(obj.name, obj.manifold.GetMeshGL(), &error)) {
+            fail(error);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        progress_.objects_done = ++done;
+    }
+    if (writer.object_count() == 0) {
+        fail("Mesh is empty; nothing to export.");
+        return;
+    }
+    if (!writer.Finish(&error)) {
+        fail(error);
+        return;
+    }
+    if (std::rename(part_path.c_str(), path.c_str()) != 0) {
+        fail("Failed to move the finished export to " + path + ".");
+        return;
+    }
+    finish(true, std::string());
+}
+
+}  // namespace vicad_scene
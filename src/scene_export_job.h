@@ -0,0 +1,68 @@
+#ifndef VICAD_SCENE_EXPORT_JOB_H_
+#define VICAD_SCENE_EXPORT_JOB_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "replay_cache.h"
+
+namespace vicad_scene {
+
+enum class SceneExportPhase : uint32_t {
+    Replaying = 0,
+    Writing = 1,
+    Finished = 2,
+};
+
+struct SceneExportProgress {
+    SceneExportPhase phase = SceneExportPhase::Replaying;
+    uint32_t objects_done = 0;
+    uint32_t objects_total = 0;
+    bool ok = false;
+    bool cancelled = false;
+    std::string path;
+    std::string error;
+};
+
+// Replays a retained scene response at Export3MF on its own thread and
+// streams each manifold object into a 3MF file. Only the object being written
+// is meshed at a time. The file is written under a ".part" name and renamed
+// once complete, so a cancelled or failed export leaves nothing behind.
+// Cancellation takes effect between objects.
+class SceneExportJob {
+  public:
+    SceneExportJob(std::shared_ptr<const std::vector<uint8_t>> response,
+                   std::shared_ptr<vicad::ReplayCache> cache,
+                   std::string out_path,
+                   std::function<void()> on_done);
+    ~SceneExportJob();
+
+    SceneExportJob(const SceneExportJob &) = delete;
+    SceneExportJob &operator=(const SceneExportJob &) = delete;
+
+    void Cancel();
+    void Wait();
+    SceneExportProgress Progress() const;
+
+  private:
+    void Run();
+    void finish(bool ok, std::string error);
+
+    std::shared_ptr<const std::vector<uint8_t>> response_;
+    std::shared_ptr<vicad::ReplayCache> cache_;
+    std::function<void()> on_done_;
+    std::atomic<bool> cancel_{false};
+    mutable std::mutex mutex_;
+    SceneExportProgress progress_;
+    std::thread thread_;
+};
+
+}  // namespace vicad_scene
+
+#endif  // VICAD_SCENE_EXPORT_JOB_H_
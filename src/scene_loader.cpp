@@ -0,0 +1,220 @@
+#include "scene_loader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "log.h"
+#include "scene_object.h"
+#include "scene_session.h"
+#include "trace.h"
+
+namespace vicad_scene {
+
+void SceneLoadRunScript(vicad::ScriptWorkerClient *client,
+                        const std::string &script_path,
+                        const vicad::ReplayLodPolicy &run_policy,
+                        bool retain_response,
+                        SceneLoadResult *out) {
+    client->set_retain_scene_response(retain_response);
+    out->script_path = script_path;
+    out->run_policy = run_policy;
+    out->ok = client->ExecuteScriptScene(script_path.c_str(), &out->scene_objects, &out->error, run_policy) &&
+              SceneLoadCheckBounds(out->scene_objects, &out->bounds_min, &out->bounds_max, &out->error);
+    if (!out->ok && !client->started()) out->ipc_start_failed = true;
+    if (out->ok) {
+        out->response = client->last_scene_response();
+        out->imports = client->last_imports();
+        out->stats.run = client->last_run_stats();
+    }
+}
+
+bool SceneLoadCheckBounds(const std::vector<vicad::ScriptSceneObject> &scene,
+                          vicad_app::Vec3 *bmin,
+                          vicad_app::Vec3 *bmax,
+                          std::string *err) {
+    if (!SceneSessionComputeSceneBounds(scene, bmin, bmax)) {
+        *err = "Scene has no manifold or sketch geometry to visualize.";
+        return false;
+    }
+    return true;
+}
+
+void SceneLoadBuildMeshes(const std::vector<vicad::ScriptSceneObject> &objects) {
+    vicad::ResolveSceneSketchDims(objects);
+    for (const vicad::ScriptSceneObject &obj : objects) {
+        if (obj.kind != vicad::ScriptSceneObjectKind::Manifold) continue;
+        if (obj.instance) {
+            (void)vicad::SceneInstanceDerived(*obj.instance);
+        } else {
+            (void)vicad::SceneObjectDerived(obj);
+        }
+    }
+}
+
+void SceneLoadStoreInDiskCache(const vicad::MeshDiskCacheKey &key,
+                               const vicad::ReplayLodPolicy &lod_policy,
+                               const std::vector<vicad::ScriptSceneObject> &objects) {
+    std::string cache_err;
+    if (key.content_hash != 0 &&
+        !vicad::MeshDiskCacheStore(key, vicad::LodKeyForPolicy(lod_policy), objects, &cache_err)) {
+        vicad::log_event("MESH_CACHE_ERROR", 0, cache_err.c_str());
+    }
+}
+
+SceneLoader::SceneLoader(std::function<void()> on_ready, size_t workers) : on_ready_(std::move(on_ready)) {
+    if (workers == 0) workers = 1;
+    for (size_t i = 0; i < workers; ++i) {
+        slots_.push_back(std::make_unique<Slot>());
+        slots_.back()->index = i;
+        slots_.back()->client.set_cancel_flag(&slots_.back()->cancel);
+    }
+    // Start the threads only after all slots are fully constructed.
+    for (const std::unique_ptr<Slot> &slot : slots_) {
+        slot->thread = std::thread(&SceneLoader::RunLoop, this, slot.get());
+    }
+}
+
+SceneLoader::~SceneLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+        for (const std::unique_ptr<Slot> &slot : slots_) slot->cancel.store(true, std::memory_order_relaxed);
+    }
+    wake_.notify_all();
+    for (const std::unique_ptr<Slot> &slot : slots_) {
+        if (slot->thread.joinable()) slot->thread.join();
+    }
+}
+
+void SceneLoader::Submit(uint64_t generation,
+                         std::string script_path,
+                         const vicad::ReplayLodPolicy &run_policy,
+                         bool retain_response,
+                         bool disk_cache) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto same_script = [&](const auto &item) { return item.script_path == script_path; };
+        queue_.erase(std::remove_if(queue_.begin(), queue_.end(), same_script), queue_.end());
+        results_.erase(std::remove_if(results_.begin(), results_.end(), same_script), results_.end());
+        for (const std::unique_ptr<Slot> &slot : slots_) {
+            if (slot->running_path == script_path) slot->cancel.store(true, std::memory_order_relaxed);
+        }
+        Job job;
+        job.generation = generation;
+        job.script_path = std::move(script_path);
+        job.run_policy = run_policy;
+        job.retain = retain_response;
+        job.disk_cache = disk_cache;
+        queue_.push_back(std::move(job));
+    }
+    wake_.notify_all();
+}
+
+bool SceneLoader::TakeResult(SceneLoadResult *out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (results_.empty()) return false;
+    *out = std::move(results_.front());
+    results_.erase(results_.begin());
+    return true;
+}
+
+bool SceneLoader::Busy(const std::string &script_path) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return running(script_path) || std::any_of(queue_.begin(), queue_.end(), [&](const Job &job) {
+               return job.script_path == script_path;
+           });
+}
+
+void SceneLoader::Prestart() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        prestart_ = true;
+    }
+    wake_.notify_all();
+}
+
+// Called with mutex_ held.
+bool SceneLoader::running(const std::string &script_path) const {
+    return std::any_of(slots_.begin(), slots_.end(), [&](const std::unique_ptr<Slot> &slot) {
+        return slot->running_path == script_path;
+    });
+}
+
+// Called with mutex_ held. Workers before `slot` are all running a script (a
+// prestarting one counts as idle, so the next job waits for it).
+bool SceneLoader::first_idle(const Slot *slot) const {
+    for (size_t i = 0; i < slot->index; ++i) {
+        if (slots_[i]->running_path.empty()) return false;
+    }
+    return true;
+}
+
+void SceneLoader::RunLoop(Slot *slot) {
+    vicad::trace_thread_name("loader " + std::to_string(slot->index));
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            // A script runs on one worker at a time, so its newer job waits
+            // for the cancelled run to return.
+            std::vector<Job>::iterator next;
+            wake_.wait(lock, [&] {
+                if (stop_ || (prestart_ && slot->index == 0)) return true;
+                if (!first_idle(slot)) return false;
+                next = std::find_if(queue_.begin(), queue_.end(),
+                                    [&](const Job &j) { return !running(j.script_path); });
+                return next != queue_.end();
+            });
+            if (stop_) return;
+            if (prestart_) {
+                prestart_ = false;
+                lock.unlock();
+                std::string start_err;
+                if (!slot->client.Prestart(&start_err)) {
+                    vicad::log_event("WORKER_PRESTART_FAILED", 0, start_err.c_str());
+                }
+                continue;
+            }
+            job = std::move(*next);
+            queue_.erase(next);
+            slot->running_path = job.script_path;
+            slot->cancel.store(false, std::memory_order_relaxed);
+        }
+        // The next worker is first in line for the remaining jobs now.
+        wake_.notify_all();
+
+        SceneLoadResult result;
+        result.generation = job.generation;
+        if (job.disk_cache) (void)vicad::MeshDiskCacheKeyForScript(job.script_path, &result.disk_cache_key);
+        SceneLoadRunScript(&slot->client, job.script_path, job.run_policy, job.retain, &result);
+        if (result.ok && !slot->cancel.load(std::memory_order_relaxed)) {
+            const auto mesh_started = std::chrono::steady_clock::now();
+            SceneLoadBuildMeshes(result.scene_objects);
+            result.stats.mesh_ms =
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - mesh_started).count();
+            // A retained Draft run is a progressive preview, and the refine
+            // that follows stores the final-quality scene instead.
+            if (!job.retain || job.run_policy.profile != vicad::LodProfile::Draft) {
+                SceneLoadStoreInDiskCache(result.disk_cache_key, job.run_policy, result.scene_objects);
+            }
+        }
+
+        bool published = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            slot->running_path.clear();
+            if (stop_) return;
+            // A newer submission of the same script makes this result stale.
+            published = std::none_of(queue_.begin(), queue_.end(), [&](const Job &j) {
+                return j.script_path == job.script_path;
+            });
+            if (published) results_.push_back(std::move(result));
+        }
+        // The script's next job, if any, can run now.
+        wake_.notify_all();
+        if (published && on_ready_) on_ready_();
+    }
+}
+
+}  // namespace vicad_scene
@@ -0,0 +1,133 @@
+#ifndef VICAD_SCENE_LOADER_H_
+#define VICAD_SCENE_LOADER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "app_state.h"
+#include "lod_policy.h"
+#include "mesh_disk_cache.h"
+#include "script_worker_client.h"
+
+namespace vicad_scene {
+
+// Where the time of the run behind a scene went: the worker phases and replay
+// (see ScriptRunStats), then meshing its objects on the loader thread.
+struct SceneRunStats {
+    vicad::ScriptRunStats run;
+    double mesh_ms = 0.0;
+};
+
+struct SceneLoadResult {
+    uint64_t generation = 0;
+    std::string script_path;
+    vicad::ReplayLodPolicy run_policy = {};
+    vicad::MeshDiskCacheKey disk_cache_key;
+    bool ok = false;
+    bool ipc_start_failed = false;
+    std::string error;
+    std::vector<vicad::ScriptSceneObject> scene_objects;
+    // Retained response, when the run was asked to keep it.
+    std::shared_ptr<const std::vector<uint8_t>> response;
+    std::vector<std::string> imports;
+    SceneRunStats stats;
+    vicad_app::Vec3 bounds_min = {0.0f, 0.0f, 0.0f};
+    vicad_app::Vec3 bounds_max = {0.0f, 0.0f, 0.0f};
+};
+
+// Pool of background threads that each own a worker client, and so a worker
+// process and shared memory segment of their own, and run scripts on it: the
+// run, its replay and the per-object meshes all happen there, and the render
+// loop only swaps in finished scenes. Runs of different scripts proceed in
+// parallel, one per worker; a job goes to the first idle worker, so single
+// runs keep landing on the warm one. A submission for a script already queued
+// or in flight replaces that job (cancelling the run), and only the newest
+// submission's result per script is kept.
+class SceneLoader {
+  public:
+    SceneLoader(std::function<void()> on_ready, size_t workers);
+    ~SceneLoader();
+
+    SceneLoader(const SceneLoader &) = delete;
+    SceneLoader &operator=(const SceneLoader &) = delete;
+
+    // `retain_response` keeps the run's response (for a later refine);
+    // `disk_cache` looks up the script's mesh cache key, and stores the scene
+    // under it unless it is a retained Draft preview that a refine will
+    // replace.
+    void Submit(uint64_t generation, std::string script_path, const vicad::ReplayLodPolicy &run_policy,
+                bool retain_response, bool disk_cache);
+    // Takes a finished result, of any script.
+    bool TakeResult(SceneLoadResult *out);
+    // A run of `script_path` is queued or in flight.
+    bool Busy(const std::string &script_path) const;
+    // Has the first worker start its worker process ahead of the first run.
+    void Prestart();
+
+  private:
+    struct Job {
+        uint64_t generation = 0;
+        std::string script_path;
+        vicad::ReplayLodPolicy run_policy = {};
+        bool retain = false;
+        bool disk_cache = false;
+    };
+    struct Slot {
+        size_t index = 0;
+        std::atomic<bool> cancel{false};
+        std::string running_path;  // guarded by mutex_; empty while idle
+        // Touched by the slot's thread only, after construction.
+        vicad::ScriptWorkerClient client;
+        std::thread thread;
+    };
+
+    void RunLoop(Slot *slot);
+    bool running(const std::string &script_path) const;
+    bool first_idle(const Slot *slot) const;
+
+    std::function<void()> on_ready_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    bool prestart_ = false;
+    std::vector<Job> queue_;
+    std::vector<SceneLoadResult> results_;
+    std::vector<std::unique_ptr<Slot>> slots_;
+};
+
+// Steps from a script to a scene ready to install, shared by the loader and
+// the refiner.
+//
+// Runs `script_path` on `client` at `run_policy` and checks the scene has
+// something to show; `retain_response` keeps the response for a refine.
+void SceneLoadRunScript(vicad::ScriptWorkerClient *client,
+                        const std::string &script_path,
+                        const vicad::ReplayLodPolicy &run_policy,
+                        bool retain_response,
+                        SceneLoadResult *out);
+// Bounds of `scene`; false with `err` set when it has no geometry to show.
+bool SceneLoadCheckBounds(const std::vector<vicad::ScriptSceneObject> &scene,
+                          vicad_app::Vec3 *bmin,
+                          vicad_app::Vec3 *bmax,
+                          std::string *err);
+// Builds per-object meshes and their derived data, and the sketch dimensions,
+// ahead of the install so the swap and the first upload do not stall a frame.
+// A sketch-only scene does no mesh work at all.
+void SceneLoadBuildMeshes(const std::vector<vicad::ScriptSceneObject> &objects);
+// Stores a final-quality scene in the disk cache under `key` (when it has
+// one), logging failures.
+void SceneLoadStoreInDiskCache(const vicad::MeshDiskCacheKey &key,
+                               const vicad::ReplayLodPolicy &lod_policy,
+                               const std::vector<vicad::ScriptSceneObject> &objects);
+
+}  // namespace vicad_scene
+
+#endif  // VICAD_SCENE_LOADER_H_
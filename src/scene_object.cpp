@@ -0,0 +1,441 @@
+#include "scene_object.h"
+
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include <unordered_map>
+#include <utility>
+
+#include "op_decoder.h"
+#include "trace.h"
+
+namespace vicad {
+
+namespace {
+
+// Row-major affine map; column 3 is the translation.
+struct Affine {
+  double m[3][4];
+};
+
+Affine affine_identity() {
+  return {{{1.0, 0.0, 0.0, 0.0}, {0.0, 1.0, 0.0, 0.0}, {0.0, 0.0, 1.0, 0.0}}};
+}
+
+// a after b.
+Affine affine_mul(const Affine &a, const Affine &b) {
+  Affine r = {};
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      double v = j == 3 ? a.m[i][3] : 0.0;
+      for (int k = 0; k < 3; ++k) v += a.m[i][k] * b.m[k][j];
+      r.m[i][j] = v;
+    }
+  }
+  return r;
+}
+
+bool affine_inverse(const Affine &a, Affine *out) {
+  const double (*m)[4] = a.m;
+  const double c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+  const double c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+  const double c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+  const double det = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+  if (!std::isfinite(det) || std::fabs(det) < 1e-12) return false;
+  const double inv_det = 1.0 / det;
+  Affine r = {};
+  r.m[0][0] = c00 * inv_det;
+  r.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * inv_det;
+  r.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inv_det;
+  r.m[1][0] = c01 * inv_det;
+  r.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inv_det;
+  r.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * inv_det;
+  r.m[2][0] = c02 * inv_det;
+  r.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * inv_det;
+  r.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inv_det;
+  for (int i = 0; i < 3; ++i) {
+    r.m[i][3] = -(r.m[i][0] * m[0][3] + r.m[i][1] * m[1][3] + r.m[i][2] * m[2][3]);
+  }
+  *out = r;
+  return true;
+}
+
+manifold::mat3x4 affine_to_mat(const Affine &a) {
+  return manifold::mat3x4(manifold::vec3(a.m[0][0], a.m[1][0], a.m[2][0]),
+                          manifold::vec3(a.m[0][1], a.m[1][1], a.m[2][1]),
+                          manifold::vec3(a.m[0][2], a.m[1][2], a.m[2][2]),
+                          manifold::vec3(a.m[0][3], a.m[1][3], a.m[2][3]));
+}
+
+// Exact at multiples of 90 degrees, as manifold's Rotate is.
+double sind(double deg) {
+  if (!std::isfinite(deg)) return std::sin(deg);
+  if (deg < 0.0) return -sind(-deg);
+  int quo = 0;
+  const double rad = std::remquo(deg, 90.0, &quo) * (3.14159265358979323846 / 180.0);
+  switch (quo % 4) {
+    case 0: return std::sin(rad);
+    case 1: return std::cos(rad);
+    case 2: return -std::sin(rad);
+    default: return -std::cos(rad);
+  }
+}
+
+double cosd(double deg) { return sind(deg + 90.0); }
+
+// The map applied by a Translate, Rotate (about X, then Y, then Z) or Scale
+// node, matching the manifold call replay makes for it.
+Affine transform_node_affine(OpCode op, double x, double y, double z) {
+  Affine a = affine_identity();
+  if (op == OpCode::Translate) {
+    a.m[0][3] = x;
+    a.m[1][3] = y;
+    a.m[2][3] = z;
+  } else if (op == OpCode::Scale) {
+    a.m[0][0] = x;
+    a.m[1][1] = y;
+    a.m[2][2] = z;
+  } else {
+    const double cx = cosd(x), sx = sind(x);
+    const double cy = cosd(y), sy = sind(y);
+    const double cz = cosd(z), sz = sind(z);
+    const Affine rx = {{{1.0, 0.0, 0.0, 0.0}, {0.0, cx, -sx, 0.0}, {0.0, sx, cx, 0.0}}};
+    const Affine ry = {{{cy, 0.0, sy, 0.0}, {0.0, 1.0, 0.0, 0.0}, {-sy, 0.0, cy, 0.0}}};
+    const Affine rz = {{{cz, -sz, 0.0, 0.0}, {sz, cz, 0.0, 0.0}, {0.0, 0.0, 1.0, 0.0}}};
+    a = affine_mul(rz, affine_mul(ry, rx));
+  }
+  return a;
+}
+
+bool is_transform_node(const ReplayNodeSemantic &sem) {
+  const OpCode op = (OpCode)sem.opcode;
+  return sem.valid && (op == OpCode::Translate || op == OpCode::Rotate || op == OpCode::Scale) &&
+         sem.inputs.count == 1 && sem.params_f64.count == 3;
+}
+
+// Shape of a primitive node in its own frame. Extrusions and cones only have
+// known ends; revolves and everything else are left to fitting.
+bool face_source_shape(const ReplayTables &tables, const ReplayNodeSemantic &sem, FaceSource *out) {
+  const std::span<const double> f64 = ReplaySemanticF64(tables, sem);
+  switch ((OpCode)sem.opcode) {
+    case OpCode::Cube:
+      out->shape = FaceSourceShape::Box;
+      return true;
+    case OpCode::Sphere:
+      if (f64.size() < 1) return false;
+      out->shape = FaceSourceShape::Sphere;
+      out->radius = std::fabs(f64[0]);
+      return true;
+    case OpCode::Cylinder:
+      if (f64.size() < 3) return false;
+      out->shape = std::fabs(f64[1]) == std::fabs(f64[2]) ? FaceSourceShape::Cylinder : FaceSourceShape::PlanarEnds;
+      out->radius = std::fabs(f64[1]);
+      return true;
+    case OpCode::Extrude:
+      out->shape = FaceSourceShape::PlanarEnds;
+      return true;
+    default:
+      return false;
+  }
+}
+
+}  // namespace
+
+const manifold::MeshGL &SceneObjectMesh(const ScriptSceneObject &obj) {
+  if (!obj.meshCache) {
+    if (obj.kind == ScriptSceneObjectKind::Manifold) {
+      TraceSpan span("mesh", "GetMeshGL");
+      obj.meshCache = obj.manifold.GetMeshGL();
+    } else {
+      obj.meshCache.emplace();
+      obj.meshCache->numProp = 3;
+    }
+  }
+  return *obj.meshCache;
+}
+
+const manifold::MeshGL &SceneInstanceMesh(const SceneInstanceGeometry &geom) {
+  if (!geom.meshCache) {
+    TraceSpan span("mesh", "GetMeshGL");
+    geom.meshCache = geom.manifold.GetMeshGL();
+  }
+  return *geom.meshCache;
+}
+
+const MeshDerived &SceneObjectDerived(const ScriptSceneObject &obj) {
+  if (!obj.derivedCache) obj.derivedCache = BuildMeshDerived(SceneObjectMesh(obj));
+  return *obj.derivedCache;
+}
+
+const MeshDerived &SceneInstanceDerived(const SceneInstanceGeometry &geom) {
+  if (!geom.derivedCache) geom.derivedCache = BuildMeshDerived(SceneInstanceMesh(geom));
+  return *geom.derivedCache;
+}
+
+const manifold::MeshGL &SceneObjectPickMesh(const ScriptSceneObject &obj, SceneVec3 *origin, SceneVec3 *dir) {
+  if (!obj.instance) return SceneObjectMesh(obj);
+  const manifold::mat3x4 &m = obj.instanceInverse;
+  const SceneVec3 o = *origin;
+  const SceneVec3 d = *dir;
+  *origin = {(float)(m[0].x * o.x + m[1].x * o.y + m[2].x * o.z + m[3].x),
+             (float)(m[0].y * o.x + m[1].y * o.y + m[2].y * o.z + m[3].y),
+             (float)(m[0].z * o.x + m[1].z * o.y + m[2].z * o.z + m[3].z)};
+  *dir = {(float)(m[0].x * d.x + m[1].x * d.y + m[2].x * d.z),
+          (float)(m[0].y * d.x + m[1].y * d.y + m[2].y * d.z),
+          (float)(m[0].z * d.x + m[1].z * d.y + m[2].z * d.z)};
+  return SceneInstanceMesh(*obj.instance);
+}
+
+const MeshBvh &SceneObjectPickBvh(const ScriptSceneObject &obj) {
+  if (obj.instance) {
+    const SceneInstanceGeometry &geom = *obj.instance;
+    if (!geom.bvhCache) geom.bvhCache = BuildMeshBvh(SceneInstanceMesh(geom));
+    return *geom.bvhCache;
+  }
+  if (!obj.bvhCache) obj.bvhCache = BuildMeshBvh(SceneObjectMesh(obj));
+  return *obj.bvhCache;
+}
+
+void ResolveSceneInstances(std::vector<ScriptSceneObject> *objects) {
+  struct Candidate {
+    size_t index;
+    uint32_t base_id;
+    uint64_t digest;
+    Affine transform;
+  };
+  std::vector<Candidate> candidates;
+  std::unordered_map<uint64_t, size_t> group_size;
+  for (size_t i = 0; i < objects->size(); ++i) {
+    const ScriptSceneObject &obj = (*objects)[i];
+    if (obj.kind != ScriptSceneObjectKind::Manifold || !obj.tables) continue;
+    const ReplayTables &tables = *obj.tables;
+    uint32_t id = obj.rootId;
+    Affine transform = affine_identity();
+    while (ReplayNodeIs(tables, id, NodeKind::Manifold) && (size_t)id < tables.node_semantics.size() &&
+           is_transform_node(tables.node_semantics[id])) {
+      const ReplayNodeSemantic &sem = tables.node_semantics[id];
+      const std::span<const double> p = ReplaySemanticF64(tables, sem);
+      transform = affine_mul(transform, transform_node_affine((OpCode)sem.opcode, p[0], p[1], p[2]));
+      id = ReplaySemanticInputs(tables, sem)[0];
+    }
+    if (!ReplayNodeIs(tables, id, NodeKind::Manifold) || (size_t)id >= tables.manifold_nodes.size() ||
+        (size_t)id >= tables.node_digest.size() || tables.node_digest[id] == 0) {
+      continue;
+    }
+    candidates.push_back({i, id, tables.node_digest[id], transform});
+    group_size[tables.node_digest[id]]++;
+  }
+
+  std::unordered_map<uint64_t, std::shared_ptr<const SceneInstanceGeometry>> geometry;
+  for (const Candidate &c : candidates) {
+    if (group_size[c.digest] < 2) continue;
+    Affine inverse;
+    if (!affine_inverse(c.transform, &inverse)) continue;
+    ScriptSceneObject &obj = (*objects)[c.index];
+    std::shared_ptr<const SceneInstanceGeometry> &geom = geometry[c.digest];
+    if (!geom) {
+      auto shared = std::make_shared<SceneInstanceGeometry>();
+      shared->digest = c.digest;
+      shared->lodKey = obj.lodKey;
+      shared->manifold = obj.tables->manifold_nodes[c.base_id];
+      geom = std::move(shared);
+    }
+    obj.instance = geom;
+    obj.instanceTransform = affine_to_mat(c.transform);
+    obj.instanceInverse = affine_to_mat(inverse);
+  }
+}
+
+const SketchDimensionModel *SceneObjectSketchDims(const ScriptSceneObject &obj) {
+  if (!obj.sketchDimsResolved) {
+    obj.sketchDimsResolved = true;
+    SketchPlane plane;
+    SketchDimensionModel dims;
+    std::string dim_error;
+    if (obj.kind == ScriptSceneObjectKind::CrossSection && obj.tables &&
+        ResolveReplayCrossSectionPlane(*obj.tables, obj.rootKind, obj.rootId, &plane, &dim_error) &&
+        plane.kind == SketchPlaneKind::XY &&
+        BuildSketchDimensionModelForRoot(*obj.tables, obj.rootId, &dims, &dim_error)) {
+      obj.sketchDimsCache = std::move(dims);
+    }
+  }
+  return obj.sketchDimsCache ? &*obj.sketchDimsCache : nullptr;
+}
+
+void ResolveSceneSketchDims(const std::vector<ScriptSceneObject> &objects) {
+  std::vector<const ReplayTables *> seen;
+  std::vector<const ScriptSceneObject *> group;
+  std::vector<uint32_t> roots;
+  std::vector<std::optional<SketchDimensionModel>> models;
+  for (const ScriptSceneObject &first : objects) {
+    const ReplayTables *tables = first.tables.get();
+    if (first.kind != ScriptSceneObjectKind::CrossSection || first.sketchDimsResolved || !tables ||
+        std::find(seen.begin(), seen.end(), tables) != seen.end()) {
+      continue;
+    }
+    seen.push_back(tables);
+    group.clear();
+    roots.clear();
+    for (const ScriptSceneObject &obj : objects) {
+      if (obj.kind != ScriptSceneObjectKind::CrossSection || obj.sketchDimsResolved || obj.tables.get() != tables) {
+        continue;
+      }
+      obj.sketchDimsResolved = true;
+      SketchPlane plane;
+      std::string plane_error;
+      if (!ResolveReplayCrossSectionPlane(*tables, obj.rootKind, obj.rootId, &plane, &plane_error) ||
+          plane.kind != SketchPlaneKind::XY) {
+        continue;
+      }
+      group.push_back(&obj);
+      roots.push_back(obj.rootId);
+    }
+    BuildSketchDimensionModels(*tables, roots, &models);
+    for (size_t i = 0; i < group.size(); ++i) group[i]->sketchDimsCache = std::move(models[i]);
+  }
+}
+
+const SketchDimLayout &SceneObjectSketchLayout(const ScriptSceneObject &obj) {
+  if (!obj.sketchLayoutCache) {
+    obj.sketchLayoutCache = BuildSketchDimLayout(obj.sketchContours, SceneObjectSketchDims(obj));
+  }
+  return *obj.sketchLayoutCache;
+}
+
+void ResolveSceneOpTraces(const std::vector<ScriptSceneObject> &objects) {
+  std::vector<const ReplayTables *> seen;
+  std::vector<const ScriptSceneObject *> group;
+  std::vector<uint32_t> roots;
+  for (const ScriptSceneObject &first : objects) {
+    const ReplayTables *tables = first.tables.get();
+    if (first.opTrace || !tables || std::find(seen.begin(), seen.end(), tables) != seen.end()) continue;
+    seen.push_back(tables);
+    group.clear();
+    roots.clear();
+    for (const ScriptSceneObject &obj : objects) {
+      if (obj.opTrace || obj.tables.get() != tables) continue;
+      group.push_back(&obj);
+      roots.push_back(obj.rootId);
+    }
+    auto table = std::make_shared<OpTraceTable>();
+    BuildOperationTraceTable(*tables, roots, table.get());
+    for (size_t i = 0; i < group.size(); ++i) {
+      group[i]->opTrace = table;
+      group[i]->opTraceRoot = (uint32_t)i;
+    }
+  }
+}
+
+bool SceneObjectOpTrace(const ScriptSceneObject &obj, const OpTraceTable **table,
+                        std::span<const uint32_t> *trace, std::string *error) {
+  if (!obj.opTrace) {
+    if (!obj.tables) {
+      if (error) *error = "Scene object has no replay tables.";
+      return false;
+    }
+    auto own = std::make_shared<OpTraceTable>();
+    BuildOperationTraceTable(*obj.tables, std::span<const uint32_t>(&obj.rootId, 1), own.get());
+    obj.opTrace = std::move(own);
+    obj.opTraceRoot = 0;
+  }
+  const OpTraceSpan &span = obj.opTrace->roots[obj.opTraceRoot];
+  if (!span.valid) {
+    if (error) *error = "Replay failed: operation trace root missing.";
+    return false;
+  }
+  *table = obj.opTrace.get();
+  *trace = std::span<const uint32_t>(obj.opTrace->order).subspan(span.offset, span.count);
+  return true;
+}
+
+std::vector<FaceSource> SceneFaceSources(const std::vector<ScriptSceneObject> &objects) {
+  std::vector<FaceSource> sources;
+  std::vector<const ReplayTables *> seen;
+  for (const ScriptSceneObject &obj : objects) {
+    const ReplayTables *tables = obj.tables.get();
+    if (!tables || std::find(seen.begin(), seen.end(), tables) != seen.end()) continue;
+    seen.push_back(tables);
+    const size_t count = std::min(tables->node_semantics.size(), tables->manifold_nodes.size());
+    for (uint32_t id = 0; id < (uint32_t)count; ++id) {
+      const ReplayNodeSemantic &sem = tables->node_semantics[id];
+      FaceSource source;
+      if (!sem.valid || !ReplayNodeIs(*tables, id, NodeKind::Manifold) || !face_source_shape(*tables, sem, &source)) {
+        continue;
+      }
+      // Transforms keep the original ID, so this is the primitive's even when
+      // the node already carries its sketch plane.
+      const int original = (int)tables->manifold_nodes[id].OriginalID();
+      if (original < 0) continue;
+      source.originalId = (uint32_t)original;
+      sources.push_back(source);
+    }
+  }
+  return sources;
+}
+
+size_t CarryOverUnchangedObjects(std::vector<ScriptSceneObject> *prev, std::vector<ScriptSceneObject> *next,
+                                 bool *manifolds_changed) {
+  std::unordered_map<uint64_t, size_t> prev_index;
+  std::unordered_map<uint64_t, std::shared_ptr<const SceneInstanceGeometry>> prev_instances;
+  prev_index.reserve(prev->size());
+  size_t prev_manifolds = 0;
+  for (size_t i = 0; i < prev->size(); ++i) {
+    prev_index.emplace((*prev)[i].objectId, i);
+    if ((*prev)[i].kind == ScriptSceneObjectKind::Manifold) prev_manifolds++;
+    const std::shared_ptr<const SceneInstanceGeometry> &geom = (*prev)[i].instance;
+    if (geom) prev_instances.emplace(geom->digest ^ ((uint64_t)geom->lodKey << 32), geom);
+  }
+  size_t reused = 0;
+  size_t reused_manifolds = 0;
+  size_t next_manifolds = 0;
+  for (ScriptSceneObject &obj : *next) {
+    const bool is_manifold = obj.kind == ScriptSceneObjectKind::Manifold;
+    if (is_manifold) next_manifolds++;
+    // Shared geometry carries over by digest, keeping its mesh and GPU
+    // buffer even when the objects using it changed.
+    if (obj.instance) {
+      auto geom = prev_instances.find(obj.instance->digest ^ ((uint64_t)obj.instance->lodKey << 32));
+      if (geom != prev_instances.end() && geom->second->digest == obj.instance->digest &&
+          geom->second->lodKey == obj.instance->lodKey) {
+        obj.instance = geom->second;
+      }
+    }
+    auto it = prev_index.find(obj.objectId);
+    if (it == prev_index.end()) continue;
+    ScriptSceneObject &old = (*prev)[it->second];
+    prev_index.erase(it);
+    if (obj.rootDigest == 0 || old.rootDigest != obj.rootDigest || old.lodKey != obj.lodKey ||
+        old.kind != obj.kind) {
+      continue;
+    }
+    // The geometry carries over; names, replay tables, instancing and any
+    // sketch dimensions already resolved come from the new run, and the
+    // derived op trace is rebuilt against those tables on first use.
+    std::string name = std::move(obj.name);
+    std::shared_ptr<const ReplayTables> tables = std::move(obj.tables);
+    std::shared_ptr<const SceneInstanceGeometry> instance = std::move(obj.instance);
+    const manifold::mat3x4 instance_transform = obj.instanceTransform;
+    const manifold::mat3x4 instance_inverse = obj.instanceInverse;
+    const uint32_t root_kind = obj.rootKind;
+    const uint32_t root_id = obj.rootId;
+    const bool sketch_dims_resolved = obj.sketchDimsResolved;
+    std::optional<SketchDimensionModel> sketch_dims = std::move(obj.sketchDimsCache);
+    obj = std::move(old);
+    obj.name = std::move(name);
+    obj.tables = std::move(tables);
+    obj.instance = std::move(instance);
+    obj.instanceTransform = instance_transform;
+    obj.instanceInverse = instance_inverse;
+    obj.rootKind = root_kind;
+    obj.rootId = root_id;
+    obj.opTrace.reset();
+    obj.sketchDimsResolved = sketch_dims_resolved;
+    obj.sketchDimsCache = std::move(sketch_dims);
+    reused++;
+    if (is_manifold) reused_manifolds++;
+  }
+  *manifolds_changed = reused_manifolds != next_manifolds || reused_manifolds != prev_manifolds;
+  return reused;
+}
+
+}  // namespace vicad
@@ -0,0 +1,146 @@
+#ifndef VICAD_SCENE_OBJECT_H_
+#define VICAD_SCENE_OBJECT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "face_detection.h"
+#include "manifold/manifold.h"
+#include "mesh_bvh.h"
+#include "mesh_derived.h"
+#include "mesh_lod.h"
+#include "sketch_dimensions.h"
+#include "sketch_layout.h"
+
+namespace vicad {
+
+enum class ScriptSceneObjectKind : uint32_t {
+  Unknown = 0,
+  Manifold = 1,
+  CrossSection = 2,
+};
+
+struct SceneVec3 {
+  float x;
+  float y;
+  float z;
+};
+
+struct ScriptSketchContour {
+  std::vector<SceneVec3> points;
+};
+
+struct ReplayTables;
+
+// Geometry shared by scene objects that are the same node under different
+// trailing Translate/Rotate/Scale chains (a patterned part). It is meshed and
+// uploaded once and drawn per object with the object's instance transform.
+struct SceneInstanceGeometry {
+  uint64_t digest = 0;  // content digest of the shared node
+  uint32_t lodKey = 0;
+  manifold::Manifold manifold;
+  mutable std::optional<manifold::MeshGL> meshCache;
+  mutable std::optional<MeshDerived> derivedCache;
+  mutable std::optional<MeshBvh> bvhCache;
+  // Decimated render levels, attached once built in the background (see
+  // SceneSessionStartLodBuild); null until then.
+  mutable std::shared_ptr<const MeshLodChain> lodChain;
+};
+
+// Decoding resolves only what every object needs up front: the manifold or
+// sketch contours and the bounds. The mesh, op trace and sketch dimensions are
+// derived on first use through the SceneObject* accessors and cached here, so
+// objects that are never drawn, picked or inspected never pay for them.
+struct ScriptSceneObject {
+  uint64_t objectId = 0;
+  std::string name;
+  ScriptSceneObjectKind kind = ScriptSceneObjectKind::Unknown;
+  uint32_t rootKind = 0;
+  uint32_t rootId = 0;
+  // Digest of the root node plus the LOD key it was replayed at: together with
+  // objectId they identify unchanged objects across reloads. rootDigest 0 means
+  // the object cannot be matched.
+  uint64_t rootDigest = 0;
+  uint32_t lodKey = 0;
+  manifold::Manifold manifold;
+  std::vector<ScriptSketchContour> sketchContours;
+  SceneVec3 bmin = {0.0f, 0.0f, 0.0f};
+  SceneVec3 bmax = {0.0f, 0.0f, 0.0f};
+  // Replay tables of the run that produced the object, shared by the scene.
+  std::shared_ptr<const ReplayTables> tables;
+  // Set when the object shares its geometry with others in the scene: the
+  // object is `instance` mapped by instanceTransform. Drawing and picking go
+  // through the shared mesh; meshCache is only built when a caller needs the
+  // world-space mesh itself.
+  std::shared_ptr<const SceneInstanceGeometry> instance;
+  manifold::mat3x4 instanceTransform;
+  manifold::mat3x4 instanceInverse;
+  mutable std::optional<manifold::MeshGL> meshCache;
+  mutable std::optional<MeshDerived> derivedCache;
+  mutable std::optional<MeshBvh> bvhCache;
+  // Operation trace shared by the objects of one set of replay tables, and
+  // the object's root in it. See ResolveSceneOpTraces.
+  mutable std::shared_ptr<const OpTraceTable> opTrace;
+  mutable uint32_t opTraceRoot = 0;
+  mutable bool sketchDimsResolved = false;
+  mutable std::optional<SketchDimensionModel> sketchDimsCache;
+  mutable std::optional<SketchDimLayout> sketchLayoutCache;
+  // Decimated render levels of a non-instanced manifold (instances use the
+  // geometry's), and the level drawn last frame.
+  mutable std::shared_ptr<const MeshLodChain> lodChain;
+  mutable int lodShown = 0;
+};
+
+// Triangle mesh of a manifold object; empty (numProp 3) for sketches.
+const manifold::MeshGL &SceneObjectMesh(const ScriptSceneObject &obj);
+// Sketch dimension model of an XY-plane sketch, or null when it has none.
+const SketchDimensionModel *SceneObjectSketchDims(const ScriptSceneObject &obj);
+// Resolves the sketch dimensions of every sketch in `objects` that has not
+// resolved them yet, one memoized walk per set of replay tables.
+void ResolveSceneSketchDims(const std::vector<ScriptSceneObject> &objects);
+// Camera-independent dimension layout of a sketch, built on first use.
+const SketchDimLayout &SceneObjectSketchLayout(const ScriptSceneObject &obj);
+// Mesh of shared instance geometry, in the geometry's own frame.
+const manifold::MeshGL &SceneInstanceMesh(const SceneInstanceGeometry &geom);
+// Bounds and face normals of SceneObjectMesh / SceneInstanceMesh, built on
+// first use and read by every consumer of the mesh.
+const MeshDerived &SceneObjectDerived(const ScriptSceneObject &obj);
+const MeshDerived &SceneInstanceDerived(const SceneInstanceGeometry &geom);
+// Mesh to draw or ray-test for a manifold object: the shared instance mesh,
+// with `origin` and `dir` mapped into its frame (hit distances along the
+// mapped ray equal those along the world ray), else the world-space mesh.
+const manifold::MeshGL &SceneObjectPickMesh(const ScriptSceneObject &obj, SceneVec3 *origin, SceneVec3 *dir);
+// BVH over the mesh SceneObjectPickMesh returns, built on first use and
+// shared by every ray query against the object.
+const MeshBvh &SceneObjectPickBvh(const ScriptSceneObject &obj);
+// Groups the manifold objects of one decoded scene by the node under their
+// trailing transform chain and gives every group of two or more a shared
+// SceneInstanceGeometry.
+void ResolveSceneInstances(std::vector<ScriptSceneObject> *objects);
+// Builds one shared operation trace per set of replay tables behind
+// `objects` for every object that has none yet. Meant for when the operation
+// inspector opens, so reloads never pay for traces nobody looks at.
+void ResolveSceneOpTraces(const std::vector<ScriptSceneObject> &objects);
+// Operation trace of an object's root as indices into (*table)->entries,
+// inputs before their users. Objects ResolveSceneOpTraces has not reached get
+// a trace of their own.
+bool SceneObjectOpTrace(const ScriptSceneObject &obj, const OpTraceTable **table,
+                        std::span<const uint32_t> *trace, std::string *error);
+// Primitives of the replay tables behind `objects` that face detection can
+// type from provenance, one per manifold original ID.
+std::vector<FaceSource> SceneFaceSources(const std::vector<ScriptSceneObject> &objects);
+// Moves every object of `prev` whose objectId, root digest and LOD key match
+// one in `next` into its place, so it keeps its manifold and cached mesh.
+// Returns the number of objects carried over; `manifolds_changed` reports
+// whether the set of manifold geometry differs.
+size_t CarryOverUnchangedObjects(std::vector<ScriptSceneObject> *prev, std::vector<ScriptSceneObject> *next,
+                                 bool *manifolds_changed);
+
+}  // namespace vicad
+
+#endif  // VICAD_SCENE_OBJECT_H_
@@ -0,0 +1,86 @@
+#include "scene_refiner.h"
+
+#include <utility>
+
+#include "scene_decode.h"
+#include "scene_loader.h"
+#include "trace.h"
+
+namespace vicad_scene {
+
+SceneRefiner::SceneRefiner(std::function<void()> on_ready) : on_ready_(std::move(on_ready)) {
+    // Start the thread only after all members are fully constructed.
+    thread_ = std::thread(&SceneRefiner::RunLoop, this);
+}
+
+SceneRefiner::~SceneRefiner() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    if (thread_.joinable()) thread_.join();
+}
+
+void SceneRefiner::Submit(uint64_t generation,
+                          std::shared_ptr<const std::vector<uint8_t>> response,
+                          const vicad::ReplayLodPolicy &lod_policy,
+                          const vicad::MeshDiskCacheKey &disk_cache_key) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        has_job_ = true;
+        job_generation_ = generation;
+        job_response_ = std::move(response);
+        job_policy_ = lod_policy;
+        job_disk_key_ = disk_cache_key;
+        has_result_ = false;
+    }
+    wake_.notify_one();
+}
+
+bool SceneRefiner::TakeResult(SceneRefineResult *out) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!has_result_) return false;
+    *out = std::move(result_);
+    has_result_ = false;
+    return true;
+}
+
+void SceneRefiner::RunLoop() {
+    vicad::trace_thread_name("refiner");
+    for (;;) {
+        std::shared_ptr<const std::vector<uint8_t>> response;
+        vicad::ReplayLodPolicy lod_policy = {};
+        vicad::MeshDiskCacheKey disk_key;
+        SceneRefineResult result;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stop_ || has_job_; });
+            if (stop_) return;
+            has_job_ = false;
+            result.generation = job_generation_;
+            result.lod_policy = job_policy_;
+            response = std::move(job_response_);
+            lod_policy = job_policy_;
+            disk_key = std::move(job_disk_key_);
+        }
+
+        result.ok = vicad::ReplaySceneResponse(*response, lod_policy, &cache_, &result.scene_objects, &result.error) &&
+                    SceneLoadCheckBounds(result.scene_objects, &result.bounds_min, &result.bounds_max, &result.error);
+        if (result.ok) {
+            SceneLoadBuildMeshes(result.scene_objects);
+            SceneLoadStoreInDiskCache(disk_key, lod_policy, result.scene_objects);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // A newer submission makes this result stale.
+            if (has_job_) continue;
+            result_ = std::move(result);
+            has_result_ = true;
+        }
+        if (on_ready_) on_ready_();
+    }
+}
+
+}  // namespace vicad_scene
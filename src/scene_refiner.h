@@ -0,0 +1,67 @@
+#ifndef VICAD_SCENE_REFINER_H_
+#define VICAD_SCENE_REFINER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "app_state.h"
+#include "lod_policy.h"
+#include "mesh_disk_cache.h"
+#include "replay_cache.h"
+#include "script_worker_client.h"
+
+namespace vicad_scene {
+
+struct SceneRefineResult {
+    uint64_t generation = 0;
+    vicad::ReplayLodPolicy lod_policy = {};
+    bool ok = false;
+    std::string error;
+    std::vector<vicad::ScriptSceneObject> scene_objects;
+    vicad_app::Vec3 bounds_min = {0.0f, 0.0f, 0.0f};
+    vicad_app::Vec3 bounds_max = {0.0f, 0.0f, 0.0f};
+};
+
+// Background thread that replays retained scene responses at final quality.
+// Only the newest submission is kept: one superseded before it started is
+// dropped. The replay cache is touched by this thread only.
+class SceneRefiner {
+  public:
+    explicit SceneRefiner(std::function<void()> on_ready);
+    ~SceneRefiner();
+
+    SceneRefiner(const SceneRefiner &) = delete;
+    SceneRefiner &operator=(const SceneRefiner &) = delete;
+
+    // A non-empty `disk_cache_key` also stores the refined scene on disk.
+    void Submit(uint64_t generation, std::shared_ptr<const std::vector<uint8_t>> response,
+                const vicad::ReplayLodPolicy &lod_policy, const vicad::MeshDiskCacheKey &disk_cache_key);
+    bool TakeResult(SceneRefineResult *out);
+
+  private:
+    void RunLoop();
+
+    std::function<void()> on_ready_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    bool has_job_ = false;
+    uint64_t job_generation_ = 0;
+    std::shared_ptr<const std::vector<uint8_t>> job_response_;
+    vicad::ReplayLodPolicy job_policy_ = {};
+    vicad::MeshDiskCacheKey job_disk_key_;
+    bool has_result_ = false;
+    SceneRefineResult result_;
+    vicad::ReplayCache cache_;
+    std::thread thread_;
+};
+
+}  // namespace vicad_scene
+
+#endif  // VICAD_SCENE_REFINER_H_
@@ -1,105 +1,20 @@
 #include "scene_session.h"
 
-#include <sys/stat.h>
-
-#include <exception>
+#include <algorithm>
+#include <unordered_set>
 #include <utility>
 
-#include "manifold/meshIO.h"
+#include "file_watch.h"
+#include "scene_decode.h"
 
 namespace vicad_scene {
 
 namespace {
 
-struct FileStamp {
-    long long mtime_ns;
-    long long ctime_ns;
-    long long size_bytes;
-};
-
-bool read_file_stamp(const char *path, FileStamp *out) {
-    struct stat st;
-    if (!out || !path || stat(path, &st) != 0) return false;
-    FileStamp stamp = {};
-#if defined(__APPLE__)
-    stamp.mtime_ns = (long long)st.st_mtimespec.tv_sec * 1000000000LL + (long long)st.st_mtimespec.tv_nsec;
-    stamp.ctime_ns = (long long)st.st_ctimespec.tv_sec * 1000000000LL + (long long)st.st_ctimespec.tv_nsec;
-#else
-    stamp.mtime_ns = (long long)st.st_mtime * 1000000000LL;
-    stamp.ctime_ns = (long long)st.st_ctime * 1000000000LL;
-#endif
-    stamp.size_bytes = (long long)st.st_size;
-    *out = stamp;
-    return true;
-}
-
-bool compute_mesh_bounds(const manifold::MeshGL &mesh, vicad_app::Vec3 *bmin, vicad_app::Vec3 *bmax) {
-    if (!bmin || !bmax || mesh.numProp < 3 || mesh.NumVert() == 0) return false;
-    vicad_app::Vec3 mn = {
-        mesh.vertProperties[0],
-        mesh.vertProperties[1],
-        mesh.vertProperties[2],
-    };
-    vicad_app::Vec3 mx = mn;
-    for (size_t i = 1; i < mesh.NumVert(); ++i) {
-        const float x = mesh.vertProperties[i * mesh.numProp + 0];
-        const float y = mesh.vertProperties[i * mesh.numProp + 1];
-        const float z = mesh.vertProperties[i * mesh.numProp + 2];
-        if (x < mn.x) mn.x = x;
-        if (y < mn.y) mn.y = y;
-        if (z < mn.z) mn.z = z;
-        if (x > mx.x) mx.x = x;
-        if (y > mx.y) mx.y = y;
-        if (z > mx.z) mx.z = z;
-    }
-    *bmin = mn;
-    *bmax = mx;
-    return true;
-}
-
 bool scene_object_is_manifold(const vicad::ScriptSceneObject &obj) {
     return obj.kind == vicad::ScriptSceneObjectKind::Manifold;
 }
 
-const char *manifold_error_string(manifold::Manifold::Error error) {
-    switch (error) {
-        case manifold::Manifold::Error::NoError: return "No error";
-        case manifold::Manifold::Error::NonFiniteVertex: return "Non-finite vertex";
-        case manifold::Manifold::Error::NotManifold: return "Not manifold";
-        case manifold::Manifold::Error::VertexOutOfBounds: return "Vertex out of bounds";
-        case manifold::Manifold::Error::PropertiesWrongLength: return "Properties wrong length";
-        case manifold::Manifold::Error::MissingPositionProperties: return "Missing position properties";
-        case manifold::Manifold::Error::MergeVectorsDifferentLengths: return "Merge vectors different lengths";
-        case manifold::Manifold::Error::MergeIndexOutOfBounds: return "Merge index out of bounds";
-        case manifold::Manifold::Error::TransformWrongLength: return "Transform wrong length";
-        case manifold::Manifold::Error::RunIndexWrongLength: return "Run index wrong length";
-        case manifold::Manifold::Error::FaceIDWrongLength: return "Face id wrong length";
-        case manifold::Manifold::Error::InvalidConstruction: return "Invalid construction";
-        default: return "Unknown manifold error";
-    }
-}
-
-bool export_mesh_to_3mf_native(const char *out_path, const manifold::MeshGL &mesh, std::string *error) {
-    try {
-        if (!out_path || out_path[0] == '\0') {
-            if (error) *error = "Output path is empty.";
-            return false;
-        }
-        if (mesh.NumVert() == 0 || mesh.NumTri() == 0) {
-            if (error) *error = "Mesh is empty; nothing to export.";
-            return false;
-        }
-        manifold::ExportMesh(out_path, mesh, manifold::ExportOptions{});
-        return true;
-    } catch (const std::exception &e) {
-        if (error) *error = std::string("3MF export failed: ") + e.what();
-        return false;
-    } catch (...) {
-        if (error) *error = "3MF export failed with unknown exception.";
-        return false;
-    }
-}
-
 }  // namespace
 
 bool SceneSessionComputeSceneBounds(const std::vector<vicad::ScriptSceneObject> &scene,
@@ -126,6 +41,93 @@ bool SceneSessionComputeSceneBounds(const std::vector<vicad::ScriptSceneObject>
     return initialized;
 }
 
+namespace {
+
+// Manifolds of a scene's manifold objects, for SceneMergeManifolds.
+std::vector<manifold::Manifold> scene_manifolds(const std::vector<vicad::ScriptSceneObject> &scene) {
+    std::vector<manifold::Manifold> parts;
+    parts.reserve(scene.size());
+    for (const vicad::ScriptSceneObject &obj : scene) {
+        if (scene_object_is_manifold(obj)) parts.push_back(obj.manifold);
+    }
+    return parts;
+}
+
+void install_scene(SceneSessionState *state,
+                   std::vector<vicad::ScriptSceneObject> next_scene,
+                   const vicad_app::Vec3 &next_bmin,
+                   const vicad_app::Vec3 &next_bmax) {
+    bool manifolds_changed = true;
+    state->reused_objects = vicad::CarryOverUnchangedObjects(&state->scene_objects, &next_scene, &manifolds_changed);
+    state->scene_objects = std::move(next_scene);
+    state->topology_changed = manifolds_changed;
+    if (manifolds_changed) {
+        state->merged_mesh.reset();
+        // An analysis of the old geometry still in flight is stale.
+        state->analysis_generation++;
+    }
+    state->bounds_min = next_bmin;
+    state->bounds_max = next_bmax;
+    state->error_text.clear();
+}
+
+bool take_file_change(SceneSessionState *state) {
+    return vicad::TakeStampChange(state->script_path, state->script_imports, &state->last_mtime_ns,
+                                   &state->last_ctime_ns, &state->last_size_bytes, &state->last_imports_stamp);
+}
+
+// A progressive reload previews at Draft and refines to `lod_policy` later.
+bool progressive_run_policy(const SceneSessionState &state,
+                            const vicad::ReplayLodPolicy &lod_policy,
+                            vicad::ReplayLodPolicy *run_policy) {
+    const bool progressive = state.progressive_lod && lod_policy.profile != vicad::LodProfile::Draft;
+    *run_policy = lod_policy;
+    if (progressive) run_policy->profile = vicad::LodProfile::Draft;
+    return progressive;
+}
+
+// Makes a finished run the displayed scene; a progressive one (Draft with a
+// retained response) starts refining to `lod_policy`.
+bool install_loaded(SceneSessionState *state,
+                    SceneLoadResult *result,
+                    const vicad::ReplayLodPolicy &lod_policy,
+                    std::string *err) {
+    if (result->ipc_start_failed) state->ipc_start_failed = true;
+    if (!result->ok) {
+        if (state->ipc_start_failed && result->error.empty()) result->error = "IPC startup failed.";
+        state->error_text = result->error;
+        if (err) *err = result->error;
+        return false;
+    }
+    state->disk_cache_key = result->disk_cache_key;
+    // Stamps taken before the run stay valid for an unchanged import set, so
+    // an import edited while the script ran still reloads it. A new set is
+    // stamped now.
+    if (result->imports != state->script_imports) {
+        state->script_imports = std::move(result->imports);
+        state->last_imports_stamp = vicad::ImportsStamp(state->script_imports);
+    }
+    install_scene(state, std::move(result->scene_objects), result->bounds_min, result->bounds_max);
+    state->run_stats = result->stats;
+    state->scene_generation++;
+    state->scene_is_preview = false;
+    state->scene_response = std::move(result->response);
+    state->scene_lod = result->run_policy;
+    state->target_lod = result->run_policy;
+    vicad::ReplayLodPolicy run_policy = {};
+    if (progressive_run_policy(*state, lod_policy, &run_policy)) {
+        state->scene_is_preview = SceneSessionRefineAt(state, lod_policy);
+    }
+    return true;
+}
+
+SceneLoader &session_loader(SceneSessionState *state) {
+    if (!state->loader) state->loader = std::make_shared<SceneLoader>(state->on_load_ready, state->loader_workers);
+    return *state->loader;
+}
+
+}  // namespace
+
 bool SceneSessionReloadIfChanged(SceneSessionState *state,
                                  vicad::ScriptWorkerClient *worker_client,
                                  const vicad::ReplayLodPolicy &lod_policy,
@@ -135,89 +137,296 @@ bool SceneSessionReloadIfChanged(SceneSessionState *state,
         if (err) *err = "SceneSessionReloadIfChanged received invalid inputs.";
         return false;
     }
+    if (!take_file_change(state)) return true;
+
+    SceneLoadResult result;
+    if (state->disk_cache_enabled) (void)vicad::MeshDiskCacheKeyForScript(state->script_path, &result.disk_cache_key);
+    vicad::ReplayLodPolicy run_policy = {};
+    const bool progressive = progressive_run_policy(*state, lod_policy, &run_policy);
+    SceneLoadRunScript(worker_client, state->script_path, run_policy, progressive, &result);
+    if (result.ok) vicad::ResolveSceneSketchDims(result.scene_objects);
+    if (result.ok && !progressive) SceneLoadStoreInDiskCache(result.disk_cache_key, run_policy, result.scene_objects);
+    return install_loaded(state, &result, lod_policy, err);
+}
+
+bool SceneSessionStartReload(SceneSessionState *state, const vicad::ReplayLodPolicy &lod_policy) {
+    if (!state || !take_file_change(state)) return false;
+    vicad::ReplayLodPolicy run_policy = {};
+    const bool progressive = progressive_run_policy(*state, lod_policy, &run_policy);
+    (void)session_loader(state);
+    state->load_generation = ++state->load_clock;
+    state->load_lod = lod_policy;
+    state->loader->Submit(state->load_generation, state->script_path, run_policy, progressive,
+                          state->disk_cache_enabled);
+    return true;
+}
 
-    FileStamp stamp = {};
-    if (!read_file_stamp(state->script_path.c_str(), &stamp)) return true;
-    if (stamp.mtime_ns == state->last_mtime_ns &&
-        stamp.ctime_ns == state->last_ctime_ns &&
-        stamp.size_bytes == state->last_size_bytes) {
-        return true;
+bool SceneSessionTakeLoaded(SceneSessionState *state, std::string *err) {
+    if (err) err->clear();
+    if (!state || !state->loader) return false;
+    bool installed = false;
+    SceneLoadResult result;
+    while (state->loader->TakeResult(&result)) {
+        if (result.script_path != state->script_path) {
+            SceneTabCacheInstall(state, &result);
+        } else if (result.generation == state->load_generation) {
+            installed = install_loaded(state, &result, state->load_lod, err);
+        }
+    }
+    return installed;
+}
+
+bool SceneSessionLoading(const SceneSessionState &state) {
+    return state.loader && state.loader->Busy(state.script_path);
+}
+
+void SceneSessionPrestartWorker(SceneSessionState *state) {
+    if (state) session_loader(state).Prestart();
+}
+
+size_t SceneSessionReloadCachedTabs(SceneSessionState *state, const vicad::ReplayLodPolicy &lod_policy) {
+    if (!state) return 0;
+    size_t queued = 0;
+    for (SceneTabSnapshot &snap : state->tab_cache) {
+        if (!vicad::TakeStampChange(snap.script_path, snap.script_imports, &snap.mtime_ns, &snap.ctime_ns,
+                                     &snap.size_bytes, &snap.imports_stamp)) {
+            continue;
+        }
+        // Nobody looks at a background tab's preview, so it runs at the final
+        // policy directly; the response is kept for later View refines.
+        const bool retain = state->progressive_lod && lod_policy.profile != vicad::LodProfile::Draft;
+        snap.load_generation = ++state->load_clock;
+        snap.load_lod = lod_policy;
+        session_loader(state).Submit(snap.load_generation, snap.script_path, lod_policy, retain,
+                                     state->disk_cache_enabled);
+        queued++;
     }
-    state->last_mtime_ns = stamp.mtime_ns;
-    state->last_ctime_ns = stamp.ctime_ns;
-    state->last_size_bytes = stamp.size_bytes;
+    return queued;
+}
 
+bool SceneSessionShowCached(SceneSessionState *state, std::string *err) {
+    if (err) err->clear();
+    if (!state || !state->disk_cache_enabled) return false;
+    vicad::MeshDiskCacheKey key;
+    std::vector<vicad::ScriptSceneObject> cached;
+    vicad_app::Vec3 bmin = {0.0f, 0.0f, 0.0f};
+    vicad_app::Vec3 bmax = {0.0f, 0.0f, 0.0f};
     std::string local_err;
-    std::vector<vicad::ScriptSceneObject> next_scene;
-    bool loaded = worker_client->ExecuteScriptScene(state->script_path.c_str(), &next_scene, &local_err, lod_policy);
-
-    manifold::MeshGL next_mesh;
-    vicad_app::Vec3 next_bmin = {0.0f, 0.0f, 0.0f};
-    vicad_app::Vec3 next_bmax = {0.0f, 0.0f, 0.0f};
-
-    if (loaded) {
-        std::vector<manifold::Manifold> parts;
-        parts.reserve(next_scene.size());
-        for (const vicad::ScriptSceneObject &obj : next_scene) {
-            if (scene_object_is_manifold(obj)) parts.push_back(obj.manifold);
+    if (!vicad::MeshDiskCacheKeyForScript(state->script_path, &key) ||
+        !vicad::MeshDiskCacheLoad(key, &cached, &local_err) ||
+        !SceneLoadCheckBounds(cached, &bmin, &bmax, &local_err)) {
+        if (err) *err = local_err;
+        return false;
+    }
+    install_scene(state, std::move(cached), bmin, bmax);
+    state->run_stats = {};
+    // Whatever was displayed or refining belonged to another script.
+    state->scene_generation++;
+    state->scene_is_preview = true;
+    state->scene_response.reset();
+    return true;
+}
+
+bool SceneSessionTakeRefined(SceneSessionState *state, std::string *err) {
+    if (err) err->clear();
+    if (!state || !state->refiner) return false;
+    SceneRefineResult result;
+    if (!state->refiner->TakeResult(&result)) return false;
+    if (result.generation != state->scene_generation) return false;
+    state->scene_is_preview = false;
+    if (!result.ok) {
+        if (err) *err = result.error;
+        return false;
+    }
+    install_scene(state, std::move(result.scene_objects), result.bounds_min, result.bounds_max);
+    state->scene_lod = result.lod_policy;
+    return true;
+}
+
+bool SceneSessionRefineAt(SceneSessionState *state, const vicad::ReplayLodPolicy &lod_policy) {
+    if (!state || !state->scene_response) return false;
+    if (!state->refiner) state->refiner = std::make_shared<SceneRefiner>(state->on_refine_ready);
+    // A new generation makes any refine still in flight stale.
+    state->scene_generation++;
+    state->target_lod = lod_policy;
+    state->refiner->Submit(state->scene_generation, state->scene_response, lod_policy, state->disk_cache_key);
+    return true;
+}
+
+std::shared_ptr<const manifold::MeshGL> SceneSessionMergedMesh(SceneSessionState *state, std::string *err) {
+    if (err) err->clear();
+    if (!state) return nullptr;
+    if (!state->merged_mesh) {
+        manifold::MeshGL merged;
+        std::string local_err;
+        if (!SceneMergeManifolds(scene_manifolds(state->scene_objects), &merged, &local_err)) {
+            if (err) *err = local_err;
+            return nullptr;
         }
+        state->merged_mesh = std::make_shared<const manifold::MeshGL>(std::move(merged));
+    }
+    return state->merged_mesh;
+}
+
+void SceneSessionStartAnalysis(SceneSessionState *state, float face_angle_deg) {
+    if (!state) return;
+    state->analysis_generation++;
+    std::vector<manifold::Manifold> parts = scene_manifolds(state->scene_objects);
+    // A sketch-only scene has nothing to merge; picking gets the empty merged
+    // mesh on demand without a round trip through the analyzer.
+    if (parts.empty()) return;
+    if (!state->analyzer) state->analyzer = std::make_shared<SceneAnalyzer>(state->on_analysis_ready);
+    state->analyzer->Submit(state->analysis_generation, std::move(parts),
+                            vicad::SceneFaceSources(state->scene_objects), face_angle_deg);
+}
 
-        if (!parts.empty()) {
-            manifold::Manifold merged = manifold::Manifold::BatchBoolean(parts, manifold::OpType::Add);
-            if (merged.Status() != manifold::Manifold::Error::NoError) {
-                loaded = false;
-                local_err = std::string("Scene merge failed: ") + manifold_error_string(merged.Status());
+void SceneSessionStartLodBuild(SceneSessionState *state) {
+    if (!state) return;
+    std::vector<vicad::MeshLodJob> jobs;
+    std::unordered_set<const vicad::SceneInstanceGeometry *> instances;
+    for (const vicad::ScriptSceneObject &obj : state->scene_objects) {
+        if (!scene_object_is_manifold(obj)) continue;
+        vicad::MeshLodJob job;
+        if (obj.instance) {
+            const vicad::SceneInstanceGeometry &geom = *obj.instance;
+            if (geom.lodChain || !instances.insert(&geom).second) continue;
+            job.digest = geom.digest;
+            job.lod_key = geom.lodKey;
+            job.manifold = geom.manifold;
+        } else {
+            if (obj.lodChain || obj.rootDigest == 0) continue;
+            job.object_id = obj.objectId;
+            job.digest = obj.rootDigest;
+            job.lod_key = obj.lodKey;
+            job.manifold = obj.manifold;
+        }
+        if (job.manifold.NumTri() < vicad::kMeshLodMinTris) continue;
+        jobs.push_back(std::move(job));
+    }
+    // Jobs run from the back: largest first, so the heaviest meshes get
+    // their levels soonest.
+    std::sort(jobs.begin(), jobs.end(), [](const vicad::MeshLodJob &a, const vicad::MeshLodJob &b) {
+        return a.manifold.NumTri() < b.manifold.NumTri();
+    });
+    if (jobs.empty() && !state->lod_builder) return;
+    if (!state->lod_builder) state->lod_builder = std::make_shared<vicad::MeshLodBuilder>(state->on_lod_ready);
+    state->lod_builder->Submit(std::move(jobs));
+}
+
+bool SceneSessionTakeLods(SceneSessionState *state) {
+    if (!state || !state->lod_builder) return false;
+    std::vector<vicad::MeshLodResult> results;
+    if (!state->lod_builder->TakeResults(&results)) return false;
+    bool attached = false;
+    for (const vicad::MeshLodResult &result : results) {
+        for (const vicad::ScriptSceneObject &obj : state->scene_objects) {
+            if (!scene_object_is_manifold(obj)) continue;
+            if (obj.instance) {
+                const vicad::SceneInstanceGeometry &geom = *obj.instance;
+                if (result.object_id != 0 || geom.lodChain || geom.digest != result.digest ||
+                    geom.lodKey != result.lod_key) {
+                    continue;
+                }
+                geom.lodChain = result.chain;
             } else {
-                next_mesh = merged.GetMeshGL();
-                if (!compute_mesh_bounds(next_mesh, &next_bmin, &next_bmax)) {
-                    loaded = false;
-                    local_err = "Merged scene mesh has no valid bounds.";
+                if (obj.lodChain || obj.objectId != result.object_id || obj.rootDigest != result.digest ||
+                    obj.lodKey != result.lod_key) {
+                    continue;
                 }
+                obj.lodChain = result.chain;
+                obj.lodShown = 0;
             }
-        } else {
-            next_mesh.numProp = 3;
-            if (!SceneSessionComputeSceneBounds(next_scene, &next_bmin, &next_bmax)) {
-                loaded = false;
-                local_err = "Scene has no manifold or sketch geometry to visualize.";
-            }
+            attached = true;
         }
     }
+    return attached;
+}
 
-    if (!loaded && !worker_client->started()) {
-        state->ipc_start_failed = true;
+bool SceneSessionTakeAnalysis(SceneSessionState *state, SceneAnalysisResult *out, std::string *err) {
+    if (err) err->clear();
+    if (!state || !state->analyzer || !out) return false;
+    SceneAnalysisResult result;
+    if (!state->analyzer->TakeResult(&result)) return false;
+    if (result.generation != state->analysis_generation) return false;
+    if (!result.ok) {
+        if (err) *err = result.error;
+        return false;
     }
+    state->merged_mesh = std::make_shared<const manifold::MeshGL>(std::move(result.mesh));
+    *out = std::move(result);
+    return true;
+}
+
+bool SceneSessionAnalyzing(const SceneSessionState &state) {
+    return state.analyzer && state.analyzer->Busy();
+}
+
+namespace {
+
+// Runs the script with response retention on, for an export of a scene whose
+// response was not kept. The run's own (Draft) replay is discarded.
+bool fetch_scene_response(SceneSessionState *state,
+                          vicad::ScriptWorkerClient *worker_client,
+                          std::shared_ptr<const std::vector<uint8_t>> *out,
+                          std::string *err) {
+    worker_client->set_retain_scene_response(true);
+    std::vector<vicad::ScriptSceneObject> scene_objects;
+    vicad::ReplayLodPolicy lod_policy = {};
+    lod_policy.profile = vicad::LodProfile::Draft;
+    const bool ok = worker_client->ExecuteScriptScene(state->script_path.c_str(), &scene_objects, err, lod_policy);
+    *out = worker_client->last_scene_response();
+    worker_client->set_retain_scene_response(state->progressive_lod);
+    if (ok && !*out) *err = "Worker run did not retain its scene response.";
+    return ok && *out;
+}
 
-    if (loaded) {
-        state->scene_objects = std::move(next_scene);
-        state->merged_mesh = std::move(next_mesh);
-
-        bool have_mesh_bounds = compute_mesh_bounds(state->merged_mesh, &state->bounds_min, &state->bounds_max);
-        vicad_app::Vec3 scene_bmin = {0.0f, 0.0f, 0.0f};
-        vicad_app::Vec3 scene_bmax = {0.0f, 0.0f, 0.0f};
-        const bool have_scene_bounds = SceneSessionComputeSceneBounds(state->scene_objects, &scene_bmin, &scene_bmax);
-        if (!have_mesh_bounds && have_scene_bounds) {
-            state->bounds_min = scene_bmin;
-            state->bounds_max = scene_bmax;
-            have_mesh_bounds = true;
-        } else if (have_mesh_bounds && have_scene_bounds) {
-            if (scene_bmin.x < state->bounds_min.x) state->bounds_min.x = scene_bmin.x;
-            if (scene_bmin.y < state->bounds_min.y) state->bounds_min.y = scene_bmin.y;
-            if (scene_bmin.z < state->bounds_min.z) state->bounds_min.z = scene_bmin.z;
-            if (scene_bmax.x > state->bounds_max.x) state->bounds_max.x = scene_bmax.x;
-            if (scene_bmax.y > state->bounds_max.y) state->bounds_max.y = scene_bmax.y;
-            if (scene_bmax.z > state->bounds_max.z) state->bounds_max.z = scene_bmax.z;
-        } else if (!have_mesh_bounds) {
-            state->bounds_min = next_bmin;
-            state->bounds_max = next_bmax;
+bool start_export(SceneSessionState *state,
+                  std::shared_ptr<const std::vector<uint8_t>> response,
+                  const std::string &out_path,
+                  std::string *err) {
+    if (state->export_job) {
+        SceneExportProgress progress = state->export_job->Progress();
+        if (progress.phase != SceneExportPhase::Finished) {
+            if (err) *err = "An export is already running.";
+            return false;
         }
-        state->error_text.clear();
-        return true;
     }
+    if (!state->export_cache) state->export_cache = std::make_shared<vicad::ReplayCache>();
+    // Joins the finished job before its successor touches the export cache.
+    state->export_job.reset();
+    state->export_job = std::make_shared<SceneExportJob>(std::move(response), state->export_cache, out_path,
+                                                         state->on_export_done);
+    return true;
+}
 
-    if (state->ipc_start_failed && local_err.empty()) local_err = "IPC startup failed.";
-    state->error_text = local_err;
-    if (err) *err = local_err;
-    return false;
+}  // namespace
+
+bool SceneSessionStartExport3mf(SceneSessionState *state,
+                                vicad::ScriptWorkerClient *worker_client,
+                                const std::string &out_path,
+                                std::string *err) {
+    if (err) err->clear();
+    if (!state || !worker_client || out_path.empty()) {
+        if (err) *err = "SceneSessionStartExport3mf received invalid inputs.";
+        return false;
+    }
+    std::shared_ptr<const std::vector<uint8_t>> response = state->scene_response;
+    std::string local_err;
+    if (!response && !fetch_scene_response(state, worker_client, &response, &local_err)) {
+        if (err) *err = local_err;
+        return false;
+    }
+    return start_export(state, std::move(response), out_path, err);
+}
+
+bool SceneSessionExportProgress(const SceneSessionState &state, SceneExportProgress *out) {
+    if (!state.export_job || !out) return false;
+    *out = state.export_job->Progress();
+    return true;
+}
+
+void SceneSessionCancelExport(SceneSessionState *state) {
+    if (state && state->export_job) state->export_job->Cancel();
 }
 
 bool SceneSessionExport3mf(SceneSessionState *state,
@@ -230,33 +439,18 @@ bool SceneSessionExport3mf(SceneSessionState *state,
         return false;
     }
 
+    // Re-run the script so the export reflects the file as it is now.
+    std::shared_ptr<const std::vector<uint8_t>> response;
     std::string local_err;
-    std::vector<vicad::ScriptSceneObject> scene_objects;
-    vicad::ReplayLodPolicy lod_policy = {};
-    lod_policy.profile = vicad::LodProfile::Export3MF;
-    if (!worker_client->ExecuteScriptScene(state->script_path.c_str(), &scene_objects, &local_err, lod_policy)) {
+    if (!fetch_scene_response(state, worker_client, &response, &local_err) ||
+        !start_export(state, std::move(response), *out_path, &local_err)) {
         if (err) *err = local_err;
         return false;
     }
-
-    std::vector<manifold::Manifold> parts;
-    parts.reserve(scene_objects.size());
-    for (const vicad::ScriptSceneObject &obj : scene_objects) {
-        if (obj.kind == vicad::ScriptSceneObjectKind::Manifold) parts.push_back(obj.manifold);
-    }
-    if (parts.empty()) {
-        if (err) *err = "Script scene does not contain manifold geometry to export.";
-        return false;
-    }
-
-    manifold::Manifold merged = manifold::Manifold::BatchBoolean(parts, manifold::OpType::Add);
-    if (merged.Status() != manifold::Manifold::Error::NoError) {
-        if (err) *err = "Failed to merge scene objects for mesh export.";
-        return false;
-    }
-
-    manifold::MeshGL export_mesh = merged.GetMeshGL();
-    return export_mesh_to_3mf_native(out_path->c_str(), export_mesh, err);
+    state->export_job->Wait();
+    const SceneExportProgress progress = state->export_job->Progress();
+    if (!progress.ok && err) *err = progress.error;
+    return progress.ok;
 }
 
 }  // namespace vicad_scene
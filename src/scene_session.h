@@ -1,11 +1,22 @@
 #ifndef VICAD_SCENE_SESSION_H_
 #define VICAD_SCENE_SESSION_H_
 
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "app_state.h"
 #include "lod_policy.h"
+#include "mesh_disk_cache.h"
+#include "mesh_lod_builder.h"
+#include "replay_cache.h"
+#include "scene_analyzer.h"
+#include "scene_export_job.h"
+#include "scene_loader.h"
+#include "scene_refiner.h"
+#include "scene_tab_cache.h"
 #include "script_worker_client.h"
 
 namespace vicad_scene {
@@ -15,12 +26,87 @@ struct SceneSessionState {
     long long last_mtime_ns = -1;
     long long last_ctime_ns = -1;
     long long last_size_bytes = -1;
+    // Modules the script imported in its last successful run (see
+    // ScriptWorkerClient::last_imports), and a digest of their stamps when
+    // the script was last taken as changed. Editing any of them reloads the
+    // script, like editing the script itself.
+    std::vector<std::string> script_imports;
+    uint64_t last_imports_stamp = 0;
     std::string error_text;
-    manifold::MeshGL merged_mesh;
     std::vector<vicad::ScriptSceneObject> scene_objects;
+    // Union of the manifold objects, built on first use by SceneSessionMergedMesh
+    // and dropped whenever the scene changes. Rendering and picking go per object.
+    // Shared with callers, who keep the mesh they were handed alive.
+    std::shared_ptr<const manifold::MeshGL> merged_mesh;
+    // Outcome of the last scene install: objects carried over unchanged (same
+    // objectId, root digest and LOD), and whether any manifold geometry
+    // changed. When it did not, the merged mesh and any face/edge topology
+    // derived from it are still valid.
+    size_t reused_objects = 0;
+    bool topology_changed = true;
     vicad_app::Vec3 bounds_min = {0.0f, 0.0f, 0.0f};
     vicad_app::Vec3 bounds_max = {0.0f, 0.0f, 0.0f};
+    // Timings of the run that produced the displayed scene; zero for a scene
+    // shown from the disk cache.
+    SceneRunStats run_stats;
     bool ipc_start_failed = false;
+    // Asynchronous reload: SceneSessionStartReload hands the run to the loader
+    // pool and SceneSessionTakeLoaded installs the scene it produced.
+    // on_load_ready is called on a loader thread when one is waiting.
+    // load_generation is the newest load of the active script, and
+    // load_clock numbers every load, background tabs' included.
+    std::function<void()> on_load_ready;
+    std::shared_ptr<SceneLoader> loader;
+    size_t loader_workers = 1;
+    uint64_t load_generation = 0;
+    uint64_t load_clock = 0;
+    vicad::ReplayLodPolicy load_lod = {};
+    // Progressive reload: replay at Draft for an immediate preview, then replay
+    // the same records at the requested profile in the background and swap
+    // them in through SceneSessionTakeRefined. on_refine_ready is called on the
+    // refiner thread when a result is waiting.
+    bool progressive_lod = false;
+    std::function<void()> on_refine_ready;
+    uint64_t scene_generation = 0;
+    bool scene_is_preview = false;
+    std::shared_ptr<SceneRefiner> refiner;
+    // Retained response of the displayed scene, the policy it was replayed at,
+    // and the policy the newest refine (if any) is replaying it at.
+    std::shared_ptr<const std::vector<uint8_t>> scene_response;
+    vicad::ReplayLodPolicy scene_lod = {};
+    vicad::ReplayLodPolicy target_lod = {};
+    // Speculative selection analysis of the merged mesh, started by
+    // SceneSessionStartAnalysis once a scene with new geometry is installed.
+    // on_analysis_ready is called on the analyzer thread when one is waiting.
+    std::function<void()> on_analysis_ready;
+    std::shared_ptr<SceneAnalyzer> analyzer;
+    uint64_t analysis_generation = 0;
+    // Render levels of the displayed scene's manifolds, built in the
+    // background by SceneSessionStartLodBuild and attached to the objects by
+    // SceneSessionTakeLods. on_lod_ready is called on the builder thread
+    // whenever a chain is waiting.
+    std::function<void()> on_lod_ready;
+    std::shared_ptr<vicad::MeshLodBuilder> lod_builder;
+    // Background 3MF export. The export cache keeps Export3MF node results
+    // between exports, so re-exporting after a small edit only replays what
+    // changed. on_export_done is called on the export thread when it ends.
+    std::shared_ptr<SceneExportJob> export_job;
+    std::shared_ptr<vicad::ReplayCache> export_cache;
+    std::function<void()> on_export_done;
+    // On-disk mesh cache: final-quality scenes are stored keyed by the script's
+    // content hash, and SceneSessionShowCached displays one before the script
+    // has run. disk_cache_key is the key of the last reload.
+    bool disk_cache_enabled = false;
+    vicad::MeshDiskCacheKey disk_cache_key;
+    // Scenes of inactive tabs, least recently used evicted first once their
+    // estimated size exceeds tab_cache_budget_bytes (0 keeps none). The GPU
+    // buffers of their meshes are meant to be retained with them.
+    // tab_cache_generation changes whenever an entry is added, replaced or
+    // dropped, e.g. for callers watching their files.
+    std::vector<SceneTabSnapshot> tab_cache;
+    size_t tab_cache_budget_bytes = (size_t)512 << 20;
+    uint64_t tab_cache_clock = 0;
+    uint64_t tab_cache_generation = 0;
 };
 
 bool SceneSessionComputeSceneBounds(const std::vector<vicad::ScriptSceneObject> &scene,
@@ -32,6 +118,75 @@ bool SceneSessionReloadIfChanged(SceneSessionState *state,
                                  const vicad::ReplayLodPolicy &lod_policy,
                                  std::string *err);
 
+// Starts a background reload when the script changed on disk since the last
+// one; returns true when a run was queued. A run already in flight is
+// cancelled. Finish it with SceneSessionTakeLoaded.
+bool SceneSessionStartReload(SceneSessionState *state, const vicad::ReplayLodPolicy &lod_policy);
+
+// Installs the scene of the newest background reload once it has finished.
+// Returns true when the scene was replaced; a failed run keeps the displayed
+// scene and reports through `err` (and error_text). Finished runs of cached
+// tabs replace their snapshots; other results are dropped.
+bool SceneSessionTakeLoaded(SceneSessionState *state, std::string *err);
+// A background reload of the active script is queued or running.
+bool SceneSessionLoading(const SceneSessionState &state);
+// Starts a loader worker process now, before any script is loaded, so the
+// first reload does not wait on a cold start.
+void SceneSessionPrestartWorker(SceneSessionState *state);
+// Reruns the cached tabs whose script or imports changed on disk since their
+// scene was made, on loader workers beside the active script's, so tabs edited
+// in the background are up to date when switched to. Returns the number of
+// runs queued.
+size_t SceneSessionReloadCachedTabs(SceneSessionState *state, const vicad::ReplayLodPolicy &lod_policy);
+
+// Displays the on-disk cached scene of `script_path` as a preview, when one
+// matches the file's current content. The caller still reloads the script,
+// which replaces the preview (objects whose digest and LOD match are kept).
+bool SceneSessionShowCached(SceneSessionState *state, std::string *err);
+
+// Installs a finished background refine of the current scene. Returns true
+// when the scene was replaced; a failed refine keeps the preview and reports
+// through `err`.
+bool SceneSessionTakeRefined(SceneSessionState *state, std::string *err);
+
+// Replays the displayed scene's retained records again at `lod_policy` in the
+// background, without re-running the script (e.g. when the camera moved far
+// enough to change the View level). Returns false when no response is held.
+bool SceneSessionRefineAt(SceneSessionState *state, const vicad::ReplayLodPolicy &lod_policy);
+
+// Queues render-level builds for the displayed scene's manifolds that have
+// none yet and are large enough to benefit (see kMeshLodMinTris).
+void SceneSessionStartLodBuild(SceneSessionState *state);
+// Attaches every render-level chain built so far to the displayed objects it
+// belongs to. Returns true when any was attached.
+bool SceneSessionTakeLods(SceneSessionState *state);
+
+// Returns the merged scene mesh (for whole-scene face/edge topology), unioning
+// the objects on the first call after a reload. Null if the merge fails.
+std::shared_ptr<const manifold::MeshGL> SceneSessionMergedMesh(SceneSessionState *state, std::string *err);
+
+// Starts merging the displayed scene and analysing the merged mesh for face
+// and edge selection in the background, superseding any analysis in flight.
+void SceneSessionStartAnalysis(SceneSessionState *state, float face_angle_deg);
+// Takes the newest analysis once it has finished. On success the merged mesh
+// moves into merged_mesh and `out` holds the rest; a failed merge reports
+// through `err`. Results for a replaced scene are dropped.
+bool SceneSessionTakeAnalysis(SceneSessionState *state, SceneAnalysisResult *out, std::string *err);
+// An analysis is queued, running or waiting to be taken.
+bool SceneSessionAnalyzing(const SceneSessionState &state);
+
+// Starts a background export of the displayed scene to `out_path`, replaying
+// its retained response (or, when none is held, one fetched from a fresh
+// worker run). Fails when an export is already running.
+bool SceneSessionStartExport3mf(SceneSessionState *state,
+                                vicad::ScriptWorkerClient *worker_client,
+                                const std::string &out_path,
+                                std::string *err);
+// Progress of the current or last export; false when none was started.
+bool SceneSessionExportProgress(const SceneSessionState &state, SceneExportProgress *out);
+void SceneSessionCancelExport(SceneSessionState *state);
+
+// Synchronous export for one-shot tools: runs the export job and waits.
 bool SceneSessionExport3mf(SceneSessionState *state,
                            vicad::ScriptWorkerClient *worker_client,
                            std::string *out_path,
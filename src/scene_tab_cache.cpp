@@ -0,0 +1,238 @@
+#include "scene_tab_cache.h"
+
+#include <algorithm>
+#include <optional>
+#include <unordered_set>
+#include <utility>
+
+#include "file_watch.h"
+#include "log.h"
+#include "scene_session.h"
+
+namespace vicad_scene {
+
+namespace {
+
+// Per triangle, what the estimate charges for a manifold's halfedges, vertices
+// and face data, and for a GPU buffer (three corners of position and normal).
+constexpr size_t kManifoldBytesPerTri = 128;
+constexpr size_t kGpuBytesPerTri = 3 * 6 * sizeof(float);
+
+template <typename T>
+size_t vector_bytes(const std::vector<T> &v) {
+    return v.size() * sizeof(T);
+}
+
+size_t mesh_gl_bytes(const manifold::MeshGL &mesh) {
+    return vector_bytes(mesh.vertProperties) + vector_bytes(mesh.triVerts) + vector_bytes(mesh.mergeFromVert) +
+           vector_bytes(mesh.mergeToVert) + vector_bytes(mesh.runIndex) + vector_bytes(mesh.runOriginalID) +
+           vector_bytes(mesh.runTransform) + vector_bytes(mesh.faceID) + vector_bytes(mesh.halfedgeTangent);
+}
+
+size_t mesh_cache_bytes(const std::optional<manifold::MeshGL> &mesh,
+                        const std::optional<vicad::MeshDerived> &derived,
+                        const std::optional<vicad::MeshBvh> &bvh) {
+    size_t bytes = mesh ? mesh_gl_bytes(*mesh) : 0;
+    if (derived) bytes += (size_t)derived->triCount * (3 * sizeof(float) + kGpuBytesPerTri);
+    if (bvh) {
+        bytes += vector_bytes(bvh->nodes) + vector_bytes(bvh->tris);
+        for (const std::vector<float> &axis : bvh->corner) bytes += vector_bytes(axis);
+    }
+    return bytes;
+}
+
+size_t lod_chain_bytes(const std::shared_ptr<const vicad::MeshLodChain> &chain) {
+    size_t bytes = 0;
+    if (!chain) return bytes;
+    for (const vicad::MeshLodLevel &level : chain->levels) {
+        bytes += mesh_gl_bytes(level.mesh) + (size_t)level.derived.triCount * (3 * sizeof(float) + kGpuBytesPerTri);
+    }
+    return bytes;
+}
+
+size_t snapshot_bytes(const SceneTabSnapshot &snap) {
+    return SceneSessionSceneBytes(snap.scene_objects) + (snap.response ? snap.response->size() : 0) +
+           (snap.merged_mesh ? mesh_gl_bytes(*snap.merged_mesh) : 0);
+}
+
+// Moves the displayed scene into the tab cache, replacing any older entry of
+// the same script.
+void stash_active_scene(SceneSessionState *state) {
+    SceneSessionDropCached(state, state->script_path);
+    SceneTabSnapshot snap;
+    snap.script_path = state->script_path;
+    snap.mtime_ns = state->last_mtime_ns;
+    snap.ctime_ns = state->last_ctime_ns;
+    snap.size_bytes = state->last_size_bytes;
+    snap.script_imports = std::move(state->script_imports);
+    snap.imports_stamp = state->last_imports_stamp;
+    snap.error_text = std::move(state->error_text);
+    snap.scene_objects = std::move(state->scene_objects);
+    snap.merged_mesh = std::move(state->merged_mesh);
+    snap.bounds_min = state->bounds_min;
+    snap.bounds_max = state->bounds_max;
+    snap.is_preview = state->scene_is_preview;
+    snap.response = std::move(state->scene_response);
+    snap.lod = state->scene_lod;
+    snap.target_lod = state->target_lod;
+    snap.disk_cache_key = state->disk_cache_key;
+    snap.run_stats = state->run_stats;
+    snap.bytes = snapshot_bytes(snap);
+    snap.last_used = ++state->tab_cache_clock;
+    // A reload still running lands in the snapshot when it finishes.
+    if (SceneSessionLoading(*state)) {
+        snap.load_generation = state->load_generation;
+        snap.load_lod = state->load_lod;
+    }
+    state->tab_cache.push_back(std::move(snap));
+    state->tab_cache_generation++;
+    // Nothing is displayed until the next scene is restored or loaded; work
+    // still in flight on the stashed one is stale.
+    state->scene_objects.clear();
+    state->merged_mesh.reset();
+    state->scene_response.reset();
+    state->error_text.clear();
+    state->run_stats = {};
+    state->reused_objects = 0;
+    state->topology_changed = true;
+    state->scene_is_preview = false;
+    state->scene_generation++;
+    state->analysis_generation++;
+}
+
+void evict_tab_cache(SceneSessionState *state) {
+    size_t total = 0;
+    for (const SceneTabSnapshot &snap : state->tab_cache) total += snap.bytes;
+    while (!state->tab_cache.empty() && total > state->tab_cache_budget_bytes) {
+        auto oldest = std::min_element(state->tab_cache.begin(), state->tab_cache.end(),
+                                       [](const SceneTabSnapshot &a, const SceneTabSnapshot &b) {
+                                           return a.last_used < b.last_used;
+                                       });
+        total -= oldest->bytes;
+        vicad::log_event("TAB_CACHE_EVICT", 0, oldest->script_path.c_str());
+        state->tab_cache.erase(oldest);
+        state->tab_cache_generation++;
+    }
+}
+
+}  // namespace
+
+void SceneTabCacheInstall(SceneSessionState *state, SceneLoadResult *result) {
+    auto it = std::find_if(state->tab_cache.begin(), state->tab_cache.end(),
+                           [&](const SceneTabSnapshot &snap) { return snap.script_path == result->script_path; });
+    if (it == state->tab_cache.end() || it->load_generation != result->generation) return;
+    SceneTabSnapshot &snap = *it;
+    snap.load_generation = 0;
+    if (result->ipc_start_failed) state->ipc_start_failed = true;
+    if (!result->ok) {
+        snap.error_text = result->error;
+        return;
+    }
+    // As for the active scene, only a new import set is stamped now.
+    if (result->imports != snap.script_imports) {
+        snap.script_imports = std::move(result->imports);
+        snap.imports_stamp = vicad::ImportsStamp(snap.script_imports);
+    }
+    bool manifolds_changed = true;
+    (void)vicad::CarryOverUnchangedObjects(&snap.scene_objects, &result->scene_objects, &manifolds_changed);
+    snap.scene_objects = std::move(result->scene_objects);
+    if (manifolds_changed) snap.merged_mesh.reset();
+    snap.bounds_min = result->bounds_min;
+    snap.bounds_max = result->bounds_max;
+    snap.error_text.clear();
+    snap.disk_cache_key = result->disk_cache_key;
+    snap.run_stats = result->stats;
+    snap.response = std::move(result->response);
+    snap.lod = result->run_policy;
+    snap.target_lod = snap.load_lod;
+    snap.is_preview = snap.response && snap.lod.profile != snap.load_lod.profile;
+    snap.bytes = snapshot_bytes(snap);
+    state->tab_cache_generation++;
+    evict_tab_cache(state);
+}
+
+size_t SceneSessionSceneBytes(const std::vector<vicad::ScriptSceneObject> &scene) {
+    size_t bytes = 0;
+    std::unordered_set<const vicad::SceneInstanceGeometry *> instances;
+    for (const vicad::ScriptSceneObject &obj : scene) {
+        bytes += sizeof(obj) + obj.name.size();
+        for (const vicad::ScriptSketchContour &contour : obj.sketchContours) bytes += vector_bytes(contour.points);
+        bytes += mesh_cache_bytes(obj.meshCache, obj.derivedCache, obj.bvhCache);
+        if (obj.kind != vicad::ScriptSceneObjectKind::Manifold) continue;
+        if (!obj.instance) {
+            bytes += obj.manifold.NumTri() * kManifoldBytesPerTri;
+        } else if (instances.insert(obj.instance.get()).second) {
+            const vicad::SceneInstanceGeometry &geom = *obj.instance;
+            bytes += geom.manifold.NumTri() * kManifoldBytesPerTri;
+            bytes += mesh_cache_bytes(geom.meshCache, geom.derivedCache, geom.bvhCache);
+            bytes += lod_chain_bytes(geom.lodChain);
+        }
+        bytes += lod_chain_bytes(obj.lodChain);
+    }
+    return bytes;
+}
+
+bool SceneSessionSwitchScript(SceneSessionState *state, const std::string &script_path) {
+    if (!state) return false;
+    // A scene that never loaded (stamps unset) is not worth keeping.
+    if (script_path != state->script_path && state->last_mtime_ns != -1) {
+        stash_active_scene(state);
+    } else {
+        SceneSessionDropCached(state, state->script_path);
+    }
+    state->script_path = script_path;
+    state->last_mtime_ns = -1;
+    state->last_ctime_ns = -1;
+    state->last_size_bytes = -1;
+    state->script_imports.clear();
+    state->last_imports_stamp = 0;
+    auto it = std::find_if(state->tab_cache.begin(), state->tab_cache.end(),
+                           [&](const SceneTabSnapshot &snap) { return snap.script_path == script_path; });
+    if (it == state->tab_cache.end()) {
+        evict_tab_cache(state);
+        return false;
+    }
+    SceneTabSnapshot snap = std::move(*it);
+    state->tab_cache.erase(it);
+    state->tab_cache_generation++;
+    evict_tab_cache(state);
+    state->last_mtime_ns = snap.mtime_ns;
+    state->last_ctime_ns = snap.ctime_ns;
+    state->last_size_bytes = snap.size_bytes;
+    state->script_imports = std::move(snap.script_imports);
+    state->last_imports_stamp = snap.imports_stamp;
+    state->error_text = std::move(snap.error_text);
+    state->scene_objects = std::move(snap.scene_objects);
+    state->merged_mesh = std::move(snap.merged_mesh);
+    state->bounds_min = snap.bounds_min;
+    state->bounds_max = snap.bounds_max;
+    state->reused_objects = 0;
+    state->topology_changed = true;
+    state->disk_cache_key = snap.disk_cache_key;
+    state->run_stats = snap.run_stats;
+    // A load of the script still running is now the active one.
+    if (snap.load_generation != 0) {
+        state->load_generation = snap.load_generation;
+        state->load_lod = snap.load_lod;
+    }
+    state->analysis_generation++;
+    state->scene_generation++;
+    state->scene_response = std::move(snap.response);
+    state->scene_lod = snap.lod;
+    state->target_lod = snap.lod;
+    state->scene_is_preview = false;
+    // A refine interrupted by the switch starts over.
+    if (snap.is_preview) state->scene_is_preview = SceneSessionRefineAt(state, snap.target_lod);
+    return true;
+}
+
+void SceneSessionDropCached(SceneSessionState *state, const std::string &script_path) {
+    if (!state) return;
+    auto dropped = std::remove_if(state->tab_cache.begin(), state->tab_cache.end(),
+                                  [&](const SceneTabSnapshot &snap) { return snap.script_path == script_path; });
+    if (dropped == state->tab_cache.end()) return;
+    state->tab_cache.erase(dropped, state->tab_cache.end());
+    state->tab_cache_generation++;
+}
+
+}  // namespace vicad_scene
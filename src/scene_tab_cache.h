@@ -0,0 +1,70 @@
+#ifndef VICAD_SCENE_TAB_CACHE_H_
+#define VICAD_SCENE_TAB_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "app_state.h"
+#include "lod_policy.h"
+#include "mesh_disk_cache.h"
+#include "scene_loader.h"
+#include "script_worker_client.h"
+
+namespace vicad_scene {
+
+struct SceneSessionState;
+
+// Scene of a tab that is not the active one, kept by SceneSessionSwitchScript
+// so switching back to it shows it without running the script again. The
+// stamps are those of the newest run submitted for it: a script edited
+// meanwhile is rerun in the background (SceneSessionReloadCachedTabs) or once
+// it is active again.
+struct SceneTabSnapshot {
+    std::string script_path;
+    long long mtime_ns = -1;
+    long long ctime_ns = -1;
+    long long size_bytes = -1;
+    std::vector<std::string> script_imports;
+    uint64_t imports_stamp = 0;
+    std::string error_text;
+    std::vector<vicad::ScriptSceneObject> scene_objects;
+    std::shared_ptr<const manifold::MeshGL> merged_mesh;
+    vicad_app::Vec3 bounds_min = {0.0f, 0.0f, 0.0f};
+    vicad_app::Vec3 bounds_max = {0.0f, 0.0f, 0.0f};
+    bool is_preview = false;
+    std::shared_ptr<const std::vector<uint8_t>> response;
+    vicad::ReplayLodPolicy lod = {};
+    vicad::ReplayLodPolicy target_lod = {};
+    vicad::MeshDiskCacheKey disk_cache_key;
+    SceneRunStats run_stats;
+    size_t bytes = 0;      // estimate, see SceneSessionSceneBytes
+    uint64_t last_used = 0;
+    // Generation and requested policy of the load whose result is still to
+    // replace this scene; 0 when none is pending.
+    uint64_t load_generation = 0;
+    vicad::ReplayLodPolicy load_lod = {};
+};
+
+// Makes `script_path` the active script. The outgoing scene is kept in the
+// tab cache along with any reload of it still running, and the incoming one is
+// restored from it when cached: returns true in that case, and the caller
+// adopts the restored scene as if it had just loaded. Either way the next
+// SceneSessionStartReload runs the script only when it changed on disk.
+bool SceneSessionSwitchScript(SceneSessionState *state, const std::string &script_path);
+// Drops the cached scene of `script_path`, e.g. when its tab is closed.
+void SceneSessionDropCached(SceneSessionState *state, const std::string &script_path);
+// Rough resident size of a scene: manifolds, meshes with their derived data
+// and BVHs, and the GPU buffers drawn from them. Shared instance geometry
+// counts once.
+size_t SceneSessionSceneBytes(const std::vector<vicad::ScriptSceneObject> &scene);
+// Replaces a cached tab's scene with the finished run submitted for it, then
+// evicts down to the budget. A run for a tab no longer cached, or one since
+// superseded, is dropped.
+void SceneTabCacheInstall(SceneSessionState *state, SceneLoadResult *result);
+
+}  // namespace vicad_scene
+
+#endif  // VICAD_SCENE_TAB_CACHE_H_
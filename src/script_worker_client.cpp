@@ -2,6 +2,7 @@
 
 #include <cerrno>
 #include <csignal>
+#include <algorithm>
 #include <chrono>
 #include <cstdio>
 #include <cstdlib>
@@ -16,13 +17,13 @@
 #include <sys/un.h>
 #include <sys/wait.h>
 #include <unistd.h>
-#include <cmath>
-#include <limits>
 #include <vector>
 
+#include "ipc_doorbell.h"
 #include "ipc_protocol.h"
 #include "log.h"
-#include "op_decoder.h"
+#include "scene_decode.h"
+#include "trace.h"
 
 namespace vicad {
 
@@ -33,106 +34,25 @@ bool set_err(std::string *error, const std::string &msg) {
   return false;
 }
 
-const char *phase_name(uint32_t phase) {
-  switch ((IpcErrorPhase)phase) {
-    case IpcErrorPhase::RequestDecode: return "request_decode";
-    case IpcErrorPhase::ScriptLoad: return "script_load";
-    case IpcErrorPhase::ScriptExecute: return "script_execute";
-    case IpcErrorPhase::SceneEncode: return "scene_encode";
-    case IpcErrorPhase::ResponseDecode: return "response_decode";
-    case IpcErrorPhase::Transport: return "transport";
-    case IpcErrorPhase::Unknown:
-    default: return "unknown";
-  }
-}
-
-std::string format_diagnostic_message(const ScriptExecutionDiagnostic &diag) {
-  std::string out = "phase=" + std::string(phase_name(diag.phase));
-  if (!diag.file.empty()) {
-    out += " file=" + diag.file;
-    if (diag.line > 0) {
-      out += ":" + std::to_string(diag.line);
-      if (diag.column > 0) out += ":" + std::to_string(diag.column);
-    }
-  }
-  if (diag.durationMs > 0) out += " duration_ms=" + std::to_string(diag.durationMs);
-  if (!diag.message.empty()) out += "\n" + diag.message;
-  if (!diag.stack.empty()) out += "\n" + diag.stack;
-  return out;
-}
-
-bool compute_bounds(const manifold::MeshGL &mesh, SceneVec3 *out_min, SceneVec3 *out_max) {
-  if (mesh.numProp < 3 || mesh.vertProperties.empty()) return false;
-  const size_t count = mesh.vertProperties.size() / mesh.numProp;
-  if (count == 0) return false;
-  double minx = std::numeric_limits<double>::infinity();
-  double miny = std::numeric_limits<double>::infinity();
-  double minz = std::numeric_limits<double>::infinity();
-  double maxx = -std::numeric_limits<double>::infinity();
-  double maxy = -std::numeric_limits<double>::infinity();
-  double maxz = -std::numeric_limits<double>::infinity();
-  for (size_t i = 0; i < count; ++i) {
-    const size_t b = i * mesh.numProp;
-    const double x = mesh.vertProperties[b + 0];
-    const double y = mesh.vertProperties[b + 1];
-    const double z = mesh.vertProperties[b + 2];
-    if (!std::isfinite(x) || !std::isfinite(y) || !std::isfinite(z)) continue;
-    minx = std::min(minx, x);
-    miny = std::min(miny, y);
-    minz = std::min(minz, z);
-    maxx = std::max(maxx, x);
-    maxy = std::max(maxy, y);
-    maxz = std::max(maxz, z);
-  }
-  if (!std::isfinite(minx) || !std::isfinite(maxx)) return false;
-  *out_min = {(float)minx, (float)miny, (float)minz};
-  *out_max = {(float)maxx, (float)maxy, (float)maxz};
-  return true;
-}
-
-bool compute_sketch_bounds(const std::vector<ScriptSketchContour> &contours,
-                           SceneVec3 *out_min, SceneVec3 *out_max) {
-  double minx = std::numeric_limits<double>::infinity();
-  double miny = std::numeric_limits<double>::infinity();
-  double minz = std::numeric_limits<double>::infinity();
-  double maxx = -std::numeric_limits<double>::infinity();
-  double maxy = -std::numeric_limits<double>::infinity();
-  double maxz = -std::numeric_limits<double>::infinity();
-  for (const ScriptSketchContour &contour : contours) {
-    for (const SceneVec3 &p : contour.points) {
-      const double x = p.x;
-      const double y = p.y;
-      const double z = p.z;
-      if (!std::isfinite(x) || !std::isfinite(y) || !std::isfinite(z)) continue;
-      minx = std::min(minx, x);
-      miny = std::min(miny, y);
-      minz = std::min(minz, z);
-      maxx = std::max(maxx, x);
-      maxy = std::max(maxy, y);
-      maxz = std::max(maxz, z);
-    }
-  }
-  if (!std::isfinite(minx) || !std::isfinite(maxx)) return false;
-  const double pad = 1e-3;
-  *out_min = {(float)minx, (float)miny, (float)(minz - pad)};
-  *out_max = {(float)maxx, (float)maxy, (float)(maxz + pad)};
-  return true;
+std::string overflow_segment_name(const std::string &shm_name, uint32_t generation) {
+  return shm_name + "-r" + std::to_string(generation);
 }
 
-SceneVec3 map_sketch_point_to_world(double x, double y, const SketchPlane &plane) {
-  switch (plane.kind) {
-    case SketchPlaneKind::XY: return {(float)x, (float)y, (float)plane.offset};
-    case SketchPlaneKind::XZ: return {(float)x, (float)plane.offset, (float)-y};
-    case SketchPlaneKind::YZ: return {(float)plane.offset, (float)x, (float)y};
-  }
-  return {(float)x, (float)y, (float)plane.offset};
-}
+// The worker outlives individual runs; a write after it dies must surface as
+// EPIPE instead of killing the app with SIGPIPE. Linux has MSG_NOSIGNAL per
+// send; macOS lacks it and sets SO_NOSIGPIPE on the socket in AcceptWorker.
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
 
+// Writes all of `buf` to the worker socket.
 bool write_all(int fd, const void *buf, size_t len) {
   const uint8_t *p = (const uint8_t *)buf;
   size_t off = 0;
   while (off < len) {
-    const ssize_t n = write(fd, p + off, len - off);
+    const ssize_t n = send(fd, p + off, len - off, kSendFlags);
     if (n <= 0) {
       if (errno == EINTR) continue;
       return false;
@@ -142,73 +62,58 @@ bool write_all(int fd, const void *buf, size_t len) {
   return true;
 }
 
-bool read_error_message(const SharedHeader *hdr, const uint8_t *base,
-                        ScriptExecutionDiagnostic *diag, std::string *error) {
-  if (hdr->response_length < sizeof(ResponsePayloadError)) {
-    return set_err(error, "Worker error payload is truncated.");
-  }
-  if ((size_t)hdr->response_offset + hdr->response_length > (size_t)hdr->capacity_bytes) {
-    return set_err(error, "Worker error payload is out of bounds.");
-  }
-  const uint8_t *payload_ptr = base + hdr->response_offset;
-  ResponsePayloadError resp = {};
-  std::memcpy(&resp, payload_ptr, sizeof(resp));
-  if (resp.version != kIpcVersion) return set_err(error, "Worker error payload has invalid version.");
-  const size_t total = sizeof(resp) + (size_t)resp.file_len + (size_t)resp.stack_len + (size_t)resp.message_len;
-  if (total > hdr->response_length) return set_err(error, "Worker error message is truncated.");
-  const uint8_t *payload = payload_ptr + sizeof(resp);
-  diag->errorCode = resp.error_code;
-  diag->phase = resp.phase;
-  diag->line = resp.line;
-  diag->column = resp.column;
-  diag->runId = resp.run_id;
-  diag->durationMs = resp.duration_ms;
-  diag->file.assign((const char *)payload, (size_t)resp.file_len);
-  payload += resp.file_len;
-  diag->stack.assign((const char *)payload, (size_t)resp.stack_len);
-  payload += resp.stack_len;
-  diag->message.assign((const char *)payload, (size_t)resp.message_len);
-  return true;
-}
+// Worker indices name shm segments and sockets, so they are unique across all
+// clients in the process, not per client.
+std::atomic<uint32_t> g_next_worker_index{1};
 
 }  // namespace
 
 ScriptWorkerClient::ScriptWorkerClient()
     : started_(false),
-      shm_fd_(-1),
-      shm_ptr_(nullptr),
-      shm_size_(kDefaultShmSize),
-      listen_fd_(-1),
-      conn_fd_(-1),
-      worker_pid_(-1),
+      standby_enabled_(true),
+      low_memory_replay_(false),
+      retain_scene_response_(false),
       next_seq_(1),
-      last_diagnostic_() {}
+      active_(),
+      standby_(),
+      replay_cache_(),
+      delta_base_(),
+      delta_base_seq_(0),
+      delta_base_lod_key_(0),
+      delta_base_response_(),
+      last_scene_response_(),
+      last_imports_(),
+      last_diagnostic_(),
+      cancel_flag_(nullptr) {}
 
 ScriptWorkerClient::~ScriptWorkerClient() { Shutdown(); }
 
-bool ScriptWorkerClient::CreateSharedMemory(std::string *error) {
+bool ScriptWorkerClient::CreateSharedMemory(WorkerProcess *w, std::string *error) {
+  TraceSpan span("ipc", "shm_setup");
   const int pid = (int)getpid();
-  shm_name_ = "/vicad-shm-" + std::to_string(pid);
+  w->shm_name = "/vicad-shm-" + std::to_string(pid) + "-" + std::to_string(w->index);
+  w->shm_size = kInitialShmSize;
 
-  shm_fd_ = shm_open(shm_name_.c_str(), O_CREAT | O_RDWR, 0600);
-  if (shm_fd_ < 0) {
+  w->shm_fd = shm_open(w->shm_name.c_str(), O_CREAT | O_RDWR, 0600);
+  if (w->shm_fd < 0) {
     return set_err(error, std::string("shm_open failed: ") + std::strerror(errno));
   }
-  if (ftruncate(shm_fd_, (off_t)shm_size_) != 0) {
+  if (ftruncate(w->shm_fd, (off_t)w->shm_size) != 0) {
     return set_err(error, std::string("ftruncate failed: ") + std::strerror(errno));
   }
 
-  shm_ptr_ = mmap(nullptr, shm_size_, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd_, 0);
-  if (shm_ptr_ == MAP_FAILED) {
-    shm_ptr_ = nullptr;
+  w->shm_ptr = mmap(nullptr, w->shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, w->shm_fd, 0);
+  if (w->shm_ptr == MAP_FAILED) {
+    w->shm_ptr = nullptr;
     return set_err(error, std::string("mmap failed: ") + std::strerror(errno));
   }
 
-  std::memset(shm_ptr_, 0, shm_size_);
-  SharedHeader *hdr = (SharedHeader *)shm_ptr_;
+  // A freshly truncated shm object is already zero-filled; only the header is
+  // written explicitly.
+  SharedHeader *hdr = (SharedHeader *)w->shm_ptr;
   std::memcpy(hdr->magic, kIpcMagic, sizeof(kIpcMagic));
   hdr->version = kIpcVersion;
-  hdr->capacity_bytes = (uint32_t)shm_size_;
+  hdr->capacity_bytes = (uint32_t)w->shm_size;
   hdr->request_seq = 0;
   hdr->response_seq = 0;
   hdr->request_offset = kDefaultRequestOffset;
@@ -217,122 +122,201 @@ bool ScriptWorkerClient::CreateSharedMemory(std::string *error) {
   hdr->response_length = 0;
   hdr->state = (uint32_t)IpcState::Idle;
   hdr->error_code = (uint32_t)IpcErrorCode::None;
-  hdr->reserved = 0;
+  hdr->response_segment = 0;
   return true;
 }
 
-bool ScriptWorkerClient::CreateSocket(std::string *error) {
+bool ScriptWorkerClient::CreateSocket(WorkerProcess *w, std::string *error) {
   const int pid = (int)getpid();
-  socket_path_ = "/tmp/vicad-worker-" + std::to_string(pid) + ".sock";
-  unlink(socket_path_.c_str());
+  w->socket_path = "/tmp/vicad-worker-" + std::to_string(pid) + "-" + std::to_string(w->index) + ".sock";
+  unlink(w->socket_path.c_str());
 
-  listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
-  if (listen_fd_ < 0) {
+  w->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (w->listen_fd < 0) {
     return set_err(error, std::string("socket failed: ") + std::strerror(errno));
   }
 
   struct sockaddr_un addr;
   std::memset(&addr, 0, sizeof(addr));
   addr.sun_family = AF_UNIX;
-  if (socket_path_.size() >= sizeof(addr.sun_path)) {
+  if (w->socket_path.size() >= sizeof(addr.sun_path)) {
     return set_err(error, "Socket path is too long.");
   }
-  std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path_.c_str());
+  std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", w->socket_path.c_str());
 
-  if (bind(listen_fd_, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+  if (bind(w->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
     return set_err(error, std::string("bind failed: ") + std::strerror(errno));
   }
-  if (listen(listen_fd_, 1) != 0) {
+  if (listen(w->listen_fd, 1) != 0) {
     return set_err(error, std::string("listen failed: ") + std::strerror(errno));
   }
   return true;
 }
 
-bool ScriptWorkerClient::SpawnWorker(std::string *error) {
-  LogEvent("WORKER_STARTING", 0);
+bool ScriptWorkerClient::SpawnWorker(WorkerProcess *w, std::string *error) {
+  LogEvent("WORKER_STARTING", 0, "worker=" + std::to_string(w->index));
+  TraceSpan span("ipc", "worker_spawn");
   const int pid = fork();
   if (pid < 0) {
     return set_err(error, std::string("fork failed: ") + std::strerror(errno));
   }
   if (pid == 0) {
-    std::string size_s = std::to_string(shm_size_);
-    execlp("bun", "bun", "worker/worker.ts", "--socket", socket_path_.c_str(), "--shm",
-           shm_name_.c_str(), "--size", size_s.c_str(), (char *)nullptr);
+    std::string size_s = std::to_string(w->shm_size);
+    execlp("bun", "bun", "worker/worker.ts", "--socket", w->socket_path.c_str(), "--shm",
+           w->shm_name.c_str(), "--size", size_s.c_str(), (char *)nullptr);
     _exit(127);
   }
-  worker_pid_ = pid;
+  w->pid = pid;
   LogEvent("WORKER_STARTED", 0, "pid=" + std::to_string(pid));
   return true;
 }
 
-bool ScriptWorkerClient::AcceptWorker(std::string *error) {
+bool ScriptWorkerClient::AcceptWorker(WorkerProcess *w, std::string *error) {
+  // Mostly Bun's cold start when the worker was only just spawned.
+  TraceSpan span("ipc", "worker_connect");
   fd_set fds;
   FD_ZERO(&fds);
-  FD_SET(listen_fd_, &fds);
+  FD_SET(w->listen_fd, &fds);
   struct timeval tv;
   tv.tv_sec = 3;
   tv.tv_usec = 0;
-  const int rc = select(listen_fd_ + 1, &fds, nullptr, nullptr, &tv);
+  const int rc = select(w->listen_fd + 1, &fds, nullptr, nullptr, &tv);
   if (rc <= 0) {
     return set_err(error, "Timed out waiting for Bun worker to connect.");
   }
-  conn_fd_ = accept(listen_fd_, nullptr, nullptr);
-  if (conn_fd_ < 0) {
+  w->conn_fd = accept(w->listen_fd, nullptr, nullptr);
+  if (w->conn_fd < 0) {
     return set_err(error, std::string("accept failed: ") + std::strerror(errno));
   }
-  LogEvent("WORKER_CONNECTED", 0);
+#ifdef SO_NOSIGPIPE
+  // See kSendFlags: where send has no MSG_NOSIGNAL the socket suppresses SIGPIPE.
+  const int one = 1;
+  setsockopt(w->conn_fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+  LogEvent("WORKER_CONNECTED", 0, "pid=" + std::to_string(w->pid));
   return true;
 }
 
-bool ScriptWorkerClient::Start(std::string *error) {
-  if (started_) return true;
-  if (!CreateSharedMemory(error)) {
-    Shutdown();
+bool ScriptWorkerClient::LaunchWorker(WorkerProcess *w, std::string *error) {
+  w->index = g_next_worker_index.fetch_add(1, std::memory_order_relaxed);
+  if (!CreateSharedMemory(w, error) || !CreateSocket(w, error) || !SpawnWorker(w, error)) {
+    StopWorker(w);
     return false;
   }
-  if (!CreateSocket(error)) {
-    Shutdown();
-    return false;
+  return true;
+}
+
+void ScriptWorkerClient::SpawnStandby() {
+  if (!standby_enabled_ || standby_.pid > 0) return;
+  // Only shm/socket setup and fork happen here; Bun boots concurrently and the
+  // connection is accepted when the standby is promoted.
+  std::string standby_err;
+  if (!LaunchWorker(&standby_, &standby_err)) {
+    LogEvent("STANDBY_FAILED", 0, standby_err);
   }
-  if (!SpawnWorker(error)) {
-    Shutdown();
-    return false;
+}
+
+bool ScriptWorkerClient::Start(std::string *error) {
+  if (started_) return true;
+  bool ready = false;
+  if (standby_.pid > 0) {
+    std::string standby_err;
+    if (WorkerAlive(&standby_) && AcceptWorker(&standby_, &standby_err)) {
+      std::swap(active_, standby_);
+      LogEvent("STANDBY_PROMOTED", 0, "pid=" + std::to_string(active_.pid));
+      ready = true;
+    } else {
+      LogEvent("STANDBY_FAILED", 0, standby_err.empty() ? "standby exited" : standby_err);
+      StopWorker(&standby_);
+    }
   }
-  if (!AcceptWorker(error)) {
-    Shutdown();
-    return false;
+  if (!ready) {
+    if (!LaunchWorker(&active_, error)) return false;
+    if (!AcceptWorker(&active_, error)) {
+      StopWorker(&active_);
+      return false;
+    }
   }
   started_ = true;
+  SpawnStandby();
   return true;
 }
 
+bool ScriptWorkerClient::WorkerAlive(WorkerProcess *w) {
+  if (w->pid <= 0) return false;
+  int status = 0;
+  const pid_t rc = waitpid(w->pid, &status, WNOHANG);
+  if (rc == 0) return true;
+  LogEvent("WORKER_EXITED", 0, "status=" + std::to_string(status));
+  w->pid = -1;
+  return false;
+}
+
+void ScriptWorkerClient::RetireActive() {
+  StopWorker(&active_);
+  started_ = false;
+}
+
 bool ScriptWorkerClient::SendLine(const std::string &line, std::string *error) {
-  if (conn_fd_ < 0) return set_err(error, "Worker socket is not connected.");
-  if (!write_all(conn_fd_, line.data(), line.size())) {
+  if (active_.conn_fd < 0) return set_err(error, "Worker socket is not connected.");
+  if (!write_all(active_.conn_fd, line.data(), line.size())) {
     return set_err(error, std::string("Failed writing socket data: ") + std::strerror(errno));
   }
   return true;
 }
 
-bool ScriptWorkerClient::ReadLineWithTimeout(int timeout_ms, std::string *out, std::string *error) {
-  out->clear();
-  struct pollfd pfd;
-  pfd.fd = conn_fd_;
-  pfd.events = POLLIN;
+bool ScriptWorkerClient::FeedReplayStream(ReplayStream *stream, std::string *replay_error) {
+  if (!replay_error->empty()) return false;
+  SharedHeader *hdr = (SharedHeader *)active_.shm_ptr;
+  // The acquire load orders the record bytes and the response_segment that
+  // held them before the watermark, so the mapping below covers `committed`.
+  const uint32_t committed = DoorbellLoad(SharedHeaderRecordsCommittedWord(hdr));
+  if (committed <= stream->consumed) return true;
+  ResponseRegion region;
+  if (!MapResponseRegion(&active_, &region, replay_error)) return false;
+  const size_t records_offset = region.stream_offset + sizeof(ResponsePayloadScene);
+  if (records_offset + (size_t)committed > region.size) {
+    *replay_error = "Worker op stream is out of bounds.";
+    return false;
+  }
+  return ReplayStreamFeed(stream, region.base + records_offset, committed, replay_error);
+}
+
+bool ScriptWorkerClient::WaitForResponse(uint64_t seq, int timeout_ms, ReplayStream *stream,
+                                         std::string *replay_error, double *replay_ms, std::string *error) {
+  SharedHeader *hdr = (SharedHeader *)active_.shm_ptr;
+  uint32_t *state_word = SharedHeaderStateWord(hdr);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
   while (true) {
-    const int rc = poll(&pfd, 1, timeout_ms);
-    if (rc < 0) {
-      if (errno == EINTR) continue;
-      return set_err(error, std::string("poll failed: ") + std::strerror(errno));
+    const uint32_t state = DoorbellLoad(state_word);
+    if ((state == (uint32_t)IpcState::ResponseReady || state == (uint32_t)IpcState::ResponseError) &&
+        hdr->response_seq == seq) {
+      return true;
+    }
+    // Replay whatever the worker has committed so far; the worker also rings
+    // the doorbell on every watermark advance, not only on state changes.
+    // A replay failure is kept for after the response so the run stays in
+    // step with the worker. Time spent replaying does not count against the
+    // worker's timeout.
+    const auto feed_started = std::chrono::steady_clock::now();
+    if (stream) FeedReplayStream(stream, replay_error);
+    const auto feed_time = std::chrono::steady_clock::now() - feed_started;
+    deadline += feed_time;
+    *replay_ms += std::chrono::duration<double, std::milli>(feed_time).count();
+    const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now()).count();
+    if (remaining <= 0) return set_err(error, "Timed out waiting for worker response.");
+    if (cancel_flag_ && cancel_flag_->load(std::memory_order_relaxed)) return set_err(error, "Run cancelled.");
+    // Wake periodically even without a doorbell so a worker that died
+    // mid-run is noticed through the socket instead of the full timeout.
+    DoorbellWait(state_word, state, (int)std::min<long long>(remaining, kLivenessSliceMs));
+    struct pollfd pfd;
+    pfd.fd = active_.conn_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLIN | POLLHUP | POLLERR)) != 0) {
+      return set_err(error, "Worker socket closed unexpectedly.");
     }
-    if (rc == 0) return set_err(error, "Timed out waiting for worker response.");
-    if ((pfd.revents & POLLIN) == 0) return set_err(error, "Worker socket closed unexpectedly.");
-    char c = 0;
-    const ssize_t n = read(conn_fd_, &c, 1);
-    if (n <= 0) return set_err(error, "Worker socket read failed.");
-    if (c == '\n') return true;
-    out->push_back(c);
-    if (out->size() > 1024) return set_err(error, "Worker response line too long.");
   }
 }
 
@@ -340,30 +324,39 @@ bool ScriptWorkerClient::ExecuteScriptScene(const char *script_path,
                                             std::vector<ScriptSceneObject> *objects,
                                             std::string *error,
                                             const ReplayLodPolicy &lod_policy) {
-  // Bun caches file:// ESM modules per process and does not re-run top-level
-  // side effects for repeated imports of the same path. Restart per run to keep
-  // hot-reload behavior deterministic.
-  if (started_) Shutdown();
+  // The worker is kept warm across runs; it evicts user modules from Bun's ESM
+  // registry before each import so top-level side effects re-run. Only respawn
+  // when the previous worker has exited or a transport failure tore it down.
+  if (started_ && !WorkerAlive(&active_)) RetireActive();
   if (!Start(error)) return false;
   if (!script_path || !objects) return set_err(error, "Invalid execute arguments.");
   objects->clear();
   last_diagnostic_ = {};
+  last_run_stats_ = {};
+  last_scene_response_.reset();
+  last_imports_.clear();
 
-  SharedHeader *hdr = (SharedHeader *)shm_ptr_;
+  SharedHeader *hdr = (SharedHeader *)active_.shm_ptr;
   if (std::memcmp(hdr->magic, kIpcMagic, sizeof(kIpcMagic)) != 0 || hdr->version != kIpcVersion) {
+    RetireActive();
     return set_err(error, "Shared memory header is invalid.");
   }
 
-  const size_t req_cap = (size_t)hdr->response_offset - (size_t)hdr->request_offset;
+  const size_t req_cap = (size_t)kDefaultResponseOffset - (size_t)hdr->request_offset;
   const size_t path_len = std::strlen(script_path);
   const size_t req_size = sizeof(RequestPayload) + path_len;
   if (req_size > req_cap) return set_err(error, "Script path is too long for request buffer.");
 
-  uint8_t *base = (uint8_t *)shm_ptr_;
+  uint8_t *base = (uint8_t *)active_.shm_ptr;
   uint8_t *req = base + hdr->request_offset;
   RequestPayload rp = {};
   rp.version = kIpcVersion;
   rp.script_path_len = (uint32_t)path_len;
+  // A retained response must be self-contained, so a delta is only requested
+  // when the base run's response is at hand to expand its keep records.
+  const bool delta = !low_memory_replay_ && delta_base_ && delta_base_lod_key_ == LodKeyForPolicy(lod_policy) &&
+                     (!retain_scene_response_ || delta_base_response_);
+  rp.delta_base_seq = delta ? delta_base_seq_ : 0;
   std::memcpy(req, &rp, sizeof(rp));
   std::memcpy(req + sizeof(rp), script_path, path_len);
 
@@ -371,151 +364,165 @@ bool ScriptWorkerClient::ExecuteScriptScene(const char *script_path,
   const auto run_started = std::chrono::steady_clock::now();
   hdr->request_seq = seq;
   hdr->request_length = (uint32_t)req_size;
+  hdr->response_offset = kDefaultResponseOffset;
   hdr->response_length = 0;
+  hdr->response_segment = 0;
   hdr->error_code = (uint32_t)IpcErrorCode::None;
-  hdr->state = (uint32_t)IpcState::RequestReady;
+  DoorbellStore(SharedHeaderRecordsCommittedWord(hdr), 0);
+  DoorbellStore(SharedHeaderStateWord(hdr), (uint32_t)IpcState::RequestReady);
 
+  // The socket line only wakes the worker's event loop; completion is signalled
+  // through SharedHeader::state and the shm doorbell.
   LogEvent("RUN_QUEUED", seq, script_path);
   if (!SendLine("RUN " + std::to_string(seq) + "\n", error)) {
-    Shutdown();
+    RetireActive();
     return false;
   }
   LogEvent("RUN_STARTED", seq);
 
-  std::string line;
-  if (!ReadLineWithTimeout(30 * 1000, &line, error)) {
-    LogEvent("RUN_FAILED", seq, "transport_timeout");
-    Shutdown();
+  // Low-memory replay needs every record and the scene roots before it starts,
+  // so nothing is replayed while the script runs.
+  ReplayStream stream;
+  if (low_memory_replay_) {
+    ReplayStreamBegin(&stream, lod_policy);
+    stream.release_dead = true;
+  } else {
+    replay_cache_.BeginRun();
+    ReplayStreamBegin(&stream, lod_policy, &replay_cache_, delta ? delta_base_ : nullptr);
+  }
+  std::string replay_error;
+  double replay_ms = 0.0;
+  // The script runs in the worker meanwhile; streamed replay spans nest in it.
+  TraceSpan run_span("ipc", "script_run");
+  if (!WaitForResponse(seq, 30 * 1000, low_memory_replay_ ? nullptr : &stream, &replay_error, &replay_ms, error)) {
+    const bool cancelled = cancel_flag_ && cancel_flag_->load(std::memory_order_relaxed);
+    LogEvent(cancelled ? "RUN_CANCELLED" : "RUN_FAILED", seq, cancelled ? "" : "transport_timeout");
+    // A cancelled or timed-out worker may still be running the script;
+    // tearing it down is the only way to stop it, and the standby is warm.
+    RetireActive();
     return false;
   }
 
-  const std::string done = "DONE " + std::to_string(seq);
-  const std::string fail = "ERROR " + std::to_string(seq);
-  if (line == fail) {
+  ResponseRegion region;
+  if (!MapResponseRegion(&active_, &region, error)) return false;
+  if ((size_t)hdr->response_offset + hdr->response_length > region.size) {
+    return set_err(error, "Worker response payload is out of bounds.");
+  }
+  const uint8_t *payload = region.base + hdr->response_offset;
+  run_span.End();
+
+  if (DoorbellLoad(SharedHeaderStateWord(hdr)) == (uint32_t)IpcState::ResponseError) {
     std::string read_err;
-    if (!read_error_message(hdr, base, &last_diagnostic_, &read_err)) return set_err(error, read_err);
+    if (!DecodeErrorResponse(payload, hdr->response_length, &last_diagnostic_, &read_err)) {
+      return set_err(error, read_err);
+    }
     if (last_diagnostic_.durationMs == 0) {
       const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
           std::chrono::steady_clock::now() - run_started).count();
       last_diagnostic_.durationMs = (uint32_t)((ms < 0) ? 0 : ms);
     }
-    LogEvent("RUN_FAILED", seq, "phase=" + std::string(phase_name(last_diagnostic_.phase)));
-    return set_err(error, format_diagnostic_message(last_diagnostic_));
-  }
-  if (line != done) {
-    LogEvent("RUN_FAILED", seq, "unexpected_response");
-    Shutdown();
-    return set_err(error, "Unexpected worker response: " + line);
+    LogEvent("RUN_FAILED", seq, "phase=" + std::string(IpcErrorPhaseName(last_diagnostic_.phase)));
+    return set_err(error, FormatScriptDiagnostic(last_diagnostic_));
   }
-  const auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-      std::chrono::steady_clock::now() - run_started).count();
+  const auto response_at = std::chrono::steady_clock::now();
+  const auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(response_at - run_started).count();
   LogEvent("RUN_DONE", seq, "duration_ms=" + std::to_string((long long)elapsed_ms));
 
-  if (hdr->state != (uint32_t)IpcState::ResponseReady) return set_err(error, "Worker state is not ResponseReady.");
-  if (hdr->response_seq != seq) return set_err(error, "Worker sequence mismatch.");
-  if (hdr->response_length < sizeof(ResponsePayloadScene)) return set_err(error, "Worker response payload is too small.");
-  if ((size_t)hdr->response_offset + hdr->response_length > (size_t)hdr->capacity_bytes) {
-    return set_err(error, "Worker response payload is out of bounds.");
-  }
-
-  const uint8_t *resp_ptr = base + hdr->response_offset;
-  ResponsePayloadScene ok = {};
-  std::memcpy(&ok, resp_ptr, sizeof(ok));
-  if (ok.version != kIpcVersion) {
-    return set_err(error, "Worker response version mismatch. Check worker/client protocol compatibility.");
-  }
-
-  const size_t payload_need =
-      sizeof(ResponsePayloadScene) + (size_t)ok.records_size + (size_t)ok.object_table_size + (size_t)ok.diagnostics_len;
-  if (payload_need > hdr->response_length) return set_err(error, "Worker response payload is truncated.");
-
-  const uint8_t *records_ptr = resp_ptr + sizeof(ResponsePayloadScene);
-  const uint8_t *object_table_ptr = records_ptr + ok.records_size;
-  const uint8_t *names_ptr = object_table_ptr + ok.object_table_size;
-  const size_t name_blob_size = (size_t)ok.diagnostics_len;
-  const size_t expected_table_size = (size_t)ok.object_count * sizeof(SceneObjectRecord);
-  if (ok.object_count == 0) return set_err(error, "Worker returned zero scene objects.");
-  if (ok.object_table_size != expected_table_size) {
-    return set_err(error, "Worker scene object table size mismatch.");
-  }
-
-  ReplayTables tables;
-  if (!ReplayOpsToTables(records_ptr, ok.records_size, ok.op_count,
-                         lod_policy, &tables, error)) {
-    return false;
-  }
-
-  size_t name_off = 0;
-  objects->reserve(ok.object_count);
-  for (uint32_t i = 0; i < ok.object_count; ++i) {
-    SceneObjectRecord rec = {};
-    std::memcpy(&rec, object_table_ptr + i * sizeof(SceneObjectRecord), sizeof(SceneObjectRecord));
-    if (name_off + rec.name_len > name_blob_size) {
-      return set_err(error, "Worker scene name blob is truncated.");
-    }
-    ScriptSceneObject obj;
-    obj.objectId = rec.object_id_hash;
-    obj.name.assign((const char *)(names_ptr + name_off), (size_t)rec.name_len);
-    obj.kind = ScriptSceneObjectKind::Unknown;
-    obj.rootKind = rec.root_kind;
-    obj.rootId = rec.root_id;
-
-    std::string trace_error;
-    if (!BuildOperationTraceForRoot(tables, rec.root_kind, rec.root_id, &obj.opTrace, &trace_error)) {
-      return set_err(error, trace_error);
+  if (!replay_error.empty()) return set_err(error, replay_error);
+  // How much of the replay overlapped script execution.
+  LogEvent("RUN_STREAMED", seq, "early_ops=" + std::to_string(stream.parsed));
+  TraceSpan decode_span("ipc", "scene_decode");
+  if (!DecodeSceneResponse(payload, hdr->response_length, &stream, objects, error, &last_imports_)) return false;
+  decode_span.End();
+  ReadSceneRunStats(payload, &last_run_stats_);
+  last_run_stats_.runMs = std::chrono::duration<double, std::milli>(response_at - run_started).count();
+  last_run_stats_.replayMs =
+      replay_ms + std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - response_at).count();
+  LogEvent("RUN_PHASES", seq, "load_us=" + std::to_string(last_run_stats_.workerLoadUs) +
+                                  " execute_us=" + std::to_string(last_run_stats_.workerExecuteUs) +
+                                  " encode_us=" + std::to_string(last_run_stats_.workerEncodeUs) +
+                                  " ops=" + std::to_string(last_run_stats_.opCount) +
+                                  " record_bytes=" + std::to_string(last_run_stats_.recordsBytes));
+  last_run_stats_.keptOps = stream.kept;
+  if (retain_scene_response_) {
+    auto retained = std::make_shared<std::vector<uint8_t>>();
+    if (stream.kept == 0) {
+      retained->assign(payload, payload + hdr->response_length);
+    } else if (!ExpandSceneResponseKeeps(*delta_base_response_, payload, hdr->response_length, retained.get(),
+                                         error)) {
+      return false;
     }
+    last_scene_response_ = std::move(retained);
+  }
+  if (low_memory_replay_) return true;
+  replay_cache_.EndRun(LodKeyForPolicy(lod_policy));
+  LogEvent("REPLAY_CACHE", seq, "hits=" + std::to_string(replay_cache_.hits()) +
+                                    " misses=" + std::to_string(replay_cache_.misses()) +
+                                    " kept=" + std::to_string(stream.kept) +
+                                    " entries=" + std::to_string(replay_cache_.size()));
+  // Every object shares the run's tables; they are the base of the next delta.
+  delta_base_ = objects->front().tables;
+  delta_base_seq_ = seq;
+  delta_base_lod_key_ = LodKeyForPolicy(lod_policy);
+  delta_base_response_ = last_scene_response_;
+  return true;
+}
 
-    if (rec.root_kind == (uint32_t)NodeKind::Manifold) {
-      manifold::Manifold m;
-      if (!ResolveReplayManifold(tables, rec.root_kind, rec.root_id,
-                                 lod_policy, &m, error)) {
-        return false;
-      }
-      obj.kind = ScriptSceneObjectKind::Manifold;
-      obj.manifold = std::move(m);
-      obj.mesh = obj.manifold.GetMeshGL();
-      if (!compute_bounds(obj.mesh, &obj.bmin, &obj.bmax)) {
-        return set_err(error, "Failed to compute bounds for scene object " + std::to_string(i));
-      }
-    } else if (rec.root_kind == (uint32_t)NodeKind::CrossSection) {
-      manifold::CrossSection cs;
-      if (!ResolveReplayCrossSection(tables, rec.root_kind, rec.root_id, &cs, error)) return false;
-      SketchPlane plane;
-      if (!ResolveReplayCrossSectionPlane(tables, rec.root_kind, rec.root_id, &plane, error)) return false;
-      obj.kind = ScriptSceneObjectKind::CrossSection;
-      obj.mesh.numProp = 3;
-      SketchDimensionModel dims;
-      std::string dim_error;
-      if (plane.kind == SketchPlaneKind::XY &&
-          BuildSketchDimensionModelForRoot(tables, rec.root_id, &dims, &dim_error)) {
-        obj.sketchDims = std::move(dims);
-      } else {
-        obj.sketchDims.reset();
-      }
-      manifold::Polygons polys = cs.ToPolygons();
-      obj.sketchContours.reserve(polys.size());
-      for (const manifold::SimplePolygon &poly : polys) {
-        if (poly.empty()) continue;
-        ScriptSketchContour contour;
-        contour.points.reserve(poly.size());
-        for (const manifold::vec2 &p : poly) {
-          contour.points.push_back(map_sketch_point_to_world(p.x, p.y, plane));
-        }
-        obj.sketchContours.push_back(std::move(contour));
-      }
-      if (!compute_sketch_bounds(obj.sketchContours, &obj.bmin, &obj.bmax)) {
-        obj.bmin = {0.0f, 0.0f, 0.0f};
-        obj.bmax = {0.0f, 0.0f, 0.0f};
+bool ScriptWorkerClient::MapResponseRegion(WorkerProcess *w, ResponseRegion *region, std::string *error) {
+  const SharedHeader *hdr = (const SharedHeader *)w->shm_ptr;
+  uint32_t generation = hdr->response_segment;
+  if (generation == 0) {
+    region->base = (const uint8_t *)w->shm_ptr;
+    region->size = w->shm_size;
+    region->stream_offset = kDefaultResponseOffset;
+    return true;
+  }
+  while (generation != w->overflow_generation) {
+    // The worker publishes a replacement's generation before unlinking the
+    // outgrown segment, so the old mapping is dropped here and the new one
+    // opened by name. If the worker grew again before the open, the name is
+    // gone but the header already names the newer generation: retry with it.
+    UnmapOverflow(w);
+    const std::string name = overflow_segment_name(w->shm_name, generation);
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+      const uint32_t latest = hdr->response_segment;
+      if (errno == ENOENT && latest != generation) {
+        generation = latest;
+        continue;
       }
-    } else {
-      return set_err(error, "Worker scene object has unsupported root kind.");
+      return set_err(error, std::string("shm_open failed for response segment: ") + std::strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+      close(fd);
+      return set_err(error, "Response segment has no size.");
+    }
+    void *ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+      return set_err(error, std::string("mmap failed for response segment: ") + std::strerror(errno));
     }
+    w->overflow_generation = generation;
+    w->overflow_ptr = ptr;
+    w->overflow_size = (size_t)st.st_size;
+    LogEvent("SHM_OVERFLOW_MAPPED", 0, "generation=" + std::to_string(generation) +
+                                           " bytes=" + std::to_string(w->overflow_size));
+  }
+  // Overflow segments always start the stream at offset 0.
+  region->base = (const uint8_t *)w->overflow_ptr;
+  region->size = w->overflow_size;
+  region->stream_offset = 0;
+  return true;
+}
 
-    name_off += rec.name_len;
-    objects->push_back(std::move(obj));
+void ScriptWorkerClient::UnmapOverflow(WorkerProcess *w) {
+  if (w->overflow_ptr) {
+    munmap(w->overflow_ptr, w->overflow_size);
+    w->overflow_ptr = nullptr;
+    w->overflow_size = 0;
   }
-
-  return true;
+  w->overflow_generation = 0;
 }
 
 void ScriptWorkerClient::LogEvent(const char *event, uint64_t run_id, const std::string &details) {
@@ -523,41 +530,51 @@ void ScriptWorkerClient::LogEvent(const char *event, uint64_t run_id, const std:
   vicad::log_event(event, run_id, details.empty() ? nullptr : details.c_str());
 }
 
-void ScriptWorkerClient::Shutdown() {
-  if (conn_fd_ >= 0) {
-    std::string unused;
-    SendLine("SHUTDOWN\n", &unused);
-    close(conn_fd_);
-    conn_fd_ = -1;
-  }
-  if (listen_fd_ >= 0) {
-    close(listen_fd_);
-    listen_fd_ = -1;
-  }
-  if (!socket_path_.empty()) {
-    unlink(socket_path_.c_str());
-    socket_path_.clear();
-  }
-  if (worker_pid_ > 0) {
-    LogEvent("WORKER_STOPPING", 0, "pid=" + std::to_string(worker_pid_));
-    kill(worker_pid_, SIGTERM);
+void ScriptWorkerClient::StopWorker(WorkerProcess *w) {
+  if (w->conn_fd >= 0) {
+    static const char kShutdownLine[] = "SHUTDOWN\n";
+    write_all(w->conn_fd, kShutdownLine, sizeof(kShutdownLine) - 1);
+    close(w->conn_fd);
+    w->conn_fd = -1;
+  }
+  if (w->listen_fd >= 0) {
+    close(w->listen_fd);
+    w->listen_fd = -1;
+  }
+  if (!w->socket_path.empty()) {
+    unlink(w->socket_path.c_str());
+    w->socket_path.clear();
+  }
+  if (w->pid > 0) {
+    LogEvent("WORKER_STOPPING", 0, "pid=" + std::to_string(w->pid));
+    kill(w->pid, SIGTERM);
     int status = 0;
-    waitpid(worker_pid_, &status, 0);
+    waitpid(w->pid, &status, 0);
     LogEvent("WORKER_STOPPED", 0, "status=" + std::to_string(status));
-    worker_pid_ = -1;
+    w->pid = -1;
+  }
+  if (w->overflow_generation != 0) {
+    // Normally unlinked by the worker on SHUTDOWN; this covers a crashed one.
+    shm_unlink(overflow_segment_name(w->shm_name, w->overflow_generation).c_str());
   }
-  if (shm_ptr_) {
-    munmap(shm_ptr_, shm_size_);
-    shm_ptr_ = nullptr;
+  UnmapOverflow(w);
+  if (w->shm_ptr) {
+    munmap(w->shm_ptr, w->shm_size);
+    w->shm_ptr = nullptr;
   }
-  if (shm_fd_ >= 0) {
-    close(shm_fd_);
-    shm_fd_ = -1;
+  if (w->shm_fd >= 0) {
+    close(w->shm_fd);
+    w->shm_fd = -1;
   }
-  if (!shm_name_.empty()) {
-    shm_unlink(shm_name_.c_str());
-    shm_name_.clear();
+  if (!w->shm_name.empty()) {
+    shm_unlink(w->shm_name.c_str());
+    w->shm_name.clear();
   }
+}
+
+void ScriptWorkerClient::Shutdown() {
+  StopWorker(&active_);
+  StopWorker(&standby_);
   started_ = false;
 }
 
@@ -1,60 +1,22 @@
 #ifndef VICAD_SCRIPT_WORKER_CLIENT_H_
 #define VICAD_SCRIPT_WORKER_CLIENT_H_
 
+#include <atomic>
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
 
-#include "manifold/manifold.h"
 #include "lod_policy.h"
-#include "sketch_dimensions.h"
+#include "op_decoder.h"
+#include "replay_cache.h"
+#include "replay_stream.h"
+#include "scene_decode.h"
+#include "scene_object.h"
 
 namespace vicad {
 
-enum class ScriptSceneObjectKind : uint32_t {
-  Unknown = 0,
-  Manifold = 1,
-  CrossSection = 2,
-};
-
-struct SceneVec3 {
-  float x;
-  float y;
-  float z;
-};
-
-struct ScriptSketchContour {
-  std::vector<SceneVec3> points;
-};
-
-struct ScriptSceneObject {
-  uint64_t objectId = 0;
-  std::string name;
-  ScriptSceneObjectKind kind = ScriptSceneObjectKind::Unknown;
-  uint32_t rootKind = 0;
-  uint32_t rootId = 0;
-  manifold::Manifold manifold;
-  manifold::MeshGL mesh;
-  std::vector<ScriptSketchContour> sketchContours;
-  std::optional<SketchDimensionModel> sketchDims;
-  std::vector<OpTraceEntry> opTrace;
-  SceneVec3 bmin = {0.0f, 0.0f, 0.0f};
-  SceneVec3 bmax = {0.0f, 0.0f, 0.0f};
-};
-
-struct ScriptExecutionDiagnostic {
-  uint32_t errorCode = 0;
-  uint32_t phase = 0;
-  uint32_t line = 0;
-  uint32_t column = 0;
-  uint64_t runId = 0;
-  uint32_t durationMs = 0;
-  std::string file;
-  std::string message;
-  std::string stack;
-};
-
 class ScriptWorkerClient {
  public:
   ScriptWorkerClient();
@@ -68,30 +30,101 @@ class ScriptWorkerClient {
                           std::string *error,
                           const ReplayLodPolicy &lod_policy = {});
   bool started() const { return started_; }
+  // Starts the worker (and its standby) now rather than on the first run, so
+  // the Bun cold start overlaps whatever the caller does meanwhile. Returns
+  // false when it could not start; the first run then tries again.
+  bool Prestart(std::string *error) { return Start(error); }
+  // When enabled (the default), a spare worker is spawned after every start so
+  // a later restart promotes it instead of waiting on a Bun cold start.
+  void set_standby_enabled(bool enabled) { standby_enabled_ = enabled; }
+  // Replays each run without the cache or delta base and releases intermediate
+  // nodes after their last use, trading reload speed for peak memory. Suits
+  // one-shot tools and very large scenes.
+  void set_low_memory_replay(bool enabled) { low_memory_replay_ = enabled; }
+  // When enabled, a copy of every successful scene response is kept so it can
+  // be replayed again, e.g. at another LOD profile on a background thread
+  // (ReplaySceneResponse). Retained responses are self-contained: keep records
+  // of a delta run are expanded from the retained response of its base run.
+  void set_retain_scene_response(bool enabled) { retain_scene_response_ = enabled; }
+  std::shared_ptr<const std::vector<uint8_t>> last_scene_response() const { return last_scene_response_; }
+  // Absolute paths of the user modules the last successful run imported,
+  // besides the script itself.
+  const std::vector<std::string> &last_imports() const { return last_imports_; }
+  // When `flag` is set while a run is waiting on the worker, the run fails
+  // within one liveness slice and the worker is torn down (its standby takes
+  // over), so a superseded run does not hold up the next one. The flag must
+  // outlive the client; null disables cancellation.
+  void set_cancel_flag(const std::atomic<bool> *flag) { cancel_flag_ = flag; }
   const ScriptExecutionDiagnostic &last_diagnostic() const { return last_diagnostic_; }
+  const ScriptRunStats &last_run_stats() const { return last_run_stats_; }
   void Shutdown();
 
  private:
+  static constexpr int kLivenessSliceMs = 50;
+
+  struct WorkerProcess {
+    uint32_t index = 0;
+    int shm_fd = -1;
+    void *shm_ptr = nullptr;
+    size_t shm_size = 0;
+    int listen_fd = -1;
+    int conn_fd = -1;
+    int pid = -1;
+    std::string shm_name;
+    std::string socket_path;
+    // Read-only mapping of the worker's current overflow segment, if any.
+    uint32_t overflow_generation = 0;
+    void *overflow_ptr = nullptr;
+    size_t overflow_size = 0;
+  };
+
+  // The mapped segment currently holding the response, and where the op
+  // record stream starts in it.
+  struct ResponseRegion {
+    const uint8_t *base = nullptr;
+    size_t size = 0;
+    size_t stream_offset = 0;
+  };
+
   bool Start(std::string *error);
-  bool CreateSharedMemory(std::string *error);
-  bool CreateSocket(std::string *error);
-  bool SpawnWorker(std::string *error);
-  bool AcceptWorker(std::string *error);
+  bool LaunchWorker(WorkerProcess *w, std::string *error);
+  bool CreateSharedMemory(WorkerProcess *w, std::string *error);
+  bool CreateSocket(WorkerProcess *w, std::string *error);
+  bool SpawnWorker(WorkerProcess *w, std::string *error);
+  bool AcceptWorker(WorkerProcess *w, std::string *error);
+  void SpawnStandby();
+  bool WorkerAlive(WorkerProcess *w);
+  void StopWorker(WorkerProcess *w);
+  void RetireActive();
   bool SendLine(const std::string &line, std::string *error);
-  bool ReadLineWithTimeout(int timeout_ms, std::string *out, std::string *error);
+  bool WaitForResponse(uint64_t seq, int timeout_ms, ReplayStream *stream,
+                       std::string *replay_error, double *replay_ms, std::string *error);
+  bool FeedReplayStream(ReplayStream *stream, std::string *replay_error);
+  bool MapResponseRegion(WorkerProcess *w, ResponseRegion *region, std::string *error);
+  void UnmapOverflow(WorkerProcess *w);
   void LogEvent(const char *event, uint64_t run_id, const std::string &details = "");
 
   bool started_;
-  int shm_fd_;
-  void *shm_ptr_;
-  size_t shm_size_;
-  int listen_fd_;
-  int conn_fd_;
-  int worker_pid_;
+  bool standby_enabled_;
+  bool low_memory_replay_;
+  bool retain_scene_response_;
   uint64_t next_seq_;
+  WorkerProcess active_;
+  WorkerProcess standby_;
+  // Survives worker restarts: digests are content-derived, not per-process.
+  ReplayCache replay_cache_;
+  // Replay tables of the last decoded run, which the worker may send the next
+  // run against as a delta. Only used when the LOD key matches.
+  std::shared_ptr<const ReplayTables> delta_base_;
+  uint64_t delta_base_seq_;
+  uint32_t delta_base_lod_key_;
+  // Retained response of the delta base run, when it was retained.
+  std::shared_ptr<const std::vector<uint8_t>> delta_base_response_;
+  std::shared_ptr<const std::vector<uint8_t>> last_scene_response_;
+  std::vector<std::string> last_imports_;
   ScriptExecutionDiagnostic last_diagnostic_;
-  std::string shm_name_;
-  std::string socket_path_;
+  ScriptRunStats last_run_stats_;
+  const std::atomic<bool> *cancel_flag_;
 };
 
 }  // namespace vicad
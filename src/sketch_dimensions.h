@@ -71,6 +71,23 @@ struct OpTraceEntry {
   std::vector<double> args;
 };
 
+// Where one root's trace sits in OpTraceTable::order. `valid` is false when
+// the root is not a traced node.
+struct OpTraceSpan {
+  uint32_t offset = 0;
+  uint32_t count = 0;
+  bool valid = false;
+};
+
+// Operation traces of several roots of the same replay tables. Every node has
+// one entry however many roots reach it; a root's trace is its span of
+// `order`, entry indices with inputs before their users.
+struct OpTraceTable {
+  std::vector<OpTraceEntry> entries;
+  std::vector<uint32_t> order;
+  std::vector<OpTraceSpan> roots;
+};
+
 const char *SketchPrimitiveKindName(SketchPrimitiveKind kind);
 
 }  // namespace vicad
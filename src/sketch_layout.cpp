@@ -0,0 +1,304 @@
+#include "sketch_layout.h"
+
+#include <cmath>
+
+#include "scene_object.h"
+
+namespace vicad {
+
+using vicad_app::Vec2;
+using vicad_app::Vec3;
+using vicad_app::add;
+using vicad_app::add2;
+using vicad_app::cross;
+using vicad_app::dot;
+using vicad_app::dot2;
+using vicad_app::length2;
+using vicad_app::mul2;
+using vicad_app::normalize;
+using vicad_app::normalize2;
+using vicad_app::sub;
+using vicad_app::sub2v;
+
+namespace {
+
+Vec3 to_vec3(const SceneVec3 &p) { return {p.x, p.y, p.z}; }
+
+void contour_plane_axes(const ScriptSketchContour &contour, Vec3 *out_right, Vec3 *out_up, Vec3 *out_normal) {
+  Vec3 right = {1.0f, 0.0f, 0.0f};
+  Vec3 up = {0.0f, 1.0f, 0.0f};
+  Vec3 normal = {0.0f, 0.0f, 1.0f};
+  if (contour.points.size() >= 2) {
+    const Vec3 p0 = to_vec3(contour.points[0]);
+    bool found_right = false;
+    for (size_t i = 1; i < contour.points.size(); ++i) {
+      const Vec3 e = sub(to_vec3(contour.points[i]), p0);
+      if (dot(e, e) > 1e-10f) {
+        right = normalize(e);
+        found_right = true;
+        break;
+      }
+    }
+    if (found_right) {
+      bool found_normal = false;
+      for (size_t i = 1; i < contour.points.size(); ++i) {
+        const Vec3 e = sub(to_vec3(contour.points[i]), p0);
+        const Vec3 n = cross(right, e);
+        if (dot(n, n) > 1e-10f) {
+          normal = normalize(n);
+          found_normal = true;
+          break;
+        }
+      }
+      if (!found_normal) {
+        const Vec3 fallback_up = std::fabs(right.z) < 0.95f ? Vec3{0.0f, 0.0f, 1.0f} : Vec3{0.0f, 1.0f, 0.0f};
+        normal = normalize(cross(right, fallback_up));
+      }
+      up = normalize(cross(normal, right));
+    }
+  }
+  *out_right = right;
+  *out_up = up;
+  *out_normal = normal;
+}
+
+float contour_signed_area(const std::vector<Vec2> &pts) {
+  const size_t n = pts.size();
+  if (n < 3) return 0.0f;
+  double a = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    const Vec2 &p0 = pts[i];
+    const Vec2 &p1 = pts[(i + 1) % n];
+    a += (double)p0.x * (double)p1.y - (double)p1.x * (double)p0.y;
+  }
+  return (float)(0.5 * a);
+}
+
+float contour_projected_area3d(const ScriptSketchContour &contour) {
+  const size_t n = contour.points.size();
+  if (n < 3) return 0.0f;
+  Vec3 area_vec = {0.0f, 0.0f, 0.0f};
+  for (size_t i = 0; i < n; ++i) {
+    area_vec = add(area_vec, cross(to_vec3(contour.points[i]), to_vec3(contour.points[(i + 1) % n])));
+  }
+  return 0.5f * std::sqrt(dot(area_vec, area_vec));
+}
+
+void contour_bbox(const std::vector<Vec2> &pts, Vec2 *mn, Vec2 *mx) {
+  Vec2 bmin = {0.0f, 0.0f};
+  Vec2 bmax = {0.0f, 0.0f};
+  if (!pts.empty()) {
+    bmin = pts[0];
+    bmax = pts[0];
+    for (size_t i = 1; i < pts.size(); ++i) {
+      const Vec2 &p = pts[i];
+      if (p.x < bmin.x) bmin.x = p.x;
+      if (p.y < bmin.y) bmin.y = p.y;
+      if (p.x > bmax.x) bmax.x = p.x;
+      if (p.y > bmax.y) bmax.y = p.y;
+    }
+  }
+  *mn = bmin;
+  *mx = bmax;
+}
+
+Vec2 contour_centroid_mean(const std::vector<Vec2> &pts) {
+  if (pts.empty()) return {0.0f, 0.0f};
+  Vec2 c = {0.0f, 0.0f};
+  for (const Vec2 &p : pts) c = add2(c, p);
+  return mul2(c, 1.0f / (float)pts.size());
+}
+
+bool classify_rectangle_like(const std::vector<Vec2> &pts, float *out_w, float *out_h) {
+  if (pts.size() != 4) return false;
+  const Vec2 e0 = sub2v(pts[1], pts[0]);
+  const Vec2 e1 = sub2v(pts[2], pts[1]);
+  const Vec2 e2 = sub2v(pts[3], pts[2]);
+  const Vec2 e3 = sub2v(pts[0], pts[3]);
+  const float l0 = length2(e0);
+  const float l1 = length2(e1);
+  const float l2 = length2(e2);
+  const float l3 = length2(e3);
+  if (l0 <= 1e-6f || l1 <= 1e-6f || l2 <= 1e-6f || l3 <= 1e-6f) return false;
+  const float orth = std::fabs(dot2(normalize2(e0), normalize2(e1)));
+  const float opp0 = std::fabs(l0 - l2) / ((l0 > l2) ? l0 : l2);
+  const float opp1 = std::fabs(l1 - l3) / ((l1 > l3) ? l1 : l3);
+  if (orth > 0.05f || opp0 > 0.05f || opp1 > 0.05f) return false;
+  *out_w = l0;
+  *out_h = l1;
+  return true;
+}
+
+// Mean centroid and mean radius, with the largest relative radius deviation.
+bool radial_fit(const std::vector<Vec2> &pts, Vec2 *out_center, float *out_radius, double *out_max_rel) {
+  const Vec2 c = contour_centroid_mean(pts);
+  double sum_r = 0.0;
+  std::vector<float> rs;
+  rs.reserve(pts.size());
+  for (const Vec2 &p : pts) {
+    const float r = length2(sub2v(p, c));
+    rs.push_back(r);
+    sum_r += (double)r;
+  }
+  const float mean_r = (float)(sum_r / (double)pts.size());
+  if (mean_r <= 1e-6f) return false;
+  double max_dev = 0.0;
+  for (float r : rs) {
+    const double d = std::fabs((double)r - (double)mean_r);
+    if (d > max_dev) max_dev = d;
+  }
+  *out_center = c;
+  *out_radius = mean_r;
+  *out_max_rel = max_dev / (double)mean_r;
+  return true;
+}
+
+bool classify_circle_like(const std::vector<Vec2> &pts, Vec2 *out_center, float *out_radius) {
+  if (pts.size() < 12) return false;
+  Vec2 c = {0.0f, 0.0f};
+  float r = 0.0f;
+  double rel = 0.0;
+  if (!radial_fit(pts, &c, &r, &rel) || rel > 0.03) return false;
+  *out_center = c;
+  *out_radius = r;
+  return true;
+}
+
+bool classify_rounded_rectangle_like(const std::vector<Vec2> &pts, float *out_w, float *out_h) {
+  const size_t n = pts.size();
+  if (n < 8) return false;
+
+  Vec2 bmin = {0.0f, 0.0f};
+  Vec2 bmax = {0.0f, 0.0f};
+  contour_bbox(pts, &bmin, &bmax);
+  const float bw = bmax.x - bmin.x;
+  const float bh = bmax.y - bmin.y;
+  if (bw <= 1e-5f || bh <= 1e-5f) return false;
+
+  const float max_dim = (bw > bh) ? bw : bh;
+  const float side_tol = max_dim * 0.02f + 1e-4f;
+
+  bool touch_left = false;
+  bool touch_right = false;
+  bool touch_bottom = false;
+  bool touch_top = false;
+  for (const Vec2 &p : pts) {
+    if (std::fabs(p.x - bmin.x) <= side_tol) touch_left = true;
+    if (std::fabs(p.x - bmax.x) <= side_tol) touch_right = true;
+    if (std::fabs(p.y - bmin.y) <= side_tol) touch_bottom = true;
+    if (std::fabs(p.y - bmax.y) <= side_tol) touch_top = true;
+  }
+  if (!touch_left || !touch_right || !touch_bottom || !touch_top) return false;
+
+  // Rounded rectangles keep a meaningful amount of axis-aligned edge length.
+  double total_len = 0.0;
+  double axis_len = 0.0;
+  for (size_t i = 0; i < n; ++i) {
+    const Vec2 e = sub2v(pts[(i + 1) % n], pts[i]);
+    const float len = length2(e);
+    if (len <= 1e-6f) continue;
+    total_len += (double)len;
+    const float axis_score = std::fmax(std::fabs(e.x / len), std::fabs(e.y / len));
+    if (axis_score >= 0.9659f) axis_len += (double)len;  // ~15 degrees from axis
+  }
+  if (total_len <= 1e-8) return false;
+  if (axis_len / total_len < 0.18) return false;
+
+  *out_w = bw;
+  *out_h = bh;
+  return true;
+}
+
+bool classify_regular_polygon_like(const std::vector<Vec2> &pts, Vec2 *out_center, float *out_radius,
+                                   float *out_side) {
+  const size_t n = pts.size();
+  if (n < 3 || n > 16) return false;
+  Vec2 c = {0.0f, 0.0f};
+  float mean_r = 0.0f;
+  double max_rel_r = 0.0;
+  if (!radial_fit(pts, &c, &mean_r, &max_rel_r) || max_rel_r > 0.03) return false;
+
+  std::vector<float> edge_lengths;
+  edge_lengths.reserve(n);
+  for (size_t i = 0; i < n; ++i) edge_lengths.push_back(length2(sub2v(pts[(i + 1) % n], pts[i])));
+  float mean_e = 0.0f;
+  for (float e : edge_lengths) mean_e += e;
+  mean_e /= (float)n;
+  if (mean_e <= 1e-6f) return false;
+  double max_rel_e = 0.0;
+  for (float e : edge_lengths) {
+    const double rel = std::fabs((double)e - (double)mean_e) / (double)mean_e;
+    if (rel > max_rel_e) max_rel_e = rel;
+  }
+  if (max_rel_e > 0.04) return false;
+  *out_center = c;
+  *out_radius = mean_r;
+  *out_side = mean_e;
+  return true;
+}
+
+}  // namespace
+
+SketchDimLayout BuildSketchDimLayout(const std::vector<ScriptSketchContour> &contours,
+                                     const SketchDimensionModel *model) {
+  SketchDimLayout out;
+  if (model) {
+    if (!contours.empty() && !contours.front().points.empty()) out.modelZ = contours.front().points.front().z;
+    out.modelCentroid = {(float)model->anchor.x, (float)model->anchor.y};
+    if (!model->logicalVertices.empty()) {
+      std::vector<Vec2> pts;
+      pts.reserve(model->logicalVertices.size());
+      for (const manifold::vec2 &p : model->logicalVertices) pts.push_back({(float)p.x, (float)p.y});
+      out.modelCentroid = contour_centroid_mean(pts);
+    }
+    return out;
+  }
+
+  float largest_area = -1.0f;
+  for (size_t i = 0; i < contours.size(); ++i) {
+    const float a = contour_projected_area3d(contours[i]);
+    if (a > largest_area) {
+      largest_area = a;
+      out.contour = i;
+    }
+  }
+  if (out.contour >= contours.size()) return out;
+  const ScriptSketchContour &contour = contours[out.contour];
+  if (contour.points.size() < 2) return out;
+
+  contour_plane_axes(contour, &out.right, &out.up, &out.normal);
+  out.origin = to_vec3(contour.points.front());
+  out.points.reserve(contour.points.size());
+  for (const SceneVec3 &p : contour.points) {
+    const Vec3 d = sub(to_vec3(p), out.origin);
+    out.points.push_back({dot(d, out.right), dot(d, out.up)});
+  }
+  const std::vector<Vec2> &pts = out.points;
+  out.centroid = contour_centroid_mean(pts);
+  Vec2 bmin = {0.0f, 0.0f};
+  Vec2 bmax = {0.0f, 0.0f};
+  contour_bbox(pts, &bmin, &bmax);
+  const float bw = bmax.x - bmin.x;
+  const float bh = bmax.y - bmin.y;
+  out.diagonal = std::sqrt(bw * bw + bh * bh);
+
+  if (classify_rectangle_like(pts, &out.rectWidth, &out.rectHeight) ||
+      classify_rounded_rectangle_like(pts, &out.rectWidth, &out.rectHeight)) {
+    const float maxv = out.rectWidth > out.rectHeight ? out.rectWidth : out.rectHeight;
+    const float minv = out.rectWidth > out.rectHeight ? out.rectHeight : out.rectWidth;
+    out.shape = (maxv > 1e-6f && std::fabs(maxv - minv) / maxv < 0.02f) ? SketchDimShape::Square
+                                                                        : SketchDimShape::Rectangle;
+  } else if (classify_circle_like(pts, &out.center, &out.radius)) {
+    out.shape = out.radius <= 0.2f ? SketchDimShape::Point : SketchDimShape::Circle;
+  } else if (classify_regular_polygon_like(pts, &out.center, &out.radius, &out.side)) {
+    out.shape = SketchDimShape::RegularPolygon;
+  } else {
+    out.shape = SketchDimShape::Polygon;
+    const size_t n = pts.size();
+    for (size_t i = 0; i < n; ++i) out.perimeter += length2(sub2v(pts[(i + 1) % n], pts[i]));
+    out.area = std::fabs(contour_signed_area(pts));
+  }
+  return out;
+}
+
+}  // namespace vicad
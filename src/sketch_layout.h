@@ -0,0 +1,57 @@
+#ifndef VICAD_SKETCH_LAYOUT_H_
+#define VICAD_SKETCH_LAYOUT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "app_state.h"
+#include "sketch_dimensions.h"
+
+namespace vicad {
+
+struct ScriptSketchContour;
+
+enum class SketchDimShape : uint8_t {
+  Polygon = 0,
+  Point = 1,
+  Circle = 2,
+  Rectangle = 3,
+  Square = 4,
+  RegularPolygon = 5,
+};
+
+// The camera-independent part of a sketch's dimension overlay, worked out
+// once per decoded object. Without a dimension model, the largest contour is
+// dimensioned by the shape it reads as, in a plane frame fitted to it;
+// with one, only the model's plane height and centroid are needed. Label
+// placement and sizing follow the camera and stay in the draw.
+struct SketchDimLayout {
+  size_t contour = 0;  // index of the largest contour by projected area
+  SketchDimShape shape = SketchDimShape::Polygon;
+  vicad_app::Vec3 origin = {0.0f, 0.0f, 0.0f};
+  vicad_app::Vec3 right = {1.0f, 0.0f, 0.0f};
+  vicad_app::Vec3 up = {0.0f, 1.0f, 0.0f};
+  vicad_app::Vec3 normal = {0.0f, 0.0f, 1.0f};
+  std::vector<vicad_app::Vec2> points;  // the contour in (right, up) about origin
+  vicad_app::Vec2 centroid = {0.0f, 0.0f};
+  float diagonal = 0.0f;  // of the plane-local bounding box
+  float rectWidth = 0.0f;
+  float rectHeight = 0.0f;
+  vicad_app::Vec2 center = {0.0f, 0.0f};  // circle or regular polygon
+  float radius = 0.0f;
+  float side = 0.0f;
+  float perimeter = 0.0f;
+  float area = 0.0f;
+
+  float modelZ = 0.0f;
+  vicad_app::Vec2 modelCentroid = {0.0f, 0.0f};
+};
+
+// `model` is the sketch's dimension model when it has one, else null.
+SketchDimLayout BuildSketchDimLayout(const std::vector<ScriptSketchContour> &contours,
+                                     const SketchDimensionModel *model);
+
+}  // namespace vicad
+
+#endif  // VICAD_SKETCH_LAYOUT_H_
@@ -3,7 +3,10 @@
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <optional>
+#include <span>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -124,35 +127,39 @@ struct EvalSketchNode {
   double fillet_radius_max = 0.0;
 };
 
-bool eval_sketch_node(const ReplayTables &tables,
-                      uint32_t id,
-                      EvalSketchNode *out,
-                      std::unordered_set<uint32_t> *visiting,
-                      std::string *error) {
-  if ((size_t)id >= tables.node_semantics.size() || !tables.node_semantics[id].valid) {
-    *error = "Replay failed: missing semantic node " + std::to_string(id);
-    return false;
-  }
-  if (visiting->find(id) != visiting->end()) {
-    *error = "Replay failed: cyclic semantic node graph.";
-    return false;
-  }
+// Evaluated sketch nodes of one set of replay tables by node id, so roots
+// that share a subtree evaluate it once. Map nodes keep their address, so
+// callers hold pointers into `done`.
+struct SketchEvalMemo {
+  std::unordered_map<uint32_t, EvalSketchNode> done;
+  std::unordered_set<uint32_t> active;
+};
 
+bool eval_sketch_node(const ReplayTables &tables, uint32_t id, SketchEvalMemo *memo,
+                      const EvalSketchNode **out, std::string *error);
+
+// Evaluates node `id` itself; its inputs go through the memo.
+bool eval_sketch_op(const ReplayTables &tables,
+                    uint32_t id,
+                    SketchEvalMemo *memo,
+                    EvalSketchNode *out,
+                    std::string *error) {
   const ReplayNodeSemantic &node = tables.node_semantics[id];
-  visiting->insert(id);
+  const auto inputs = ReplaySemanticInputs(tables, node);
+  const auto params_f64 = ReplaySemanticF64(tables, node);
+  const auto params_u32 = ReplaySemanticU32(tables, node);
   EvalSketchNode res;
 
   switch ((OpCode)node.opcode) {
     case OpCode::CrossRect:
     case OpCode::CrossSquare: {
-      if (node.params_f64.size() < 2 || node.params_u32.empty()) {
+      if (params_f64.size() < 2 || params_u32.empty()) {
         *error = "Replay failed: malformed rect semantic node.";
-        visiting->erase(id);
         return false;
       }
-      const double w = std::fabs(node.params_f64[0]);
-      const double h = std::fabs(node.params_f64[1]);
-      const bool centered = (node.params_u32[0] != 0);
+      const double w = std::fabs(params_f64[0]);
+      const double h = std::fabs(params_f64[1]);
+      const bool centered = (params_u32[0] != 0);
       res.ok = true;
       res.primitive = SketchPrimitiveKind::Rect;
       res.vertices = rectangle_vertices(w, h, centered);
@@ -162,14 +169,14 @@ bool eval_sketch_node(const ReplayTables &tables,
       res.anchor = centered ? manifold::vec2(0.0, 0.0) : manifold::vec2(w * 0.5, h * 0.5);
     } break;
     case OpCode::CrossPolygons: {
-      if (!node.has_polygons || node.polygons.empty()) {
+      const manifold::Polygons polygons = ReplaySemanticPolygons(tables, node);
+      if (polygons.empty()) {
         *error = "Replay failed: malformed cross polygon semantic node.";
-        visiting->erase(id);
         return false;
       }
       const manifold::SimplePolygon *best = nullptr;
       double best_area = -1.0;
-      for (const manifold::SimplePolygon &poly : node.polygons) {
+      for (const manifold::SimplePolygon &poly : polygons) {
         std::vector<manifold::vec2> tmp(poly.begin(), poly.end());
         const double a = std::fabs(polygon_area(tmp));
         if (a > best_area) {
@@ -179,7 +186,6 @@ bool eval_sketch_node(const ReplayTables &tables,
       }
       if (!best || best->size() < 3) {
         *error = "Replay failed: missing polygon shell for sketch dimensions.";
-        visiting->erase(id);
         return false;
       }
       res.ok = true;
@@ -197,28 +203,26 @@ bool eval_sketch_node(const ReplayTables &tables,
       }
     } break;
     case OpCode::CrossCircle: {
-      if (node.params_f64.empty()) {
+      if (params_f64.empty()) {
         *error = "Replay failed: malformed circle semantic node.";
-        visiting->erase(id);
         return false;
       }
       res.ok = true;
       res.primitive = SketchPrimitiveKind::Circle;
       res.anchor = manifold::vec2(0.0, 0.0);
       res.has_circle = true;
-      res.circle_r = std::fabs(node.params_f64[0]);
+      res.circle_r = std::fabs(params_f64[0]);
     } break;
     case OpCode::CrossPoint: {
-      if (node.params_f64.size() < 3) {
+      if (params_f64.size() < 3) {
         *error = "Replay failed: malformed point semantic node.";
-        visiting->erase(id);
         return false;
       }
       res.ok = true;
       res.primitive = SketchPrimitiveKind::Point;
-      res.anchor = manifold::vec2(node.params_f64[0], node.params_f64[1]);
+      res.anchor = manifold::vec2(params_f64[0], params_f64[1]);
       res.has_circle = true;
-      res.circle_r = std::fabs(node.params_f64[2]);
+      res.circle_r = std::fabs(params_f64[2]);
     } break;
     case OpCode::CrossTranslate:
     case OpCode::CrossRotate:
@@ -226,57 +230,49 @@ bool eval_sketch_node(const ReplayTables &tables,
     case OpCode::CrossFilletCorners:
     case OpCode::CrossOffsetClone:
     case OpCode::CrossPlane: {
-      if (node.inputs.empty()) {
+      if (inputs.empty()) {
         *error = "Replay failed: malformed cross transform semantic node.";
-        visiting->erase(id);
-        return false;
-      }
-      EvalSketchNode base;
-      if (!eval_sketch_node(tables, node.inputs[0], &base, visiting, error)) {
-        visiting->erase(id);
         return false;
       }
-      res = base;
+      const EvalSketchNode *base = nullptr;
+      if (!eval_sketch_node(tables, inputs[0], memo, &base, error)) return false;
+      res = *base;
 
       if ((OpCode)node.opcode == OpCode::CrossTranslate) {
-        if (node.params_f64.size() < 2) {
+        if (params_f64.size() < 2) {
           *error = "Replay failed: malformed cross translate semantic node.";
-          visiting->erase(id);
           return false;
         }
-        const Affine2 t = translation2(node.params_f64[0], node.params_f64[1]);
+        const Affine2 t = translation2(params_f64[0], params_f64[1]);
         for (manifold::vec2 &p : res.vertices) p = apply_affine(t, p);
         res.anchor = apply_affine(t, res.anchor);
       } else if ((OpCode)node.opcode == OpCode::CrossRotate) {
-        if (node.params_f64.empty()) {
+        if (params_f64.empty()) {
           *error = "Replay failed: malformed cross rotate semantic node.";
-          visiting->erase(id);
           return false;
         }
-        const Affine2 t = rotation2(node.params_f64[0]);
+        const Affine2 t = rotation2(params_f64[0]);
         for (manifold::vec2 &p : res.vertices) p = apply_affine(t, p);
         res.anchor = apply_affine(t, res.anchor);
       } else if ((OpCode)node.opcode == OpCode::CrossFillet) {
-        if (node.params_f64.empty()) {
+        if (params_f64.empty()) {
           *error = "Replay failed: malformed cross fillet semantic node.";
-          visiting->erase(id);
           return false;
         }
         res.has_fillet = true;
-        res.fillet_radius = std::fabs(node.params_f64[0]);
+        res.fillet_radius = std::fabs(params_f64[0]);
         res.fillet_radius_min = res.fillet_radius;
         res.fillet_radius_max = res.fillet_radius;
       } else if ((OpCode)node.opcode == OpCode::CrossFilletCorners) {
-        if (node.params_f64.empty()) {
+        if (params_f64.empty()) {
           *error = "Replay failed: malformed cross fillet corners semantic node.";
-          visiting->erase(id);
           return false;
         }
         res.has_fillet = true;
-        res.fillet_count = (uint32_t)node.params_f64.size();
+        res.fillet_count = (uint32_t)params_f64.size();
         res.fillet_radius_min = std::numeric_limits<double>::infinity();
         res.fillet_radius_max = 0.0;
-        for (double r : node.params_f64) {
+        for (double r : params_f64) {
           const double rr = std::fabs(r);
           if (rr < res.fillet_radius_min) res.fillet_radius_min = rr;
           if (rr > res.fillet_radius_max) res.fillet_radius_max = rr;
@@ -297,31 +293,46 @@ bool eval_sketch_node(const ReplayTables &tables,
       break;
   }
 
-  visiting->erase(id);
   *out = std::move(res);
   return true;
 }
 
-}  // namespace
-
-bool BuildSketchDimensionModelForRoot(const ReplayTables &tables, uint32_t root_id,
-                                      SketchDimensionModel *out, std::string *error) {
-  if (!out) {
-    if (error) *error = "Replay failed: null output model.";
+bool eval_sketch_node(const ReplayTables &tables, uint32_t id, SketchEvalMemo *memo,
+                      const EvalSketchNode **out, std::string *error) {
+  if ((size_t)id >= tables.node_semantics.size() || !tables.node_semantics[id].valid) {
+    *error = "Replay failed: missing semantic node " + std::to_string(id);
     return false;
   }
-  if ((size_t)root_id >= tables.cross_nodes.size() || !tables.has_cross[root_id]) {
+  auto it = memo->done.find(id);
+  if (it == memo->done.end()) {
+    if (!memo->active.insert(id).second) {
+      *error = "Replay failed: cyclic semantic node graph.";
+      return false;
+    }
+    EvalSketchNode res;
+    const bool ok = eval_sketch_op(tables, id, memo, &res, error);
+    memo->active.erase(id);
+    if (!ok) return false;
+    it = memo->done.emplace(id, std::move(res)).first;
+  }
+  *out = &it->second;
+  return true;
+}
+
+bool build_dimension_model(const ReplayTables &tables, uint32_t root_id, SketchEvalMemo *memo,
+                           SketchDimensionModel *out, std::string *error) {
+  if (!ReplayNodeIs(tables, root_id, NodeKind::CrossSection)) {
     if (error) *error = "Replay failed: root cross-section node missing.";
     return false;
   }
 
-  std::unordered_set<uint32_t> visiting;
-  EvalSketchNode node;
+  const EvalSketchNode *evaluated = nullptr;
   std::string local_err;
-  if (!eval_sketch_node(tables, root_id, &node, &visiting, &local_err)) {
+  if (!eval_sketch_node(tables, root_id, memo, &evaluated, &local_err)) {
     if (error) *error = local_err;
     return false;
   }
+  const EvalSketchNode &node = *evaluated;
   if (node.fallback_only) {
     if (error) *error = "Sketch semantic model requires contour fallback for this operation chain.";
     return false;
@@ -374,4 +385,26 @@ bool BuildSketchDimensionModelForRoot(const ReplayTables &tables, uint32_t root_
   return true;
 }
 
+}  // namespace
+
+bool BuildSketchDimensionModelForRoot(const ReplayTables &tables, uint32_t root_id,
+                                      SketchDimensionModel *out, std::string *error) {
+  if (!out) {
+    if (error) *error = "Replay failed: null output model.";
+    return false;
+  }
+  SketchEvalMemo memo;
+  return build_dimension_model(tables, root_id, &memo, out, error);
+}
+
+void BuildSketchDimensionModels(const ReplayTables &tables, std::span<const uint32_t> root_ids,
+                                std::vector<std::optional<SketchDimensionModel>> *out) {
+  SketchEvalMemo memo;
+  out->assign(root_ids.size(), std::nullopt);
+  for (size_t i = 0; i < root_ids.size(); ++i) {
+    SketchDimensionModel model;
+    if (build_dimension_model(tables, root_ids[i], &memo, &model, nullptr)) (*out)[i] = std::move(model);
+  }
+}
+
 }  // namespace vicad
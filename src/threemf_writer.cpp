@@ -0,0 +1,277 @@
+#include "threemf_writer.h"
+
+#include <array>
+#include <utility>
+
+namespace vicad {
+
+namespace {
+
+constexpr size_t kFlushBytes = 1u << 20;
+constexpr uint64_t kZipLimit = 0xFFFFFFFFull;
+// DOS timestamp 1980-01-01 00:00; packages are reproducible byte for byte.
+constexpr uint16_t kZipTime = 0;
+constexpr uint16_t kZipDate = (1u << 5) | 1u;
+
+const char kContentTypes[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<Types xmlns=\"http://schemas.openxmlformats.org/package/2006/content-types\">"
+    "<Default Extension=\"rels\" ContentType=\"application/vnd.openxmlformats-package.relationships+xml\"/>"
+    "<Default Extension=\"model\" ContentType=\"application/vnd.ms-package.3dmanufacturing-3dmodel+xml\"/>"
+    "</Types>\n";
+
+const char kRels[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<Relationships xmlns=\"http://schemas.openxmlformats.org/package/2006/relationships\">"
+    "<Relationship Target=\"/3D/3dmodel.model\" Id=\"rel0\" "
+    "Type=\"http://schemas.microsoft.com/3dmanufacturing/2013/01/3dmodel\"/>"
+    "</Relationships>\n";
+
+const char kModelHeader[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<model unit=\"millimeter\" xml:lang=\"en-US\" "
+    "xmlns=\"http://schemas.microsoft.com/3dmanufacturing/core/2015/02\">\n"
+    "<resources>\n";
+
+const std::array<uint32_t, 256> &crc_table() {
+  static const std::array<uint32_t, 256> table = [] {
+    std::array<uint32_t, 256> t = {};
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) c = (c & 1u) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+      t[i] = c;
+    }
+    return t;
+  }();
+  return table;
+}
+
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len) {
+  const std::array<uint32_t, 256> &table = crc_table();
+  const uint8_t *p = (const uint8_t *)data;
+  crc = ~crc;
+  for (size_t i = 0; i < len; ++i) crc = table[(crc ^ p[i]) & 0xFFu] ^ (crc >> 8);
+  return ~crc;
+}
+
+void put_u16(std::string *out, uint16_t v) {
+  out->push_back((char)(v & 0xFFu));
+  out->push_back((char)(v >> 8));
+}
+
+void put_u32(std::string *out, uint32_t v) {
+  for (int i = 0; i < 4; ++i) out->push_back((char)((v >> (8 * i)) & 0xFFu));
+}
+
+void append_escaped(std::string *out, const std::string &text) {
+  for (char c : text) {
+    switch (c) {
+      case '&': *out += "&amp;"; break;
+      case '<': *out += "&lt;"; break;
+      case '>': *out += "&gt;"; break;
+      case '"': *out += "&quot;"; break;
+      case '\'': *out += "&apos;"; break;
+      default: out->push_back(c); break;
+    }
+  }
+}
+
+}  // namespace
+
+ThreeMfWriter::~ThreeMfWriter() { Abort(); }
+
+bool ThreeMfWriter::Open(const std::string &path, std::string *error) {
+  Abort();
+  file_ = std::fopen(path.c_str(), "wb");
+  if (!file_) {
+    if (error) *error = "Failed to open " + path + " for writing.";
+    return false;
+  }
+  entries_.clear();
+  object_ids_.clear();
+  offset_ = 0;
+  buffer_.clear();
+  buffer_.reserve(kFlushBytes + 4096);
+  if (!write_entry("[Content_Types].xml", kContentTypes, error) ||
+      !write_entry("_rels/.rels", kRels, error) ||
+      !begin_entry("3D/3dmodel.model", error)) {
+    Abort();
+    return false;
+  }
+  append(kModelHeader);
+  return true;
+}
+
+bool ThreeMfWriter::WriteObject(const std::string &name, const manifold::MeshGL &mesh, std::string *error) {
+  if (!file_ || !in_entry_) {
+    if (error) *error = "3MF writer is not open.";
+    return false;
+  }
+  if (mesh.numProp < 3 || mesh.NumVert() == 0 || mesh.NumTri() == 0) return true;
+  const uint32_t id = (uint32_t)object_ids_.size() + 1;
+  char line[160];
+  std::snprintf(line, sizeof(line), "<object id=\"%u\" type=\"model\" name=\"", id);
+  append(line);
+  append_escaped(&buffer_, name);
+  append("\">\n<mesh>\n<vertices>\n");
+  for (size_t v = 0; v < mesh.NumVert(); ++v) {
+    const float *p = &mesh.vertProperties[v * mesh.numProp];
+    std::snprintf(line, sizeof(line), "<vertex x=\"%.9g\" y=\"%.9g\" z=\"%.9g\"/>\n", p[0], p[1], p[2]);
+    append(line);
+    if (buffer_.size() >= kFlushBytes && !flush(error)) return false;
+  }
+  append("</vertices>\n<triangles>\n");
+  for (size_t t = 0; t < mesh.NumTri(); ++t) {
+    std::snprintf(line, sizeof(line), "<triangle v1=\"%u\" v2=\"%u\" v3=\"%u\"/>\n",
+                  mesh.triVerts[t * 3 + 0], mesh.triVerts[t * 3 + 1], mesh.triVerts[t * 3 + 2]);
+    append(line);
+    if (buffer_.size() >= kFlushBytes && !flush(error)) return false;
+  }
+  append("</triangles>\n</mesh>\n</object>\n");
+  object_ids_.push_back(id);
+  return flush(error);
+}
+
+bool ThreeMfWriter::Finish(std::string *error) {
+  if (!file_ || !in_entry_) {
+    if (error) *error = "3MF writer is not open.";
+    return false;
+  }
+  append("</resources>\n<build>\n");
+  char line[64];
+  for (uint32_t id : object_ids_) {
+    std::snprintf(line, sizeof(line), "<item objectid=\"%u\"/>\n", id);
+    append(line);
+  }
+  append("</build>\n</model>\n");
+  if (!end_entry(error)) return false;
+
+  std::string dir;
+  for (const Entry &e : entries_) {
+    put_u32(&dir, 0x02014b50u);
+    put_u16(&dir, 20);  // version made by
+    put_u16(&dir, 20);  // version needed
+    put_u16(&dir, 0);   // flags
+    put_u16(&dir, 0);   // stored
+    put_u16(&dir, kZipTime);
+    put_u16(&dir, kZipDate);
+    put_u32(&dir, e.crc);
+    put_u32(&dir, e.size);
+    put_u32(&dir, e.size);
+    put_u16(&dir, (uint16_t)e.name.size());
+    put_u16(&dir, 0);  // extra
+    put_u16(&dir, 0);  // comment
+    put_u16(&dir, 0);  // disk
+    put_u16(&dir, 0);  // internal attributes
+    put_u32(&dir, 0);  // external attributes
+    put_u32(&dir, e.header_offset);
+    dir += e.name;
+  }
+  const uint64_t dir_offset = offset_;
+  std::string end;
+  put_u32(&end, 0x06054b50u);
+  put_u16(&end, 0);
+  put_u16(&end, 0);
+  put_u16(&end, (uint16_t)entries_.size());
+  put_u16(&end, (uint16_t)entries_.size());
+  put_u32(&end, (uint32_t)dir.size());
+  put_u32(&end, (uint32_t)dir_offset);
+  put_u16(&end, 0);
+  if (!write_raw(dir.data(), dir.size(), error) || !write_raw(end.data(), end.size(), error)) return false;
+  if (offset_ > kZipLimit) {
+    if (error) *error = "3MF package exceeds 4 GiB.";
+    return false;
+  }
+  const bool closed = std::fclose(file_) == 0;
+  file_ = nullptr;
+  if (!closed && error) *error = "Failed to close the 3MF file.";
+  return closed;
+}
+
+void ThreeMfWriter::Abort() {
+  if (file_) std::fclose(file_);
+  file_ = nullptr;
+  in_entry_ = false;
+  buffer_.clear();
+}
+
+bool ThreeMfWriter::begin_entry(const char *name, std::string *error) {
+  if (offset_ > kZipLimit) {
+    if (error) *error = "3MF package exceeds 4 GiB.";
+    return false;
+  }
+  Entry e;
+  e.name = name;
+  e.header_offset = (uint32_t)offset_;
+  std::string header;
+  put_u32(&header, 0x04034b50u);
+  put_u16(&header, 20);  // version needed
+  put_u16(&header, 0);   // flags
+  put_u16(&header, 0);   // stored
+  put_u16(&header, kZipTime);
+  put_u16(&header, kZipDate);
+  put_u32(&header, 0);  // crc, patched by end_entry
+  put_u32(&header, 0);  // compressed size
+  put_u32(&header, 0);  // uncompressed size
+  put_u16(&header, (uint16_t)e.name.size());
+  put_u16(&header, 0);
+  header += e.name;
+  if (!write_raw(header.data(), header.size(), error)) return false;
+  entries_.push_back(std::move(e));
+  in_entry_ = true;
+  return true;
+}
+
+bool ThreeMfWriter::end_entry(std::string *error) {
+  if (!flush(error)) return false;
+  in_entry_ = false;
+  const Entry &e = entries_.back();
+  std::string patch;
+  put_u32(&patch, e.crc);
+  put_u32(&patch, e.size);
+  put_u32(&patch, e.size);
+  // The crc field sits 14 bytes into the local header.
+  if (std::fseek(file_, (long)e.header_offset + 14, SEEK_SET) != 0 ||
+      std::fwrite(patch.data(), 1, patch.size(), file_) != patch.size() ||
+      std::fseek(file_, 0, SEEK_END) != 0) {
+    if (error) *error = "Failed to finalize 3MF entry " + e.name + ".";
+    return false;
+  }
+  return true;
+}
+
+bool ThreeMfWriter::write_entry(const char *name, const std::string &body, std::string *error) {
+  if (!begin_entry(name, error)) return false;
+  append(body);
+  return end_entry(error);
+}
+
+void ThreeMfWriter::append(const char *text) { buffer_ += text; }
+
+void ThreeMfWriter::append(const std::string &text) { buffer_ += text; }
+
+bool ThreeMfWriter::flush(std::string *error) {
+  if (buffer_.empty()) return true;
+  Entry &e = entries_.back();
+  const uint64_t next_size = (uint64_t)e.size + buffer_.size();
+  if (next_size > kZipLimit) {
+    if (error) *error = "3MF model part exceeds 4 GiB.";
+    return false;
+  }
+  e.crc = crc32_update(e.crc, buffer_.data(), buffer_.size());
+  e.size = (uint32_t)next_size;
+  if (!write_raw(buffer_.data(), buffer_.size(), error)) return false;
+  buffer_.clear();
+  return true;
+}
+
+bool ThreeMfWriter::write_raw(const void *data, size_t len, std::string *error) {
+  if (std::fwrite(data, 1, len, file_) != len) {
+    if (error) *error = "Failed to write the 3MF file.";
+    return false;
+  }
+  offset_ += len;
+  return true;
+}
+
+}  // namespace vicad
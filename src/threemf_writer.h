@@ -0,0 +1,63 @@
+#ifndef VICAD_THREEMF_WRITER_H_
+#define VICAD_THREEMF_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "manifold/manifold.h"
+
+namespace vicad {
+
+// Streams a 3MF package (a zip of the model XML plus its two package parts)
+// straight to disk, one object at a time, so exporting never holds more than
+// the object being written and a small output buffer. Entries are stored
+// uncompressed; each local header is patched with its CRC and size once the
+// entry is complete. Packages must stay under 4 GiB (no zip64).
+class ThreeMfWriter {
+ public:
+  ThreeMfWriter() = default;
+  ~ThreeMfWriter();
+
+  ThreeMfWriter(const ThreeMfWriter &) = delete;
+  ThreeMfWriter &operator=(const ThreeMfWriter &) = delete;
+
+  bool Open(const std::string &path, std::string *error);
+  // Appends one mesh object and its build item. Empty meshes are skipped.
+  bool WriteObject(const std::string &name, const manifold::MeshGL &mesh, std::string *error);
+  // Writes the build, closes the model part and the zip directory.
+  bool Finish(std::string *error);
+  // Closes without finishing; the file is left incomplete.
+  void Abort();
+
+  uint32_t object_count() const { return (uint32_t)object_ids_.size(); }
+
+ private:
+  struct Entry {
+    std::string name;
+    uint32_t header_offset = 0;
+    uint32_t crc = 0;
+    uint32_t size = 0;
+  };
+
+  bool begin_entry(const char *name, std::string *error);
+  bool end_entry(std::string *error);
+  bool write_entry(const char *name, const std::string &body, std::string *error);
+  void append(const char *text);
+  void append(const std::string &text);
+  bool flush(std::string *error);
+  bool write_raw(const void *data, size_t len, std::string *error);
+
+  std::FILE *file_ = nullptr;
+  std::vector<Entry> entries_;
+  bool in_entry_ = false;
+  uint64_t offset_ = 0;
+  std::string buffer_;
+  std::vector<uint32_t> object_ids_;
+};
+
+}  // namespace vicad
+
+#endif  // VICAD_THREEMF_WRITER_H_
@@ -0,0 +1,120 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "json_escape.h"
+
+namespace vicad {
+
+namespace trace_detail {
+std::atomic<bool> g_enabled{false};
+}  // namespace trace_detail
+
+namespace {
+
+struct TraceSpanRecord {
+  const char *category;
+  const char *name;
+  uint64_t begin_ns;
+  uint64_t end_ns;
+  uint32_t tid;
+};
+
+struct TraceState {
+  std::chrono::steady_clock::time_point epoch;
+  std::mutex mutex;
+  std::vector<TraceSpanRecord> spans;
+  std::vector<std::pair<uint32_t, std::string>> thread_names;
+  size_t max_spans = 0;
+  uint64_t dropped = 0;
+  std::atomic<uint32_t> next_tid{1};
+};
+
+TraceState &state() {
+  static TraceState s;
+  return s;
+}
+
+// Small sequential ids read better in the trace viewer than native ones.
+uint32_t thread_id() {
+  thread_local const uint32_t id = state().next_tid.fetch_add(1, std::memory_order_relaxed);
+  return id;
+}
+
+}  // namespace
+
+void trace_enable(size_t max_spans) {
+  TraceState &s = state();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  if (trace_detail::g_enabled.load(std::memory_order_relaxed)) return;
+  s.epoch = std::chrono::steady_clock::now();
+  s.max_spans = max_spans;
+  s.spans.reserve(std::min<size_t>(max_spans, (size_t)1 << 16));
+  trace_detail::g_enabled.store(true, std::memory_order_release);
+}
+
+uint64_t trace_now_ns() {
+  const auto since = std::chrono::steady_clock::now() - state().epoch;
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(since).count();
+}
+
+void trace_thread_name(const std::string &name) {
+  if (!trace_enabled()) return;
+  TraceState &s = state();
+  const uint32_t tid = thread_id();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  s.thread_names.emplace_back(tid, name);
+}
+
+void trace_record(const char *category, const char *name, uint64_t begin_ns, uint64_t end_ns) {
+  TraceState &s = state();
+  const uint32_t tid = thread_id();
+  std::lock_guard<std::mutex> lock(s.mutex);
+  if (s.spans.size() >= s.max_spans) {
+    s.dropped++;
+    return;
+  }
+  s.spans.push_back({category, name, begin_ns, end_ns, tid});
+}
+
+bool trace_write(const char *path, std::string *error) {
+  TraceState &s = state();
+  std::FILE *f = std::fopen(path, "w");
+  if (!f) {
+    if (error) *error = std::string("cannot open trace file ") + path + ": " + std::strerror(errno);
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(s.mutex);
+  std::fprintf(f, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_spans\":%llu},\"traceEvents\":[",
+               (unsigned long long)s.dropped);
+  bool first = true;
+  for (const auto &[tid, name] : s.thread_names) {
+    std::fprintf(f, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"",
+                 first ? "" : ",", tid);
+    write_json_escaped(f, name.c_str());
+    std::fputs("\"}}", f);
+    first = false;
+  }
+  for (const TraceSpanRecord &span : s.spans) {
+    std::fprintf(f, "%s\n{\"ph\":\"X\",\"cat\":\"", first ? "" : ",");
+    write_json_escaped(f, span.category);
+    std::fputs("\",\"name\":\"", f);
+    write_json_escaped(f, span.name);
+    std::fprintf(f, "\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", span.tid, span.begin_ns / 1000.0,
+                 (span.end_ns - span.begin_ns) / 1000.0);
+    first = false;
+  }
+  std::fputs("\n]}\n", f);
+  const bool ok = std::fclose(f) == 0;
+  if (!ok && error) *error = std::string("cannot write trace file ") + path;
+  return ok;
+}
+
+}  // namespace vicad
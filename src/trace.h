@@ -0,0 +1,68 @@
+#ifndef VICAD_TRACE_H_
+#define VICAD_TRACE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Scoped trace spans, kept in memory and written out as a Chrome trace
+// (open in ui.perfetto.dev or chrome://tracing).
+//
+// Tracing is off until trace_enable(); a disabled span costs one atomic
+// load. Each span records its thread and begin/end in nanoseconds since
+// trace_enable(). `category` and `name` must outlive the trace (literals).
+// Past `max_spans` further spans are counted as dropped, not stored.
+//
+// Usage:
+//   vicad::trace_enable();
+//   { vicad::TraceSpan span("replay", "boolean"); ... }
+//   vicad::TraceSpan frame("frame", "ui_layout"); ...; frame.End();
+//   vicad::trace_write("build/trace.json", &err);
+//
+// The app enables it when VICAD_TRACE=<path> is set and writes the trace
+// there on exit.
+
+namespace vicad {
+
+namespace trace_detail {
+extern std::atomic<bool> g_enabled;
+}  // namespace trace_detail
+
+inline bool trace_enabled() { return trace_detail::g_enabled.load(std::memory_order_acquire); }
+
+void trace_enable(size_t max_spans = (size_t)1 << 20);
+uint64_t trace_now_ns();
+// Names the calling thread in the trace (e.g. "main", "loader 0").
+void trace_thread_name(const std::string &name);
+void trace_record(const char *category, const char *name, uint64_t begin_ns, uint64_t end_ns);
+
+class TraceSpan {
+ public:
+  TraceSpan(const char *category, const char *name) : category_(category), name_(name) {
+    if (trace_enabled()) begin_ns_ = trace_now_ns() + 1;  // 0 means not recording
+  }
+  ~TraceSpan() { End(); }
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+
+  // Ends the span early; the destructor then does nothing.
+  void End() {
+    if (begin_ns_ == 0) return;
+    trace_record(category_, name_, begin_ns_ - 1, trace_now_ns());
+    begin_ns_ = 0;
+  }
+
+ private:
+  const char *category_;
+  const char *name_;
+  uint64_t begin_ns_ = 0;
+};
+
+// Writes every span so far as Chrome trace JSON ("X" events, microseconds).
+// Recording continues; returns false when the file cannot be written.
+bool trace_write(const char *path, std::string *error);
+
+}  // namespace vicad
+
+#endif  // VICAD_TRACE_H_
@@ -0,0 +1,73 @@
+#include "union_by_bounds.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+#include "trace.h"
+
+namespace vicad {
+
+manifold::Manifold UnionByBounds(const std::vector<manifold::Manifold> &parts) {
+  if (parts.size() < 2) return manifold::Manifold::BatchBoolean(parts, manifold::OpType::Add);
+  std::vector<manifold::Box> boxes(parts.size());
+  std::vector<uint32_t> order;
+  order.reserve(parts.size());
+  for (uint32_t i = 0; i < (uint32_t)parts.size(); ++i) {
+    // A failed part reports its error through the boolean, as before.
+    if (parts[i].Status() != manifold::Manifold::Error::NoError) {
+      return manifold::Manifold::BatchBoolean(parts, manifold::OpType::Add);
+    }
+    if (parts[i].IsEmpty()) continue;
+    boxes[i] = parts[i].BoundingBox();
+    order.push_back(i);
+  }
+
+  // Sweep along x, joining each part to every earlier one whose box it
+  // overlaps. Touching boxes count as overlapping so shared faces still fuse.
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return boxes[a].min.x < boxes[b].min.x; });
+  std::vector<uint32_t> parent(parts.size());
+  for (uint32_t i = 0; i < (uint32_t)parent.size(); ++i) parent[i] = i;
+  auto find = [&](uint32_t i) {
+    while (parent[i] != i) i = parent[i] = parent[parent[i]];
+    return i;
+  };
+  std::vector<uint32_t> active;
+  for (uint32_t i : order) {
+    const manifold::Box &b = boxes[i];
+    size_t kept = 0;
+    for (uint32_t j : active) {
+      const manifold::Box &a = boxes[j];
+      if (a.max.x < b.min.x) continue;
+      active[kept++] = j;
+      if (a.min.y <= b.max.y && b.min.y <= a.max.y && a.min.z <= b.max.z && b.min.z <= a.max.z) {
+        parent[find(j)] = find(i);
+      }
+    }
+    active.resize(kept);
+    active.push_back(i);
+  }
+
+  std::vector<std::vector<manifold::Manifold>> clusters;
+  std::vector<int> cluster_of(parts.size(), -1);
+  for (uint32_t i : order) {
+    int &c = cluster_of[find(i)];
+    if (c < 0) {
+      c = (int)clusters.size();
+      clusters.emplace_back();
+    }
+    clusters[c].push_back(parts[i]);
+  }
+  if (clusters.size() < 2) return manifold::Manifold::BatchBoolean(parts, manifold::OpType::Add);
+
+  TraceSpan span("replay", "union_by_bounds");
+  std::vector<manifold::Manifold> pieces;
+  pieces.reserve(clusters.size());
+  for (std::vector<manifold::Manifold> &cluster : clusters) {
+    pieces.push_back(cluster.size() == 1 ? std::move(cluster[0])
+                                         : manifold::Manifold::BatchBoolean(cluster, manifold::OpType::Add));
+  }
+  return manifold::Manifold::Compose(pieces);
+}
+
+}  // namespace vicad
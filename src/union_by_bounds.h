@@ -0,0 +1,18 @@
+#ifndef VICAD_UNION_BY_BOUNDS_H_
+#define VICAD_UNION_BY_BOUNDS_H_
+
+#include <vector>
+
+#include "manifold/manifold.h"
+
+namespace vicad {
+
+// Union of `parts` that runs booleans only where bounding boxes overlap:
+// parts are clustered by box overlap, each cluster is unioned with
+// BatchBoolean and the disjoint results are concatenated with Compose. With a
+// single cluster this is BatchBoolean(parts, Add).
+manifold::Manifold UnionByBounds(const std::vector<manifold::Manifold> &parts);
+
+}  // namespace vicad
+
+#endif  // VICAD_UNION_BY_BOUNDS_H_
@@ -0,0 +1,148 @@
+#include "view_culling.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace vicad_cull {
+
+using vicad_app::Vec3;
+using vicad_app::add;
+using vicad_app::dot;
+using vicad_app::mul;
+using vicad_app::normalize;
+
+namespace {
+
+constexpr uint32_t kEdgeChunkSize = 64;
+
+Plane plane_through(const Vec3 &point, const Vec3 &normal) {
+  const Vec3 n = normalize(normal);
+  return {n, -dot(n, point)};
+}
+
+Vec3 mesh_point(const manifold::MeshGL &mesh, uint32_t v) {
+  const size_t base = (size_t)v * mesh.numProp;
+  return {mesh.vertProperties[base + 0], mesh.vertProperties[base + 1], mesh.vertProperties[base + 2]};
+}
+
+// Spreads the low 10 bits of v so two zero bits follow each one.
+uint32_t spread_bits10(uint32_t v) {
+  v &= 0x3FFu;
+  v = (v | (v << 16)) & 0x030000FFu;
+  v = (v | (v << 8)) & 0x0300F00Fu;
+  v = (v | (v << 4)) & 0x030C30C3u;
+  v = (v | (v << 2)) & 0x09249249u;
+  return v;
+}
+
+uint32_t quantize10(float v, float lo, float inv_extent) {
+  const float t = std::clamp((v - lo) * inv_extent, 0.0f, 1.0f);
+  return (uint32_t)(t * 1023.0f);
+}
+
+}  // namespace
+
+ViewFrustum BuildViewFrustum(const Vec3 &eye, const vicad_app::CameraBasis &basis,
+                             float fov_degrees, float aspect, float z_near, float z_far) {
+  const float tan_v = std::tan((fov_degrees * 3.1415926535f / 180.0f) * 0.5f);
+  const float tan_h = tan_v * (aspect > 0.0f ? aspect : 1.0f);
+  const Vec3 &f = basis.forward;
+  const Vec3 &r = basis.right;
+  const Vec3 &u = basis.up;
+  ViewFrustum out = {};
+  out.planes[0] = plane_through(add(eye, mul(f, z_near)), f);
+  out.planes[1] = plane_through(add(eye, mul(f, z_far)), mul(f, -1.0f));
+  out.planes[2] = plane_through(eye, add(r, mul(f, tan_h)));
+  out.planes[3] = plane_through(eye, add(mul(r, -1.0f), mul(f, tan_h)));
+  out.planes[4] = plane_through(eye, add(u, mul(f, tan_v)));
+  out.planes[5] = plane_through(eye, add(mul(u, -1.0f), mul(f, tan_v)));
+  return out;
+}
+
+bool BoxInFrustum(const ViewFrustum &frustum, const Vec3 &bmin, const Vec3 &bmax) {
+  for (const Plane &p : frustum.planes) {
+    const Vec3 far_corner = {
+        p.n.x >= 0.0f ? bmax.x : bmin.x,
+        p.n.y >= 0.0f ? bmax.y : bmin.y,
+        p.n.z >= 0.0f ? bmax.z : bmin.z,
+    };
+    if (dot(p.n, far_corner) + p.d < 0.0f) return false;
+  }
+  return true;
+}
+
+bool SegmentInFrustum(const ViewFrustum &frustum, const Vec3 &a, const Vec3 &b) {
+  for (const Plane &p : frustum.planes) {
+    if (dot(p.n, a) + p.d < 0.0f && dot(p.n, b) + p.d < 0.0f) return false;
+  }
+  return true;
+}
+
+EdgeChunks BuildEdgeChunks(const manifold::MeshGL &mesh, const vicad::EdgeDetectionResult &edge_result,
+                           const std::vector<int> &indices) {
+  EdgeChunks out;
+  if (indices.empty() || mesh.numProp < 3) return out;
+  const size_t vert_count = mesh.vertProperties.size() / mesh.numProp;
+
+  std::vector<std::pair<Vec3, int>> mids;
+  mids.reserve(indices.size());
+  Vec3 lo = {1e30f, 1e30f, 1e30f};
+  Vec3 hi = {-1e30f, -1e30f, -1e30f};
+  for (const int idx : indices) {
+    if (idx < 0 || (size_t)idx >= edge_result.edges.size()) continue;
+    const vicad::EdgeRecord &e = edge_result.edges[(size_t)idx];
+    if (e.v0 >= vert_count || e.v1 >= vert_count) continue;
+    const Vec3 m = mul(add(mesh_point(mesh, e.v0), mesh_point(mesh, e.v1)), 0.5f);
+    lo = {std::min(lo.x, m.x), std::min(lo.y, m.y), std::min(lo.z, m.z)};
+    hi = {std::max(hi.x, m.x), std::max(hi.y, m.y), std::max(hi.z, m.z)};
+    mids.push_back({m, idx});
+  }
+  if (mids.empty()) return out;
+
+  const float extent = std::max({hi.x - lo.x, hi.y - lo.y, hi.z - lo.z, 1e-6f});
+  const float inv_extent = 1.0f / extent;
+  std::vector<std::pair<uint32_t, int>> keyed;
+  keyed.reserve(mids.size());
+  for (const auto &[m, idx] : mids) {
+    const uint32_t code = spread_bits10(quantize10(m.x, lo.x, inv_extent)) |
+                          (spread_bits10(quantize10(m.y, lo.y, inv_extent)) << 1) |
+                          (spread_bits10(quantize10(m.z, lo.z, inv_extent)) << 2);
+    keyed.push_back({code, idx});
+  }
+  std::sort(keyed.begin(), keyed.end());
+
+  out.edges.reserve(keyed.size());
+  for (const auto &k : keyed) out.edges.push_back(k.second);
+  for (uint32_t begin = 0; begin < (uint32_t)out.edges.size(); begin += kEdgeChunkSize) {
+    EdgeChunk chunk;
+    chunk.begin = begin;
+    chunk.end = std::min<uint32_t>(begin + kEdgeChunkSize, (uint32_t)out.edges.size());
+    chunk.bmin = {1e30f, 1e30f, 1e30f};
+    chunk.bmax = {-1e30f, -1e30f, -1e30f};
+    for (uint32_t i = chunk.begin; i < chunk.end; ++i) {
+      const vicad::EdgeRecord &e = edge_result.edges[(size_t)out.edges[i]];
+      for (const Vec3 &p : {mesh_point(mesh, e.v0), mesh_point(mesh, e.v1)}) {
+        chunk.bmin = {std::min(chunk.bmin.x, p.x), std::min(chunk.bmin.y, p.y), std::min(chunk.bmin.z, p.z)};
+        chunk.bmax = {std::max(chunk.bmax.x, p.x), std::max(chunk.bmax.y, p.y), std::max(chunk.bmax.z, p.z)};
+      }
+    }
+    out.chunks.push_back(chunk);
+  }
+  return out;
+}
+
+void CollectVisibleRanges(const EdgeChunks &chunks, const ViewFrustum &frustum,
+                          std::vector<std::pair<uint32_t, uint32_t>> *out) {
+  if (!out) return;
+  out->clear();
+  for (const EdgeChunk &chunk : chunks.chunks) {
+    if (!BoxInFrustum(frustum, chunk.bmin, chunk.bmax)) continue;
+    if (!out->empty() && out->back().second == chunk.begin) {
+      out->back().second = chunk.end;
+    } else {
+      out->push_back({chunk.begin, chunk.end});
+    }
+  }
+}
+
+}  // namespace vicad_cull
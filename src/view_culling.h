@@ -0,0 +1,58 @@
+#ifndef VICAD_VIEW_CULLING_H_
+#define VICAD_VIEW_CULLING_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "app_state.h"
+#include "manifold/manifold.h"
+
+namespace vicad_cull {
+
+// Inward-facing plane: points p with dot(n, p) + d >= 0 are on the inside.
+struct Plane {
+  vicad_app::Vec3 n;
+  float d;
+};
+
+struct ViewFrustum {
+  Plane planes[6];
+};
+
+// Frustum of a perspective camera at `eye` looking along basis.forward, with
+// the vertical field of view and clip distances the projection uses.
+ViewFrustum BuildViewFrustum(const vicad_app::Vec3 &eye, const vicad_app::CameraBasis &basis,
+                             float fov_degrees, float aspect, float z_near, float z_far);
+
+// Conservative: false only when the box lies wholly outside one plane, so a
+// box straddling a frustum corner may still report visible.
+bool BoxInFrustum(const ViewFrustum &frustum, const vicad_app::Vec3 &bmin, const vicad_app::Vec3 &bmax);
+bool SegmentInFrustum(const ViewFrustum &frustum, const vicad_app::Vec3 &a, const vicad_app::Vec3 &b);
+
+struct EdgeChunk {
+  uint32_t begin = 0;
+  uint32_t end = 0;
+  vicad_app::Vec3 bmin = {0.0f, 0.0f, 0.0f};
+  vicad_app::Vec3 bmax = {0.0f, 0.0f, 0.0f};
+};
+
+// An edge index list reordered along a Morton curve of the edge midpoints and
+// cut into fixed-size chunks with bounds, so the edge overlays test a few
+// boxes against the view instead of every edge. Build when the edge topology
+// changes; the chunks stay valid while the mesh does.
+struct EdgeChunks {
+  std::vector<int> edges;
+  std::vector<EdgeChunk> chunks;
+};
+
+EdgeChunks BuildEdgeChunks(const manifold::MeshGL &mesh, const vicad::EdgeDetectionResult &edge_result,
+                           const std::vector<int> &indices);
+// Replaces `out` with [first, last) positions in chunks.edges covering every
+// chunk that intersects the frustum; adjacent chunks merge into one range.
+void CollectVisibleRanges(const EdgeChunks &chunks, const ViewFrustum &frustum,
+                          std::vector<std::pair<uint32_t, uint32_t>> *out);
+
+}  // namespace vicad_cull
+
+#endif  // VICAD_VIEW_CULLING_H_
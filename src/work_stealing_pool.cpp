@@ -0,0 +1,193 @@
+#include "work_stealing_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace vicad {
+
+namespace {
+
+constexpr size_t kMaxChunks = 64;
+
+}  // namespace
+
+WorkStealingPool &WorkStealingPool::Shared() {
+  static WorkStealingPool pool([] {
+    const unsigned hw = std::thread::hardware_concurrency();
+    return (size_t)(hw > 1 ? hw - 1 : 0);
+  }());
+  return pool;
+}
+
+WorkStealingPool::WorkStealingPool(size_t worker_count) {
+  for (size_t i = 0; i < worker_count + 1; ++i) queues_.push_back(std::make_unique<Queue>());
+  workers_.reserve(worker_count);
+  for (size_t i = 0; i < worker_count; ++i) {
+    workers_.emplace_back([this, i] { WorkerLoop(i); });
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread &t : workers_) t.join();
+}
+
+void WorkStealingPool::Push(size_t self, uint32_t task) {
+  {
+    std::lock_guard<std::mutex> lock(queues_[self]->mutex);
+    queues_[self]->tasks.push_back(task);
+  }
+  // Counted under wake_mutex_ so an idle thread cannot check `queued_` and
+  // then miss the notification; idle waits have no timeout.
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    queued_.fetch_add(1);
+  }
+  wake_.notify_one();
+  drained_.notify_all();
+}
+
+bool WorkStealingPool::Pop(size_t self, uint32_t *task) {
+  std::lock_guard<std::mutex> lock(queues_[self]->mutex);
+  if (queues_[self]->tasks.empty()) return false;
+  *task = queues_[self]->tasks.back();
+  queues_[self]->tasks.pop_back();
+  queued_.fetch_sub(1);
+  return true;
+}
+
+bool WorkStealingPool::Steal(size_t self, uint32_t *task) {
+  const size_t n = queues_.size();
+  for (size_t k = 1; k < n; ++k) {
+    Queue &victim = *queues_[(self + k) % n];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (victim.tasks.empty()) continue;
+    *task = victim.tasks.front();
+    victim.tasks.pop_front();
+    queued_.fetch_sub(1);
+    return true;
+  }
+  return false;
+}
+
+bool WorkStealingPool::TryRunOne(size_t self) {
+  uint32_t task = 0;
+  if (!Pop(self, &task) && !Steal(self, &task)) return false;
+  // A queued task implies an active graph; it is only cleared once drained.
+  Graph *g = graph_.load();
+  Finish(self, task, (*g->task)(task));
+  return true;
+}
+
+void WorkStealingPool::Finish(size_t self, uint32_t task, bool ok) {
+  Graph *g = graph_.load();
+  // Skipped dependents are finished here as well, iteratively so long failed
+  // chains cannot exhaust the stack.
+  std::vector<std::pair<uint32_t, bool>> done = {{task, ok}};
+  size_t finished = 0;
+  while (!done.empty()) {
+    const auto [t, t_ok] = done.back();
+    done.pop_back();
+    g->results[t] = t_ok ? 1 : 0;
+    for (uint32_t d : (*g->dependents)[t]) {
+      if (!t_ok) g->poisoned[d].store(1);
+      if (g->waiting[d].fetch_sub(1) != 1) continue;
+      if (g->poisoned[d].load() != 0) {
+        done.push_back({d, false});
+      } else {
+        Push(self, d);
+      }
+    }
+    finished++;
+  }
+  if (g->remaining.fetch_sub(finished) == finished) {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    drained_.notify_all();
+  }
+}
+
+void WorkStealingPool::WorkerLoop(size_t self) {
+  while (true) {
+    if (TryRunOne(self)) continue;
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    if (stopping_) return;
+    wake_.wait(lock, [this] { return stopping_ || queued_.load() > 0; });
+    if (stopping_) return;
+  }
+}
+
+std::vector<uint8_t> WorkStealingPool::RunGraph(const std::vector<uint32_t> &indegree,
+                                                const std::vector<std::vector<uint32_t>> &dependents,
+                                                const std::function<bool(uint32_t)> &task) {
+  if (indegree.empty()) return {};
+  std::lock_guard<std::mutex> run_lock(run_mutex_);
+  return RunLocked(indegree, dependents, task);
+}
+
+bool WorkStealingPool::TryRunGraph(const std::vector<uint32_t> &indegree,
+                                   const std::vector<std::vector<uint32_t>> &dependents,
+                                   const std::function<bool(uint32_t)> &task, std::vector<uint8_t> *results) {
+  std::unique_lock<std::mutex> run_lock(run_mutex_, std::try_to_lock);
+  if (!run_lock.owns_lock()) return false;
+  *results = indegree.empty() ? std::vector<uint8_t>() : RunLocked(indegree, dependents, task);
+  return true;
+}
+
+std::vector<uint8_t> WorkStealingPool::RunLocked(const std::vector<uint32_t> &indegree,
+                                                 const std::vector<std::vector<uint32_t>> &dependents,
+                                                 const std::function<bool(uint32_t)> &task) {
+  const size_t n = indegree.size();
+  Graph g;
+  g.dependents = &dependents;
+  g.task = &task;
+  g.waiting = std::make_unique<std::atomic<uint32_t>[]>(n);
+  g.poisoned = std::make_unique<std::atomic<uint8_t>[]>(n);
+  for (size_t i = 0; i < n; ++i) {
+    g.waiting[i].store(indegree[i]);
+    g.poisoned[i].store(0);
+  }
+  g.results.assign(n, 0);
+  g.remaining.store(n);
+  graph_.store(&g);
+
+  const size_t caller = queues_.size() - 1;
+  for (size_t i = 0; i < n; ++i) {
+    if (indegree[i] == 0) Push(caller, (uint32_t)i);
+  }
+  while (g.remaining.load() > 0) {
+    if (TryRunOne(caller)) continue;
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    drained_.wait(lock, [this, &g] { return g.remaining.load() == 0 || queued_.load() > 0; });
+  }
+  graph_.store(nullptr);
+  return std::move(g.results);
+}
+
+WorkChunks SplitWork(size_t n, size_t min_parallel) {
+  WorkChunks chunks;
+  chunks.n = n;
+  const size_t workers = WorkStealingPool::Shared().worker_count();
+  if (n >= min_parallel && n > 1 && workers > 0) chunks.count = std::min({workers + 1, kMaxChunks, n});
+  chunks.size = (n + chunks.count - 1) / chunks.count;
+  return chunks;
+}
+
+void RunWorkChunks(const WorkChunks &chunks, const std::function<void(size_t, size_t, size_t)> &task) {
+  auto run = [&](uint32_t c) {
+    task(c, chunks.begin(c), chunks.end(c));
+    return true;
+  };
+  if (chunks.count > 1) {
+    const std::vector<uint32_t> indegree(chunks.count, 0);
+    const std::vector<std::vector<uint32_t>> dependents(chunks.count);
+    std::vector<uint8_t> results;
+    if (WorkStealingPool::Shared().TryRunGraph(indegree, dependents, run, &results)) return;
+  }
+  for (uint32_t c = 0; c < (uint32_t)chunks.count; ++c) run(c);
+}
+
+}  // namespace vicad
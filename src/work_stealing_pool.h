@@ -0,0 +1,100 @@
+#ifndef VICAD_WORK_STEALING_POOL_H_
+#define VICAD_WORK_STEALING_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vicad {
+
+// Process-wide pool that executes dependency graphs. Each thread owns a deque:
+// it pushes tasks it unblocks and pops them LIFO, and idle threads steal FIFO
+// from the others. The thread calling RunGraph participates as well.
+class WorkStealingPool {
+ public:
+  static WorkStealingPool &Shared();
+
+  explicit WorkStealingPool(size_t worker_count);
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+  size_t worker_count() const { return workers_.size(); }
+
+  // Runs tasks [0, indegree.size()). Task i starts once indegree[i] of its
+  // predecessors finished; dependents[i] lists the tasks waiting on i. A task
+  // that returns false is a failure and every task depending on it, directly
+  // or not, is skipped. Returns per-task results: 1 = ran and succeeded,
+  // 0 = failed or skipped. Blocks until the whole graph drained.
+  std::vector<uint8_t> RunGraph(const std::vector<uint32_t> &indegree,
+                                const std::vector<std::vector<uint32_t>> &dependents,
+                                const std::function<bool(uint32_t)> &task);
+  // Like RunGraph, but returns false without running anything when another
+  // thread's graph holds the pool, so the caller can run the tasks itself.
+  bool TryRunGraph(const std::vector<uint32_t> &indegree, const std::vector<std::vector<uint32_t>> &dependents,
+                   const std::function<bool(uint32_t)> &task, std::vector<uint8_t> *results);
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<uint32_t> tasks;
+  };
+  struct Graph {
+    const std::vector<std::vector<uint32_t>> *dependents = nullptr;
+    const std::function<bool(uint32_t)> *task = nullptr;
+    std::unique_ptr<std::atomic<uint32_t>[]> waiting;
+    std::unique_ptr<std::atomic<uint8_t>[]> poisoned;
+    std::vector<uint8_t> results;
+    std::atomic<size_t> remaining{0};
+  };
+
+  std::vector<uint8_t> RunLocked(const std::vector<uint32_t> &indegree,
+                                 const std::vector<std::vector<uint32_t>> &dependents,
+                                 const std::function<bool(uint32_t)> &task);
+  void WorkerLoop(size_t self);
+  bool TryRunOne(size_t self);
+  void Push(size_t self, uint32_t task);
+  bool Pop(size_t self, uint32_t *task);
+  bool Steal(size_t self, uint32_t *task);
+  void Finish(size_t self, uint32_t task, bool ok);
+
+  std::vector<std::thread> workers_;
+  // One queue per worker plus one for the calling thread (the last).
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::mutex run_mutex_;
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  std::condition_variable drained_;
+  std::atomic<Graph *> graph_{nullptr};
+  std::atomic<size_t> queued_{0};
+  bool stopping_ = false;
+};
+
+// [0, n) cut into contiguous chunks: one per shared pool thread plus the
+// caller, or a single chunk below `min_parallel` items or without workers.
+struct WorkChunks {
+  size_t n = 0;
+  size_t count = 1;
+  size_t size = 0;
+
+  size_t begin(size_t c) const { return c * size < n ? c * size : n; }
+  size_t end(size_t c) const { return (c + 1) * size < n ? (c + 1) * size : n; }
+};
+
+WorkChunks SplitWork(size_t n, size_t min_parallel);
+
+// Runs task(chunk, begin, end) for every chunk, on the shared pool unless it is
+// busy with another thread's graph, in which case the calling thread does it.
+void RunWorkChunks(const WorkChunks &chunks, const std::function<void(size_t, size_t, size_t)> &task);
+
+}  // namespace vicad
+
+#endif  // VICAD_WORK_STEALING_POOL_H_
@@ -39,8 +39,8 @@ check() {
   fi
 }
 
-RENDER_HEADERS='"scene_session\.h"\|"scene_runtime\.h"\|"script_worker_client\.h"\|"ipc_protocol\.h"'
-SCENE_HEADERS='"scene_session\.h"\|"scene_runtime\.h"\|"script_worker_client\.h"'
+RENDER_HEADERS='"scene_session\.h"\|"scene_loader\.h"\|"scene_refiner\.h"\|"scene_analyzer\.h"\|"scene_tab_cache\.h"\|"scene_export_job\.h"\|"scene_runtime\.h"\|"script_worker_client\.h"\|"ipc_protocol\.h"'
+SCENE_HEADERS='"scene_session\.h"\|"scene_loader\.h"\|"scene_refiner\.h"\|"scene_analyzer\.h"\|"scene_tab_cache\.h"\|"scene_export_job\.h"\|"scene_runtime\.h"\|"script_worker_client\.h"'
 
 # LOCAL_INCLUDE matches flat quoted includes like "foo.h" but not "manifold/foo.h" or "../bar.h"
 LOCAL_INCLUDE='^#include "[^./][^/]*\.h"'
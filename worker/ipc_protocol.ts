@@ -1,4 +1,4 @@
-export const IPC_VERSION = 3;
+export const IPC_VERSION = 10;
 export const IPC_MAGIC = "VCADIPC1";
 
 export const HEADER_OFFSETS = {
@@ -13,9 +13,11 @@ export const HEADER_OFFSETS = {
   responseLength: 44,
   state: 48,
   errorCode: 52,
+  responseSegment: 56,
+  recordsCommitted: 60,
 } as const;
 
-export const HEADER_SIZE = 60;
+export const HEADER_SIZE = 64;
 
 export const IPC_STATE = {
   IDLE: 0,
@@ -81,13 +83,33 @@ export const OP = {
 
 export type OpCode = (typeof OP)[keyof typeof OP];
 
+export const OP_FLAG = {
+  // Payload is { outId: u32, baseId: u32 }: the node is reused from the delta base run.
+  KEEP: 1,
+} as const;
+
+export const IMPORTS_SEPARATOR = "\n";
+
+export const REQUEST_OFFSETS = {
+  version: 0,
+  scriptPathLen: 4,
+  deltaBaseSeq: 8,
+  headerSize: 16,
+} as const;
+
 export const RESPONSE_OFFSETS = {
   sceneVersion: 0,
   sceneObjectCount: 4,
   sceneOpCount: 8,
   sceneRecordsSize: 12,
+  // Object names back to back (nameLen each), then the absolute paths of the
+  // user modules the script imported, UTF-8, joined by IMPORTS_SEPARATOR.
   sceneDiagnosticsLen: 16,
   sceneObjectTableSize: 20,
-  sceneHeaderSize: 24,
+  sceneLoadUs: 24,
+  sceneExecuteUs: 28,
+  sceneEncodeUs: 32,
+  sceneHeaderSize: 36,
   objectRecordSize: 24,
+  opHeaderSize: 16,
 } as const;
@@ -1,83 +1,79 @@
-import type { OpCode } from "./ipc_protocol";
+import { RESPONSE_OFFSETS } from "./ipc_protocol";
 
-export type EncodedOp = {
-  opcode: OpCode;
-  payload: ArrayBuffer;
+export const OP_HEADER_SIZE = RESPONSE_OFFSETS.opHeaderSize;
+
+// A writable region at the sink's record cursor.
+export type RecordSlot = {
+  bytes: Uint8Array;
+  view: DataView;
+  offset: number;
 };
 
-class Writer {
-  private chunks: Uint8Array[] = [];
-  private total = 0;
+// Destination of op records. Each record is written in place at the cursor:
+// the sink hands out room for it, and only a committed record becomes part of
+// the stream, so an op dropped after encoding (value numbering) costs nothing.
+export interface OpSink {
+  // Room for a `len`-byte record at the cursor. The region stays valid until
+  // the next call.
+  reserveRecord(len: number): RecordSlot;
+  // Moves the cursor past the `len`-byte record written at the reserved slot.
+  commitRecord(len: number): void;
+}
 
-  append(buf: Uint8Array) {
-    this.chunks.push(buf);
-    this.total += buf.byteLength;
-  }
+// Bump cursor over the payload of the record being encoded.
+export class PayloadWriter {
+  view: DataView = new DataView(new ArrayBuffer(0));
+  bytes: Uint8Array = new Uint8Array(0);
+  start = 0;
+  off = 0;
 
-  appendU32(v: number) {
-    const b = new Uint8Array(4);
-    new DataView(b.buffer).setUint32(0, v >>> 0, true);
-    this.append(b);
+  reset(slot: RecordSlot) {
+    this.view = slot.view;
+    this.bytes = slot.bytes;
+    this.start = slot.offset + OP_HEADER_SIZE;
+    this.off = this.start;
   }
 
-  appendU16(v: number) {
-    const b = new Uint8Array(2);
-    new DataView(b.buffer).setUint16(0, v >>> 0, true);
-    this.append(b);
+  u32(v: number) {
+    this.view.setUint32(this.off, v >>> 0, true);
+    this.off += 4;
   }
 
-  appendF64(v: number) {
-    const b = new Uint8Array(8);
-    new DataView(b.buffer).setFloat64(0, Number(v), true);
-    this.append(b);
+  u64(v: bigint) {
+    this.view.setBigUint64(this.off, v, true);
+    this.off += 8;
   }
 
-  toUint8Array() {
-    const out = new Uint8Array(this.total);
-    let off = 0;
-    for (const c of this.chunks) {
-      out.set(c, off);
-      off += c.byteLength;
-    }
-    return out;
+  f64(v: number) {
+    this.view.setFloat64(this.off, v, true);
+    this.off += 8;
   }
 }
 
-export function payloadU32AndF64(outId: number, values: number[]) {
-  const w = new Writer();
-  w.appendU32(outId);
-  for (const v of values) w.appendF64(v);
-  return w.toUint8Array().buffer;
-}
+// Sink that keeps the records in memory, for runs without shared memory
+// (tests, __vicadEncodeScene).
+export class BufferSink implements OpSink {
+  private bytes = new Uint8Array(4096);
+  private view = new DataView(this.bytes.buffer);
+  private used = 0;
 
-export function payloadU32(outId: number, values: number[]) {
-  const w = new Writer();
-  w.appendU32(outId);
-  for (const v of values) w.appendU32(v);
-  return w.toUint8Array().buffer;
-}
+  reserveRecord(len: number) {
+    if (this.used + len > this.bytes.byteLength) {
+      let size = this.bytes.byteLength * 2;
+      while (size < this.used + len) size *= 2;
+      const grown = new Uint8Array(size);
+      grown.set(this.bytes.subarray(0, this.used));
+      this.bytes = grown;
+      this.view = new DataView(grown.buffer);
+    }
+    return { bytes: this.bytes, view: this.view, offset: this.used };
+  }
 
-export function payloadMixed(outId: number, f64Values: number[], u32Values: number[], u32First = false) {
-  const w = new Writer();
-  w.appendU32(outId);
-  if (u32First) {
-    for (const v of u32Values) w.appendU32(v);
-    for (const v of f64Values) w.appendF64(v);
-  } else {
-    for (const v of f64Values) w.appendF64(v);
-    for (const v of u32Values) w.appendU32(v);
+  commitRecord(len: number) {
+    this.used += len;
   }
-  return w.toUint8Array().buffer;
-}
 
-export function encodeOps(ops: EncodedOp[]) {
-  const w = new Writer();
-  for (const op of ops) {
-    const payloadBytes = new Uint8Array(op.payload);
-    w.appendU16(op.opcode);
-    w.appendU16(0);
-    w.appendU32(payloadBytes.byteLength);
-    w.append(payloadBytes);
+  get records() {
+    return this.bytes.subarray(0, this.used);
   }
-  return w.toUint8Array();
 }
@@ -1,10 +1,23 @@
 import { describe, expect, it } from "bun:test";
 
-import { NODE_KIND, OP } from "./ipc_protocol";
-import { __vicadBeginRun, __vicadEncodeScene, CrossSection, Manifold, Plane, XY, XZ, vicad } from "./proxy-manifold";
+import { NODE_KIND, OP, OP_FLAG } from "./ipc_protocol";
+import { BufferSink } from "./op-encoder";
+import {
+  __vicadBeginRun,
+  __vicadEncodeScene,
+  __vicadRunNodes,
+  CrossSection,
+  Manifold,
+  Plane,
+  XY,
+  XZ,
+  vicad,
+} from "./proxy-manifold";
 
 type DecodedOp = {
   opcode: number;
+  flags: number;
+  digest: bigint;
   payload: Uint8Array;
 };
 
@@ -13,13 +26,17 @@ function decodeOps(records: Uint8Array): DecodedOp[] {
   const view = new DataView(records.buffer, records.byteOffset, records.byteLength);
   let off = 0;
   while (off < records.byteLength) {
-    if (off + 8 > records.byteLength) throw new Error("Truncated op header in records.");
+    if (off + 16 > records.byteLength) throw new Error("Truncated op header in records.");
     const opcode = view.getUint16(off + 0, true);
+    const flags = view.getUint16(off + 2, true);
     const payloadLen = view.getUint32(off + 4, true);
-    off += 8;
+    const digest = view.getBigUint64(off + 8, true);
+    off += 16;
     if (off + payloadLen > records.byteLength) throw new Error("Truncated op payload in records.");
     out.push({
       opcode,
+      flags,
+      digest,
       payload: records.subarray(off, off + payloadLen),
     });
     off += payloadLen;
@@ -340,3 +357,117 @@ describe("Plane primitives", () => {
     expect(ops.some((op) => op.opcode === OP.EXTRUDE)).toBe(true);
   });
 });
+
+describe("Op streaming", () => {
+  // Notes the opcode of every record as it is committed.
+  class RecordingSink extends BufferSink {
+    opcodes: number[] = [];
+
+    commitRecord(len: number) {
+      const at = this.records.byteLength;
+      super.commitRecord(len);
+      const view = new DataView(this.records.buffer, this.records.byteOffset, this.records.byteLength);
+      this.opcodes.push(view.getUint16(at, true));
+    }
+  }
+
+  it("encodes every op into the run's sink in push order", () => {
+    const sink = new RecordingSink();
+    __vicadBeginRun(sink);
+    const base = Manifold.cube([4, 4, 4]);
+    const hole = Manifold.cylinder(6, 1);
+    vicad.addToScene(base.subtract(hole), { name: "streamed" });
+
+    const scene = __vicadEncodeScene();
+    const ops = decodeOps(scene.records);
+    expect(sink.opcodes).toEqual(ops.map((op) => op.opcode));
+    expect(scene.opCount).toBe(sink.opcodes.length);
+  });
+
+  it("leaves the sink behind on the next run", () => {
+    const sink = new RecordingSink();
+    __vicadBeginRun(sink);
+    __vicadBeginRun();
+    Manifold.sphere(2);
+    expect(sink.records.byteLength).toBe(0);
+  });
+
+  it("writes payloads larger than the sink's initial buffer in place", () => {
+    __vicadBeginRun();
+    const points: [number, number][] = [];
+    for (let i = 0; i < 1000; i++) points.push([Math.cos(i), i * 0.5]);
+    vicad.addToScene(CrossSection.polygon(points), { name: "outline" });
+
+    const ops = decodeOps(__vicadEncodeScene().records);
+    expect(ops.length).toBe(1);
+    const payload = ops[0].payload;
+    expect(payload.byteLength).toBe(12 + 1000 * 16);
+    const view = new DataView(payload.buffer, payload.byteOffset, payload.byteLength);
+    expect(view.getUint32(8, true)).toBe(1000);
+    expect(view.getFloat64(12 + 999 * 16 + 8, true)).toBe(999 * 0.5);
+  });
+});
+
+describe("Content digests", () => {
+  function rootDigest(build: () => Manifold) {
+    __vicadBeginRun();
+    vicad.addToScene(build(), { name: "digest" });
+    const ops = decodeOps(__vicadEncodeScene().records);
+    return ops[ops.length - 1].digest;
+  }
+
+  it("ignores node ids and follows input content", () => {
+    const plain = rootDigest(() => Manifold.cube([2, 2, 2]).translate([1, 0, 0]));
+    const shifted = rootDigest(() => {
+      Manifold.sphere(3);
+      return Manifold.cube([2, 2, 2]).translate([1, 0, 0]);
+    });
+    const edited = rootDigest(() => Manifold.cube([2, 2, 3]).translate([1, 0, 0]));
+    expect(plain).not.toBe(0n);
+    expect(shifted).toBe(plain);
+    expect(edited).not.toBe(plain);
+  });
+});
+
+describe("Value numbering", () => {
+  it("reuses the node of a structurally identical op", () => {
+    __vicadBeginRun();
+    const bolts = [0, 1, 2].map(() => Manifold.cylinder(4, 0.5).translate([10, 0, 0]));
+    const other = Manifold.cylinder(4, 0.6);
+    vicad.addToScene(Manifold.union(bolts), { name: "bolts" });
+    vicad.addToScene(other, { name: "other" });
+
+    const ops = decodeOps(__vicadEncodeScene().records);
+    expect(new Set(bolts.map((b) => b.nodeId)).size).toBe(1);
+    expect(ops.map((op) => op.opcode)).toEqual([OP.CYLINDER, OP.TRANSLATE, OP.UNION, OP.CYLINDER]);
+    // The skipped ids are handed out again, so numbering stays dense.
+    expect(other.nodeId).toBe(4);
+  });
+});
+
+describe("Delta runs", () => {
+  function build(height: number) {
+    const plate = Manifold.cube([20, 20, 2]);
+    const boss = Manifold.cylinder(height, 3).translate([10, 10, 0]);
+    vicad.addToScene(Manifold.union([plate, boss]), { name: "part" });
+  }
+
+  it("sends unchanged nodes as keep records naming the base node", () => {
+    __vicadBeginRun();
+    build(5);
+    __vicadEncodeScene();
+    const base = __vicadRunNodes();
+
+    __vicadBeginRun(undefined, base);
+    Manifold.sphere(1);
+    build(6);
+    const ops = decodeOps(__vicadEncodeScene().records);
+    expect(ops.map((op) => op.flags)).toEqual([0, OP_FLAG.KEEP, 0, 0, 0]);
+    const kept = ops[1];
+    expect(kept?.opcode).toBe(OP.CUBE);
+    const keptView = new DataView(kept!.payload.buffer, kept!.payload.byteOffset, kept!.payload.byteLength);
+    expect(kept?.payload.byteLength).toBe(8);
+    expect(keptView.getUint32(0, true)).toBe(2);
+    expect(keptView.getUint32(4, true)).toBe(base.get(kept!.digest));
+  });
+});
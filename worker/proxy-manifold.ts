@@ -1,11 +1,12 @@
-import { NODE_KIND, OP } from "./ipc_protocol";
-import { encodeOps, type EncodedOp } from "./op-encoder";
+import { NODE_KIND, OP, OP_FLAG } from "./ipc_protocol";
+import { BufferSink, OP_HEADER_SIZE, PayloadWriter, type OpSink } from "./op-encoder";
 
 type Vec2Like = [number, number] | number[];
 type Vec3Like = [number, number, number] | number[];
 type FilletCornerSelection = { contour: number; vertex: number; radius: number };
 
-type Part = { t: "u32" | "u64" | "f64"; v: number | bigint };
+// "node" parts are input node ids: encoded as u32, hashed by content digest.
+type Part = { t: "u32" | "u64" | "f64" | "node"; v: number | bigint };
 
 type SceneEntry = {
   objectIdHash: bigint;
@@ -51,73 +52,54 @@ function hashCombine64(parts: bigint[]) {
   return h;
 }
 
-function makePayload(parts: Part[]) {
-  let bytes = 0;
-  for (const p of parts) bytes += p.t === "u32" ? 4 : 8;
-  const out = new Uint8Array(bytes);
-  const view = new DataView(out.buffer);
-  let off = 0;
-  for (const p of parts) {
-    if (p.t === "u32") {
-      view.setUint32(off, Number(p.v) >>> 0, true);
-      off += 4;
-    } else if (p.t === "u64") {
-      view.setBigUint64(off, BigInt(p.v), true);
-      off += 8;
-    } else {
-      view.setFloat64(off, Number(p.v), true);
-      off += 8;
+// FNV-1a over bytes [start, end), reading the 4-byte input node ids at the
+// absolute offsets `skips` as zeros so the hash covers parameters only.
+function fnv1a64Params(bytes: Uint8Array, start: number, end: number, skips: number[]) {
+  let h = FNV64_OFFSET;
+  for (let i = start; i < end; i++) {
+    let b = bytes[i];
+    for (const s of skips) {
+      if (i >= s && i < s + 4) b = 0;
     }
+    h ^= BigInt(b);
+    h = (h * FNV64_PRIME) & U64_MASK;
   }
-  return out.buffer;
+  return h;
 }
 
-function makePolygonsPayload(outId: number, contours: [number, number][][]) {
+function partsPayloadLen(parts: Part[]) {
+  let bytes = 0;
+  for (const p of parts) bytes += p.t === "u32" || p.t === "node" ? 4 : 8;
+  return bytes;
+}
+
+function polygonsPayloadLen(contours: [number, number][][]) {
   let bytes = 8;
+  for (const contour of contours) bytes += 4 + contour.length * 16;
+  return bytes;
+}
+
+function writePolygonsPayload(w: PayloadWriter, outId: number, contours: [number, number][][]) {
+  w.u32(outId);
+  w.u32(contours.length);
   for (const contour of contours) {
-    bytes += 4;
-    bytes += contour.length * 16;
-  }
-  const out = new Uint8Array(bytes);
-  const view = new DataView(out.buffer);
-  let off = 0;
-  view.setUint32(off, outId >>> 0, true);
-  off += 4;
-  view.setUint32(off, contours.length >>> 0, true);
-  off += 4;
-  for (const contour of contours) {
-    view.setUint32(off, contour.length >>> 0, true);
-    off += 4;
+    w.u32(contour.length);
     for (const [x, y] of contour) {
-      view.setFloat64(off, x, true);
-      off += 8;
-      view.setFloat64(off, y, true);
-      off += 8;
+      w.f64(x);
+      w.f64(y);
     }
   }
-  return out.buffer;
 }
 
-function makeFilletCornersPayload(outId: number, inId: number, corners: FilletCornerSelection[]) {
-  const bytes = 12 + corners.length * 16;
-  const out = new Uint8Array(bytes);
-  const view = new DataView(out.buffer);
-  let off = 0;
-  view.setUint32(off, outId >>> 0, true);
-  off += 4;
-  view.setUint32(off, inId >>> 0, true);
-  off += 4;
-  view.setUint32(off, corners.length >>> 0, true);
-  off += 4;
+function writeFilletCornersPayload(w: PayloadWriter, outId: number, inId: number, corners: FilletCornerSelection[]) {
+  w.u32(outId);
+  w.u32(inId);
+  w.u32(corners.length);
   for (const corner of corners) {
-    view.setUint32(off, corner.contour >>> 0, true);
-    off += 4;
-    view.setUint32(off, corner.vertex >>> 0, true);
-    off += 4;
-    view.setFloat64(off, corner.radius, true);
-    off += 8;
-  }
-  return out.buffer;
+    w.u32(corner.contour);
+    w.u32(corner.vertex);
+    w.f64(corner.radius);
+  }
 }
 
 function vec3(xOrArr: number | Vec3Like, y?: number, z?: number): [number, number, number] {
@@ -172,29 +154,105 @@ function unsupported(name: string): never {
 
 class Registry {
   private nextNodeId = 1;
-  ops: EncodedOp[] = [];
+  private readonly writer = new PayloadWriter();
+  opCount = 0;
   sceneEntries: SceneEntry[] = [];
   nodeDigest = new Map<number, bigint>();
-
-  reset() {
+  // Merkle digest of each node: opcode, parameters and the content digests of
+  // its inputs, but not node ids. Sent with every record so the client can
+  // reuse replay results for unchanged subtrees across runs.
+  contentDigest = new Map<number, bigint>();
+  // Content digest -> node id of the first op that produced it this run.
+  valueNumber = new Map<bigint, number>();
+  // valueNumber of the delta base run. Ops found here are sent as keep records
+  // naming the base node instead of their payload.
+  baseNodes: Map<bigint, number> | null = null;
+  // Where records are encoded. The worker passes its shared memory stream, so
+  // each op is written once, in place, while the script is still running.
+  sink: OpSink = new BufferSink();
+
+  reset(sink: OpSink) {
     this.nextNodeId = 1;
-    this.ops = [];
+    this.opCount = 0;
+    this.sink = sink;
     this.sceneEntries = [];
     this.nodeDigest.clear();
+    this.contentDigest.clear();
+    this.valueNumber.clear();
+    this.baseNodes = null;
   }
 
   allocNodeId() {
     return this.nextNodeId++;
   }
 
-  push(opcode: number, payload: ArrayBuffer) {
-    this.ops.push({ opcode, payload });
-    const bytes = new Uint8Array(payload);
-    if (bytes.byteLength >= 4) {
-      const outId = new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength).getUint32(0, true);
-      const digest = hashCombine64([BigInt(opcode >>> 0), fnv1a64(bytes)]);
-      this.nodeDigest.set(outId, digest);
+  // Starts an op with a `payloadLen`-byte payload, reserved at the sink's
+  // cursor. Write the payload through the returned writer, then call endOp.
+  beginOp(payloadLen: number) {
+    this.writer.reset(this.sink.reserveRecord(OP_HEADER_SIZE + payloadLen));
+    return this.writer;
+  }
+
+  // Finishes the op begun last. `inputOffsets` are the byte offsets of input
+  // node ids within the payload. Returns the node id callers must use: an op
+  // whose content digest was already pushed this run is not committed and
+  // resolves to the existing node (value numbering), so repeated primitives
+  // and transforms in patterns are encoded and replayed once.
+  endOp(opcode: number, inputOffsets: number[] = []) {
+    const { bytes, view, start } = this.writer;
+    let payloadLen = this.writer.off - start;
+    let outId = 0;
+    let digest = 0n;
+    if (payloadLen >= 4) {
+      outId = view.getUint32(start, true);
+      const inputs: bigint[] = [];
+      const skips: number[] = [];
+      for (const off of inputOffsets) {
+        inputs.push(this.contentDigest.get(view.getUint32(start + off, true)) ?? 0n);
+        skips.push(start + off);
+      }
+      const paramsHash = fnv1a64Params(bytes, start + 4, start + payloadLen, skips);
+      digest = hashCombine64([BigInt(opcode >>> 0), paramsHash, ...inputs]);
+      const existing = this.valueNumber.get(digest);
+      if (existing !== undefined) {
+        if (outId === this.nextNodeId - 1) this.nextNodeId = outId;
+        return existing;
+      }
+      this.valueNumber.set(digest, outId);
+      this.nodeDigest.set(outId, hashCombine64([BigInt(opcode >>> 0), BigInt(outId), paramsHash]));
+      this.contentDigest.set(outId, digest);
+    }
+    let flags = 0;
+    const baseId = digest !== 0n ? this.baseNodes?.get(digest) : undefined;
+    if (baseId !== undefined) {
+      view.setUint32(start + 4, baseId >>> 0, true);
+      payloadLen = 8;
+      flags = OP_FLAG.KEEP;
+    }
+    const at = start - OP_HEADER_SIZE;
+    view.setUint16(at + 0, opcode, true);
+    view.setUint16(at + 2, flags, true);
+    view.setUint32(at + 4, payloadLen >>> 0, true);
+    view.setBigUint64(at + 8, digest, true);
+    this.sink.commitRecord(OP_HEADER_SIZE + payloadLen);
+    this.opCount += 1;
+    return outId;
+  }
+
+  pushParts(opcode: number, parts: Part[]) {
+    const inputOffsets: number[] = [];
+    const w = this.beginOp(partsPayloadLen(parts));
+    for (const p of parts) {
+      if (p.t === "node") inputOffsets.push(w.off - w.start);
+      if (p.t === "u32" || p.t === "node") {
+        w.u32(Number(p.v));
+      } else if (p.t === "u64") {
+        w.u64(BigInt(p.v));
+      } else {
+        w.f64(Number(p.v));
+      }
     }
+    return this.endOp(opcode, inputOffsets);
   }
 
   addSceneObject(rootKind: number, rootId: number, opts?: { id?: string; name?: string }) {
@@ -266,13 +324,12 @@ function applyCrossPlane(crossSection: CrossSection, planeKind: PlaneKind, plane
   if (planeKind === PlaneKind.XY && planeOffset === 0) {
     return crossSection;
   }
-  const out = reg.allocNodeId();
-  reg.push(OP.CROSS_PLANE, makePayload([
-    { t: "u32", v: out },
-    { t: "u32", v: crossSection.nodeId },
+  const out = reg.pushParts(OP.CROSS_PLANE, [
+    { t: "u32", v: reg.allocNodeId() },
+    { t: "node", v: crossSection.nodeId },
     { t: "u32", v: planeKind },
     { t: "f64", v: planeOffset },
-  ]));
+  ]);
   crossSection.consume(opName);
   return new CrossSection(out);
 }
@@ -381,24 +438,22 @@ export class CrossSection {
     if (arguments.length > 1) {
       throw new Error("CrossSection.circle only accepts (radius).");
     }
-    const out = reg.allocNodeId();
-    reg.push(OP.CROSS_CIRCLE, makePayload([
-      { t: "u32", v: out },
+    const out = reg.pushParts(OP.CROSS_CIRCLE, [
+      { t: "u32", v: reg.allocNodeId() },
       { t: "f64", v: radius },
       { t: "u32", v: 0 },
-    ]));
+    ]);
     return new CrossSection(out);
   }
 
   static square(size: number | Vec2Like = [1, 1], center = false) {
     const [x, y] = typeof size === "number" ? [size, size] : vec2(size);
-    const out = reg.allocNodeId();
-    reg.push(OP.CROSS_SQUARE, makePayload([
-      { t: "u32", v: out },
+    const out = reg.pushParts(OP.CROSS_SQUARE, [
+      { t: "u32", v: reg.allocNodeId() },
       { t: "f64", v: x },
       { t: "f64", v: y },
       { t: "u32", v: center ? 1 : 0 },
-    ]));
+    ]);
     return new CrossSection(out);
   }
 
@@ -418,13 +473,12 @@ export class CrossSection {
       [x, y] = vec2(sizeOrWidth);
       if (typeof heightOrCenter === "boolean") center = heightOrCenter;
     }
-    const out = reg.allocNodeId();
-    reg.push(OP.CROSS_RECT, makePayload([
-      { t: "u32", v: out },
+    const out = reg.pushParts(OP.CROSS_RECT, [
+      { t: "u32", v: reg.allocNodeId() },
       { t: "f64", v: x },
       { t: "f64", v: y },
       { t: "u32", v: center ? 1 : 0 },
-    ]));
+    ]);
     return new CrossSection(out);
   }
 
@@ -436,14 +490,13 @@ export class CrossSection {
       throw new Error("CrossSection.point requires position as [x, y].");
     }
     const [x, y] = vec2(position);
-    const out = reg.allocNodeId();
-    reg.push(OP.CROSS_POINT, makePayload([
-      { t: "u32", v: out },
+    const out = reg.pushParts(OP.CROSS_POINT, [
+      { t: "u32", v: reg.allocNodeId() },
       { t: "f64", v: x },
       { t: "f64", v: y },
       { t: "f64", v: radius },
       { t: "u32", v: 0 },
-    ]));
+    ]);
     return new CrossSection(out);
   }
 
@@ -466,8 +519,8 @@ export class CrossSection {
       }
       normalized.push(poly);
     }
-    const out = reg.allocNodeId();
-    reg.push(OP.CROSS_POLYGONS, makePolygonsPayload(out, normalized));
+    writePolygonsPayload(reg.beginOp(polygonsPayloadLen(normalized)), reg.allocNodeId(), normalized);
+    const out = reg.endOp(OP.CROSS_POLYGONS);
     return new CrossSection(out);
   }
 
@@ -481,23 +534,21 @@ export class CrossSection {
 
   translate(x: number | Vec2Like, y?: number) {
     const [tx, ty] = vec2(x, y);
-    const out = reg.allocNodeId();
-    reg.push(OP.CROSS_TRANSLATE, makePayload([
-      { t: "u32", v: out },
-      { t: "u32", v: this.nodeId },
+    const out = reg.pushParts(OP.CROSS_TRANSLATE, [
+      { t: "u32", v: reg.allocNodeId() },
+      { t: "node", v: this.nodeId },
       { t: "f64", v: tx },
       { t: "f64", v: ty },
-    ]));
+    ]);
     return this.derive(out, "CrossSection.translate");
   }
 
   rotate(degrees: number) {
-    const out = reg.allocNodeId();
-    reg.push(OP.CROSS_ROTATE, makePayload([
-      { t: "u32", v: out },
-      { t: "u32", v: this.nodeId },
+    const out = reg.pushParts(OP.CROSS_ROTATE, [
+      { t: "u32", v: reg.allocNodeId() },
+      { t: "node", v: this.nodeId },
       { t: "f64", v: degrees },
-    ]));
+    ]);
     return this.derive(out, "CrossSection.rotate");
   }
 
@@ -506,12 +557,11 @@ export class CrossSection {
     if (!Number.isFinite(r) || r < 0) {
       throw new Error("CrossSection.fillet requires a finite radius >= 0.");
     }
-    const out = reg.allocNodeId();
-    reg.push(OP.CROSS_FILLET, makePayload([
-      { t: "u32", v: out },
-      { t: "u32", v: this.nodeId },
+    const out = reg.pushParts(OP.CROSS_FILLET, [
+      { t: "u32", v: reg.allocNodeId() },
+      { t: "node", v: this.nodeId },
       { t: "f64", v: r },
-    ]));
+    ]);
     return this.derive(out, "CrossSection.fillet");
   }
 
@@ -544,8 +594,8 @@ export class CrossSection {
       seen.add(key);
       normalized.push({ contour, vertex, radius });
     }
-    const out = reg.allocNodeId();
-    reg.push(OP.CROSS_FILLET_CORNERS, makeFilletCornersPayload(out, this.nodeId, normalized));
+    writeFilletCornersPayload(reg.beginOp(12 + normalized.length * 16), reg.allocNodeId(), this.nodeId, normalized);
+    const out = reg.endOp(OP.CROSS_FILLET_CORNERS, [4]);
     return this.derive(out, "CrossSection.filletCorners");
   }
 
@@ -554,12 +604,11 @@ export class CrossSection {
     if (!Number.isFinite(d)) {
       throw new Error("CrossSection.offsetClone requires a finite delta.");
     }
-    const out = reg.allocNodeId();
-    reg.push(OP.CROSS_OFFSET_CLONE, makePayload([
-      { t: "u32", v: out },
-      { t: "u32", v: this.nodeId },
+    const out = reg.pushParts(OP.CROSS_OFFSET_CLONE, [
+      { t: "u32", v: reg.allocNodeId() },
+      { t: "node", v: this.nodeId },
       { t: "f64", v: d },
-    ]));
+    ]);
     return this.derive(out, "CrossSection.offsetClone");
   }
 
@@ -604,25 +653,23 @@ export class Manifold {
     if (arguments.length > 1) {
       throw new Error("Manifold.sphere only accepts (radius).");
     }
-    const out = reg.allocNodeId();
-    reg.push(OP.SPHERE, makePayload([
-      { t: "u32", v: out },
+    const out = reg.pushParts(OP.SPHERE, [
+      { t: "u32", v: reg.allocNodeId() },
       { t: "f64", v: radius },
       { t: "u32", v: 0 },
-    ]));
+    ]);
     return new Manifold(out);
   }
 
   static cube(size: number | Vec3Like = 1, center = false) {
     const [x, y, z] = typeof size === "number" ? [size, size, size] : vec3(size);
-    const out = reg.allocNodeId();
-    reg.push(OP.CUBE, makePayload([
-      { t: "u32", v: out },
+    const out = reg.pushParts(OP.CUBE, [
+      { t: "u32", v: reg.allocNodeId() },
       { t: "f64", v: x },
       { t: "f64", v: y },
       { t: "f64", v: z },
       { t: "u32", v: center ? 1 : 0 },
-    ]));
+    ]);
     return new Manifold(out);
   }
 
@@ -630,39 +677,36 @@ export class Manifold {
     if (arguments.length > 4) {
       throw new Error("Manifold.cylinder only accepts (height, radiusLow, radiusHigh?, center?).");
     }
-    const out = reg.allocNodeId();
-    reg.push(OP.CYLINDER, makePayload([
-      { t: "u32", v: out },
+    const out = reg.pushParts(OP.CYLINDER, [
+      { t: "u32", v: reg.allocNodeId() },
       { t: "f64", v: height },
       { t: "f64", v: radiusLow },
       { t: "f64", v: radiusHigh },
       { t: "u32", v: 0 },
       { t: "u32", v: center ? 1 : 0 },
-    ]));
+    ]);
     return new Manifold(out);
   }
 
   static union(items: Manifold[]) {
     if (!Array.isArray(items) || items.length === 0) throw new Error("Manifold.union requires a non-empty array.");
     for (const item of items) item.assertValid("Manifold.union");
-    const out = reg.allocNodeId();
-    const parts: Part[] = [{ t: "u32", v: out }, { t: "u32", v: items.length }];
-    for (const item of items) parts.push({ t: "u32", v: item.nodeId });
-    reg.push(OP.UNION, makePayload(parts));
+    const parts: Part[] = [{ t: "u32", v: reg.allocNodeId() }, { t: "u32", v: items.length }];
+    for (const item of items) parts.push({ t: "node", v: item.nodeId });
+    const out = reg.pushParts(OP.UNION, parts);
     for (const item of items) item.invalidate();
     return new Manifold(out);
   }
 
   static extrude(crossSection: CrossSection, height: number, divisions = 0, twistDegrees = 0) {
     crossSection.assertValid("Manifold.extrude");
-    const out = reg.allocNodeId();
-    reg.push(OP.EXTRUDE, makePayload([
-      { t: "u32", v: out },
-      { t: "u32", v: crossSection.nodeId },
+    const out = reg.pushParts(OP.EXTRUDE, [
+      { t: "u32", v: reg.allocNodeId() },
+      { t: "node", v: crossSection.nodeId },
       { t: "f64", v: height },
       { t: "u32", v: divisions },
       { t: "f64", v: twistDegrees },
-    ]));
+    ]);
     return new Manifold(out);
   }
 
@@ -671,13 +715,12 @@ export class Manifold {
       throw new Error("Manifold.revolve only accepts (crossSection, revolveDegrees?).");
     }
     crossSection.assertValid("Manifold.revolve");
-    const out = reg.allocNodeId();
-    reg.push(OP.REVOLVE, makePayload([
-      { t: "u32", v: out },
-      { t: "u32", v: crossSection.nodeId },
+    const out = reg.pushParts(OP.REVOLVE, [
+      { t: "u32", v: reg.allocNodeId() },
+      { t: "node", v: crossSection.nodeId },
       { t: "u32", v: 0 },
       { t: "f64", v: revolveDegrees },
-    ]));
+    ]);
     crossSection.consume("Manifold.revolve");
     return new Manifold(out);
   }
@@ -687,12 +730,11 @@ export class Manifold {
   subtract(other: Manifold) {
     this.assertValid("Manifold.subtract");
     other.assertValid("Manifold.subtract");
-    const out = reg.allocNodeId();
-    reg.push(OP.SUBTRACT, makePayload([
-      { t: "u32", v: out },
-      { t: "u32", v: this.nodeId },
-      { t: "u32", v: other.nodeId },
-    ]));
+    const out = reg.pushParts(OP.SUBTRACT, [
+      { t: "u32", v: reg.allocNodeId() },
+      { t: "node", v: this.nodeId },
+      { t: "node", v: other.nodeId },
+    ]);
     this.invalidate();
     other.invalidate();
     return new Manifold(out);
@@ -701,12 +743,11 @@ export class Manifold {
   intersect(other: Manifold) {
     this.assertValid("Manifold.intersect");
     other.assertValid("Manifold.intersect");
-    const out = reg.allocNodeId();
-    reg.push(OP.INTERSECT, makePayload([
-      { t: "u32", v: out },
-      { t: "u32", v: this.nodeId },
-      { t: "u32", v: other.nodeId },
-    ]));
+    const out = reg.pushParts(OP.INTERSECT, [
+      { t: "u32", v: reg.allocNodeId() },
+      { t: "node", v: this.nodeId },
+      { t: "node", v: other.nodeId },
+    ]);
     this.invalidate();
     other.invalidate();
     return new Manifold(out);
@@ -714,51 +755,47 @@ export class Manifold {
 
   translate(x: number | Vec3Like, y?: number, z?: number) {
     const [tx, ty, tz] = vec3(x, y, z);
-    const out = reg.allocNodeId();
-    reg.push(OP.TRANSLATE, makePayload([
-      { t: "u32", v: out },
-      { t: "u32", v: this.nodeId },
+    const out = reg.pushParts(OP.TRANSLATE, [
+      { t: "u32", v: reg.allocNodeId() },
+      { t: "node", v: this.nodeId },
       { t: "f64", v: tx },
       { t: "f64", v: ty },
       { t: "f64", v: tz },
-    ]));
+    ]);
     return this.derive(out, "Manifold.translate");
   }
 
   rotate(x: number | Vec3Like, y?: number, z?: number) {
     const [rx, ry, rz] = vec3(x, y, z);
-    const out = reg.allocNodeId();
-    reg.push(OP.ROTATE, makePayload([
-      { t: "u32", v: out },
-      { t: "u32", v: this.nodeId },
+    const out = reg.pushParts(OP.ROTATE, [
+      { t: "u32", v: reg.allocNodeId() },
+      { t: "node", v: this.nodeId },
       { t: "f64", v: rx },
       { t: "f64", v: ry },
       { t: "f64", v: rz },
-    ]));
+    ]);
     return this.derive(out, "Manifold.rotate");
   }
 
   scale(x: number | Vec3Like, y?: number, z?: number) {
     const [sx, sy, sz] = vec3(x, y, z);
-    const out = reg.allocNodeId();
-    reg.push(OP.SCALE, makePayload([
-      { t: "u32", v: out },
-      { t: "u32", v: this.nodeId },
+    const out = reg.pushParts(OP.SCALE, [
+      { t: "u32", v: reg.allocNodeId() },
+      { t: "node", v: this.nodeId },
       { t: "f64", v: sx },
       { t: "f64", v: sy },
       { t: "f64", v: sz },
-    ]));
+    ]);
     return this.derive(out, "Manifold.scale");
   }
 
   slice(height = 0) {
     this.assertValid("Manifold.slice");
-    const out = reg.allocNodeId();
-    reg.push(OP.SLICE, makePayload([
-      { t: "u32", v: out },
-      { t: "u32", v: this.nodeId },
+    const out = reg.pushParts(OP.SLICE, [
+      { t: "u32", v: reg.allocNodeId() },
+      { t: "node", v: this.nodeId },
       { t: "f64", v: height },
-    ]));
+    ]);
     this.invalidate();
     return new CrossSection(out);
   }
@@ -798,13 +835,19 @@ export const vicad = {
   },
 };
 
-export function __vicadBeginRun() {
-  reg.reset();
+// Records are encoded into `sink`, or kept in memory for __vicadEncodeScene
+// when none is given. `base` is the __vicadRunNodes() of the run the client
+// holds replay results for; passing it turns the run into a delta against
+// that run.
+export function __vicadBeginRun(sink?: OpSink, base?: Map<bigint, number>) {
+  reg.reset(sink ?? new BufferSink());
+  reg.baseNodes = base ?? null;
   _crossSections.clear();
   _manifolds.clear();
 }
 
-export function __vicadEncodeScene() {
+// Finalizes scene registration; the op records are already in the run's sink.
+export function __vicadCollectScene() {
   const sceneEntries = reg.sceneEntries.slice();
   for (const crossSection of _crossSections) {
     if (crossSection.autoAddToScene) {
@@ -823,8 +866,18 @@ export function __vicadEncodeScene() {
     throw new Error("SceneRegistrationError: no scene entries were produced. Use autoAddToScene or vicad.add(...).");
   }
   return {
-    opCount: reg.ops.length,
-    records: encodeOps(reg.ops),
+    opCount: reg.opCount,
     sceneEntries: finalSceneEntries,
   };
 }
+
+// Content digest -> node id of every op pushed this run.
+export function __vicadRunNodes() {
+  return new Map(reg.valueNumber);
+}
+
+export function __vicadEncodeScene() {
+  const scene = __vicadCollectScene();
+  if (!(reg.sink instanceof BufferSink)) throw new Error("__vicadEncodeScene needs a run begun without a sink.");
+  return { ...scene, records: reg.sink.records };
+}
@@ -0,0 +1,132 @@
+import { HEADER_OFFSETS, RESPONSE_OFFSETS } from "./ipc_protocol";
+import type { OpSink } from "./op-encoder";
+import { createSegment, releaseSegment, ringDoorbell, type ShmSegment } from "./shm";
+
+const MIN_OVERFLOW_SIZE = 4 * 1024 * 1024;
+const MAX_SEGMENT_SIZE = 0xffffffff;
+// Commit the watermark every few ops, or sooner when the script is slow
+// between ops, so the client can replay while the script keeps running.
+const COMMIT_EVERY_OPS = 64;
+const COMMIT_INTERVAL_MS = 2;
+
+type LogFn = (event: string, fields?: Record<string, string | number>) => void;
+
+function nextPowerOfTwo(n: number) {
+  let size = 1;
+  while (size < n) size *= 2;
+  return size;
+}
+
+// Owns where the response payload lives and is the sink the script's op
+// records are encoded into, in place, as it pushes them. The stream base is
+// responseOffset in the main segment and 0 in an overflow segment; records sit
+// behind a scene payload header there, so a successful response is assembled
+// in place. A payload that outgrows its segment moves to the next overflow
+// generation; POSIX shm objects cannot be resized on macOS, so growth always
+// means a new segment.
+export class ResponseStream implements OpSink {
+  private readonly main: ShmSegment;
+  private readonly shmName: string;
+  private readonly log: LogFn;
+  private readonly header: DataView;
+  private readonly committedWord: Uint32Array;
+  private readonly stateWordPtr: number;
+  private overflow: ShmSegment | null = null;
+  private generation = 0;
+  private out: ShmSegment;
+  private base = 0;
+  private streamed = 0;
+  private pendingOps = 0;
+  private lastCommitAt = 0;
+  // performance.now() of the run's first record, or 0.
+  firstRecordAt = 0;
+
+  constructor(main: ShmSegment, shmName: string, log: LogFn) {
+    this.main = main;
+    this.shmName = shmName;
+    this.log = log;
+    this.header = main.view;
+    this.committedWord = new Uint32Array(main.bytes.buffer, main.bytes.byteOffset + HEADER_OFFSETS.recordsCommitted, 1);
+    this.stateWordPtr = main.ptr + HEADER_OFFSETS.state;
+    this.out = main;
+    this.beginRun();
+  }
+
+  // The client resets responseOffset and recordsCommitted before every run;
+  // the stream starts over in the main segment.
+  beginRun() {
+    this.out = this.main;
+    this.base = this.header.getUint32(HEADER_OFFSETS.responseOffset, true);
+    this.header.setUint32(HEADER_OFFSETS.responseSegment, 0, true);
+    this.streamed = 0;
+    this.pendingOps = 0;
+    this.lastCommitAt = performance.now();
+    this.firstRecordAt = 0;
+  }
+
+  // Returns the segment and offset that can hold a `total`-byte payload, keeping
+  // the first `keep` bytes of the current payload when it has to move.
+  reserve(total: number, keep: number) {
+    if (this.base + total <= this.out.size) return { out: this.out, offset: this.base };
+    const grown = this.out === this.overflow ? this.out.size * 2 : 0;
+    const size = Math.max(MIN_OVERFLOW_SIZE, nextPowerOfTwo(total), grown);
+    if (size > MAX_SEGMENT_SIZE) throw new Error("Response exceeds the maximum shared memory segment size.");
+    const next = createSegment(`${this.shmName}-r${this.generation + 1}`, size);
+    next.bytes.set(this.out.bytes.subarray(this.base, this.base + keep), 0);
+    // Publish the new generation before unlinking the old segment: a client
+    // whose open of the old name fails sees the generation change and maps the
+    // new segment instead of failing the run.
+    const previous = this.overflow;
+    this.overflow = next;
+    this.generation += 1;
+    this.out = next;
+    this.base = 0;
+    this.header.setUint32(HEADER_OFFSETS.responseSegment, this.generation, true);
+    if (previous) releaseSegment(previous);
+    this.log("SHM_OVERFLOW_GROWN", { generation: this.generation, bytes: size });
+    return { out: this.out, offset: this.base };
+  }
+
+  // Places a payload behind the streamed records, which the client may still be
+  // reading, e.g. an error response for a run that already streamed ops.
+  reserveTail(total: number) {
+    const used = RESPONSE_OFFSETS.sceneHeaderSize + this.streamed;
+    const { out, offset } = this.reserve(used + total, used);
+    return { out, offset: offset + used };
+  }
+
+  // Records are encoded in place behind the ones already streamed.
+  reserveRecord(len: number) {
+    const used = RESPONSE_OFFSETS.sceneHeaderSize + this.streamed;
+    const { out, offset } = this.reserve(used + len, used);
+    return { bytes: out.bytes, view: out.view, offset: offset + used };
+  }
+
+  commitRecord(len: number) {
+    if (this.streamed === 0) this.firstRecordAt = performance.now();
+    this.streamed += len;
+    this.pendingOps += 1;
+    if (this.pendingOps >= COMMIT_EVERY_OPS || performance.now() - this.lastCommitAt >= COMMIT_INTERVAL_MS) {
+      this.commit();
+    }
+  }
+
+  // Publishes every record written so far. Atomics.store orders the record
+  // bytes (and any responseSegment change) before the watermark.
+  commit() {
+    Atomics.store(this.committedWord, 0, this.streamed);
+    ringDoorbell(this.stateWordPtr);
+    this.pendingOps = 0;
+    this.lastCommitAt = performance.now();
+  }
+
+  get recordsSize() {
+    return this.streamed;
+  }
+
+  release() {
+    if (this.overflow) releaseSegment(this.overflow);
+    this.overflow = null;
+    this.out = this.main;
+  }
+}
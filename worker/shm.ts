@@ -0,0 +1,87 @@
+import { dlopen, FFIType, toArrayBuffer } from "bun:ffi";
+
+const libc = dlopen("/usr/lib/libSystem.B.dylib", {
+  shm_open: { args: [FFIType.cstring, FFIType.i32, FFIType.i32], returns: FFIType.i32 },
+  shm_unlink: { args: [FFIType.cstring], returns: FFIType.i32 },
+  ftruncate: { args: [FFIType.i32, FFIType.i64], returns: FFIType.i32 },
+  mmap: { args: [FFIType.ptr, FFIType.u64, FFIType.i32, FFIType.i32, FFIType.i32, FFIType.i64], returns: FFIType.ptr },
+  munmap: { args: [FFIType.ptr, FFIType.u64], returns: FFIType.i32 },
+  close: { args: [FFIType.i32], returns: FFIType.i32 },
+});
+
+// os_sync_wake_by_address_any exists on macOS 14.4+. Without it the client
+// still notices the state change on its next liveness slice.
+function loadDoorbell() {
+  try {
+    return dlopen("/usr/lib/libSystem.B.dylib", {
+      os_sync_wake_by_address_any: { args: [FFIType.ptr, FFIType.u64, FFIType.u32], returns: FFIType.i32 },
+    }).symbols.os_sync_wake_by_address_any;
+  } catch {
+    return null;
+  }
+}
+const wakeByAddress = loadDoorbell();
+const OS_SYNC_WAKE_BY_ADDRESS_SHARED = 0x1;
+
+const O_RDWR = 0x0002;
+const O_CREAT = 0x0200;
+const O_EXCL = 0x0800;
+const PROT_READ = 0x1;
+const PROT_WRITE = 0x2;
+const MAP_SHARED = 0x0001;
+
+export type ShmSegment = {
+  name: string;
+  size: number;
+  ptr: number;
+  bytes: Uint8Array;
+  view: DataView;
+};
+
+function cstr(value: string) {
+  return new TextEncoder().encode(`${value}\0`);
+}
+
+function mapSegment(name: string, fd: number, size: number): ShmSegment {
+  const mapPtr = libc.symbols.mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  libc.symbols.close(fd);
+  if (Number(mapPtr) === -1) throw new Error(`mmap failed for ${name}`);
+  const bytes = new Uint8Array(toArrayBuffer(mapPtr, 0, size));
+  return {
+    name,
+    size,
+    ptr: Number(mapPtr),
+    bytes,
+    view: new DataView(bytes.buffer, bytes.byteOffset, bytes.byteLength),
+  };
+}
+
+// Maps a segment created by the client.
+export function openSegment(name: string, size: number) {
+  const fd = libc.symbols.shm_open(cstr(name), O_RDWR, 0);
+  if (fd < 0) throw new Error(`shm_open failed for ${name}`);
+  return mapSegment(name, fd, size);
+}
+
+// Creates and maps a fresh zero-filled segment. macOS only allows sizing a
+// POSIX shm object once, so growth always means a new segment.
+export function createSegment(name: string, size: number) {
+  const fd = libc.symbols.shm_open(cstr(name), O_RDWR | O_CREAT | O_EXCL, 0o600);
+  if (fd < 0) throw new Error(`shm_open failed for ${name}`);
+  if (libc.symbols.ftruncate(fd, size) !== 0) {
+    libc.symbols.close(fd);
+    libc.symbols.shm_unlink(cstr(name));
+    throw new Error(`ftruncate failed for ${name}`);
+  }
+  return mapSegment(name, fd, size);
+}
+
+export function releaseSegment(segment: ShmSegment) {
+  libc.symbols.munmap(segment.ptr, segment.size);
+  libc.symbols.shm_unlink(cstr(segment.name));
+}
+
+// Wakes a client blocked in DoorbellWait on the 32-bit word at `ptr`.
+export function ringDoorbell(ptr: number) {
+  if (wakeByAddress) wakeByAddress(ptr, 4, OS_SYNC_WAKE_BY_ADDRESS_SHARED);
+}
@@ -1,20 +1,22 @@
-import { dlopen, FFIType, toArrayBuffer } from "bun:ffi";
 import { resolve } from "node:path";
 import { createConnection } from "node:net";
 
 import {
   HEADER_OFFSETS,
   HEADER_SIZE,
+  IMPORTS_SEPARATOR,
   IPC_ERROR,
   IPC_ERROR_PHASE,
   IPC_MAGIC,
   IPC_STATE,
   IPC_VERSION,
+  REQUEST_OFFSETS,
   RESPONSE_OFFSETS,
 } from "./ipc_protocol";
 import {
   __vicadBeginRun,
-  __vicadEncodeScene,
+  __vicadCollectScene,
+  __vicadRunNodes,
   CrossSection,
   GLTFNode,
   Manifold,
@@ -25,6 +27,8 @@ import {
   YZ,
   vicad,
 } from "./proxy-manifold";
+import { ResponseStream } from "./response-stream";
+import { openSegment, ringDoorbell } from "./shm";
 
 const args = Bun.argv.slice(2);
 function arg(name: string) {
@@ -40,28 +44,12 @@ if (!socketPath || !shmName || !Number.isFinite(shmSize) || shmSize <= HEADER_SI
   throw new Error("Usage: bun worker/worker.ts --socket <path> --shm <name> --size <bytes>");
 }
 
-const libc = dlopen("/usr/lib/libSystem.B.dylib", {
-  shm_open: { args: [FFIType.cstring, FFIType.i32, FFIType.i32], returns: FFIType.i32 },
-  mmap: { args: [FFIType.ptr, FFIType.u64, FFIType.i32, FFIType.i32, FFIType.i32, FFIType.i64], returns: FFIType.ptr },
-  close: { args: [FFIType.i32], returns: FFIType.i32 },
-});
-
-const O_RDWR = 0x0002;
-const PROT_READ = 0x1;
-const PROT_WRITE = 0x2;
-const MAP_SHARED = 0x0001;
-
-function cstr(value: string) {
-  return new TextEncoder().encode(`${value}\0`);
-}
-
-const fd = libc.symbols.shm_open(cstr(shmName), O_RDWR, 0);
-if (fd < 0) throw new Error(`shm_open failed for ${shmName}`);
-const mapPtr = libc.symbols.mmap(0, shmSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-if (Number(mapPtr) === -1) throw new Error("mmap failed");
-const shared = new Uint8Array(toArrayBuffer(mapPtr, 0, shmSize));
-const view = new DataView(shared.buffer, shared.byteOffset, shared.byteLength);
-libc.symbols.close(fd);
+const main = openSegment(shmName, shmSize);
+const shared = main.bytes;
+const view = main.view;
+const stateWord = new Uint32Array(shared.buffer, shared.byteOffset + HEADER_OFFSETS.state, 1);
+const stateWordPtr = main.ptr + HEADER_OFFSETS.state;
+const stream = new ResponseStream(main, shmName, log);
 
 function readAscii(offset: number, len: number) {
   return new TextDecoder().decode(shared.subarray(offset, offset + len));
@@ -80,6 +68,13 @@ function setU64(off: number, v: bigint) {
   view.setBigUint64(off, v, true);
 }
 
+// Publishes a new SharedHeader::state and rings the doorbell the client waits
+// on. Atomics.store orders every earlier payload write before the state word.
+function publishState(state: number) {
+  Atomics.store(stateWord, 0, state);
+  ringDoorbell(stateWordPtr);
+}
+
 function headerCheck() {
   const magic = readAscii(HEADER_OFFSETS.magic, 8);
   const version = getU32(HEADER_OFFSETS.version);
@@ -100,79 +95,164 @@ type ErrorDiagnostic = {
 };
 
 function writeErrorResponse(diag: ErrorDiagnostic) {
-  const responseOffset = getU32(HEADER_OFFSETS.responseOffset);
-  const capacity = getU32(HEADER_OFFSETS.capacityBytes);
   const message = new TextEncoder().encode(diag.message);
   const stack = new TextEncoder().encode(diag.stack);
   const file = new TextEncoder().encode(diag.file);
   const total = 44 + message.byteLength + stack.byteLength + file.byteLength;
-  if (responseOffset + total > capacity) throw new Error("Error response exceeds shared memory size.");
-  view.setUint32(responseOffset + 0, IPC_VERSION, true);
-  view.setUint32(responseOffset + 4, diag.code >>> 0, true);
-  view.setUint32(responseOffset + 8, diag.phase >>> 0, true);
-  view.setUint32(responseOffset + 12, Math.max(0, diag.line) >>> 0, true);
-  view.setUint32(responseOffset + 16, Math.max(0, diag.column) >>> 0, true);
-  view.setBigUint64(responseOffset + 20, diag.runId, true);
-  view.setUint32(responseOffset + 28, Math.max(0, Math.trunc(diag.durationMs)) >>> 0, true);
-  view.setUint32(responseOffset + 32, file.byteLength >>> 0, true);
-  view.setUint32(responseOffset + 36, stack.byteLength >>> 0, true);
-  view.setUint32(responseOffset + 40, message.byteLength >>> 0, true);
+  const { out, offset: responseOffset } = stream.reserveTail(total);
+  const outView = out.view;
+  outView.setUint32(responseOffset + 0, IPC_VERSION, true);
+  outView.setUint32(responseOffset + 4, diag.code >>> 0, true);
+  outView.setUint32(responseOffset + 8, diag.phase >>> 0, true);
+  outView.setUint32(responseOffset + 12, Math.max(0, diag.line) >>> 0, true);
+  outView.setUint32(responseOffset + 16, Math.max(0, diag.column) >>> 0, true);
+  outView.setBigUint64(responseOffset + 20, diag.runId, true);
+  outView.setUint32(responseOffset + 28, Math.max(0, Math.trunc(diag.durationMs)) >>> 0, true);
+  outView.setUint32(responseOffset + 32, file.byteLength >>> 0, true);
+  outView.setUint32(responseOffset + 36, stack.byteLength >>> 0, true);
+  outView.setUint32(responseOffset + 40, message.byteLength >>> 0, true);
   let off = responseOffset + 44;
-  shared.set(file, off);
+  out.bytes.set(file, off);
   off += file.byteLength;
-  shared.set(stack, off);
+  out.bytes.set(stack, off);
   off += stack.byteLength;
-  shared.set(message, off);
+  out.bytes.set(message, off);
+  setU32(HEADER_OFFSETS.responseOffset, responseOffset);
   setU32(HEADER_OFFSETS.responseLength, total);
   setU32(HEADER_OFFSETS.errorCode, diag.code);
-  setU32(HEADER_OFFSETS.state, IPC_STATE.RESP_ERROR);
 }
 
+// Phase boundaries of a run, in performance.now() milliseconds. Load ends at
+// the script's first op (or its end when it pushes none); encode runs from the
+// end of the script until the response header is written.
+type RunTimings = {
+  startedAt: number;
+  firstOpAt: number;
+  executedAt: number;
+};
+
+function toMicros(ms: number) {
+  return Math.max(0, Math.round(ms * 1000)) >>> 0;
+}
+
+// Op records were already streamed behind the payload header by
+// ResponseStream; this appends the object table, names and imports and fills
+// the header.
 function writeSuccessResponseScene(
   objectCount: number,
   opCount: number,
-  records: Uint8Array,
   objectTable: Uint8Array,
   namesBlob: Uint8Array,
+  importsBlob: Uint8Array,
+  timings: RunTimings,
 ) {
-  const responseOffset = getU32(HEADER_OFFSETS.responseOffset);
-  const capacity = getU32(HEADER_OFFSETS.capacityBytes);
   const headLen = RESPONSE_OFFSETS.sceneHeaderSize;
-  const total = headLen + records.byteLength + objectTable.byteLength + namesBlob.byteLength;
-  if (responseOffset + total > capacity) throw new Error("Success response exceeds shared memory size.");
-  view.setUint32(responseOffset + RESPONSE_OFFSETS.sceneVersion, IPC_VERSION, true);
-  view.setUint32(responseOffset + RESPONSE_OFFSETS.sceneObjectCount, objectCount >>> 0, true);
-  view.setUint32(responseOffset + RESPONSE_OFFSETS.sceneOpCount, opCount >>> 0, true);
-  view.setUint32(responseOffset + RESPONSE_OFFSETS.sceneRecordsSize, records.byteLength >>> 0, true);
-  view.setUint32(responseOffset + RESPONSE_OFFSETS.sceneDiagnosticsLen, namesBlob.byteLength >>> 0, true);
-  view.setUint32(responseOffset + RESPONSE_OFFSETS.sceneObjectTableSize, objectTable.byteLength >>> 0, true);
-
-  let off = responseOffset + headLen;
-  shared.set(records, off);
-  off += records.byteLength;
-  shared.set(objectTable, off);
+  const recordsSize = stream.recordsSize;
+  const diagnosticsLen = namesBlob.byteLength + importsBlob.byteLength;
+  const total = headLen + recordsSize + objectTable.byteLength + diagnosticsLen;
+  const { out, offset: responseOffset } = stream.reserve(total, headLen + recordsSize);
+  const outView = out.view;
+  outView.setUint32(responseOffset + RESPONSE_OFFSETS.sceneVersion, IPC_VERSION, true);
+  outView.setUint32(responseOffset + RESPONSE_OFFSETS.sceneObjectCount, objectCount >>> 0, true);
+  outView.setUint32(responseOffset + RESPONSE_OFFSETS.sceneOpCount, opCount >>> 0, true);
+  outView.setUint32(responseOffset + RESPONSE_OFFSETS.sceneRecordsSize, recordsSize >>> 0, true);
+  outView.setUint32(responseOffset + RESPONSE_OFFSETS.sceneDiagnosticsLen, diagnosticsLen >>> 0, true);
+  outView.setUint32(responseOffset + RESPONSE_OFFSETS.sceneObjectTableSize, objectTable.byteLength >>> 0, true);
+
+  let off = responseOffset + headLen + recordsSize;
+  out.bytes.set(objectTable, off);
   off += objectTable.byteLength;
-  shared.set(namesBlob, off);
+  out.bytes.set(namesBlob, off);
+  off += namesBlob.byteLength;
+  out.bytes.set(importsBlob, off);
+  const loadEnd = timings.firstOpAt || timings.executedAt;
+  outView.setUint32(responseOffset + RESPONSE_OFFSETS.sceneLoadUs, toMicros(loadEnd - timings.startedAt), true);
+  outView.setUint32(responseOffset + RESPONSE_OFFSETS.sceneExecuteUs, toMicros(timings.executedAt - loadEnd), true);
+  outView.setUint32(
+    responseOffset + RESPONSE_OFFSETS.sceneEncodeUs,
+    toMicros(performance.now() - timings.executedAt),
+    true,
+  );
+  stream.commit();
+  setU32(HEADER_OFFSETS.responseOffset, responseOffset);
   setU32(HEADER_OFFSETS.responseLength, total);
   setU32(HEADER_OFFSETS.errorCode, IPC_ERROR.NONE);
-  setU32(HEADER_OFFSETS.state, IPC_STATE.RESP_READY);
 }
 
-function requestScriptPath() {
+function readRequest() {
   const reqOffset = getU32(HEADER_OFFSETS.requestOffset);
   const reqLen = getU32(HEADER_OFFSETS.requestLength);
-  if (reqLen < 8) throw new Error("Request payload too short.");
-  const reqVersion = view.getUint32(reqOffset, true);
-  const pathLen = view.getUint32(reqOffset + 4, true);
+  const headLen = REQUEST_OFFSETS.headerSize;
+  if (reqLen < headLen) throw new Error("Request payload too short.");
+  const reqVersion = view.getUint32(reqOffset + REQUEST_OFFSETS.version, true);
+  const pathLen = view.getUint32(reqOffset + REQUEST_OFFSETS.scriptPathLen, true);
+  const deltaBaseSeq = view.getBigUint64(reqOffset + REQUEST_OFFSETS.deltaBaseSeq, true);
   if (reqVersion !== IPC_VERSION) throw new Error("Request version mismatch.");
-  if (8 + pathLen > reqLen) throw new Error("Request path is truncated.");
-  const bytes = shared.subarray(reqOffset + 8, reqOffset + 8 + pathLen);
-  return new TextDecoder().decode(bytes);
+  if (headLen + pathLen > reqLen) throw new Error("Request path is truncated.");
+  const bytes = shared.subarray(reqOffset + headLen, reqOffset + headLen + pathLen);
+  return { path: new TextDecoder().decode(bytes), deltaBaseSeq };
+}
+
+// Node table of the last successful run. The client names it as the delta
+// base when it still holds that run's replay results.
+let lastRun: { seq: bigint; nodes: Map<bigint, number> } | null = null;
+
+type ModuleRegistry = {
+  keys(): IterableIterator<string>;
+  delete(key: string): boolean;
+};
+
+const WORKER_DIR = import.meta.dir;
+
+function moduleKeyPath(key: string) {
+  return key.replace(/^file:\/\//, "").replace(/\?.*$/, "");
+}
+
+function isUserModuleKey(key: string) {
+  const path = moduleKeyPath(key);
+  if (!path.startsWith("/")) return false;
+  if (path.startsWith(`${WORKER_DIR}/`)) return false;
+  return !path.includes("/node_modules/");
+}
+
+function moduleRegistry() {
+  return (globalThis as { Loader?: { registry?: ModuleRegistry } }).Loader?.registry;
+}
+
+// User modules the last run loaded besides the script itself. They were all
+// evicted before the run, so whatever is loaded now is this run's import set.
+function loadedUserModules(scriptPath: string) {
+  const paths = new Set<string>();
+  const keys = [...(moduleRegistry()?.keys() ?? []), ...Object.keys(require.cache)];
+  for (const key of keys) {
+    if (isUserModuleKey(key)) paths.add(moduleKeyPath(key));
+  }
+  paths.delete(scriptPath);
+  return [...paths].sort();
+}
+
+// Bun caches ESM modules per process and does not re-run top-level side
+// effects for repeated imports. The worker stays warm across runs, so every
+// user module (the script and anything it imports locally) is dropped from the
+// loader before each run; worker modules and node_modules stay cached.
+function evictUserModules() {
+  const registry = moduleRegistry();
+  if (registry) {
+    for (const key of Array.from(registry.keys())) {
+      if (isUserModuleKey(key)) registry.delete(key);
+    }
+  }
+  for (const key of Object.keys(require.cache)) {
+    if (isUserModuleKey(key)) delete require.cache[key];
+  }
 }
 
-async function executeScript(scriptPath: string) {
+async function executeScript(scriptPath: string, runId: bigint, base: Map<bigint, number> | undefined) {
   const abs = resolve(scriptPath);
-  __vicadBeginRun();
+  const timings: RunTimings = { startedAt: performance.now(), firstOpAt: 0, executedAt: 0 };
+  evictUserModules();
+  stream.beginRun();
+  __vicadBeginRun(stream, base);
   const g = globalThis as Record<string, unknown>;
   g.Manifold = Manifold;
   g.CrossSection = CrossSection;
@@ -183,11 +263,13 @@ async function executeScript(scriptPath: string) {
   g.XZ = XZ;
   g.YZ = YZ;
   g.vicad = vicad;
-  const loaded = await import(`file://${abs}?t=${Date.now()}`);
+  const loaded = await import(`file://${abs}?run=${runId}`);
+  timings.executedAt = performance.now();
+  timings.firstOpAt = stream.firstRecordAt;
   if (loaded.default !== undefined) {
     throw new Error("SceneRegistrationError: scene mode uses side-effect registration only; default export is disabled.");
   }
-  return __vicadEncodeScene();
+  return { ...__vicadCollectScene(), imports: loadedUserModules(abs), timings };
 }
 
 function toErrCode(e: unknown) {
@@ -255,7 +337,8 @@ sock.on("data", async (chunk: Buffer) => {
     recv = recv.slice(nl + 1);
     if (!line) continue;
     if (line === "SHUTDOWN") {
-      setU32(HEADER_OFFSETS.state, IPC_STATE.SHUTDOWN);
+      stream.release();
+      publishState(IPC_STATE.SHUTDOWN);
       shuttingDown = true;
       sock.end();
       break;
@@ -276,17 +359,19 @@ sock.on("data", async (chunk: Buffer) => {
         runId: seq,
         durationMs: 0,
       };
+      stream.beginRun();
       writeErrorResponse(diag);
       setU64(HEADER_OFFSETS.responseSeq, seq);
-      sock.write(`ERROR ${seq}\n`);
+      publishState(IPC_STATE.RESP_ERROR);
       continue;
     }
-    setU32(HEADER_OFFSETS.state, IPC_STATE.REQ_RUNNING);
+    publishState(IPC_STATE.REQ_RUNNING);
     const startedAt = Date.now();
     log("RUN_STARTED", { run_id: seq.toString() });
     try {
-      const path = requestScriptPath();
-      const result = await executeScript(path);
+      const request = readRequest();
+      const base = lastRun && request.deltaBaseSeq === lastRun.seq ? lastRun.nodes : undefined;
+      const result = await executeScript(request.path, seq, base);
       const entries = result.sceneEntries;
       const objectTable = new Uint8Array(entries.length * RESPONSE_OFFSETS.objectRecordSize);
       const tableView = new DataView(objectTable.buffer);
@@ -310,16 +395,18 @@ sock.on("data", async (chunk: Buffer) => {
         namesBlob.set(nb, nOff);
         nOff += nb.byteLength;
       }
-      writeSuccessResponseScene(entries.length, result.opCount, result.records, objectTable, namesBlob);
+      const importsBlob = new TextEncoder().encode(result.imports.join(IMPORTS_SEPARATOR));
+      writeSuccessResponseScene(entries.length, result.opCount, objectTable, namesBlob, importsBlob, result.timings);
+      lastRun = { seq, nodes: __vicadRunNodes() };
       setU64(HEADER_OFFSETS.responseSeq, seq);
-      log("RUN_DONE", { run_id: seq.toString(), duration_ms: Date.now() - startedAt });
-      sock.write(`DONE ${seq}\n`);
+      publishState(IPC_STATE.RESP_READY);
+      log("RUN_DONE", { run_id: seq.toString(), duration_ms: Date.now() - startedAt, delta: base ? 1 : 0 });
     } catch (error) {
       const diag = makeDiag(error, IPC_ERROR_PHASE.SCRIPT_EXECUTE, seq, startedAt);
       writeErrorResponse(diag);
       setU64(HEADER_OFFSETS.responseSeq, seq);
+      publishState(IPC_STATE.RESP_ERROR);
       log("RUN_FAILED", { run_id: seq.toString(), duration_ms: Date.now() - startedAt, code: diag.code });
-      sock.write(`ERROR ${seq}\n`);
     }
   }
 });